@@ -48,6 +48,7 @@ extern "C"{
 #define digitalPinToInterrupt(P)   ( P )
 
 void yield(void);
+void idle(void);
 
 /* sketch */
 extern void setup( void ) ;
@@ -100,6 +101,11 @@ extern PinDescription g_APinDescription[] ;
 extern uint32_t pwmPeriod[4];
 
 extern uint8_t pinmuxMode[NUM_DIGITAL_PINS];
+/* Last value written to each pin's pull-up enable, so digitalWrite() can
+ * skip the SCSS write when the level it mirrors hasn't changed. OUTPUT pins
+ * are marked PIN_PULLUP_OUTPUT: the pull-up is off and left alone */
+#define PIN_PULLUP_OUTPUT 0x80
+extern uint8_t pinPullup[NUM_DIGITAL_PINS];
 
 #ifdef __cplusplus
 } // extern "C"
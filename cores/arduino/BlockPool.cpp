@@ -0,0 +1,98 @@
+/*
+  BlockPool.cpp - fixed-size block pools for library objects
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include "BlockPool.h"
+#include "interrupt.h"
+
+BlockPool::BlockPool(size_t blockSize, uint16_t count, void *storage) :
+	_storage((uint8_t *)storage),
+	_freeList(NULL),
+	_blockSize(blockBytes(blockSize)),
+	_count(count),
+	_available(0)
+{
+	if (_storage)
+		reset();
+}
+
+bool BlockPool::init(void)
+{
+	// allocate outside the lock; a racing init() just loses its copy
+	uint8_t *storage = (uint8_t *)malloc(_blockSize * _count);
+	if (!storage)
+		return false;
+
+	uint32_t saved = interrupt_lock();
+	if (_storage) {
+		interrupt_unlock(saved);
+		::free(storage);
+		return true;
+	}
+	_storage = storage;
+	interrupt_unlock(saved);
+	reset();
+	return true;
+}
+
+void BlockPool::reset(void)
+{
+	uint32_t saved = interrupt_lock();
+	_freeList = NULL;
+	for (uint16_t i = _count; i > 0; i--) {
+		void **block = (void **)(_storage + (i - 1) * _blockSize);
+		*block = _freeList;
+		_freeList = block;
+	}
+	_available = _count;
+	interrupt_unlock(saved);
+}
+
+void *BlockPool::alloc(void)
+{
+	if (!_storage && !init())
+		return NULL;
+
+	uint32_t saved = interrupt_lock();
+	void **block = (void **)_freeList;
+	if (block) {
+		_freeList = *block;
+		_available--;
+	}
+	interrupt_unlock(saved);
+	return block;
+}
+
+void BlockPool::free(void *ptr)
+{
+	if (!ptr)
+		return;
+
+	uint32_t saved = interrupt_lock();
+	*(void **)ptr = _freeList;
+	_freeList = ptr;
+	_available++;
+	interrupt_unlock(saved);
+}
+
+bool BlockPool::owns(const void *ptr) const
+{
+	return _storage && (const uint8_t *)ptr >= _storage &&
+	       (const uint8_t *)ptr < _storage + _blockSize * _count;
+}
@@ -0,0 +1,127 @@
+/*
+  BlockPool.h - fixed-size block pools for library objects
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef BlockPool_h
+#define BlockPool_h
+#ifdef __cplusplus
+
+#include <stdint.h>
+#include <stddef.h>
+#include "new.h"
+
+// count blocks of one size on a free list, so alloc() and free() are
+// constant time and a pool never fragments the heap. The storage is either
+// given or malloc'd in one piece on the first alloc(). Safe from ISRs.
+class BlockPool
+{
+public:
+	// blocks are 8 byte aligned and at least pointer sized
+	static constexpr size_t blockBytes(size_t size)
+	{
+		return size < sizeof(void *) ? 8 : (size + 7) & ~(size_t)7;
+	}
+
+	BlockPool(size_t blockSize, uint16_t count, void *storage = NULL);
+
+	// NULL when all blocks are in use
+	void *alloc(void);
+	// ptr must come from this pool's alloc()
+	void free(void *ptr);
+	bool owns(const void *ptr) const;
+	// makes every block free again; no destructors are run
+	void reset(void);
+
+	size_t blockSize(void) const { return _blockSize; }
+	uint16_t capacity(void) const { return _count; }
+	uint16_t available(void) const { return _available; }
+
+private:
+	bool init(void);
+
+	uint8_t *_storage;
+	void *_freeList;
+	size_t _blockSize;
+	uint16_t _count;
+	uint16_t _available;
+};
+
+// N objects of type T in inline storage, built with placement new:
+//   static ObjectPool<Node, 16> nodes;
+//   Node *n = nodes.create(arg);  ...  nodes.destroy(n);
+template <typename T, uint16_t N>
+class ObjectPool
+{
+public:
+	ObjectPool() : _pool(sizeof(T), N, _storage) {}
+
+	// NULL when the pool is full
+	template <typename... Args>
+	T *create(Args&&... args)
+	{
+		void *p = _pool.alloc();
+		return p ? new (p) T(static_cast<Args&&>(args)...) : NULL;
+	}
+	void destroy(T *obj)
+	{
+		if (obj) {
+			obj->~T();
+			_pool.free(obj);
+		}
+	}
+	// drops every object at once without running destructors, for
+	// objects that own nothing outside the pool
+	void reset(void) { _pool.reset(); }
+
+	bool owns(const T *obj) const { return _pool.owns(obj); }
+	uint16_t available(void) const { return _pool.available(); }
+
+private:
+	alignas(8) uint8_t _storage[N * BlockPool::blockBytes(sizeof(T))];
+	BlockPool _pool;
+};
+
+// Base class giving T a class-level operator new that takes the first N
+// objects from a pool, malloc'd in one piece when the first is created,
+// and the rest from the heap:
+//   class Node : public PoolAllocated<Node, 8> { ... };
+template <typename T, uint16_t N>
+class PoolAllocated
+{
+public:
+	static void *operator new(size_t size)
+	{
+		void *p = size == sizeof(T) ? pool().alloc() : NULL;
+		return p ? p : ::operator new(size);
+	}
+	static void operator delete(void *ptr)
+	{
+		if (pool().owns(ptr))
+			pool().free(ptr);
+		else
+			::operator delete(ptr);
+	}
+	static BlockPool &pool(void)
+	{
+		static BlockPool blocks(sizeof(T), N);
+		return blocks;
+	}
+};
+
+#endif  // __cplusplus
+#endif  // BlockPool_h
@@ -26,11 +26,21 @@
 #include "Arduino.h"
 #include "portable.h"
 #include "CDCSerialClass.h"
+#include "RingBuffer.h"
 #include "wiring_constants.h"
 #include "wiring_digital.h"
 #include "variant.h"
 
-#define CDCACM_FIXED_DELAY     120
+/* When the tx ring is full, poll for free space every CDCACM_POLL_DELAY us.
+ * Without LMT flow control, give up after CDCACM_TX_TIMEOUT us without
+ * progress (host not reading) rather than blocking the sketch forever */
+#define CDCACM_POLL_DELAY      10
+#define CDCACM_TX_TIMEOUT      20000
+
+/* The shared rings are a power of two long, so indices wrap with a mask */
+#define SBS	CDCACM_BUFFER_SIZE
+#define SBS_MASK	(SBS - 1)
+static_assert((SBS & SBS_MASK) == 0, "CDCACM_BUFFER_SIZE must be a power of two");
 
 extern void CDCSerial_Handler(void);
 extern void serialEventRun1(void) __attribute__((weak));
@@ -41,6 +51,7 @@ extern void serialEvent1(void) __attribute__((weak));
 CDCSerialClass::CDCSerialClass(uart_init_info *info)
 {
     this->info = info;
+    this->_flow = NULL;
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
@@ -52,6 +63,11 @@ void CDCSerialClass::setSharedData(struct cdc_acm_shared_data *cdc_acm_shared_da
     this->_tx_buffer = cdc_acm_shared_data->tx_buffer;
 }
 
+void CDCSerialClass::setFlowControl(volatile struct cdc_acm_flow_control *flow)
+{
+    this->_flow = flow;
+}
+
 void CDCSerialClass::begin(const uint32_t dwBaudRate)
 {
     begin(dwBaudRate, (uint8_t)SERIAL_8N1 );
@@ -84,12 +100,15 @@ void CDCSerialClass::end( void )
 
 int CDCSerialClass::available( void )
 {
-#define SBS	CDCACM_BUFFER_SIZE
-
   if (!_shared_data->device_open)
     return (0);
   else
-    return (int)(SBS + _rx_buffer->head - _rx_buffer->tail) % SBS;
+    return (_rx_buffer->head - _rx_buffer->tail) & SBS_MASK;
+}
+
+bool CDCSerialClass::rxEvent(void)
+{
+    return _shared_data->device_open && _rx_buffer->head != _rx_buffer->tail;
 }
 
 int CDCSerialClass::availableForWrite(void)
@@ -97,12 +116,27 @@ int CDCSerialClass::availableForWrite(void)
     if (!_shared_data->device_open || !_shared_data->host_open)
         return(0);
 
-    int head = _tx_buffer->head;
-    int tail = _tx_buffer->tail;
+    return txSpace();
+}
+
+int CDCSerialClass::txSpace(void)
+{
+    volatile struct cdc_ring_buffer *tx = _tx_buffer;
+    int head = tx->head;
+    int tail = tx->tail;
+    int space = (head >= tail) ? CDCACM_BUFFER_SIZE - 1 - head + tail
+                               : tail - head - 1;
+
+    // If LMT reports what the host has accepted, never run further ahead
+    // of the host than the ring itself can hold
+    if (_flow && _flow->magic == CDCACM_FLOW_MAGIC) {
+        uint32_t in_flight = _flow->tx_queued - _flow->tx_credits;
+        int window = (in_flight < CDCACM_BUFFER_SIZE - 1) ?
+                     CDCACM_BUFFER_SIZE - 1 - (int)in_flight : 0;
+        space = min(space, window);
+    }
 
-    if (head >= tail)
-        return CDCACM_BUFFER_SIZE - head + tail - 1;
-    return tail - head - 1;
+    return space;
 }
 
 int CDCSerialClass::peek(void)
@@ -118,41 +152,152 @@ int CDCSerialClass::read( void )
   if ((!_shared_data->device_open) || ( _rx_buffer->head == _rx_buffer->tail ))
     return -1;
 
-  uint8_t uc = _rx_buffer->data[_rx_buffer->tail];
-  _rx_buffer->tail = (_rx_buffer->tail + 1) % CDCACM_BUFFER_SIZE;
+  int tail = _rx_buffer->tail;
+  uint8_t uc = _rx_buffer->data[tail];
+  RING_BUFFER_BARRIER();
+  _rx_buffer->tail = (tail + 1) & SBS_MASK;
   return uc;
 }
 
+size_t CDCSerialClass::read( uint8_t *buffer, size_t size )
+{
+  return readBuffered(buffer, size);
+}
+
+// The span ends at the head or at the end of the ring, whichever is first;
+// a wrapped transfer takes two peekSpan()/consume() rounds
+int CDCSerialClass::peekSpan( const uint8_t **data )
+{
+  int tail = _rx_buffer->tail;
+  int head = _rx_buffer->head;
+
+  RING_BUFFER_BARRIER();
+  *data = _rx_buffer->data + tail;
+  if (!_shared_data->device_open)
+    return 0;
+  if (head >= tail)
+    return head - tail;
+  return SBS - tail;
+}
+
+void CDCSerialClass::consume( int n )
+{
+  int avail = available();
+
+  if (n > avail)
+    n = avail;
+  RING_BUFFER_BARRIER();
+  _rx_buffer->tail = (_rx_buffer->tail + n) & SBS_MASK;
+}
+
+// Copy up to length bytes out of the shared rx ring in at most two spans,
+// stopping at terminator (consumed, not copied) unless it is negative
+size_t CDCSerialClass::rxCopy(uint8_t *buffer, size_t length, int terminator, bool &found)
+{
+  found = false;
+  if (!_shared_data->device_open)
+    return 0;
+
+  int tail = _rx_buffer->tail;
+  size_t n = (_rx_buffer->head - tail) & SBS_MASK;
+  size_t count = 0;
+
+  if (n > length)
+    n = length;
+  while (count < n) {
+    size_t span = min(n - count, (size_t)(SBS - tail));
+    const uint8_t *src = _rx_buffer->data + tail;
+    if (terminator >= 0) {
+      const uint8_t *p = (const uint8_t *)memchr(src, terminator, span);
+      if (p != NULL) {
+        span = p - src;
+        found = true;
+      }
+    }
+    memcpy(buffer + count, src, span);
+    count += span;
+    tail = (tail + span + (found ? 1 : 0)) & SBS_MASK;
+    if (found)
+      break;
+  }
+  RING_BUFFER_BARRIER();
+  _rx_buffer->tail = tail;
+  return count;
+}
+
+size_t CDCSerialClass::readBuffered(uint8_t *buffer, size_t length)
+{
+  bool found;
+  return rxCopy(buffer, length, -1, found);
+}
+
+size_t CDCSerialClass::readBufferedUntil(char terminator, uint8_t *buffer, size_t length, bool &found)
+{
+  return rxCopy(buffer, length, (uint8_t)terminator, found);
+}
+
 void CDCSerialClass::flush( void )
 {
     while (_tx_buffer->tail != _tx_buffer->head) { /* This infinite loop is intentional
 						      and requested by design */
 	    delayMicroseconds(1);
     }
+
+    // With flow control, also wait until the host has accepted everything
+    if (_flow && _flow->magic == CDCACM_FLOW_MAGIC) {
+        while (_shared_data->host_open && _flow->tx_credits != _flow->tx_queued)
+            delayMicroseconds(1);
+    }
 }
 
 size_t CDCSerialClass::write( const uint8_t uc_data )
 {
-    uint32_t retries = 2;
+    return write(&uc_data, 1);
+}
+
+size_t CDCSerialClass::write(const uint8_t *buffer, size_t size)
+{
+    volatile struct cdc_ring_buffer *tx = _tx_buffer;
+    uint32_t stalled = 0;
+    size_t sent = 0;
 
     if (!_shared_data->device_open || !_shared_data->host_open)
         return(0);
 
-    do {
-        int i = (uint32_t)(_tx_buffer->head + 1) % CDCACM_BUFFER_SIZE;
-        // if we should be storing the received character into the location
-        // just before the tail (meaning that the head would advance to the
-        // current location of the tail), we're about to overflow the buffer
-        // and so we don't write the character or advance the head.
-        if (i != _tx_buffer->tail) {
-            _tx_buffer->data[_tx_buffer->head] = uc_data;
-            _tx_buffer->head = i;
-
-	    // Just use a fixed delay to make it compatible with the CODK-M based firmware
-	    delayMicroseconds(CDCACM_FIXED_DELAY);
-            break;
+    while (sent < size) {
+        int space = txSpace();
+
+        if (space == 0) {
+            // Pace on ring occupancy / host credits: wait for the LMT to
+            // drain some data. With flow control we know the host is
+            // making progress, so only a host disconnect ends the wait
+            bool flow = _flow && _flow->magic == CDCACM_FLOW_MAGIC;
+            if (!_shared_data->host_open ||
+                (!flow && stalled >= CDCACM_TX_TIMEOUT / CDCACM_POLL_DELAY))
+                break;
+            stalled++;
+            delayMicroseconds(CDCACM_POLL_DELAY);
+            continue;
         }
-    } while (retries--);
+        stalled = 0;
+
+        int head = tx->head;
+        size_t n = min((size_t)space, size - sent);
+        size_t first = min(n, (size_t)(CDCACM_BUFFER_SIZE - head));
+
+        // Copy up to two contiguous spans, then publish them to the LMT
+        // with a single head update once the data is in place
+        memcpy((uint8_t *)&tx->data[head], buffer + sent, first);
+        if (n > first)
+            memcpy((uint8_t *)&tx->data[0], buffer + sent + first, n - first);
+
+        tx->head = (head + n) % CDCACM_BUFFER_SIZE;
+        // Without the magic, _flow points at whatever follows the shared
+        // block of an older LMT image: don't write there
+        if (_flow && _flow->magic == CDCACM_FLOW_MAGIC)
+            _flow->tx_queued += n;
+        sent += n;
+    }
 
-    return 1;
+    return sent;
 }
@@ -36,16 +36,29 @@ class CDCSerialClass : public HardwareSerial
     CDCSerialClass(uart_init_info *info);
 
     void setSharedData(struct cdc_acm_shared_data *cdc_acm_shared_data);
+    void setFlowControl(volatile struct cdc_acm_flow_control *flow);
 
     void begin(const uint32_t dwBaudRate);
     void begin(const uint32_t dwBaudRate, const uint8_t config);
     void end(void);
     int available(void);
+    // True while received data is unread. LMT fills the rx ring through
+    // shared memory without interrupting this core, so serialEventRun()
+    // compares the ring indexes instead of waiting on an interrupt
+    bool rxEvent(void);
     int availableForWrite(void);
     int peek(void);
     int read(void);
+    // Non-blocking bulk read of whatever is buffered, up to size bytes
+    size_t read(uint8_t *buffer, size_t size);
+    // Zero-copy receive straight from the shared rx ring: points data at
+    // the oldest byte and returns how many are contiguous from there.
+    // Release them with consume(), which hands the space back to LMT
+    int peekSpan(const uint8_t **data);
+    void consume(int n);
     void flush(void);
     size_t write(const uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
     using Print::write; // pull in write(str) and write(buf, size) from Print
 
     operator bool() {
@@ -57,10 +70,15 @@ class CDCSerialClass : public HardwareSerial
 
   protected:
     void init(const uint32_t dwBaudRate, const uint8_t config);
+    int txSpace(void);
+    size_t readBuffered(uint8_t *buffer, size_t length);
+    size_t readBufferedUntil(char terminator, uint8_t *buffer, size_t length, bool &found);
+    size_t rxCopy(uint8_t *buffer, size_t length, int terminator, bool &found);
 
     struct cdc_acm_shared_data *_shared_data;
     struct cdc_ring_buffer *_rx_buffer;
     struct cdc_ring_buffer *_tx_buffer;
+    volatile struct cdc_acm_flow_control *_flow;
 
     uart_init_info *info;
     uint32_t _writeDelayUsec;
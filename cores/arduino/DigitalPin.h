@@ -0,0 +1,107 @@
+/*
+  DigitalPin.h - GPIO access for pin numbers known at compile time
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _DIGITAL_PIN_
+#define _DIGITAL_PIN_
+
+#ifdef __cplusplus
+
+#include "variant.h"
+#include "portable.h"
+
+// Columns of the variant pin table for constant expressions
+#define DIGITAL_PIN_GPIO_ID(id, port, type, base, ...)    id,
+#define DIGITAL_PIN_GPIO_TYPE(id, port, type, base, ...)  type,
+#define DIGITAL_PIN_GPIO_BASE(id, port, type, base, ...)  base,
+
+static constexpr uint32_t digitalPinGPIOId[] = { VARIANT_PIN_TABLE(DIGITAL_PIN_GPIO_ID) };
+static constexpr uint32_t digitalPinGPIOType[] = { VARIANT_PIN_TABLE(DIGITAL_PIN_GPIO_TYPE) };
+static constexpr uint32_t digitalPinGPIOBase[] = { VARIANT_PIN_TABLE(DIGITAL_PIN_GPIO_BASE) };
+
+/*
+ * DigitalPin<13>::high() and friends: the controller, register and bit come
+ * out of the pin table at compile time, so each call is the bare register
+ * read-modify-write under an interrupt lock. Like the FastPin calls these
+ * leave the pull-up register alone; use mode() or pinMode() first.
+ */
+template <uint8_t pin>
+class DigitalPin
+{
+    static_assert(pin < NUM_DIGITAL_PINS, "DigitalPin: no such pin");
+    static_assert(digitalPinGPIOType[pin] == SS_GPIO ||
+                  digitalPinGPIOType[pin] == SOC_GPIO, "DigitalPin: not a GPIO");
+
+    static constexpr bool aux = digitalPinGPIOType[pin] == SS_GPIO;
+    static constexpr uint32_t mask = 1UL << digitalPinGPIOId[pin];
+    static constexpr uint32_t out = digitalPinGPIOBase[pin] +
+        (aux ? SS_GPIO_SWPORTA_DR : SOC_GPIO_SWPORTA_DR);
+    static constexpr uint32_t in = digitalPinGPIOBase[pin] +
+        (aux ? SS_GPIO_EXT_PORTA : SOC_GPIO_EXT_PORTA);
+
+  public:
+    static void mode(uint8_t m) { pinMode(pin, m); }
+
+    static inline void high(void)
+    {
+        uint32_t saved = interrupt_lock();
+        if (aux)
+            WRITE_ARC_REG(READ_ARC_REG(out) | mask, out);
+        else
+            MMIO_REG_VAL(out) |= mask;
+        interrupt_unlock(saved);
+    }
+
+    static inline void low(void)
+    {
+        uint32_t saved = interrupt_lock();
+        if (aux)
+            WRITE_ARC_REG(READ_ARC_REG(out) & ~mask, out);
+        else
+            MMIO_REG_VAL(out) &= ~mask;
+        interrupt_unlock(saved);
+    }
+
+    static inline void toggle(void)
+    {
+        uint32_t saved = interrupt_lock();
+        if (aux)
+            WRITE_ARC_REG(READ_ARC_REG(out) ^ mask, out);
+        else
+            MMIO_REG_VAL(out) ^= mask;
+        interrupt_unlock(saved);
+    }
+
+    static inline void write(uint8_t val)
+    {
+        if (val)
+            high();
+        else
+            low();
+    }
+
+    static inline int read(void)
+    {
+        uint32_t v = aux ? READ_ARC_REG(in) : MMIO_REG_VAL(in);
+        return (v & mask) ? HIGH : LOW;
+    }
+};
+
+#endif // __cplusplus
+
+#endif /* _DIGITAL_PIN_ */
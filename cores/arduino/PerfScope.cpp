@@ -0,0 +1,64 @@
+/*
+  PerfScope.cpp - cycle count statistics for named code regions
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "PerfScope.h"
+
+static PerfRegion *perfRegions = NULL;
+
+void PerfRegion::record(uint32_t elapsed)
+{
+	uint32_t saved = interrupt_lock();
+	if (count == 0) {
+		if (!linked) {
+			next = perfRegions;
+			perfRegions = this;
+			linked = true;
+		}
+		min = max = elapsed;
+	} else {
+		if (elapsed < min) min = elapsed;
+		if (elapsed > max) max = elapsed;
+	}
+	count++;
+	total += elapsed;
+	interrupt_unlock(saved);
+}
+
+void perfPrint(Print &out)
+{
+	for (PerfRegion *r = perfRegions; r != NULL; r = r->next) {
+		if (r->count == 0)
+			continue;
+		out.printf("%s: %lu calls, min %lu avg %lu max %lu ns\r\n", r->name,
+			(unsigned long)r->count,
+			(unsigned long)cyclesToNanos(r->min),
+			(unsigned long)cyclesToNanos(r->total / r->count),
+			(unsigned long)cyclesToNanos(r->max));
+	}
+}
+
+void perfReset(void)
+{
+	uint32_t saved = interrupt_lock();
+	for (PerfRegion *r = perfRegions; r != NULL; r = r->next) {
+		r->count = 0;
+		r->total = 0;
+	}
+	interrupt_unlock(saved);
+}
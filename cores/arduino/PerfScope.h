@@ -0,0 +1,68 @@
+/*
+  PerfScope.h - cycle count statistics for named code regions
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PerfScope_h
+#define PerfScope_h
+#ifdef __cplusplus
+
+#include "Arduino.h"
+#include "Print.h"
+
+// Statistics for one region. Regions are static, so they need no
+// constructor; each links itself into the list perfPrint() walks the first
+// time it records a sample.
+struct PerfRegion
+{
+	const char *name;
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	PerfRegion *next;
+	bool linked;
+
+	void record(uint32_t elapsed);
+};
+
+// Times its own lifetime in cycles() and adds it to a region:
+//   void loop() { PERF_SCOPE("loop"); ... }
+class PerfScope
+{
+public:
+	PerfScope(PerfRegion &region) : _region(region), _start(cycles()) {}
+	~PerfScope() { _region.record(cycles() - _start); }
+
+private:
+	PerfRegion &_region;
+	uint32_t _start;
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define PERF_SCOPE(name) \
+	static PerfRegion PERF_CONCAT(_perfRegion, __LINE__) = { name, 0, 0, 0, 0, NULL, false }; \
+	PerfScope PERF_CONCAT(_perfScope, __LINE__)(PERF_CONCAT(_perfRegion, __LINE__))
+
+// one line per region: name, count, min/avg/max in ns
+void perfPrint(Print &out);
+// zeroes every region's statistics
+void perfReset(void);
+
+#endif  // __cplusplus
+#endif  // PerfScope_h
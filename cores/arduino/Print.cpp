@@ -46,11 +46,12 @@ size_t Print::print(const __FlashStringHelper *ifsh)
 
 size_t Print::print(const String &s)
 {
-  size_t n = 0;
-  for (uint16_t i = 0; i < s.length(); i++) {
-    n += write(s[i]);
-  }
-  return n;
+  return write(s.c_str(), s.length());
+}
+
+size_t Print::print(StringView s)
+{
+  return write(s.data(), s.length());
 }
 
 size_t Print::print(const char str[])
@@ -80,34 +81,12 @@ size_t Print::print(unsigned int n, int base)
 
 size_t Print::print(long n, int base)
 {
-  if (base == 0) {
-    return write(n);
-  } else if (base == DEC) {
-    if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printNumber(n, DEC) + t;
-    }
-    return printNumber(n, DEC);
-  } else {
-    return printNumber(n, base);
-  }
+  return printSigned(n, base, false);
 }
 
 size_t Print::print(long long n, int base)
 {
-  if (base == 0) {
-    return write(n);
-  } else if (base == DEC) {
-    if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printLongLong(n, DEC) + t;
-    }
-    return printLongLong(n, DEC);
-  } else {
-    return printLongLong(n, base);
-  }
+  return printSignedLongLong(n, base, false);
 }
 
 size_t Print::print(unsigned long n, int base)
@@ -141,9 +120,7 @@ size_t Print::print(const Printable& x)
 
 size_t Print::println(void)
 {
-  size_t n = print('\r');
-  n += print('\n');
-  return n;
+  return write("\r\n", 2);
 }
 
 size_t Print::println(const String &s)
@@ -153,74 +130,66 @@ size_t Print::println(const String &s)
   return n;
 }
 
-size_t Print::println(const char c[])
+size_t Print::println(StringView s)
 {
-  size_t n = print(c);
+  size_t n = print(s);
   n += println();
   return n;
 }
 
-size_t Print::println(char c)
+size_t Print::println(const char c[])
 {
   size_t n = print(c);
   n += println();
   return n;
 }
 
+size_t Print::println(char c)
+{
+  char buf[3] = { c, '\r', '\n' };
+  return write(buf, sizeof(buf));
+}
+
 size_t Print::println(unsigned char b, int base)
 {
-  size_t n = print(b, base);
-  n += println();
-  return n;
+  return println((unsigned long) b, base);
 }
 
 size_t Print::println(int num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return println((long) num, base);
 }
 
 size_t Print::println(unsigned int num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return println((unsigned long) num, base);
 }
 
 size_t Print::println(long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printSigned(num, base, true);
 }
 
 size_t Print::println(long long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printSignedLongLong(num, base, true);
 }
 
 size_t Print::println(unsigned long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  if (base == 0) return write(num) + println();
+  else return printNumber(num, base, false, true);
 }
 
 size_t Print::println(unsigned long long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  if (base == 0) return write(num) + println();
+  else return printLongLong(num, base, false, true);
 }
 
 size_t Print::println(double num, int digits)
 {
-  size_t n = print(num, digits);
-  n += println();
-  return n;
+  return printFloat(num, digits, true);
 }
 
 size_t Print::println(const Printable& x)
@@ -230,66 +199,145 @@ size_t Print::println(const Printable& x)
   return n;
 }
 
+size_t Print::printf(const char *format, ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  size_t n = vprintf(format, ap);
+  va_end(ap);
+  return n;
+}
+
+size_t Print::vprintf(const char *format, va_list ap)
+{
+  char buf[PRINTF_BUFFER_SIZE];
+  va_list copy;
+
+  va_copy(copy, ap);
+  int len = vsnprintf(buf, sizeof(buf), format, copy);
+  va_end(copy);
+  if (len < 0)
+    return 0;
+  if ((size_t)len < sizeof(buf))
+    return write(buf, len);
+
+  // too long for the stack buffer, format again on the heap
+  char *str = (char *)malloc(len + 1);
+  if (str == NULL)
+    return write(buf, sizeof(buf) - 1);
+  vsnprintf(str, len + 1, format, ap);
+  size_t n = write(str, len);
+  free(str);
+  return n;
+}
+
 // Private Methods /////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base) {
-  char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
+size_t Print::printSigned(long n, int base, bool eol)
+{
+  if (base == 0) {
+    size_t t = write(n);
+    return eol ? t + println() : t;
+  } else if (base == DEC && n < 0) {
+    return printNumber(0UL - (unsigned long)n, DEC, true, eol);
+  } else {
+    return printNumber(n, base, false, eol);
+  }
+}
 
-  *str = '\0';
+size_t Print::printSignedLongLong(long long n, int base, bool eol)
+{
+  if (base == 0) {
+    size_t t = write(n);
+    return eol ? t + println() : t;
+  } else if (base == DEC && n < 0) {
+    return printLongLong(0ULL - (unsigned long long)n, DEC, true, eol);
+  } else {
+    return printLongLong(n, base, false, eol);
+  }
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative, bool eol) {
+  char buf[8 * sizeof(long) + 4]; // Assumes 8-bit chars plus sign and "\r\n".
+  char *end = &buf[sizeof(buf)];
+  char *str;
+
+  if (eol) {
+    *--end = '\n';
+    *--end = '\r';
+  }
+  str = end;
 
+  // the supported bases other than DEC are powers of two: shift, don't divide
+  uint8_t shift;
   switch(base) {
-    case BIN:
-    case OCT:
-    case DEC:
-    case HEX:
-	  break;
-    default:
-	  base = DEC;
+    case BIN: shift = 1; break;
+    case OCT: shift = 3; break;
+    case HEX: shift = 4; break;
+    default:  shift = 0; break;
   }
 
-  do {
-    unsigned long m = n;
-    n /= base;
-    char c = m - base * n;
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+  if (shift == 0) {
+    str = ultoa10(n, str);
+  } else {
+    do {
+      char c = n & (base - 1);
+      n >>= shift;
+      *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while(n);
+  }
 
-  return write(str);
+  if (negative)
+    *--str = '-';
+  return write(str, &buf[sizeof(buf)] - str);
 }
 
 
-size_t Print::printLongLong(unsigned long long n, uint8_t base) {
-  char buf[8 * sizeof(long long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
+size_t Print::printLongLong(unsigned long long n, uint8_t base, bool negative, bool eol) {
+  char buf[8 * sizeof(long long) + 4]; // Assumes 8-bit chars plus sign and "\r\n".
+  char *end = &buf[sizeof(buf)];
+  char *str;
 
-  *str = '\0';
+  if (eol) {
+    *--end = '\n';
+    *--end = '\r';
+  }
+  str = end;
 
+  // the supported bases other than DEC are powers of two: shift, don't divide
+  uint8_t shift;
   switch(base) {
-    case BIN:
-    case OCT:
-    case DEC:
-    case HEX:
-	  break;
-    default:
-	  base = DEC;
+    case BIN: shift = 1; break;
+    case OCT: shift = 3; break;
+    case HEX: shift = 4; break;
+    default:  shift = 0; break;
   }
 
-  do {
-    unsigned long long m = n;
-    n /= base;
-    char c = m - base * n;
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+  if (shift == 0) {
+    str = ulltoa10(n, str);
+  } else {
+    do {
+      char c = n & (base - 1);
+      n >>= shift;
+      *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while(n);
+  }
 
-  return write(str);
+  if (negative)
+    *--str = '-';
+  return write(str, &buf[sizeof(buf)] - str);
 }
 
 
-size_t Print::printFloat(double number, uint8_t digits)
+size_t Print::printFloat(double number, uint8_t digits, bool eol)
 {
-  char str[50];
+  char str[52];
 
   dtostrf(number, 0, digits, str);
-  return(print(str));
+  size_t len = strlen(str);
+  if (eol) {
+    str[len++] = '\r';
+    str[len++] = '\n';
+  }
+  return write(str, len);
 }
@@ -22,8 +22,10 @@
 
 #include <inttypes.h>
 #include <stdio.h> // for size_t
+#include <stdarg.h>
 
 #include "WString.h"
+#include "StringView.h"
 #include "Printable.h"
 
 #define DEC 10
@@ -31,13 +33,23 @@
 #define OCT 8
 #define BIN 2
 
+// printf() formats into a stack buffer of this size, falling back to the
+// heap for longer output
+#ifndef PRINTF_BUFFER_SIZE
+#define PRINTF_BUFFER_SIZE 64
+#endif
+
 class Print
 {
   private:
     int write_error;
-    size_t printNumber(unsigned long, uint8_t);
-    size_t printLongLong(unsigned long long, uint8_t);
-    size_t printFloat(double, uint8_t);
+    // the formatting helpers build the sign, digits and optional line
+    // ending in one buffer so each value costs a single write()
+    size_t printSigned(long, int, bool);
+    size_t printSignedLongLong(long long, int, bool);
+    size_t printNumber(unsigned long, uint8_t, bool = false, bool = false);
+    size_t printLongLong(unsigned long long, uint8_t, bool = false, bool = false);
+    size_t printFloat(double, uint8_t, bool = false);
   protected:
     void setWriteError(int err = 1) { write_error = err; }
   public:
@@ -56,8 +68,13 @@ class Print
       return write((const uint8_t *)buffer, size);
     }
 
+    // bytes write() takes now without waiting, or -1 when the port can't
+    // tell, in which case write() may wait
+    virtual int availableForWrite() { return -1; }
+
     size_t print(const __FlashStringHelper *);
     size_t print(const String &);
+    size_t print(StringView);
     size_t print(const char[]);
     size_t print(char);
     size_t print(unsigned char, int = DEC);
@@ -72,6 +89,7 @@ class Print
 
     size_t println(const __FlashStringHelper *);
     size_t println(const String &s);
+    size_t println(StringView s);
     size_t println(const char[]);
     size_t println(char);
     size_t println(unsigned char, int = DEC);
@@ -84,6 +102,9 @@ class Print
     size_t println(double, int = BIN);
     size_t println(const Printable&);
     size_t println(void);
+
+    size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+    size_t vprintf(const char *format, va_list ap);
 };
 
 #endif
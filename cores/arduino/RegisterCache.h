@@ -0,0 +1,187 @@
+/*
+  RegisterCache.h - write-through register map cache for sensor drivers
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RegisterCache_h
+#define RegisterCache_h
+#ifdef __cplusplus
+
+#include <stdint.h>
+
+// Keeps a copy of the device registers First .. First + Count - 1, so that
+// reads of configuration registers and read-modify-writes of their bit
+// fields don't go out on the bus, and writes of an unchanged value are
+// dropped. Registers outside the range, and ones marked with setVolatile()
+// (status, data, self-clearing command and device-updated registers), always
+// go to the device. Between beginBatch() and endBatch() writes are held back
+// and sent as one burst per run of consecutive registers; any uncached access
+// sends them first, so the device sees the writes in register order but never
+// after a later uncached access.
+//
+// The driver derives from it and implements busRead() and busWrite(), each an
+// auto-incrementing burst starting at reg.
+template <uint8_t First, uint8_t Count>
+class RegisterCache
+{
+	static_assert(Count > 0 && First + Count <= 256, "RegisterCache: bad range");
+
+public:
+	RegisterCache() : _batch(0)
+	{
+		for (unsigned i = 0; i < Words; i++)
+			_valid[i] = _dirty[i] = _volatile[i] = 0;
+	}
+
+	uint8_t read(uint8_t reg)
+	{
+		if (cacheable(reg) && test(_valid, reg - First))
+			return _val[reg - First];
+
+		uint8_t data;
+		flush();
+		busRead(reg, &data, 1);
+		if (cacheable(reg)) {
+			_val[reg - First] = data;
+			set(_valid, reg - First);
+		}
+		return data;
+	}
+
+	void write(uint8_t reg, uint8_t data)
+	{
+		if (!cacheable(reg)) {
+			flush();
+			busWrite(reg, &data, 1);
+			return;
+		}
+
+		unsigned i = reg - First;
+		if (test(_valid, i) && _val[i] == data)
+			return;
+		_val[i] = data;
+		set(_valid, i);
+		if (_batch)
+			set(_dirty, i);
+		else
+			busWrite(reg, &data, 1);
+	}
+
+	uint8_t readBits(uint8_t reg, unsigned pos, unsigned len)
+	{
+		return (read(reg) >> pos) & ((1 << len) - 1);
+	}
+
+	void writeBits(uint8_t reg, uint8_t data, unsigned pos, unsigned len)
+	{
+		uint8_t mask = ((1 << len) - 1) << pos;
+		write(reg, (read(reg) & ~mask) | ((data << pos) & mask));
+	}
+
+	// the device changes reg by itself, or writing it has side effects
+	void setVolatile(uint8_t reg)
+	{
+		if (inRange(reg)) {
+			set(_volatile, reg - First);
+			clear(_valid, reg - First);
+		}
+	}
+
+	// forget the cached copies, e.g. after the device has been reset;
+	// writes still held by a batch are dropped
+	void invalidate(void)
+	{
+		for (unsigned i = 0; i < Words; i++)
+			_valid[i] = _dirty[i] = 0;
+	}
+
+	void invalidate(uint8_t reg)
+	{
+		if (inRange(reg)) {
+			clear(_valid, reg - First);
+			clear(_dirty, reg - First);
+		}
+	}
+
+	// fills the whole cache with one burst read
+	void prefetch(void)
+	{
+		uint8_t data[Count];
+
+		flush();
+		busRead(First, data, Count);
+		for (unsigned i = 0; i < Count; i++) {
+			if (!test(_volatile, i)) {
+				_val[i] = data[i];
+				set(_valid, i);
+			}
+		}
+	}
+
+	// batches nest; the outermost endBatch() sends the writes
+	void beginBatch(void) { _batch++; }
+	void endBatch(void)
+	{
+		if (_batch && --_batch == 0)
+			flush();
+	}
+
+	void flush(void)
+	{
+		unsigned i = 0;
+
+		while (i < Count) {
+			if (!test(_dirty, i)) {
+				i++;
+				continue;
+			}
+			unsigned start = i;
+			while (i < Count && test(_dirty, i))
+				clear(_dirty, i++);
+			busWrite(First + start, &_val[start], i - start);
+		}
+	}
+
+protected:
+	virtual void busRead(uint8_t reg, uint8_t *data, unsigned len) = 0;
+	virtual void busWrite(uint8_t reg, const uint8_t *data, unsigned len) = 0;
+
+private:
+	static const unsigned Words = (Count + 31) / 32;
+
+	static bool inRange(uint8_t reg)
+	{
+		return reg >= First && reg - First < Count;
+	}
+	bool cacheable(uint8_t reg) const
+	{
+		return inRange(reg) && !test(_volatile, reg - First);
+	}
+
+	static bool test(const uint32_t *map, unsigned i) { return map[i >> 5] & (1UL << (i & 31)); }
+	static void set(uint32_t *map, unsigned i) { map[i >> 5] |= 1UL << (i & 31); }
+	static void clear(uint32_t *map, unsigned i) { map[i >> 5] &= ~(1UL << (i & 31)); }
+
+	uint8_t _val[Count];
+	uint32_t _valid[Words];
+	uint32_t _dirty[Words];
+	uint32_t _volatile[Words];
+	uint8_t _batch;
+};
+
+#endif  // __cplusplus
+#endif  // RegisterCache_h
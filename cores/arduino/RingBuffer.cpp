@@ -19,19 +19,60 @@
 */
 
 #include "RingBuffer.h"
+#include <stdlib.h>
 #include <string.h>
 
 RingBuffer::RingBuffer( void )
 {
-    _aucBuffer = (uint8_t*)dccm_malloc(UART_BUFFER_SIZE);
-    memset( _aucBuffer, 0, UART_BUFFER_SIZE ) ;
+    allocate(UART_BUFFER_SIZE);
+}
+
+RingBuffer::RingBuffer( uint16_t size )
+{
+    allocate(size);
+}
+
+RingBuffer::RingBuffer( uint8_t *buffer, int size )
+{
+    _aucBuffer = NULL;
+    setBuffer(buffer, size);
+}
+
+void RingBuffer::allocate( uint16_t size )
+{
+    int n = 2;
+
+    while (n < size && n < 0x8000)
+        n <<= 1;
+
+    _aucBuffer = (uint8_t*)dccm_malloc(n);
+    if (_aucBuffer == NULL)
+        _aucBuffer = (uint8_t*)malloc(n);
+    if (_aucBuffer)
+        memset( _aucBuffer, 0, n ) ;
+    _iMask = n - 1;
+    _iHead=0 ;
+    _iTail=0 ;
+    _buffer_overflow = false;
+}
+
+void RingBuffer::setBuffer( uint8_t *buffer, int size )
+{
+    int n = 2;
+
+    while ((n << 1) <= size)
+        n <<= 1;
+
+    _aucBuffer = buffer;
+    _iMask = n - 1;
     _iHead=0 ;
     _iTail=0 ;
+    _buffer_overflow = false;
 }
 
 void RingBuffer::store_char( uint8_t c )
 {
-  int i = (uint32_t)(_iHead + 1) % UART_BUFFER_SIZE ;
+  int i = (_iHead + 1) & _iMask ;
 
   // if we should be storing the received character into the location
   // just before the tail (meaning that the head would advance to the
@@ -40,6 +81,7 @@ void RingBuffer::store_char( uint8_t c )
   if ( i != _iTail )
   {
     _aucBuffer[_iHead] = c ;
+    RING_BUFFER_BARRIER();
     _iHead = i ;
     _buffer_overflow = false;
   }
@@ -49,3 +91,105 @@ void RingBuffer::store_char( uint8_t c )
   }
 }
 
+int RingBuffer::peek_char( void )
+{
+  if ( _iHead == _iTail )
+    return -1;
+
+  RING_BUFFER_BARRIER();
+  return _aucBuffer[_iTail];
+}
+
+int RingBuffer::read_char( void )
+{
+  int tail = _iTail;
+
+  // if the head isn't ahead of the tail, we don't have any characters
+  if ( _iHead == tail )
+    return -1;
+
+  RING_BUFFER_BARRIER();
+  uint8_t c = _aucBuffer[tail];
+  RING_BUFFER_BARRIER();
+  _iTail = (tail + 1) & _iMask;
+  return c;
+}
+
+size_t RingBuffer::readBytes( uint8_t *buffer, size_t length )
+{
+  int tail = _iTail;
+  size_t n = (_iHead - tail) & _iMask;
+
+  if (n > length)
+    n = length;
+  if (n == 0)
+    return 0;
+
+  RING_BUFFER_BARRIER();
+  // at most two contiguous spans: up to the end of storage, then from 0
+  size_t first = size() - tail;
+  if (first > n)
+    first = n;
+  memcpy(buffer, _aucBuffer + tail, first);
+  memcpy(buffer + first, _aucBuffer, n - first);
+  RING_BUFFER_BARRIER();
+  _iTail = (tail + n) & _iMask;
+  return n;
+}
+
+size_t RingBuffer::readBytesUntil( uint8_t terminator, uint8_t *buffer, size_t length, bool &found )
+{
+  int tail = _iTail;
+  size_t n = (_iHead - tail) & _iMask;
+
+  found = false;
+  if (n > length)
+    n = length;
+  if (n == 0)
+    return 0;
+
+  RING_BUFFER_BARRIER();
+  // search each contiguous span in turn and cut n short at the terminator
+  size_t first = size() - tail;
+  if (first > n)
+    first = n;
+  const uint8_t *p = (const uint8_t *)memchr(_aucBuffer + tail, terminator, first);
+  if (p != NULL) {
+    n = p - (_aucBuffer + tail);
+    found = true;
+    first = n;
+  } else if (n > first) {
+    p = (const uint8_t *)memchr(_aucBuffer, terminator, n - first);
+    if (p != NULL) {
+      n = first + (p - _aucBuffer);
+      found = true;
+    }
+  }
+  memcpy(buffer, _aucBuffer + tail, first);
+  memcpy(buffer + first, _aucBuffer, n - first);
+  RING_BUFFER_BARRIER();
+  _iTail = (tail + n + (found ? 1 : 0)) & _iMask;
+  return n;
+}
+
+int RingBuffer::peekSpan( const uint8_t **data )
+{
+  int head = _iHead;
+  int tail = _iTail;
+
+  RING_BUFFER_BARRIER();
+  *data = _aucBuffer + tail;
+  if (head >= tail)
+    return head - tail;
+  return size() - tail;
+}
+
+void RingBuffer::consume( int n )
+{
+  int avail = available();
+
+  if (n > avail)
+    n = avail;
+  RING_BUFFER_BARRIER();
+  _iTail = (_iTail + n) & _iMask;
+}
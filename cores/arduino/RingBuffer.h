@@ -18,14 +18,25 @@
 #define _RING_BUFFER_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "dccm/dccm_alloc.h"
 
 // Define constants and variables for buffering incoming serial data.  We're
 // using a ring buffer (I think), in which head is the index of the location
 // to which to write the next incoming character and tail is the index of the
 // location from which to read.
+// The buffer size is always a power of two, so indices wrap with a mask.
+//
+// The ring is single-producer/single-consumer and lock-free: only the
+// producer (store_char, usually an ISR) writes _iHead and only the consumer
+// (read_char, readBytes, consume) writes _iTail. Each side accesses the data
+// first and then publishes its index, with a compiler barrier in between so
+// the data accesses cannot be moved past the index update. ARC EM is a
+// single in-order core, so no hardware fence is needed.
 #define UART_BUFFER_SIZE 64
 
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
 class RingBuffer
 {
 public:
@@ -33,10 +44,37 @@ public:
 	volatile int _iHead ;
 	volatile int _iTail ;
 	volatile bool _buffer_overflow ;
+	int _iMask ;
 
 	RingBuffer( void ) ;
+	// size is rounded up to a power of two and allocated from DCCM,
+	// falling back to the heap if DCCM is exhausted
+	RingBuffer( uint16_t size ) ;
+	// caller-supplied storage, size is rounded down to a power of two
+	RingBuffer( uint8_t *buffer, int size ) ;
+	void setBuffer( uint8_t *buffer, int size ) ;
+	int size() { return _iMask + 1; }
+	int available() { return (_iHead - _iTail) & _iMask; }
+	void clear() { _iHead = _iTail = 0; }
 	void store_char( uint8_t c ) ;
+
+	// Consumer side
+	int peek_char() ;
+	int read_char() ;
+	// copy up to length bytes out of the ring, returns the number copied
+	size_t readBytes( uint8_t *buffer, size_t length ) ;
+	// as readBytes but stops at terminator, which is consumed but not
+	// copied, and sets found
+	size_t readBytesUntil( uint8_t terminator, uint8_t *buffer, size_t length, bool &found ) ;
+	// zero-copy access: points data at the oldest byte and returns how many
+	// bytes are contiguous from there; release them with consume()
+	int peekSpan( const uint8_t **data ) ;
+	void consume( int n ) ;
+
 	bool overflow() { bool ret = _buffer_overflow; _buffer_overflow = false; return ret; }
+
+private:
+	void allocate( uint16_t size ) ;
 } ;
 
 #endif
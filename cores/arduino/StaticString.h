@@ -0,0 +1,101 @@
+/*
+  StaticString.h - fixed capacity string that never touches the heap
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef StaticString_h
+#define StaticString_h
+#ifdef __cplusplus
+
+#include "StringView.h"
+#include "Stream.h"
+#include "stdlib_noniso.h"
+
+// Holds up to N characters plus a terminator inline. Appends that don't fit
+// are truncated and reported by returning false. Converts to StringView, so
+// it can be printed and compared with String, StringView and "strings".
+template <size_t N>
+class StaticString
+{
+public:
+	StaticString() : _len(0) { _buf[0] = 0; }
+	StaticString(const char *cstr) : _len(0) { _buf[0] = 0; append(cstr); }
+	StaticString(StringView s) : _len(0) { _buf[0] = 0; append(s); }
+
+	const char *c_str(void) const { return _buf; }
+	size_t length(void) const { return _len; }
+	static size_t capacity(void) { return N; }
+	void clear(void) { setLength(0); }
+
+	// direct access for functions that fill a char buffer: write up to
+	// capacity() characters into buffer(), then setLength()
+	char *buffer(void) { return _buf; }
+	void setLength(size_t length)
+	{
+		_len = length < N ? length : N;
+		_buf[_len] = 0;
+	}
+
+	bool append(const char *data, size_t length)
+	{
+		bool fits = length <= N - _len;
+		if (!fits) length = N - _len;
+		memcpy(_buf + _len, data, length);
+		setLength(_len + length);
+		return fits;
+	}
+	bool append(StringView s) { return append(s.data(), s.length()); }
+	bool append(const char *cstr) { return append(StringView(cstr)); }
+	bool append(char c) { return append(&c, 1); }
+	bool append(int num) { return append((long)num); }
+	bool append(unsigned int num) { return append((unsigned long)num); }
+	bool append(long num)
+	{
+		char tmp[2 + 3 * sizeof(long)];
+		return append(ltoa(num, tmp, 10));
+	}
+	bool append(unsigned long num)
+	{
+		char tmp[1 + 3 * sizeof(unsigned long)];
+		return append(ultoa(num, tmp, 10));
+	}
+
+	StaticString & operator = (StringView s) { clear(); append(s); return *this; }
+	StaticString & operator = (const char *cstr) { clear(); append(cstr); return *this; }
+	template <typename T>
+	StaticString & operator += (T value) { append(value); return *this; }
+
+	operator StringView() const { return StringView(_buf, _len); }
+	bool operator == (StringView s) const { return StringView(*this).equals(s); }
+	bool operator != (StringView s) const { return !StringView(*this).equals(s); }
+	char operator [] (size_t index) const { return index < _len ? _buf[index] : 0; }
+
+	// replaces the contents with Stream::readBytesUntil(terminator) and
+	// returns the number of characters read
+	size_t readFrom(Stream &stream, char terminator)
+	{
+		setLength(stream.readBytesUntil(terminator, _buf, N));
+		return _len;
+	}
+
+private:
+	char _buf[N + 1];
+	size_t _len;
+};
+
+#endif  // __cplusplus
+#endif  // StaticString_h
@@ -29,9 +29,11 @@
 #define NO_SKIP_CHAR  1  // a magic char not found in a valid ASCII numeric field
 
 // private method to read stream with timeout
+// the clock is only read once nothing is buffered
 int Stream::timedRead()
 {
-  int c;
+  int c = read();
+  if (c >= 0) return c;
   _startMillis = millis();
   do {
     c = read();
@@ -43,7 +45,8 @@ int Stream::timedRead()
 // private method to peek stream with timeout
 int Stream::timedPeek()
 {
-  int c;
+  int c = peek();
+  if (c >= 0) return c;
   _startMillis = millis();
   do {
     c = peek();
@@ -52,6 +55,45 @@ int Stream::timedPeek()
   return -1;     // -1 indicates timeout
 }
 
+// starts the timeout on the first call after data stopped arriving,
+// returns true once it has expired
+bool Stream::waitTimedOut(bool &waiting)
+{
+  if (!waiting) {
+    waiting = true;
+    _startMillis = millis();
+    return false;
+  }
+  return millis() - _startMillis >= _timeout;
+}
+
+size_t Stream::readBuffered(uint8_t *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length && available() > 0) {
+    int c = read();
+    if (c < 0) break;
+    buffer[count++] = (uint8_t)c;
+  }
+  return count;
+}
+
+size_t Stream::readBufferedUntil(char terminator, uint8_t *buffer, size_t length, bool &found)
+{
+  size_t count = 0;
+  found = false;
+  while (count < length && available() > 0) {
+    int c = read();
+    if (c < 0) break;
+    if (c == (uint8_t)terminator) {
+      found = true;
+      break;
+    }
+    buffer[count++] = (uint8_t)c;
+  }
+  return count;
+}
+
 // returns peek of the next digit in the stream or -1 if timeout
 // discards non-numeric characters
 int Stream::peekNextDigit()
@@ -200,11 +242,15 @@ float Stream::parseFloat(char skipChar){
 size_t Stream::readBytes(char *buffer, size_t length)
 {
   size_t count = 0;
+  bool waiting = false;
   while (count < length) {
-    int c = timedRead();
-    if (c < 0) break;
-    *buffer++ = (char)c;
-    count++;
+    size_t n = readBuffered((uint8_t *)buffer + count, length - count);
+    if (n > 0) {
+      count += n;
+      waiting = false;
+    } else if (waitTimedOut(waiting)) {
+      break;
+    }
   }
   return count;
 }
@@ -218,11 +264,16 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
 {
   if (length < 1) return 0;
   size_t index = 0;
+  bool waiting = false;
+  bool found = false;
   while (index < length) {
-    int c = timedRead();
-    if (c < 0 || c == terminator) break;
-    *buffer++ = (char)c;
-    index++;
+    size_t n = readBufferedUntil(terminator, (uint8_t *)buffer + index, length - index, found);
+    index += n;
+    if (found) break;
+    if (n > 0)
+      waiting = false;
+    else if (waitTimedOut(waiting))
+      break;
   }
   return index; // return number of characters, not including null terminator
 }
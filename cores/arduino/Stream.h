@@ -43,6 +43,15 @@ class Stream : public Print
     int timedRead();    // private method to read stream with timeout
     int timedPeek();    // private method to peek stream with timeout
     int peekNextDigit(); // returns the next numeric digit in the stream or -1 if timeout
+    bool waitTimedOut(bool &waiting); // called when nothing is buffered, true once the timeout has expired
+
+    // bulk hooks for readBytes() and readBytesUntil(): copy out what is
+    // already buffered without waiting. The defaults go through read();
+    // ports with a ring buffer override them to copy straight out of it
+    virtual size_t readBuffered(uint8_t *buffer, size_t length);
+    // as above but stops at terminator, which is consumed but not copied,
+    // setting found
+    virtual size_t readBufferedUntil(char terminator, uint8_t *buffer, size_t length, bool &found);
 
   public:
     virtual int available() = 0;
@@ -52,6 +61,13 @@ class Stream : public Print
 
     Stream() {_timeout=1000;}
 
+    // zero-copy receive, used by StreamPump: points data at the oldest
+    // buffered byte and returns how many are contiguous from there, 0 when
+    // nothing is buffered; release them with consume(). The default has no
+    // buffer to point into, so StreamPump falls back to readBytes()
+    virtual int peekSpan(const uint8_t **data) { return 0; }
+    virtual void consume(int n) {}
+
 // parsing methods
 
   void setTimeout(unsigned long timeout);  // sets maximum milliseconds to wait for stream data, default is 1 second
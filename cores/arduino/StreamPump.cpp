@@ -0,0 +1,99 @@
+/*
+  StreamPump.cpp - moves bytes from one stream to another in bulk
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "StreamPump.h"
+
+void StreamPump::run(void *arg)
+{
+	((StreamPump *)arg)->poll();
+}
+
+// how much of n the destination takes without waiting; all of it when it
+// can't tell
+size_t StreamPump::writable(size_t n)
+{
+	int space = _to.availableForWrite();
+
+	if (space < 0)
+		return n;
+	return min(n, (size_t)space);
+}
+
+size_t StreamPump::poll(size_t limit)
+{
+	size_t total = 0;
+
+	// a destination that yields while writing must not restart the pump
+	if (_busy)
+		return 0;
+	_busy = true;
+
+	while (!limit || total < limit) {
+		size_t most = limit ? limit - total : SIZE_MAX;
+		const uint8_t *data;
+		size_t len, done;
+		int n;
+
+		// bytes read into the buffer earlier go first, to keep the order
+		if (_pos < _held) {
+			len = writable(min(most, (size_t)(_held - _pos)));
+			if (!len)
+				break;
+			done = _to.write(_buf + _pos, len);
+			_pos += done;
+			total += done;
+			if (done < len)
+				break;
+			if (_pos == _held)
+				_pos = _held = 0;
+			continue;
+		}
+
+		n = _from.peekSpan(&data);
+		if (n > 0) {
+			len = writable(min(most, (size_t)n));
+			if (!len)
+				break;
+			done = _to.write(data, len);
+			_from.consume(done);
+			total += done;
+			if (done < len)
+				break;
+			continue;
+		}
+
+		// no span: nothing buffered, or a source without peekSpan()
+		n = _from.available();
+		if (n <= 0)
+			break;
+		len = writable(min(most, min((size_t)n, sizeof(_buf))));
+		if (!len)
+			break;
+		// no more than available(), so readBytes() doesn't wait
+		_held = _from.readBytes(_buf, len);
+		_pos = 0;
+		if (!_held)
+			break;
+	}
+
+	_moved += total;
+	_busy = false;
+	return total;
+}
@@ -0,0 +1,71 @@
+/*
+  StreamPump.h - moves bytes from one stream to another in bulk
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef StreamPump_h
+#define StreamPump_h
+
+#include "Stream.h"
+#include "Task.h"
+
+// bytes held for a source without peekSpan()
+#define STREAM_PUMP_BUFFER 64
+
+// Bridges a source stream into a destination, e.g. a modem on Serial1 to
+// the USB Serial, one direction per pump:
+//   StreamPump up(Serial1, Serial), down(Serial, Serial1);
+//   void setup() { up.begin(); down.begin(); }
+// Sources with peekSpan() (Serial, Serial1, BLEStream) are written from
+// their receive buffer a contiguous run at a time; others go through
+// readBytes() and a small buffer. Only as much as the destination's
+// availableForWrite() is taken, so poll() does not wait on a slow
+// destination and what it can't take yet stays in the source's buffer.
+class StreamPump
+{
+public:
+	StreamPump(Stream &from, Print &to)
+		: _from(from), _to(to), _task(run, this), _held(0), _pos(0),
+		  _moved(0), _busy(false) {}
+
+	// polls every periodMs from yield() and the main loop
+	void begin(uint32_t periodMs = 1) { _task.start(0, periodMs); }
+	void end(void) { _task.stop(); }
+
+	// moves what both sides allow now, up to limit bytes (0 for no
+	// limit), and returns the count. Also for calling from serialEvent1()
+	// or similar to forward data as soon as it is read; not from an ISR
+	size_t poll(size_t limit = 0);
+
+	// bytes moved since construction
+	uint32_t moved(void) const { return _moved; }
+
+private:
+	static void run(void *arg);
+	size_t writable(size_t n);
+
+	Stream &_from;
+	Print &_to;
+	Task _task;
+	uint8_t _buf[STREAM_PUMP_BUFFER];
+	uint8_t _held;
+	uint8_t _pos;
+	uint32_t _moved;
+	bool _busy;
+};
+
+#endif  // StreamPump_h
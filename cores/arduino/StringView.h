@@ -0,0 +1,107 @@
+/*
+  StringView.h - non-owning view of a run of characters
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef StringView_h
+#define StringView_h
+#ifdef __cplusplus
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "WString.h"
+
+// A pointer and a length, for passing text around without copying it onto
+// the heap. The view does not own the characters, they must outlive it, and
+// it is not necessarily NUL terminated.
+class StringView
+{
+public:
+	StringView() : _data(""), _len(0) {}
+	StringView(const char *cstr) : _data(cstr ? cstr : ""), _len(cstr ? strlen(cstr) : 0) {}
+	StringView(const char *data, size_t length) : _data(data), _len(length) {}
+	StringView(const String &str) : _data(str.c_str() ? str.c_str() : ""), _len(str.length()) {}
+
+	const char *data(void) const { return _data; }
+	size_t length(void) const { return _len; }
+	bool isEmpty(void) const { return _len == 0; }
+	char operator [] (size_t index) const { return index < _len ? _data[index] : 0; }
+
+	bool equals(StringView s) const
+		{ return _len == s._len && memcmp(_data, s._data, _len) == 0; }
+	bool equalsIgnoreCase(StringView s) const
+	{
+		if (_len != s._len) return false;
+		for (size_t i = 0; i < _len; i++)
+			if (tolower((unsigned char)_data[i]) != tolower((unsigned char)s._data[i])) return false;
+		return true;
+	}
+	bool operator == (StringView s) const { return equals(s); }
+	bool operator != (StringView s) const { return !equals(s); }
+	bool startsWith(StringView prefix) const
+		{ return prefix._len <= _len && memcmp(_data, prefix._data, prefix._len) == 0; }
+	bool endsWith(StringView suffix) const
+		{ return suffix._len <= _len && memcmp(_data + _len - suffix._len, suffix._data, suffix._len) == 0; }
+
+	int indexOf(char ch, size_t fromIndex = 0) const
+	{
+		if (fromIndex >= _len) return -1;
+		const char *p = (const char *)memchr(_data + fromIndex, ch, _len - fromIndex);
+		return p ? p - _data : -1;
+	}
+	StringView substring(size_t beginIndex) const { return substring(beginIndex, _len); }
+	StringView substring(size_t beginIndex, size_t endIndex) const
+	{
+		if (endIndex > _len) endIndex = _len;
+		if (beginIndex > endIndex) beginIndex = endIndex;
+		return StringView(_data + beginIndex, endIndex - beginIndex);
+	}
+
+	// same rules as String::toInt(), without needing a terminator
+	long toInt(void) const
+	{
+		size_t i = 0;
+		bool negative = false;
+		long value = 0;
+		while (i < _len && isspace((unsigned char)_data[i])) i++;
+		if (i < _len && (_data[i] == '-' || _data[i] == '+')) negative = (_data[i++] == '-');
+		while (i < _len && _data[i] >= '0' && _data[i] <= '9')
+			value = value * 10 + (_data[i++] - '0');
+		return negative ? -value : value;
+	}
+
+	// copies the characters onto the heap
+	String toString(void) const
+	{
+		String s;
+		if (s.reserve(_len)) {
+			for (size_t i = 0; i < _len; i++) s += _data[i];
+		}
+		return s;
+	}
+
+private:
+	const char *_data;
+	size_t _len;
+};
+
+inline bool operator == (const String &lhs, StringView rhs) { return StringView(lhs).equals(rhs); }
+inline bool operator != (const String &lhs, StringView rhs) { return !StringView(lhs).equals(rhs); }
+
+#endif  // __cplusplus
+#endif  // StringView_h
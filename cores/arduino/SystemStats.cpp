@@ -0,0 +1,133 @@
+/*
+  SystemStats.cpp - loop timing and CPU utilisation
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "SystemStats.h"
+
+SystemStatsClass SystemStats;
+
+void systemStatsLoop(uint32_t start)
+{
+	if (SystemStats._enabled)
+		SystemStats.record(cycles() - start);
+}
+
+void SystemStatsClass::record(uint32_t clocks)
+{
+	_loops++;
+	_total += clocks;
+	if (clocks < _min)
+		_min = clocks;
+	if (clocks > _max) {
+		_max = clocks;
+		_maxAt = millis();
+	}
+
+	// log2 of the microseconds
+	uint32_t us = clocks >> 5;
+	uint8_t bin = us < 2 ? 0 : 31 - __builtin_clz(us);
+	if (bin >= SYSTEM_STATS_BINS)
+		bin = SYSTEM_STATS_BINS - 1;
+	_histogram[bin]++;
+}
+
+void SystemStatsClass::begin(void)
+{
+	reset();
+	_enabled = true;
+}
+
+void SystemStatsClass::end(void)
+{
+	_enabled = false;
+}
+
+void SystemStatsClass::reset(void)
+{
+	_start = cycles64();
+	_idleStart = idleCycles();
+	_total = 0;
+	_maxAt = 0;
+	_loops = 0;
+	_min = UINT32_MAX;
+	_max = 0;
+	memset(_histogram, 0, sizeof(_histogram));
+}
+
+uint32_t SystemStatsClass::minLoopMicros(void) const
+{
+	return _loops ? _min >> 5 : 0;
+}
+
+uint32_t SystemStatsClass::avgLoopMicros(void) const
+{
+	return _loops ? (uint32_t)((_total / _loops) >> 5) : 0;
+}
+
+uint32_t SystemStatsClass::maxLoopMicros(void) const
+{
+	return _max >> 5;
+}
+
+uint64_t SystemStatsClass::elapsedMicros(void) const
+{
+	return (cycles64() - _start) >> 5;
+}
+
+uint64_t SystemStatsClass::idleMicros(void) const
+{
+	return (idleCycles() - _idleStart) >> 5;
+}
+
+float SystemStatsClass::utilization(void) const
+{
+	uint64_t elapsed = cycles64() - _start;
+	uint64_t idle = idleCycles() - _idleStart;
+
+	if (elapsed == 0)
+		return 0;
+	return 100.0f * (float)(elapsed - idle) / (float)elapsed;
+}
+
+void SystemStatsClass::print(Print &out) const
+{
+	out.print("loops ");
+	out.print(_loops);
+	out.print(" min/avg/max us ");
+	out.print(minLoopMicros());
+	out.print('/');
+	out.print(avgLoopMicros());
+	out.print('/');
+	out.print(maxLoopMicros());
+	out.print(" (max at ");
+	out.print((uint32_t)_maxAt);
+	out.print(" ms) cpu ");
+	out.print(utilization(), 1);
+	out.println('%');
+
+	// histogram rows up to the last non-empty bin
+	int last = SYSTEM_STATS_BINS - 1;
+	while (last > 0 && _histogram[last] == 0)
+		last--;
+	for (int bin = 0; bin <= last; bin++) {
+		out.print(bin == 0 ? 0UL : 1UL << bin);
+		out.print(bin == SYSTEM_STATS_BINS - 1 ? "+ us: " : " us: ");
+		out.println(_histogram[bin]);
+	}
+}
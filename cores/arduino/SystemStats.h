@@ -0,0 +1,85 @@
+/*
+  SystemStats.h - loop timing and CPU utilisation
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SystemStats_h
+#define SystemStats_h
+
+#include <stdint.h>
+#include "Print.h"
+
+#ifndef SYSTEM_STATS_BINS
+#define SYSTEM_STATS_BINS	16
+#endif
+
+// Called by the main loop after each iteration, with cycles() at its start,
+// once SystemStats.h is used.
+extern "C" void systemStatsLoop(uint32_t start);
+
+// Times every pass of the main loop - loop() and the serial, task, log and
+// BLE polls after it, but not idle() - and the share of time the core slept
+// in delay() and idleFor(). Nothing is measured until begin().
+//   SystemStats.begin();
+//   ...
+//   SystemStats.print(Serial);
+class SystemStatsClass
+{
+public:
+	// starts measuring from now, clearing what was measured
+	void begin(void);
+	void end(void);
+	void reset(void);
+
+	uint32_t loops(void) const { return _loops; }
+	uint32_t minLoopMicros(void) const;
+	uint32_t avgLoopMicros(void) const;
+	uint32_t maxLoopMicros(void) const;
+	// millis() at the end of the longest loop, to line it up with other events
+	uint64_t maxLoopAt(void) const { return _maxAt; }
+
+	// loops that took 2^bin to 2^(bin + 1) - 1 microseconds; bin 0 counts
+	// those under 2 us and the last bin all the longer ones
+	uint32_t histogram(uint8_t bin) const
+		{ return bin < SYSTEM_STATS_BINS ? _histogram[bin] : 0; }
+
+	uint64_t elapsedMicros(void) const;
+	uint64_t idleMicros(void) const;
+	// percentage of the time since begin() the core was not asleep
+	float utilization(void) const;
+
+	void print(Print &out) const;
+
+private:
+	friend void systemStatsLoop(uint32_t start);
+
+	void record(uint32_t clocks);
+
+	uint64_t _start;
+	uint64_t _idleStart;
+	uint64_t _total;
+	uint64_t _maxAt;
+	uint32_t _loops;
+	uint32_t _min;
+	uint32_t _max;
+	uint32_t _histogram[SYSTEM_STATS_BINS];
+	bool _enabled;
+};
+
+extern SystemStatsClass SystemStats;
+
+#endif
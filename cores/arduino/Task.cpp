@@ -0,0 +1,103 @@
+/*
+  Task.cpp - cooperative periodic and one-shot tasks run from yield()
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "Task.h"
+
+// run queue, sorted by due time
+static Task *taskQueue = NULL;
+// keeps a task that calls delay() or yield() from re-entering the queue walk
+static bool tasksRunning = false;
+
+void Task::insert(void)
+{
+	Task **link = &taskQueue;
+	while (*link && (*link)->_due <= _due)
+		link = &(*link)->_next;
+	_next = *link;
+	*link = this;
+	_scheduled = true;
+}
+
+void Task::startMicros(uint64_t delayUs, uint64_t periodUs)
+{
+	stop();
+	_due = micros() + delayUs;
+	_period = periodUs;
+	_missed = 0;
+	insert();
+}
+
+void Task::stop(void)
+{
+	if (!_scheduled)
+		return;
+	for (Task **link = &taskQueue; *link; link = &(*link)->_next) {
+		if (*link == this) {
+			*link = _next;
+			break;
+		}
+	}
+	_next = NULL;
+	_scheduled = false;
+}
+
+void tasksRun(void)
+{
+	if (tasksRunning || taskQueue == NULL)
+		return;
+	tasksRunning = true;
+
+	uint64_t now = micros();
+	while (taskQueue && taskQueue->_due <= now) {
+		Task *task = taskQueue;
+		taskQueue = task->_next;
+		task->_next = NULL;
+		task->_scheduled = false;
+
+		if (task->_period) {
+			// keep to the original schedule, skipping whole periods if late
+			task->_due += task->_period;
+			if (task->_due <= now) {
+				uint64_t behind = (now - task->_due) / task->_period + 1;
+				task->_missed += behind;
+				task->_due += behind * task->_period;
+			}
+			task->insert();
+		}
+		// the callback may stop or restart its own task
+		// tasks made due by a slow callback wait for the next pass, so a
+		// short period can't keep loop() from running
+		task->_callback(task->_arg);
+	}
+
+	tasksRunning = false;
+}
+
+uint64_t tasksNextDue(void)
+{
+	return taskQueue ? taskQueue->_due : UINT64_MAX;
+}
+
+// delay() and cooperative libraries call yield(); with tasks linked in it
+// replaces the empty weak hook
+void yield(void)
+{
+	tasksRun();
+}
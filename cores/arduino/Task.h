@@ -0,0 +1,84 @@
+/*
+  Task.h - cooperative periodic and one-shot tasks run from yield()
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Task_h
+#define Task_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runs every task that is due. Called by the main loop after loop(), and by
+ * yield() (so from delay() and any library that yields) once Task.h is used.
+ * Tasks must only be started and stopped from thread context, not ISRs. */
+void tasksRun(void);
+
+/* micros() at which the first task is due, or UINT64_MAX when none is
+ * scheduled. delay() sleeps no later than this. */
+uint64_t tasksNextDue(void);
+
+#ifdef __cplusplus
+}
+
+// A task lives wherever the sketch puts it (usually a global) and is linked
+// into the sorted run queue while scheduled, so nothing is allocated.
+//   Task blink(toggleLed);
+//   void setup() { blink.start(0, 500); }
+class Task
+{
+public:
+	typedef void (*Callback)(void *arg);
+
+	Task(Callback callback, void *arg = NULL)
+		: _callback(callback), _arg(arg), _next(NULL), _due(0),
+		  _period(0), _missed(0), _scheduled(false) {}
+	~Task() { stop(); }
+
+	// first run delayMs from now, then every periodMs; 0 for a one-shot
+	void start(uint32_t delayMs, uint32_t periodMs = 0)
+		{ startMicros((uint64_t)delayMs * 1000, (uint64_t)periodMs * 1000); }
+	void startMicros(uint64_t delayUs, uint64_t periodUs = 0);
+	void stop(void);
+
+	bool isScheduled(void) const { return _scheduled; }
+	// micros() at which the task runs next
+	uint64_t due(void) const { return _due; }
+	// periods skipped because the task ran more than a period late
+	uint32_t missed(void) const { return _missed; }
+
+private:
+	friend void tasksRun(void);
+	friend uint64_t tasksNextDue(void);
+
+	void insert(void);
+
+	Callback _callback;
+	void *_arg;
+	Task *_next;
+	uint64_t _due;
+	uint64_t _period;
+	uint32_t _missed;
+	bool _scheduled;
+};
+
+#endif  // __cplusplus
+#endif  // Task_h
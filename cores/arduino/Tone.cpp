@@ -22,49 +22,72 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "interrupt.h"
 #include "conf.h"
 #include "aux_regs.h"
+#include "hwtimer.h"
 
 #define ACTIVE 1
 #define INACTIVE 0
 #define CONVERT_US 1000000
 
+/* a duration timer interval at most, in ms: clocks stay within 32 bits */
+#define TONE_MAX_CHUNK_MS 60000
+
 /* globals */
 static uint32_t current_pin;
 static uint32_t timer_interval;
 static int32_t duration_left;
 static uint32_t tone_state = INACTIVE;
 
+/* On a PWM pin the PWM block makes the square wave and timer1 only ends it */
+static bool tone_pwm;
+static uint32_t tone_saved_period;          /* analogWrite() period, put back after */
+static uint32_t tone_ms_left;               /* after the running duration interval */
+
 #ifdef __cplusplus
  extern "C" {
 #endif
 
 static void timer1_disable_tone(void);
-static void timer1_isr(void);
+static void timer1_isr(void *arg);
 static void timer1_init_tone(uint32_t ticktime_us);
+static void timer1_isr_pwm_tone(void *arg);
 
-static void timer1_disable_tone(void)
-{
-    uint32_t saved;
-    uint32_t ctrl_val;   /* timer control register value */
+/* timer1 is shared with Servo, CurieTimerOne and delay() through hwtimer */
+static hwtimer_t tone_timer = { 0, 0, timer1_isr, NULL, -1 };
+static hwtimer_t tone_end_timer = { 0, 0, timer1_isr_pwm_tone, NULL, -1 };
 
-    saved = interrupt_lock();
+static void pwm_tone_stop(void)
+{
+    hwtimerStop(&tone_end_timer);
+    /* back to GPIO, low, with the analogWrite() period */
+    pinMode(current_pin, OUTPUT);
+    digitalWrite(current_pin, LOW);
+    pwmPeriod[g_APinDescription[current_pin].ulPwmChan] = tone_saved_period;
+    tone_pwm = false;
+    tone_state = INACTIVE;
+}
 
-    /* disable interrupt generation */
-    ctrl_val = aux_reg_read(ARC_V2_TMR1_CONTROL);
-    aux_reg_write(ARC_V2_TMR1_CONTROL, ctrl_val & ~ARC_V2_TMR_CTRL_IE);
+/* Next interval of the duration, or the end of the tone */
+static void timer1_isr_pwm_tone(void *arg)
+{
+    uint32_t chunk = tone_ms_left < TONE_MAX_CHUNK_MS ? tone_ms_left : TONE_MAX_CHUNK_MS;
 
-    interrupt_unlock(saved);
+    if (chunk == 0) {
+        pwm_tone_stop();
+        return;
+    }
+    tone_ms_left -= chunk;
+    hwtimerAdvance(&tone_end_timer, chunk * 32000);
+}
 
-    /* disable interrupt in the interrupt controller */
-    interrupt_disable(ARCV2_IRQ_TIMER1);
+static void timer1_disable_tone(void)
+{
+    hwtimerStop(&tone_timer);
 }
 
-static void timer1_isr(void)
+static void timer1_isr(void *arg)
 {
     static uint32_t pin_state = 0;
 
-    /* clear the interrupt (by writing 0 to IP bit of the control register) */
-    aux_reg_write(ARC_V2_TMR1_CONTROL, ARC_V2_TMR_CTRL_NH | ARC_V2_TMR_CTRL_IE);
-
     if (duration_left != 0) {
         pin_state = !pin_state;
         digitalWrite(current_pin, pin_state);
@@ -78,39 +101,44 @@ static void timer1_isr(void)
 
 static void timer1_init_tone(uint32_t ticktime_us)
 {
-    int tickunit;
-
-    /* ensure that the timer will not generate interrupts */
-    aux_reg_write(ARC_V2_TMR1_CONTROL, 0);
-    aux_reg_write(ARC_V2_TMR1_COUNT, 0);    /* clear the count value */
-
-    /* connect specified routine/parameter to the timer 0 interrupt vector */
-    interrupt_connect(ARCV2_IRQ_TIMER1, timer1_isr);
-
-    tickunit = 32 * ticktime_us;
+    uint32_t tickunit = 32 * ticktime_us;
 
-    /*
-     * Set the reload value to achieve the configured tick rate, enable the
-     * counter and interrupt generation.
-     *
-     * The global variable 'tickunit' represents the #cycles/tick.
-     */
-
-    aux_reg_write(ARC_V2_TMR1_LIMIT, tickunit); /* write the limit value */
-    /* count only when not halted for debug and enable interrupts */
-    aux_reg_write(ARC_V2_TMR1_CONTROL, ARC_V2_TMR_CTRL_NH | ARC_V2_TMR_CTRL_IE);
-    aux_reg_write(ARC_V2_TMR1_COUNT, 0); /* write the start value */
-
-    /* Everything has been configured. It is now safe to enable the interrupt */
-    interrupt_enable(ARCV2_IRQ_TIMER1);
+    /* periodic, every tickunit cycles */
+    hwtimerStart(&tone_timer, tickunit, tickunit);
 }
 
 #ifdef __cplusplus
 }
 #endif
 
+static void pwm_tone(uint32_t _pin, unsigned int frequency, unsigned long duration)
+{
+    uint32_t chan = g_APinDescription[_pin].ulPwmChan;
+    uint32_t period = F_CPU / frequency;
+
+    hwtimerStop(&tone_end_timer);
+    if (!tone_pwm)
+        tone_saved_period = pwmPeriod[chan];
+    tone_pwm = true;
+    tone_state = ACTIVE;
+    current_pin = _pin;
+    analogWritePulse(_pin, period, period / 2);
+
+    if (duration > 0) {
+        uint32_t chunk = duration < TONE_MAX_CHUNK_MS ? duration : TONE_MAX_CHUNK_MS;
+        tone_ms_left = duration - chunk;
+        hwtimerStart(&tone_end_timer, chunk * 32000, 0);
+    }
+}
+
 void tone(uint32_t _pin, unsigned int frequency, unsigned long duration)
 {
+    if (frequency != 0 && digitalPinHasPWM(_pin) &&
+        (tone_state == INACTIVE || (tone_pwm && current_pin == _pin))) {
+        pwm_tone(_pin, frequency, duration);
+        return;
+    }
+
     if(frequency != 0) {
         timer_interval = (CONVERT_US / frequency) >> 1;
     } else
@@ -143,6 +171,12 @@ void tone(uint32_t _pin, unsigned int frequency, unsigned long duration)
 
 void noTone(uint32_t _pin)
 {
+    if (tone_pwm) {
+        if (current_pin == _pin)
+            pwm_tone_stop();
+        return;
+    }
+
     /* if tone already active on specified pin, disable the timer */
     if (current_pin == _pin) {
         timer1_disable_tone();
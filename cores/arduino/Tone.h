@@ -24,6 +24,8 @@
 /*
  * \brief Generates a square wave of the specified frequency (and 50% duty cycle) on a pin.
  *        A duration can be specified, otherwise the wave continues until a call to noTone()
+ *        On the PWM pins the wave comes from the PWM block, and timer1 only times
+ *        the duration; other pins are toggled from timer1 at twice the frequency.
  * \param pin
  * \param val
  */
@@ -24,10 +24,28 @@
 #include "UARTClass.h"
 #include "wiring_constants.h"
 #include "wiring_digital.h"
+#include "dccm/dccm_alloc.h"
+#include "dma_channel.h"
+
+// Rx FIFO trigger level programmed by uart_init() (FCR_FIFO_8)
+#define UART_RX_TRIGGER 8
+
+#if CONFIG_UART_CONSOLE_INDEX == 0
+#define UART_DMA_INTERFACE_TX SOC_DMA_INTERFACE_UART0_TX
+#define UART_DMA_INTERFACE_RX SOC_DMA_INTERFACE_UART0_RX
+#else
+#define UART_DMA_INTERFACE_TX SOC_DMA_INTERFACE_UART1_TX
+#define UART_DMA_INTERFACE_RX SOC_DMA_INTERFACE_UART1_RX
+#endif
 
 extern void UART_Handler(void);
 extern void serialEventRun(void) __attribute__((weak));
 extern void serialEvent(void) __attribute__((weak));
+// Defined by the sketch, see setEventMode()
+extern void serialEvent1(void) __attribute__((weak));
+// Only in a libarc32drv_arduino101.a rebuilt with the ns16550.c change;
+// without it there is no idle-line framing
+extern "C" int uart_irq_rx_timeout(int port) __attribute__((weak));
 
 bool Serial0_available() {
   return Serial.available();
@@ -45,10 +63,55 @@ UARTClass::UARTClass( uart_init_info *info, RingBuffer *pRx_buffer, RingBuffer *
    this->info = info;
    this->_rx_buffer = pRx_buffer;
    this->_tx_buffer = pTx_buffer;
+   this->_mode = SERIAL_IRQ;
+   this->_txPolicy = SERIAL_TX_BLOCK;
+   this->_txDropped = 0;
+   this->_onReceive = NULL;
+   this->_frameStart = 0;
+   this->_eventMode = SERIAL_EVENT_LOOP;
+   this->_rxEvent = false;
+   this->_dmaTxLen = 0;
+}
+
+static void uart_dma_tx_done(void *arg)
+{
+  ((UARTClass *)arg)->DmaTxDone();
+}
+
+// The DMA engine cannot reach the ARC's DCCM, which is where RingBuffer
+// allocates by default, so move such a ring to the heap
+static bool dmaReachable(RingBuffer *ring)
+{
+  uint32_t addr = (uint32_t)ring->_aucBuffer;
+
+  if (addr >= DCCM_START && addr < DCCM_START + DCCM_SIZE) {
+    uint8_t *buf = (uint8_t *)malloc(ring->size());
+    if (buf == NULL)
+      return false;
+    ring->setBuffer(buf, ring->size());
+  }
+  return true;
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
 
+void UARTClass::setRxBuffer(uint8_t *buffer, int size)
+{
+  uint32_t saved = interrupt_lock();
+  _rx_buffer->setBuffer(buffer, size);
+  interrupt_unlock(saved);
+}
+
+void UARTClass::setTxBuffer(uint8_t *buffer, int size)
+{
+  // Let anything already queued go out before swapping storage
+  if (opened)
+    flush();
+  uint32_t saved = interrupt_lock();
+  _tx_buffer->setBuffer(buffer, size);
+  interrupt_unlock(saved);
+}
+
 void UARTClass::begin(const uint32_t dwBaudRate)
 {
   begin(dwBaudRate, SERIAL_8N1);
@@ -56,6 +119,13 @@ void UARTClass::begin(const uint32_t dwBaudRate)
 
 void UARTClass::begin(const uint32_t dwBaudRate, const uint8_t config)
 {
+  begin(dwBaudRate, config, SERIAL_IRQ);
+}
+
+void UARTClass::begin(const uint32_t dwBaudRate, const uint8_t config, const uint8_t mode)
+{
+  _mode = mode;
+  _txDropped = 0;
   init(dwBaudRate, config );
   opened = true;
 }
@@ -65,8 +135,10 @@ void UARTClass::init(const uint32_t dwBaudRate, const uint8_t modeReg)
 {
   uint8_t c;
   // Make sure both ring buffers are initialized back to empty.
-  _rx_buffer->_iHead = _rx_buffer->_iTail = 0;
-  _tx_buffer->_iHead = _tx_buffer->_iTail = 0;
+  _rx_buffer->clear();
+  _tx_buffer->clear();
+  _frameStart = 0;
+  _rxEvent = false;
 
   SET_PIN_MODE(17, UART_MUX_MODE); // Rdx SOC PIN (Arduino header pin 0)
   SET_PIN_MODE(16, UART_MUX_MODE); // Txd SOC PIN (Arduino header pin 1)
@@ -93,9 +165,127 @@ void UARTClass::init(const uint32_t dwBaudRate, const uint8_t modeReg)
   while (uart_irq_rx_ready(CONFIG_UART_CONSOLE_INDEX))
       uart_fifo_read(CONFIG_UART_CONSOLE_INDEX, &c, 1);
 
+  // Fall back to interrupt mode if the DMA channels can't be set up
+  if (_mode & SERIAL_DMA) {
+    if (!dmaTxInit()) {
+      _mode &= ~SERIAL_DMA;
+    } else if (!dmaRxStart()) {
+      soc_dma_release(&_dmaTxChannel);
+      _mode &= ~SERIAL_DMA;
+    }
+  }
+
+  if (!(_mode & SERIAL_DMA))
+    uart_irq_rx_enable(CONFIG_UART_CONSOLE_INDEX);
+
+}
 
-  uart_irq_rx_enable(CONFIG_UART_CONSOLE_INDEX);
+bool UARTClass::dmaTxInit(void)
+{
+  _dmaTxLen = 0;
+  if (!dmaReachable(_tx_buffer))
+    return false;
+
+  if (dma_channel_acquire(&_dmaTxChannel) != DRV_RC_OK)
+    return false;
+
+  memset(&_dmaTxCfg, 0, sizeof(_dmaTxCfg));
+  _dmaTxCfg.type = SOC_DMA_TYPE_MEM2PER;
+  _dmaTxCfg.dest_interface = UART_DMA_INTERFACE_TX;
+  _dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+  _dmaTxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+  _dmaTxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+  _dmaTxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+  _dmaTxCfg.xfer.dest.addr = (void *)CONFIG_UART_CONSOLE_REGS;
+  _dmaTxCfg.cb_done = uart_dma_tx_done;
+  _dmaTxCfg.cb_done_arg = this;
+  _dmaTxCfg.cb_err = uart_dma_tx_done;
+  _dmaTxCfg.cb_err_arg = this;
+  _dmaTxItem = _dmaTxCfg.xfer;
+  _dmaTxItem.src.addr = _tx_buffer->_aucBuffer;
+  return true;
+}
 
+bool UARTClass::dmaRxStart(void)
+{
+  int half = _rx_buffer->size() / 2;
+
+  if (!dmaReachable(_rx_buffer))
+    return false;
+
+  if (dma_channel_acquire(&_dmaRxChannel) != DRV_RC_OK)
+    return false;
+
+  // Two blocks, each half of the ring, linked into a circle
+  memset(&_dmaRxCfg, 0, sizeof(_dmaRxCfg));
+  _dmaRxCfg.type = SOC_DMA_TYPE_PER2MEM;
+  _dmaRxCfg.src_interface = UART_DMA_INTERFACE_RX;
+  _dmaRxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+  _dmaRxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+  _dmaRxCfg.xfer.src.addr = (void *)CONFIG_UART_CONSOLE_REGS;
+  _dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+  _dmaRxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+  _dmaRxCfg.xfer.dest.addr = _rx_buffer->_aucBuffer;
+  _dmaRxCfg.xfer.size = half;
+  _dmaRxItem = _dmaRxCfg.xfer;
+  _dmaRxItem.dest.addr = _rx_buffer->_aucBuffer + half;
+  _dmaRxCfg.xfer.next = &_dmaRxItem;
+  _dmaRxItem.next = &_dmaRxCfg.xfer;
+
+  if (soc_dma_config(&_dmaRxChannel, &_dmaRxCfg) != DRV_RC_OK ||
+      soc_dma_start_transfer(&_dmaRxChannel) != DRV_RC_OK) {
+    soc_dma_release(&_dmaRxChannel);
+    return false;
+  }
+  return true;
+}
+
+// Start sending whatever is queued, at most up to the end of the ring and
+// then from its start as a second list item. Called from thread context by
+// write() and from the UART ISR once the previous transfer has completed
+void UARTClass::dmaTxStart(void)
+{
+  uint32_t saved = interrupt_lock();
+  int head = _tx_buffer->_iHead;
+  int tail = _tx_buffer->_iTail;
+
+  if (_dmaTxLen || head == tail) {
+    interrupt_unlock(saved);
+    return;
+  }
+
+  _dmaTxCfg.xfer.src.addr = _tx_buffer->_aucBuffer + tail;
+  _dmaTxCfg.xfer.next = NULL;
+  if (head > tail) {
+    _dmaTxCfg.xfer.size = head - tail;
+  } else {
+    _dmaTxCfg.xfer.size = _tx_buffer->size() - tail;
+    if (head > 0) {
+      _dmaTxItem.size = head;
+      _dmaTxItem.next = NULL;
+      _dmaTxCfg.xfer.next = &_dmaTxItem;
+    }
+  }
+  _dmaTxLen = (head - tail) & _tx_buffer->_iMask;
+
+  soc_dma_deconfig(&_dmaTxChannel);
+  if (soc_dma_config(&_dmaTxChannel, &_dmaTxCfg) != DRV_RC_OK ||
+      soc_dma_start_transfer(&_dmaTxChannel) != DRV_RC_OK) {
+    // Leave the data queued, the next write or flush retries
+    _dmaTxLen = 0;
+  }
+  interrupt_unlock(saved);
+}
+
+void UARTClass::DmaTxDone(void)
+{
+  _tx_buffer->_iTail = (_tx_buffer->_iTail + _dmaTxLen) & _tx_buffer->_iMask;
+  _dmaTxLen = 0;
+
+  // The DMA driver disables the channel after this callback returns, so
+  // the next transfer is kicked from the UART tx-empty interrupt instead
+  if (_tx_buffer->_iHead != _tx_buffer->_iTail)
+    uart_irq_tx_enable(CONFIG_UART_CONSOLE_INDEX);
 }
 
 void UARTClass::end( void )
@@ -106,6 +296,13 @@ void UARTClass::end( void )
   flush();
   uart_irq_rx_disable(CONFIG_UART_CONSOLE_INDEX);
   uart_irq_tx_disable(CONFIG_UART_CONSOLE_INDEX);
+  if (_mode & SERIAL_DMA) {
+    soc_dma_stop_transfer(&_dmaRxChannel);
+    soc_dma_release(&_dmaRxChannel);
+    soc_dma_stop_transfer(&_dmaTxChannel);
+    soc_dma_release(&_dmaTxChannel);
+    _mode &= ~SERIAL_DMA;
+  }
   while ( ret != -1 ) {
     ret = uart_poll_in(CONFIG_UART_CONSOLE_INDEX, &uc_data);
   }
@@ -121,20 +318,53 @@ void UARTClass::end( void )
   SET_PIN_MODE(16, GPIO_MUX_MODE); // Txd SOC PIN (Arduino header pin 1)
 }
 
-void UARTClass::setInterruptPriority(uint32_t priority)
+void UARTClass::onReceive(uart_frame_callback callback)
 {
-  //NVIC_SetPriority(_dwIrq, priority & 0x0F);
+  if (!uart_irq_rx_timeout)
+    callback = NULL;
+
+  uint32_t saved = interrupt_lock();
+  _frameStart = _rx_buffer->_iHead;
+  _onReceive = callback;
+  interrupt_unlock(saved);
+}
+
+bool UARTClass::setInterruptPriority(uint32_t priority)
+{
+  return ::setInterruptPriority(CONFIG_UART_CONSOLE_IRQ, priority);
 }
 
 uint32_t UARTClass::getInterruptPriority()
 {
-  //return NVIC_GetPriority(_dwIrq);
-  return 0;
+  return ::getInterruptPriority(CONFIG_UART_CONSOLE_IRQ);
+}
+
+void UARTClass::setEventMode(uint8_t mode)
+{
+  _eventMode = mode;
+}
+
+bool UARTClass::rxEvent(void)
+{
+  // The DMA transfer raises no interrupt per byte, so look at the ring
+  if (_mode & SERIAL_DMA)
+    return available() > 0;
+
+  if (!_rxEvent)
+    return false;
+  // Clear before looking, so that a byte stored in between sets it again
+  _rxEvent = false;
+  if (_eventMode != SERIAL_EVENT_LOOP || !_rx_buffer->available())
+    return false;
+  // Unread data keeps the event pending, as the per-loop poll did
+  _rxEvent = true;
+  return true;
 }
 
 int UARTClass::available( void )
 {
-  return (uint32_t)(UART_BUFFER_SIZE + _rx_buffer->_iHead - _rx_buffer->_iTail) % UART_BUFFER_SIZE;
+  dmaRxSync();
+  return _rx_buffer->available();
 }
 
 int UARTClass::availableForWrite(void)
@@ -143,74 +373,237 @@ int UARTClass::availableForWrite(void)
     return(0);
   int head = _tx_buffer->_iHead;
   int tail = _tx_buffer->_iTail;
-  if (head >= tail) return UART_BUFFER_SIZE - 1 - head + tail;
-  return tail - head - 1;
+  return (tail - head - 1) & _tx_buffer->_iMask;
 }
 
 int UARTClass::peek( void )
 {
-  if ( _rx_buffer->_iHead == _rx_buffer->_iTail )
-    return -1;
-
-  return _rx_buffer->_aucBuffer[_rx_buffer->_iTail];
+  dmaRxSync();
+  return _rx_buffer->peek_char();
 }
 
 int UARTClass::read( void )
 {
-  // if the head isn't ahead of the tail, we don't have any characters
-  if ( _rx_buffer->_iHead == _rx_buffer->_iTail )
-    return -1;
+  dmaRxSync();
+  return _rx_buffer->read_char();
+}
+
+size_t UARTClass::read( uint8_t *buffer, size_t size )
+{
+  dmaRxSync();
+  return _rx_buffer->readBytes(buffer, size);
+}
+
+// Stream's readBytes()/readBytesUntil() copy straight out of the rx ring
+size_t UARTClass::readBuffered( uint8_t *buffer, size_t length )
+{
+  return read(buffer, length);
+}
+
+size_t UARTClass::readBufferedUntil( char terminator, uint8_t *buffer, size_t length, bool &found )
+{
+  dmaRxSync();
+  return _rx_buffer->readBytesUntil((uint8_t)terminator, buffer, length, found);
+}
 
-  uint8_t uc = _rx_buffer->_aucBuffer[_rx_buffer->_iTail];
-  _rx_buffer->_iTail = (unsigned int)(_rx_buffer->_iTail + 1) % UART_BUFFER_SIZE;
-  return uc;
+int UARTClass::peekSpan( const uint8_t **data )
+{
+  dmaRxSync();
+  return _rx_buffer->peekSpan(data);
+}
+
+void UARTClass::consume( int n )
+{
+  _rx_buffer->consume(n);
 }
 
 void UARTClass::flush( void )
 {
+  if (_mode & SERIAL_DMA)
+    dmaTxStart();
   while (_tx_buffer->_iHead != (_tx_buffer->_iTail)); //wait for transmit data to be sent
   // Wait for transmission to complete
   while(!uart_tx_complete(CONFIG_UART_CONSOLE_INDEX));
 }
 
+void UARTClass::setWritePolicy(uint8_t policy)
+{
+  _txPolicy = policy;
+}
+
+// Queue one byte behind whatever is already in the tx ring, applying the
+// write policy if it is full. Returns the count to report to the caller;
+// the caller is responsible for getting the transmitter going
+size_t UARTClass::txQueue( const uint8_t uc_data )
+{
+  int l = (_tx_buffer->_iHead + 1) & _tx_buffer->_iMask;
+
+  if (_tx_buffer->_iTail == l)
+  {
+    switch (_txPolicy)
+    {
+      case SERIAL_TX_BLOCK:
+        if (_mode & SERIAL_DMA)
+          dmaTxStart();
+        while (_tx_buffer->_iTail == l); // Spin locks if we're about to overwrite the buffer. This continues once the data is sent
+        break;
+
+      case SERIAL_TX_DROP_OLDEST:
+        if (!(_mode & SERIAL_DMA))
+        {
+          // The ISR moves the tail too; only push it on if it's still full
+          uint32_t saved = interrupt_lock();
+          if (_tx_buffer->_iTail == l)
+          {
+            _tx_buffer->_iTail = (l + 1) & _tx_buffer->_iMask;
+            _txDropped++;
+          }
+          interrupt_unlock(saved);
+          break;
+        }
+        // The tail of a DMA ring may be in flight, drop the new byte instead
+        // fall through
+      case SERIAL_TX_DROP_NEWEST:
+        _txDropped++;
+        return 1;
+
+      default:
+        return 0;
+    }
+  }
+
+  _tx_buffer->_aucBuffer[_tx_buffer->_iHead] = uc_data;
+  RING_BUFFER_BARRIER();
+  _tx_buffer->_iHead = l;
+  return 1;
+}
+
 size_t UARTClass::write( const uint8_t uc_data )
 {
+  size_t n;
+
   if (!opened)
     return(0);
 
+  if (_mode & SERIAL_DMA)
+  {
+    n = txQueue(uc_data);
+    dmaTxStart();
+    return n;
+  }
+
   // Is the hardware currently busy?
   if (_tx_buffer->_iTail != _tx_buffer->_iHead)
   {
     // If busy we buffer
-    int l = (_tx_buffer->_iHead + 1) % UART_BUFFER_SIZE;
-    while (_tx_buffer->_iTail == l); // Spin locks if we're about to overwrite the buffer. This continues once the data is sent
-
-    _tx_buffer->_aucBuffer[_tx_buffer->_iHead] = uc_data;
-    _tx_buffer->_iHead = l;
+    n = txQueue(uc_data);
     // Make sure TX interrupt is enabled
     uart_irq_tx_enable(CONFIG_UART_CONSOLE_INDEX);
+    return n;
   }
-  else 
+
+  if (_txPolicy == SERIAL_TX_BLOCK)
   {
      // Bypass buffering and send character directly
      uart_poll_out(CONFIG_UART_CONSOLE_INDEX, uc_data);
   }
+  else if (uart_tx_ready(CONFIG_UART_CONSOLE_INDEX))
+  {
+     uart_fifo_fill(CONFIG_UART_CONSOLE_INDEX, &uc_data, 1);
+  }
+  else
+  {
+     // Don't wait for the shift register, let the ISR send it
+     txQueue(uc_data);
+     uart_irq_tx_enable(CONFIG_UART_CONSOLE_INDEX);
+  }
   return 1;
 }
 
+size_t UARTClass::write( const uint8_t *buffer, size_t size )
+{
+  size_t n = 0;
+
+  if (!opened)
+    return(0);
+
+  // With nothing queued there is no ordering to preserve, so fill the
+  // hardware FIFO directly. uart_fifo_fill() stops once it is occupied
+  if (!(_mode & SERIAL_DMA))
+  {
+    while (n < size && _tx_buffer->_iTail == _tx_buffer->_iHead &&
+           uart_tx_ready(CONFIG_UART_CONSOLE_INDEX))
+    {
+      int l = uart_fifo_fill(CONFIG_UART_CONSOLE_INDEX, buffer + n,
+                             min(size - n, (size_t)UART_FIFO_SIZE));
+      if (l <= 0)
+        break;
+      n += l;
+    }
+  }
+
+  // Queue the rest for the ISR or DMA completion to drain
+  while (n < size)
+  {
+    if (txQueue(buffer[n]) == 0)
+      break;
+    n++;
+    if (!(_mode & SERIAL_DMA))
+      uart_irq_tx_enable(CONFIG_UART_CONSOLE_INDEX);
+  }
+
+  if (_mode & SERIAL_DMA)
+    dmaTxStart();
+  return n;
+}
+
 void UARTClass::IrqHandler( void )
 {
   uart_irq_update(CONFIG_UART_CONSOLE_INDEX);
+
+  // In DMA mode only the tx-empty interrupt is used, to chain transfers
+  if (_mode & SERIAL_DMA)
+  {
+    if(uart_irq_tx_ready(CONFIG_UART_CONSOLE_INDEX))
+    {
+      uart_irq_tx_disable(CONFIG_UART_CONSOLE_INDEX);
+      dmaTxStart();
+    }
+    return;
+  }
+
   // if irq is Receiver Data Available
   if(uart_irq_rx_ready(CONFIG_UART_CONSOLE_INDEX))
   {
     uint8_t uc_data;
     int ret;
-    ret = uart_poll_in(CONFIG_UART_CONSOLE_INDEX, &uc_data);
-    
-    while ( ret != -1 ) {
-      _rx_buffer->store_char(uc_data);
+    bool idle = _onReceive && uart_irq_rx_timeout(CONFIG_UART_CONSOLE_INDEX);
+    // When framing, a trigger-level interrupt leaves one byte in the FIFO
+    // so that the receive timeout still fires at the end of the burst
+    int count = (_onReceive && !idle) ? UART_RX_TRIGGER - 1 : -1;
+
+    while ( count-- != 0 ) {
       ret = uart_poll_in(CONFIG_UART_CONSOLE_INDEX, &uc_data);
+      if ( ret == -1 )
+        break;
+      _rx_buffer->store_char(uc_data);
+    }
+
+    if (_rx_buffer->available())
+    {
+      if (_eventMode == SERIAL_EVENT_IRQ && serialEvent1)
+        serialEvent1();
+      else
+        _rxEvent = true;
+    }
+
+    if (idle && _onReceive)
+    {
+      int head = _rx_buffer->_iHead;
+      int length = (head - _frameStart) & _rx_buffer->_iMask;
+      _frameStart = head;
+      if (length)
+        _onReceive(length);
     }
   }
 
@@ -219,10 +612,10 @@ void UARTClass::IrqHandler( void )
   {
     if(_tx_buffer->_iTail != _tx_buffer->_iHead)
     {
-      int end = (_tx_buffer->_iTail < _tx_buffer->_iHead) ? _tx_buffer->_iHead : UART_BUFFER_SIZE;
+      int end = (_tx_buffer->_iTail < _tx_buffer->_iHead) ? _tx_buffer->_iHead : _tx_buffer->size();
       int l = min(end - _tx_buffer->_iTail, UART_FIFO_SIZE);
       l = uart_fifo_fill(CONFIG_UART_CONSOLE_INDEX, _tx_buffer->_aucBuffer+_tx_buffer->_iTail, l);
-      _tx_buffer->_iTail = (_tx_buffer->_iTail+l)%UART_BUFFER_SIZE;
+      _tx_buffer->_iTail = (_tx_buffer->_iTail+l) & _tx_buffer->_iMask;
     }
     else
     {
@@ -24,6 +24,7 @@
 
 #include <board.h>
 #include <uart.h>
+#include "soc_dma.h"
 
 #define SERIAL_5N1      LCR_CS5 | LCR_PDIS | LCR_1_STB
 #define SERIAL_6N1      LCR_CS6 | LCR_PDIS | LCR_1_STB
@@ -50,31 +51,100 @@
 #define SERIAL_7O2      LCR_CS7 | LCR_PEN  | LCR_2_STB
 #define SERIAL_8O2      LCR_CS8 | LCR_PEN  | LCR_2_STB
 
+// Transfer modes for begin(baud, config, mode). SERIAL_DMA falls back to
+// SERIAL_IRQ without two free channels; the prebuilt system library only
+// has interrupts for channels 0 and 1 (see dma_channel.h)
+#define SERIAL_IRQ      0x00    // interrupt per FIFO fill (default)
+#define SERIAL_DMA      0x01    // circular DMA receive, DMA transmit
+
+// Where serialEvent1() runs, see setEventMode()
+#define SERIAL_EVENT_LOOP       0x00    // after loop(), once data arrived (default)
+#define SERIAL_EVENT_IRQ        0x01    // from the UART interrupt, after each fill
+
+// What write() does when the tx ring is full, see setWritePolicy()
+#define SERIAL_TX_BLOCK         0x00    // spin until space frees up (default)
+#define SERIAL_TX_DROP_NEWEST   0x01    // discard the new byte, report it written
+#define SERIAL_TX_DROP_OLDEST   0x02    // overwrite the oldest queued byte
+#define SERIAL_TX_FAIL          0x03    // return 0 and leave the ring untouched
+
+// Called from the UART interrupt when the line goes idle after a burst.
+// The frame is the last length bytes received into the rx ring; if frames
+// are only consumed from the callback they start at the read position.
+typedef void (*uart_frame_callback)(int length);
+
 class UARTClass : public HardwareSerial
 {
   public:
     //UARTClass(Uart* pUart, IRQn_Type dwIrq, uint32_t dwId, RingBuffer* pRx_buffer, RingBuffer* pTx_buffer);
     UARTClass(uart_init_info *info, RingBuffer *pRx_buffer, RingBuffer *pTx_buffer );
 
+    // Replace the default ring buffer storage, e.g. with a larger static
+    // array. Sizes are rounded down to a power of two; call before begin()
+    void setRxBuffer(uint8_t *buffer, int size);
+    void setTxBuffer(uint8_t *buffer, int size);
+
     void begin(const uint32_t dwBaudRate);
     void begin(const uint32_t dwBaudRate, const uint8_t config);
+    void begin(const uint32_t dwBaudRate, const uint8_t config, const uint8_t mode);
     void end(void);
     int available(void);
     int availableForWrite(void);
     int peek(void);
     int read(void);
+    // Non-blocking bulk read of whatever is buffered, up to size bytes
+    size_t read(uint8_t *buffer, size_t size);
+    // Zero-copy receive: see RingBuffer::peekSpan() / consume()
+    int peekSpan(const uint8_t **data);
+    void consume(int n);
     void flush(void);
     size_t write(const uint8_t c);
-    using Print::write; // pull in write(str) and write(buf, size) from Print
-    void setInterruptPriority(uint32_t priority);
+    // Bulk write: with nothing queued the bytes go straight into the
+    // hardware FIFO, the rest is queued under the write policy
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) from Print
+    // Any policy other than SERIAL_TX_BLOCK also keeps write() from waiting
+    // on the transmitter when the ring is empty. In DMA mode the oldest
+    // bytes may already be in flight, so DROP_OLDEST drops the newest
+    void setWritePolicy(uint8_t policy);
+    // Bytes discarded by the DROP policies since begin()
+    uint32_t txDropped(void) { return _txDropped; }
+    // Idle-line framing (interrupt mode only): the callback fires once the
+    // receiver has seen no data for four character times after a burst,
+    // the fixed 16550 receive timeout. Pass NULL to disable. Needs a
+    // system library with uart_irq_rx_timeout(); otherwise it stays off
+    void onReceive(uart_frame_callback callback);
+    // SERIAL_EVENT_IRQ calls serialEvent1() from the receive interrupt,
+    // right after the bytes are stored, so it must be short and must not
+    // wait on the UART. It is called again only when more data arrives, so
+    // it should read everything. Interrupt mode only: received DMA data
+    // raises no interrupt and is always dispatched from the loop
+    void setEventMode(uint8_t mode);
+    // True while data received since the ring was last drained is unread.
+    // Polled by serialEventRun(); costs a flag test when nothing arrived
+    bool rxEvent(void);
+    // See ::setInterruptPriority()
+    bool setInterruptPriority(uint32_t priority);
     uint32_t getInterruptPriority();
 
     void IrqHandler(void);
+    void DmaTxDone(void);
 
     operator bool() { return true; }; // UART always active
 
   protected:
     void init(const uint32_t dwBaudRate, const uint8_t config);
+    bool dmaRxStart(void);
+    bool dmaTxInit(void);
+    void dmaTxStart(void);
+    size_t readBuffered(uint8_t *buffer, size_t length);
+    size_t readBufferedUntil(char terminator, uint8_t *buffer, size_t length, bool &found);
+    size_t txQueue(const uint8_t uc_data);
+    void dmaRxSync(void)
+    {
+      if (_mode & SERIAL_DMA)
+        _rx_buffer->_iHead = (soc_dma_get_dest_addr(&_dmaRxChannel) -
+                              (uint32_t)_rx_buffer->_aucBuffer) & _rx_buffer->_iMask;
+    }
 
     RingBuffer *_rx_buffer;
     RingBuffer *_tx_buffer;
@@ -84,6 +154,24 @@ class UARTClass : public HardwareSerial
     //IRQn_Type _dwIrq;
     uint32_t _dwId;
     uint32_t opened;
+    uint8_t _mode;
+    uint8_t _txPolicy;
+    uint32_t _txDropped;
+    uart_frame_callback _onReceive;
+    int _frameStart;
+    uint8_t _eventMode;
+    volatile bool _rxEvent;
+
+    // DMA mode: the rx ring is filled by a circular two-block transfer whose
+    // destination register is the producer index; the tx ring is drained by
+    // one- or two-item transfers of _dmaTxLen bytes from the tail
+    struct soc_dma_channel _dmaRxChannel;
+    struct soc_dma_channel _dmaTxChannel;
+    struct soc_dma_cfg _dmaRxCfg;
+    struct soc_dma_cfg _dmaTxCfg;
+    struct soc_dma_xfer_item _dmaRxItem;
+    struct soc_dma_xfer_item _dmaTxItem;
+    volatile int _dmaTxLen;
 
 };
 
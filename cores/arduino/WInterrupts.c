@@ -17,10 +17,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
  */
 
+#include <string.h>
 #include "WInterrupts.h"
 #include "wiring_digital.h"
 #include "gpio.h"
 #include "interrupt.h"
+#include "aux_regs.h"
+#include "io_config.h"
+#include "portable.h"
+#include "dccm/dccm_alloc.h"
 
 /* Saves the interrupt state from STATUS32 register before disabling the
  * interrupts */
@@ -29,7 +34,111 @@ static uint32_t irq_flags;
  * interrupts() */
 static uint32_t noInterrupts_executed;
 
-void attachInterrupt(uint32_t pin, void(*callback)(void), uint32_t mode)
+/* attachInterruptFast() takes over the controller vector from the GPIO
+ * driver, so it keeps its own record of every attached pin */
+#define GPIO_CONTROLLERS    4
+#define GPIO_NO_PIN         0xFF
+
+static void (*pinCallback[NUM_DIGITAL_PINS])(void) DCCM_BSS;
+static fastInterruptHandler pinFastHandler[NUM_DIGITAL_PINS] DCCM_BSS;
+static uint8_t bitPin[GPIO_CONTROLLERS][32] DCCM_BSS;
+static uint8_t controllerFast[GPIO_CONTROLLERS];
+
+/* attachPulseCounter(): the pins counted by each controller, as status
+ * bits, and per pin the edges and the timer0 count of its first and last */
+static uint32_t countBits[GPIO_CONTROLLERS] DCCM_BSS;
+static volatile uint32_t pulseCount[NUM_DIGITAL_PINS] DCCM_BSS;
+static volatile uint32_t pulseFirst[NUM_DIGITAL_PINS] DCCM_BSS;
+static volatile uint32_t pulseLast[NUM_DIGITAL_PINS] DCCM_BSS;
+
+/* SS 8B0, SS 8B1, SoC GPIO, AON GPIO */
+static inline uint8_t gpioController(PinDescription *p)
+{
+    return (p->ulGPIOType == SS_GPIO ? 0 : 2) + p->ulGPIOPort;
+}
+
+/* One vector per controller; each pending bit is cleared and dispatched
+ * on its own, lowest bit first */
+static inline __attribute__((always_inline))
+void gpioDispatch(uint8_t ctl, uint32_t base, int aux)
+{
+    uint32_t cycles = aux_reg_read(ARC_V2_TMR0_COUNT);
+    uint32_t status = aux ? READ_ARC_REG(base + SS_GPIO_INTSTATUS) :
+                            MMIO_REG_VAL(base + SOC_GPIO_INTSTATUS);
+    uint32_t counted = status & countBits[ctl];
+
+    /* Counted pins first, all acknowledged with one write */
+    if (counted) {
+        if (aux)
+            WRITE_ARC_REG(counted, base + SS_GPIO_PORTA_EOI);
+        else
+            MMIO_REG_VAL(base + SOC_GPIO_PORTA_EOI) = counted;
+        status &= ~counted;
+        do {
+            uint8_t pin = bitPin[ctl][__builtin_ctz(counted)];
+
+            if (pulseCount[pin]++ == 0)
+                pulseFirst[pin] = cycles;
+            pulseLast[pin] = cycles;
+            counted &= counted - 1;
+        } while (counted);
+    }
+
+    while (status) {
+        uint32_t bit = __builtin_ctz(status);
+        uint8_t pin = bitPin[ctl][bit];
+
+        status &= status - 1;
+        if (aux)
+            WRITE_ARC_REG(1 << bit, base + SS_GPIO_PORTA_EOI);
+        else
+            MMIO_REG_VAL(base + SOC_GPIO_PORTA_EOI) = 1 << bit;
+        if (pin == GPIO_NO_PIN)
+            continue;
+        if (pinFastHandler[pin])
+            pinFastHandler[pin](cycles);
+        else if (pinCallback[pin])
+            pinCallback[pin]();
+    }
+}
+
+static FAST_CODE void ssGpio0Isr(void) { gpioDispatch(0, SS_GPIO_8B0_BASE_ADDR, 1); }
+static FAST_CODE void ssGpio1Isr(void) { gpioDispatch(1, SS_GPIO_8B1_BASE_ADDR, 1); }
+static FAST_CODE void socGpioIsr(void) { gpioDispatch(2, SOC_GPIO_BASE_ADDR, 0); }
+static FAST_CODE void aonGpioIsr(void) { gpioDispatch(3, SOC_GPIO_AON_BASE_ADDR, 0); }
+
+static const struct {
+    unsigned int vector;
+    void (*isr)(void);
+} gpioVectors[GPIO_CONTROLLERS] = {
+    { IO_GPIO_8B0_INT_INTR_FLAG, ssGpio0Isr },
+    { IO_GPIO_8B1_INT_INTR_FLAG, ssGpio1Isr },
+    { SOC_GPIO_INTERRUPT, socGpioIsr },
+    { SOC_GPIO_AON_INTERRUPT, aonGpioIsr },
+};
+
+static void fastInterruptStub(void)
+{
+}
+
+static void recordAttach(uint32_t pin, void (*callback)(void), fastInterruptHandler handler)
+{
+    static uint8_t initialized;
+    PinDescription *p = &g_APinDescription[pin];
+
+    if (!initialized) {
+        memset(bitPin, GPIO_NO_PIN, sizeof(bitPin));
+        initialized = 1;
+    }
+    uint32_t saved = interrupt_lock();
+    pinCallback[pin] = callback;
+    pinFastHandler[pin] = handler;
+    bitPin[gpioController(p)][p->ulGPIOId] = pin;
+    countBits[gpioController(p)] &= ~(1 << p->ulGPIOId);
+    interrupt_unlock(saved);
+}
+
+static void gpioInterruptConfig(uint32_t pin, void(*callback)(void), uint32_t mode, int debounce)
 {
     if (pin >= NUM_DIGITAL_PINS) {
 #ifdef DEBUG
@@ -84,9 +193,10 @@ void attachInterrupt(uint32_t pin, void(*callback)(void), uint32_t mode)
 	return;
     }
     config.gpio_type = GPIO_INTERRUPT;
-    config.int_debounce = DEBOUNCE_ON;
+    config.int_debounce = debounce;
     config.int_ls_sync = LS_SYNC_OFF;
     config.gpio_cb = callback;
+    recordAttach(pin, callback, NULL);
 
     if (p->ulGPIOType == SS_GPIO)
         ret = ss_gpio_set_config(p->ulGPIOPort, p->ulGPIOId, &config);
@@ -98,6 +208,11 @@ void attachInterrupt(uint32_t pin, void(*callback)(void), uint32_t mode)
 #endif
 }
 
+void attachInterrupt(uint32_t pin, void(*callback)(void), uint32_t mode)
+{
+    gpioInterruptConfig(pin, callback, mode, DEBOUNCE_ON);
+}
+
 
 void detachInterrupt(uint32_t pin)
 {
@@ -110,6 +225,7 @@ void detachInterrupt(uint32_t pin)
     PinDescription *p = &g_APinDescription[pin];
     DRIVER_API_RC ret;
 
+    recordAttach(pin, NULL, NULL);
     if (p->ulGPIOType == SS_GPIO)
         ret = ss_gpio_deconfig(p->ulGPIOPort, p->ulGPIOId);
     else
@@ -120,6 +236,96 @@ void detachInterrupt(uint32_t pin)
 #endif
 }
 
+void attachInterruptFast(uint32_t pin, fastInterruptHandler handler, uint32_t mode)
+{
+    if (pin >= NUM_DIGITAL_PINS || handler == NULL)
+        return;
+
+    /* the driver programs the trigger, then the vector is pointed here */
+    attachInterrupt(pin, fastInterruptStub, mode);
+    recordAttach(pin, NULL, handler);
+
+    uint8_t ctl = gpioController(&g_APinDescription[pin]);
+    if (!controllerFast[ctl]) {
+        interrupt_connect(gpioVectors[ctl].vector, gpioVectors[ctl].isr);
+        controllerFast[ctl] = 1;
+    }
+}
+
+void attachPulseCounter(uint32_t pin, uint32_t mode, bool debounce)
+{
+    if (pin >= NUM_DIGITAL_PINS || (mode != RISING && mode != FALLING && mode != CHANGE))
+        return;
+
+    PinDescription *p = &g_APinDescription[pin];
+    uint8_t ctl = gpioController(p);
+
+    gpioInterruptConfig(pin, fastInterruptStub, mode, debounce ? DEBOUNCE_ON : DEBOUNCE_OFF);
+
+    uint32_t saved = interrupt_lock();
+    pinCallback[pin] = NULL;
+    pulseCount[pin] = 0;
+    countBits[ctl] |= 1 << p->ulGPIOId;
+    interrupt_unlock(saved);
+
+    if (!controllerFast[ctl]) {
+        interrupt_connect(gpioVectors[ctl].vector, gpioVectors[ctl].isr);
+        controllerFast[ctl] = 1;
+    }
+}
+
+void detachPulseCounter(uint32_t pin)
+{
+    detachInterrupt(pin);
+}
+
+uint32_t pulseCounterRead(uint32_t pin)
+{
+    if (pin >= NUM_DIGITAL_PINS)
+        return 0;
+    return pulseCount[pin];
+}
+
+uint32_t pulseCounterTake(uint32_t pin, uint32_t *first, uint32_t *last)
+{
+    if (pin >= NUM_DIGITAL_PINS)
+        return 0;
+
+    uint32_t saved = interrupt_lock();
+    uint32_t count = pulseCount[pin];
+    pulseCount[pin] = 0;
+    if (first)
+        *first = pulseFirst[pin];
+    if (last)
+        *last = pulseLast[pin];
+    interrupt_unlock(saved);
+    return count;
+}
+
+/* Only in a system library rebuilt with the low priority entry path, which
+ * gives those handlers their own stack; the prebuilt _do_isr reloads SP for
+ * every interrupt, so a high one preempting a low one overwrites its frame */
+extern unsigned char interrupt_priority_get(int irq) __attribute__((weak));
+
+bool setInterruptPriority(uint32_t irq, uint32_t priority)
+{
+    if (priority && !interrupt_priority_get)
+        return false;
+    interrupt_priority_set(irq, priority ? INTERRUPT_PRIORITY_LOW
+                                         : INTERRUPT_PRIORITY_HIGH);
+    return true;
+}
+
+/* Read here rather than with interrupt_priority_get(), which the prebuilt
+ * system library doesn't have */
+uint32_t getInterruptPriority(uint32_t irq)
+{
+    uint32_t saved = interrupt_lock();
+    aux_reg_write(ARC_V2_IRQ_SELECT, irq);
+    uint32_t priority = aux_reg_read(ARC_V2_IRQ_PRIORITY);
+    interrupt_unlock(saved);
+    return priority;
+}
 
 void interrupts(void)
 {
@@ -29,6 +29,62 @@ void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
 
 void detachInterrupt(uint32_t pin);
 
+/*
+ * Low latency variant of attachInterrupt(). The handler is called straight
+ * from the GPIO controller vector with that pin's status bit already cleared,
+ * and gets the timer0 count (CPU cycles, the clock behind micros()) read on
+ * entry to the vector. Pins on the same controller attached with
+ * attachInterrupt() are still dispatched, from the same vector.
+ */
+typedef void (*fastInterruptHandler)(uint32_t cycles);
+
+void attachInterruptFast(uint32_t pin, fastInterruptHandler handler, uint32_t mode);
+
+/*
+ * Edge counting without a handler: the controller vector counts the pin's
+ * edges itself and acknowledges all counted pins of the controller with one
+ * write. mode is RISING, FALLING or CHANGE, which counts both edges on SoC
+ * GPIO pins only, as for attachInterrupt(). The GPIO debounce filters
+ * glitches but, clocked at 32 kHz, limits the rate to a few kHz. The GPIO
+ * blocks have no hardware edge counter, so each edge is still an interrupt.
+ * detachPulseCounter() or any attachInterrupt() on the pin stops counting.
+ */
+void attachPulseCounter(uint32_t pin, uint32_t mode, bool debounce);
+
+void detachPulseCounter(uint32_t pin);
+
+/* Edges counted since attachPulseCounter() or the last pulseCounterTake() */
+uint32_t pulseCounterRead(uint32_t pin);
+
+/*
+ * Reads and clears the count in one step. first and last, unless NULL, get
+ * the timer0 counts (see cycles()) on entry to the vector of the first and
+ * the last edge counted, so the count - 1 intervals between them together
+ * took last - first cycles.
+ */
+uint32_t pulseCounterTake(uint32_t pin, uint32_t *first, uint32_t *last);
+
+/*
+ * Priority of an IRQ of board.h: INTERRUPT_PRIORITY_HIGH or
+ * INTERRUPT_PRIORITY_LOW. With a rebuilt system library every IRQ starts
+ * low, unless the sketch defines interrupt_priority_default(); the prebuilt
+ * one starts them all high and has no entry path for low ones, so there
+ * INTERRUPT_PRIORITY_LOW is refused, returning false. A high priority
+ * handler preempts the low ones, so it must only share data with them
+ * through interrupt_lock() or atomic_*. The latency critical and the bulk
+ * IRQs:
+ *   IRQ_I2S_INTR        CurieI2S, also CurieI2S.setInterruptPriority()
+ *   IRQ_ALWAYS_ON_GPIO  CurieIMU, also CurieIMU.setInterruptPriority()
+ *   IRQ_UART1_INTR      Serial1, also Serial1.setInterruptPriority()
+ *   IRQ_UART0_INTR      BLE core IPC, with IRQ_MAILBOXES_INTR for the
+ *                       framework IPC; their handlers use balloc
+ *   IRQ_TIMER0          millis() and micros() overflow
+ *   IRQ_TIMER1          hwtimer: delay(), tone(), Servo, CurieTimerOne
+ */
+bool setInterruptPriority(uint32_t irq, uint32_t priority);
+
+uint32_t getInterruptPriority(uint32_t irq);
+
 void interrupts(void);
 
 void noInterrupts(void);
@@ -155,7 +155,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	if (buffer != sso) free(buffer);
 }
 
 /*********************************************/
@@ -171,7 +171,7 @@ inline void String::init(void)
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer && buffer != sso) free(buffer);
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -179,7 +179,12 @@ void String::invalidate(void)
 unsigned char String::reserve(unsigned int size)
 {
 	if (buffer && capacity >= size) return 1;
-	if (changeBuffer(size)) {
+	// grow a string that is being appended to by half again, so building
+	// it up piece by piece doesn't realloc (and fragment the heap) each time
+	unsigned int grown = size;
+	if (buffer && len && grown < capacity + (capacity >> 1))
+		grown = capacity + (capacity >> 1);
+	if (changeBuffer(grown) || (grown != size && changeBuffer(size))) {
 		if (len == 0) buffer[0] = 0;
 		return 1;
 	}
@@ -188,7 +193,20 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	char *newbuffer;
+
+	if (buffer == NULL || buffer == sso) {
+		if (maxStrLen < STRING_SSO_SIZE) {
+			buffer = sso;
+			capacity = STRING_SSO_SIZE - 1;
+			return 1;
+		}
+		// moving out of the inline buffer, take the contents along
+		newbuffer = (char *)malloc(maxStrLen + 1);
+		if (newbuffer && buffer) memcpy(newbuffer, buffer, len + 1);
+	} else {
+		newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	}
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -226,13 +244,20 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length)
 #if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
 void String::move(String &rhs)
 {
+	if (rhs.buffer == rhs.sso) {
+		// an inline buffer can't change hands, copy it instead
+		copy(rhs.buffer, rhs.len);
+		rhs.len = 0;
+		rhs.sso[0] = 0;
+		return;
+	}
 	if (buffer) {
 		if (rhs && capacity >= rhs.len) {
 			strcpy(buffer, rhs.buffer);
 			len = rhs.len;
 			rhs.len = 0;
 			return;
-		} else {
+		} else if (buffer != sso) {
 			free(buffer);
 		}
 	}
@@ -400,95 +425,95 @@ unsigned char String::concat(const __FlashStringHelper * str)
 /*  Concatenate                              */
 /*********************************************/
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs)
+StringSumResult operator + (const StringSumHelper &lhs, const String &rhs)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(rhs.buffer, rhs.len)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr)
+StringSumResult operator + (const StringSumHelper &lhs, const char *cstr)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!cstr || !a.concat(cstr, strlen(cstr))) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, char c)
+StringSumResult operator + (const StringSumHelper &lhs, char c)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(c)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num)
+StringSumResult operator + (const StringSumHelper &lhs, unsigned char num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, int num)
+StringSumResult operator + (const StringSumHelper &lhs, int num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num)
+StringSumResult operator + (const StringSumHelper &lhs, unsigned int num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, long num)
+StringSumResult operator + (const StringSumHelper &lhs, long num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num)
+StringSumResult operator + (const StringSumHelper &lhs, unsigned long num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, long long num)
+StringSumResult operator + (const StringSumHelper &lhs, long long num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long long num)
+StringSumResult operator + (const StringSumHelper &lhs, unsigned long long num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, float num)
+StringSumResult operator + (const StringSumHelper &lhs, float num)
 {
         StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
         if (!a.concat(num)) a.invalidate();
-        return a;
+        return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, double num)
+StringSumResult operator + (const StringSumHelper &lhs, double num)
 {
         StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
         if (!a.concat(num)) a.invalidate();
-        return a;
+        return static_cast<StringSumResult>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs)
+StringSumResult operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(rhs))	a.invalidate();
-	return a;
+	return static_cast<StringSumResult>(a);
 }
 
 /*********************************************/
@@ -46,6 +46,21 @@ class __FlashStringHelper;
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
 
+// The type operator+ returns. With move semantics it hands its temporary
+// back as an rvalue so that "String s = a + b + c" takes over the buffer
+// the chain was built in instead of copying it
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+typedef StringSumHelper && StringSumResult;
+#else
+typedef StringSumHelper & StringSumResult;
+#endif
+
+// Strings shorter than this are stored inside the String object itself
+// rather than on the heap
+#ifndef STRING_SSO_SIZE
+#define STRING_SSO_SIZE 16
+#endif
+
 // The string class
 class String
 {
@@ -133,19 +148,19 @@ public:
 	String & operator += (double num)               {concat(num); return (*this);}
 	String & operator += (const __FlashStringHelper *str){concat(str); return (*this);}
 
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, char c);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, long long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, float num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, double num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs);
+	friend StringSumResult operator + (const StringSumHelper &lhs, const String &rhs);
+	friend StringSumResult operator + (const StringSumHelper &lhs, const char *cstr);
+	friend StringSumResult operator + (const StringSumHelper &lhs, char c);
+	friend StringSumResult operator + (const StringSumHelper &lhs, unsigned char num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, int num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, unsigned int num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, long num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, unsigned long num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, long long num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, unsigned long long num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, float num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, double num);
+	friend StringSumResult operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs);
 
 	// comparison (only works w/ Strings and "strings")
 	operator StringIfHelperType() const { return buffer ? &String::StringIfHelper : 0; }
@@ -206,6 +221,7 @@ protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+	char sso[STRING_SSO_SIZE]; // inline storage, buffer points here while it fits
 protected:
 	void init(void);
 	void invalidate(void);
@@ -0,0 +1,58 @@
+/*
+  crc.h - table driven CRC-8, CRC-16/CCITT and CRC-32
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _CRC_H_
+#define _CRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Every function continues the CRC of the data before: pass the previous
+ * result to add the next chunk, and the initial value for the first one.
+ * Four bytes at a time go through four lookup tables (slice-by-4); the
+ * tables are const, in flash, and only those of the CRCs a sketch uses
+ * are linked in: 1 KB for CRC-8, 2 KB for CRC-16, 4 KB for CRC-32. */
+
+/*
+ * \brief CRC-8, polynomial 0x07, not reflected (CRC-8/SMBUS from 0).
+ */
+extern uint8_t crc8(uint8_t crc, const void *data, size_t len);
+
+/*
+ * \brief CRC-16, polynomial 0x1021, not reflected: CRC-16/CCITT-FALSE
+ * from 0xFFFF, XMODEM from 0.
+ */
+extern uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t len);
+
+/*
+ * \brief The CRC-32 of zlib, Ethernet and PNG: polynomial 0x04C11DB7,
+ * reflected. The inversions are done inside, as zlib's crc32() does, so
+ * start from 0 and chain the results.
+ */
+extern uint32_t crc32(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRC_H_ */
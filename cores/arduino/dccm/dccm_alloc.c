@@ -18,34 +18,247 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 #include "dccm_alloc.h"
+#include "interrupt.h"
 
-uint16_t dccm_index = 0;
+/*
+ * Segregated free lists with boundary tags. Every block starts with a
+ * 4 byte header holding its own size and the size of the block physically
+ * before it, so free() can coalesce both ways in O(1). Free blocks are kept
+ * in one list per power of two; malloc takes the head of the first
+ * non-empty list whose smallest member is big enough, found with one bit
+ * scan over the list bitmap.
+ * Blocks are addressed by their 16 bit offset into DCCM. The heap starts
+ * after the DCCM_DATA and DCCM_BSS variables.
+ */
 
-#ifdef __cplusplus
- extern "C" {
-#endif
+#define BLOCK_USED      0x1
+#define BLOCK_HEADER    4
+#define BLOCK_MIN       8       /* header + free list links */
+#define NO_BLOCK        0xFFFF
+#define CLASS_SHIFT     3       /* class 0 holds blocks of 8..15 bytes */
+#define CLASS_COUNT     11      /* ... class 10 holds the whole 8K */
 
-void* dccm_malloc(uint16_t size)
+typedef struct {
+    uint16_t size;      /* whole block, BLOCK_USED while allocated */
+    uint16_t prev;      /* size of the block before, 0 for the first */
+    uint16_t next_free; /* free blocks only */
+    uint16_t prev_free;
+} dccm_block_t;
+
+extern char __dccm_heap_start[];
+
+static uint16_t heap_start;
+static uint16_t free_list[CLASS_COUNT];
+static uint16_t free_map;
+static uint16_t free_bytes;
+static uint8_t initialized;
+
+static inline dccm_block_t *block(uint16_t off)
+{
+    return (dccm_block_t *)(DCCM_START + off);
+}
+
+static inline uint16_t block_size(uint16_t off)
+{
+    return block(off)->size & ~BLOCK_USED;
+}
+
+/* class whose every member is at least size bytes */
+static inline int class_fit(uint16_t size)
+{
+    return 32 - __builtin_clz(size - 1) - CLASS_SHIFT;
+}
+
+/* class a block of size bytes belongs to */
+static inline int class_of(uint16_t size)
+{
+    return 31 - __builtin_clz(size) - CLASS_SHIFT;
+}
+
+static void list_insert(uint16_t off)
+{
+    dccm_block_t *b = block(off);
+    int c = class_of(b->size);
+
+    b->prev_free = NO_BLOCK;
+    b->next_free = free_list[c];
+    if (free_list[c] != NO_BLOCK)
+        block(free_list[c])->prev_free = off;
+    free_list[c] = off;
+    free_map |= 1 << c;
+    free_bytes += b->size;
+}
+
+static void list_remove(uint16_t off)
 {
-    if((size + dccm_index) > DCCM_SIZE)
-    {
+    dccm_block_t *b = block(off);
+    int c = class_of(b->size);
+
+    if (b->prev_free != NO_BLOCK)
+        block(b->prev_free)->next_free = b->next_free;
+    else
+        free_list[c] = b->next_free;
+    if (b->next_free != NO_BLOCK)
+        block(b->next_free)->prev_free = b->prev_free;
+    if (free_list[c] == NO_BLOCK)
+        free_map &= ~(1 << c);
+    free_bytes -= b->size;
+}
+
+static void set_next_prev(uint16_t off)
+{
+    uint16_t next = off + block_size(off);
+    if (next < DCCM_SIZE)
+        block(next)->prev = block_size(off);
+}
+
+/* Cuts a free, unlisted block down to size and lists the tail */
+static void split(uint16_t off, uint16_t size)
+{
+    uint16_t rest = block(off)->size - size;
+
+    if (rest < BLOCK_MIN)
+        return;
+    block(off)->size = size;
+    block(off + size)->size = rest;
+    block(off + size)->prev = size;
+    set_next_prev(off + size);
+    list_insert(off + size);
+}
+
+static void heap_init(void)
+{
+    int c;
+
+    for (c = 0; c < CLASS_COUNT; c++)
+        free_list[c] = NO_BLOCK;
+    heap_start = ((uint32_t)__dccm_heap_start - DCCM_START + 3) & ~3;
+    initialized = 1;
+    if (heap_start > DCCM_SIZE - BLOCK_MIN)
+        return;
+    block(heap_start)->size = DCCM_SIZE - heap_start;
+    block(heap_start)->prev = 0;
+    list_insert(heap_start);
+}
+
+/* Unlists a free block of at least size bytes, or returns NO_BLOCK */
+static uint16_t take(uint16_t size)
+{
+    int c = class_fit(size);
+    uint16_t map;
+
+    if (c >= CLASS_COUNT)
+        return NO_BLOCK;
+    map = free_map & ~((1 << c) - 1);
+    if (map == 0)
+        return NO_BLOCK;
+
+    uint16_t off = free_list[__builtin_ctz(map)];
+    list_remove(off);
+    return off;
+}
+
+void *dccm_aligned_alloc(uint16_t alignment, uint16_t size)
+{
+    uint32_t need, slack = 0;
+    uint16_t off;
+    void *ptr = 0;
+
+    if (size == 0 || alignment == 0 || (alignment & (alignment - 1)))
         return 0;
+    if (alignment < BLOCK_HEADER)
+        alignment = BLOCK_HEADER;
+
+    need = (size + BLOCK_HEADER + 3) & ~3;
+    if (need < BLOCK_MIN)
+        need = BLOCK_MIN;
+    if (alignment > BLOCK_HEADER)
+        /* room to move the start up to the boundary, leaving either no gap
+         * or a gap big enough to be a free block of its own */
+        slack = alignment + BLOCK_MIN;
+    if (need + slack > DCCM_SIZE)
+        return 0;
+
+    uint32_t saved = interrupt_lock();
+    if (!initialized)
+        heap_init();
+
+    off = take(need + slack);
+    if (off != NO_BLOCK) {
+        if (slack) {
+            uint32_t payload = (DCCM_START + off + BLOCK_HEADER + alignment - 1) & ~(alignment - 1);
+            uint16_t gap = payload - BLOCK_HEADER - DCCM_START - off;
+            if (gap && gap < BLOCK_MIN)
+                gap += alignment;
+            if (gap) {
+                uint16_t lead = off;
+                block(off + gap)->size = block(lead)->size - gap;
+                block(off + gap)->prev = gap;
+                block(lead)->size = gap;
+                off += gap;
+                set_next_prev(off);
+                list_insert(lead);
+            }
+        }
+        split(off, need);
+        block(off)->size |= BLOCK_USED;
+        ptr = (void *)(DCCM_START + off + BLOCK_HEADER);
     }
-    
-    void* addr = (void*)(DCCM_START + dccm_index);
-    dccm_index += size;
-    return addr;
+    interrupt_unlock(saved);
+
+    return ptr;
+}
+
+void* dccm_malloc(uint16_t size)
+{
+    return dccm_aligned_alloc(BLOCK_HEADER, size);
 }
 
 void *dccm_memalign(uint16_t size)
 {
-  if ((dccm_index +3) > DCCM_SIZE)
-    return 0;
+    return dccm_aligned_alloc(BLOCK_HEADER, size);
+}
+
+void dccm_free(void *ptr)
+{
+    uint32_t addr = (uint32_t)ptr;
+
+    if (!initialized || addr < DCCM_START + heap_start + BLOCK_HEADER ||
+        addr >= DCCM_START + DCCM_SIZE)
+        return;
+
+    uint16_t off = addr - DCCM_START - BLOCK_HEADER;
+    uint32_t saved = interrupt_lock();
 
-  dccm_index = (dccm_index + 3) & ~((uint16_t)0x3);  /* 4 byte addr alignment */
-  return dccm_malloc(size);
+    if (block(off)->size & BLOCK_USED) {
+        uint16_t next, prev;
+
+        block(off)->size &= ~BLOCK_USED;
+        next = off + block(off)->size;
+        if (next < DCCM_SIZE && !(block(next)->size & BLOCK_USED)) {
+            list_remove(next);
+            block(off)->size += block(next)->size;
+        }
+        if (block(off)->prev) {
+            prev = off - block(off)->prev;
+            if (!(block(prev)->size & BLOCK_USED)) {
+                list_remove(prev);
+                block(prev)->size += block(off)->size;
+                off = prev;
+            }
+        }
+        set_next_prev(off);
+        list_insert(off);
+    }
+    interrupt_unlock(saved);
 }
 
-#ifdef __cplusplus
+uint16_t dccm_free_size(void)
+{
+    uint32_t saved = interrupt_lock();
+    if (!initialized)
+        heap_init();
+    uint16_t bytes = free_bytes;
+    interrupt_unlock(saved);
+    return bytes;
 }
-#endif
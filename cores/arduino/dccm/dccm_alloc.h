@@ -25,14 +25,61 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef _DCCM_ALLOC_
 #define _DCCM_ALLOC_
 
+/*
+ * DCCM is single cycle and doesn't contend with the instruction fetch, so
+ * it suits tables and state that interrupt handlers touch. DCCM_DATA
+ * variables are initialised at boot like .data, DCCM_BSS ones are zeroed.
+ * Whatever they leave free becomes the dccm_malloc() heap.
+ *
+ * The copy and the zeroing are done by c_init.o in libarc32drv_arduino101.a.
+ * The prebuilt archive predates them, so until a rebuilt one ships (and
+ * defines CONFIG_DCCM_INIT in platform.txt) both stay in .data and .bss.
+ */
+#ifdef CONFIG_DCCM_INIT
+#define DCCM_DATA   __attribute__((section(".dccm.data")))
+#define DCCM_BSS    __attribute__((section(".dccm.bss")))
+#else
+#define DCCM_DATA
+#define DCCM_BSS
+#endif
+
+/*
+ * The ARC can't fetch from DCCM, so FAST_CODE runs from SRAM instead of
+ * flash, avoiding the flash wait states. SRAM is out of bl range from
+ * flash: a FAST_CODE function may only call inline or other FAST_CODE
+ * functions directly, anything else through a function pointer.
+ */
+#define FAST_CODE   __attribute__((section(".ramfunc"), long_call, noinline))
+
+/*
+ * NOINIT variables, in SRAM, are neither zeroed nor initialised at boot,
+ * which saves the time for large buffers and lets them keep their contents
+ * over a warm reset, e.g. a crash log. Their value is undefined after a
+ * power-on, so such data needs its own validity marker. They can't have
+ * an initialiser.
+ */
+#define NOINIT      __attribute__((section(".noinit")))
+
 #ifdef __cplusplus
  extern "C" {
 #endif
 
+/*
+ * All allocations are 4 byte aligned and can be returned with dccm_free().
+ * Allocation and free are constant time and safe from interrupt context.
+ */
 void* dccm_malloc(uint16_t size);
 
 void *dccm_memalign(uint16_t size);
 
+/* alignment must be a power of two */
+void *dccm_aligned_alloc(uint16_t alignment, uint16_t size);
+
+void dccm_free(void *ptr);
+
+/* total free bytes, including block headers; not all in one piece */
+uint16_t dccm_free_size(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,55 @@
+/*
+  dma_channel.c - SoC DMA channels shared between the core and libraries
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "dma_channel.h"
+#include "interrupt.h"
+
+/* Only in a rebuilt system library, which has an ISR for every channel */
+extern const uint8_t soc_dma_isr_channels __attribute__((weak));
+
+/* Channels the prebuilt system library installs interrupt handlers for */
+#define PREBUILT_ISR_CHANNELS   2
+
+static uint8_t initialized = 0;
+
+void dma_channel_init(void)
+{
+    uint32_t saved = interrupt_lock();
+
+    if (!initialized) {
+        soc_dma_init();
+        initialized = 1;
+    }
+    interrupt_unlock(saved);
+}
+
+DRIVER_API_RC dma_channel_acquire(struct soc_dma_channel *channel)
+{
+    uint8_t isrChannels = &soc_dma_isr_channels ? soc_dma_isr_channels
+                                                : PREBUILT_ISR_CHANNELS;
+
+    dma_channel_init();
+    if (soc_dma_acquire(channel) != DRV_RC_OK)
+        return DRV_RC_FAIL;
+    if (channel->id >= isrChannels) {
+        soc_dma_release(channel);
+        return DRV_RC_FAIL;
+    }
+    return DRV_RC_OK;
+}
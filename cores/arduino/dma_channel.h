@@ -0,0 +1,49 @@
+/*
+  dma_channel.h - SoC DMA channels shared between the core and libraries
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _DMA_CHANNEL_H_
+#define _DMA_CHANNEL_H_
+
+#include "soc_dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Brings the DMA controller up the first time only. The soc_dma_init() in
+ * the prebuilt system library empties the channel table and disables every
+ * channel each time it runs, so calling it directly stops transfers other
+ * drivers have running; everything in the core and libraries goes through
+ * here instead.
+ */
+extern void dma_channel_init(void);
+
+/*
+ * soc_dma_acquire() after dma_channel_init(). Fails, leaving the channel
+ * free, for a channel the linked system library has no interrupt handler
+ * for: the prebuilt one only handles channels 0 and 1.
+ */
+extern DRIVER_API_RC dma_channel_acquire(struct soc_dma_channel *channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DMA_CHANNEL_H_ */
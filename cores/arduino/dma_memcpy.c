@@ -0,0 +1,245 @@
+/*
+  dma_memcpy.c - memory to memory copies and fills on the SoC DMA controller
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include "Arduino.h"
+#include "dma_memcpy.h"
+#include "dma_channel.h"
+#include "soc_dma.h"
+#include "interrupt.h"
+#include "aux_regs.h"
+#include "dccm/dccm_alloc.h"
+
+/* Items in one xfer; soc_dma splits it into blocks of up to 4095 */
+#define DMA_MEMCPY_MAX_ITEMS    0xFFFF
+/* dma_memcpy_wait() gives up after this many cycles per item, plus a
+ * millisecond; a memory to memory item takes a few */
+#define DMA_MEMCPY_ITEM_CYCLES  16
+#define DMA_MEMCPY_SLACK_CYCLES (1000UL * CLOCK_SPEED)
+
+static struct soc_dma_channel channel;
+static struct soc_dma_cfg cfg;
+static uint8_t acquired = 0;
+static volatile uint8_t busy = 0;
+static volatile int8_t status = 0;
+/* cycles() at the start of the transfer, and how long it may run */
+static uint32_t started;
+static uint32_t timeout;
+/* source word of a fill, read over and over with the address held */
+static uint32_t fillWord;
+static dma_memcpy_callback_t userCallback;
+static void *userArg;
+
+static int dmaReachable(const void *buf, size_t len)
+{
+    uint32_t addr = (uint32_t)buf;
+
+    return addr + len <= DCCM_START || addr >= DCCM_START + DCCM_SIZE;
+}
+
+/* The IRQ never comes with interrupts locked or from a handler */
+static int canWait(void)
+{
+    return (aux_reg_read(ARC_V2_STATUS32) & ARC_V2_STATUS32_IE) &&
+           aux_reg_read(ARC_V2_AUX_IRQ_ACT) == 0;
+}
+
+static void finish(int8_t result)
+{
+    dma_memcpy_callback_t callback = userCallback;
+
+    status = result;
+    busy = 0;
+    if (callback)
+        callback(userArg, result);
+}
+
+static void dmaDone(void *arg)
+{
+    finish(0);
+}
+
+static void dmaError(void *arg)
+{
+    soc_dma_stop_transfer(&channel);
+    finish(-1);
+}
+
+/* Claims the channel for one transfer, -1 if it's running one already */
+static int claim(dma_memcpy_callback_t callback, void *arg)
+{
+    uint32_t saved = interrupt_lock();
+
+    if (busy) {
+        interrupt_unlock(saved);
+        return -1;
+    }
+    busy = 1;
+    interrupt_unlock(saved);
+
+    if (!acquired) {
+        if (dma_channel_acquire(&channel) != DRV_RC_OK) {
+            busy = 0;
+            return -1;
+        }
+        acquired = 1;
+    }
+    userCallback = callback;
+    userArg = arg;
+    return 0;
+}
+
+static int start(void *dst, const void *src, uint8_t srcDelta,
+                 uint8_t width, uint32_t items)
+{
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.type = SOC_DMA_TYPE_MEM2MEM;
+    cfg.xfer.src.delta = srcDelta;
+    cfg.xfer.src.width = width;
+    cfg.xfer.src.addr = (void *)src;
+    cfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+    cfg.xfer.dest.width = width;
+    cfg.xfer.dest.addr = dst;
+    cfg.xfer.size = items;
+    cfg.cb_done = dmaDone;
+    cfg.cb_err = dmaError;
+    timeout = items * DMA_MEMCPY_ITEM_CYCLES + DMA_MEMCPY_SLACK_CYCLES;
+    started = cycles();
+
+    soc_dma_deconfig(&channel);
+    if (soc_dma_config(&channel, &cfg) != DRV_RC_OK ||
+        soc_dma_start_transfer(&channel) != DRV_RC_OK) {
+        busy = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int dma_memcpy_async(void *dst, const void *src, size_t len,
+                     dma_memcpy_callback_t callback, void *arg)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t width = SOC_DMA_WIDTH_8;
+    size_t head = 0, items = len;
+
+    if (!dmaReachable(dst, len) || !dmaReachable(src, len))
+        return -1;
+    if ((((uint32_t)d ^ (uint32_t)s) & 3) == 0 && len >= 8) {
+        head = -(uint32_t)d & 3;
+        items = (len - head) / 4;
+        width = SOC_DMA_WIDTH_32;
+    }
+    if (items == 0 || items > DMA_MEMCPY_MAX_ITEMS)
+        return -1;
+    if (claim(callback, arg))
+        return -1;
+
+    /* the unaligned ends, done now so the callback means all of it */
+    if (width == SOC_DMA_WIDTH_32) {
+        size_t tail = head + items * 4;
+        memcpy(d, s, head);
+        memcpy(d + tail, s + tail, len - tail);
+    }
+    return start(d + head, s + head, SOC_DMA_DELTA_INCR, width, items);
+}
+
+int dma_memset_async(void *dst, uint8_t value, size_t len,
+                     dma_memcpy_callback_t callback, void *arg)
+{
+    uint8_t *d = (uint8_t *)dst;
+    uint8_t width = SOC_DMA_WIDTH_8;
+    size_t head = 0, items = len;
+
+    if (!dmaReachable(dst, len))
+        return -1;
+    if (len >= 8) {
+        head = -(uint32_t)d & 3;
+        items = (len - head) / 4;
+        width = SOC_DMA_WIDTH_32;
+    }
+    if (items == 0 || items > DMA_MEMCPY_MAX_ITEMS)
+        return -1;
+    if (claim(callback, arg))
+        return -1;
+
+    fillWord = value * 0x01010101UL;
+    if (width == SOC_DMA_WIDTH_32) {
+        size_t tail = head + items * 4;
+        memset(d, value, head);
+        memset(d + tail, value, len - tail);
+    }
+    return start(d + head, &fillWord, SOC_DMA_DELTA_NONE, width, items);
+}
+
+int dma_memcpy_busy(void)
+{
+    return busy;
+}
+
+int dma_memcpy_wait(void)
+{
+    while (busy) {
+        if (cycles() - started > timeout) {
+            /* the interrupt never came: stop it and report an error, so
+             * dma_memcpy() and dma_memset() redo it on the CPU */
+            uint32_t saved = interrupt_lock();
+            if (busy) {
+                soc_dma_stop_transfer(&channel);
+                finish(-1);
+            }
+            interrupt_unlock(saved);
+        }
+    }
+    return status;
+}
+
+void *dma_memcpy(void *dst, const void *src, size_t len)
+{
+    uint32_t d = (uint32_t)dst, s = (uint32_t)src;
+
+    /* memcpy() doesn't allow overlap either, but callers get away with
+     * dst below src on the CPU; the DMA reads ahead, so never risk it */
+    if (len < DMA_MEMCPY_THRESHOLD || (d < s + len && s < d + len) ||
+        !canWait() || dma_memcpy_async(dst, src, len, NULL, NULL))
+        return memcpy(dst, src, len);
+    if (dma_memcpy_wait())
+        memcpy(dst, src, len);
+    return dst;
+}
+
+void *dma_memset(void *dst, int value, size_t len)
+{
+    if (len < DMA_MEMCPY_THRESHOLD || !canWait() ||
+        dma_memset_async(dst, value, len, NULL, NULL))
+        return memset(dst, value, len);
+    if (dma_memcpy_wait())
+        memset(dst, value, len);
+    return dst;
+}
+
+void dma_memcpy_end(void)
+{
+    dma_memcpy_wait();
+    if (acquired) {
+        soc_dma_deconfig(&channel);
+        soc_dma_release(&channel);
+        acquired = 0;
+    }
+}
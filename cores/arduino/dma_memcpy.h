@@ -0,0 +1,95 @@
+/*
+  dma_memcpy.h - memory to memory copies and fills on the SoC DMA controller
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _DMA_MEMCPY_H_
+#define _DMA_MEMCPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One DMA channel, taken from soc_dma on first use and kept until
+ * dma_memcpy_end(), moves one buffer at a time. Buffers must be in SRAM:
+ * the controller can't reach the ARC DCCM. When dst and src share their
+ * alignment the bulk moves as 32 bit words and the odd bytes at either
+ * end are copied by the CPU before the transfer starts. */
+
+/* Below this many bytes dma_memcpy() and dma_memset() use the CPU, which
+ * is quicker than setting up the channel */
+#ifndef DMA_MEMCPY_THRESHOLD
+#define DMA_MEMCPY_THRESHOLD    256
+#endif
+
+/* status is 0, or -1 when the controller reported an error */
+typedef void (*dma_memcpy_callback_t)(void *arg, int status);
+
+/*
+ * \brief Starts copying len bytes from src to dst and returns; callback,
+ * which may be NULL, runs in the DMA interrupt when it is done. Neither
+ * buffer may be touched until then, and the callback can't start the next
+ * transfer (the channel is still being shut down when it runs).
+ *
+ * \return 0, or -1 when a transfer is already running, a buffer is in
+ * DCCM, len is too big for one transfer (65535 words, or bytes when the
+ * alignments differ) or no channel is free.
+ */
+extern int dma_memcpy_async(void *dst, const void *src, size_t len,
+                            dma_memcpy_callback_t callback, void *arg);
+
+/*
+ * \brief As dma_memcpy_async(), filling len bytes of dst with value.
+ */
+extern int dma_memset_async(void *dst, uint8_t value, size_t len,
+                            dma_memcpy_callback_t callback, void *arg);
+
+/*
+ * \brief Non-zero while an async transfer is running.
+ */
+extern int dma_memcpy_busy(void);
+
+/*
+ * \brief Blocks until the running transfer, if any, is done. One that runs
+ * well past the time it should take is stopped, with the callback getting -1.
+ *
+ * \return 0, or -1 when it ended with an error or was stopped.
+ */
+extern int dma_memcpy_wait(void);
+
+/*
+ * \brief Drop-in memcpy()/memset(): small, DCCM or overlapping buffers,
+ * calls from interrupts and times when the channel is busy go to the CPU,
+ * the rest to the DMA channel, waiting for it to finish.
+ */
+extern void *dma_memcpy(void *dst, const void *src, size_t len);
+extern void *dma_memset(void *dst, int value, size_t len);
+
+/*
+ * \brief Gives the channel back to soc_dma once the running transfer is
+ * done.
+ */
+extern void dma_memcpy_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DMA_MEMCPY_H_ */
@@ -0,0 +1,154 @@
+/*
+  fiber.c - cooperative fibers with pooled stacks
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "fiber.h"
+
+/* Callee-saved state: r13-r26, fp, sp, blink. Everything else is
+ * clobbered by a call anyway, and interrupts run on the FIRQ register
+ * bank with their own stack, so they never see a fiber switch. */
+typedef struct {
+    uint32_t r13_r26[14];
+    uint32_t fp;
+    uint32_t sp;
+    uint32_t blink;
+} fiber_context_t;
+
+/* Saves the running context into from and resumes to */
+extern void _fiber_switch(fiber_context_t *from, fiber_context_t *to);
+/* First blink of a new fiber: calls r13(r14), then fiberExit() */
+extern void _fiber_start(void);
+
+__asm__(
+    "    .pushsection .text\n"
+    "    .balign 4\n"
+    "    .global _fiber_switch\n"
+    "    .type _fiber_switch, @function\n"
+    "_fiber_switch:\n"
+    "    st r13, [r0, 0]\n"
+    "    st r14, [r0, 4]\n"
+    "    st r15, [r0, 8]\n"
+    "    st r16, [r0, 12]\n"
+    "    st r17, [r0, 16]\n"
+    "    st r18, [r0, 20]\n"
+    "    st r19, [r0, 24]\n"
+    "    st r20, [r0, 28]\n"
+    "    st r21, [r0, 32]\n"
+    "    st r22, [r0, 36]\n"
+    "    st r23, [r0, 40]\n"
+    "    st r24, [r0, 44]\n"
+    "    st r25, [r0, 48]\n"
+    "    st r26, [r0, 52]\n"
+    "    st fp, [r0, 56]\n"
+    "    st sp, [r0, 60]\n"
+    "    st blink, [r0, 64]\n"
+    "    ld r13, [r1, 0]\n"
+    "    ld r14, [r1, 4]\n"
+    "    ld r15, [r1, 8]\n"
+    "    ld r16, [r1, 12]\n"
+    "    ld r17, [r1, 16]\n"
+    "    ld r18, [r1, 20]\n"
+    "    ld r19, [r1, 24]\n"
+    "    ld r20, [r1, 28]\n"
+    "    ld r21, [r1, 32]\n"
+    "    ld r22, [r1, 36]\n"
+    "    ld r23, [r1, 40]\n"
+    "    ld r24, [r1, 44]\n"
+    "    ld r25, [r1, 48]\n"
+    "    ld r26, [r1, 52]\n"
+    "    ld fp, [r1, 56]\n"
+    "    ld sp, [r1, 60]\n"
+    "    ld blink, [r1, 64]\n"
+    "    j_s [blink]\n"
+    "    .size _fiber_switch, .-_fiber_switch\n"
+    "\n"
+    "    .balign 4\n"
+    "    .global _fiber_start\n"
+    "    .type _fiber_start, @function\n"
+    "_fiber_start:\n"
+    "    mov r0, r14\n"
+    "    jl [r13]\n"
+    "    bl fiberExit\n"
+    "    .size _fiber_start, .-_fiber_start\n"
+    "    .popsection\n"
+);
+
+/* slot 0 is the main loop, which runs on the boot stack */
+static fiber_context_t fiberContext[FIBER_POOL_SIZE + 1];
+static uint8_t fiberActive[FIBER_POOL_SIZE + 1] = { 1 };
+static uint32_t fiberStack[FIBER_POOL_SIZE][FIBER_STACK_SIZE / 4] __attribute__((aligned(8)));
+static int fiberCurrent = 0;
+
+int fiberCreate(fiber_func_t fn, void *arg)
+{
+    int id;
+
+    for (id = 1; id <= FIBER_POOL_SIZE; id++) {
+        if (!fiberActive[id])
+            break;
+    }
+    if (id > FIBER_POOL_SIZE)
+        return -1;
+
+    fiber_context_t *ctx = &fiberContext[id];
+    ctx->r13_r26[0] = (uint32_t)fn;
+    ctx->r13_r26[1] = (uint32_t)arg;
+    ctx->fp = 0;
+    ctx->sp = (uint32_t)&fiberStack[id - 1][FIBER_STACK_SIZE / 4];
+    ctx->blink = (uint32_t)_fiber_start;
+    fiberActive[id] = 1;
+
+    return id;
+}
+
+static void fiberSwitchNext(void)
+{
+    int prev = fiberCurrent;
+    int next = prev;
+
+    do {
+        next = (next + 1) % (FIBER_POOL_SIZE + 1);
+    } while (!fiberActive[next] && next != prev);
+
+    if (next == prev)
+        return;
+    fiberCurrent = next;
+    _fiber_switch(&fiberContext[prev], &fiberContext[next]);
+}
+
+void fiberYield(void)
+{
+    fiberSwitchNext();
+}
+
+void fiberExit(void)
+{
+    if (fiberCurrent == 0)
+        return;
+    /* the stack stays in use until the switch below, which never returns,
+     * and nothing can claim the slot before then */
+    fiberActive[fiberCurrent] = 0;
+    fiberSwitchNext();
+}
+
+int fiberSelf(void)
+{
+    return fiberCurrent;
+}
@@ -0,0 +1,68 @@
+/*
+  fiber.h - cooperative fibers with pooled stacks
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _FIBER_H_
+#define _FIBER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stacks come from a static pool; override with -D to trade RAM for depth */
+#ifndef FIBER_POOL_SIZE
+#define FIBER_POOL_SIZE     4
+#endif
+#ifndef FIBER_STACK_SIZE
+#define FIBER_STACK_SIZE    1024
+#endif
+
+typedef void (*fiber_func_t)(void *arg);
+
+/*
+ * \brief Starts fn(arg) on a pool stack. It first runs at the next
+ * fiberYield(), and its stack goes back to the pool when fn returns.
+ *
+ * \return Fiber id (1..FIBER_POOL_SIZE), or -1 when the pool is empty.
+ */
+extern int fiberCreate(fiber_func_t fn, void *arg);
+
+/*
+ * \brief Switches to the next runnable fiber, round robin, including the
+ * main loop (id 0). Returns at once when there is no other fiber.
+ * delay(), the I2C wait loops and anything built on them call this, so
+ * blocking code written in a fiber lets the others run.
+ */
+extern void fiberYield(void);
+
+/*
+ * \brief Ends the calling fiber. Returning from the fiber function does
+ * the same. Must not be called from the main loop.
+ */
+extern void fiberExit(void);
+
+/*
+ * \brief Id of the running fiber, 0 for the main loop.
+ */
+extern int fiberSelf(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FIBER_H_ */
@@ -30,6 +30,15 @@ static void __empty() {
 }
 void yield(void) __attribute__ ((weak, alias("__empty")));
 
+/**
+ * Empty idle() hook.
+ *
+ * Called by the main loop after every loop(). Sketches that have nothing to
+ * do until the next interrupt can redefine it to sleep the core, typically
+ * with idleFor().
+ */
+void idle(void) __attribute__ ((weak, alias("__empty")));
+
 /**
  * SysTick hook
  *
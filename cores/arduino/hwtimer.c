@@ -0,0 +1,209 @@
+/*
+  hwtimer.c - software timers multiplexed onto ARC timer1
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "hwtimer.h"
+#include "interrupt.h"
+#include "conf.h"
+#include "aux_regs.h"
+
+/* Shortest one-shot programmed into timer1, so a timer that is nearly due
+ * fires a little late rather than being missed */
+#define HWTIMER_MIN_CLOCKS  64
+
+static hwtimer_t *heap[HWTIMER_MAX] DCCM_BSS;
+static uint8_t heapSize = 0;
+/* timer whose callback is running, until it restarts or stops itself */
+static hwtimer_t *firing = NULL;
+/* set while the interrupt runs callbacks; it reprograms timer1 at the end */
+static uint8_t inIsr = 0;
+
+static void heapSet(uint8_t i, hwtimer_t *timer)
+{
+    heap[i] = timer;
+    timer->slot = i;
+}
+
+static void heapUp(uint8_t i)
+{
+    hwtimer_t *timer = heap[i];
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+        if (heap[parent]->expiry <= timer->expiry)
+            break;
+        heapSet(i, heap[parent]);
+        i = parent;
+    }
+    heapSet(i, timer);
+}
+
+static void heapDown(uint8_t i)
+{
+    hwtimer_t *timer = heap[i];
+    for (;;) {
+        uint8_t child = 2 * i + 1;
+        if (child >= heapSize)
+            break;
+        if (child + 1 < heapSize && heap[child + 1]->expiry < heap[child]->expiry)
+            child++;
+        if (timer->expiry <= heap[child]->expiry)
+            break;
+        heapSet(i, heap[child]);
+        i = child;
+    }
+    heapSet(i, timer);
+}
+
+static int heapInsert(hwtimer_t *timer)
+{
+    if (heapSize >= HWTIMER_MAX)
+        return -1;
+    heap[heapSize] = timer;
+    heapUp(heapSize++);
+    return 0;
+}
+
+static void heapRemove(hwtimer_t *timer)
+{
+    uint8_t i = timer->slot;
+    timer->slot = -1;
+    if (--heapSize == i)
+        return;
+    heap[i] = heap[heapSize];
+    heapUp(i);
+    heapDown(heap[i]->slot);
+}
+
+/* One-shot for the earliest timer, or off when there is none */
+static void timer1Program(void)
+{
+    aux_reg_write(ARC_V2_TMR1_CONTROL, 0);
+    if (heapSize == 0) {
+        interrupt_disable(ARCV2_IRQ_TIMER1);
+        return;
+    }
+
+    uint64_t now = cycles64();
+    uint64_t left = heap[0]->expiry > now ? heap[0]->expiry - now : 0;
+    if (left < HWTIMER_MIN_CLOCKS)
+        left = HWTIMER_MIN_CLOCKS;
+    else if (left > 0xFFFFFFFF)
+        left = 0xFFFFFFFF;
+
+    aux_reg_write(ARC_V2_TMR1_LIMIT, (uint32_t)left);
+    aux_reg_write(ARC_V2_TMR1_COUNT, 0);
+    aux_reg_write(ARC_V2_TMR1_CONTROL, ARC_V2_TMR_CTRL_NH | ARC_V2_TMR_CTRL_IE);
+    interrupt_enable(ARCV2_IRQ_TIMER1);
+}
+
+static void timer1_isr(void)
+{
+    /* clear the interrupt (by writing 0 to IP bit of the control register) */
+    aux_reg_write(ARC_V2_TMR1_CONTROL, ARC_V2_TMR_CTRL_NH | ARC_V2_TMR_CTRL_IE);
+
+    inIsr = 1;
+    while (heapSize && heap[0]->expiry <= cycles64()) {
+        hwtimer_t *timer = heap[0];
+        heapRemove(timer);
+
+        firing = timer;
+        timer->callback(timer->arg);
+        if (firing == timer && timer->period) {
+            /* not restarted or stopped by its callback */
+            timer->expiry += timer->period;
+            heapInsert(timer);
+        }
+        firing = NULL;
+    }
+    inIsr = 0;
+
+    timer1Program();
+}
+
+void hwtimerInit(hwtimer_t *timer, hwtimer_callback_t callback, void *arg)
+{
+    timer->expiry = 0;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->slot = -1;
+}
+
+static int hwtimerSchedule(hwtimer_t *timer, uint64_t expiry, uint32_t period)
+{
+    static uint8_t connected;
+    int ret;
+    uint32_t saved = interrupt_lock();
+
+    if (!connected) {
+        interrupt_connect(ARCV2_IRQ_TIMER1, timer1_isr);
+        connected = 1;
+    }
+    if (firing == timer)
+        firing = NULL;
+    if (timer->slot >= 0)
+        heapRemove(timer);
+    timer->expiry = expiry;
+    timer->period = period;
+    ret = heapInsert(timer);
+    if (!inIsr)
+        timer1Program();
+
+    interrupt_unlock(saved);
+    return ret;
+}
+
+int hwtimerStart(hwtimer_t *timer, uint32_t delay, uint32_t period)
+{
+    return hwtimerSchedule(timer, cycles64() + delay, period);
+}
+
+int hwtimerAdvance(hwtimer_t *timer, uint32_t delay)
+{
+    return hwtimerSchedule(timer, timer->expiry + delay, timer->period);
+}
+
+void hwtimerStop(hwtimer_t *timer)
+{
+    uint32_t saved = interrupt_lock();
+
+    if (firing == timer)
+        firing = NULL;
+    if (timer->slot >= 0) {
+        uint8_t first = timer->slot == 0;
+        heapRemove(timer);
+        if (first && !inIsr)
+            timer1Program();
+    }
+
+    interrupt_unlock(saved);
+}
+
+int hwtimerActive(const hwtimer_t *timer)
+{
+    return timer->slot >= 0;
+}
+
+uint32_t hwtimerRemaining(const hwtimer_t *timer)
+{
+    if (timer->slot < 0)
+        return 0;
+    uint64_t now = cycles64();
+    return timer->expiry > now ? (uint32_t)(timer->expiry - now) : 0;
+}
@@ -0,0 +1,85 @@
+/*
+  hwtimer.h - software timers multiplexed onto ARC timer1
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _HWTIMER_H_
+#define _HWTIMER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* tone(), Servo, CurieTimerOne, delay() and user timers all share timer1
+ * through this: pending timers sit in a min-heap on their expiry, and
+ * timer1 is reprogrammed as a one-shot for the earliest one. Times are in
+ * timer0 clocks (cycles(), 32 per microsecond). */
+#ifndef HWTIMER_MAX
+#define HWTIMER_MAX     16
+#endif
+
+typedef void (*hwtimer_callback_t)(void *arg);
+
+typedef struct {
+    uint64_t expiry;            /* cycles64() at which it fires */
+    uint32_t period;            /* clocks between firings, 0 for one-shot */
+    hwtimer_callback_t callback;
+    void *arg;
+    int8_t slot;                /* heap index, -1 while stopped */
+} hwtimer_t;
+
+/*
+ * \brief Sets up a stopped timer. Callbacks run in the timer1 interrupt.
+ */
+extern void hwtimerInit(hwtimer_t *timer, hwtimer_callback_t callback, void *arg);
+
+/*
+ * \brief (Re)starts a timer delay clocks from now, then every period clocks
+ * (0 for a one-shot).
+ *
+ * \return 0, or -1 when HWTIMER_MAX timers are already running.
+ */
+extern int hwtimerStart(hwtimer_t *timer, uint32_t delay, uint32_t period);
+
+/*
+ * \brief Reschedules a timer delay clocks after its previous expiry rather
+ * than after now, so a chain of intervals set from the callback doesn't
+ * drift by the interrupt latency.
+ *
+ * \return 0, or -1 when HWTIMER_MAX timers are already running.
+ */
+extern int hwtimerAdvance(hwtimer_t *timer, uint32_t delay);
+
+extern void hwtimerStop(hwtimer_t *timer);
+
+/*
+ * \brief Non-zero while the timer is waiting to fire.
+ */
+extern int hwtimerActive(const hwtimer_t *timer);
+
+/*
+ * \brief Clocks until the timer fires, 0 if stopped or already due.
+ */
+extern uint32_t hwtimerRemaining(const hwtimer_t *timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HWTIMER_H_ */
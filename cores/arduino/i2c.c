@@ -20,9 +20,26 @@
  */
 
 #include "i2c.h"
+#include "hwtimer.h"
 #include "variant.h"
 
+/* Defined when the sketch uses fiber.h: the wait loops let other fibers run.
+ * Otherwise they spin on the flags set by the driver callbacks, so a
+ * transfer returns as soon as it completes */
+extern void fiberYield(void) __attribute__((weak));
+
+/* Only in a rebuilt system library; without it SCL runs at 100 or 400 kHz */
+extern DRIVER_API_RC ss_i2c_set_clock(I2C_CONTROLLER controller_id,
+                                      uint32_t scl_hz) __attribute__((weak));
+
 #define TIMEOUT_MS 16
+/* timer0 runs at the CPU clock */
+#define TIMEOUT_CYCLES ((uint32_t)TIMEOUT_MS * 1000 * CLOCK_SPEED)
+
+/* An address probe is START, address, ACK, one data byte, NACK and STOP,
+ * about 20 SCL periods; it is given four times that plus the ISR latency */
+#define PROBE_BITS 20
+#define PROBE_SLACK_CYCLES (50 * CLOCK_SPEED)
 
 static volatile uint8_t i2c_tx_complete[NUM_SS_I2C];
 static volatile uint8_t i2c_rx_complete[NUM_SS_I2C];
@@ -30,100 +47,187 @@ static volatile uint8_t i2c_err_detect[NUM_SS_I2C];
 static volatile uint32_t i2c_err_source[NUM_SS_I2C];
 
 static volatile uint8_t i2c_slave[NUM_SS_I2C];
+static uint32_t i2c_scl_hz[NUM_SS_I2C];
+
+/* i2c_submit() transfers, the head one on the bus */
+static i2c_xfer_t *volatile i2c_queue_head[NUM_SS_I2C];
+static i2c_xfer_t *i2c_queue_tail[NUM_SS_I2C];
+
+static void i2c_queue_done(I2C_CONTROLLER controller_id, int status);
+static void i2c_queue_retry(void *arg);
+
+/* A queued start the controller isn't ready for is tried again from timer1
+ * about a byte time later, not spun on in the interrupt or lock it came
+ * from. i2c_queue_since is when the head transfer was first tried */
+static hwtimer_t i2c_queue_timer[NUM_SS_I2C] = {
+    { 0, 0, i2c_queue_retry, (void *)I2C_SENSING_0, -1 },
+    { 0, 0, i2c_queue_retry, (void *)I2C_SENSING_1, -1 },
+};
+static uint32_t i2c_queue_since[NUM_SS_I2C];
+/* The last queued transfer failed, its STOP possibly still to come */
+static bool i2c_queue_abort[NUM_SS_I2C];
+
+#ifndef I2C_NO_STATS
+static i2c_stats_t i2c_stats[NUM_SS_I2C];
+#define STAT_ADD(id, field, n) (i2c_stats[id].field += (n))
+
+/* Counts the outcome of one transfer of bytes data bytes */
+static void stat_result(I2C_CONTROLLER controller_id, int ret, uint32_t bytes)
+{
+    if (ret >= 0)
+        i2c_stats[controller_id].bytes += bytes;
+    else if (ret == I2C_ERROR_ADDRESS_NOACK || ret == I2C_ERROR_DATA_NOACK)
+        i2c_stats[controller_id].nacks++;
+}
+
+/* Adds the time since start to the wait totals and passes ret through */
+static int wait_done(I2C_CONTROLLER controller_id, uint32_t start, int ret)
+{
+    uint32_t waited = cycles() - start;
+
+    i2c_stats[controller_id].wait_cycles += waited;
+    if (waited > i2c_stats[controller_id].wait_max)
+        i2c_stats[controller_id].wait_max = waited;
+    return ret;
+}
+#else
+#define STAT_ADD(id, field, n) do {} while (0)
+#define stat_result(id, ret, bytes) do {} while (0)
+#define wait_done(id, start, ret) (ret)
+#endif
+
+static int err_status(uint32_t source)
+{
+    if (source & I2C_ABRT_7B_ADDR_NOACK) {
+        return I2C_ERROR_ADDRESS_NOACK; // NACK on transmit of address
+    } else if (source & I2C_ABRT_TXDATA_NOACK) {
+        return I2C_ERROR_DATA_NOACK; // NACK on transmit of data
+    } else {
+        return I2C_ERROR_OTHER; // other error
+    }
+}
 
 static void ss_i2c_0_rx(uint32_t dev_id)
 {
     i2c_rx_complete[I2C_SENSING_0] = 1;
+    if (i2c_queue_head[I2C_SENSING_0])
+        i2c_queue_done(I2C_SENSING_0, I2C_OK);
 }
 
 static void ss_i2c_1_rx(uint32_t dev_id)
 {
     i2c_rx_complete[I2C_SENSING_1] = 1;
+    if (i2c_queue_head[I2C_SENSING_1])
+        i2c_queue_done(I2C_SENSING_1, I2C_OK);
 }
 
 static void ss_i2c_0_tx(uint32_t dev_id)
 {
     i2c_tx_complete[I2C_SENSING_0] = 1;
+    if (i2c_queue_head[I2C_SENSING_0])
+        i2c_queue_done(I2C_SENSING_0, I2C_OK);
 }
 
 static void ss_i2c_1_tx(uint32_t dev_id)
 {
     i2c_tx_complete[I2C_SENSING_1] = 1;
+    if (i2c_queue_head[I2C_SENSING_1])
+        i2c_queue_done(I2C_SENSING_1, I2C_OK);
 }
 
 static void ss_i2c_0_err(uint32_t dev_id)
 {
     i2c_err_detect[I2C_SENSING_0] = 1;
     i2c_err_source[I2C_SENSING_0] = dev_id;
+    if (i2c_queue_head[I2C_SENSING_0])
+        i2c_queue_done(I2C_SENSING_0, err_status(dev_id));
 }
 
 static void ss_i2c_1_err(uint32_t dev_id)
 {
     i2c_err_detect[I2C_SENSING_1] = 1;
     i2c_err_source[I2C_SENSING_1] = dev_id;
+    if (i2c_queue_head[I2C_SENSING_1])
+        i2c_queue_done(I2C_SENSING_1, err_status(dev_id));
 }
 
-static int wait_rx_or_err(I2C_CONTROLLER controller_id)
+static int wait_rx_or_err(I2C_CONTROLLER controller_id, uint32_t timeout)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
+    uint32_t start = cycles();
 
-    while (timeout--) {
+    do {
         if (i2c_err_detect[controller_id]) {
-            if (i2c_err_source[controller_id] & I2C_ABRT_7B_ADDR_NOACK) {
-                return I2C_ERROR_ADDRESS_NOACK; // NACK on transmit of address
-            } else if (i2c_err_source[controller_id] & I2C_ABRT_TXDATA_NOACK) {
-                return I2C_ERROR_DATA_NOACK; // NACK on transmit of data
-            } else {
-                return I2C_ERROR_OTHER; // other error
-            }
+            return wait_done(controller_id, start,
+                             err_status(i2c_err_source[controller_id]));
         }
         if (i2c_rx_complete[controller_id]) {
-            return I2C_OK;
+            return wait_done(controller_id, start, I2C_OK);
         }
-        delayMicroseconds(10);
-    }
+        if (fiberYield) fiberYield();
+    } while (cycles() - start < timeout);
 
-    return I2C_TIMEOUT;
+    STAT_ADD(controller_id, timeouts, 1);
+    return wait_done(controller_id, start, I2C_TIMEOUT);
 }
 
 static int wait_tx_or_err(I2C_CONTROLLER controller_id)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
+    uint32_t start = cycles();
 
-    while (timeout--) {
+    do {
         if (i2c_err_detect[controller_id]) {
-            if (i2c_err_source[controller_id] & I2C_ABRT_7B_ADDR_NOACK) {
-                return I2C_ERROR_ADDRESS_NOACK; // NACK on transmit of address
-            } else if (i2c_err_source[controller_id] & I2C_ABRT_TXDATA_NOACK) {
-                return I2C_ERROR_DATA_NOACK; // NACK on transmit of data
-            } else {
-                return I2C_ERROR_OTHER; // other error
-            }
+            return wait_done(controller_id, start,
+                             err_status(i2c_err_source[controller_id]));
         }
         if (i2c_tx_complete[controller_id]) {
-            return I2C_OK;
+            return wait_done(controller_id, start, I2C_OK);
         }
-        delayMicroseconds(10);
-    }
-    return I2C_TIMEOUT;
+        if (fiberYield) fiberYield();
+    } while (cycles() - start < TIMEOUT_CYCLES);
+    STAT_ADD(controller_id, timeouts, 1);
+    return wait_done(controller_id, start, I2C_TIMEOUT);
 }
 
-static int wait_dev_ready(I2C_CONTROLLER controller_id, bool no_stop)
+static int wait_dev_ready(I2C_CONTROLLER controller_id, bool no_stop,
+                          uint32_t timeout)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
+    uint32_t start = cycles();
     int ret = 0;
 
-    while (timeout--) {
+    do {
         ret = ss_i2c_status(controller_id, no_stop);
         if (ret == I2C_OK) {
-            return I2C_OK;
+            return wait_done(controller_id, start, I2C_OK);
         } else if (ret == I2C_BUSY) {
-            delayMicroseconds(10);
+            if (fiberYield) fiberYield();
         } else {
-            return I2C_TIMEOUT - ret;
+            return wait_done(controller_id, start, I2C_TIMEOUT - ret);
         }
+    } while (cycles() - start < timeout);
+    STAT_ADD(controller_id, timeouts, 1);
+    return wait_done(controller_id, start, I2C_TIMEOUT - ret);
+}
+
+/* Cycles taken by bits SCL periods at the current clock */
+static uint32_t scl_cycles(I2C_CONTROLLER controller_id, uint32_t bits)
+{
+    uint32_t hz = i2c_scl_hz[controller_id];
+
+    return hz ? bits * ((uint32_t)CLOCK_SPEED * 1000000 / hz) : TIMEOUT_CYCLES;
+}
+
+/* The blocking calls share the completion flags with the queue */
+static void wait_queue_idle(I2C_CONTROLLER controller_id)
+{
+    uint32_t start;
+
+    if (!i2c_queue_head[controller_id])
+        return;
+    start = cycles();
+    while (i2c_queue_head[controller_id]) {
+        if (fiberYield) fiberYield();
     }
-    return I2C_TIMEOUT - ret;
+    wait_done(controller_id, start, 0);
 }
 
 int i2c_openadapter(I2C_CONTROLLER controller_id)
@@ -163,10 +267,11 @@ int i2c_openadapter(I2C_CONTROLLER controller_id)
     i2c_rx_complete[controller_id] = 0;
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
+    i2c_scl_hz[controller_id] = i2c_cfg.speed == I2C_SLOW ? 100000 : 400000;
 
     ss_i2c_set_config(controller_id, &i2c_cfg);
     ss_i2c_clock_enable(controller_id);
-    ret = wait_dev_ready(controller_id, false);
+    ret = wait_dev_ready(controller_id, false, TIMEOUT_CYCLES);
 
     return ret;
 }
@@ -207,34 +312,55 @@ int i2c_openadapter_speed(I2C_CONTROLLER controller_id, int i2c_speed)
     i2c_rx_complete[controller_id] = 0;
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
+    i2c_scl_hz[controller_id] = i2c_cfg.speed == I2C_SLOW ? 100000 : 400000;
 
     ss_i2c_set_config(controller_id, &i2c_cfg);
     ss_i2c_clock_enable(controller_id);
-    ret = wait_dev_ready(controller_id, false);
+    ret = wait_dev_ready(controller_id, false, TIMEOUT_CYCLES);
 
     return ret;
 }
 
+int i2c_setclock(I2C_CONTROLLER controller_id, uint32_t hz)
+{
+    int ret;
+
+    wait_queue_idle(controller_id);
+    ret = wait_dev_ready(controller_id, false, TIMEOUT_CYCLES);
+    if (ret)
+        return ret;
+    if (!ss_i2c_set_clock)
+        return i2c_openadapter_speed(controller_id,
+                                     hz >= 400000 ? I2C_FAST : I2C_SLOW);
+    if (ss_i2c_set_clock(controller_id, hz) != DRV_RC_OK)
+        return I2C_ERROR;
+    i2c_scl_hz[controller_id] = hz;
+    return I2C_OK;
+}
+
 void i2c_setslave(I2C_CONTROLLER controller_id, uint8_t addr)
 {
     i2c_slave[controller_id] = addr;
     return;
 }
 
-int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, uint8_t length,
+int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, int length,
                    bool no_stop)
 {
     int ret;
 
+    wait_queue_idle(controller_id);
+
     i2c_tx_complete[controller_id] = 0;
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
+    STAT_ADD(controller_id, transactions, 1);
     ss_i2c_transfer(controller_id, bytes, length, 0, 0,
                     i2c_slave[controller_id], no_stop);
     ret = wait_tx_or_err(controller_id);
-    if (ret)
-        return ret;
-    ret = wait_dev_ready(controller_id, no_stop);
+    if (!ret)
+        ret = wait_dev_ready(controller_id, no_stop, TIMEOUT_CYCLES);
+    stat_result(controller_id, ret, length);
     if (ret)
         return ret;
     return length;
@@ -245,16 +371,247 @@ int i2c_readbytes(I2C_CONTROLLER controller_id, uint8_t *buf, int length,
 {
     int ret;
 
+    wait_queue_idle(controller_id);
+
     i2c_rx_complete[controller_id] = 0;
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
+    STAT_ADD(controller_id, transactions, 1);
     ss_i2c_transfer(controller_id, 0, 0, buf, length, i2c_slave[controller_id],
                     no_stop);
-    ret = wait_rx_or_err(controller_id);
+    ret = wait_rx_or_err(controller_id, TIMEOUT_CYCLES);
+    if (!ret)
+        ret = wait_dev_ready(controller_id, no_stop, TIMEOUT_CYCLES);
+    stat_result(controller_id, ret, length);
     if (ret)
         return ret;
-    ret = wait_dev_ready(controller_id, no_stop);
+    return length;
+}
+
+int i2c_writeread(I2C_CONTROLLER controller_id, const uint8_t *tx, int tx_len,
+                  uint8_t *rx, int rx_len)
+{
+    int ret;
+
+    wait_queue_idle(controller_id);
+
+    if (rx_len == 0) {
+        ret = i2c_writebytes(controller_id, (uint8_t *)tx, tx_len, false);
+        return ret < 0 ? ret : 0;
+    }
+
+    /* The controller sends tx, then a repeated start and the reads: one
+     * transfer and one completion (rx) */
+    i2c_rx_complete[controller_id] = 0;
+    i2c_err_detect[controller_id] = 0;
+    i2c_err_source[controller_id] = 0;
+    STAT_ADD(controller_id, transactions, 1);
+    ss_i2c_transfer(controller_id, (uint8_t *)tx, tx_len, rx, rx_len,
+                    i2c_slave[controller_id], false);
+    ret = wait_rx_or_err(controller_id, TIMEOUT_CYCLES);
+    if (!ret)
+        ret = wait_dev_ready(controller_id, false, TIMEOUT_CYCLES);
+    stat_result(controller_id, ret, tx_len + rx_len);
     if (ret)
         return ret;
-    return length;
+    return rx_len;
+}
+
+/* Puts the head of the queue on the bus, or has i2c_queue_retry() do it.
+ * Without a STOP the previous transfer may still have commands in the TX
+ * FIFO, which ss_i2c_transfer() refuses, and after an abort the address
+ * can't change until the master is idle; both clear within a few byte
+ * times. Called with the interrupts locked or from a driver callback. */
+static void i2c_queue_try(I2C_CONTROLLER controller_id)
+{
+    i2c_xfer_t *xfer = i2c_queue_head[controller_id];
+    uint32_t waited = cycles() - i2c_queue_since[controller_id];
+
+    /* After an abort the master is given as long as a probe to go idle,
+     * then the transfer starts regardless */
+    if (i2c_queue_abort[controller_id] &&
+        (ss_i2c_status(controller_id, false) != I2C_BUSY ||
+         waited >= scl_cycles(controller_id, PROBE_BITS) + PROBE_SLACK_CYCLES))
+        i2c_queue_abort[controller_id] = false;
+
+    if (!i2c_queue_abort[controller_id]) {
+        if (ss_i2c_transfer(controller_id, (uint8_t *)xfer->tx, xfer->tx_len,
+                            xfer->rx, xfer->rx_len, xfer->addr,
+                            !xfer->stop) == DRV_RC_OK)
+            return;
+        STAT_ADD(controller_id, retries, 1);
+        if (waited >= TIMEOUT_CYCLES) {
+            STAT_ADD(controller_id, timeouts, 1);
+            i2c_queue_done(controller_id, I2C_TIMEOUT);
+            return;
+        }
+    }
+
+    /* Fails at once if every hwtimer is taken */
+    if (hwtimerStart(&i2c_queue_timer[controller_id],
+                     scl_cycles(controller_id, 9), 0) != 0)
+        i2c_queue_done(controller_id, I2C_ERROR);
+}
+
+static void i2c_queue_start(I2C_CONTROLLER controller_id)
+{
+    STAT_ADD(controller_id, transactions, 1);
+    i2c_queue_since[controller_id] = cycles();
+    i2c_queue_try(controller_id);
+}
+
+/* timer1 interrupt, which may preempt the I2C ones */
+static void i2c_queue_retry(void *arg)
+{
+    I2C_CONTROLLER controller_id = (I2C_CONTROLLER)(uintptr_t)arg;
+    uint32_t saved = interrupt_lock();
+
+    if (i2c_queue_head[controller_id])
+        i2c_queue_try(controller_id);
+    interrupt_unlock(saved);
+}
+
+/* From the driver callbacks: completes the head transfer and starts the
+ * next one straight away */
+static void i2c_queue_done(I2C_CONTROLLER controller_id, int status)
+{
+    i2c_xfer_t *xfer = i2c_queue_head[controller_id];
+
+    stat_result(controller_id, status, xfer->tx_len + xfer->rx_len);
+
+    /* An abort is reported before its STOP is on the bus */
+    i2c_queue_abort[controller_id] = (status != I2C_OK);
+
+    i2c_queue_head[controller_id] = xfer->next;
+    if (!xfer->next)
+        i2c_queue_tail[controller_id] = NULL;
+    else
+        i2c_queue_start(controller_id);
+
+    xfer->status = status;
+    if (xfer->callback)
+        xfer->callback(xfer);
+}
+
+int i2c_submit(I2C_CONTROLLER controller_id, i2c_xfer_t *xfer)
+{
+    uint32_t saved;
+
+    if (xfer->tx_len == 0 && xfer->rx_len == 0)
+        return I2C_ERROR;
+
+    xfer->status = I2C_PENDING;
+    xfer->next = NULL;
+
+    saved = interrupt_lock();
+    if (i2c_queue_tail[controller_id]) {
+        i2c_queue_tail[controller_id]->next = xfer;
+        i2c_queue_tail[controller_id] = xfer;
+    } else {
+        i2c_queue_head[controller_id] = i2c_queue_tail[controller_id] = xfer;
+        i2c_queue_start(controller_id);
+    }
+    interrupt_unlock(saved);
+    return I2C_OK;
+}
+
+int i2c_queue_busy(I2C_CONTROLLER controller_id)
+{
+    return i2c_queue_head[controller_id] != NULL;
+}
+
+int i2c_scan(I2C_CONTROLLER controller_id, uint8_t *bitmap)
+{
+    uint32_t timeout;
+    uint8_t temp;
+    int addr, ret, found = 0;
+
+    memset(bitmap, 0, I2C_SCAN_BYTES);
+    if (!i2c_scl_hz[controller_id])
+        return I2C_ERROR;
+
+    wait_queue_idle(controller_id);
+    timeout = 4 * scl_cycles(controller_id, PROBE_BITS) + PROBE_SLACK_CYCLES;
+
+    for (addr = I2C_SCAN_FIRST; addr <= I2C_SCAN_LAST; addr++) {
+        /* Both lengths 0 makes the driver read one byte and discard it */
+        i2c_rx_complete[controller_id] = 0;
+        i2c_err_detect[controller_id] = 0;
+        i2c_err_source[controller_id] = 0;
+        STAT_ADD(controller_id, transactions, 1);
+        if (ss_i2c_transfer(controller_id, 0, 0, &temp, 0, addr, false) !=
+            DRV_RC_OK)
+            return I2C_ERROR;
+        ret = wait_rx_or_err(controller_id, timeout);
+        if (ret == I2C_TIMEOUT)
+            return ret;
+        if (ret == I2C_OK) {
+            bitmap[addr >> 3] |= 1 << (addr & 7);
+            found++;
+        }
+        /* After a NACK the STOP is still going out */
+        ret = wait_dev_ready(controller_id, false, timeout);
+        if (ret)
+            return ret;
+    }
+    return found;
+}
+
+int i2c_read_batch(I2C_CONTROLLER controller_id, const uint8_t *addrs,
+                   int count, uint8_t reg, uint8_t *data, int len,
+                   int *status)
+{
+    i2c_xfer_t xfer[I2C_BATCH_MAX];
+    int i, n, done = 0, found = 0;
+
+    if (count < 0 || len <= 0)
+        return I2C_ERROR;
+
+    while (done < count) {
+        n = count - done < I2C_BATCH_MAX ? count - done : I2C_BATCH_MAX;
+        for (i = 0; i < n; i++) {
+            memset(&xfer[i], 0, sizeof(xfer[i]));
+            xfer[i].addr = addrs[done + i];
+            xfer[i].stop = true;
+            xfer[i].tx = &reg;
+            xfer[i].tx_len = 1;
+            xfer[i].rx = data + (done + i) * len;
+            xfer[i].rx_len = len;
+            i2c_submit(controller_id, &xfer[i]);
+        }
+
+        /* The queue runs in order, so the last one finishes last */
+        while (xfer[n - 1].status == I2C_PENDING) {
+            if (fiberYield) fiberYield();
+        }
+
+        for (i = 0; i < n; i++) {
+            if (status)
+                status[done + i] = xfer[i].status;
+            if (xfer[i].status == I2C_OK)
+                found++;
+        }
+        done += n;
+    }
+    return found;
+}
+
+void i2c_get_stats(I2C_CONTROLLER controller_id, i2c_stats_t *stats)
+{
+#ifndef I2C_NO_STATS
+    uint32_t saved = interrupt_lock();
+    *stats = i2c_stats[controller_id];
+    interrupt_unlock(saved);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+void i2c_reset_stats(I2C_CONTROLLER controller_id)
+{
+#ifndef I2C_NO_STATS
+    uint32_t saved = interrupt_lock();
+    memset(&i2c_stats[controller_id], 0, sizeof(i2c_stats[controller_id]));
+    interrupt_unlock(saved);
+#endif
 }
@@ -37,14 +37,84 @@ extern "C"{
 #define I2C_ERROR_DATA_NOACK    (-3)
 #define I2C_ERROR_OTHER         (-4)
 
+#define I2C_PENDING             1      /* i2c_xfer_t status while queued */
+
 #define I2C_ABRT_7B_ADDR_NOACK  (1 << 0)
 #define I2C_ABRT_TXDATA_NOACK   (1 << 3)
 
 int i2c_openadapter(I2C_CONTROLLER controller_id);
 int i2c_openadapter_speed(I2C_CONTROLLER controller_id, int i2c_speed);
+/* Retunes SCL to hz, up to 1 MHz (Fm+), without reopening the adapter. A
+ * system library without ss_i2c_set_clock() reopens it at 400 kHz for hz
+ * from 400 kHz up, and 100 kHz below */
+int i2c_setclock(I2C_CONTROLLER controller_id, uint32_t hz);
 void i2c_setslave(I2C_CONTROLLER controller_id, uint8_t addr);
-int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, uint8_t length, bool no_stop);
+int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, int length, bool no_stop);
 int i2c_readbytes(I2C_CONTROLLER controller_id, uint8_t *buf, int length, bool no_stop);
+/* A transfer for i2c_submit(): writes tx_len bytes from tx, then reads
+ * rx_len bytes into rx after a repeated start, ending with a STOP if stop is
+ * set. Either length may be 0, not both. The descriptor and buffers belong
+ * to the queue until callback, from interrupt context, has been called or
+ * status is no longer I2C_PENDING. */
+typedef struct i2c_xfer {
+    uint8_t addr;
+    bool stop;
+    const uint8_t *tx;
+    uint32_t tx_len;
+    uint8_t *rx;
+    uint32_t rx_len;
+    void (*callback)(struct i2c_xfer *xfer);
+    void *arg;                 /* for the caller */
+    volatile int status;       /* I2C_PENDING, then I2C_OK or an error */
+    struct i2c_xfer *next;     /* used by the queue */
+} i2c_xfer_t;
+
+/* Queues a transfer and returns at once; queued transfers run back to back,
+ * the next one started from the completion interrupt of the one before, or
+ * from timer1 shortly after if the controller isn't ready for it yet. The
+ * blocking calls wait for the queue to empty first. */
+int i2c_submit(I2C_CONTROLLER controller_id, i2c_xfer_t *xfer);
+int i2c_queue_busy(I2C_CONTROLLER controller_id);
+
+/* Writes tx then reads rx_len bytes after a repeated start, in one transfer;
+ * returns rx_len or a negative error */
+int i2c_writeread(I2C_CONTROLLER controller_id, const uint8_t *tx, int tx_len,
+                  uint8_t *rx, int rx_len);
+
+/* Addresses probed by i2c_scan(); the rest are reserved */
+#define I2C_SCAN_FIRST  0x08
+#define I2C_SCAN_LAST   0x77
+#define I2C_SCAN_BYTES  16     /* bitmap size, one bit per 7-bit address */
+
+/* Probes every address with a one byte read, each allowed a few times its
+ * bus time, and sets bit (addr & 7) of bitmap[addr >> 3] for those that ACK.
+ * Returns the number found, or a negative error if the bus is stuck */
+int i2c_scan(I2C_CONTROLLER controller_id, uint8_t *bitmap);
+
+/* Reads len bytes from register reg of each of count devices, queued back to
+ * back with i2c_submit(). Device i's bytes go to data + i * len and, if
+ * status isn't NULL, its I2C_OK or error to status[i]. Returns the number
+ * of devices read */
+#define I2C_BATCH_MAX   8      /* transfers queued at a time */
+int i2c_read_batch(I2C_CONTROLLER controller_id, const uint8_t *addrs,
+                   int count, uint8_t reg, uint8_t *data, int len,
+                   int *status);
+
+/* Per controller counters, also kept for the SoC controllers by soc_i2c.c.
+ * Building with -DI2C_NO_STATS leaves them at 0 */
+typedef struct i2c_stats {
+    uint32_t transactions;     /* transfers started, blocking or queued */
+    uint32_t bytes;            /* data bytes of the ones that succeeded */
+    uint32_t nacks;            /* address or data NACKs */
+    uint32_t timeouts;
+    uint32_t retries;          /* queued starts refused, TX FIFO not empty,
+                                * each retried from timer1 */
+    uint64_t wait_cycles;      /* time in the wait loops, in cycles() */
+    uint32_t wait_max;         /* longest single wait, in cycles() */
+} i2c_stats_t;
+
+void i2c_get_stats(I2C_CONTROLLER controller_id, i2c_stats_t *stats);
+void i2c_reset_stats(I2C_CONTROLLER controller_id);
 
 #ifdef __cplusplus
 }
@@ -25,6 +25,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 void initVariant() __attribute__((weak));
 void initVariant() { }
 
+// Defined when the sketch uses Task.h
+extern "C" void tasksRun(void) __attribute__((weak));
+// Defined by libarc32drv builds with the deferred framework log
+extern "C" void log_process(void) __attribute__((weak));
+// BLE core bring-up, started by initVariant() and finished in the background
+extern "C" bool ble_cfw_service_poll(void) __attribute__((weak));
+// Defined when the sketch uses SystemStats.h
+extern "C" void systemStatsLoop(uint32_t start) __attribute__((weak));
+
 /*
  * \brief Main entry point of Arduino application
  */
@@ -40,12 +49,22 @@ int main( void )
 	USBDevice.attach();
 #endif
 
+	bootMark(BOOT_SETUP);
 	setup();
+	bootMark(BOOT_LOOP);
 
 	for (;;) /* This infinite loop is intentional and requested by design */
 	{
+		uint32_t start = cycles();
 		loop();
 		if (serialEventRun) serialEventRun();
+		if (tasksRun) tasksRun();
+		// framework log messages queued by interrupts and the BLE/IPC paths
+		if (log_process) log_process();
+		if (ble_cfw_service_poll && !bootReached(BOOT_BLE) && ble_cfw_service_poll())
+			bootMark(BOOT_BLE);
+		if (systemStatsLoop) systemStatsLoop(start);
+		idle();
 	}
 
 	return 0;
@@ -27,6 +27,11 @@ void *operator new[](size_t size) {
   return malloc(size);
 }
 
+void *operator new(size_t size, void * ptr) noexcept {
+  (void)size;
+  return ptr;
+}
+
 void operator delete(void * ptr) {
   free(ptr);
 }
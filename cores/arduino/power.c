@@ -0,0 +1,64 @@
+/*
+  power.c - reference counted peripheral clock gates
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "power.h"
+#include "scss_registers.h"
+#include "interrupt.h"
+
+static const struct {
+    uint32_t reg;
+    uint32_t mask;
+} gates[POWER_CLOCK_COUNT] = {
+    [POWER_CLOCK_I2C0]    = { PERIPH_CLK_GATE_CTRL,   I2C0_CLK_GATE_MASK },
+    [POWER_CLOCK_I2C1]    = { PERIPH_CLK_GATE_CTRL,   I2C1_CLK_GATE_MASK },
+    [POWER_CLOCK_SPI0]    = { PERIPH_CLK_GATE_CTRL,   1 << 14 },
+    [POWER_CLOCK_SPI1]    = { PERIPH_CLK_GATE_CTRL,   1 << 15 },
+    [POWER_CLOCK_SPIS]    = { PERIPH_CLK_GATE_CTRL,   1 << 16 },
+    [POWER_CLOCK_I2S]     = { PERIPH_CLK_GATE_CTRL,   I2S_CLK_GATE_MASK },
+    [POWER_CLOCK_PWM]     = { QRK_CLKGATE_CTRL,       QRK_CLKGATE_CTRL_PWM_ENABLE },
+    [POWER_CLOCK_SS_I2C0] = { SS_PERIPH_CLK_GATE_CTL, SS_I2C0_CLK_GATE_MASK },
+    [POWER_CLOCK_SS_I2C1] = { SS_PERIPH_CLK_GATE_CTL, SS_I2C1_CLK_GATE_MASK },
+    [POWER_CLOCK_SS_SPI0] = { SS_PERIPH_CLK_GATE_CTL, SS_SPI0_CLK_GATE_MASK },
+    [POWER_CLOCK_SS_SPI1] = { SS_PERIPH_CLK_GATE_CTL, SS_SPI1_CLK_GATE_MASK },
+};
+
+static uint8_t users[POWER_CLOCK_COUNT];
+
+void power_clock_acquire(enum power_clock clock)
+{
+    uint32_t key = interrupt_lock();
+
+    if (users[clock]++ == 0)
+        MMIO_REG_VAL(gates[clock].reg) |= gates[clock].mask;
+    interrupt_unlock(key);
+}
+
+void power_clock_release(enum power_clock clock)
+{
+    uint32_t key = interrupt_lock();
+
+    if (users[clock] && --users[clock] == 0)
+        MMIO_REG_VAL(gates[clock].reg) &= ~gates[clock].mask;
+    interrupt_unlock(key);
+}
+
+uint8_t power_clock_users(enum power_clock clock)
+{
+    return users[clock];
+}
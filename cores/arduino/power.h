@@ -0,0 +1,69 @@
+/*
+  power.h - reference counted peripheral clock gates
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Peripheral clocks of the SCSS gate registers. Drivers take their clock
+ * when they start and give it back when they are done, and the gate opens
+ * on the first user and closes after the last, so a peripheral nobody
+ * uses isn't clocked and two users of a shared gate can't switch it off
+ * under each other. A clock that was on at reset and is never taken is
+ * left alone. */
+enum power_clock {
+    POWER_CLOCK_I2C0,
+    POWER_CLOCK_I2C1,
+    POWER_CLOCK_SPI0,
+    POWER_CLOCK_SPI1,
+    POWER_CLOCK_SPIS,
+    POWER_CLOCK_I2S,
+    POWER_CLOCK_PWM,
+    POWER_CLOCK_SS_I2C0,
+    POWER_CLOCK_SS_I2C1,
+    POWER_CLOCK_SS_SPI0,
+    POWER_CLOCK_SS_SPI1,
+    POWER_CLOCK_COUNT
+};
+
+/*
+ * \brief Ungates clock for one more user. Safe from interrupts.
+ */
+extern void power_clock_acquire(enum power_clock clock);
+
+/*
+ * \brief Drops a user of clock, gating it when none is left.
+ */
+extern void power_clock_release(enum power_clock clock);
+
+/*
+ * \brief Number of users holding clock.
+ */
+extern uint8_t power_clock_users(enum power_clock clock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _POWER_H_ */
@@ -25,7 +25,18 @@
 #include "soc_i2c.h"
 #include "i2c.h"
 
+/* Only in a rebuilt system library; without it SCL runs at 100 or 400 kHz */
+extern DRIVER_API_RC soc_i2c_set_transfer_clock(SOC_I2C_CONTROLLER controller_id,
+                                                uint32_t hz) __attribute__((weak));
+/* Also only in a rebuilt system library; transfers use the FIFO without it */
+extern DRIVER_API_RC soc_i2c_master_set_dma(SOC_I2C_CONTROLLER controller_id,
+                                            bool enable) __attribute__((weak));
+
 #define TIMEOUT_MS 16
+/* timer0 runs at the CPU clock */
+#define TIMEOUT_CYCLES ((uint32_t)TIMEOUT_MS * 1000 * CLOCK_SPEED)
+/* added per byte: nine bits at 100 kHz, rounded up */
+#define BYTE_CYCLES ((uint32_t)100 * CLOCK_SPEED)
 
 static volatile uint8_t soc_i2c_master_tx_complete[NUM_SOC_I2C];
 static volatile uint8_t soc_i2c_master_rx_complete[NUM_SOC_I2C];
@@ -34,6 +45,35 @@ static volatile uint32_t soc_i2c_err_source[NUM_SOC_I2C];
 
 static volatile uint32_t soc_i2c_slave_address[NUM_SOC_I2C] = {0, 0};
 
+#ifndef I2C_NO_STATS
+static i2c_stats_t soc_i2c_stats[NUM_SOC_I2C];
+#define STAT_ADD(id, field, n) (soc_i2c_stats[id].field += (n))
+
+/* Counts the outcome of one transfer of bytes data bytes */
+static void stat_result(SOC_I2C_CONTROLLER controller_id, int ret, uint32_t bytes)
+{
+    if (ret >= 0)
+        soc_i2c_stats[controller_id].bytes += bytes;
+    else if (ret == I2C_ERROR_ADDRESS_NOACK || ret == I2C_ERROR_DATA_NOACK)
+        soc_i2c_stats[controller_id].nacks++;
+}
+
+/* Adds the time since start to the wait totals and passes ret through */
+static int wait_done(SOC_I2C_CONTROLLER controller_id, uint32_t start, int ret)
+{
+    uint32_t waited = cycles() - start;
+
+    soc_i2c_stats[controller_id].wait_cycles += waited;
+    if (waited > soc_i2c_stats[controller_id].wait_max)
+        soc_i2c_stats[controller_id].wait_max = waited;
+    return ret;
+}
+#else
+#define STAT_ADD(id, field, n) do {} while (0)
+#define stat_result(id, ret, bytes) do {} while (0)
+#define wait_done(id, start, ret) (ret)
+#endif
+
 static void soc_i2c0_master_rx_callback(uint32_t dev_id)
 {
     soc_i2c_master_rx_complete[SOC_I2C_0] = 1;
@@ -78,8 +118,57 @@ static void *soc_i2c0_slave_tx_user_cb_data_ptr = NULL;
 static void (*soc_i2c1_slave_tx_user_callback)(void *) = NULL;
 static void *soc_i2c1_slave_tx_user_cb_data_ptr = NULL;
 
+/* Slave ping-pong buffers, see soc_i2c_slave_set_rx_buffers() */
+static struct soc_i2c_slave_buffers {
+    uint8_t *rx_buf[2];
+    uint32_t rx_len;
+    uint8_t rx_cur;
+    uint32_t rx_seq;
+    void (*rx_cb)(const soc_i2c_slave_rx_t *xfer, void *arg);
+    void *rx_arg;
+
+    uint8_t *tx_buf[2];
+    uint32_t tx_len[2];
+    uint8_t tx_front;
+    volatile bool tx_pending;
+} soc_i2c_slave_buffers[NUM_SOC_I2C];
+
+/* The driver has ended the transfer and reset its count; nothing more is
+ * read from the FIFO until this returns */
+static void soc_i2c_slave_rx_swap(SOC_I2C_CONTROLLER controller_id, uint32_t bytes)
+{
+    struct soc_i2c_slave_buffers *b = &soc_i2c_slave_buffers[controller_id];
+    soc_i2c_slave_rx_t xfer;
+
+    if (!b->rx_buf[0])
+        return;
+    xfer.buf = b->rx_buf[b->rx_cur];
+    xfer.bytes = bytes;
+    xfer.timestamp = micros32();
+    xfer.seq = b->rx_seq++;
+    b->rx_cur ^= 1;
+    soc_i2c_slave_enable_rx(controller_id, b->rx_buf[b->rx_cur], b->rx_len);
+    if (b->rx_cb)
+        b->rx_cb(&xfer, b->rx_arg);
+}
+
+/* A read request found the TX buffer empty */
+static void soc_i2c_slave_tx_swap(SOC_I2C_CONTROLLER controller_id)
+{
+    struct soc_i2c_slave_buffers *b = &soc_i2c_slave_buffers[controller_id];
+
+    if (!b->tx_buf[0])
+        return;
+    if (b->tx_pending) {
+        b->tx_front ^= 1;
+        b->tx_pending = false;
+    }
+    soc_i2c_slave_enable_tx(controller_id, b->tx_buf[b->tx_front], b->tx_len[b->tx_front]);
+}
+
 static void soc_i2c0_slave_rx_callback(uint32_t bytes)
 {
+    soc_i2c_slave_rx_swap(SOC_I2C_0, bytes);
     if (soc_i2c0_slave_rx_user_callback) {
       soc_i2c0_slave_rx_user_callback((int)bytes, soc_i2c0_slave_rx_user_cb_data_ptr);
     }
@@ -87,6 +176,7 @@ static void soc_i2c0_slave_rx_callback(uint32_t bytes)
 
 static void soc_i2c1_slave_rx_callback(uint32_t bytes)
 {
+    soc_i2c_slave_rx_swap(SOC_I2C_1, bytes);
     if (soc_i2c1_slave_rx_user_callback) {
       soc_i2c1_slave_rx_user_callback((int)bytes, soc_i2c1_slave_rx_user_cb_data_ptr);
     }
@@ -97,6 +187,7 @@ static void soc_i2c0_slave_tx_callback(uint32_t bytes)
     if (soc_i2c0_slave_tx_user_callback) {
         soc_i2c0_slave_tx_user_callback(soc_i2c0_slave_tx_user_cb_data_ptr);
     }
+    soc_i2c_slave_tx_swap(SOC_I2C_0);
 }
 
 static void soc_i2c1_slave_tx_callback(uint32_t bytes)
@@ -104,6 +195,7 @@ static void soc_i2c1_slave_tx_callback(uint32_t bytes)
     if (soc_i2c1_slave_tx_user_callback) {
         soc_i2c1_slave_tx_user_callback(soc_i2c1_slave_tx_user_cb_data_ptr);
     }
+    soc_i2c_slave_tx_swap(SOC_I2C_1);
 }
 
 void soc_i2c_slave_set_rx_user_callback(SOC_I2C_CONTROLLER controller_id, void (*onReceiveCallback)(int, void *), void *callerDataPtr)
@@ -128,67 +220,69 @@ void soc_i2c_slave_set_tx_user_callback(SOC_I2C_CONTROLLER controller_id, void (
   }
 }
 
-static int soc_i2c_master_wait_rx_or_err(SOC_I2C_CONTROLLER controller_id)
+static int soc_i2c_master_wait_rx_or_err(SOC_I2C_CONTROLLER controller_id,
+                                         int length)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
-    while (timeout--) {
+    uint32_t start = cycles();
+    uint32_t limit = TIMEOUT_CYCLES + (uint32_t)length * BYTE_CYCLES;
+    do {
         if (soc_i2c_err_detect[controller_id]) {
             if (soc_i2c_err_source[controller_id] &
 		(I2C_ABRT_7B_ADDR_NOACK | I2C_ABRT_10ADDR1_NOACK | I2C_ABRT_10ADDR2_NOACK)) {
-	      return I2C_ERROR_ADDRESS_NOACK; // NACK on transmit of address
+	      return wait_done(controller_id, start, I2C_ERROR_ADDRESS_NOACK); // NACK on transmit of address
             }
 	    else if (soc_i2c_err_source[controller_id] & I2C_ABRT_TXDATA_NOACK) {
-	      return I2C_ERROR_DATA_NOACK; // NACK on transmit of data
+	      return wait_done(controller_id, start, I2C_ERROR_DATA_NOACK); // NACK on transmit of data
             } else {
-	      return I2C_ERROR_OTHER; // other error
+	      return wait_done(controller_id, start, I2C_ERROR_OTHER); // other error
             }
         }
         if (soc_i2c_master_rx_complete[controller_id]) {
-            return I2C_OK;
+            return wait_done(controller_id, start, I2C_OK);
         }
-        delayMicroseconds(10);
-    }
-    return I2C_TIMEOUT;
+    } while (cycles() - start < limit);
+    STAT_ADD(controller_id, timeouts, 1);
+    return wait_done(controller_id, start, I2C_TIMEOUT);
 }
 
-static int soc_i2c_master_wait_tx_or_err(SOC_I2C_CONTROLLER controller_id)
+static int soc_i2c_master_wait_tx_or_err(SOC_I2C_CONTROLLER controller_id,
+                                         int length)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
-    while (timeout--) {
+    uint32_t start = cycles();
+    uint32_t limit = TIMEOUT_CYCLES + (uint32_t)length * BYTE_CYCLES;
+    do {
         if (soc_i2c_err_detect[controller_id]) {
             if (soc_i2c_err_source[controller_id] &
 		(I2C_ABRT_7B_ADDR_NOACK | I2C_ABRT_10ADDR1_NOACK | I2C_ABRT_10ADDR2_NOACK)) {
-	      return I2C_ERROR_ADDRESS_NOACK; // NACK on transmit of address
+	      return wait_done(controller_id, start, I2C_ERROR_ADDRESS_NOACK); // NACK on transmit of address
             }
 	    else if (soc_i2c_err_source[controller_id] & I2C_ABRT_TXDATA_NOACK) {
-	      return I2C_ERROR_DATA_NOACK; // NACK on transmit of data
+	      return wait_done(controller_id, start, I2C_ERROR_DATA_NOACK); // NACK on transmit of data
             } else {
-	      return I2C_ERROR_OTHER; // other error
+	      return wait_done(controller_id, start, I2C_ERROR_OTHER); // other error
             }
         }
         if (soc_i2c_master_tx_complete[controller_id]) {
-            return I2C_OK;
+            return wait_done(controller_id, start, I2C_OK);
         }
-        delayMicroseconds(10);
-    }
-    return I2C_TIMEOUT;
+    } while (cycles() - start < limit);
+    STAT_ADD(controller_id, timeouts, 1);
+    return wait_done(controller_id, start, I2C_TIMEOUT);
 }
 
 static int soc_i2c_wait_dev_ready(SOC_I2C_CONTROLLER controller_id,
                                   bool no_stop)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
+    uint32_t start = cycles();
     int ret = 0;
-    while (timeout--) {
+    do {
         ret = soc_i2c_status(controller_id, no_stop);
         if (ret == I2C_OK) {
-            return I2C_OK;
-        }
-        if (ret == I2C_BUSY) {
-            delayMicroseconds(10);
+            return wait_done(controller_id, start, I2C_OK);
         }
-    }
-    return I2C_TIMEOUT - ret;
+    } while (cycles() - start < TIMEOUT_CYCLES);
+    STAT_ADD(controller_id, timeouts, 1);
+    return wait_done(controller_id, start, I2C_TIMEOUT - ret);
 }
 
 int soc_i2c_open_adapter(SOC_I2C_CONTROLLER controller_id, uint32_t address, int i2c_speed, int i2c_addr_mode)
@@ -254,6 +348,8 @@ int soc_i2c_open_adapter(SOC_I2C_CONTROLLER controller_id, uint32_t address, int
 
 void soc_i2c_close_adapter(SOC_I2C_CONTROLLER controller_id)
 {
+    if (soc_i2c_master_set_dma)
+        soc_i2c_master_set_dma(controller_id, false);
     soc_i2c_deconfig(controller_id);
     soc_i2c_clock_disable(controller_id);
 
@@ -273,6 +369,22 @@ void soc_i2c_set_speed(SOC_I2C_CONTROLLER controller_id, uint32_t speed)
     soc_i2c_set_transfer_speed(controller_id, speed);
 }
 
+int soc_i2c_set_clock(SOC_I2C_CONTROLLER controller_id, uint32_t hz)
+{
+    if (!soc_i2c_set_transfer_clock) {
+        soc_i2c_set_transfer_speed(controller_id, hz >= 400000 ? I2C_FAST : I2C_SLOW);
+        return I2C_OK;
+    }
+    return soc_i2c_set_transfer_clock(controller_id, hz) == DRV_RC_OK ? I2C_OK : I2C_ERROR;
+}
+
+int soc_i2c_set_dma(SOC_I2C_CONTROLLER controller_id, bool enable)
+{
+    if (!soc_i2c_master_set_dma)
+        return enable ? I2C_ERROR : I2C_OK;
+    return soc_i2c_master_set_dma(controller_id, enable) == DRV_RC_OK ? I2C_OK : I2C_ERROR;
+}
+
 void soc_i2c_set_address_mode(SOC_I2C_CONTROLLER controller_id, uint32_t mode)
 {
     soc_i2c_set_transfer_mode(controller_id, mode);
@@ -294,19 +406,78 @@ void soc_i2c_slave_set_tx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t
     soc_i2c_slave_enable_tx(controller_id, buffer, length);
 }
 
-int soc_i2c_master_witebytes(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, uint8_t length, bool no_stop)
+void soc_i2c_slave_set_rx_buffers(SOC_I2C_CONTROLLER controller_id, uint8_t *buf0, uint8_t *buf1,
+                                  uint32_t length,
+                                  void (*callback)(const soc_i2c_slave_rx_t *xfer, void *arg), void *arg)
+{
+    struct soc_i2c_slave_buffers *b = &soc_i2c_slave_buffers[controller_id];
+    uint32_t saved = interrupt_lock();
+
+    if (!buf0 || !buf1) {
+        b->rx_buf[0] = b->rx_buf[1] = NULL;
+    } else {
+        b->rx_buf[0] = buf0;
+        b->rx_buf[1] = buf1;
+        b->rx_len = length;
+        b->rx_cur = 0;
+        b->rx_seq = 0;
+        b->rx_cb = callback;
+        b->rx_arg = arg;
+        soc_i2c_slave_enable_rx(controller_id, buf0, length);
+    }
+    interrupt_unlock(saved);
+}
+
+void soc_i2c_slave_set_tx_buffers(SOC_I2C_CONTROLLER controller_id, uint8_t *buf0, uint8_t *buf1)
+{
+    struct soc_i2c_slave_buffers *b = &soc_i2c_slave_buffers[controller_id];
+    uint32_t saved = interrupt_lock();
+
+    if (!buf0 || !buf1) {
+        b->tx_buf[0] = b->tx_buf[1] = NULL;
+    } else {
+        b->tx_buf[0] = buf0;
+        b->tx_buf[1] = buf1;
+        b->tx_len[0] = b->tx_len[1] = 0;
+        b->tx_front = 0;
+        b->tx_pending = false;
+    }
+    interrupt_unlock(saved);
+}
+
+uint8_t *soc_i2c_slave_tx_next(SOC_I2C_CONTROLLER controller_id)
+{
+    struct soc_i2c_slave_buffers *b = &soc_i2c_slave_buffers[controller_id];
+
+    if (!b->tx_buf[0] || b->tx_pending)
+        return NULL;
+    return b->tx_buf[b->tx_front ^ 1];
+}
+
+void soc_i2c_slave_tx_publish(SOC_I2C_CONTROLLER controller_id, uint32_t length)
+{
+    struct soc_i2c_slave_buffers *b = &soc_i2c_slave_buffers[controller_id];
+
+    if (!b->tx_buf[0] || b->tx_pending)
+        return;
+    b->tx_len[b->tx_front ^ 1] = length;
+    b->tx_pending = true;
+}
+
+int soc_i2c_master_witebytes(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, int length, bool no_stop)
 {
     int ret;
 
     soc_i2c_master_tx_complete[controller_id] = 0;
     soc_i2c_err_detect[controller_id] = 0;
     soc_i2c_err_source[controller_id] = 0;
+    STAT_ADD(controller_id, transactions, 1);
     soc_i2c_master_transfer(controller_id, buf, length, 0, 0,
 			    soc_i2c_slave_address[controller_id], no_stop);
-    ret = soc_i2c_master_wait_tx_or_err(controller_id);
-    if (ret)
-        return ret;
-    ret = soc_i2c_wait_dev_ready(controller_id, no_stop);
+    ret = soc_i2c_master_wait_tx_or_err(controller_id, length);
+    if (!ret)
+        ret = soc_i2c_wait_dev_ready(controller_id, no_stop);
+    stat_result(controller_id, ret, length);
     if (ret)
         return ret;
     return length;
@@ -319,13 +490,34 @@ int soc_i2c_master_readbytes(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, int
     soc_i2c_master_rx_complete[controller_id] = 0;
     soc_i2c_err_detect[controller_id] = 0;
     soc_i2c_err_source[controller_id] = 0;
+    STAT_ADD(controller_id, transactions, 1);
     soc_i2c_master_transfer(controller_id, 0, 0, buf, length,
 			    soc_i2c_slave_address[controller_id], no_stop);
-    ret = soc_i2c_master_wait_rx_or_err(controller_id);
-    if (ret)
-        return ret;
-    ret = soc_i2c_wait_dev_ready(controller_id, no_stop);
+    ret = soc_i2c_master_wait_rx_or_err(controller_id, length);
+    if (!ret)
+        ret = soc_i2c_wait_dev_ready(controller_id, no_stop);
+    stat_result(controller_id, ret, length);
     if (ret)
         return ret;
     return length;
 }
+
+void soc_i2c_get_stats(SOC_I2C_CONTROLLER controller_id, i2c_stats_t *stats)
+{
+#ifndef I2C_NO_STATS
+    uint32_t saved = interrupt_lock();
+    *stats = soc_i2c_stats[controller_id];
+    interrupt_unlock(saved);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+void soc_i2c_reset_stats(SOC_I2C_CONTROLLER controller_id)
+{
+#ifndef I2C_NO_STATS
+    uint32_t saved = interrupt_lock();
+    memset(&soc_i2c_stats[controller_id], 0, sizeof(soc_i2c_stats[controller_id]));
+    interrupt_unlock(saved);
+#endif
+}
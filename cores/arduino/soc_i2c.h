@@ -25,6 +25,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include "intel_qrk_i2c.h"
+#include "i2c.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,15 +37,50 @@ extern "C" {
 int soc_i2c_open_adapter(SOC_I2C_CONTROLLER controller_id, uint32_t address, int i2c_speed, int i2c_addr_mode);
 void soc_i2c_close_adapter(SOC_I2C_CONTROLLER controller_id);
 void soc_i2c_set_speed(SOC_I2C_CONTROLLER controller_id, uint32_t speed);
+/* Any SCL rate up to 1 MHz (Fm+), only between transfers; 100 or 400 kHz
+ * with a system library that lacks soc_i2c_set_transfer_clock() */
+int soc_i2c_set_clock(SOC_I2C_CONTROLLER controller_id, uint32_t hz);
+/* Once enabled, master reads or writes of more than 16 bytes go through two
+ * DMA channels, held until disabled; buffers in DCCM still use the FIFO.
+ * Fails to enable with a system library that has no I2C DMA */
+int soc_i2c_set_dma(SOC_I2C_CONTROLLER controller_id, bool enable);
 void soc_i2c_set_address_mode(SOC_I2C_CONTROLLER controller_id, uint32_t mode);
 void soc_i2c_master_set_slave_address(SOC_I2C_CONTROLLER controller_id, uint32_t addr);
-int soc_i2c_master_witebytes(SOC_I2C_CONTROLLER controller_id, uint8_t *bytes, uint8_t length, bool no_stop);
+int soc_i2c_master_witebytes(SOC_I2C_CONTROLLER controller_id, uint8_t *bytes, int length, bool no_stop);
 int soc_i2c_master_readbytes(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, int length, bool no_stop);
   void soc_i2c_slave_set_rx_user_callback(SOC_I2C_CONTROLLER controller_id, void (*onReceiveCallback)(int, void *), void *callerDataPtr);
 void soc_i2c_slave_set_tx_user_callback(SOC_I2C_CONTROLLER controller_id, void (*onRequestCallback)(void *), void *callerDataPtr);
 void soc_i2c_slave_set_rx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint8_t length);
 void soc_i2c_slave_set_tx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint8_t length);
 
+/* A slave receive completed into a ping-pong buffer */
+typedef struct soc_i2c_slave_rx {
+    uint8_t *buf;
+    uint32_t bytes;
+    uint32_t timestamp;     /* micros32() at the end of the transfer */
+    uint32_t seq;           /* counts transfers; a gap means one was missed */
+} soc_i2c_slave_rx_t;
+
+/* Slave receives alternate between buf0 and buf1, each length bytes, so the
+ * next transfer streams into one while the last is processed from the
+ * other. callback runs from the interrupt as each transfer ends; its buffer
+ * stays untouched until the transfer after the next one starts. NULL
+ * buffers go back to soc_i2c_slave_set_rx_user_buffer(). */
+void soc_i2c_slave_set_rx_buffers(SOC_I2C_CONTROLLER controller_id, uint8_t *buf0, uint8_t *buf1,
+                                  uint32_t length,
+                                  void (*callback)(const soc_i2c_slave_rx_t *xfer, void *arg), void *arg);
+/* Slave transmit from two buffers: the master reads the published one while
+ * the next reply is written into soc_i2c_slave_tx_next(), which returns
+ * NULL while a published reply hasn't been picked up yet. Publishing takes
+ * effect at the next read request, never in the middle of a read. */
+void soc_i2c_slave_set_tx_buffers(SOC_I2C_CONTROLLER controller_id, uint8_t *buf0, uint8_t *buf1);
+uint8_t *soc_i2c_slave_tx_next(SOC_I2C_CONTROLLER controller_id);
+void soc_i2c_slave_tx_publish(SOC_I2C_CONTROLLER controller_id, uint32_t length);
+
+/* Master transfer counters, as i2c_get_stats() */
+void soc_i2c_get_stats(SOC_I2C_CONTROLLER controller_id, i2c_stats_t *stats);
+void soc_i2c_reset_stats(SOC_I2C_CONTROLLER controller_id);
+
 #ifdef __cplusplus
 }
 #endif
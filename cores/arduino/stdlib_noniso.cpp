@@ -26,6 +26,24 @@
 
 #define ASCII_ZERO  0x30
 
+// "00".."99", so decimal conversion can emit two digits per division
+static const char digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const unsigned long pow10[10] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+    100000000UL, 1000000000UL
+};
+
 int atoi(const char* s) {
     return (int) atol(s);
 }
@@ -52,6 +70,66 @@ void reverse(char* begin, char* end) {
     }
 }
 
+char* ultoa10( unsigned long val, char *end )
+{
+    // division by a constant compiles to a multiply by its reciprocal
+    while (val >= 100) {
+        unsigned long q = val / 100;
+        const char *d = &digitPairs[(val - q * 100) * 2];
+        *--end = d[1];
+        *--end = d[0];
+        val = q;
+    }
+    if (val >= 10) {
+        const char *d = &digitPairs[val * 2];
+        *--end = d[1];
+        *--end = d[0];
+    } else {
+        *--end = ASCII_ZERO + val;
+    }
+    return end;
+}
+
+char* ulltoa10( unsigned long long val, char *end )
+{
+    // peel off nine-digit chunks with at most two 64-bit divisions and
+    // convert each with 32-bit arithmetic
+    while (val > 0xFFFFFFFFULL) {
+        unsigned long long q = val / 1000000000ULL;
+        char *start = ultoa10((unsigned long)(val - q * 1000000000ULL), end);
+        end -= 9;
+        while (start > end)
+            *--start = ASCII_ZERO;
+        val = q;
+    }
+    return ultoa10((unsigned long)val, end);
+}
+
+// radix 10 and powers of two avoid a division per digit
+static char* ultoa_radix( unsigned long v, char *end, int radix )
+{
+    if (radix == 10)
+        return ultoa10(v, end);
+
+    if ((radix & (radix - 1)) == 0) {
+        int shift = __builtin_ctz(radix);
+        unsigned long mask = radix - 1;
+        do {
+            int i = v & mask;
+            *--end = (i < 10) ? i + '0' : i + 'a' - 10;
+            v >>= shift;
+        } while (v);
+        return end;
+    }
+
+    do {
+        int i = v % radix;
+        v = v / radix;
+        *--end = (i < 10) ? i + '0' : i + 'a' - 10;
+    } while (v);
+    return end;
+}
+
 char* itoa( int val, char *string, int radix )
 {
     return ltoa( val, string, radix ) ;
@@ -60,8 +138,7 @@ char* itoa( int val, char *string, int radix )
 char* ltoa( long val, char *string, int radix )
 {
     char tmp[33];
-    char *tp = tmp;
-    long i;
+    char *tp;
     unsigned long v;
     int sign;
     char *sp;
@@ -79,29 +156,21 @@ char* ltoa( long val, char *string, int radix )
     sign = (radix == 10 && val < 0);
     if (sign)
     {
-        v = -val;
+        v = 0UL - (unsigned long)val;
     }
     else
     {
         v = (unsigned long)val;
     }
 
-    while (v || tp == tmp)
-    {
-        i = v % radix;
-        v = v / radix;
-        if (i < 10)
-            *tp++ = i+'0';
-        else
-            *tp++ = i + 'a' - 10;
-    }
+    tp = ultoa_radix(v, tmp + sizeof(tmp), radix);
 
     sp = string;
 
     if (sign)
         *sp++ = '-';
-    while (tp > tmp)
-        *sp++ = *--tp;
+    while (tp < tmp + sizeof(tmp))
+        *sp++ = *tp++;
     *sp = 0;
 
     return string;
@@ -115,9 +184,7 @@ char* utoa( unsigned int val, char *string, int radix )
 char* ultoa( unsigned long val, char *string, int radix )
 {
     char tmp[33];
-    char *tp = tmp;
-    long i;
-    unsigned long v = val;
+    char *tp;
     char *sp;
 
     if ( string == NULL )
@@ -130,21 +197,13 @@ char* ultoa( unsigned long val, char *string, int radix )
         return 0;
     }
 
-    while (v || tp == tmp)
-    {
-        i = v % radix;
-        v = v / radix;
-        if (i < 10)
-            *tp++ = i+'0';
-        else
-            *tp++ = i + 'a' - 10;
-    }
+    tp = ultoa_radix(val, tmp + sizeof(tmp), radix);
 
     sp = string;
 
-    while (tp > tmp)
-        *sp++ = *--tp;
-      *sp = 0;
+    while (tp < tmp + sizeof(tmp))
+        *sp++ = *tp++;
+    *sp = 0;
 
     return string;
 }
@@ -174,6 +233,15 @@ int digitsBe4Decimal(double number)
     number = -number;
   }
 
+  // Most values fit in 32 bits, compare against powers of ten instead
+  if(number < 4294967296.0) {
+    unsigned long integer = (unsigned long)number;
+    int i;
+    for(i = 1; i < 10 && integer >= pow10[i]; i++)
+      cnt++;
+    return cnt;
+  }
+
   // Count the number of digits beyond the 1st, basically, the exponent.
   while(number >= 10.0) {
     number /= 10;
@@ -188,7 +256,9 @@ char *dtostrf(double number, signed char width, unsigned char prec, char *s)
     unsigned long long integer;
     double fraction, rounding;
     int digit, before, i;
-    int delta;
+    int delta, sign;
+    char tmp[20];
+    char *digits;
 
     if (isnan(number)) {
         strcpy(s, "nan");
@@ -210,43 +280,50 @@ char *dtostrf(double number, signed char width, unsigned char prec, char *s)
         number += rounding;
 
     out = s;
-    before = digitsBe4Decimal(number);
-
-    // check if padding is required
-    if (width < 0) {
-        delta = (-width) - (before + prec + 1);
-        for (i = 0; i < delta; ++i) *out++ = ' ';
-        width = 0;
-    }
 
     // Handle negative numbers
-    if (number < 0.0) {
-      *out = '-';
+    sign = (number < 0.0);
+    if (sign)
       number = -number;
-    }
 
     // seperate integral and fractional parts
     integer = (unsigned long long) number;
     fraction = (double) (number - integer);
 
     // generate chars for each digit of the integral part
-    i = before;
-    while (integer >= 10) {
-        digit = integer % 10;
-        out[(i--) - 1] = ASCII_ZERO + digit;
-        integer /= 10;
+    digits = ulltoa10(integer, tmp + sizeof(tmp));
+    before = sign + (tmp + sizeof(tmp) - digits);
+
+    // check if padding is required
+    if (width < 0) {
+        delta = (-width) - (before + prec + 1);
+        for (i = 0; i < delta; ++i) *out++ = ' ';
+        width = 0;
     }
 
-    out[i - 1] = ASCII_ZERO + integer;
-    out += before;
+    if (sign)
+      *out++ = '-';
+    while (digits < tmp + sizeof(tmp))
+      *out++ = *digits++;
 
     if (prec) {
-        // generate chars for each digit of the fractional part
         *out++ = '.';
-        for (i = 0; i < prec; ++i) {
-            fraction *= 10.0;
-            digit = ((unsigned long long) fraction) % 10;
-            *out++ = (char) (ASCII_ZERO + digit);
+        if (prec < 10) {
+            // scale the fraction once and convert it as an integer
+            unsigned long f = (unsigned long) (fraction * pow10[prec]);
+            if (f >= pow10[prec])
+                f = pow10[prec] - 1;
+            digits = ultoa10(f, out + prec);
+            while (digits > out)
+                *--digits = ASCII_ZERO;
+            out += prec;
+        } else {
+            // generate chars for each digit of the fractional part
+            for (i = 0; i < prec; ++i) {
+                fraction *= 10.0;
+                digit = ((unsigned long long) fraction) % 10;
+                *out++ = (char) (ASCII_ZERO + digit);
+            }
         }
     }
 
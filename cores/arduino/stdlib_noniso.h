@@ -39,6 +39,13 @@ char* ultoa (unsigned long val, char *s, int radix);
  
 char* dtostrf (double val, signed char width, unsigned char prec, char *s);
 
+// Write the decimal digits of val so that they end just before end and
+// return a pointer to the first one; no terminator is written. Room for
+// 10 (ultoa10) or 20 (ulltoa10) digits is needed
+char* ultoa10 (unsigned long val, char *end);
+
+char* ulltoa10 (unsigned long long val, char *end);
+
 int digitsBe4Decimal(double number);
 
 #ifdef __cplusplus
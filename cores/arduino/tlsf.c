@@ -0,0 +1,494 @@
+/*
+  tlsf.c - constant time TLSF allocator for the main heap
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <malloc.h>
+#include <string.h>
+#include "tlsf.h"
+#include "interrupt.h"
+
+/* Nothing here is linked unless the Heap menu passes --wrap for the
+ * allocator entry points, which also defines __heap_tlsf */
+extern char __heap_tlsf __attribute__((weak));
+extern char __start_heap;
+extern char __end_heap;
+
+struct _reent;
+
+/* 16 size classes per power of two; sizes below 128 bytes get 16 classes
+ * 8 bytes apart, every one exact */
+#define SL_LOG2     4
+#define SL_COUNT    (1 << SL_LOG2)
+#define FL_SHIFT    (SL_LOG2 + 3)
+#define SMALL_SIZE  (1 << FL_SHIFT)
+#define FL_MAX      20              /* blocks below 1 MB */
+#define FL_COUNT    (FL_MAX - FL_SHIFT + 1)
+
+#define BLOCK_FREE      1
+#define BLOCK_PREV_FREE 2
+#define SIZE_MASK       (~(size_t)(TLSF_ALIGN - 1))
+
+/* prev_phys and size make the TLSF_BLOCK_OVERHEAD header; the list links
+ * live in the payload of free blocks, so a block holds at least 8 bytes */
+typedef struct block {
+    struct block *prev_phys;
+    size_t size;                    /* payload bytes | BLOCK_* flags */
+    struct block *next_free;
+    struct block *prev_free;
+} block_t;
+
+#define MIN_BLOCK   (sizeof(block_t) - TLSF_BLOCK_OVERHEAD)
+
+static uint32_t flBitmap;
+static uint16_t slBitmap[FL_COUNT];
+static block_t *lists[FL_COUNT][SL_COUNT];
+static uint8_t ready;
+static struct tlsf_stats stats;
+
+static inline size_t blockSize(const block_t *b)
+{
+    return b->size & SIZE_MASK;
+}
+
+static inline void *payload(block_t *b)
+{
+    return (char *)b + TLSF_BLOCK_OVERHEAD;
+}
+
+static inline block_t *fromPayload(void *ptr)
+{
+    return (block_t *)((char *)ptr - TLSF_BLOCK_OVERHEAD);
+}
+
+static inline block_t *nextPhys(block_t *b)
+{
+    return (block_t *)((char *)payload(b) + blockSize(b));
+}
+
+static inline int fls32(uint32_t v)
+{
+    return 31 - __builtin_clz(v);
+}
+
+static inline void mapping(size_t size, int *fl, int *sl)
+{
+    if (size < SMALL_SIZE) {
+        *fl = 0;
+        *sl = size / (SMALL_SIZE / SL_COUNT);
+    } else {
+        int f = fls32(size);
+        *sl = (size >> (f - SL_LOG2)) ^ SL_COUNT;
+        *fl = f - (FL_SHIFT - 1);
+    }
+}
+
+/* Lowest size class whose every block holds size */
+static inline void mappingSearch(size_t size, int *fl, int *sl)
+{
+    if (size >= SMALL_SIZE)
+        size += (1 << (fls32(size) - SL_LOG2)) - 1;
+    mapping(size, fl, sl);
+}
+
+static void insertFree(block_t *b)
+{
+    int fl, sl;
+
+    mapping(blockSize(b), &fl, &sl);
+    b->next_free = lists[fl][sl];
+    b->prev_free = NULL;
+    if (b->next_free)
+        b->next_free->prev_free = b;
+    lists[fl][sl] = b;
+    flBitmap |= 1UL << fl;
+    slBitmap[fl] |= 1U << sl;
+    stats.free += blockSize(b);
+    stats.free_blocks++;
+}
+
+static void removeFree(block_t *b)
+{
+    int fl, sl;
+
+    mapping(blockSize(b), &fl, &sl);
+    if (b->next_free)
+        b->next_free->prev_free = b->prev_free;
+    if (b->prev_free) {
+        b->prev_free->next_free = b->next_free;
+    } else {
+        lists[fl][sl] = b->next_free;
+        if (!lists[fl][sl]) {
+            slBitmap[fl] &= ~(1U << sl);
+            if (!slBitmap[fl])
+                flBitmap &= ~(1UL << fl);
+        }
+    }
+    stats.free -= blockSize(b);
+    stats.free_blocks--;
+}
+
+static block_t *findFree(size_t size)
+{
+    int fl, sl;
+    uint32_t map;
+
+    mappingSearch(size, &fl, &sl);
+    if (fl >= FL_COUNT)
+        return NULL;
+    map = slBitmap[fl] & (~0U << sl);
+    if (!map) {
+        map = flBitmap & (~0UL << (fl + 1));
+        if (!map)
+            return NULL;
+        fl = __builtin_ctz(map);
+        map = slBitmap[fl];
+    }
+    return lists[fl][__builtin_ctz(map)];
+}
+
+/* Marks b free or not in its own and its successor's header */
+static inline void setFree(block_t *b, int free)
+{
+    block_t *next = nextPhys(b);
+
+    if (free) {
+        b->size |= BLOCK_FREE;
+        next->size |= BLOCK_PREV_FREE;
+    } else {
+        b->size &= ~BLOCK_FREE;
+        next->size &= ~BLOCK_PREV_FREE;
+    }
+}
+
+/* Cuts used block b down to size and frees the rest, when that is a block */
+static void trim(block_t *b, size_t size)
+{
+    size_t have = blockSize(b);
+    block_t *rest, *next;
+
+    if (have < size + TLSF_BLOCK_OVERHEAD + MIN_BLOCK)
+        return;
+
+    rest = (block_t *)((char *)payload(b) + size);
+    rest->size = have - size - TLSF_BLOCK_OVERHEAD;
+    rest->prev_phys = b;
+    b->size = size | (b->size & ~SIZE_MASK);
+    next = nextPhys(rest);
+    next->prev_phys = rest;
+
+    /* the rest may join a free successor */
+    if (next->size & BLOCK_FREE) {
+        removeFree(next);
+        rest->size += TLSF_BLOCK_OVERHEAD + blockSize(next);
+        nextPhys(rest)->prev_phys = rest;
+    }
+    setFree(rest, 1);
+    insertFree(rest);
+}
+
+/* One free block over the heap, and a used, empty block at the end so
+ * that nextPhys() of the last block is always a header */
+static void init(void)
+{
+    uintptr_t start = ((uintptr_t)&__start_heap + TLSF_ALIGN - 1) & SIZE_MASK;
+    uintptr_t end = (uintptr_t)&__end_heap & SIZE_MASK;
+    block_t *b = (block_t *)start;
+    block_t *sentinel = (block_t *)(end - TLSF_BLOCK_OVERHEAD);
+
+    stats.size = end - start;
+    b->prev_phys = NULL;
+    b->size = (uintptr_t)sentinel - (uintptr_t)payload(b);
+    /* a block's size must map below FL_MAX */
+    if (b->size >> FL_MAX)
+        b->size = ((size_t)1 << FL_MAX) - TLSF_ALIGN;
+    sentinel = nextPhys(b);
+    sentinel->prev_phys = b;
+    sentinel->size = 0;
+    setFree(b, 1);
+    insertFree(b);
+    ready = 1;
+}
+
+static inline size_t adjust(size_t size)
+{
+    if (size < MIN_BLOCK)
+        return MIN_BLOCK;
+    return (size + TLSF_ALIGN - 1) & SIZE_MASK;
+}
+
+static void *allocate(size_t size)
+{
+    block_t *b;
+
+    if (!ready)
+        init();
+    if (size > ((size_t)1 << FL_MAX))
+        return NULL;
+    size = adjust(size);
+    b = findFree(size);
+    if (!b)
+        return NULL;
+
+    removeFree(b);
+    setFree(b, 0);
+    trim(b, size);
+
+    stats.used += blockSize(b);
+    if (stats.used > stats.peak)
+        stats.peak = stats.used;
+    stats.overhead += TLSF_BLOCK_OVERHEAD;
+    stats.blocks++;
+    return payload(b);
+}
+
+static void release(void *ptr)
+{
+    block_t *b = fromPayload(ptr), *next;
+
+    stats.used -= blockSize(b);
+    stats.overhead -= TLSF_BLOCK_OVERHEAD;
+    stats.blocks--;
+
+    if (b->size & BLOCK_PREV_FREE) {
+        block_t *prev = b->prev_phys;
+        removeFree(prev);
+        prev->size += TLSF_BLOCK_OVERHEAD + blockSize(b);
+        b = prev;
+    }
+    next = nextPhys(b);
+    if (next->size & BLOCK_FREE) {
+        removeFree(next);
+        b->size += TLSF_BLOCK_OVERHEAD + blockSize(next);
+        next = nextPhys(b);
+    }
+    next->prev_phys = b;
+    setFree(b, 1);
+    insertFree(b);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    uint32_t flags = interrupt_lock();
+    void *ptr = allocate(size);
+    interrupt_unlock(flags);
+    return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    uint32_t flags = interrupt_lock();
+    release(ptr);
+    interrupt_unlock(flags);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    size_t total = n * size;
+    void *ptr;
+
+    if (size && total / size != n)
+        return NULL;
+    ptr = __wrap_malloc(total);
+    if (ptr)
+        memset(ptr, 0, total);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    block_t *b, *next;
+    void *moved;
+
+    if (!ptr)
+        return __wrap_malloc(size);
+    if (!size) {
+        __wrap_free(ptr);
+        return NULL;
+    }
+    if (size > ((size_t)1 << FL_MAX))
+        return NULL;
+
+    size = adjust(size);
+    b = fromPayload(ptr);
+
+    uint32_t flags = interrupt_lock();
+    next = nextPhys(b);
+    /* grow into a free successor, or shrink, where the block is */
+    if (blockSize(b) < size && (next->size & BLOCK_FREE) &&
+        blockSize(b) + TLSF_BLOCK_OVERHEAD + blockSize(next) >= size) {
+        stats.used -= blockSize(b);
+        removeFree(next);
+        b->size += TLSF_BLOCK_OVERHEAD + blockSize(next);
+        setFree(b, 0);
+        nextPhys(b)->prev_phys = b;
+        trim(b, size);
+        stats.used += blockSize(b);
+        if (stats.used > stats.peak)
+            stats.peak = stats.used;
+    } else if (blockSize(b) >= size) {
+        stats.used -= blockSize(b);
+        trim(b, size);
+        stats.used += blockSize(b);
+    } else {
+        interrupt_unlock(flags);
+        moved = __wrap_malloc(size);
+        if (moved) {
+            memcpy(moved, ptr, blockSize(b));
+            __wrap_free(ptr);
+        }
+        return moved;
+    }
+    interrupt_unlock(flags);
+    return ptr;
+}
+
+void *__wrap_memalign(size_t align, size_t size)
+{
+    block_t *b, *aligned;
+    uintptr_t addr;
+    size_t gap;
+    void *ptr;
+
+    if (align <= TLSF_ALIGN)
+        return __wrap_malloc(size);
+    if (align & (align - 1))
+        return NULL;
+
+    /* room to move the payload up to the boundary, and for what is cut
+     * off in front to be a free block of its own */
+    ptr = __wrap_malloc(size + align + TLSF_BLOCK_OVERHEAD + MIN_BLOCK);
+    if (!ptr || !((uintptr_t)ptr & (align - 1)))
+        return ptr;
+
+    uint32_t flags = interrupt_lock();
+    b = fromPayload(ptr);
+    addr = ((uintptr_t)ptr + TLSF_BLOCK_OVERHEAD + MIN_BLOCK + align - 1) & ~(uintptr_t)(align - 1);
+    gap = addr - (uintptr_t)ptr;
+
+    aligned = fromPayload((void *)addr);
+    aligned->prev_phys = b;
+    aligned->size = blockSize(b) - gap;
+    nextPhys(aligned)->prev_phys = aligned;
+    b->size = (gap - TLSF_BLOCK_OVERHEAD) | (b->size & ~SIZE_MASK);
+    stats.used -= TLSF_BLOCK_OVERHEAD;
+    stats.overhead += TLSF_BLOCK_OVERHEAD;
+    stats.blocks++;
+    /* the front goes back to the heap, merging with a free predecessor */
+    release(payload(b));
+    stats.used -= blockSize(aligned);
+    trim(aligned, adjust(size));
+    stats.used += blockSize(aligned);
+    interrupt_unlock(flags);
+    return (void *)addr;
+}
+
+size_t tlsf_usable_size(void *ptr)
+{
+    return ptr ? blockSize(fromPayload(ptr)) : 0;
+}
+
+int tlsf_active(void)
+{
+    return &__heap_tlsf != NULL;
+}
+
+void tlsf_get_stats(struct tlsf_stats *out)
+{
+    uint32_t flags = interrupt_lock();
+
+    if (tlsf_active() && !ready)
+        init();
+    *out = stats;
+    out->largest = 0;
+    if (flBitmap) {
+        /* the biggest block is in the top list; any request that maps to
+         * its class fits every block there */
+        int fl = fls32(flBitmap);
+        int sl = fls32(slBitmap[fl]);
+        size_t largest = 0;
+        block_t *b;
+
+        for (b = lists[fl][sl]; b; b = b->next_free)
+            if (blockSize(b) > largest)
+                largest = blockSize(b);
+        if (largest >= SMALL_SIZE)
+            largest &= ~(((size_t)1 << (fls32(largest) - SL_LOG2)) - 1);
+        out->largest = largest;
+    }
+    interrupt_unlock(flags);
+}
+
+/* newlib's reentrant entry points, used by stdio, strdup() and the like */
+void *__wrap__malloc_r(struct _reent *r, size_t size)
+{
+    return __wrap_malloc(size);
+}
+
+void __wrap__free_r(struct _reent *r, void *ptr)
+{
+    __wrap_free(ptr);
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t n, size_t size)
+{
+    return __wrap_calloc(n, size);
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size)
+{
+    return __wrap_realloc(ptr, size);
+}
+
+void *__wrap__memalign_r(struct _reent *r, size_t align, size_t size)
+{
+    return __wrap_memalign(align, size);
+}
+
+size_t __wrap_malloc_usable_size(void *ptr)
+{
+    return tlsf_usable_size(ptr);
+}
+
+size_t __wrap__malloc_usable_size_r(struct _reent *r, void *ptr)
+{
+    return tlsf_usable_size(ptr);
+}
+
+/* What MemoryFree's freeHeap() reads: arena is the whole heap, so the
+ * free bytes are fordblks */
+struct mallinfo __wrap_mallinfo(void)
+{
+    struct tlsf_stats s;
+    struct mallinfo mi;
+
+    tlsf_get_stats(&s);
+    memset(&mi, 0, sizeof(mi));
+    mi.arena = s.size;
+    mi.ordblks = s.free_blocks;
+    mi.uordblks = s.used + s.overhead;
+    mi.fordblks = s.free;
+    return mi;
+}
+
+struct mallinfo __wrap__mallinfo_r(struct _reent *r)
+{
+    return __wrap_mallinfo();
+}
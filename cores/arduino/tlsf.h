@@ -0,0 +1,79 @@
+/*
+  tlsf.h - constant time TLSF allocator for the main heap
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _TLSF_H_
+#define _TLSF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* With Tools > Heap set to TLSF, malloc(), free(), realloc(), calloc(),
+ * memalign() and so operator new and String run on a two level segregated
+ * fit heap over __start_heap..__end_heap instead of newlib's: free blocks
+ * sit in lists by size class, 16 per power of two, found through two
+ * bitmaps, so an allocation or a free is a handful of bit scans and list
+ * operations whatever the state of the heap, with interrupts masked only
+ * for those. A request is rounded up to the next size class boundary
+ * before the search, so any block found fits and no list is walked; a
+ * freed block merges with free neighbours at once. The link wraps the
+ * newlib entry points, mallinfo() included, so MemoryFree and the
+ * framework see the same heap. */
+
+/* bytes a block takes on top of its rounded size */
+#define TLSF_BLOCK_OVERHEAD     8
+/* alignment of every block, as newlib's */
+#define TLSF_ALIGN              8
+
+struct tlsf_stats {
+    uint32_t size;          /* heap bytes, headers included */
+    uint32_t used;          /* bytes in allocated blocks, headers excluded */
+    uint32_t peak;          /* highest used so far */
+    uint32_t free;          /* bytes in free blocks, headers excluded */
+    uint32_t largest;       /* largest single allocation that would succeed */
+    uint32_t overhead;      /* header bytes of the allocated blocks */
+    uint32_t blocks;        /* allocated blocks */
+    uint32_t free_blocks;
+};
+
+/*
+ * \brief Non-zero when the sketch was linked with the TLSF heap.
+ */
+extern int tlsf_active(void);
+
+/*
+ * \brief Copies the heap counters; all zero when tlsf_active() is not.
+ */
+extern void tlsf_get_stats(struct tlsf_stats *stats);
+
+/*
+ * \brief Bytes usable at ptr, from malloc() and friends: the request
+ * rounded up to TLSF_ALIGN, and more when the remainder of a block was too
+ * small to split off. The block costs TLSF_BLOCK_OVERHEAD on top.
+ */
+extern size_t tlsf_usable_size(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TLSF_H_ */
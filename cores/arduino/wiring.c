@@ -25,40 +25,134 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "interrupt.h"
 #include "aux_regs.h"
 #include "board.h"
+#include "hwtimer.h"
 
 #define FREQ_MHZ	((ARCV2_TIMER0_CLOCK_FREQ)/1000000)
 static const uint64_t	 MS_TO_CLKS = (FREQ_MHZ * 1000);
 
+#if FREQ_MHZ != 32
+#error "millis() and micros() conversions assume a 32MHz timer0"
+#endif
+
+/*
+ * Reads the 64-bit virtual RTC (timer0_overflows:COUNT0) without masking
+ * interrupts. A wrap that the ISR hasn't counted yet shows up as the IP bit,
+ * and an overflow ISR running in the middle changes timer0_overflows, in
+ * which case the read is simply retried.
+ */
+static inline __attribute__((always_inline))
+uint32_t readTimeStampClks(uint32_t *low)
+{
+	uint32_t high, count, pending;
+
+	do {
+		high = timer0_overflows;
+		count = aux_reg_read(ARC_V2_TMR0_COUNT);
+		pending = 0;
+		if (aux_reg_read(ARC_V2_TMR0_CONTROL) & ARC_V2_TMR_CTRL_IP) {
+			/* wrapped: read the count again, past the wrap */
+			count = aux_reg_read(ARC_V2_TMR0_COUNT);
+			pending = 1;
+		}
+	} while (high != timer0_overflows);
+
+	*low = count;
+	return high + pending;
+}
+
 static inline __attribute__((always_inline))
 uint64_t getTimeStampClks(void)
 {
-	uint32_t time_stamp;
-	int key = interrupt_lock();
-	uint64_t ret = timer0_overflows;
-	time_stamp = aux_reg_read(ARC_V2_TMR0_COUNT);
-	if (aux_reg_read(ARC_V2_TMR0_CONTROL) & (0x01 << 3)) {
-		time_stamp = aux_reg_read(ARC_V2_TMR0_COUNT);
-		ret++;
-	}
-	interrupt_unlock(key);
-	return ((ret << 32) | time_stamp);
+	uint32_t low;
+	uint64_t high = readTimeStampClks(&low);
+	return ((high << 32) | low);
+}
+
+/* One-shot wakeup for idleUntil(), sharing timer1 through hwtimer */
+static void idle_wake(void *arg)
+{
+}
+
+static hwtimer_t idleTimer = { 0, 0, idle_wake, NULL, -1 };
+
+/* Clocks spent asleep in idleUntil(), for SystemStats */
+static uint64_t idleClks = 0;
+
+/*
+ * Sleeps the core until the timestamp deadline (in clocks) or any earlier
+ * interrupt. The sleep instruction takes the interrupt_lock() key and
+ * re-enables interrupts as it sleeps, so a wakeup can't slip in between
+ * the deadline check and the sleep.
+ */
+static void idleUntil(uint64_t deadline)
+{
+    uint32_t key = interrupt_lock();
+    uint64_t now = getTimeStampClks();
+
+    if (now >= deadline) {
+        interrupt_unlock(key);
+        return;
+    }
+
+    uint64_t left = deadline - now;
+    hwtimerStart(&idleTimer, left < 0xFFFFFFFF ? (uint32_t)left : 0xFFFFFFFF, 0);
+
+    __asm__ volatile ("sleep %0" :: "r" (key));
+
+    /* woken by something else: don't leave a stale wakeup behind */
+    hwtimerStop(&idleTimer);
+    idleClks += getTimeStampClks() - now;
+}
+
+void idleFor(uint32_t usec)
+{
+    idleUntil(getTimeStampClks() + ((uint64_t)usec << 5));
 }
 
+uint64_t idleCycles(void)
+{
+    return idleClks;
+}
+
+/* Defined when the sketch uses Task.h */
+extern uint64_t tasksNextDue(void) __attribute__((weak));
+/* Defined when the sketch uses fiber.h */
+extern void fiberYield(void) __attribute__((weak));
+
 void delay(uint32_t msec)
 {
-    uint64_t initial_timestamp = getTimeStampClks();
-    uint64_t delay_clks = msec * MS_TO_CLKS;
+    uint64_t deadline = getTimeStampClks() + msec * MS_TO_CLKS;
 
-    while (getTimeStampClks() - initial_timestamp < delay_clks) {
+    while (getTimeStampClks() < deadline) {
+        uint64_t wake = deadline;
         yield();
+        if (fiberYield) {
+            /* let the other fibers run before sleeping */
+            fiberYield();
+            if (getTimeStampClks() >= deadline)
+                break;
+        }
+        /* wake for the next task rather than sleep through it */
+        if (tasksNextDue) {
+            uint64_t due = tasksNextDue();
+            if (due < (wake >> 5))
+                wake = due << 5;
+        }
+        idleUntil(wake);
     }
 }
 
 
 uint64_t millis(void)
 {
-    uint64_t timestamp = getTimeStampClks();
-    return (uint64_t)(timestamp / (FREQ_MHZ * 1000));
+    /* clks / 32000 == (clks >> 8) / 125. With x = high * 2^24 + (low >> 8)
+     * and 2^24 == 125 * 134217 + 91, that is
+     * high * 134217 + (91 * high + (low >> 8)) / 125, where the last divide
+     * fits 32 bits (for the first ~190 years) and is a multiply-shift. */
+    uint32_t low;
+    uint32_t high = readTimeStampClks(&low);
+    uint32_t rest = 91 * high + (low >> 8);
+    return (uint64_t)high * 134217 + (uint32_t)(((uint64_t)rest * 0x10624DD3) >> 35);
 }
 
 uint64_t micros(void)
@@ -67,3 +161,46 @@ uint64_t micros(void)
     /* Divide by FREQ_MHZ and return */
     return (timestamp >> 5);
 }
+
+uint64_t cycles64(void)
+{
+    return getTimeStampClks();
+}
+
+uint32_t micros32(void)
+{
+    uint32_t low;
+    uint32_t high = readTimeStampClks(&low);
+    return (high << 27) | (low >> 5);
+}
+
+/* Filled in by c_init.c for the early phases, before main() */
+struct boot_stamps boot_stamps;
+
+void bootMark(uint8_t phase)
+{
+    uint32_t key = interrupt_lock();
+    boot_stamp(&boot_stamps, phase);
+    interrupt_unlock(key);
+}
+
+int bootReached(uint8_t phase)
+{
+    return phase < BOOT_PHASES && (boot_stamps.reached & (1u << phase));
+}
+
+uint32_t bootTime(uint8_t phase)
+{
+    if (!bootReached(phase))
+        return 0;
+    uint32_t clks = boot_stamps.tmr0[phase];
+    /* TMR0 was cleared between BOOT_CTORS and BOOT_MAIN */
+    if (phase >= BOOT_MAIN)
+        clks += boot_stamps.tmr0_restart;
+    return clks >> 5;
+}
+
+uint32_t bootTicks(uint8_t phase)
+{
+    return bootReached(phase) ? boot_stamps.aon[phase] : 0;
+}
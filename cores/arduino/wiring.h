@@ -27,6 +27,7 @@ extern "C" {
 #include <stdint.h>
 #include "wiring_constants.h"
 #include "arcv2_timer0.h"
+#include "boot_time.h"
 
 
 /**
@@ -58,13 +59,22 @@ extern uint64_t millis( void ) ;
  */
 extern uint64_t micros( void ) ;
 
+/**
+ * \brief Low 32 bits of micros(), for measuring intervals.
+ *
+ * Wraps every ~71 minutes; unsigned subtraction of two readings gives the
+ * elapsed time across a wrap.
+ */
+extern uint32_t micros32( void ) ;
+
 /**
  * \brief Pauses the program for the amount of time (in milliseconds) specified
  *  as parameter.
  *
  *  This function relies on Timer0 interrupts, therefore it shouldn't be called
  *  from a context with interrupts disabled.
- *  It doesn't use CPU's power management features.
+ *  The core sleeps between wakeups, set by an hwtimer one-shot, and yield()
+ *  is called after every wakeup.
  *
  * \param dwMs the number of milliseconds to pause (uint32_t)
  *
@@ -72,6 +82,70 @@ extern uint64_t micros( void ) ;
  */
 extern void delay( uint32_t dwMs ) ;
 
+/**
+ * \brief Sleeps the core for up to usec microseconds, returning early on any
+ * interrupt. Meant for idle(), e.g. void idle() { idleFor(1000); }
+ */
+extern void idleFor( uint32_t usec ) ;
+
+/**
+ * \brief Clocks the core has slept in delay() and idleFor() since reset,
+ * including the interrupts that ran while it slept.
+ */
+extern uint64_t idleCycles( void ) ;
+
+/**
+ * \brief Records the raw TMR0 and always-on counts for a boot phase, see
+ * boot_time.h, the first time it is reached.
+ */
+extern void bootMark( uint8_t phase ) ;
+
+/**
+ * \brief Whether a boot phase has been reached.
+ */
+extern int bootReached( uint8_t phase ) ;
+
+/**
+ * \brief Microseconds from the ARC reset to a boot phase, from TMR0, so to
+ * the CPU clock; 0 if not reached. Wraps for phases past ~134 seconds. With
+ * a driver library that doesn't record the early phases, counts from
+ * BOOT_MAIN instead.
+ */
+extern uint32_t bootTime( uint8_t phase ) ;
+
+/**
+ * \brief Raw always-on counter, 32768 per second from power-on, at a boot
+ * phase; 0 if not reached. Also covers the time LMT took to start the ARC.
+ */
+extern uint32_t bootTicks( uint8_t phase ) ;
+
+
+/**
+ * \brief Raw timer0 count: 32 counts per microsecond, the CPU clock.
+ *
+ * Wraps every ~134 seconds; use the unsigned difference of two readings.
+ */
+static inline __attribute__ ((always_inline))
+uint32_t cycles(void)
+{
+    return arcv2_timer0_count_get();
+}
+
+/**
+ * \brief cycles() extended to 64 bits with the timer0 overflow count; never
+ * wraps in practice.
+ */
+extern uint64_t cycles64( void ) ;
+
+/**
+ * \brief Converts a cycles() difference to nanoseconds.
+ */
+static inline __attribute__ ((always_inline))
+uint64_t cyclesToNanos(uint32_t c)
+{
+    /* 1000 / 32 == 125 / 4 */
+    return ((uint64_t)c * 125) >> 2;
+}
 
 /**
  * \brief Pauses the program for the amount of time (in microseconds) specified
@@ -19,6 +19,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "Arduino.h"
 #include "portable.h"
+#include "board.h"
+#include "power.h"
+#include "hwtimer.h"
+#include "wiring_private.h"
 
 #ifdef __cplusplus
  extern "C" {
@@ -29,10 +33,27 @@ static int _writeResolution = 8;
 static int _readResolution = 10;
 uint32_t maxResolutionValue = 0xFF;
 
+/* Per PWM channel, high clocks per unit of analogWrite() value in 16.16
+ * fixed point, so a write costs a multiply rather than a float divide;
+ * worked out again whenever pwmPeriod[] no longer matches pwmScalePeriod[],
+ * as when a library such as Servo puts its period back */
+static uint32_t pwmScale[4];
+static uint32_t pwmScalePeriod[4];
+
+static void pwmUpdateScale(uint32_t chan)
+{
+    pwmScale[chan] = ((uint64_t)pwmPeriod[chan] << 16) / maxResolutionValue;
+    pwmScalePeriod[chan] = pwmPeriod[chan];
+}
+
 void analogWriteResolution(int res)
 {
+    uint32_t chan;
+
     _writeResolution = res;
     maxResolutionValue = 0xFFFFFFFF >> (32-res);
+    for (chan = 0; chan < 4; chan++)
+        pwmUpdateScale(chan);
 }
 
 void analogReadResolution(int res)
@@ -50,6 +71,74 @@ static inline uint32_t mapResolution(uint32_t value, uint32_t from, uint32_t to)
          return value << (to-from);
 }
 
+/* High clocks of the channel for val, kept off 0 and the whole period,
+ * which the timer can't do */
+static uint32_t pwmHighCount(uint32_t chan, uint32_t val)
+{
+    if (pwmScalePeriod[chan] != pwmPeriod[chan])
+        pwmUpdateScale(chan);
+
+    uint32_t hcnt = ((uint64_t)val * pwmScale[chan]) >> 16;
+    if (hcnt < PWM_MIN_DUTY_CYCLE)
+        hcnt = PWM_MIN_DUTY_CYCLE;
+    if (hcnt > pwmPeriod[chan] - PWM_MIN_DUTY_CYCLE)
+        hcnt = pwmPeriod[chan] - PWM_MIN_DUTY_CYCLE;
+    return hcnt;
+}
+
+/* Channels started by pwmStart(); the PWM clock is held while any runs,
+ * or from a load count update until the channel starts */
+static uint8_t pwmRunning = 0;
+static uint8_t pwmClockHeld = 0;
+
+static inline void pwmSetCounts(uint32_t chan, uint32_t hcnt)
+{
+    /* the PWM block is brought up by its first use */
+    variantPwmInit();
+    if (!pwmClockHeld) {
+        power_clock_acquire(POWER_CLOCK_PWM);
+        pwmClockHeld = 1;
+    }
+    /* Set the high count period (duty cycle) */
+    MMIO_REG_VAL(QRK_PWM_BASE_ADDR + (chan * QRK_PWM_N_LCNT2_LEN) + QRK_PWM_N_LOAD_COUNT2) = hcnt;
+    /* Set the low count period (duty cycle) */
+    MMIO_REG_VAL(QRK_PWM_BASE_ADDR + (chan * QRK_PWM_N_REGS_LEN) + QRK_PWM_N_LOAD_COUNT1) =
+        pwmPeriod[chan] - hcnt;
+}
+
+/* Starts the channel and muxes the pin to it, unless already done: once
+ * running an update only needs the load counts */
+static void pwmStart(uint8_t pin)
+{
+    if(pinmuxMode[pin] == PWM_MUX_MODE)
+        return;
+
+    PinDescription *p = &g_APinDescription[pin];
+    uint32_t offset = ((p->ulPwmChan * QRK_PWM_N_REGS_LEN) + QRK_PWM_N_CONTROL);
+
+    /* start the PWM output */
+    SET_MMIO_MASK(QRK_PWM_BASE_ADDR + offset, QRK_PWM_CONTROL_ENABLE);
+    pwmRunning |= 1 << p->ulPwmChan;
+    /* Disable pull-up and set pin mux for PWM output */
+    SET_PIN_PULLUP(p->ulSocPin, 0);
+    pinPullup[pin] = 0;
+    SET_PIN_MODE(p->ulSocPin, PWM_MUX_MODE);
+    pinmuxMode[pin] = PWM_MUX_MODE;
+}
+
+void pwmRelease(uint8_t pin)
+{
+    PinDescription *p = &g_APinDescription[pin];
+    uint32_t offset = ((p->ulPwmChan * QRK_PWM_N_REGS_LEN) + QRK_PWM_N_CONTROL);
+
+    CLEAR_MMIO_MASK(QRK_PWM_BASE_ADDR + offset, QRK_PWM_CONTROL_ENABLE);
+    pwmRunning &= ~(1 << p->ulPwmChan);
+    if (!pwmRunning && pwmClockHeld) {
+        power_clock_release(POWER_CLOCK_PWM);
+        pwmClockHeld = 0;
+    }
+}
+
 void analogWrite(uint8_t pin, uint32_t val)
 {
     if (! digitalPinHasPWM(pin))
@@ -69,45 +158,135 @@ void analogWrite(uint8_t pin, uint32_t val)
         /* Use GPIO for 0% duty cycle (always off)  */
         pinMode(pin, OUTPUT);
         digitalWrite(pin, LOW);
-    } else if (val >= ((1 << _writeResolution) - 1)) {
+    } else if (val >= maxResolutionValue) {
         /* Use GPIO for 100% duty cycle (always on)  */
         pinMode(pin, OUTPUT);
         digitalWrite(pin, HIGH);
     } else {
         /* PWM for everything in between */
-        PinDescription *p = &g_APinDescription[pin];
-
-        uint32_t offset;
-        
-        uint32_t hcnt = (val/(float)maxResolutionValue) * pwmPeriod[p->ulPwmChan];
-        uint32_t lcnt = pwmPeriod[p->ulPwmChan] - hcnt;
-        
-        /* Set the high count period (duty cycle) */
-        offset = ((p->ulPwmChan * QRK_PWM_N_LCNT2_LEN) + QRK_PWM_N_LOAD_COUNT2);
-        MMIO_REG_VAL(QRK_PWM_BASE_ADDR + offset) = hcnt;
-        
-        /* Set the low count period (duty cycle) */
-        offset = ((p->ulPwmChan * QRK_PWM_N_REGS_LEN) + QRK_PWM_N_LOAD_COUNT1);
-        MMIO_REG_VAL(QRK_PWM_BASE_ADDR + offset) = lcnt;
-
-        /* start the PWM output */
-        offset = ((p->ulPwmChan * QRK_PWM_N_REGS_LEN) + QRK_PWM_N_CONTROL);
-        SET_MMIO_MASK(QRK_PWM_BASE_ADDR + offset, QRK_PWM_CONTROL_ENABLE);
-        
-        if(pinmuxMode[pin] != PWM_MUX_MODE)
-        {
-            /* Disable pull-up and set pin mux for PWM output */
-            SET_PIN_PULLUP(p->ulSocPin, 0);
-            SET_PIN_MODE(p->ulSocPin, PWM_MUX_MODE);
-            pinmuxMode[pin] = PWM_MUX_MODE;
-        }
+        uint32_t chan = g_APinDescription[pin].ulPwmChan;
+
+        pwmSetCounts(chan, pwmHighCount(chan, val));
+        pwmStart(pin);
     }
 }
-uint32_t analogRead(uint32_t pin)
+
+void analogWriteMulti(const uint8_t *pins, const uint32_t *vals, uint8_t count)
 {
+    uint32_t hcnt[4];
+    uint8_t i;
 
-    uint32_t val = 0;
+    if (count > 4)
+        return;
+
+    /* work everything out first, so the writes go out back to back */
+    for (i = 0; i < count; i++) {
+        if (!digitalPinHasPWM(pins[i]) || vals[i] == 0 ||
+            vals[i] >= maxResolutionValue)
+            hcnt[i] = 0;
+        else
+            hcnt[i] = pwmHighCount(g_APinDescription[pins[i]].ulPwmChan, vals[i]);
+    }
+
+    uint32_t flags = interrupt_lock();
+    for (i = 0; i < count; i++) {
+        if (hcnt[i])
+            pwmSetCounts(g_APinDescription[pins[i]].ulPwmChan, hcnt[i]);
+    }
+    interrupt_unlock(flags);
+
+    /* first writes, and 0% or 100%, take the slow path */
+    for (i = 0; i < count; i++) {
+        if (hcnt[i])
+            pwmStart(pins[i]);
+        else
+            analogWrite(pins[i], vals[i]);
+    }
+}
+void analogWritePulse(uint8_t pin, uint32_t period, uint32_t high)
+{
+    if (!digitalPinHasPWM(pin) || period <= 2 * PWM_MIN_DUTY_CYCLE)
+        return;
+
+    uint32_t chan = g_APinDescription[pin].ulPwmChan;
+
+    pwmPeriod[chan] = period;
+    if (high < PWM_MIN_DUTY_CYCLE)
+        high = PWM_MIN_DUTY_CYCLE;
+    if (high > period - PWM_MIN_DUTY_CYCLE)
+        high = period - PWM_MIN_DUTY_CYCLE;
+
+    uint32_t flags = interrupt_lock();
+    pwmSetCounts(chan, high);
+    interrupt_unlock(flags);
+    pwmStart(pin);
+}
+
+void analogWriteSync(const uint8_t *pins, const uint32_t *phases, uint8_t count)
+{
+    uint32_t ctrl[4], order[4], start;
+    uint8_t i, j;
+
+    if (count > 4)
+        return;
 
+    /* control registers of the running PWM pins, by phase */
+    for (i = 0, j = 0; i < count; i++) {
+        if (!digitalPinHasPWM(pins[i]) || pinmuxMode[pins[i]] != PWM_MUX_MODE)
+            continue;
+        uint8_t k = j++;
+        while (k > 0 && phases[order[k - 1]] > phases[i]) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = i;
+    }
+    for (i = 0; i < j; i++)
+        ctrl[i] = QRK_PWM_BASE_ADDR + g_APinDescription[pins[order[i]]].ulPwmChan *
+                  QRK_PWM_N_REGS_LEN + QRK_PWM_N_CONTROL;
+
+    uint32_t flags = interrupt_lock();
+    for (i = 0; i < j; i++)
+        CLEAR_MMIO_MASK(ctrl[i], QRK_PWM_CONTROL_ENABLE);
+    start = cycles();
+    for (i = 0; i < j; i++) {
+        while (cycles() - start < phases[order[i]])
+            ;
+        SET_MMIO_MASK(ctrl[i], QRK_PWM_CONTROL_ENABLE);
+    }
+    interrupt_unlock(flags);
+}
+
+/* Sequencer state while analogReadContinuous() owns the ADC */
+static volatile uint8_t adcContinuous = 0;
+static uint8_t adcScanLength;
+static uint16_t *adcRing;
+static uint32_t adcRingSize;
+static uint32_t adcRingHead;
+static uint32_t adcRingTail;
+static volatile uint32_t adcRingCount;
+static volatile uint32_t adcOverruns;
+
+/* analogReadTriggered(): a timer tick starts each single-shot scan, and the
+ * ring holds the tick index ahead of the samples of its scan */
+static uint8_t adcTriggered = 0;
+static hwtimer_t adcTimer;
+static uint64_t adcTriggerStart;
+static uint32_t adcTriggerPeriod;
+static volatile uint32_t adcTriggerTicks;
+static volatile uint8_t adcScanBusy;
+static uint32_t adcScanTick;
+static void (*adcTriggerCallback)(uint32_t) = NULL;
+
+/* analogReadStart() state */
+static volatile uint8_t adcPending = 0;
+static volatile uint8_t adcResultValid = 0;
+static volatile uint32_t adcResult;
+static void (*adcCallback)(uint32_t) = NULL;
+
+/* Switch a pin over to the ADC and return its channel */
+static uint32_t adcPinChannel(uint32_t pin)
+{
     /* allow for channel or pin numbers */
     if (pin < 6) pin += A0;
 
@@ -116,11 +295,48 @@ uint32_t analogRead(uint32_t pin)
     /* Disable pull-up and set pin mux for ADC output */
     SET_PIN_MODE(p->ulSocPin, ADC_MUX_MODE);
     SET_PIN_PULLUP(p->ulSocPin,0);
+    pinPullup[pin] = 0;
+
+    return p->ulAdcChan;
+}
+
+/* Load the sequence table, two entries per write, each entry waiting
+ * delay ADC clocks before its conversion */
+static void adcLoadSequence(const uint8_t *pins, uint8_t count, uint32_t delay)
+{
+    uint32_t i, entry, pair = 0;
+
+    /* Reset sequence pointer */
+    SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST);
+    for (i = 0; i < count; i++) {
+        entry = adcPinChannel(pins[i]) | (delay << ADC_SEQ_DELAY_SHIFT);
+        if (i & 1)
+            WRITE_ARC_REG(pair | (entry << 16), ADC_SEQ);
+        else
+            pair = entry;
+    }
+    if (count & 1)
+        WRITE_ARC_REG(pair, ADC_SEQ);
+}
+
+uint32_t analogRead(uint32_t pin)
+{
+
+    uint32_t val = 0;
+
+    /* the sequencer is busy with analogReadContinuous() or analogReadStart() */
+    if (adcContinuous || adcPending)
+        return 0;
+
+    /* the ADC is powered up by its first use */
+    variantAdcInit();
+
+    uint32_t chan = adcPinChannel(pin);
 
     /* Reset sequence pointer */
     SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST);
     /* Update sequence table */
-    WRITE_ARC_REG(p->ulAdcChan, ADC_SEQ);
+    WRITE_ARC_REG(chan, ADC_SEQ);
     /* Reset sequence pointer & start sequencer */
     SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START | ADC_ENABLE);
     /* Poll for ADC data ready status (DATA_A) */
@@ -136,11 +352,435 @@ uint32_t analogRead(uint32_t pin)
 
 }
 
+int analogReadMulti(const uint8_t *pins, uint32_t *out, uint8_t count)
+{
+    uint32_t i;
+
+    if (adcContinuous || adcPending || count == 0 || count > ADC_SEQ_MAX_ENTRIES)
+        return 0;
+
+    variantAdcInit();
+
+    /* One single-shot pass over count entries, DATA_A once all are in */
+    WRITE_ARC_REG(ADC_CONFIG_SETUP | ((count - 1) << ADC_SEQ_ENTRIES_SHIFT) |
+                  ((count - 1) << ADC_THRESHOLD_SHIFT), ADC_SET);
+    adcLoadSequence(pins, count, 0);
+    SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START | ADC_ENABLE);
+    while((READ_ARC_REG(ADC_INTSTAT) & ADC_INT_DATA_A) == 0);
+    for (i = 0; i < count; i++) {
+        SET_ARC_MASK(ADC_SET, ADC_POP_SAMPLE);
+        out[i] = mapResolution(READ_ARC_REG(ADC_SAMPLE), ADC_RESOLUTION, _readResolution);
+    }
+    SET_ARC_MASK(ADC_CTRL, ADC_CLR_DATA_A);
+
+    /* Back to the one entry table analogRead() expects */
+    WRITE_ARC_REG(ADC_CONFIG_SETUP, ADC_SET);
+
+    return count;
+}
+
+/* Single-shot table of count conversions of one channel */
+static void adcLoadRepeated(uint32_t chan, uint8_t count)
+{
+    uint32_t i;
+
+    WRITE_ARC_REG(ADC_CONFIG_SETUP | ((count - 1) << ADC_SEQ_ENTRIES_SHIFT) |
+                  ((count - 1) << ADC_THRESHOLD_SHIFT), ADC_SET);
+    SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST);
+    for (i = 0; i < count; i += 2)
+        WRITE_ARC_REG(chan | (chan << 16), ADC_SEQ);
+}
+
+uint32_t analogReadAccumulate(uint32_t pin, uint32_t samples)
+{
+    uint32_t i, n, sum = 0;
+    uint8_t pass;
+
+    if (adcContinuous || adcPending || samples == 0)
+        return 0;
+
+    variantAdcInit();
+
+    /* Pin mux and table are set up once, then the table is rerun */
+    uint32_t chan = adcPinChannel(pin);
+    pass = samples < ADC_SEQ_MAX_ENTRIES ? samples : ADC_SEQ_MAX_ENTRIES;
+    adcLoadRepeated(chan, pass);
+
+    while (samples) {
+        n = samples < pass ? samples : pass;
+        if (n != pass) {
+            pass = n;
+            adcLoadRepeated(chan, pass);
+        }
+        SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START | ADC_ENABLE);
+        while((READ_ARC_REG(ADC_INTSTAT) & ADC_INT_DATA_A) == 0);
+        for (i = 0; i < n; i++) {
+            SET_ARC_MASK(ADC_SET, ADC_POP_SAMPLE);
+            sum += READ_ARC_REG(ADC_SAMPLE);
+        }
+        SET_ARC_MASK(ADC_CTRL, ADC_CLR_DATA_A);
+        samples -= n;
+    }
+
+    /* Back to the one entry table analogRead() expects */
+    WRITE_ARC_REG(ADC_CONFIG_SETUP, ADC_SET);
+
+    return sum;
+}
+
+uint32_t analogReadOversample(uint32_t pin, uint32_t samples, uint8_t extraBits)
+{
+    uint32_t sum = analogReadAccumulate(pin, samples);
+
+    if (samples == 0)
+        return 0;
+
+    /* mean of the samples with extraBits more bits below the point */
+    uint32_t mean = ((uint64_t)sum << extraBits) / samples;
+    return mapResolution(mean, ADC_RESOLUTION + extraBits, _readResolution + extraBits);
+}
+
+/* Pop the analogReadStart() sample */
+static void adcCollect(void)
+{
+    SET_ARC_MASK(ADC_SET, ADC_POP_SAMPLE);
+    adcResult = mapResolution(READ_ARC_REG(ADC_SAMPLE), ADC_RESOLUTION, _readResolution);
+    SET_ARC_MASK(ADC_CTRL, ADC_CLR_DATA_A);
+    adcPending = 0;
+    adcResultValid = 1;
+}
+
+/* DATA_A fires once a full scan is in the FIFO */
+static void adcScanComplete(void)
+{
+    uint32_t i, head = adcRingHead;
+    uint32_t len = adcScanLength + adcTriggered;
+    uint8_t room = adcRingSize - adcRingCount >= len;
+
+    if (room && adcTriggered) {
+        adcRing[head] = adcScanTick;
+        if (++head == adcRingSize)
+            head = 0;
+    }
+    for (i = 0; i < adcScanLength; i++) {
+        SET_ARC_MASK(ADC_SET, ADC_POP_SAMPLE);
+        uint16_t val = READ_ARC_REG(ADC_SAMPLE);
+        if (room) {
+            adcRing[head] = val;
+            if (++head == adcRingSize)
+                head = 0;
+        }
+    }
+    if (room) {
+        adcRingHead = head;
+        adcRingCount += len;
+    } else {
+        /* drop whole scans so the ring stays aligned to the pin list */
+        adcOverruns++;
+    }
+
+    if (!adcTriggered && (READ_ARC_REG(ADC_INTSTAT) & ADC_INT_OVERFLOW)) {
+        /* The FIFO lost samples, restart at the top of the table */
+        CLEAR_ARC_MASK(ADC_CTRL, ADC_SEQ_START);
+        SET_ARC_MASK(ADC_SET, ADC_FLUSH_RX);
+        CLEAR_ARC_MASK(ADC_SET, ADC_FLUSH_RX);
+        SET_ARC_MASK(ADC_CTRL, ADC_CLR_OVERFLOW);
+        SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START);
+        adcOverruns++;
+    }
+    SET_ARC_MASK(ADC_CTRL, ADC_CLR_DATA_A);
+    adcScanBusy = 0;
+}
+
+static void adcIsr(void)
+{
+    if (adcContinuous) {
+        adcScanComplete();
+    } else if (adcPending) {
+        SET_ARC_MASK(ADC_CTRL, ADC_INT_DATA_A_DSB);
+        adcCollect();
+        if (adcCallback)
+            adcCallback(adcResult);
+    }
+}
+
+static void adcEnableInterrupt(void)
+{
+    SET_INTERRUPT_HANDLER(IRQ_ADC_IRQ, adcIsr);
+    SOC_UNMASK_INTERRUPTS(INT_SS_ADC_IRQ_MASK);
+    CLEAR_ARC_MASK(ADC_CTRL, ADC_INT_DATA_A_DSB);
+}
+
+static void adcDisableInterrupt(void)
+{
+    SET_ARC_MASK(ADC_CTRL, ADC_INT_DATA_A_DSB);
+    interrupt_disable(IRQ_ADC_IRQ);
+}
+
+void analogReadCallback(void (*callback)(uint32_t value))
+{
+    adcCallback = callback;
+}
+
+int analogReadStart(uint32_t pin)
+{
+    if (adcContinuous || adcPending)
+        return 0;
+
+    variantAdcInit();
+
+    uint32_t chan = adcPinChannel(pin);
+
+    adcResultValid = 0;
+    adcPending = 1;
+    if (adcCallback)
+        adcEnableInterrupt();
+
+    SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST);
+    WRITE_ARC_REG(chan, ADC_SEQ);
+    SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START | ADC_ENABLE);
+
+    return 1;
+}
+
+int analogReadReady(void)
+{
+    /* without a callback the conversion is collected here */
+    if (adcPending && !adcCallback && (READ_ARC_REG(ADC_INTSTAT) & ADC_INT_DATA_A))
+        adcCollect();
+    return adcResultValid;
+}
+
+uint32_t analogReadResult(void)
+{
+    if (!adcPending && !adcResultValid)
+        return 0;
+    while (!analogReadReady());
+    adcResultValid = 0;
+    return adcResult;
+}
+
+int analogReadContinuous(const uint8_t *pins, uint8_t count, uint32_t rate,
+                         uint16_t *buffer, uint32_t size)
+{
+    uint32_t ratio = ADC_CLOCK_RATIO;
+    uint32_t delay = 0;
+
+    if (adcPending || count == 0 || count > ADC_SEQ_MAX_ENTRIES || buffer == NULL || size < count)
+        return 0;
+
+    variantAdcInit();
+    analogReadStop();
+
+    if (rate) {
+        /* Per entry period in CPU clocks; a conversion takes ADC_RESOLUTION + 2
+         * ADC clocks and the entry delay fills the rest. Slow the ADC clock down
+         * when the delay field can't cover the period. */
+        uint32_t conv = ADC_RESOLUTION + 2;
+        uint32_t period = F_CPU / (rate * count);
+        uint32_t clocks;
+
+        if (period / ratio > conv + ADC_SEQ_DELAY_MAX)
+            ratio = period / (conv + ADC_SEQ_DELAY_MAX) + 1;
+        clocks = period / ratio;
+        delay = clocks > conv ? clocks - conv : 0;
+    }
+
+    adcRing = buffer;
+    adcRingSize = size;
+    adcRingHead = 0;
+    adcRingTail = 0;
+    adcRingCount = 0;
+    adcOverruns = 0;
+    adcScanLength = count;
+
+    WRITE_ARC_REG(ratio & ADC_CLK_RATIO_MASK, ADC_DIVSEQSTAT);
+    WRITE_ARC_REG(ADC_CONFIG_SETUP | ADC_SEQ_MODE_REPETITIVE |
+                  ((count - 1) << ADC_SEQ_ENTRIES_SHIFT) |
+                  ((count - 1) << ADC_THRESHOLD_SHIFT), ADC_SET);
+    adcLoadSequence(pins, count, delay);
+
+    adcContinuous = 1;
+    adcEnableInterrupt();
+    SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START | ADC_ENABLE);
+
+    return 1;
+}
+
+uint32_t analogContinuousAvailable(void)
+{
+    return adcRingCount;
+}
+
+uint32_t analogContinuousRead(uint32_t *out, uint32_t count)
+{
+    uint32_t i, tail = adcRingTail;
+    uint32_t available = adcTriggered ? 0 : adcRingCount;
+
+    if (count > available)
+        count = available;
+    for (i = 0; i < count; i++) {
+        out[i] = mapResolution(adcRing[tail], ADC_RESOLUTION, _readResolution);
+        if (++tail == adcRingSize)
+            tail = 0;
+    }
+    adcRingTail = tail;
+
+    uint32_t saved = interrupt_lock();
+    adcRingCount -= count;
+    interrupt_unlock(saved);
+
+    return count;
+}
+
+uint32_t analogContinuousOverruns(void)
+{
+    return adcOverruns;
+}
+
+/* The tick: start a scan unless the last one is still converting, then
+ * let the callback latch whatever else belongs to this index */
+static void adcTriggerFire(void *arg)
+{
+    uint32_t index = adcTriggerTicks++;
+
+    if (adcScanBusy) {
+        adcOverruns++;
+    } else {
+        adcScanTick = index;
+        adcScanBusy = 1;
+        SET_ARC_MASK(ADC_CTRL, ADC_SEQ_PTR_RST | ADC_SEQ_START);
+    }
+    if (adcTriggerCallback)
+        adcTriggerCallback(index);
+}
+
+void analogTriggerCallback(void (*callback)(uint32_t index))
+{
+    uint32_t saved = interrupt_lock();
+    adcTriggerCallback = callback;
+    interrupt_unlock(saved);
+}
+
+int analogReadTriggered(const uint8_t *pins, uint8_t count, uint32_t rate,
+                        uint16_t *buffer, uint32_t size)
+{
+    if (adcPending || count == 0 || count > ADC_SEQ_MAX_ENTRIES || buffer == NULL ||
+        size < count + 1u || rate == 0 || rate > F_CPU)
+        return 0;
+
+    variantAdcInit();
+    analogReadStop();
+
+    adcRing = buffer;
+    adcRingSize = size;
+    adcRingHead = 0;
+    adcRingTail = 0;
+    adcRingCount = 0;
+    adcOverruns = 0;
+    adcScanLength = count;
+    adcTriggerTicks = 0;
+    adcScanBusy = 0;
+
+    /* one single-shot pass over the table per tick, DATA_A once it's in */
+    WRITE_ARC_REG(ADC_CLOCK_RATIO & ADC_CLK_RATIO_MASK, ADC_DIVSEQSTAT);
+    WRITE_ARC_REG(ADC_CONFIG_SETUP | ((count - 1) << ADC_SEQ_ENTRIES_SHIFT) |
+                  ((count - 1) << ADC_THRESHOLD_SHIFT), ADC_SET);
+    adcLoadSequence(pins, count, 0);
+    SET_ARC_MASK(ADC_CTRL, ADC_ENABLE);
+
+    adcContinuous = 1;
+    adcTriggered = 1;
+    adcEnableInterrupt();
+
+    /* tick 0 is one period from now, and tick n n periods after it */
+    adcTriggerPeriod = F_CPU / rate;
+    uint32_t saved = interrupt_lock();
+    hwtimerInit(&adcTimer, adcTriggerFire, NULL);
+    adcTriggerStart = cycles64() + adcTriggerPeriod;
+    if (hwtimerStart(&adcTimer, adcTriggerPeriod, adcTriggerPeriod) != 0) {
+        interrupt_unlock(saved);
+        analogReadStop();
+        return 0;
+    }
+    interrupt_unlock(saved);
+
+    return 1;
+}
+
+uint32_t analogTriggeredRead(uint32_t *out, uint32_t *index)
+{
+    uint32_t i, tail = adcRingTail;
+    uint32_t len = adcScanLength + 1;
+
+    if (!adcTriggered || adcRingCount < len)
+        return 0;
+
+    /* the ring keeps the low 16 bits; index is at most 65535 scans back */
+    uint16_t low = adcRing[tail];
+    if (index)
+        *index = adcTriggerTicks - (uint16_t)(adcTriggerTicks - low);
+    if (++tail == adcRingSize)
+        tail = 0;
+    for (i = 0; i < adcScanLength; i++) {
+        out[i] = mapResolution(adcRing[tail], ADC_RESOLUTION, _readResolution);
+        if (++tail == adcRingSize)
+            tail = 0;
+    }
+    adcRingTail = tail;
+
+    uint32_t saved = interrupt_lock();
+    adcRingCount -= len;
+    interrupt_unlock(saved);
+
+    return adcScanLength;
+}
+
+uint64_t analogTriggerCycles(uint32_t index)
+{
+    return adcTriggerStart + (uint64_t)index * adcTriggerPeriod;
+}
+
+int32_t analogTriggerIndex(uint64_t us)
+{
+    int64_t offset = (int64_t)(us * (F_CPU / 1000000)) - (int64_t)adcTriggerStart;
+
+    if (!adcTriggerPeriod)
+        return 0;
+    /* nearest tick, rounding halves up on either side of tick 0 */
+    offset += adcTriggerPeriod / 2;
+    if (offset < 0)
+        return -(int32_t)((-offset + adcTriggerPeriod - 1) / adcTriggerPeriod);
+    return offset / adcTriggerPeriod;
+}
+
+void analogReadStop(void)
+{
+    if (!adcContinuous)
+        return;
+
+    if (adcTriggered) {
+        hwtimerStop(&adcTimer);
+        adcTriggered = 0;
+    }
+    CLEAR_ARC_MASK(ADC_CTRL, ADC_SEQ_START);
+    adcDisableInterrupt();
+
+    /* Drop anything left in the FIFO and restore the analogRead() setup */
+    WRITE_ARC_REG(ADC_CONFIG_SETUP | ADC_FLUSH_RX, ADC_SET);
+    WRITE_ARC_REG(ADC_CONFIG_SETUP, ADC_SET);
+    SET_ARC_MASK(ADC_CTRL, ADC_CLR_DATA_A | ADC_CLR_OVERFLOW);
+    WRITE_ARC_REG(ADC_CLOCK_RATIO & ADC_CLK_RATIO_MASK, ADC_DIVSEQSTAT);
+
+    adcContinuous = 0;
+}
+
 void analogWriteFrequency(uint8_t pin, uint32_t freq)
 {
     //convert frequency to period in clock ticks
     PinDescription *p = &g_APinDescription[pin];
     pwmPeriod[p->ulPwmChan] = F_CPU / freq;
+    pwmUpdateScale(p->ulPwmChan);
 }
 
 #ifdef __cplusplus
@@ -51,6 +51,41 @@ extern void analogReference( eAnalogReference ulMode ) ;
  */
 extern void analogWrite( uint8_t pin, uint32_t val ) ;
 
+/*
+ * \brief analogWrite() of count PWM pins at once: the duty cycles are worked
+ * out first and the load counts then written back to back with interrupts
+ * masked, so each channel takes its new value at its next period. A value
+ * of 0 or full scale switches the pin to GPIO as analogWrite() does.
+ *
+ * \param pins up to 4 pins
+ * \param vals one value per pin
+ */
+extern void analogWriteMulti( const uint8_t *pins, const uint32_t *vals, uint8_t count ) ;
+
+/*
+ * \brief Drives a PWM pin with a pulse of high clocks every period clocks
+ * (F_CPU, so 32 per microsecond), timed by the PWM block rather than by
+ * software, e.g. for servos. The period stays set for later analogWrite()
+ * calls on the pin. New values take effect at the end of the running period.
+ *
+ * \param pin    a PWM pin
+ * \param period in clocks
+ * \param high   in clocks, kept inside the period
+ */
+extern void analogWritePulse( uint8_t pin, uint32_t period, uint32_t high ) ;
+
+/*
+ * \brief Restarts the PWM channels of count pins already running, from
+ * analogWrite() or analogWritePulse(), so their periods begin phases[i]
+ * clocks (F_CPU) after the call does: the same phase for all starts them
+ * together. Interrupts stay masked until the last has started, so keep the
+ * phases short, within a period. Pins not running PWM are skipped.
+ *
+ * \param pins   up to 4 pins
+ * \param phases one offset per pin, in clocks
+ */
+extern void analogWriteSync( const uint8_t *pins, const uint32_t *phases, uint8_t count ) ;
+
 /*
  * \brief Reads the value from the specified analog pin.
  *
@@ -60,6 +95,168 @@ extern void analogWrite( uint8_t pin, uint32_t val ) ;
  */
 extern uint32_t analogRead( uint32_t ulPin ) ;
 
+/*
+ * \brief Starts a single conversion and returns without waiting for it.
+ * analogRead() and the other ADC calls return 0 until the result is collected.
+ *
+ * \param ulPin
+ *
+ * \return 1 when started, 0 if the ADC is busy.
+ */
+extern int analogReadStart( uint32_t ulPin ) ;
+
+/*
+ * \brief Returns non-zero once the analogReadStart() conversion has finished.
+ */
+extern int analogReadReady( void ) ;
+
+/*
+ * \brief Returns the analogReadStart() result, waiting for it if necessary.
+ *
+ * \return Read value, or 0 if no conversion was started.
+ */
+extern uint32_t analogReadResult( void ) ;
+
+/*
+ * \brief Calls callback from the ADC interrupt with the result of every
+ * analogReadStart() conversion. NULL goes back to polling analogReadReady().
+ *
+ * \param callback
+ */
+extern void analogReadCallback( void (*callback)(uint32_t value) ) ;
+
+/*
+ * \brief Reads several analog pins in one pass of the ADC sequencer.
+ * Returns 0 while analogReadContinuous() is running.
+ *
+ * \param pins  up to ADC_SEQ_MAX_ENTRIES channel or pin numbers, repeats allowed
+ * \param out   receives one value per pin, in the same order
+ * \param count number of pins
+ *
+ * \return count, or 0 on error.
+ */
+extern int analogReadMulti( const uint8_t *pins, uint32_t *out, uint8_t count ) ;
+
+/*
+ * \brief Takes samples conversions of one pin, queued ADC_SEQ_MAX_ENTRIES at a
+ * time in the sequencer, and returns the sum of the raw 12-bit values.
+ *
+ * \param ulPin
+ * \param samples
+ *
+ * \return Sum of the samples, or 0 if the ADC is busy.
+ */
+extern uint32_t analogReadAccumulate( uint32_t ulPin, uint32_t samples ) ;
+
+/*
+ * \brief Averages samples conversions of one pin and returns the mean at the
+ * analogReadResolution() plus extraBits. Each extra bit of real resolution
+ * takes four times the samples, e.g. 16 samples for 2 extra bits.
+ *
+ * \param ulPin
+ * \param samples
+ * \param extraBits
+ *
+ * \return Averaged value, or 0 if the ADC is busy.
+ */
+extern uint32_t analogReadOversample( uint32_t ulPin, uint32_t samples, uint8_t extraBits ) ;
+
+/*
+ * \brief Runs the ADC sequencer over a list of pins continuously, rate scans
+ * per second (0 for as fast as possible), from the ADC interrupt into buffer.
+ * Samples are interleaved in pin order. Scans that don't fit in the buffer are
+ * dropped whole and counted by analogContinuousOverruns(). analogRead() and
+ * analogReadMulti() return 0 until analogReadStop().
+ *
+ * \param pins   up to ADC_SEQ_MAX_ENTRIES channel or pin numbers
+ * \param count  number of pins
+ * \param rate   scans per second
+ * \param buffer ring storage, raw 12-bit samples; must stay valid until stopped
+ * \param size   entries in buffer, at least count; a multiple of count keeps
+ *               reads aligned to scans
+ *
+ * \return 1 when started, 0 on error.
+ */
+extern int analogReadContinuous( const uint8_t *pins, uint8_t count, uint32_t rate,
+                                 uint16_t *buffer, uint32_t size ) ;
+
+/*
+ * \brief Number of samples waiting in the analogReadContinuous() buffer.
+ */
+extern uint32_t analogContinuousAvailable( void ) ;
+
+/*
+ * \brief Copies up to count waiting samples, oldest first, scaled to the
+ * analogReadResolution().
+ *
+ * \return Number of samples copied.
+ */
+extern uint32_t analogContinuousRead( uint32_t *out, uint32_t count ) ;
+
+/*
+ * \brief Number of scans lost since analogReadContinuous() started.
+ */
+extern uint32_t analogContinuousOverruns( void ) ;
+
+/*
+ * \brief Runs one scan of a list of pins per hardware timer tick, rate ticks
+ * per second, for samples that must line up in time with other sensors. The
+ * ticks are numbered from 0, one period after the start, so tick n is at
+ * analogTriggerCycles(n) on the cycles64() clock and times from elsewhere
+ * map to their nearest tick with analogTriggerIndex(), e.g. the IMU FIFO's
+ * CURIE_IMU_SAMPLE_TIME records:
+ *
+ *     analogTriggerIndex(CurieIMU.sensorTimeToMicros(record.time))
+ *
+ * A tick that comes while the last scan is still converting is skipped and
+ * counted by analogContinuousOverruns(), as are scans that don't fit in the
+ * buffer. Stop with analogReadStop(); analogRead() and analogReadMulti()
+ * return 0 until then.
+ *
+ * \param pins   up to ADC_SEQ_MAX_ENTRIES channel or pin numbers
+ * \param count  number of pins
+ * \param rate   ticks per second
+ * \param buffer ring storage, count + 1 entries a scan; must stay valid until
+ *               stopped
+ * \param size   entries in buffer, at least count + 1
+ *
+ * \return 1 when started, 0 on error.
+ */
+extern int analogReadTriggered( const uint8_t *pins, uint8_t count, uint32_t rate,
+                                uint16_t *buffer, uint32_t size ) ;
+
+/*
+ * \brief Called from the timer interrupt on every analogReadTriggered() tick,
+ * straight after the scan has been started, with the tick index: the place
+ * to latch anything else that belongs to the tick. NULL to remove.
+ */
+extern void analogTriggerCallback( void (*callback)(uint32_t index) ) ;
+
+/*
+ * \brief Copies the oldest analogReadTriggered() scan, count samples scaled to
+ * the analogReadResolution(), and sets index, unless NULL, to its tick.
+ * analogContinuousRead() returns nothing in this mode.
+ *
+ * \return count, or 0 if no scan is waiting.
+ */
+extern uint32_t analogTriggeredRead( uint32_t *out, uint32_t *index ) ;
+
+/*
+ * \brief The cycles64() time of analogReadTriggered() tick index.
+ */
+extern uint64_t analogTriggerCycles( uint32_t index ) ;
+
+/*
+ * \brief The analogReadTriggered() tick nearest a micros() time; negative
+ * before tick 0.
+ */
+extern int32_t analogTriggerIndex( uint64_t us ) ;
+
+/*
+ * \brief Stops analogReadContinuous() and hands the ADC back to analogRead().
+ */
+extern void analogReadStop( void ) ;
+
 /*
  * \brief Set the resolution of analogRead return values. Default is 10 bits (range from 0 to 1023).
  *
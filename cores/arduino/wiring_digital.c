@@ -19,6 +19,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "Arduino.h"
 #include "portable.h"
+#include "wiring_private.h"
 
 #ifdef __cplusplus
  extern "C" {
@@ -52,9 +53,12 @@ void pinMode( uint8_t pin, uint8_t mode )
 
     /* Set SoC pin mux configuration */
     SET_PIN_PULLUP(p->ulSocPin, (mode == INPUT_PULLUP) ? 1 : 0);
+    pinPullup[pin] = (mode == OUTPUT) ? PIN_PULLUP_OUTPUT : (mode == INPUT_PULLUP) ? 1 : 0;
     SET_PIN_MODE(p->ulSocPin, GPIO_MUX_MODE);
     if(pinmuxMode[pin] != GPIO_MUX_MODE)
     {
+        if (pinmuxMode[pin] == PWM_MUX_MODE)
+            pwmRelease(pin);
         pinmuxMode[pin] = GPIO_MUX_MODE;
     }
 }
@@ -67,6 +71,8 @@ void digitalWrite( uint8_t pin, uint8_t val )
     
     if(pinmuxMode[pin] != GPIO_MUX_MODE)
     {
+        if (pinmuxMode[pin] == PWM_MUX_MODE)
+            pwmRelease(pin);
         pinmuxMode[pin] = GPIO_MUX_MODE;
         SET_PIN_MODE(p->ulSocPin, GPIO_MUX_MODE);
     }
@@ -86,10 +92,14 @@ void digitalWrite( uint8_t pin, uint8_t val )
 			CLEAR_MMIO_BIT(reg, p->ulGPIOId);
 	}
 
-	if (val)
-		SET_PIN_PULLUP(p->ulSocPin,1);
-	else
-		SET_PIN_PULLUP(p->ulSocPin,0);
+	// The pull-up mirrors the level only for inputs, where writing HIGH
+	// is the Arduino way of enabling it
+	val = val ? 1 : 0;
+	if (pinPullup[pin] != PIN_PULLUP_OUTPUT && pinPullup[pin] != val)
+	{
+		pinPullup[pin] = val;
+		SET_PIN_PULLUP(p->ulSocPin, val);
+	}
 }
 
 int digitalRead( uint8_t pin )
@@ -112,6 +122,124 @@ int digitalRead( uint8_t pin )
     return LOW;
 }
 
+// Inert target for handles of pins that aren't GPIOs
+static uint32_t fastPinDummy;
+
+int fastPinInit( FastPin *fp, uint8_t pin )
+{
+    PinDescription *p = (pin < NUM_DIGITAL_PINS) ? &g_APinDescription[pin] : NULL;
+
+    if (p && p->ulGPIOType == SS_GPIO) {
+        fp->out = p->ulGPIOBase + SS_GPIO_SWPORTA_DR;
+        fp->in = p->ulGPIOBase + SS_GPIO_EXT_PORTA;
+        fp->aux = 1;
+    } else if (p && p->ulGPIOType == SOC_GPIO) {
+        fp->out = p->ulGPIOBase + SOC_GPIO_SWPORTA_DR;
+        fp->in = p->ulGPIOBase + SOC_GPIO_EXT_PORTA;
+        fp->aux = 0;
+    } else {
+        fp->out = fp->in = (uint32_t)&fastPinDummy;
+        fp->mask = 0;
+        fp->aux = 0;
+        return 0;
+    }
+    fp->mask = 1 << p->ulGPIOId;
+
+    if(pinmuxMode[pin] != GPIO_MUX_MODE)
+    {
+        if (pinmuxMode[pin] == PWM_MUX_MODE)
+            pwmRelease(pin);
+        pinmuxMode[pin] = GPIO_MUX_MODE;
+        SET_PIN_MODE(p->ulSocPin, GPIO_MUX_MODE);
+    }
+    return 1;
+}
+
+int pinGroupInit( PinGroup *group, const uint8_t *pins, uint8_t count )
+{
+    uint8_t i, j;
+
+    group->nports = 0;
+    group->npins = 0;
+    if (count > PIN_GROUP_MAX_PINS) return 0;
+
+    for (i = 0; i < count; i++) {
+        uint8_t pin = pins[i];
+        if (pin >= NUM_DIGITAL_PINS) return 0;
+
+        PinDescription *p = &g_APinDescription[pin];
+        if (p->ulGPIOType != SS_GPIO && p->ulGPIOType != SOC_GPIO) return 0;
+
+        uint32_t out = p->ulGPIOBase + ((p->ulGPIOType == SS_GPIO) ?
+                                        SS_GPIO_SWPORTA_DR : SOC_GPIO_SWPORTA_DR);
+        for (j = 0; j < group->nports && group->port[j].out != out; j++)
+            ;
+        if (j == group->nports) {
+            if (j == PIN_GROUP_MAX_PORTS) return 0;
+            group->port[j].out = out;
+            group->port[j].aux = (p->ulGPIOType == SS_GPIO);
+            group->port[j].in = p->ulGPIOBase + (group->port[j].aux ?
+                                                 SS_GPIO_EXT_PORTA : SOC_GPIO_EXT_PORTA);
+            group->port[j].mask = 0;
+            group->nports++;
+        }
+        group->port[j].mask |= 1 << p->ulGPIOId;
+        group->portOf[i] = j;
+        group->bitOf[i] = p->ulGPIOId;
+
+        if(pinmuxMode[pin] != GPIO_MUX_MODE)
+        {
+            if (pinmuxMode[pin] == PWM_MUX_MODE)
+                pwmRelease(pin);
+            pinmuxMode[pin] = GPIO_MUX_MODE;
+            SET_PIN_MODE(p->ulSocPin, GPIO_MUX_MODE);
+        }
+    }
+    group->npins = count;
+    return 1;
+}
+
+void digitalWritePort( const PinGroup *group, uint32_t value )
+{
+    uint32_t set[PIN_GROUP_MAX_PORTS] = { 0 };
+    uint8_t i;
+
+    // scatter the value bits onto their controllers first, so the
+    // registers are updated back to back under one lock
+    for (i = 0; i < group->npins; i++) {
+        if (value & (1 << i))
+            set[group->portOf[i]] |= 1 << group->bitOf[i];
+    }
+
+    uint32_t saved = interrupt_lock();
+    for (i = 0; i < group->nports; i++) {
+        uint32_t reg = group->port[i].out;
+        uint32_t mask = group->port[i].mask;
+        if (group->port[i].aux)
+            WRITE_ARC_REG((READ_ARC_REG(reg) & ~mask) | set[i], reg);
+        else
+            MMIO_REG_VAL(reg) = (MMIO_REG_VAL(reg) & ~mask) | set[i];
+    }
+    interrupt_unlock(saved);
+}
+
+uint32_t digitalReadPort( const PinGroup *group )
+{
+    uint32_t in[PIN_GROUP_MAX_PORTS];
+    uint32_t value = 0;
+    uint8_t i;
+
+    for (i = 0; i < group->nports; i++) {
+        uint32_t reg = group->port[i].in;
+        in[i] = group->port[i].aux ? READ_ARC_REG(reg) : MMIO_REG_VAL(reg);
+    }
+    for (i = 0; i < group->npins; i++) {
+        if (in[group->portOf[i]] & (1 << group->bitOf[i]))
+            value |= 1 << i;
+    }
+    return value;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,8 @@
 #ifndef _WIRING_DIGITAL_
 #define _WIRING_DIGITAL_
 
+#include "portable.h"
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -64,6 +66,123 @@ extern void digitalWrite( uint8_t pin, uint8_t val ) ;
  */
 extern int digitalRead( uint8_t pin ) ;
 
+/**
+ * \brief Pre-resolved pin for bit-banging.
+ *
+ * fastPinInit() looks the pin up in g_APinDescription once and puts it in GPIO
+ * mode; the fastPin*() calls then touch only the GPIO data register. Unlike
+ * digitalWrite() they don't mirror the level into the pull-up register, so
+ * configure the pin with pinMode() first. The GPIO blocks have no set/clear
+ * registers, so writes are a read-modify-write under an interrupt lock.
+ */
+typedef struct _FastPin
+{
+        uint32_t        out;    // SWPORTA_DR: aux register (SS_GPIO) or address (SOC_GPIO)
+        uint32_t        in;     // EXT_PORTA, in the same space as out
+        uint32_t        mask;   // bit of the pin in both registers
+        uint32_t        aux;    // non-zero for an SS_GPIO (aux register) pin
+} FastPin;
+
+/**
+ * \brief Resolve a pin into a FastPin handle.
+ *
+ * \param fp handle to fill in
+ * \param pin the pin number
+ *
+ * \return 1 on success, 0 if the pin is not a GPIO (the handle is then inert)
+ */
+extern int fastPinInit( FastPin *fp, uint8_t pin ) ;
+
+static inline void fastPinHigh( const FastPin *fp )
+{
+    uint32_t saved = interrupt_lock();
+    if (fp->aux)
+        WRITE_ARC_REG(READ_ARC_REG(fp->out) | fp->mask, fp->out);
+    else
+        MMIO_REG_VAL(fp->out) |= fp->mask;
+    interrupt_unlock(saved);
+}
+
+static inline void fastPinLow( const FastPin *fp )
+{
+    uint32_t saved = interrupt_lock();
+    if (fp->aux)
+        WRITE_ARC_REG(READ_ARC_REG(fp->out) & ~fp->mask, fp->out);
+    else
+        MMIO_REG_VAL(fp->out) &= ~fp->mask;
+    interrupt_unlock(saved);
+}
+
+static inline void fastPinToggle( const FastPin *fp )
+{
+    uint32_t saved = interrupt_lock();
+    if (fp->aux)
+        WRITE_ARC_REG(READ_ARC_REG(fp->out) ^ fp->mask, fp->out);
+    else
+        MMIO_REG_VAL(fp->out) ^= fp->mask;
+    interrupt_unlock(saved);
+}
+
+static inline void fastPinWrite( const FastPin *fp, uint8_t val )
+{
+    if (val)
+        fastPinHigh(fp);
+    else
+        fastPinLow(fp);
+}
+
+static inline int fastPinRead( const FastPin *fp )
+{
+    uint32_t v = fp->aux ? READ_ARC_REG(fp->in) : MMIO_REG_VAL(fp->in);
+    return (v & fp->mask) ? HIGH : LOW;
+}
+
+#define PIN_GROUP_MAX_PINS      16
+#define PIN_GROUP_MAX_PORTS     4       // SS_GPIO_8B0, SS_GPIO_8B1, SOC_GPIO, SOC_GPIO_AON
+
+/**
+ * \brief A set of pins written and read together, e.g. a parallel bus.
+ *
+ * pinGroupInit() splits the pins by GPIO controller, so digitalWritePort()
+ * costs one read-modify-write of each controller's SWPORTA_DR and
+ * digitalReadPort() one read of each EXT_PORTA, whatever the pin count.
+ * Like the FastPin calls these leave the pull-up register alone.
+ */
+typedef struct _PinGroup
+{
+        struct {
+            uint32_t    out;    // SWPORTA_DR
+            uint32_t    in;     // EXT_PORTA
+            uint32_t    aux;    // non-zero for SS_GPIO
+            uint32_t    mask;   // bits of this controller in the group
+        } port[PIN_GROUP_MAX_PORTS];
+        uint8_t         portOf[PIN_GROUP_MAX_PINS];    // port[] index of each pin
+        uint8_t         bitOf[PIN_GROUP_MAX_PINS];     // GPIO bit of each pin
+        uint8_t         nports;
+        uint8_t         npins;
+} PinGroup;
+
+/**
+ * \brief Build a pin group; bit i of the port value maps to pins[i].
+ *
+ * \param group group to fill in
+ * \param pins the pin numbers, least significant first
+ * \param count number of pins, at most PIN_GROUP_MAX_PINS
+ *
+ * \return 1 on success, 0 if count is too large or a pin is not a GPIO
+ */
+extern int pinGroupInit( PinGroup *group, const uint8_t *pins, uint8_t count ) ;
+
+/**
+ * \brief Drive every pin of the group at once from the bits of value.
+ */
+extern void digitalWritePort( const PinGroup *group, uint32_t value ) ;
+
+/**
+ * \brief Sample every pin of the group, bit i holding pins[i].
+ */
+extern uint32_t digitalReadPort( const PinGroup *group ) ;
+
 #ifdef __cplusplus
 }
 #endif
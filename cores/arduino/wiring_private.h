@@ -66,6 +66,10 @@ uint32_t countPulseASM(volatile uint8_t *port, uint8_t bit, uint8_t stateMask, u
 
 typedef void (*voidFuncPtr)(void);
 
+/* Stops the PWM channel of a pin leaving PWM_MUX_MODE, and gates the PWM
+ * clock once no channel runs */
+void pwmRelease(uint8_t pin);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
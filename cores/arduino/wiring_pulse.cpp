@@ -124,3 +124,200 @@ end:
 
    return pulseLengthMicroseconds;
 }
+
+/*
+ * Input capture
+ */
+#if INPUT_CAPTURE_MAX_PINS > 8
+#error INPUT_CAPTURE_MAX_PINS is at most 8
+#endif
+
+typedef struct {
+    uint8_t used;
+    uint8_t pin;
+    uint8_t mode;
+    uint8_t ssId;               /* SS_GPIO bit, when ssPolarity is set */
+    uint32_t ssPolarity;        /* CHANGE on an SS_GPIO: its INT_POLARITY */
+    FastPin fp;
+    CaptureEdge *buf;
+    uint16_t size;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    volatile uint32_t overruns;
+} CaptureSlot;
+
+static CaptureSlot captureSlots[INPUT_CAPTURE_MAX_PINS];
+
+static void captureEdge(CaptureSlot *s, uint32_t cycles)
+{
+    uint8_t level;
+
+    if (s->mode == RISING) {
+        level = 1;
+    } else if (s->mode == FALLING) {
+        level = 0;
+    } else {
+        level = fastPinRead(&s->fp) ? 1 : 0;
+        /* the SS GPIOs take one edge at a time: wait for the other one */
+        if (s->ssPolarity) {
+            if (level)
+                CLEAR_ARC_BIT(s->ssPolarity, s->ssId);
+            else
+                SET_ARC_BIT(s->ssPolarity, s->ssId);
+        }
+    }
+
+    uint16_t next = s->tail + 1;
+    if (next == s->size)
+        next = 0;
+    if (next == s->head) {
+        s->overruns++;
+        return;
+    }
+    s->buf[s->tail].cycles = cycles;
+    s->buf[s->tail].level = level;
+    s->tail = next;
+}
+
+/* attachInterruptFast() handlers take no argument: one per slot */
+template <int N>
+static void captureVector(uint32_t cycles)
+{
+    captureEdge(&captureSlots[N], cycles);
+}
+
+static const fastInterruptHandler captureVectors[] = {
+    captureVector<0>, captureVector<1>, captureVector<2>, captureVector<3>,
+#if INPUT_CAPTURE_MAX_PINS > 4
+    captureVector<4>, captureVector<5>, captureVector<6>, captureVector<7>,
+#endif
+};
+
+static CaptureSlot *captureSlot(uint32_t pin)
+{
+    for (int i = 0; i < INPUT_CAPTURE_MAX_PINS; i++) {
+        if (captureSlots[i].used && captureSlots[i].pin == pin)
+            return &captureSlots[i];
+    }
+    return NULL;
+}
+
+int inputCaptureBegin(uint32_t pin, uint32_t mode, uint16_t depth)
+{
+    // dccm_malloc() takes a uint16_t byte count
+    if (pin >= NUM_DIGITAL_PINS ||
+        depth < 2 || depth > UINT16_MAX / sizeof(CaptureEdge) ||
+        (mode != RISING && mode != FALLING && mode != CHANGE))
+        return -1;
+
+    inputCaptureEnd(pin);
+
+    int i = 0;
+    while (i < INPUT_CAPTURE_MAX_PINS && captureSlots[i].used)
+        i++;
+    if (i == INPUT_CAPTURE_MAX_PINS)
+        return -1;
+
+    CaptureSlot *s = &captureSlots[i];
+    s->buf = (CaptureEdge *)dccm_malloc(depth * sizeof(CaptureEdge));
+    if (!s->buf)
+        return -1;
+
+    PinDescription *p = &g_APinDescription[pin];
+    s->pin = pin;
+    s->mode = mode;
+    s->size = depth;
+    s->head = s->tail = 0;
+    s->overruns = 0;
+    s->ssPolarity = 0;
+    if (mode == CHANGE && p->ulGPIOType == SS_GPIO) {
+        s->ssPolarity = p->ulGPIOBase + SS_GPIO_INT_POLARITY;
+        s->ssId = p->ulGPIOId;
+    }
+    fastPinInit(&s->fp, pin);
+    s->used = 1;
+
+    attachInterruptFast(pin, captureVectors[i], mode);
+    if (s->ssPolarity) {
+        /* CHANGE set it up for a falling edge */
+        if (!fastPinRead(&s->fp))
+            SET_ARC_BIT(s->ssPolarity, s->ssId);
+    }
+    return 0;
+}
+
+void inputCaptureEnd(uint32_t pin)
+{
+    CaptureSlot *s = captureSlot(pin);
+
+    if (!s)
+        return;
+    detachInterrupt(pin);
+    dccm_free(s->buf);
+    s->buf = NULL;
+    s->used = 0;
+}
+
+uint16_t inputCaptureAvailable(uint32_t pin)
+{
+    CaptureSlot *s = captureSlot(pin);
+
+    if (!s)
+        return 0;
+    uint16_t head = s->head, tail = s->tail;
+    return tail >= head ? tail - head : tail + s->size - head;
+}
+
+int inputCaptureRead(uint32_t pin, CaptureEdge *edge)
+{
+    CaptureSlot *s = captureSlot(pin);
+
+    if (!s || s->head == s->tail)
+        return 0;
+    *edge = s->buf[s->head];
+    s->head = s->head + 1 == s->size ? 0 : s->head + 1;
+    return 1;
+}
+
+uint32_t inputCaptureOverruns(uint32_t pin)
+{
+    CaptureSlot *s = captureSlot(pin);
+
+    return s ? s->overruns : 0;
+}
+
+int inputCapturePwm(uint32_t pin, uint32_t *period, uint32_t *high)
+{
+    CaptureSlot *s = captureSlot(pin);
+    CaptureEdge e[3];
+    int need;
+
+    if (!s)
+        return -1;
+    need = s->mode == CHANGE ? 3 : 2;
+
+    /* the newest edges, oldest first in e[] */
+    uint32_t flags = interrupt_lock();
+    if (inputCaptureAvailable(pin) < need) {
+        interrupt_unlock(flags);
+        return -1;
+    }
+    uint16_t pos = s->tail;
+    for (int i = need - 1; i >= 0; i--) {
+        pos = pos ? pos - 1 : s->size - 1;
+        e[i] = s->buf[pos];
+    }
+    interrupt_unlock(flags);
+
+    if (need == 2) {
+        *period = e[1].cycles - e[0].cycles;
+        *high = 0;
+        return 0;
+    }
+    /* a glitch can leave two edges of one level in a row */
+    if (e[0].level != e[2].level || e[1].level == e[0].level)
+        return -1;
+    *period = e[2].cycles - e[0].cycles;
+    *high = e[0].level ? e[1].cycles - e[0].cycles : e[2].cycles - e[1].cycles;
+    return 0;
+}
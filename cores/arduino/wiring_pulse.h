@@ -34,6 +34,58 @@
  */
 extern uint32_t pulseIn( uint32_t ulPin, uint32_t ulState, uint32_t ulTimeout = 1000000UL ) ;
 
+/*
+ * Input capture: edges on a pin are timestamped in the GPIO vector with the
+ * timer0 count (cycles(), 32 per microsecond) and queued per pin, so PWM,
+ * echo pulses and tachometers can be measured continuously without
+ * blocking. Timestamps wrap every ~134 seconds; use unsigned differences.
+ */
+#ifndef INPUT_CAPTURE_MAX_PINS
+#define INPUT_CAPTURE_MAX_PINS  4
+#endif
+
+typedef struct {
+    uint32_t cycles;            /* timer0 count at the edge */
+    uint8_t level;              /* of the pin after it */
+} CaptureEdge;
+
+/*
+ * \brief Starts capturing RISING, FALLING or CHANGE edges on the pin into a
+ * queue of depth edges, allocated from DCCM. depth is at least 2 and at
+ * most UINT16_MAX / sizeof(CaptureEdge).
+ *
+ * \return 0, or -1 for a bad argument, no free capture slot or no memory.
+ */
+extern int inputCaptureBegin( uint32_t ulPin, uint32_t ulMode, uint16_t depth ) ;
+
+extern void inputCaptureEnd( uint32_t ulPin ) ;
+
+/*
+ * \brief Edges waiting in the pin's queue.
+ */
+extern uint16_t inputCaptureAvailable( uint32_t ulPin ) ;
+
+/*
+ * \brief Takes the oldest edge off the pin's queue.
+ *
+ * \return 1, or 0 when the queue is empty.
+ */
+extern int inputCaptureRead( uint32_t ulPin, CaptureEdge *edge ) ;
+
+/*
+ * \brief Edges dropped because the queue was full.
+ */
+extern uint32_t inputCaptureOverruns( uint32_t ulPin ) ;
+
+/*
+ * \brief Period and high time, in cycles, from the newest edges, leaving them
+ * queued. With CHANGE that takes three edges; with RISING or FALLING two,
+ * and high is 0.
+ *
+ * \return 0, or -1 until enough edges have arrived.
+ */
+extern int inputCapturePwm( uint32_t ulPin, uint32_t *period, uint32_t *high ) ;
+
 
 #ifdef __cplusplus
 }
@@ -24,37 +24,100 @@
 #endif
 
 
-uint32_t shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder ) {
+/*
+ * The pins are resolved once per call into FastPins and each byte is
+ * clocked with the interrupts masked, so every bit costs a few register
+ * accesses rather than the table walk and pull-up write of digitalWrite().
+ */
+
+/* fastPinWrite() without its interrupt lock; the caller holds one */
+static inline void shiftWrite(const FastPin *fp, uint32_t high)
+{
+	if (fp->aux) {
+		uint32_t v = READ_ARC_REG(fp->out);
+		WRITE_ARC_REG(high ? v | fp->mask : v & ~fp->mask, fp->out);
+	} else {
+		uint32_t v = MMIO_REG_VAL(fp->out);
+		MMIO_REG_VAL(fp->out) = high ? v | fp->mask : v & ~fp->mask;
+	}
+}
 
-	uint32_t value = 0;
+static uint8_t shiftInByte(const FastPin *data, const FastPin *clock, uint32_t ulBitOrder)
+{
+	uint8_t value = 0;
 	uint32_t i;
-	for (i = 0; i < 8 ; i++) {
-		digitalWrite(ulClockPin, HIGH);
+	uint32_t saved = interrupt_lock();
+
+	for (i = 0; i < 8; i++) {
+		shiftWrite(clock, 1);
 		if (ulBitOrder == LSBFIRST)
-			value |= digitalRead(ulDataPin) << i;
+			value |= fastPinRead(data) << i;
 		else
-			value |= digitalRead(ulDataPin) << (7-i);
+			value |= fastPinRead(data) << (7 - i);
+		shiftWrite(clock, 0);
+	}
+	interrupt_unlock(saved);
+	return value;
+}
 
-		digitalWrite(ulClockPin,LOW);
+static void shiftOutByte(const FastPin *data, const FastPin *clock, uint32_t ulBitOrder, uint8_t val)
+{
+	uint32_t i;
+	uint32_t saved = interrupt_lock();
+
+	for (i = 0; i < 8; i++) {
+		if (ulBitOrder == LSBFIRST) {
+			shiftWrite(data, val & 0x01);
+			val >>= 1;
+		} else {
+			shiftWrite(data, val & 0x80);
+			val <<= 1;
+		}
+		shiftWrite(clock, 1);
+		shiftWrite(clock, 0);
 	}
+	interrupt_unlock(saved);
+}
 
-	return value;
+uint32_t shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder ) {
+
+	FastPin data, clock;
 
+	fastPinInit(&data, ulDataPin);
+	fastPinInit(&clock, ulClockPin);
+	return shiftInByte(&data, &clock, ulBitOrder);
 }
 
 
 void shiftOut( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint32_t ulVal ) {
 
-	int i;
-	for(i = 0; i < 8; i++) {
-		if(ulBitOrder == LSBFIRST)
-			digitalWrite(ulDataPin, !!(ulVal & (1 << i)));
-		else
-			digitalWrite(ulDataPin, !!(ulVal & (1 << (7-i))));
+	FastPin data, clock;
 
-		digitalWrite(ulClockPin, HIGH);
-		digitalWrite(ulClockPin, LOW);
-	}
+	fastPinInit(&data, ulDataPin);
+	fastPinInit(&clock, ulClockPin);
+	shiftOutByte(&data, &clock, ulBitOrder, ulVal);
+}
+
+
+void shiftInBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint8_t *buf, size_t len ) {
+
+	FastPin data, clock;
+
+	fastPinInit(&data, ulDataPin);
+	fastPinInit(&clock, ulClockPin);
+	while (len--)
+		*buf++ = shiftInByte(&data, &clock, ulBitOrder);
+}
+
+
+void shiftOutBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, const uint8_t *buf, size_t len ) {
+
+	FastPin data, clock;
+
+	fastPinInit(&data, ulDataPin);
+	fastPinInit(&clock, ulClockPin);
+	while (len--)
+		shiftOutByte(&data, &clock, ulBitOrder, *buf++);
 }
 
 
@@ -24,19 +24,38 @@
 #endif
 
 /*
- * \brief
+ * \brief Clocks a byte in from ulDataPin, ulClockPin pulsed high for each bit
+ * and the data read while it is high.
  */
 extern uint32_t shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder ) ;
 
 
 /*
- * \brief
+ * \brief Clocks a byte out on ulDataPin, each bit set before a high pulse on
+ * ulClockPin. The pins must already be outputs.
  */
 extern void shiftOut( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint32_t ulVal ) ;
 
+/*
+ * \brief shiftIn() and shiftOut() of len bytes, the pins resolved once.
+ */
+extern void shiftInBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint8_t *buf, size_t len ) ;
+
+extern void shiftOutBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, const uint8_t *buf, size_t len ) ;
+
 
 #ifdef __cplusplus
 }
+
+static inline void shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint8_t *buf, size_t len )
+{
+	shiftInBuffer(ulDataPin, ulClockPin, ulBitOrder, buf, len);
+}
+
+static inline void shiftOut( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, const uint8_t *buf, size_t len )
+{
+	shiftOutBuffer(ulDataPin, ulClockPin, ulBitOrder, buf, len);
+}
 #endif
 
 #endif /* _WIRING_SHIFT_ */
@@ -0,0 +1,44 @@
+/*
+ * BootTimeReport.ino: prints how long each phase of the boot took, from the
+ * ARC reset vector to setup(), loop() and the BLE core coming up, to track
+ * boot time regressions.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+#include <BootTime.h>
+
+void setup() {
+  Serial.begin(9600);
+  // waiting for the serial monitor counts towards setup(): mark the end of
+  // the sketch's own start-up here instead
+  bootMark(BOOT_LOOP);
+  while (!Serial);
+}
+
+void loop() {
+  // the BLE core comes up in the background; give it a moment
+  delay(2000);
+  bootTimePrint(Serial);
+  Serial.println();
+  while (true);
+}
+
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
@@ -0,0 +1,61 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "BootTime.h"
+
+static const char * const phaseNames[BOOT_PHASES] = {
+    "reset vector",
+    ".data/.bss init",
+    "static constructors",
+    "main() called",
+    "initVariant() entered",
+    "GPIO init",
+    "PWM init",
+    "ADC init",
+    "cfw_platform_init() done",
+    "initVariant() returned",
+    "setup() called",
+    "setup() returned",
+    "BLE core up",
+};
+
+const char *bootPhaseName(uint8_t phase)
+{
+    return phase < BOOT_PHASES ? phaseNames[phase] : "";
+}
+
+void bootTimePrint(Print &out)
+{
+    uint32_t last = 0;
+
+    out.println("     usec    +usec    32kHz  phase");
+    for (uint8_t phase = 0; phase < BOOT_PHASES; phase++) {
+        char line[40];
+
+        if (!bootReached(phase))
+            continue;
+        uint32_t t = bootTime(phase);
+        /* lazy inits run out of order, at first use */
+        uint32_t delta = t >= last ? t - last : 0;
+        snprintf(line, sizeof(line), "%9lu %8lu %8lu  ", (unsigned long)t,
+                 (unsigned long)delta, (unsigned long)bootTicks(phase));
+        out.print(line);
+        out.println(bootPhaseName(phase));
+        if (t > last)
+            last = t;
+    }
+}
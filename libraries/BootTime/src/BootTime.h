@@ -0,0 +1,35 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef BOOTTIME_H
+#define BOOTTIME_H
+
+#include <Arduino.h>
+
+/*
+ * Name of a boot phase of boot_time.h, e.g. "setup() called"
+ */
+const char *bootPhaseName(uint8_t phase);
+
+/*
+ * Prints one line per boot phase reached: microseconds from the ARC reset,
+ * the time since the previous phase reached, the always-on counter and the
+ * phase name. Phases not reached, e.g. lazy PWM/ADC init, are skipped.
+ */
+void bootTimePrint(Print &out);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * CoreBenchmarks.ino: times the core's hot paths - digital and analog I/O,
+ * SPI, I2C, Serial1, millis()/micros(), balloc()/malloc() and EEPROM writes -
+ * and prints one "BENCH <suite>.<name> <value> <unit>" line per result, so
+ * the output of two builds can be diffed by a script.
+ *
+ * Pin 2 is driven and pin 3 read; SPI needs nothing attached. The I2C bus
+ * must be pulled up: the suite addresses 0x7f, which no device answers, so
+ * it times the address phase. The EEPROM suite flips the last byte of the
+ * emulated EEPROM and puts it back.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+#include <CoreBenchmarks.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <EEPROM.h>
+
+extern "C" {
+#include <os/os.h>
+}
+
+const int outPin = 2;
+const int inPin = 3;
+const uint32_t calls = 1000;
+
+static uint8_t spiBuffer[256];
+static char serialBuffer[64];
+static int eepromIndex;
+
+static void toggle()   { digitalWrite(outPin, HIGH); digitalWrite(outPin, LOW); }
+static void readPin()  { (void)digitalRead(inPin); }
+static void readA0()   { (void)analogRead(A0); }
+static void callMillis() { (void)millis(); }
+static void callMicros() { (void)micros(); }
+static void spiBulk()  { SPI.transfer(spiBuffer, sizeof(spiBuffer)); }
+static void i2cProbe() { Wire.beginTransmission(0x7f); Wire.endTransmission(); }
+static void serialOut() { Serial1.write((const uint8_t *)serialBuffer, sizeof(serialBuffer)); }
+static void ballocFree() { OS_ERR_TYPE err; bfree(balloc(32, &err)); }
+static void mallocFree() { free(malloc(32)); }
+static void eepromWrite() { EEPROM.write(eepromIndex, EEPROM.read(eepromIndex) ^ 0xff); }
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial);
+
+  pinMode(outPin, OUTPUT);
+  pinMode(inPin, INPUT);
+  memset(serialBuffer, 'U', sizeof(serialBuffer));
+}
+
+void loop() {
+  float c;
+
+  benchBegin(Serial, "gpio");
+  c = benchCycles(toggle, calls) / 2;
+  benchResult("digitalWrite", benchNanos(c), "ns");
+  benchResult("toggle", benchPerSecond(2 * c), "Hz");
+  c = benchCycles(readPin, calls);
+  benchResult("digitalRead", benchNanos(c), "ns");
+  benchEnd();
+
+  benchBegin(Serial, "adc");
+  c = benchCycles(readA0, calls);
+  benchResult("analogRead", benchNanos(c), "ns");
+  benchResult("rate", benchPerSecond(c), "Hz");
+  benchEnd();
+
+  benchBegin(Serial, "time");
+  benchResult("millis", benchNanos(benchCycles(callMillis, calls)), "ns");
+  benchResult("micros", benchNanos(benchCycles(callMicros, calls)), "ns");
+  benchEnd();
+
+  benchBegin(Serial, "spi");
+  SPI.begin();
+  static const uint32_t clocks[] = { 1000000, 4000000, 8000000, 16000000 };
+  for (unsigned int i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "%luHz", (unsigned long)clocks[i]);
+    SPI.beginTransaction(SPISettings(clocks[i], MSBFIRST, SPI_MODE0));
+    c = benchCycles(spiBulk, 20);
+    SPI.endTransaction();
+    benchResult(name, benchPerSecond(c) * sizeof(spiBuffer), "B/s");
+  }
+  SPI.end();
+  benchEnd();
+
+  benchBegin(Serial, "i2c");
+  Wire.begin();
+  Wire.setClock(100000);
+  benchResult("100kHz", benchPerSecond(benchCycles(i2cProbe, 100)), "xfer/s");
+  Wire.setClock(400000);
+  benchResult("400kHz", benchPerSecond(benchCycles(i2cProbe, 100)), "xfer/s");
+  benchEnd();
+
+  benchBegin(Serial, "serial1");
+  static const uint32_t bauds[] = { 115200, 1000000 };
+  for (unsigned int i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "%lubaud", (unsigned long)bauds[i]);
+    Serial1.begin(bauds[i]);
+    c = benchCycles(serialOut, 50);
+    Serial1.flush();
+    Serial1.end();
+    benchResult(name, benchPerSecond(c) * sizeof(serialBuffer), "B/s");
+  }
+  benchEnd();
+
+  benchBegin(Serial, "alloc");
+  benchResult("balloc", benchNanos(benchCycles(ballocFree, calls)), "ns");
+  benchResult("malloc", benchNanos(benchCycles(mallocFree, calls)), "ns");
+  benchEnd();
+
+  benchBegin(Serial, "eeprom");
+  eepromIndex = EEPROM.length() - 1;
+  c = benchCycles(eepromWrite, 2);
+  eepromWrite();
+  eepromWrite();
+  benchResult("write", benchNanos(c), "ns");
+  benchEnd();
+
+  Serial.println();
+  delay(10000);
+}
+
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CoreBenchmarks.h"
+
+static Print *benchOut;
+static const char *benchSuite;
+
+void benchBegin(Print &out, const char *suite)
+{
+    benchOut = &out;
+    benchSuite = suite;
+    out.print("BENCH_BEGIN ");
+    out.println(suite);
+}
+
+void benchResult(const char *name, float value, const char *unit)
+{
+    if (benchOut == NULL)
+        return;
+    benchOut->print("BENCH ");
+    benchOut->print(benchSuite);
+    benchOut->print('.');
+    benchOut->print(name);
+    benchOut->print(' ');
+    benchOut->print(value, 3);
+    benchOut->print(' ');
+    benchOut->println(unit);
+}
+
+void benchEnd(void)
+{
+    if (benchOut == NULL)
+        return;
+    benchOut->print("BENCH_END ");
+    benchOut->println(benchSuite);
+    benchOut = NULL;
+}
+
+static void __attribute__((noinline)) benchEmpty(void)
+{
+    __asm__ volatile ("");
+}
+
+static uint32_t benchRun(void (*fn)(void), uint32_t n)
+{
+    uint32_t start = cycles();
+    for (uint32_t i = 0; i < n; i++)
+        fn();
+    return cycles() - start;
+}
+
+float benchCycles(void (*fn)(void), uint32_t n)
+{
+    if (n == 0)
+        return 0;
+    uint32_t overhead = benchRun(benchEmpty, n);
+    uint32_t total = benchRun(fn, n);
+    return total > overhead ? (float)(total - overhead) / n : 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef COREBENCHMARKS_H
+#define COREBENCHMARKS_H
+
+#include <Arduino.h>
+
+/*
+ * Results go out one per line, between a begin and an end line, as
+ *
+ *     BENCH_BEGIN <suite>
+ *     BENCH <suite>.<name> <value> <unit>
+ *     BENCH_END <suite>
+ *
+ * with single-space separators, no spaces in names or units and the value
+ * in decimal, so a script can diff two builds' output.
+ */
+void benchBegin(Print &out, const char *suite);
+void benchResult(const char *name, float value, const char *unit);
+void benchEnd(void);
+
+/*
+ * Cycles per call of fn, called n times, less the cost of the calls of an
+ * empty function
+ */
+float benchCycles(void (*fn)(void), uint32_t n);
+
+/* Conversions of a benchCycles() result */
+static inline float benchNanos(float cyclesPerCall)
+{
+    return cyclesPerCall * (1000.0f / (F_CPU / 1000000));
+}
+
+static inline float benchPerSecond(float cyclesPerCall)
+{
+    return cyclesPerCall > 0 ? F_CPU / cyclesPerCall : 0;
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/**
+ * Captures stereo audio on the I2S rx channel, runs it through a high-pass
+ * biquad (to remove DC), a 3 kHz low-pass and a gain stage, and plays the
+ * result on the tx channel. All the processing happens in the DMA block
+ * callback, in interrupt context, on the DMA buffers themselves.
+ *
+ * Connection:
+ *   a codec or ADC/DAC pair on the I2S pins; for exact sample alignment
+ *   clock rx from the tx clocks:
+ *   I2S_RSCK(pin 8) -> I2S_TSCK(pin 2)
+ *   I2S_RWS (pin 3) -> I2S_TWS (pin 4)
+**/
+#include <CurieI2SDMA.h>
+#include <CurieAudio.h>
+
+const int SAMPLE_RATE = 48000;
+const int BLOCKS = 2;                  // ping-pong
+const int FRAMES = 128;                // per block, 2.7 ms at 48 kHz
+
+// 32 bit I2S words, left and right interleaved
+uint32_t txBuff[BLOCKS * FRAMES * 2];
+uint32_t rxBuff[BLOCKS * FRAMES * 2];
+
+AudioPipeline pipeline(2);
+AudioBiquad dcBlock;
+AudioBiquad lowpass;
+AudioGain volume(0.5f);
+
+volatile uint32_t blockCount = 0;
+
+void onBlock(void* rx, void* tx, uint32_t len)
+{
+  // process the captured block in place, then hand it to the tx side
+  pipeline.process32(rx, len);
+  memcpy(tx, rx, len);
+  blockCount++;
+}
+
+void setup()
+{
+  Serial.begin(115200); // initialize Serial communication
+  while(!Serial) ;      // wait for serial port to connect.
+  Serial.println("CurieAudio duplex filter");
+
+  dcBlock.setHighpass(SAMPLE_RATE, 20);
+  lowpass.setLowpass(SAMPLE_RATE, 3000);
+  pipeline.add(dcBlock);
+  pipeline.add(lowpass);
+  pipeline.add(volume);
+
+  CurieI2SDMA.iniTX();
+  CurieI2SDMA.iniRX();
+  // 32 bit resolution, tx master, rx slave, PHILIPS_MODE
+  CurieI2SDMA.beginTX(SAMPLE_RATE, 32, 1, 1);
+  CurieI2SDMA.beginRX(SAMPLE_RATE, 32, 0, 1);
+
+  int status = CurieI2SDMA.streamDuplex(txBuff, rxBuff, sizeof(txBuff), sizeof(uint32_t), BLOCKS, onBlock);
+  if(status)
+  {
+    Serial.println("could not start the streams");
+    while(1);
+  }
+}
+
+void loop()
+{
+  // once a second, report blocks processed and toggle the low-pass
+  delay(1000);
+  Serial.print("blocks: ");
+  Serial.println(blockCount);
+  lowpass.bypass(!lowpass.bypassed());
+}
+
+/*
+  Copyright (c) 2017 Intel Corporation. All rights reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-
+  1301 USA
+*/
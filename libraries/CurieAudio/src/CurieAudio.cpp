@@ -0,0 +1,420 @@
+/*
+ * Fixed point audio block processing for Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include <interrupt.h>
+#include "CurieAudio.h"
+
+#define BIQUAD_Q                14
+
+static int32_t toQ12(float gain)
+{
+    if (gain >= 8.0f)
+        return 8 * CURIE_AUDIO_GAIN_ONE - 1;
+    if (gain <= -8.0f)
+        return -8 * CURIE_AUDIO_GAIN_ONE;
+    return (int32_t)lrintf(gain * CURIE_AUDIO_GAIN_ONE);
+}
+
+/* AudioPipeline */
+
+AudioPipeline::AudioPipeline(uint8_t channels) : _first(NULL)
+{
+    _channels = constrain(channels, 1, CURIE_AUDIO_MAX_CHANNELS);
+}
+
+void AudioPipeline::add(AudioProcessor &processor)
+{
+    AudioProcessor **p = &_first;
+
+    while (*p) {
+        if (*p == &processor)
+            return;
+        p = &(*p)->_next;
+    }
+    processor._next = NULL;
+    *p = &processor;
+}
+
+void AudioPipeline::remove(AudioProcessor &processor)
+{
+    for (AudioProcessor **p = &_first; *p; p = &(*p)->_next) {
+        if (*p == &processor) {
+            *p = processor._next;
+            processor._next = NULL;
+            return;
+        }
+    }
+}
+
+void AudioPipeline::reset(void)
+{
+    for (AudioProcessor *p = _first; p; p = p->_next)
+        p->reset();
+}
+
+void AudioPipeline::process(int16_t *samples, uint16_t frames)
+{
+    for (AudioProcessor *p = _first; p; p = p->_next) {
+        if (!p->_bypass)
+            p->process(samples, frames, _channels);
+    }
+}
+
+void AudioPipeline::process16(void *buf, uint32_t len)
+{
+    process((int16_t *)buf, len / (sizeof(int16_t) * _channels));
+}
+
+void AudioPipeline::process32(void *buf, uint32_t len)
+{
+    int32_t *words = (int32_t *)buf;
+    int16_t *samples = (int16_t *)buf;
+    uint32_t count = len / sizeof(int32_t);
+
+    /* forwards to narrow and backwards to widen, so neither overwrites a
+     * word it has not read yet */
+    for (uint32_t i = 0; i < count; i++)
+        samples[i] = words[i] >> 16;
+
+    process(samples, count / _channels);
+
+    for (uint32_t i = count; i > 0; i--)
+        words[i - 1] = (int32_t)samples[i - 1] << 16;
+}
+
+/* AudioGain */
+
+AudioGain::AudioGain(float gain)
+{
+    setGain(gain);
+}
+
+void AudioGain::setGain(float gain)
+{
+    for (int c = 0; c < CURIE_AUDIO_MAX_CHANNELS; c++)
+        _gain[c] = toQ12(gain);
+}
+
+void AudioGain::setGain(uint8_t channel, float gain)
+{
+    setGainQ12(channel, toQ12(gain));
+}
+
+void AudioGain::setGainQ12(uint8_t channel, int32_t gain)
+{
+    if (channel < CURIE_AUDIO_MAX_CHANNELS)
+        _gain[channel] = gain;
+}
+
+void AudioGain::process(int16_t *samples, uint16_t frames, uint8_t channels)
+{
+    if (channels == 2) {
+        int32_t gl = _gain[0], gr = _gain[1];
+
+        for (uint16_t i = 0; i < frames; i++) {
+            samples[0] = audioSaturate((samples[0] * gl) >> 12);
+            samples[1] = audioSaturate((samples[1] * gr) >> 12);
+            samples += 2;
+        }
+    } else {
+        int32_t g = _gain[0];
+
+        for (uint32_t i = 0; i < (uint32_t)frames * channels; i++)
+            samples[i] = audioSaturate((samples[i] * g) >> 12);
+    }
+}
+
+/* AudioBiquad */
+
+AudioBiquad::AudioBiquad()
+{
+    setCoefficients(1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void AudioBiquad::setCoefficients(float b0, float b1, float b2, float a1, float a2)
+{
+    const float one = 1 << BIQUAD_Q;
+
+    _b0 = lrintf(b0 * one);
+    _b1 = lrintf(b1 * one);
+    _b2 = lrintf(b2 * one);
+    _a1 = lrintf(a1 * one);
+    _a2 = lrintf(a2 * one);
+    reset();
+}
+
+/* The designs are the usual bilinear transform ones (R. Bristow-Johnson,
+ * "Cookbook formulae for audio EQ biquad filter coefficients") */
+void AudioBiquad::setLowpass(float sampleRate, float frequency, float q)
+{
+    float w = 2.0f * (float)M_PI * frequency / sampleRate;
+    float alpha = sinf(w) / (2.0f * q);
+    float c = cosf(w);
+    float a0 = 1.0f + alpha;
+
+    setCoefficients((1.0f - c) / 2.0f / a0, (1.0f - c) / a0, (1.0f - c) / 2.0f / a0,
+                    -2.0f * c / a0, (1.0f - alpha) / a0);
+}
+
+void AudioBiquad::setHighpass(float sampleRate, float frequency, float q)
+{
+    float w = 2.0f * (float)M_PI * frequency / sampleRate;
+    float alpha = sinf(w) / (2.0f * q);
+    float c = cosf(w);
+    float a0 = 1.0f + alpha;
+
+    setCoefficients((1.0f + c) / 2.0f / a0, -(1.0f + c) / a0, (1.0f + c) / 2.0f / a0,
+                    -2.0f * c / a0, (1.0f - alpha) / a0);
+}
+
+void AudioBiquad::setBandpass(float sampleRate, float frequency, float q)
+{
+    float w = 2.0f * (float)M_PI * frequency / sampleRate;
+    float alpha = sinf(w) / (2.0f * q);
+    float c = cosf(w);
+    float a0 = 1.0f + alpha;
+
+    setCoefficients(alpha / a0, 0.0f, -alpha / a0, -2.0f * c / a0, (1.0f - alpha) / a0);
+}
+
+void AudioBiquad::setNotch(float sampleRate, float frequency, float q)
+{
+    float w = 2.0f * (float)M_PI * frequency / sampleRate;
+    float alpha = sinf(w) / (2.0f * q);
+    float c = cosf(w);
+    float a0 = 1.0f + alpha;
+
+    setCoefficients(1.0f / a0, -2.0f * c / a0, 1.0f / a0, -2.0f * c / a0, (1.0f - alpha) / a0);
+}
+
+void AudioBiquad::setPeaking(float sampleRate, float frequency, float q, float gainDb)
+{
+    float a = powf(10.0f, gainDb / 40.0f);
+    float w = 2.0f * (float)M_PI * frequency / sampleRate;
+    float alpha = sinf(w) / (2.0f * q);
+    float c = cosf(w);
+    float a0 = 1.0f + alpha / a;
+
+    setCoefficients((1.0f + alpha * a) / a0, -2.0f * c / a0, (1.0f - alpha * a) / a0,
+                    -2.0f * c / a0, (1.0f - alpha / a) / a0);
+}
+
+void AudioBiquad::reset(void)
+{
+    for (int c = 0; c < CURIE_AUDIO_MAX_CHANNELS; c++)
+        _x1[c] = _x2[c] = _y1[c] = _y2[c] = 0;
+}
+
+void AudioBiquad::process(int16_t *samples, uint16_t frames, uint8_t channels)
+{
+    for (uint8_t c = 0; c < channels && c < CURIE_AUDIO_MAX_CHANNELS; c++) {
+        int16_t x1 = _x1[c], x2 = _x2[c], y1 = _y1[c], y2 = _y2[c];
+        int16_t *s = samples + c;
+
+        for (uint16_t i = 0; i < frames; i++) {
+            int16_t x = *s;
+            /* 64 bits, as a peaking section's b0 can be above 2.0 */
+            int64_t acc = (int64_t)_b0 * x + (int64_t)_b1 * x1 + (int64_t)_b2 * x2
+                          - (int64_t)_a1 * y1 - (int64_t)_a2 * y2;
+            int32_t y = (int32_t)(acc >> BIQUAD_Q);
+
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = audioSaturate(y);
+            *s = y1;
+            s += channels;
+        }
+        _x1[c] = x1;
+        _x2[c] = x2;
+        _y1[c] = y1;
+        _y2[c] = y2;
+    }
+}
+
+/* AudioFIR */
+
+AudioFIR::AudioFIR(const int16_t *coeffs, uint16_t taps, int16_t *history, uint8_t channels) :
+    _coeffs(coeffs), _history(history), _taps(taps), _pos(0), _channels(channels)
+{
+}
+
+void AudioFIR::reset(void)
+{
+    memset(_history, 0, (uint32_t)_taps * _channels * sizeof(int16_t));
+    _pos = 0;
+}
+
+void AudioFIR::process(int16_t *samples, uint16_t frames, uint8_t channels)
+{
+    uint16_t taps = _taps;
+
+    if (!taps || channels > _channels)
+        return;
+
+    for (uint16_t i = 0; i < frames; i++) {
+        /* the history runs backwards from _pos, newest first, so the taps
+         * are two straight runs with no index wrap */
+        uint16_t pos = _pos ? _pos - 1 : taps - 1;
+        uint16_t head = taps - pos;
+
+        for (uint8_t c = 0; c < channels; c++) {
+            int16_t *h = _history + c * taps;
+            int32_t acc = 0;
+
+            h[pos] = samples[c];
+            for (uint16_t k = 0; k < head; k++)
+                acc += (int32_t)_coeffs[k] * h[pos + k];
+            for (uint16_t k = head; k < taps; k++)
+                acc += (int32_t)_coeffs[k] * h[k - head];
+            samples[c] = audioSaturate(acc >> 15);
+        }
+        _pos = pos;
+        samples += channels;
+    }
+}
+
+/* AudioMixer */
+
+AudioMixer::AudioMixer(float gain, float inputGain) : _input(NULL)
+{
+    setGains(gain, inputGain);
+}
+
+void AudioMixer::setGains(float gain, float inputGain)
+{
+    _gain = toQ12(gain);
+    _input_gain = toQ12(inputGain);
+}
+
+void AudioMixer::process(int16_t *samples, uint16_t frames, uint8_t channels)
+{
+    uint32_t count = (uint32_t)frames * channels;
+    const int16_t *in = _input;
+
+    if (in) {
+        for (uint32_t i = 0; i < count; i++)
+            samples[i] = audioSaturate((samples[i] * _gain + in[i] * _input_gain) >> 12);
+    } else if (_gain != CURIE_AUDIO_GAIN_ONE) {
+        for (uint32_t i = 0; i < count; i++)
+            samples[i] = audioSaturate((samples[i] * _gain) >> 12);
+    }
+}
+
+/* AudioResampler */
+
+AudioResampler::AudioResampler() : _step(1UL << 16), _phase(0), _channels(2)
+{
+    reset();
+}
+
+void AudioResampler::begin(uint32_t inRate, uint32_t outRate, uint8_t channels)
+{
+    _channels = constrain(channels, 1, CURIE_AUDIO_MAX_CHANNELS);
+    if (inRate && outRate)
+        _step = ((uint64_t)inRate << 16) / outRate;
+    reset();
+}
+
+void AudioResampler::reset(void)
+{
+    _phase = 0;
+    for (int c = 0; c < CURIE_AUDIO_MAX_CHANNELS; c++)
+        _last[c] = 0;
+}
+
+uint16_t AudioResampler::process(const int16_t *in, uint16_t inFrames, int16_t *out, uint16_t maxOut)
+{
+    uint8_t channels = _channels;
+    uint32_t phase = _phase;
+    uint16_t n = 0;
+
+    if (!inFrames)
+        return 0;
+
+    /* frame -1 is the last one of the previous block */
+    while ((phase >> 16) < inFrames && n < maxOut) {
+        uint32_t i = phase >> 16;
+        int32_t frac = phase & 0xFFFF;
+        const int16_t *b = in + i * channels;
+        const int16_t *a = i ? b - channels : _last;
+
+        for (uint8_t c = 0; c < channels; c++)
+            *out++ = a[c] + (((b[c] - a[c]) * frac) >> 16);
+        phase += _step;
+        n++;
+    }
+
+    uint32_t end = (uint32_t)inFrames << 16;
+    _phase = phase > end ? phase - end : 0;
+    for (uint8_t c = 0; c < channels; c++)
+        _last[c] = in[(inFrames - 1) * channels + c];
+    return n;
+}
+
+/* AudioBlockPool */
+
+AudioBlockPool::AudioBlockPool(void *storage, uint16_t blockBytes, uint8_t count) :
+    _storage((uint8_t *)storage), _block_bytes(blockBytes), _used(0)
+{
+    _count = count > 32 ? 32 : count;
+}
+
+int16_t *AudioBlockPool::alloc(void)
+{
+    uint32_t flags = interrupt_lock();
+    int16_t *block = NULL;
+
+    for (uint8_t i = 0; i < _count; i++) {
+        if (!(_used & (1UL << i))) {
+            _used |= 1UL << i;
+            block = (int16_t *)(_storage + (uint32_t)i * _block_bytes);
+            break;
+        }
+    }
+    interrupt_unlock(flags);
+    return block;
+}
+
+void AudioBlockPool::release(int16_t *block)
+{
+    uint32_t offset = (uint8_t *)block - _storage;
+    uint32_t i = offset / _block_bytes;
+
+    if (!block || (uint8_t *)block < _storage || i >= _count)
+        return;
+
+    uint32_t flags = interrupt_lock();
+    _used &= ~(1UL << i);
+    interrupt_unlock(flags);
+}
+
+uint8_t AudioBlockPool::available(void) const
+{
+    uint32_t used = _used;
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < _count; i++)
+        n += !(used & (1UL << i));
+    return n;
+}
@@ -0,0 +1,220 @@
+/*
+ * Fixed point audio block processing for Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CURIEAUDIO_H_
+#define _CURIEAUDIO_H_
+
+#include <Arduino.h>
+
+/* Samples are signed 16 bit, channels interleaved (L R L R ...) as the
+ * CurieI2SDMA buffers; every processor works in place on a block, so an
+ * AudioPipeline can run straight on a DMA block from a CurieI2SDMA stream
+ * callback, in interrupt context. Nothing here allocates memory.
+ */
+#define CURIE_AUDIO_MAX_CHANNELS    2
+
+/* Gains are Q12: 1.0 == 4096, up to just under 8.0 */
+#define CURIE_AUDIO_GAIN_ONE        4096
+
+static inline int16_t audioSaturate(int32_t v)
+{
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return (int16_t)v;
+}
+
+/* Base of the in place block processors, chained by AudioPipeline */
+class AudioProcessor {
+    public:
+        AudioProcessor() : _next(NULL), _bypass(false) {}
+
+        virtual void process(int16_t *samples, uint16_t frames, uint8_t channels) = 0;
+        // clears filter state, e.g. when the stream restarts
+        virtual void reset(void) {}
+
+        void bypass(bool on) { _bypass = on; }
+        bool bypassed(void) const { return _bypass; }
+
+    private:
+        friend class AudioPipeline;
+        AudioProcessor *_next;
+        bool _bypass;
+};
+
+/* Runs processors in the order they were added */
+class AudioPipeline {
+    public:
+        AudioPipeline(uint8_t channels = 2);
+
+        void add(AudioProcessor &processor);
+        void remove(AudioProcessor &processor);
+        void reset(void);
+
+        void process(int16_t *samples, uint16_t frames);
+        // a block of 16 bit words, len in bytes, as I2SDMABlockCallback gives
+        void process16(void *buf, uint32_t len);
+        // a block of 32 bit I2S words with the sample in the upper 16 bits;
+        // narrowed to 16 bits in place, processed and widened back
+        void process32(void *buf, uint32_t len);
+
+    private:
+        AudioProcessor *_first;
+        uint8_t _channels;
+};
+
+/* Per channel gain, saturating */
+class AudioGain : public AudioProcessor {
+    public:
+        AudioGain(float gain = 1.0f);
+
+        void setGain(float gain);
+        void setGain(uint8_t channel, float gain);
+        void setGainQ12(uint8_t channel, int32_t gain);
+
+        virtual void process(int16_t *samples, uint16_t frames, uint8_t channels);
+
+    private:
+        int32_t _gain[CURIE_AUDIO_MAX_CHANNELS];
+};
+
+/* Second order IIR section, direct form I, Q14 coefficients and a 64 bit
+ * accumulator; the same filter runs on every channel, each with its own
+ * state. The design helpers use float once, at setup.
+ */
+class AudioBiquad : public AudioProcessor {
+    public:
+        AudioBiquad();
+
+        // normalised coefficients, a0 == 1
+        void setCoefficients(float b0, float b1, float b2, float a1, float a2);
+        void setLowpass(float sampleRate, float frequency, float q = 0.7071f);
+        void setHighpass(float sampleRate, float frequency, float q = 0.7071f);
+        void setBandpass(float sampleRate, float frequency, float q);
+        void setNotch(float sampleRate, float frequency, float q);
+        void setPeaking(float sampleRate, float frequency, float q, float gainDb);
+
+        virtual void process(int16_t *samples, uint16_t frames, uint8_t channels);
+        virtual void reset(void);
+
+    private:
+        int32_t _b0, _b1, _b2, _a1, _a2;
+        int16_t _x1[CURIE_AUDIO_MAX_CHANNELS], _x2[CURIE_AUDIO_MAX_CHANNELS];
+        int16_t _y1[CURIE_AUDIO_MAX_CHANNELS], _y2[CURIE_AUDIO_MAX_CHANNELS];
+};
+
+/* FIR filter with Q15 taps, summing in 32 bits: keep the sum of |taps|
+ * below 2.0. history must hold taps * channels samples, zeroed, and both
+ * arrays must outlive the filter.
+ */
+class AudioFIR : public AudioProcessor {
+    public:
+        AudioFIR(const int16_t *coeffs, uint16_t taps, int16_t *history, uint8_t channels = 2);
+
+        virtual void process(int16_t *samples, uint16_t frames, uint8_t channels);
+        virtual void reset(void);
+
+    private:
+        const int16_t *_coeffs;
+        int16_t *_history;
+        uint16_t _taps;
+        uint16_t _pos;
+        uint8_t _channels;
+};
+
+/* Adds a second block into the processed one: out = in * gain + input *
+ * inputGain. setInput() names the block to mix for the next process()
+ * call, e.g. a synthesised tone or the other stream of streamDuplex();
+ * with no input the block is only scaled.
+ */
+class AudioMixer : public AudioProcessor {
+    public:
+        AudioMixer(float gain = 1.0f, float inputGain = 1.0f);
+
+        void setGains(float gain, float inputGain);
+        void setInput(const int16_t *input) { _input = input; }
+
+        virtual void process(int16_t *samples, uint16_t frames, uint8_t channels);
+
+    private:
+        const int16_t *_input;
+        int32_t _gain;
+        int32_t _input_gain;
+};
+
+/* Sample rate converter with linear interpolation. The frame count changes,
+ * so it works between two buffers rather than in a pipeline; the last input
+ * frame is kept so consecutive blocks join without a click.
+ */
+class AudioResampler {
+    public:
+        AudioResampler();
+
+        void begin(uint32_t inRate, uint32_t outRate, uint8_t channels = 2);
+        void reset(void);
+
+        // returns the frames written to out, at most maxOut; all in frames
+        // are consumed when out is big enough (inFrames * outRate / inRate,
+        // rounded up)
+        uint16_t process(const int16_t *in, uint16_t inFrames, int16_t *out, uint16_t maxOut);
+
+    private:
+        uint32_t _step;         // input frames per output frame, Q16
+        uint32_t _phase;        // position past _last, Q16
+        int16_t _last[CURIE_AUDIO_MAX_CHANNELS];
+        uint8_t _channels;
+};
+
+/* Fixed size blocks from caller provided storage, for the intermediate
+ * buffers of a graph; alloc() and release() may be called from interrupts.
+ * Up to 32 blocks.
+ */
+class AudioBlockPool {
+    public:
+        AudioBlockPool(void *storage, uint16_t blockBytes, uint8_t count);
+
+        int16_t *alloc(void);
+        void release(int16_t *block);
+        uint8_t available(void) const;
+
+    private:
+        uint8_t *_storage;
+        uint16_t _block_bytes;
+        uint8_t _count;
+        volatile uint32_t _used;
+};
+
+/* AudioBlockPool with its storage, e.g.
+ *   AudioBlockPoolOf<256, 2, 4> pool;      // four blocks of 256 stereo frames
+ */
+template <uint16_t Frames, uint8_t Channels, uint8_t Count>
+class AudioBlockPoolOf : public AudioBlockPool {
+    static_assert(Count > 0 && Count <= 32, "AudioBlockPoolOf: 1 to 32 blocks");
+
+    public:
+        AudioBlockPoolOf() : AudioBlockPool(_blocks, Frames * Channels * sizeof(int16_t), Count) {}
+
+    private:
+        int16_t _blocks[Count][Frames * Channels];
+};
+
+#endif /* _CURIEAUDIO_H_ */
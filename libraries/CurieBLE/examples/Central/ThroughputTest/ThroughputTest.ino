@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+ * Sketch: ThroughputTest.ino
+ *
+ * Description:
+ *   This is the Central half of a BLE throughput and latency benchmark,
+ *   to run against the Peripheral/Throughput sketch on a second board.
+ *   It times the connection set up and the attribute discovery, then
+ *   measures for a few seconds each the notify throughput, the write
+ *   without response throughput and the read round trip, and prints
+ *
+ *     BENCH ble.central.<name> <value> <unit>
+ *
+ *   lines, in the format of the CoreBenchmarks library, together with the
+ *   ATT MTU and connection interval they were measured with.
+ */
+
+#include <CurieBLE.h>
+
+#define BENCH_SERVICE_UUID  "19b10100-e8f2-537e-4f6c-d104768a1214"
+
+const unsigned long testMillis = 5000;
+
+volatile unsigned long bytesNotified = 0;
+
+void onNotified(BLEDevice peripheral, BLECharacteristic characteristic) {
+  // called from the BLE interrupt: only count
+  bytesNotified += characteristic.valueLength();
+}
+
+void report(const char *name, float value, const char *unit) {
+  Serial.print("BENCH ble.central.");
+  Serial.print(name);
+  Serial.print(' ');
+  Serial.print(value, 3);
+  Serial.print(' ');
+  Serial.println(unit);
+}
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial);
+
+  BLE.begin();
+
+  Serial.println("BLE Central - Throughput test");
+
+  BLE.scanForUuid(BENCH_SERVICE_UUID);
+}
+
+void loop() {
+  BLEDevice peripheral = BLE.available();
+
+  if (peripheral) {
+    Serial.print("Found ");
+    Serial.println(peripheral.address());
+
+    BLE.stopScan();
+
+    runTests(peripheral);
+    peripheral.disconnect();
+
+    delay(5000);
+    BLE.scanForUuid(BENCH_SERVICE_UUID);
+  }
+}
+
+void runTests(BLEDevice peripheral) {
+  unsigned long start = micros();
+  if (!peripheral.connect()) {
+    Serial.println("Failed to connect!");
+    return;
+  }
+  unsigned long connectMicros = micros() - start;
+
+  start = micros();
+  if (!peripheral.discoverAttributes()) {
+    Serial.println("Attribute discovery failed!");
+    return;
+  }
+  unsigned long discoverMicros = micros() - start;
+
+  BLECharacteristic notifyCharacteristic = peripheral.characteristic("19b10101-e8f2-537e-4f6c-d104768a1214");
+  BLECharacteristic writeCharacteristic = peripheral.characteristic("19b10102-e8f2-537e-4f6c-d104768a1214");
+  BLECharacteristic readCharacteristic = peripheral.characteristic("19b10103-e8f2-537e-4f6c-d104768a1214");
+
+  if (!notifyCharacteristic || !writeCharacteristic || !readCharacteristic) {
+    Serial.println("Peripheral is not running the Throughput sketch!");
+    return;
+  }
+
+  // the peripheral runs as fast as the central's connection interval allows
+  peripheral.setConnectionProfile(BLEConnectionThroughput);
+  delay(1000);
+
+  Serial.println("BENCH_BEGIN ble.central");
+  report("connect", connectMicros / 1000.0, "ms");
+  report("discover", discoverMicros / 1000.0, "ms");
+  report("mtu", peripheral.mtu(), "B");
+  report("interval", peripheral.getConnectionInterval(), "ms");
+
+  // notifications: the peripheral sends while subscribed
+  notifyCharacteristic.setEventHandler(BLEValueUpdated, onNotified);
+  bytesNotified = 0;
+  start = millis();
+  notifyCharacteristic.subscribe();
+  while (millis() - start < testMillis && peripheral.connected());
+  notifyCharacteristic.unsubscribe();
+  report("notify", bytesNotified * 1000.0 / (millis() - start), "B/s");
+
+  // writes without response, as fast as write() takes them
+  unsigned char packet[20];
+  int length = peripheral.mtu() - 3;
+  if (length > (int)sizeof(packet)) {
+    length = sizeof(packet);
+  }
+  memset(packet, 0x55, sizeof(packet));
+  unsigned long bytesWritten = 0;
+  start = millis();
+  while (millis() - start < testMillis && peripheral.connected()) {
+    if (writeCharacteristic.write(packet, length)) {
+      bytesWritten += length;
+    }
+  }
+  report("writeWithoutResponse", bytesWritten * 1000.0 / (millis() - start), "B/s");
+
+  // blocking reads, one round trip each
+  unsigned long reads = 0;
+  unsigned long maxMicros = 0;
+  start = millis();
+  while (millis() - start < testMillis && peripheral.connected()) {
+    unsigned long t0 = micros();
+    if (!readCharacteristic.read()) {
+      break;
+    }
+    unsigned long t = micros() - t0;
+    if (t > maxMicros) {
+      maxMicros = t;
+    }
+    reads++;
+  }
+  if (reads > 0) {
+    report("read", (millis() - start) * 1000.0 / reads, "us");
+    report("readMax", maxMicros, "us");
+  }
+  Serial.println("BENCH_END ble.central");
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
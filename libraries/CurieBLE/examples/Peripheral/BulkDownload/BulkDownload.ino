@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+ * Sketch: BulkDownload.ino
+ *
+ * Description:
+ *   Takes a blob, such as a firmware image, from a phone over the bulk
+ *   transfer service and programs it into the first half of the onboard
+ *   flash, then reads it back and checks it against the CRC-32 the phone
+ *   gave. Keep SerialFlash files out of that area.
+ *
+ *   Blocks are programmed as they complete while the next one is being
+ *   received. Erases run one sector ahead of the data, from flash.poll()
+ *   while the chip would be idle, so they don't hold up the programming
+ *   either.
+ */
+
+#include <CurieBLE.h>
+#include <CurieFlashChip.h>
+#include <crc.h>
+
+#define DOWNLOAD_ADDR 0
+
+CurieFlashChip flash;
+BLEBulkTransfer bulk;
+
+uint32_t downloadLength;
+uint32_t nextErase;
+unsigned long startMillis;
+
+bool started(uint32_t length) {
+  if (length > flash.capacity() / 2)
+    return false;
+
+  downloadLength = length;
+  nextErase = DOWNLOAD_ADDR;
+  flash.queueErase(nextErase);
+  nextErase += CURIE_FLASH_SECTOR_SIZE;
+  startMillis = millis();
+  Serial.print("Receiving ");
+  Serial.print(length);
+  Serial.println(" bytes");
+  return true;
+}
+
+bool received(uint32_t offset, const uint8_t *data, uint16_t length) {
+  uint32_t end = DOWNLOAD_ADDR + offset + length;
+
+  // keep the sector after the one being written erased or queued
+  while (nextErase < end + CURIE_FLASH_SECTOR_SIZE &&
+         nextErase < DOWNLOAD_ADDR + downloadLength &&
+         flash.queueErase(nextErase))
+    nextErase += CURIE_FLASH_SECTOR_SIZE;
+
+  // any erase still queued for this area is done first
+  flash.write(DOWNLOAD_ADDR + offset, data, length);
+  return true;
+}
+
+void ended(uint8_t status, uint32_t length) {
+  unsigned long ms = millis() - startMillis;
+
+  if (status != BLE_BULK_OK) {
+    Serial.print("Transfer failed, status ");
+    Serial.println(status);
+    return;
+  }
+
+  uint8_t buffer[256];
+  uint32_t crc = 0;
+  for (uint32_t done = 0; done < length; done += sizeof(buffer)) {
+    uint32_t n = min((uint32_t)sizeof(buffer), length - done);
+    flash.read(DOWNLOAD_ADDR + done, buffer, n);
+    crc = crc32(crc, buffer, n);
+  }
+
+  Serial.print(length);
+  Serial.print(" bytes in ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print(ms ? length * 1000 / ms : 0);
+  Serial.print(" bytes/s, ");
+  Serial.print(bulk.dropped());
+  Serial.print(" chunks dropped, CRC-32 ");
+  Serial.println(crc, HEX);
+}
+
+void setup() {
+  Serial.begin(9600);
+
+  if (!flash.begin()) {
+    Serial.println("No flash chip found");
+    while (1) ;
+  }
+
+  BLE.begin();
+  BLE.setLocalName("BulkDownload");
+  bulk.setHandlers(started, received, ended);
+  bulk.begin();
+  BLE.setAdvertisedService(bulk.service());
+  BLE.advertise();
+
+  Serial.println("Waiting for a download...");
+}
+
+void loop() {
+  // starts the queued erases while the chip is idle
+  flash.poll();
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+ * Sketch: SerialBridge.ino
+ *
+ * Description:
+ *   Bridges the USB serial port to a BLE serial port, as the Nordic UART
+ *   service that terminal apps such as nRF Toolbox or Serial Bluetooth
+ *   Terminal connect to. What you type in the Serial Monitor shows up on
+ *   the phone and the other way round, and a line with the uptime is
+ *   printed to the phone every second.
+ *
+ *   Each print() only fills the pending notification; full ones go out at
+ *   once and a part filled one a few milliseconds later.
+ */
+
+#include <CurieBLE.h>
+
+BLESerial bleSerial;
+
+unsigned long lastReport = 0;
+
+void setup() {
+  Serial.begin(9600);
+
+  BLE.begin();
+  BLE.setLocalName("BLESerial");
+  bleSerial.begin();
+  BLE.setAdvertisedService(bleSerial.service());
+  BLE.advertise();
+
+  Serial.println("BLE serial bridge, waiting for connections...");
+}
+
+void loop() {
+  uint8_t buffer[64];
+  size_t n;
+
+  // USB to BLE, as much as is buffered at a time
+  n = Serial.read(buffer, sizeof(buffer));
+  if (n > 0) {
+    bleSerial.write(buffer, n);
+  }
+
+  // BLE to USB
+  while (bleSerial.available()) {
+    Serial.write(bleSerial.read());
+  }
+
+  if (bleSerial && millis() - lastReport >= 1000) {
+    lastReport = millis();
+    bleSerial.print("uptime ");
+    bleSerial.print(lastReport / 1000);
+    bleSerial.println(" s");
+  }
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+ * Sketch: Throughput.ino
+ *
+ * Description:
+ *   This is the Peripheral half of a BLE throughput and latency benchmark,
+ *   to run against the Central/ThroughputTest sketch on a second board.
+ *   While the Central is subscribed it sends notifications back to back,
+ *   it counts the Central's writes without response, and it serves a small
+ *   value for the Central to time reads with. Once a second it prints
+ *
+ *     BENCH ble.peripheral.<name> <value> <unit>
+ *
+ *   lines with the notify and write rates, the ATT MTU and the connection
+ *   interval, in the format of the CoreBenchmarks library.
+ */
+
+#include <CurieBLE.h>
+
+BLEService benchService("19B10100-E8F2-537E-4F6C-D104768A1214");
+BLECharacteristic notifyCharacteristic("19B10101-E8F2-537E-4F6C-D104768A1214", BLENotify, 20);
+BLECharacteristic writeCharacteristic("19B10102-E8F2-537E-4F6C-D104768A1214", BLEWriteWithoutResponse, 20);
+BLECharacteristic readCharacteristic("19B10103-E8F2-537E-4F6C-D104768A1214", BLERead, 4);
+
+volatile unsigned long bytesWritten = 0;
+
+void onWritten(BLEDevice central, BLECharacteristic characteristic) {
+  // called from the BLE interrupt: only count
+  bytesWritten += characteristic.valueLength();
+}
+
+void setup() {
+  Serial.begin(9600);
+
+  BLE.begin();
+  BLE.setLocalName("Throughput");
+  BLE.setAdvertisedService(benchService);
+
+  benchService.addCharacteristic(notifyCharacteristic);
+  benchService.addCharacteristic(writeCharacteristic);
+  benchService.addCharacteristic(readCharacteristic);
+  BLE.addService(benchService);
+
+  writeCharacteristic.setEventHandler(BLEWritten, onWritten);
+  readCharacteristic.setValue((const unsigned char *)"\0\0\0\0", 4);
+
+  BLE.advertise();
+  Serial.println("BLE Throughput Peripheral");
+}
+
+void report(const char *name, float value, const char *unit) {
+  Serial.print("BENCH ble.peripheral.");
+  Serial.print(name);
+  Serial.print(' ');
+  Serial.print(value, 3);
+  Serial.print(' ');
+  Serial.println(unit);
+}
+
+void loop() {
+  BLEDevice central = BLE.central();
+
+  if (!central) {
+    return;
+  }
+
+  Serial.print("Connected to central: ");
+  Serial.println(central.address());
+
+  unsigned char packet[20];
+  unsigned long sequence = 0;
+  unsigned long bytesNotified = 0;
+  unsigned long lastReport = millis();
+
+  memset(packet, 0, sizeof(packet));
+
+  while (central.connected()) {
+    int length = central.mtu() - 3;
+    if (length > (int)sizeof(packet)) {
+      length = sizeof(packet);
+    }
+
+    // notifyAsync() queues the value and says no once the queue is full,
+    // so this loop runs the notifications as fast as the link takes them
+    if (notifyCharacteristic.subscribed()) {
+      memcpy(packet, &sequence, sizeof(sequence));
+      if (notifyCharacteristic.notifyAsync(packet, length)) {
+        sequence++;
+        bytesNotified += length;
+      }
+    }
+
+    unsigned long now = millis();
+    if (now - lastReport >= 1000) {
+      float seconds = (now - lastReport) / 1000.0;
+
+      noInterrupts();
+      unsigned long written = bytesWritten;
+      bytesWritten = 0;
+      interrupts();
+
+      readCharacteristic.setValue((const unsigned char *)&sequence, 4);
+
+      Serial.println("BENCH_BEGIN ble.peripheral");
+      report("notify", bytesNotified / seconds, "B/s");
+      report("writeWithoutResponse", written / seconds, "B/s");
+      report("mtu", central.mtu(), "B");
+      report("interval", central.getConnectionInterval(), "ms");
+      Serial.println("BENCH_END ble.peripheral");
+
+      bytesNotified = 0;
+      lastReport = now;
+    }
+  }
+
+  Serial.print("Disconnected from central: ");
+  Serial.println(central.address());
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
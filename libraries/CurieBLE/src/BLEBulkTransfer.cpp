@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieBLE.h"
+#include "crc.h"
+
+#include "BLEBulkTransfer.h"
+
+BLEBulkTransfer* BLEBulkTransfer::_transfers = NULL;
+
+BLEBulkTransferAttributes::BLEBulkTransferAttributes():
+    _service(BLE_BULK_SERVICE_UUID),
+    _dataCharacteristic(BLE_BULK_DATA_UUID,
+                        BLEWriteWithoutResponse,
+                        BLE_MAX_ATTR_DATA_LEN),
+    _controlCharacteristic(BLE_BULK_CONTROL_UUID,
+                           BLEWrite | BLENotify,
+                           BLE_MAX_ATTR_DATA_LEN)
+{
+}
+
+BLEBulkTransfer::BLEBulkTransfer():
+    _next(NULL),
+    _onStart(NULL),
+    _onData(NULL),
+    _onEnd(NULL),
+    _command(0),
+    _active(false),
+    _length(0),
+    _chunks(0),
+    _block(0),
+    _expect(0),
+    _received(0),
+    _ackDue(false),
+    _dropped(0),
+    _lastAck(0),
+    _doneStatus(BLE_BULK_OK),
+    _donePending(false),
+    _busy(false),
+    _task(pollTask, this)
+{
+    _map[0] = _map[1] = 0;
+}
+
+BLEBulkTransfer::~BLEBulkTransfer()
+{
+    end();
+}
+
+void BLEBulkTransfer::setHandlers(BLEBulkStartHandler start,
+                                  BLEBulkDataHandler data,
+                                  BLEBulkEndHandler end)
+{
+    _onStart = start;
+    _onData = data;
+    _onEnd = end;
+}
+
+void BLEBulkTransfer::begin()
+{
+    end();
+    _dataCharacteristic.setStreamHandlers(dataWritten);
+    _controlCharacteristic.setStreamHandlers(controlWritten);
+    // An acknowledgement supersedes the one before, and DONE any of them
+    _controlCharacteristic.setNotifyCoalescing(true, true);
+
+    uint32_t saved = interrupt_lock();
+    _next = _transfers;
+    _transfers = this;
+    interrupt_unlock(saved);
+
+    _service.addCharacteristic(_dataCharacteristic);
+    _service.addCharacteristic(_controlCharacteristic);
+    BLE.addService(_service);
+    _task.start(0, 1);
+}
+
+void BLEBulkTransfer::end()
+{
+    _active = false;
+    uint32_t saved = interrupt_lock();
+    BLEBulkTransfer** link = &_transfers;
+    while (NULL != *link)
+    {
+        if (*link == this)
+        {
+            *link = _next;
+            break;
+        }
+        link = &(*link)->_next;
+    }
+    _next = NULL;
+    interrupt_unlock(saved);
+    _task.stop();
+}
+
+BLEService& BLEBulkTransfer::service()
+{
+    return _service;
+}
+
+bool BLEBulkTransfer::active() const
+{
+    return _active;
+}
+
+uint32_t BLEBulkTransfer::received() const
+{
+    return _received;
+}
+
+unsigned long BLEBulkTransfer::dropped() const
+{
+    return _dropped;
+}
+
+// The handlers have no context, so find the transfer by the characteristic
+//  written to. They run in the IPC UART interrupt.
+void BLEBulkTransfer::dataWritten(BLEDevice bledev,
+                                  BLECharacteristic characteristic,
+                                  const unsigned char data[],
+                                  unsigned short length,
+                                  unsigned short offset)
+{
+    if (NULL == data || 0 != offset)
+    {
+        return;
+    }
+
+    const char* uuid = characteristic.uuid();
+    for (BLEBulkTransfer* transfer = _transfers; NULL != transfer; transfer = transfer->_next)
+    {
+        if (0 == strcmp(uuid, transfer->_dataCharacteristic.uuid()))
+        {
+            transfer->receive(data, length);
+            break;
+        }
+    }
+}
+
+// Commands are only noted here; poll() acts on them, in thread context
+void BLEBulkTransfer::controlWritten(BLEDevice bledev,
+                                     BLECharacteristic characteristic,
+                                     const unsigned char data[],
+                                     unsigned short length,
+                                     unsigned short offset)
+{
+    if (NULL == data || 0 == length || 0 != offset)
+    {
+        return;
+    }
+
+    const char* uuid = characteristic.uuid();
+    for (BLEBulkTransfer* transfer = _transfers; NULL != transfer; transfer = transfer->_next)
+    {
+        if (0 != strcmp(uuid, transfer->_controlCharacteristic.uuid()))
+        {
+            continue;
+        }
+        if (BLE_BULK_OP_START == data[0] && length >= 9)
+        {
+            memcpy(&transfer->_commandLength, data + 1, sizeof(uint32_t));
+            memcpy(&transfer->_commandCrc, data + 5, sizeof(uint32_t));
+            transfer->_command = BLE_BULK_OP_START;
+        }
+        else if (BLE_BULK_OP_ABORT == data[0])
+        {
+            transfer->_command = BLE_BULK_OP_ABORT;
+        }
+        break;
+    }
+}
+
+// Copies a chunk into the block buffer it belongs to. The window holds the
+//  oldest block being assembled and the one after; anything outside it is
+//  a duplicate, or the data handler is behind, and the client learns what
+//  to resend from the next acknowledgement.
+void BLEBulkTransfer::receive(const unsigned char data[], unsigned short length)
+{
+    if (!_active || length < 3)
+    {
+        return;
+    }
+
+    uint16_t seq = data[0] | (data[1] << 8);
+    uint32_t base = _block * BLE_BULK_BLOCK_CHUNKS_CFG;
+    int16_t ahead = (int16_t)(seq - (uint16_t)base);
+    if (ahead < 0)
+    {
+        // The client missed an acknowledgement
+        _ackDue = true;
+        return;
+    }
+
+    uint32_t index = base + ahead;
+    if (index >= _chunks)
+    {
+        return;
+    }
+    if (index >= base + BLE_BULK_WINDOW)
+    {
+        _dropped++;
+        _ackDue = true;
+        return;
+    }
+
+    uint16_t size = (index == _chunks - 1) ?
+                    _length - index * BLE_BULK_CHUNK_DATA : BLE_BULK_CHUNK_DATA;
+    if (length - 2 != size)
+    {
+        return;
+    }
+
+    uint8_t slot = (index / BLE_BULK_BLOCK_CHUNKS_CFG) & 1;
+    uint32_t chunk = index % BLE_BULK_BLOCK_CHUNKS_CFG;
+    if (_map[slot] & (1UL << chunk))
+    {
+        return;
+    }
+    memcpy(_buffer[slot] + chunk * BLE_BULK_CHUNK_DATA, data + 2, size);
+    _map[slot] |= 1UL << chunk;
+
+    // A gap, or a resend filling one, is worth telling the client about
+    if (index != _expect)
+    {
+        _ackDue = true;
+    }
+    if (index >= _expect)
+    {
+        _expect = index + 1;
+    }
+}
+
+bool BLEBulkTransfer::blockFull(uint32_t block)
+{
+    uint32_t first = block * BLE_BULK_BLOCK_CHUNKS_CFG;
+    uint32_t count = _chunks - first;
+    if (count > BLE_BULK_BLOCK_CHUNKS_CFG)
+    {
+        count = BLE_BULK_BLOCK_CHUNKS_CFG;
+    }
+    uint32_t full = (32 == count) ? 0xFFFFFFFFUL : (1UL << count) - 1;
+    return (_map[block & 1] & full) == full;
+}
+
+void BLEBulkTransfer::start()
+{
+    if (_active)
+    {
+        finish(BLE_BULK_ABORTED);
+    }
+
+    _length = _commandLength;
+    _expectedCrc = _commandCrc;
+    _received = 0;
+    _crc = 0;
+    if (NULL == _onData || (NULL != _onStart && !_onStart(_length)))
+    {
+        _doneStatus = BLE_BULK_REJECTED;
+        _donePending = true;
+        return;
+    }
+
+    _chunks = (_length + BLE_BULK_CHUNK_DATA - 1) / BLE_BULK_CHUNK_DATA;
+    _block = 0;
+    _map[0] = _map[1] = 0;
+    _expect = 0;
+    _donePending = false;
+    _active = true;
+    if (0 == _chunks)
+    {
+        finish(0 == _expectedCrc ? BLE_BULK_OK : BLE_BULK_CRC_ERROR);
+        return;
+    }
+    // The client sends nothing before this first acknowledgement
+    sendAck();
+}
+
+void BLEBulkTransfer::finish(uint8_t status)
+{
+    _active = false;
+    _doneStatus = status;
+    _donePending = true;
+    if (NULL != _onEnd)
+    {
+        _onEnd(status, _received);
+    }
+}
+
+bool BLEBulkTransfer::sendAck()
+{
+    uint8_t ack[12];
+
+    uint32_t saved = interrupt_lock();
+    uint32_t block = _block;
+    uint64_t map = _map[block & 1] |
+                   ((uint64_t)_map[(block + 1) & 1] << BLE_BULK_BLOCK_CHUNKS_CFG);
+    _ackDue = false;
+    interrupt_unlock(saved);
+
+    uint16_t base = block * BLE_BULK_BLOCK_CHUNKS_CFG;
+    ack[0] = BLE_BULK_OP_ACK;
+    ack[1] = BLE_BULK_OK;
+    ack[2] = base & 0xFF;
+    ack[3] = base >> 8;
+    memcpy(ack + 4, &map, sizeof(map));
+
+    if (!_controlCharacteristic.notifyAsync(ack, sizeof(ack)))
+    {
+        _ackDue = true;
+        return false;
+    }
+    _lastAck = millis();
+    return true;
+}
+
+bool BLEBulkTransfer::sendDone()
+{
+    uint8_t done[10];
+
+    if (!_controlCharacteristic.subscribed())
+    {
+        // Nobody to tell
+        _donePending = false;
+        return false;
+    }
+    done[0] = BLE_BULK_OP_DONE;
+    done[1] = _doneStatus;
+    memcpy(done + 2, &_received, sizeof(uint32_t));
+    memcpy(done + 6, &_crc, sizeof(uint32_t));
+    if (!_controlCharacteristic.notifyAsync(done, sizeof(done)))
+    {
+        return false;
+    }
+    _donePending = false;
+    return true;
+}
+
+void BLEBulkTransfer::pollTask(void* arg)
+{
+    ((BLEBulkTransfer*)arg)->poll();
+}
+
+void BLEBulkTransfer::poll()
+{
+    // A data handler that yields must not come back in here
+    if (_busy)
+    {
+        return;
+    }
+    _busy = true;
+
+    uint8_t command = _command;
+    if (0 != command)
+    {
+        _command = 0;
+        if (BLE_BULK_OP_START == command)
+        {
+            start();
+        }
+        else if (_active)
+        {
+            finish(BLE_BULK_ABORTED);
+        }
+    }
+    if (_active && !_controlCharacteristic.subscribed())
+    {
+        finish(BLE_BULK_ABORTED);
+    }
+
+    // The oldest block goes to the handler while the IPC interrupt keeps
+    //  filling the other one
+    bool progress = false;
+    while (_active && blockFull(_block))
+    {
+        uint8_t slot = _block & 1;
+        uint32_t offset = _block * BLE_BULK_BLOCK_SIZE;
+        uint16_t length = (_length - offset < BLE_BULK_BLOCK_SIZE) ?
+                          _length - offset : BLE_BULK_BLOCK_SIZE;
+
+        if (!_onData(offset, _buffer[slot], length))
+        {
+            finish(BLE_BULK_SINK_ERROR);
+            break;
+        }
+        _crc = crc32(_crc, _buffer[slot], length);
+        _received = offset + length;
+
+        uint32_t saved = interrupt_lock();
+        _map[slot] = 0;
+        _block++;
+        interrupt_unlock(saved);
+
+        if (_received == _length)
+        {
+            finish(_crc == _expectedCrc ? BLE_BULK_OK : BLE_BULK_CRC_ERROR);
+            break;
+        }
+        progress = true;
+    }
+
+    if (_active)
+    {
+        unsigned long elapsed = millis() - _lastAck;
+        if (progress ||
+            (_ackDue && elapsed >= BLE_BULK_ACK_MS_CFG) ||
+            elapsed >= 10 * BLE_BULK_ACK_MS_CFG)
+        {
+            sendAck();
+        }
+    }
+    if (_donePending)
+    {
+        sendDone();
+    }
+
+    _busy = false;
+}
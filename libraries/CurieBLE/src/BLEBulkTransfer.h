@@ -0,0 +1,211 @@
+/*
+  BLE bulk download of large blobs from a GATT client
+  Copyright (c) 2017 Intel Corporation. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef ARDUINO_BLE_BULK_TRANSFER_H
+#define ARDUINO_BLE_BULK_TRANSFER_H
+
+#include "Task.h"
+#include "BLEService.h"
+#include "BLECharacteristic.h"
+
+#define BLE_BULK_SERVICE_UUID       "8e7f0001-6b1c-4c47-9f3b-2d1a5c0e9d10"
+#define BLE_BULK_DATA_UUID          "8e7f0002-6b1c-4c47-9f3b-2d1a5c0e9d10"
+#define BLE_BULK_CONTROL_UUID       "8e7f0003-6b1c-4c47-9f3b-2d1a5c0e9d10"
+
+// Data bytes in a chunk, after its sequence number
+#define BLE_BULK_CHUNK_DATA         (BLE_MAX_ATTR_DATA_LEN - 2)
+#define BLE_BULK_BLOCK_SIZE         (BLE_BULK_BLOCK_CHUNKS_CFG * BLE_BULK_CHUNK_DATA)
+#define BLE_BULK_WINDOW             (2 * BLE_BULK_BLOCK_CHUNKS_CFG)
+
+// Control characteristic: the client writes
+#define BLE_BULK_OP_START           0x01    // u32 length, u32 CRC-32
+#define BLE_BULK_OP_ABORT           0x02
+// and is notified
+#define BLE_BULK_OP_ACK             0x81    // u8 status, u16 base, u64 map
+#define BLE_BULK_OP_DONE            0x82    // u8 status, u32 length, u32 CRC-32
+
+// Status in the acknowledgements and for the end handler
+#define BLE_BULK_OK                 0
+#define BLE_BULK_REJECTED           1       // the start handler said no
+#define BLE_BULK_CRC_ERROR          2
+#define BLE_BULK_ABORTED            3       // by the client, or it went away
+#define BLE_BULK_SINK_ERROR         4       // the data handler failed
+
+// A transfer of length bytes is starting; false rejects it
+typedef bool (*BLEBulkStartHandler)(uint32_t length);
+// The next block of the blob, in order, of BLE_BULK_BLOCK_SIZE bytes
+// except the last; false aborts the transfer
+typedef bool (*BLEBulkDataHandler)(uint32_t offset, const uint8_t *data, uint16_t length);
+// The transfer is over, with one of the BLE_BULK_* status
+typedef void (*BLEBulkEndHandler)(uint8_t status, uint32_t length);
+
+// The attributes, built before the BLEBulkTransfer that refers to them
+class BLEBulkTransferAttributes
+{
+protected:
+    BLEBulkTransferAttributes();
+
+    BLEService _service;
+    BLECharacteristic _dataCharacteristic;
+    BLECharacteristic _controlCharacteristic;
+};
+
+/**
+ * A service that takes a blob from the GATT client as fast as the link
+ * goes, e.g. a firmware image or configuration for the onboard flash:
+ *
+ *      BLEBulkTransfer bulk;
+ *
+ *      BLE.begin();
+ *      bulk.setHandlers(started, received, ended);
+ *      bulk.begin();
+ *      BLE.setAdvertisedService(bulk.service());
+ *      BLE.advertise();
+ *
+ * The client subscribes to the control characteristic, writes START with
+ * the length and the CRC-32 of the blob, and waits for the first ACK.
+ * It then writes the blob to the data characteristic without response,
+ * BLE_BULK_CHUNK_DATA bytes a chunk behind a little endian 16-bit
+ * sequence number, the chunk index modulo 65536. Only the last chunk is
+ * short. Each ACK gives the index of the first chunk not yet taken and a
+ * little endian 64-bit map, bit i set for chunk base + i received. The
+ * client keeps the chunks of the window, base to base + BLE_BULK_WINDOW,
+ * in flight, and resends those an ACK shows missing below one it shows
+ * received. DONE closes the transfer with its status.
+ *
+ * Chunks are copied on arrival, in the IPC interrupt, into one of two
+ * block buffers. A block is handed to the data handler from a task once
+ * all of it is in, while the other block fills, so a data handler that
+ * programs flash overlaps the radio instead of holding it up. A chunk
+ * past both blocks, because the handler is slower than the link, is
+ * dropped and resent once an ACK shows it missing.
+ */
+class BLEBulkTransfer : private BLEBulkTransferAttributes
+{
+public:
+    BLEBulkTransfer();
+    virtual ~BLEBulkTransfer();
+
+    /**
+     * @brief   Set what is done with a transfer
+     *
+     * @param   start   Called as the client starts a transfer; NULL takes any
+     *
+     * @param   data    Gets the blob in blocks, from the task, so it may
+     *                  wait, e.g. for a flash program or erase
+     *
+     * @param   end     Called as the transfer finishes or fails; optional
+     *
+     * @return  none
+     */
+    void setHandlers(BLEBulkStartHandler start, BLEBulkDataHandler data,
+                     BLEBulkEndHandler end = NULL);
+
+    /**
+     * @brief   Add the service to the local GATT server
+     *
+     * @param   none
+     *
+     * @return  none
+     *
+     * @note  After BLE.begin(), before BLE.advertise()
+     */
+    void begin();
+    void end();
+
+    BLEService& service();
+
+    /**
+     * @brief   Hand complete blocks to the data handler and acknowledge
+     *
+     * @note  Runs every millisecond from yield() and the main loop; call
+     *        it directly to go faster where the sketch doesn't yield
+     */
+    void poll();
+
+    /**
+     * @brief   A transfer is running
+     */
+    bool active() const;
+
+    /**
+     * @brief   Bytes of the current or last transfer the data handler took
+     */
+    uint32_t received() const;
+
+    /**
+     * @brief   Chunks dropped for falling past the window, over all transfers
+     */
+    unsigned long dropped() const;
+
+private:
+    static void dataWritten(BLEDevice bledev,
+                            BLECharacteristic characteristic,
+                            const unsigned char data[],
+                            unsigned short length,
+                            unsigned short offset);
+    static void controlWritten(BLEDevice bledev,
+                               BLECharacteristic characteristic,
+                               const unsigned char data[],
+                               unsigned short length,
+                               unsigned short offset);
+    static void pollTask(void* arg);
+    void receive(const unsigned char data[], unsigned short length);
+    void start();
+    void finish(uint8_t status);
+    bool blockFull(uint32_t block);
+    bool sendAck();
+    bool sendDone();
+
+    BLEBulkTransfer* _next;
+    static BLEBulkTransfer* _transfers;
+
+    BLEBulkStartHandler _onStart;
+    BLEBulkDataHandler _onData;
+    BLEBulkEndHandler _onEnd;
+
+    // Set by the control write handler, taken by poll()
+    volatile uint8_t _command;
+    uint32_t _commandLength;
+    uint32_t _commandCrc;
+
+    volatile bool _active;
+    uint32_t _length;
+    uint32_t _chunks;
+    uint32_t _expectedCrc;
+    uint32_t _crc;
+    // Oldest block being assembled; the window starts at its first chunk
+    volatile uint32_t _block;
+    // Chunks received into each block buffer, bit i for chunk i of it
+    volatile uint32_t _map[2];
+    uint8_t _buffer[2][BLE_BULK_BLOCK_SIZE];
+    // One past the highest chunk received, to tell a gap
+    volatile uint32_t _expect;
+    uint32_t _received;
+    volatile bool _ackDue;
+    volatile unsigned long _dropped;
+
+    unsigned long _lastAck;
+    uint8_t _doneStatus;
+    bool _donePending;
+    bool _busy;
+    Task _task;
+};
+
+#endif
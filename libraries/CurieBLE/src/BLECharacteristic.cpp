@@ -37,6 +37,12 @@ BLECharacteristic::BLECharacteristic():
     memset(_uuid_cstr, 0, sizeof(_uuid_cstr));
     memset(_event_handlers, 0, sizeof(_event_handlers));
     memset(_oldevent_handlers, 0, sizeof(_oldevent_handlers));
+    _write_stream_handler = NULL;
+    _read_stream_handler = NULL;
+    _notify_coalesce = false;
+    _notify_latest = false;
+    _const_value = NULL;
+    _user_value = NULL;
 }
 
 BLECharacteristic::BLECharacteristic(const char* uuid, 
@@ -54,6 +60,12 @@ BLECharacteristic::BLECharacteristic(const char* uuid,
     _bledev.setAddress(*BLEUtils::bleGetLoalAddress());
     memset(_event_handlers, 0, sizeof(_event_handlers));
     memset(_oldevent_handlers, 0, sizeof(_oldevent_handlers));
+    _write_stream_handler = NULL;
+    _read_stream_handler = NULL;
+    _notify_coalesce = false;
+    _notify_latest = false;
+    _const_value = NULL;
+    _user_value = NULL;
 }
 
 BLECharacteristic::BLECharacteristic(const char* uuid, 
@@ -74,6 +86,12 @@ BLECharacteristic::BLECharacteristic(BLECharacteristicImp *characteristicImp,
     _value_size = characteristicImp->valueSize();
     memset(_event_handlers, 0, sizeof(_event_handlers));
     memset(_oldevent_handlers, 0, sizeof(_oldevent_handlers));
+    _write_stream_handler = NULL;
+    _read_stream_handler = NULL;
+    _notify_coalesce = false;
+    _notify_latest = false;
+    _const_value = NULL;
+    _user_value = NULL;
 }
 
 BLECharacteristic::BLECharacteristic(const BLECharacteristic& rhs):
@@ -82,6 +100,12 @@ BLECharacteristic::BLECharacteristic(const BLECharacteristic& rhs):
 {
     _chrc_local_imp = NULL; // Not copy
     _value_size = rhs._value_size;
+    _write_stream_handler = rhs._write_stream_handler;
+    _read_stream_handler = rhs._read_stream_handler;
+    _notify_coalesce = rhs._notify_coalesce;
+    _notify_latest = rhs._notify_latest;
+    _const_value = rhs._const_value;
+    _user_value = rhs._user_value;
     _internal = rhs._internal;
     _bledev.setAddress(*rhs._bledev.bt_le_address());
     memcpy(_uuid_cstr, rhs._uuid_cstr, sizeof(_uuid_cstr));
@@ -192,6 +216,12 @@ BLECharacteristic& BLECharacteristic::operator= (const BLECharacteristic& chrc)
         _internal = chrc._internal;
         _chrc_local_imp = NULL; // Not copy
         _properties = chrc._properties;
+        _write_stream_handler = chrc._write_stream_handler;
+        _read_stream_handler = chrc._read_stream_handler;
+        _notify_coalesce = chrc._notify_coalesce;
+        _notify_latest = chrc._notify_latest;
+        _const_value = chrc._const_value;
+        _user_value = chrc._user_value;
         
         if (_value_size < chrc._value_size)
         {
@@ -277,11 +307,9 @@ bool BLECharacteristic::writeValue(const byte value[], int length, int offset)
         if (true == _broadcast && 
             true == BLEDeviceManager::instance()->advertising())
         {
-            BLEDeviceManager::instance()->stopAdvertising();
-            BLEDeviceManager::instance()->setAdvertisedServiceData(characteristicImp->bt_uuid(),
-                                                                   characteristicImp->value(), 
-                                                                   characteristicImp->valueLength());
-            BLEDeviceManager::instance()->startAdvertising();
+            BLEDeviceManager::instance()->updateAdvertisedServiceData(characteristicImp->bt_uuid(),
+                                                                      characteristicImp->value(), 
+                                                                      characteristicImp->valueLength());
         }
     } else {
         // not associated with a service yet
@@ -296,6 +324,46 @@ bool BLECharacteristic::writeValue(const char* value)
     return writeValue((const byte*)value, strlen(value));
 }
 
+bool BLECharacteristic::notifyAsync(const byte value[], int length)
+{
+    bool retVar = false;
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp &&
+        BLEUtils::isLocalBLE(_bledev) == true)
+    {
+        retVar = characteristicImp->notifyAsync(value, length);
+    }
+    return retVar;
+}
+
+bool BLECharacteristic::canNotifyNow()
+{
+    bool retVar = false;
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp)
+    {
+        retVar = characteristicImp->canNotifyNow();
+    }
+    return retVar;
+}
+
+void BLECharacteristic::setNotifyCoalescing(bool enable, bool latestOnly)
+{
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp)
+    {
+        characteristicImp->setNotifyCoalescing(enable, latestOnly);
+    }
+    else
+    {
+        _notify_coalesce = enable;
+        _notify_latest = latestOnly;
+    }
+}
+
 bool BLECharacteristic::broadcast()
 {
     _broadcast = true;
@@ -388,6 +456,18 @@ bool BLECharacteristic::read(bool blocked)
     return retVar;
 }
 
+bool BLECharacteristic::readAsync(BLECharacteristicReadCompleteHandler callback)
+{
+    bool retVar = false;
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp)
+    {
+        retVar = characteristicImp->readAsync(callback);
+    }
+    return retVar;
+}
+
 bool BLECharacteristic::write(const unsigned char* value, int length)
 {
     bool retVar = false;
@@ -400,6 +480,29 @@ bool BLECharacteristic::write(const unsigned char* value, int length)
     return retVar;
 }
 
+bool BLECharacteristic::writeAsync(const unsigned char* value, int length,
+                                   BLECharacteristicWriteCompleteHandler callback)
+{
+    bool retVar = false;
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp)
+    {
+        retVar = characteristicImp->writeAsync(value, (uint16_t)length, callback);
+    }
+    return retVar;
+}
+
+void BLECharacteristic::setWriteCoalescing(bool enable)
+{
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp)
+    {
+        characteristicImp->setWriteCoalescing(enable);
+    }
+}
+
 bool BLECharacteristic::subscribe()
 {
     bool retVar = false;
@@ -480,6 +583,7 @@ int BLECharacteristic::descriptorCount() const
     
     if (NULL != characteristicImp)
     {
+        characteristicImp->resolveDescriptors();
         count = characteristicImp->descriptorCount();
     }
     return count;
@@ -492,6 +596,7 @@ bool BLECharacteristic::hasDescriptor(const char* uuid) const
     
     if (NULL != characteristicImp)
     {
+        characteristicImp->resolveDescriptors();
         descriptorImp = characteristicImp->descrptor(uuid);
     }
     
@@ -506,6 +611,7 @@ bool BLECharacteristic::hasDescriptor(const char* uuid, int index) const
     
     if (NULL != characteristicImp)
     {
+        characteristicImp->resolveDescriptors();
         descriptorImp = characteristicImp->descrptor(index);
         if (NULL != descriptorImp)
         {
@@ -523,6 +629,7 @@ BLEDescriptor BLECharacteristic::descriptor(int index) const
     
     if (NULL != characteristicImp)
     {
+        characteristicImp->resolveDescriptors();
         descriptorImp = characteristicImp->descrptor(index);
     }
     
@@ -542,6 +649,7 @@ BLEDescriptor BLECharacteristic::descriptor(const char * uuid) const
     
     if (NULL != characteristicImp)
     {
+        characteristicImp->resolveDescriptors();
         descriptorImp = characteristicImp->descrptor(uuid);
     }
     
@@ -563,6 +671,7 @@ BLEDescriptor BLECharacteristic::descriptor(const char * uuid, int index) const
     
     if (NULL != characteristicImp)
     {
+        characteristicImp->resolveDescriptors();
         descriptorImp = characteristicImp->descrptor(index);
         if (NULL != descriptorImp)
         {
@@ -580,6 +689,70 @@ BLEDescriptor BLECharacteristic::descriptor(const char * uuid, int index) const
     }
 }
 
+bool BLECharacteristic::setConstantValue(const unsigned char value[], unsigned short length)
+{
+    if (NULL != _internal || NULL != _chrc_local_imp ||
+        (_properties & (BLEWrite | BLEWriteWithoutResponse | BLENotify | BLEIndicate)) ||
+        length > BLE_MAX_ATTR_LONGDATA_LEN)
+    {
+        return false;
+    }
+    if (NULL != _value)
+    {
+        free(_value);
+        _value = NULL;
+    }
+    _const_value = value;
+    _value_size = length;
+    return true;
+}
+
+bool BLECharacteristic::setValueStorage(unsigned char value[], unsigned short size)
+{
+    if (NULL != _internal || NULL != _chrc_local_imp ||
+        NULL != _const_value || NULL == value || 0 == size ||
+        size > BLE_MAX_ATTR_LONGDATA_LEN)
+    {
+        return false;
+    }
+    if (NULL != _value)
+    {
+        free(_value);
+        _value = NULL;
+    }
+    _user_value = value;
+    _value_size = size;
+    return true;
+}
+
+bool BLECharacteristic::notifyValue()
+{
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL == characteristicImp ||
+        BLEUtils::isLocalBLE(_bledev) == false)
+    {
+        return false;
+    }
+    return characteristicImp->notifyValue();
+}
+
+void BLECharacteristic::setStreamHandlers(BLECharacteristicWriteStreamHandler writeHandler,
+                                          BLECharacteristicReadStreamHandler readHandler)
+{
+    BLECharacteristicImp *characteristicImp = getImplementation();
+    
+    if (NULL != characteristicImp)
+    {
+        characteristicImp->setStreamHandlers(writeHandler, readHandler);
+    }
+    else
+    {
+        _write_stream_handler = writeHandler;
+        _read_stream_handler = readHandler;
+    }
+}
+
 void BLECharacteristic::setEventHandler(BLECharacteristicEvent event, 
                                         BLECharacteristicEventHandler eventHandler)
 {
@@ -626,6 +799,14 @@ BLECharacteristic::_setValue(const uint8_t value[], uint16_t length)
         length = _value_size;
     }
     
+    if (NULL != _user_value)
+    {
+        if (value != _user_value)
+        {
+            memcpy(_user_value, value, length);
+        }
+        return;
+    }
     if (NULL == _value)
     {
         // Allocate the buffer for characteristic
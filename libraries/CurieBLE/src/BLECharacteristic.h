@@ -45,6 +45,30 @@ typedef void (*BLECharacteristicEventHandler)(BLEDevice bledev, BLECharacteristi
 
 typedef void (*BLECharacteristicEventHandlerOld)(BLECentral &central, BLECharacteristic &characteristic);
 
+// Streaming handlers, see BLECharacteristic::setStreamHandlers()
+typedef void (*BLECharacteristicWriteStreamHandler)(BLEDevice bledev, 
+                                                    BLECharacteristic characteristic,
+                                                    const unsigned char data[],
+                                                    unsigned short length,
+                                                    unsigned short offset);
+typedef int (*BLECharacteristicReadStreamHandler)(BLEDevice bledev, 
+                                                  BLECharacteristic characteristic,
+                                                  unsigned char buffer[],
+                                                  unsigned short length,
+                                                  unsigned short offset);
+
+// Completion of BLECharacteristic::readAsync(); err is 0 on success, with
+// the value read in the characteristic, or the ATT error from the peer
+typedef void (*BLECharacteristicReadCompleteHandler)(BLEDevice bledev, 
+                                                     BLECharacteristic characteristic,
+                                                     int err);
+
+// Completion of BLECharacteristic::writeAsync(); err is 0 on success, the
+// ATT error from the peer, or negative if the write was not sent
+typedef void (*BLECharacteristicWriteCompleteHandler)(BLEDevice bledev, 
+                                                      BLECharacteristic characteristic,
+                                                      int err);
+
 //#include "BLECharacteristicImp.h"
 
 class BLECharacteristic: public BLEAttributeWithValue
@@ -228,6 +252,51 @@ public:
      */
     bool writeValue(const char* value);
 
+    /**
+     * @brief   Queue a notification of the value to the subscribed central
+     *
+     * @param   value   The value buffer that want to write to characteristic
+     *
+     * @param   length  The value buffer's length
+     *
+     * @return  bool    true - Queued, false - Not subscribed or queue full
+     *
+     * @note  GATT server only. Unlike writeValue() it never overruns the
+     *        nRF core's buffers: values wait in a short queue and go out as
+     *        the earlier notifications are confirmed. Retry on false.
+     */
+    bool notifyAsync(const byte value[], int length);
+    
+    /**
+     * @brief   Would notifyAsync() send the value without queueing it
+     *
+     * @param   none
+     *
+     * @return  true - Yes, false - No
+     *
+     * @note  GATT server only
+     */
+    bool canNotifyNow();
+    
+    /**
+     * @brief   Coalesce writeValue() notifications with the other queued ones
+     *
+     * @param   enable      true - writeValue() notifies through the
+     *                      notifyAsync() queue, so updates to several
+     *                      characteristics go out together as the nRF core
+     *                      frees buffers; it sends at once if the queue is
+     *                      full
+     *
+     * @param   latestOnly  true - a new value replaces this characteristic's
+     *                      value still waiting in the queue, dropping
+     *                      superseded updates. Applies to notifyAsync() too
+     *
+     * @return  none
+     *
+     * @note  GATT server only
+     */
+    void setNotifyCoalescing(bool enable, bool latestOnly = false);
+
     // peripheral mode
     bool broadcast(); // broadcast the characteristic value in the advertisement data
     
@@ -333,6 +402,19 @@ public:
      */
     virtual bool read(bool blocked = true);
     
+    /**
+     * @brief   Read the characteristic value without waiting
+     *
+     * @param[in]   callback    Called when the response is in, may be NULL
+     *
+     * @return  bool    true - Request sent, false - Failed or a read
+     *                  is already pending
+     *
+     * @note  Only for GATT client. The callback runs from the BLE
+     *        interrupt, after the BLEValueUpdated event; keep it short
+     */
+    bool readAsync(BLECharacteristicReadCompleteHandler callback);
+    
     /**
      * @brief   Write the charcteristic value
      *
@@ -343,9 +425,44 @@ public:
      * @return  bool    true - Success, false - Failed
      *
      * @note  Only for GATT client. Schedule write request to the GATT server
+     *        and, for a write request, wait for the response
      */
     virtual bool write(const unsigned char* value, int length);
     
+    /**
+     * @brief   Queue a write of the characteristic value without waiting
+     *
+     * @param   value   The value buffer, copied. At most
+     *                  BLE_MAX_ATTR_DATA_LEN bytes
+     *
+     * @param   length  The value buffer's length
+     *
+     * @param   callback    Called when the write completes, may be NULL
+     *
+     * @return  bool    true - Queued, false - Not connected, too long or
+     *                  the queue is full
+     *
+     * @note  Only for GATT client. Writes to a peripheral go out in order:
+     *        write requests one at a time, write commands as long as
+     *        fewer than BLE_MAX_WRITE_IN_FLIGHT_CFG writes are with the nRF
+     *        core. The callback runs from the BLE interrupt; keep it short
+     */
+    bool writeAsync(const unsigned char* value, int length,
+                    BLECharacteristicWriteCompleteHandler callback = NULL);
+    
+    /**
+     * @brief   Coalesce queued writeAsync() values
+     *
+     * @param   enable  true - a new value replaces this characteristic's
+     *                  value still waiting in the queue, and its callback
+     *                  the superseded one, which is not called
+     *
+     * @return  none
+     *
+     * @note  Only for GATT client
+     */
+    void setWriteCoalescing(bool enable);
+    
     /**
      * @brief   Subscribe to the characteristic
      *
@@ -477,6 +594,72 @@ public:
     void setEventHandler(BLECharacteristicEvent event, 
                          BLECharacteristicEventHandlerOld eventHandler);
     
+    /**
+     * @brief   Stream the value through handlers instead of keeping a copy
+     *
+     * @param   writeHandler    Gets each chunk the GATT client writes, in place,
+     *                          with its offset in the value. A NULL data with
+     *                          length 0 says the client cancelled the chunks
+     *                          sent since the last BLEWritten event, which
+     *                          marks a completed write.
+     *
+     * @param   readHandler     Fills buffer with up to length bytes of the
+     *                          value from offset, returning the count;
+     *                          NULL serves reads from writeValue()'s copy
+     *
+     * @return  none
+     *
+     * @note  GATT server only. Call before the characteristic is added to a
+     *        service: a long characteristic then has no staging buffer for
+     *        prepared writes, and with both handlers no value copy at all,
+     *        so value() is NULL.
+     */
+    void setStreamHandlers(BLECharacteristicWriteStreamHandler writeHandler,
+                           BLECharacteristicReadStreamHandler readHandler = NULL);
+    
+    /**
+     * @brief   Serve a fixed value from the sketch's memory, without a copy
+     *
+     * @param   value   The value; a static const array stays in flash
+     *
+     * @param   length  The value length, which becomes the value size
+     *
+     * @return  bool    true - Set, false - Already added, too long or not
+     *                  read only (needs BLERead alone)
+     *
+     * @note  GATT server only. Call before the characteristic is added to a
+     *        service; writeValue() fails from then on.
+     */
+    bool setConstantValue(const unsigned char value[], unsigned short length);
+    
+    /**
+     * @brief   Keep the value in the sketch's memory instead of a copy
+     *
+     * @param   value   The storage, which must stay valid. Reads are served
+     *                  from it and the GATT client's writes land in it
+     *
+     * @param   size    The storage size, which becomes the value size
+     *
+     * @return  bool    true - Set, false - Already added, constant or too long
+     *
+     * @note  GATT server only. Call before the characteristic is added to a
+     *        service. Change the storage in place, then notifyValue().
+     */
+    bool setValueStorage(unsigned char value[], unsigned short size);
+    
+    /**
+     * @brief   Notify the current value to the subscribed central, as
+     *           writeValue() does but without copying it first
+     *
+     * @param   none
+     *
+     * @return  bool    true - Success, false - Failed
+     *
+     * @note  GATT server only. For storage from setValueStorage() that was
+     *        changed in place.
+     */
+    bool notifyValue();
+    
 protected:
     friend class BLEDevice;
     friend class BLEService;
@@ -541,7 +724,16 @@ protected:
     BLECharacteristicEventHandler _event_handlers[BLECharacteristicEventLast];  // Sid. Define the arr as in BLECharacteristicImp.h
     
     BLECharacteristicEventHandlerOld _oldevent_handlers[BLECharacteristicEventLast];
+    BLECharacteristicWriteStreamHandler _write_stream_handler;
+    BLECharacteristicReadStreamHandler _read_stream_handler;
+    bool _notify_coalesce;
+    bool _notify_latest;
+    const unsigned char* _const_value;
+    unsigned char* _user_value;     // From setValueStorage()
 };
 
+#define ARDUINO_BLE_CHARACTERISTIC_DEFINED
+#include "CurieBLE.h"  // Headers holding this class by value, see there
+
 #endif
 
@@ -41,11 +41,18 @@
 #define UUID_SIZE_16    2
 #define MAX_UUID_SIZE   UUID_SIZE_128
 
+/* The ATT MTU of every link. The nRF core firmware has no RPC to exchange
+ * a larger MTU or to enable data length extension, so links keep the
+ * default of the core specification.
+ */
+#define BLE_ATT_MTU_DEFAULT         23
+
 /* Theoretically we should be able to support attribute lengths up to 512 bytes
  * but this involves splitting it across multiple packets.  For simplicity,
- * we will just limit this to 20 bytes for now, which will fit in a single packet
+ * we will just limit this to what fits in a single packet: the MTU less the
+ * 3 byte ATT header
  */
-#define BLE_MAX_ATTR_DATA_LEN       20
+#define BLE_MAX_ATTR_DATA_LEN       (BLE_ATT_MTU_DEFAULT - 3)
 #define BLE_MAX_ATTR_LONGDATA_LEN   512
 
 /* Default device name prefix, applied only if user does not provide a name
@@ -101,9 +108,92 @@ typedef ble_status_t BleStatus;
 
 #define BLE_LIB_ASSERT(cond) ((cond) ? (void)0 : __assert_fail())
 
+// Peer connections the library keeps a profile for, counted separately
+// from the central this device may be connected to as a peripheral. The
+// BLE stack's connection table is CONFIG_BLUETOOTH_MAX_CONN, set from
+// BLE_MAX_CONN in the libarc32 Makefile; raising this means rebuilding
+// libarc32drv_arduino101.a to match, and an nRF firmware that accepts as
+// many links
+#ifndef BLE_MAX_CONN_CFG
 #define BLE_MAX_CONN_CFG            2
+#endif
+#if BLE_MAX_CONN_CFG < 1 || BLE_MAX_CONN_CFG > 8
+#error "CurieBLE: 1 to 8 connections, one bit each in a uint8_t"
+#endif
+#if defined(CONFIG_BLUETOOTH_MAX_CONN) && BLE_MAX_CONN_CFG > CONFIG_BLUETOOTH_MAX_CONN
+#error "CurieBLE: BLE_MAX_CONN_CFG is larger than the BLE stack's table"
+#endif
+// Scan results held for available(), about 120 bytes each, and the
+// addresses remembered for scan() without duplicates, 11 bytes each, a
+// power of 2. Raise both, e.g. with -D in the build flags, when scanning
+// among many advertisers
+#ifndef BLE_MAX_ADV_BUFFER_CFG
 #define BLE_MAX_ADV_BUFFER_CFG      3
-#define BLE_MAX_ADV_FILTER_SIZE_CFG 20
+#endif
+#ifndef BLE_MAX_ADV_FILTER_SIZE_CFG
+#define BLE_MAX_ADV_FILTER_SIZE_CFG 64
+#endif
+#if BLE_MAX_ADV_BUFFER_CFG < 2 || BLE_MAX_ADV_BUFFER_CFG > 254
+#error "CurieBLE: 2 to 254 scan results, indexed by uint8_t"
+#endif
+#if BLE_MAX_ADV_FILTER_SIZE_CFG < 8 || BLE_MAX_ADV_FILTER_SIZE_CFG > 128 || \
+    (BLE_MAX_ADV_FILTER_SIZE_CFG & (BLE_MAX_ADV_FILTER_SIZE_CFG - 1))
+#error "CurieBLE: the duplicate filter size is a power of 2, 8 to 128"
+#endif
+// A reported address older than this is forgotten by the duplicate
+// filter and the device is reported again; 0 keeps it for the whole scan
+// unless the filter is full
+#ifndef BLE_ADV_FILTER_AGE_MS
+#define BLE_ADV_FILTER_AGE_MS       0
+#endif
+// A scan result not taken by available() within this time is dropped
+#define BLE_ADV_EXPIRE_MS           2000
+// Notifications handed to the nRF core and not yet confirmed, over all
+// characteristics, and notifyAsync() values held per characteristic
+#define BLE_MAX_NOTIFY_IN_FLIGHT_CFG    4
+#define BLE_NOTIFY_QUEUE_DEPTH_CFG      4
+// GATT client writes queued, over all peripherals, and writes handed to
+// the nRF core and not yet confirmed
+#define BLE_WRITE_QUEUE_DEPTH_CFG       8
+#define BLE_MAX_WRITE_IN_FLIGHT_CFG     4
+// Peers whose discovered profile is kept for the next connection, and
+// the bytes kept per peer (about 9 per attribute with a 16-bit UUID,
+// 23 with a 128-bit one); 0 peers turns the cache off
+#ifndef BLE_DISCOVERY_CACHE_CFG
+#define BLE_DISCOVERY_CACHE_CFG         2
+#endif
+#ifndef BLE_DISCOVERY_CACHE_SIZE_CFG
+#define BLE_DISCOVERY_CACHE_SIZE_CFG    512
+#endif
+// 1 - Long characteristics share one staging buffer for prepared writes,
+// instead of one each. A prepared write to a second characteristic before
+// the first is executed is then dropped
+#ifndef BLE_COMPACT_PROFILE_CFG
+#define BLE_COMPACT_PROFILE_CFG         0
+#endif
+// Bytes a BLEStream holds between the client's writes and read(); one
+// less is usable
+#ifndef BLE_STREAM_RX_BUFFER_CFG
+#define BLE_STREAM_RX_BUFFER_CFG        128
+#endif
+// BLESerial sends a part filled notification this long after its first
+// byte was written, about one connection interval
+#ifndef BLE_SERIAL_FLUSH_MS_CFG
+#define BLE_SERIAL_FLUSH_MS_CFG         10
+#endif
+// Chunks in each of the two blocks a BLEBulkTransfer assembles, so the
+// receive window is twice this
+#ifndef BLE_BULK_BLOCK_CHUNKS_CFG
+#define BLE_BULK_BLOCK_CHUNKS_CFG       28
+#endif
+#if BLE_BULK_BLOCK_CHUNKS_CFG < 1 || BLE_BULK_BLOCK_CHUNKS_CFG > 32
+#error "CurieBLE: BLE_BULK_BLOCK_CHUNKS_CFG must be 1 to 32"
+#endif
+// Shortest gap between the acknowledgements that out of order or dropped
+// chunks prompt, and the keepalive acknowledgement at ten times it
+#ifndef BLE_BULK_ACK_MS_CFG
+#define BLE_BULK_ACK_MS_CFG             20
+#endif
 
 typedef bool (*ble_advertise_handle_cb_t)(uint8_t type, const uint8_t *dataPtr,
                                           uint8_t data_len, const bt_addr_le_t *addrPtr);
@@ -103,6 +103,16 @@ bool BLEDevice::connected() const
     return link_exist;
 }
 
+uint16_t BLEDevice::mtu() const
+{
+    uint16_t mtu = 0;
+    if (BLEDeviceManager::instance()->connected(this))
+    {
+        mtu = BLE_ATT_MTU_DEFAULT;
+    }
+    return mtu;
+}
+
 bool BLEDevice::disconnect()
 {
     bool retval = BLEDeviceManager::instance()->disconnect(this);
@@ -141,6 +151,12 @@ void BLEDevice::setManufacturerData(const unsigned char manufacturerData[],
     BLEDeviceManager::instance()->setManufacturerData(manufacturerData, manufacturerDataLength);
 }
 
+int BLEDevice::updateManufacturerData(const unsigned char manufacturerData[],
+                                      unsigned char manufacturerDataLength)
+{
+    return BLEDeviceManager::instance()->updateManufacturerData(manufacturerData, manufacturerDataLength);
+}
+
 bool BLEDevice::getManufacturerData (unsigned char* manu_data, 
                                      unsigned char& manu_data_len) const
 {
@@ -188,6 +204,24 @@ void BLEDevice::setConnectionInterval(int minimumConnectionInterval,
     BLEDeviceManager::instance()->setConnectionInterval(this);
 }
 
+bool BLEDevice::setConnectionProfile(BLEConnectionProfile profile)
+{
+    // Intervals in 1.25 ms units, timeouts in 10 ms units. Each timeout is
+    // well over the (1 + latency) * interval_max * 2 the spec requires.
+    static const bt_le_conn_param_t profiles[BLEConnectionLastProfile] = {
+        { 6, 12, 0, 200 },      // Throughput: 7.5 - 15 ms, 2 s
+        { 24, 40, 0, 400 },     // Balanced: 30 - 50 ms, 4 s
+        { 200, 400, 4, 600 },   // LowPower: 250 - 500 ms, 6 s
+    };
+    
+    if (profile >= BLEConnectionLastProfile)
+    {
+        return false;
+    }
+    memcpy(&_conn_param, &profiles[profile], sizeof (_conn_param));
+    return (BLEDeviceManager::instance()->setConnectionInterval(this) == 0);
+}
+
 int BLEDevice::getConnectionInterval()
 {
     bt_le_conn_param_t conn_param;
@@ -242,6 +276,11 @@ int BLEDevice::addService(BLEService& attribute)
     return BLE_STATUS_SUCCESS;
 }
 
+int BLEDevice::addAttributeTable(const bt_gatt_attr_t* attrs, int count)
+{
+    return BLEProfileManager::instance()->addAttributeTable(*this, attrs, count);
+}
+
 int BLEDevice::advertise()
 {
     preCheckProfile();
@@ -308,6 +347,14 @@ void BLEDevice::scan(bool withDuplicates)
     startScan(withDuplicates);
 }
 
+bool BLEDevice::setScanParameters(float interval, float window, bool active)
+{
+    return BLEDeviceManager::instance()->setScanParameters(
+        (uint16_t)MSEC_TO_UNITS(interval, UNIT_0_625_MS),
+        (uint16_t)MSEC_TO_UNITS(window, UNIT_0_625_MS),
+        active ? BT_HCI_LE_SCAN_ACTIVE : BT_HCI_LE_SCAN_PASSIVE);
+}
+
 void BLEDevice::scanForName(String name, bool withDuplicates)
 {
     BLEDeviceManager::instance()->setAdvertiseCritical(name);
@@ -327,6 +374,26 @@ void BLEDevice::scanForAddress(String macaddr, bool withDuplicates)
     startScan(withDuplicates);
 }
 
+void BLEDevice::setScanFilterRssi(int rssi)
+{
+    BLEDeviceManager::instance()->setScanFilterRssi(constrain(rssi, -127, 127));
+}
+
+void BLEDevice::setScanFilterNamePrefix(String prefix)
+{
+    BLEDeviceManager::instance()->setScanFilterNamePrefix(prefix);
+}
+
+void BLEDevice::setScanFilterManufacturer(unsigned short companyId)
+{
+    BLEDeviceManager::instance()->setScanFilterManufacturer(companyId);
+}
+
+void BLEDevice::clearScanFilters()
+{
+    BLEDeviceManager::instance()->clearScanFilters();
+}
+
 void BLEDevice::stopScan()
 {
     BLEDeviceManager::instance()->stopScanning();
@@ -373,11 +440,50 @@ String BLEDevice::advertisedServiceUuid(int index) const
     return BLEDeviceManager::instance()->advertisedServiceUuid(this, index);
 }
 
+int BLEDevice::localName(char *buffer, int size) const
+{
+    return BLEDeviceManager::instance()->localName(this, buffer, size);
+}
+
+int BLEDevice::advertisedServiceUuid(char *buffer, int size, int index) const
+{
+    return BLEDeviceManager::instance()->advertisedServiceUuid(this, index, buffer, size);
+}
+
 int BLEDevice::rssi() const
 {
     return BLEDeviceManager::instance()->rssi(this);
 }
 
+int BLEDevice::advertisementData(const unsigned char* &data) const
+{
+    return BLEDeviceManager::instance()->advertisementData(this, data);
+}
+
+int BLEDevice::scanResponseData(const unsigned char* &data) const
+{
+    return BLEDeviceManager::instance()->scanResponseData(this, data);
+}
+
+void BLEDevice::setScanReportHandler(BLEScanReportHandler handler)
+{
+    BLEDeviceManager::instance()->setScanReportHandler(handler);
+}
+
+int BLEDevice::advertisementField(const unsigned char* data,
+                                  int length,
+                                  unsigned char type,
+                                  const unsigned char* &field)
+{
+    uint8_t field_len = 0;
+    if (length <= 0 || length > 255 ||
+        false == BLEDeviceManager::findAdvertiseField(data, length, type, field, field_len))
+    {
+        return -1;
+    }
+    return field_len;
+}
+
 bool BLEDevice::connect()
 {
     return BLEDeviceManager::instance()->connect(*this);
@@ -395,6 +501,37 @@ bool BLEDevice::discoverAttributesByService(const char* svc_uuid)
     return BLEProfileManager::instance()->discoverAttributesByService(this, (const bt_uuid_t *)&uuid);
 }
 
+bool BLEDevice::discoverAttributesByService(const char* svc_uuid, const char* chrc_uuid)
+{
+    bt_uuid_128_t uuid;
+    bt_uuid_128_t chrc;
+    BLEUtils::uuidString2BT(svc_uuid, (bt_uuid_t *)&uuid);
+    BLEUtils::uuidString2BT(chrc_uuid, (bt_uuid_t *)&chrc);
+    return BLEProfileManager::instance()->discoverAttributesByService(this, 
+                                                                      (const bt_uuid_t *)&uuid,
+                                                                      (const bt_uuid_t *)&chrc);
+}
+
+void BLEDevice::setLazyDiscovery(bool lazy)
+{
+    BLEProfileManager::instance()->setLazyDiscovery(lazy);
+}
+
+int BLEDevice::discoveryCache(unsigned char* buffer, int size) const
+{
+    return BLEProfileManager::instance()->discoveryCache(*this, buffer, size);
+}
+
+bool BLEDevice::setDiscoveryCache(const unsigned char* buffer, int length)
+{
+    return BLEProfileManager::instance()->setDiscoveryCache(*this, buffer, length);
+}
+
+void BLEDevice::clearDiscoveryCache()
+{
+    BLEProfileManager::instance()->clearDiscoveryCache(*this);
+}
+
 
 String BLEDevice::deviceName()
 {
@@ -413,6 +550,12 @@ bool BLEDevice::hasService(const char* uuid) const
     return (NULL != serviceImp);
 }
 
+bool BLEDevice::hasService(const BLEUuid& uuid) const
+{
+    BLEServiceImp* serviceImp = BLEProfileManager::instance()->service(*this, uuid.bt_uuid());
+    return (NULL != serviceImp);
+}
+
 bool BLEDevice::hasService(const char* uuid, int index) const
 {
     BLEServiceImp* serviceImp = BLEProfileManager::instance()->service(*this, index);
@@ -443,6 +586,18 @@ BLEService BLEDevice::service(const char * uuid) const
     return temp;
 }
 
+BLEService BLEDevice::service(const BLEUuid& uuid) const
+{
+    BLEServiceImp* serviceImp = BLEProfileManager::instance()->service(*this, uuid.bt_uuid());
+    if (serviceImp != NULL)
+    {
+        BLEService temp(serviceImp, this);
+        return temp;
+    }
+    BLEService temp;
+    return temp;
+}
+
 BLEService BLEDevice::service(const char * uuid, int index) const
 {
     BLEServiceImp* serviceImp = BLEProfileManager::instance()->service(*this, index);
@@ -466,6 +621,12 @@ bool BLEDevice::hasCharacteristic(const char* uuid) const
     return (NULL != characteristicImp);
 }
 
+bool BLEDevice::hasCharacteristic(const BLEUuid& uuid) const
+{
+    BLECharacteristicImp* characteristicImp = BLEProfileManager::instance()->characteristic(*this, uuid.bt_uuid());
+    return (NULL != characteristicImp);
+}
+
 bool BLEDevice::hasCharacteristic(const char* uuid, int index) const
 {
     BLECharacteristicImp* characteristicImp = BLEProfileManager::instance()->characteristic(*this, uuid, index);
@@ -498,6 +659,19 @@ BLECharacteristic BLEDevice::characteristic(const char * uuid) const
     return temp;
 }
 
+BLECharacteristic BLEDevice::characteristic(const BLEUuid& uuid) const
+{
+    BLECharacteristicImp* characteristicImp = BLEProfileManager::instance()->characteristic(*this, uuid.bt_uuid());
+    
+    if (NULL == characteristicImp)
+    {
+        BLECharacteristic temp;
+        return temp;
+    }
+    BLECharacteristic temp(characteristicImp, this);
+    return temp;
+}
+
 BLECharacteristic BLEDevice::characteristic(const char * uuid, int index) const
 {
     BLECharacteristicImp* characteristicImp = BLEProfileManager::instance()->characteristic(*this, index);
@@ -535,7 +709,8 @@ const bt_le_conn_param* BLEDevice::bt_conn_param() const
 void BLEDevice::preCheckProfile()
 {
     if (false == BLEProfileManager::instance()->hasRegisterProfile() &&
-        BLEProfileManager::instance()->serviceCount(*this) > 0)
+        (BLEProfileManager::instance()->serviceCount(*this) > 0 ||
+         BLEProfileManager::instance()->hasAttributeTable()))
     {
         BLEProfileManager::instance()->registerProfile(*this);
         delay(8); 
@@ -32,8 +32,23 @@ enum BLEDeviceEvent {
   BLEDeviceLastEvent
 };
 
+/* Preset connection parameters, see BLEDevice::setConnectionProfile() */
+enum BLEConnectionProfile {
+  BLEConnectionThroughput = 0,  // 7.5 - 15 ms interval, no slave latency
+  BLEConnectionBalanced,        // 30 - 50 ms interval, no slave latency
+  BLEConnectionLowPower,        // 250 - 500 ms interval, slave latency 4
+  BLEConnectionLastProfile
+};
+
 typedef void (*BLEDeviceEventHandler)(BLEDevice device);
 
+// A scan report as received, see BLEDevice::setScanReportHandler()
+typedef void (*BLEScanReportHandler)(BLEDevice device,
+                                     int rssi,
+                                     const unsigned char* data,
+                                     int length,
+                                     bool scanResponse);
+
 class BLEDevice
 {
   public:
@@ -121,6 +136,19 @@ class BLEDevice
      */
     bool connected() const;
     
+    /**
+     * @brief   The ATT MTU of the link with the device
+     *
+     * @param   none
+     *
+     * @return   uint16_t   The MTU in bytes, 0 if not connected.
+     *                      Notifications carry up to mtu() - 3 bytes.
+     *
+     * @note  Always BLE_ATT_MTU_DEFAULT, as the nRF core can't exchange
+     *        a larger one
+     */
+    uint16_t mtu() const;
+    
     /**
      * @brief   Disconnect the connected device/s.
      *
@@ -191,6 +219,21 @@ class BLEDevice
     void setManufacturerData(const unsigned char manufacturerData[], 
                              unsigned char manufacturerDataLength);
     
+    /**
+     * @brief   Change the manufacturer data while advertising
+     *
+     * @param[in] manufacturerData          The new manufacturer data
+     * @param[in] manufacturerDataLength    The length of the manufacturer data
+     *
+     * @return  int       0 - Success. Others - error code @enum BLE_STATUS_T
+     *
+     * @note  Only the advertising data is sent again; advertising is not
+     *         restarted. Keeping the length the same lets the data be
+     *         patched in place. Only for peripheral mode.
+     */
+    int updateManufacturerData(const unsigned char manufacturerData[],
+                               unsigned char manufacturerDataLength);
+    
     bool getManufacturerData (unsigned char* manu_data, 
                               unsigned char& manu_data_len) const;
     
@@ -252,6 +295,21 @@ class BLEDevice
     void setConnectionInterval(int minimumConnectionInterval, 
                                int maximumConnectionInterval);
     
+    /**
+     * @brief   Request one of the preset connection parameter sets on the
+     *           link with this device, e.g. BLEConnectionThroughput around
+     *           a bulk transfer and BLEConnectionLowPower afterwards
+     *
+     * @param[in]   profile     The parameter set
+     *
+     * @return  bool    true - Update requested, false - Not connected or error
+     *
+     * @note  The peer may pick other values or refuse. The BLEConParamUpdate
+     *         event reports the accepted ones, read with getConnectionInterval(),
+     *         getConnectionLatency() and getConnectionTimeout().
+     */
+    bool setConnectionProfile(BLEConnectionProfile profile);
+    
     int getConnectionInterval();
     int getConnectionTimeout();
     int getConnectionLatency();
@@ -314,6 +372,26 @@ class BLEDevice
      */
     int addService(BLEService& attribute);
     
+    /**
+     * @brief   Add a GATT attribute table built at compile time, see
+     *           BLEGattTable.h. It is registered as it is, ahead of the
+     *           services added with addService().
+     *
+     * @param[in] attrs     The table, which must stay valid
+     *
+     * @param[in] count     The number of entries
+     *
+     * @return int     Indicating success or error type @enum BLE_STATUS_T
+     *
+     * @note This method must be called before the advertise method
+     */
+    int addAttributeTable(const bt_gatt_attr_t* attrs, int count);
+    template <size_t N>
+    int addAttributeTable(const bt_gatt_attr_t (&attrs)[N])
+    {
+        return addAttributeTable(attrs, N);
+    }
+    
     /**
      * @brief   Construct the ADV data and start send advertisement
      *
@@ -380,6 +458,27 @@ class BLEDevice
      */
     void scan(bool withDuplicates = false);
     
+    /**
+     * @brief   Set how the radio scans, for the scans started after
+     *
+     * @param[in]   interval    Time from one scan window to the next in ms,
+     *                          2.5 to 10240
+     *
+     * @param[in]   window      Time listening per interval in ms, 2.5 up to
+     *                          interval; equal to interval scans all the time
+     *
+     * @param[in]   active      true - send scan requests for scan responses.
+     *                          false - passive, only listen to the ADVs
+     *
+     * @return  bool    true - Set, false - Out of range
+     *
+     * @note  The default is an active scan, 30 ms every 60 ms. A passive
+     *        scan costs less air time and fewer reports, but sees nothing
+     *        of the scan responses: scanForName() and the scan filters
+     *        have to be met by the ADV alone.
+     */
+    bool setScanParameters(float interval, float window, bool active = true);
+    
     /**
      * @brief   Start scanning for peripherals and filter by device name in ADV and
      *          the option of accepting all detectable Peripherals or just the
@@ -436,6 +535,53 @@ class BLEDevice
      *         reported once.
      */
     void scanForAddress(String macaddr, bool withDuplicates = false);
+    
+    /**
+     * @brief   Drop scan reports weaker than rssi before they are buffered
+     *
+     * @param[in]   rssi    The lowest RSSI in dBm to accept, e.g. -80
+     *
+     * @return  none
+     *
+     * @note  The scan filters add to the one set by scanForName(),
+     *        scanForUuid() or scanForAddress(); every one set has to be met
+     *        by the ADV or by its scan response. They stay until
+     *        clearScanFilters(), so set them before scan().
+     */
+    void setScanFilterRssi(int rssi);
+    
+    /**
+     * @brief   Accept only peripherals whose local name begins with prefix
+     *
+     * @param[in]   prefix  The start of the complete or shortened name
+     *
+     * @return  none
+     *
+     * @note  See setScanFilterRssi()
+     */
+    void setScanFilterNamePrefix(String prefix);
+    
+    /**
+     * @brief   Accept only peripherals advertising manufacturer data of a company
+     *
+     * @param[in]   companyId   The Bluetooth SIG company identifier
+     *
+     * @return  none
+     *
+     * @note  See setScanFilterRssi()
+     */
+    void setScanFilterManufacturer(unsigned short companyId);
+    
+    /**
+     * @brief   Remove the filters set by the setScanFilter*() calls
+     *
+     * @param   none
+     *
+     * @return  none
+     *
+     * @note  none
+     */
+    void clearScanFilters();
 
     /**
      * @brief   Stop scanning for peripherals
@@ -477,12 +623,56 @@ class BLEDevice
     String localName() const; // returns the advertised local name as a String
     String advertisedServiceUuid() const; // returns the advertised service as a UUID String
     String advertisedServiceUuid(int index) const; // returns the nth advertised service as a UUID String
+    // Allocation-free versions: copy into buffer (NUL terminated, truncated
+    // to size) and return the length copied. A UUID needs 37 bytes
+    int localName(char *buffer, int size) const;
+    int advertisedServiceUuid(char *buffer, int size, int index = 0) const;
 
     int rssi() const; // returns the RSSI of the peripheral at discovery
+    // Point data at the ADV / scan response as received, without copying,
+    // and return the length. For a device from available() the data stays
+    // valid until available() returns another device
+    int advertisementData(const unsigned char* &data) const;
+    int scanResponseData(const unsigned char* &data) const;
 
     bool connect(); // connect to the peripheral
     bool discoverAttributes(); // discover the peripheral's attributes
     bool discoverAttributesByService(const char* svc_uuid);
+    // Only the one characteristic of the service; call again for another
+    bool discoverAttributesByService(const char* svc_uuid, const char* chrc_uuid);
+    
+    /**
+     * @brief   Leave the descriptors out of attribute discovery
+     *
+     * @param   lazy    true - A characteristic's descriptors are discovered
+     *                  on its first subscribe() or descriptor access
+     *
+     * @return  none
+     *
+     * @note  Saves a round trip per characteristic when most are only read
+     *        or written. The first access blocks for the discovery.
+     */
+    void setLazyDiscovery(bool lazy);
+    
+    /**
+     * @brief   Copy out the peer's profile as kept by discoverAttributes()
+     *
+     * @param   buffer  Gets the record, BLE_DISCOVERY_CACHE_SIZE_CFG at most
+     *
+     * @param   size    The buffer size
+     *
+     * @return  int     The record length, 0 - None or buffer too small
+     *
+     * @note  discoverAttributes() keeps the handles it finds for the next
+     *        connection to the peer. Then it discovers the primary services
+     *        only and, if they are unchanged, takes the characteristics and
+     *        descriptors from the record. Keep the record in EEPROM and give
+     *        it back with setDiscoveryCache() to keep it over a reset.
+     */
+    int discoveryCache(unsigned char* buffer, int size) const;
+    bool setDiscoveryCache(const unsigned char* buffer, int length);
+    // Forget the record, e.g. when the peer's firmware has changed
+    void clearDiscoveryCache();
 
     String deviceName(); // read the device name attribute of the peripheral, and return String value
     //int appearance(); // read the appearance attribute of the peripheral and return value as int
@@ -510,6 +700,7 @@ class BLEDevice
      * @note  none
      */
     bool hasService(const char* uuid) const;
+    bool hasService(const BLEUuid& uuid) const;
     
     /**
      * @brief   Does the peripheral have an nth service with the specified UUID
@@ -546,6 +737,7 @@ class BLEDevice
      * @note  none
      */
     BLEService service(const char * uuid) const;
+    BLEService service(const BLEUuid& uuid) const;
     
     /**
      * @brief   Return the nth service with the specified UUID
@@ -582,6 +774,7 @@ class BLEDevice
      * @note  none
      */
     bool hasCharacteristic(const char* uuid) const;
+    bool hasCharacteristic(const BLEUuid& uuid) const;
     
     /**
      * @brief   Does the device have an nth characteristic with the 
@@ -619,6 +812,7 @@ class BLEDevice
      * @note  none
      */
     BLECharacteristic characteristic(const char * uuid) const;
+    BLECharacteristic characteristic(const BLEUuid& uuid) const;
     
     /**
      * @brief   Return the nth characteristic with the specified UUID
@@ -647,6 +841,44 @@ class BLEDevice
      */
     void setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler eventHandler); // set an event handler (callback)
     
+    /**
+     * @brief   Take scan reports straight from the BLE core's interrupt
+     *
+     * @param   handler     Gets each report that passes the scan filters,
+     *                      in place, as soon as it is in; NULL goes back to
+     *                      available() and the BLEDiscovered event
+     *
+     * @return  none
+     *
+     * @note  For the lowest latency and no reports lost to full buffers.
+     *        The handler runs in interrupt context: keep it short, don't
+     *        call back into CurieBLE, and copy what it needs from data,
+     *        which is only valid during the call. The filters look at
+     *        each ADV and scan response on its own, and with the
+     *        duplicate filter only the first report of a device comes.
+     *        The device's localName() etc. aren't available; use
+     *        advertisementField() on data.
+     */
+    void setScanReportHandler(BLEScanReportHandler handler);
+    
+    /**
+     * @brief   Find an AD field in advertising or scan response data
+     *
+     * @param   data        The data, e.g. from a scan report handler
+     *
+     * @param   length      The data length
+     *
+     * @param   type        The AD type, e.g. 0x09 for the complete local name
+     *
+     * @param   field       Set to the field's value
+     *
+     * @return  int     The value length, -1 if there is no such field
+     */
+    static int advertisementField(const unsigned char* data,
+                                  int length,
+                                  unsigned char type,
+                                  const unsigned char* &field);
+    
 protected:
     friend class BLEDescriptorImp;
     friend class BLECharacteristicImp;
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2016 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieBLE.h"
+#include "BLEGattTable.h"
+
+namespace BLEGatt
+{
+
+constexpr BLEUuid primaryServiceUuid = BLE_UUID("2800");
+constexpr BLEUuid characteristicUuid = BLE_UUID("2803");
+constexpr BLEUuid cccUuid = BLE_UUID("2902");
+
+ssize_t valueRead(bt_conn_t *conn, const bt_gatt_attr_t *attr,
+                  void *buf, uint16_t len, uint16_t offset)
+{
+    const BLEGattValue* value = (const BLEGattValue*)attr->user_data;
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                             value->data, value->length);
+}
+
+ssize_t valueWrite(bt_conn_t *conn, const bt_gatt_attr_t *attr,
+                   const void *buf, uint16_t len, uint16_t offset)
+{
+    BLEGattValue* value = (BLEGattValue*)attr->user_data;
+
+    if (offset > value->length)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (offset + len > value->size)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    memcpy(value->data + offset, buf, len);
+    value->length = offset + len;
+    if (NULL != value->written)
+    {
+        value->written(attr);
+    }
+    return len;
+}
+
+// Whether a central enabled notifications in the CCC of the value attr
+static bool notifying(const bt_gatt_attr_t* attr)
+{
+    for (attr = bt_gatt_attr_next(attr); NULL != attr; attr = bt_gatt_attr_next(attr))
+    {
+        if (bt_gatt_attr_read_chrc == attr->read ||
+            bt_gatt_attr_read_service == attr->read)
+        {
+            break;
+        }
+        if (bt_gatt_attr_write_ccc == attr->write)
+        {
+            return ((_bt_gatt_ccc_t*)attr->user_data)->value & BT_GATT_CCC_NOTIFY;
+        }
+    }
+    return false;
+}
+
+bool notify(const bt_gatt_attr_t& attr, const void* data, uint16_t len)
+{
+    BLEGattValue* value = (BLEGattValue*)attr.user_data;
+
+    if (len > value->size)
+    {
+        len = value->size;
+    }
+    uint32_t saved = interrupt_lock();
+    memcpy(value->data, data, len);
+    value->length = len;
+    interrupt_unlock(saved);
+
+    // The prebuilt libarc32drv returns 0 whether it notified anyone or not
+    int status = bt_gatt_notify(NULL, &attr, value->data, len, NULL);
+    return (status > 0 || (0 == status && notifying(&attr)));
+}
+
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ARDUINO_BLE_GATT_TABLE_H
+#define ARDUINO_BLE_GATT_TABLE_H
+
+#include "BLECommon.h"
+#include "BLEUuid.h"
+
+/**
+ * A GATT attribute table built by the compiler, for
+ *  BLEDevice::addAttributeTable(). The table is const and so stays in
+ *  flash and goes to bt_gatt_register() as it is: no BLEService or
+ *  BLECharacteristic objects, no heap and no walk over them at start up.
+ *  Only the values and CCCs it points to live in RAM.
+ *
+ *      constexpr BLEUuid ledService = BLE_UUID("19b10000-e8f2-537e-4f6c-d104768a1214");
+ *      constexpr BLEUuid ledSwitch  = BLE_UUID("19b10001-e8f2-537e-4f6c-d104768a1214");
+ *      constexpr bt_gatt_chrc_t ledSwitchChrc =
+ *          BLEGatt::chrc(ledSwitch, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY);
+ *      BLE_GATT_VALUE(ledSwitchValue, 1);
+ *      BLE_GATT_CCC(ledSwitchCcc);
+ *
+ *      constexpr bt_gatt_attr_t ledProfile[] = {
+ *          BLEGatt::primaryService(ledService),
+ *          BLEGatt::characteristic(ledSwitchChrc),
+ *          BLEGatt::value(ledSwitch, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, ledSwitchValue),
+ *          BLEGatt::ccc(ledSwitchCcc),
+ *      };
+ *
+ *      BLE.addAttributeTable(ledProfile);    // before BLE.advertise()
+ *
+ *  The entries follow the GATT layout, as BLEServiceImp::updateProfile()
+ *  writes them: a service declaration, then per characteristic its
+ *  declaration, its value and any descriptors.
+ */
+
+/// RAM storage behind a BLEGatt::value() attribute
+typedef struct {
+    uint8_t* data;
+    uint16_t size;      ///< capacity of data
+    uint16_t length;    ///< bytes of data in use
+    /// Called after a peer wrote the value, from the BLE interrupt; may be NULL
+    void (*written)(const bt_gatt_attr_t* attr);
+} BLEGattValue;
+
+/// Defines a BLEGattValue name of size bytes, initially empty
+#define BLE_GATT_VALUE(name, size)                              \
+    static uint8_t name##_data[size];                           \
+    BLEGattValue name = { name##_data, size, 0, NULL }
+
+/// CCC storage for a characteristic that notifies or indicates
+typedef struct {
+    bt_gatt_ccc_cfg_t cfg;
+    _bt_gatt_ccc_t    ccc;
+} BLEGattCcc;
+
+/// Defines a BLEGattCcc name
+#define BLE_GATT_CCC(name)                                      \
+    BLEGattCcc name = { {}, { &name.cfg, 1, 0, NULL } }
+
+namespace BLEGatt
+{
+    extern const BLEUuid primaryServiceUuid;    // 0x2800
+    extern const BLEUuid characteristicUuid;    // 0x2803
+    extern const BLEUuid cccUuid;               // 0x2902
+
+    ssize_t valueRead(bt_conn_t *conn, const bt_gatt_attr_t *attr,
+                      void *buf, uint16_t len, uint16_t offset);
+    ssize_t valueWrite(bt_conn_t *conn, const bt_gatt_attr_t *attr,
+                       const void *buf, uint16_t len, uint16_t offset);
+
+    /// The declaration value of a characteristic, for characteristic()
+    constexpr bt_gatt_chrc_t chrc(const BLEUuid& uuid, uint8_t properties)
+    {
+        return bt_gatt_chrc_t{ uuid.bt_uuid(), properties };
+    }
+
+    constexpr bt_gatt_attr_t primaryService(const BLEUuid& uuid)
+    {
+        return bt_gatt_attr_t{ primaryServiceUuid.bt_uuid(),
+                               bt_gatt_attr_read_service, NULL, NULL,
+                               const_cast<bt_uuid_t*>(uuid.bt_uuid()),
+                               0, BT_GATT_PERM_READ };
+    }
+
+    constexpr bt_gatt_attr_t characteristic(const bt_gatt_chrc_t& chrc)
+    {
+        return bt_gatt_attr_t{ characteristicUuid.bt_uuid(),
+                               bt_gatt_attr_read_chrc, NULL, NULL,
+                               const_cast<bt_gatt_chrc_t*>(&chrc),
+                               0, BT_GATT_PERM_READ };
+    }
+
+    /// A characteristic value or a descriptor, kept in value
+    constexpr bt_gatt_attr_t value(const BLEUuid& uuid, uint8_t perm, BLEGattValue& value)
+    {
+        return bt_gatt_attr_t{ uuid.bt_uuid(), valueRead, valueWrite, NULL,
+                               &value, 0, perm };
+    }
+
+    constexpr bt_gatt_attr_t ccc(BLEGattCcc& ccc)
+    {
+        return bt_gatt_attr_t{ cccUuid.bt_uuid(),
+                               bt_gatt_attr_read_ccc, bt_gatt_attr_write_ccc, NULL,
+                               &ccc.ccc, 0, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE };
+    }
+
+    /**
+     * @brief   Updates the value of a value attribute and notifies it to
+     *           the subscribed centrals
+     *
+     * @param   attr    The value entry of a registered table
+     *
+     * @return  bool    true - sent.  false - not sent, the value is still updated
+     */
+    bool notify(const bt_gatt_attr_t& attr, const void* data, uint16_t len);
+}
+
+#endif // ARDUINO_BLE_GATT_TABLE_H
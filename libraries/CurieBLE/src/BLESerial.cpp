@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieBLE.h"
+
+#include "BLESerial.h"
+
+BLESerialAttributes::BLESerialAttributes():
+    _service(BLE_SERIAL_SERVICE_UUID),
+    _rxCharacteristic(BLE_SERIAL_RX_UUID,
+                      BLEWrite | BLEWriteWithoutResponse,
+                      BLE_MAX_ATTR_DATA_LEN),
+    _txCharacteristic(BLE_SERIAL_TX_UUID, BLENotify, BLE_MAX_ATTR_DATA_LEN),
+    _creditsCharacteristic(BLE_SERIAL_CREDITS_UUID,
+                           BLERead | BLENotify,
+                           sizeof(uint32_t))
+{
+}
+
+BLESerial::BLESerial():
+    BLEStream(_txCharacteristic, _rxCharacteristic, _creditsCharacteristic)
+{
+}
+
+void BLESerial::begin()
+{
+    BLEStream::begin();
+    setFlushDelay(BLE_SERIAL_FLUSH_MS_CFG);
+    
+    _service.addCharacteristic(_rxCharacteristic);
+    _service.addCharacteristic(_txCharacteristic);
+    _service.addCharacteristic(_creditsCharacteristic);
+    BLE.addService(_service);
+}
+
+BLEService& BLESerial::service()
+{
+    return _service;
+}
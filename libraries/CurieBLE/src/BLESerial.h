@@ -0,0 +1,84 @@
+/*
+  BLE serial port over the Nordic UART service
+  Copyright (c) 2017 Intel Corporation. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef ARDUINO_BLE_SERIAL_H
+#define ARDUINO_BLE_SERIAL_H
+
+#include "BLEService.h"
+#include "BLECharacteristic.h"
+#include "BLEStream.h"
+
+#define BLE_SERIAL_SERVICE_UUID     "6e400001-b5a3-f393-e0a9-e50e24dcca9e"
+#define BLE_SERIAL_RX_UUID          "6e400002-b5a3-f393-e0a9-e50e24dcca9e"
+#define BLE_SERIAL_TX_UUID          "6e400003-b5a3-f393-e0a9-e50e24dcca9e"
+#define BLE_SERIAL_CREDITS_UUID     "6e400004-b5a3-f393-e0a9-e50e24dcca9e"
+
+// The attributes, built before the BLEStream that refers to them
+class BLESerialAttributes
+{
+protected:
+    BLESerialAttributes();
+
+    BLEService _service;
+    BLECharacteristic _rxCharacteristic;
+    BLECharacteristic _txCharacteristic;
+    BLECharacteristic _creditsCharacteristic;
+};
+
+/**
+ * A serial port in the local GATT server, as the Nordic UART service that
+ * phone and desktop terminal apps speak: the client writes to RX and
+ * subscribes to TX.
+ *
+ *      BLESerial bleSerial;
+ *
+ *      BLE.begin();
+ *      bleSerial.begin();
+ *      BLE.setAdvertisedService(bleSerial.service());
+ *      BLE.advertise();
+ *      ...
+ *      bleSerial.print(millis());
+ *
+ * Writes are packed into full notifications, and a part filled one goes
+ * out BLE_SERIAL_FLUSH_MS_CFG after its first byte, so print() costs no
+ * notification of its own. The service also has a credits characteristic
+ * that lets a client pace its writes to what read() takes, see BLEStream.
+ * Clients that ignore it work as with any UART service, and may overrun
+ * the RX buffer.
+ */
+class BLESerial : private BLESerialAttributes, public BLEStream
+{
+public:
+    BLESerial();
+
+    /**
+     * @brief   Add the service to the local GATT server
+     *
+     * @param   none
+     *
+     * @return  none
+     *
+     * @note  After BLE.begin(), before BLE.advertise()
+     */
+    void begin();
+
+    BLEService& service();
+};
+
+#endif
@@ -144,6 +144,17 @@ bool BLEService::hasCharacteristic(const char* uuid) const
     return (NULL != characteristicImp);
 }
 
+bool BLEService::hasCharacteristic(const BLEUuid& uuid) const
+{
+    BLECharacteristicImp* characteristicImp = NULL;
+    BLEServiceImp* serviceImp = getServiceImp();
+    if (NULL != serviceImp)
+    {
+        characteristicImp = serviceImp->characteristic(uuid.bt_uuid());
+    }
+    return (NULL != characteristicImp);
+}
+
 bool BLEService::hasCharacteristic(const char* uuid, int index) const
 {
     BLECharacteristicImp* characteristicImp = NULL;
@@ -201,6 +212,27 @@ BLECharacteristic BLEService::characteristic(const char * uuid) const
     }
 }
 
+BLECharacteristic BLEService::characteristic(const BLEUuid& uuid) const
+{
+    BLECharacteristicImp* characteristicImp = NULL;
+    BLEServiceImp* serviceImp = getServiceImp();
+    if (NULL != serviceImp)
+    {
+        characteristicImp = serviceImp->characteristic(uuid.bt_uuid());
+    }
+    
+    if (NULL == characteristicImp)
+    {
+        BLECharacteristic temp;
+        return temp;
+    }
+    else
+    {
+        BLECharacteristic temp(characteristicImp, &_bledevice);
+        return temp;
+    }
+}
+
 BLECharacteristic BLEService::characteristic(const char * uuid, int index) const
 {
     BLECharacteristicImp* characteristicImp = NULL;
@@ -70,6 +70,7 @@ public:
      * @note  none
      */
     bool hasCharacteristic(const char* uuid) const;
+    bool hasCharacteristic(const BLEUuid& uuid) const;
     
     /**
      * @brief   Does the service have an nth characteristic with the 
@@ -106,6 +107,7 @@ public:
      * @note  none
      */
     BLECharacteristic characteristic(const char * uuid) const;
+    BLECharacteristic characteristic(const BLEUuid& uuid) const;
     
     /**
      * @brief   return the nth characteristic with the specified UUID
@@ -148,4 +150,7 @@ private:
     BLEServiceImp* _service_local_imp; // This not allow copy
 };
 
+#define ARDUINO_BLE_SERVICE_DEFINED
+#include "CurieBLE.h"  // Headers holding this class by value, see there
+
 #endif
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieBLE.h"
+
+#include "./internal/BLEUtils.h"
+
+#include "BLEStream.h"
+
+BLEStream* BLEStream::_streams = NULL;
+
+BLEStream::BLEStream(BLECharacteristic& tx, BLECharacteristic& rx):
+    _tx(tx),
+    _rx(rx),
+    _credits(NULL),
+    _next(NULL),
+    _rx_head(0),
+    _rx_tail(0),
+    _rx_overflows(0),
+    _rx_consumed(0),
+    _rx_reported(0),
+    _tx_length(0),
+    _tx_busy(false),
+    _flush_ms(0),
+    _flush_task(flushTask, this)
+{
+}
+
+BLEStream::BLEStream(BLECharacteristic& tx, BLECharacteristic& rx,
+                     BLECharacteristic& credits):
+    BLEStream(tx, rx)
+{
+    _credits = &credits;
+}
+
+BLEStream::~BLEStream()
+{
+    end();
+}
+
+void BLEStream::begin()
+{
+    end();
+    _rx.setStreamHandlers(rxWritten);
+    if (NULL != _credits)
+    {
+        // Only the latest count matters to the client
+        _credits->setNotifyCoalescing(true, true);
+    }
+    
+    uint32_t saved = interrupt_lock();
+    _next = _streams;
+    _streams = this;
+    interrupt_unlock(saved);
+}
+
+void BLEStream::end()
+{
+    uint32_t saved = interrupt_lock();
+    BLEStream** link = &_streams;
+    while (NULL != *link)
+    {
+        if (*link == this)
+        {
+            *link = _next;
+            break;
+        }
+        link = &(*link)->_next;
+    }
+    _next = NULL;
+    interrupt_unlock(saved);
+    _flush_task.stop();
+}
+
+void BLEStream::setFlushDelay(uint16_t ms)
+{
+    _flush_ms = ms;
+    if (0 == ms)
+    {
+        _flush_task.stop();
+    }
+}
+
+// The handler has no context, so find the stream by the characteristic
+//  the chunk was written to. Runs in the IPC UART interrupt.
+void BLEStream::rxWritten(BLEDevice bledev,
+                         BLECharacteristic characteristic,
+                         const unsigned char data[],
+                         unsigned short length,
+                         unsigned short offset)
+{
+    if (NULL == data || 0 == length)
+    {
+        return;
+    }
+    
+    const char* uuid = characteristic.uuid();
+    for (BLEStream* stream = _streams; NULL != stream; stream = stream->_next)
+    {
+        if (0 == strcmp(uuid, stream->_rx.uuid()))
+        {
+            stream->receive(data, length);
+            break;
+        }
+    }
+}
+
+void BLEStream::receive(const unsigned char data[], unsigned short length)
+{
+    uint16_t head = _rx_head;
+    for (unsigned short i = 0; i < length; i++)
+    {
+        uint16_t next = (head + 1) % BLE_STREAM_RX_BUFFER_CFG;
+        if (next == _rx_tail)
+        {
+            _rx_overflows += length - i;
+            break;
+        }
+        _rx_buffer[head] = data[i];
+        head = next;
+    }
+    _rx_head = head;
+}
+
+int BLEStream::available()
+{
+    return (_rx_head + BLE_STREAM_RX_BUFFER_CFG - _rx_tail) % BLE_STREAM_RX_BUFFER_CFG;
+}
+
+int BLEStream::read()
+{
+    uint16_t tail = _rx_tail;
+    if (tail == _rx_head)
+    {
+        return -1;
+    }
+    uint8_t byte = _rx_buffer[tail];
+    _rx_tail = (tail + 1) % BLE_STREAM_RX_BUFFER_CFG;
+    consumed(1);
+    return byte;
+}
+
+// Report every quarter of the buffer. The client then always has room
+//  for another three quarters, or this side has bytes left to read
+void BLEStream::consumed(int n)
+{
+    _rx_consumed += n;
+    if (NULL != _credits &&
+        _rx_consumed - _rx_reported >= BLE_STREAM_RX_BUFFER_CFG / 4)
+    {
+        reportCredits();
+    }
+}
+
+// The span ends at the head or at the end of the buffer, whichever is
+//  first; a wrapped run takes two peekSpan()/consume() rounds
+int BLEStream::peekSpan(const uint8_t **data)
+{
+    uint16_t tail = _rx_tail;
+    uint16_t head = _rx_head;
+    
+    *data = _rx_buffer + tail;
+    if (head >= tail)
+    {
+        return head - tail;
+    }
+    return BLE_STREAM_RX_BUFFER_CFG - tail;
+}
+
+void BLEStream::consume(int n)
+{
+    int avail = available();
+    
+    if (n > avail)
+    {
+        n = avail;
+    }
+    if (n <= 0)
+    {
+        return;
+    }
+    _rx_tail = (_rx_tail + n) % BLE_STREAM_RX_BUFFER_CFG;
+    consumed(n);
+}
+
+void BLEStream::reportCredits()
+{
+    uint32_t consumed = _rx_consumed;
+    // Kept for the next read() if it didn't go out
+    if (_credits->writeValue((const byte*)&consumed, sizeof(consumed)))
+    {
+        _rx_reported = consumed;
+    }
+}
+
+int BLEStream::peek()
+{
+    uint16_t tail = _rx_tail;
+    if (tail == _rx_head)
+    {
+        return -1;
+    }
+    return _rx_buffer[tail];
+}
+
+// Hands the held bytes to the notification queue, waiting while it is
+//  full; the bytes are dropped if the client goes away meanwhile.
+bool BLEStream::sendSegment()
+{
+    while (!_tx.notifyAsync(_tx_buffer, _tx_length))
+    {
+        if (!_tx.subscribed())
+        {
+            _tx_length = 0;
+            return false;
+        }
+        BLEUtils::waitForEvent();
+    }
+    _tx_length = 0;
+    return true;
+}
+
+void BLEStream::flush()
+{
+    if (_tx_length > 0)
+    {
+        _tx_busy = true;
+        sendSegment();
+        _tx_busy = false;
+    }
+}
+
+// Sends what write() left held, without waiting: a full queue or a
+//  write() in progress just retries a millisecond later
+void BLEStream::flushTask(void* arg)
+{
+    BLEStream* stream = (BLEStream*)arg;
+    
+    if (0 == stream->_tx_length)
+    {
+        return;
+    }
+    if (!stream->_tx.subscribed())
+    {
+        stream->_tx_length = 0;
+        return;
+    }
+    if (stream->_tx_busy ||
+        !stream->_tx.notifyAsync(stream->_tx_buffer, stream->_tx_length))
+    {
+        stream->_flush_task.start(1);
+        return;
+    }
+    stream->_tx_length = 0;
+}
+
+size_t BLEStream::write(uint8_t byte)
+{
+    return write(&byte, 1);
+}
+
+size_t BLEStream::write(const uint8_t *buffer, size_t size)
+{
+    if (!_tx.subscribed())
+    {
+        _tx_length = 0;
+        return 0;
+    }
+    
+    size_t done = 0;
+    _tx_busy = true;
+    while (done < size)
+    {
+        size_t n = BLE_MAX_ATTR_DATA_LEN - _tx_length;
+        if (n > size - done)
+        {
+            n = size - done;
+        }
+        memcpy(_tx_buffer + _tx_length, buffer + done, n);
+        _tx_length += n;
+        done += n;
+        
+        if (BLE_MAX_ATTR_DATA_LEN == _tx_length && !sendSegment())
+        {
+            // The segment never went out, nor did this call's part of it
+            _tx_busy = false;
+            return done > BLE_MAX_ATTR_DATA_LEN ?
+                   done - BLE_MAX_ATTR_DATA_LEN : 0;
+        }
+    }
+    _tx_busy = false;
+    
+    if (_tx_length > 0 && _flush_ms > 0 && !_flush_task.isScheduled())
+    {
+        _flush_task.start(_flush_ms);
+    }
+    return done;
+}
+
+int BLEStream::availableForWrite()
+{
+    if (!_tx.subscribed())
+    {
+        return 0;
+    }
+    return BLE_MAX_ATTR_DATA_LEN - _tx_length;
+}
+
+unsigned long BLEStream::overflows() const
+{
+    return _rx_overflows;
+}
+
+BLEStream::operator bool()
+{
+    return _tx.subscribed();
+}
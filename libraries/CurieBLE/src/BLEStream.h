@@ -0,0 +1,161 @@
+/*
+  BLE byte stream over a pair of GATT characteristics
+  Copyright (c) 2017 Intel Corporation. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef ARDUINO_BLE_STREAM_H
+#define ARDUINO_BLE_STREAM_H
+
+#include "Stream.h"
+#include "Task.h"
+
+/**
+ * A Stream over two characteristics of the local GATT server: bytes the
+ * client writes to rx are read back with read(), and bytes written here go
+ * to the client as notifications of tx, packed into full ATT payloads.
+ *
+ * Give tx BLENotify and rx BLEWrite or BLEWriteWithoutResponse (the
+ * latter is the fast one), and add both to a service as usual. Call
+ * begin() before BLE.addService(), as it installs the rx stream handler.
+ */
+class BLEStream : public Stream
+{
+public:
+    BLEStream(BLECharacteristic& tx, BLECharacteristic& rx);
+
+    /**
+     * @brief   A stream whose client paces its writes by credits
+     *
+     * @param   credits     BLERead | BLENotify, 4 bytes. Holds the count of
+     *                      bytes read() has taken, little endian and free
+     *                      running, and is notified as it grows. A client
+     *                      that has sent n bytes in total may send until
+     *                      n - credits reaches BLE_STREAM_RX_BUFFER_CFG - 1,
+     *                      and then nothing is dropped
+     */
+    BLEStream(BLECharacteristic& tx, BLECharacteristic& rx,
+              BLECharacteristic& credits);
+    virtual ~BLEStream();
+
+    /**
+     * @brief   Hook the stream into its characteristics
+     *
+     * @param   none
+     *
+     * @return  none
+     *
+     * @note  Before the characteristics are added to the service
+     */
+    void begin();
+    void end();
+
+    /**
+     * @brief   Send a part filled notification at the latest ms after its
+     *          first byte was written
+     *
+     * @param   ms      0 - Only when full or on flush(), the default
+     *
+     * @return  none
+     *
+     * @note  The notification goes out from a Task, so from the main loop
+     *        or a yield()
+     */
+    void setFlushDelay(uint16_t ms);
+
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+
+    /**
+     * @brief   Zero-copy receive, see Stream::peekSpan()
+     *
+     * @note  consume() counts the bytes toward the credits as read() does
+     */
+    virtual int peekSpan(const uint8_t **data);
+    virtual void consume(int n);
+
+    /**
+     * @brief   Send the bytes still waiting for a full notification
+     *
+     * @note  Waits while the notification queue is full
+     */
+    virtual void flush();
+
+    /**
+     * @brief   Write bytes to the subscribed client
+     *
+     * @return  The count taken; short if the client unsubscribed or
+     *          disconnected on the way, 0 if it is not subscribed
+     *
+     * @note  Bytes are held until a notification is full or flush() is
+     *        called. Waits while the notification queue is full.
+     */
+    virtual size_t write(uint8_t byte);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+    /**
+     * @brief   Room left in the notification being filled, 0 if no client
+     *          is subscribed
+     *
+     * @note  Writing that many sends the notification, which waits only
+     *        while the notification queue is full
+     */
+    virtual int availableForWrite();
+
+    /**
+     * @brief   Bytes dropped because the RX buffer was full
+     */
+    unsigned long overflows() const;
+
+    operator bool();
+
+private:
+    static void rxWritten(BLEDevice bledev,
+                          BLECharacteristic characteristic,
+                          const unsigned char data[],
+                          unsigned short length,
+                          unsigned short offset);
+    void receive(const unsigned char data[], unsigned short length);
+    bool sendSegment();
+    void consumed(int n);
+    void reportCredits();
+    static void flushTask(void* arg);
+
+    BLECharacteristic& _tx;
+    BLECharacteristic& _rx;
+    BLECharacteristic* _credits;
+    BLEStream* _next;
+    static BLEStream* _streams;
+
+    // Filled in the rx write handler, emptied by read()
+    uint8_t _rx_buffer[BLE_STREAM_RX_BUFFER_CFG];
+    volatile uint16_t _rx_head;
+    volatile uint16_t _rx_tail;
+    volatile unsigned long _rx_overflows;
+    uint32_t _rx_consumed;
+    uint32_t _rx_reported;
+
+    uint8_t _tx_buffer[BLE_MAX_ATTR_DATA_LEN];
+    uint8_t _tx_length;
+    // write() may yield, and the flush task must not send meanwhile
+    bool _tx_busy;
+    uint16_t _flush_ms;
+    Task _flush_task;
+};
+
+#endif
@@ -41,6 +41,24 @@ public:
      */
     BLETypedCharacteristic(const char* uuid, unsigned char properties);
 
+    /**
+     * @brief   A typed characteristic whose value stays in the sketch's
+     *           variable, see BLECharacteristic::setValueStorage()
+     *
+     * @param[in]   uuid        The characteristic UUID 16/128 bits
+     *
+     * @param[in]   properties  The property of the characteristic
+     *
+     * @param[in]   storage     The variable, which must outlive the
+     *                           characteristic. Change it in place and call
+     *                           notifyValue(); GATT client writes land in it
+     *
+     * @return  none
+     *
+     * @note  none
+     */
+    BLETypedCharacteristic(const char* uuid, unsigned char properties, T& storage);
+
     /**
      * @brief   Set the characteristic value
      *
@@ -142,6 +160,12 @@ template<typename T> BLETypedCharacteristic<T>::BLETypedCharacteristic(const cha
     setValue(value);
 }
 
+template<typename T> BLETypedCharacteristic<T>::BLETypedCharacteristic(const char* uuid, unsigned char properties, T& storage) :
+  BLECharacteristic(uuid, properties, sizeof(T))
+{
+    setValueStorage((unsigned char*)&storage, sizeof(T));
+}
+
 template<typename T> bool BLETypedCharacteristic<T>::setValue(T value) {
     return BLECharacteristic::setValue((unsigned char*)&value, sizeof(T));
 }
@@ -186,4 +210,121 @@ template<typename T> T BLETypedCharacteristic<T>::byteSwap(T value) {
     return result;
 }
 
+/**
+ * A characteristic holding N values of T, kept in the object. Elements are
+ *  updated in place; notifyChanges() then notifies the array, only if an
+ *  element actually changed since the last notification.
+ */
+template<typename T, int N> class BLEFixedArrayCharacteristic : public BLECharacteristic
+{
+public:
+    /**
+     * @brief   The constructor of the array characteristic, all elements 0
+     *
+     * @param[in]   uuid        The characteristic UUID 16/128 bits
+     *
+     * @param[in]   properties  The property of the characteristic
+     *
+     * @return  none
+     *
+     * @note  none
+     */
+    BLEFixedArrayCharacteristic(const char* uuid, unsigned char properties);
+
+    using BLECharacteristic::value;
+    using BLECharacteristic::setValue;
+
+    /**
+     * @brief   Get an element
+     *
+     * @param[in]   index   The element, 0 to N - 1
+     *
+     * @return  T       The element, as last set or written by the GATT client
+     *
+     * @note  none
+     */
+    T value(int index) const { return _values[index]; }
+
+    /**
+     * @brief   Set an element in place
+     *
+     * @param[in]   index   The element, 0 to N - 1
+     *
+     * @param[in]   value   The new value
+     *
+     * @return  bool    true - Set, false - index out of range
+     *
+     * @note  none
+     */
+    bool setValue(int index, const T& value);
+
+    /**
+     * @brief   Set count elements from index in place
+     *
+     * @return  bool    true - Set, false - out of range
+     *
+     * @note  none
+     */
+    bool setValues(int index, const T values[], int count);
+
+    /**
+     * @brief   Has an element changed since the last notifyChanges()
+     */
+    bool changed() const { return _changed; }
+
+    /**
+     * @brief   Notify the array to the subscribed central if an element
+     *           changed, without copying it first
+     *
+     * @param   none
+     *
+     * @return  bool    true - Sent or nothing to send, false - Failed, the
+     *                  changes stay pending
+     *
+     * @note  A notification carries at most BLE_MAX_ATTR_DATA_LEN bytes
+     *        from the start of the value; the central reads the rest.
+     */
+    bool notifyChanges();
+
+private:
+    T _values[N];
+    bool _changed;
+};
+
+template<typename T, int N> BLEFixedArrayCharacteristic<T, N>::BLEFixedArrayCharacteristic(const char* uuid, unsigned char properties) :
+  BLECharacteristic(uuid, properties, sizeof(T) * N),
+  _changed(false)
+{
+    static_assert(sizeof(T) * N <= BLE_MAX_ATTR_LONGDATA_LEN, "array too long for a characteristic");
+    memset(_values, 0x00, sizeof(_values));
+    setValueStorage((unsigned char*)_values, sizeof(_values));
+}
+
+template<typename T, int N> bool BLEFixedArrayCharacteristic<T, N>::setValue(int index, const T& value) {
+    return setValues(index, &value, 1);
+}
+
+template<typename T, int N> bool BLEFixedArrayCharacteristic<T, N>::setValues(int index, const T values[], int count) {
+    if (index < 0 || count < 0 || index + count > N) {
+        return false;
+    }
+    if (0 != memcmp(&_values[index], values, count * sizeof(T))) {
+        memcpy(&_values[index], values, count * sizeof(T));
+        _changed = true;
+    }
+    return true;
+}
+
+template<typename T, int N> bool BLEFixedArrayCharacteristic<T, N>::notifyChanges() {
+    if (false == _changed) {
+        return true;
+    }
+    _changed = false;
+    if (false == notifyValue()) {
+        _changed = true;
+        return false;
+    }
+    return true;
+}
+
 #endif // _BLE_TYPED_CHARACTERISTIC_H_INCLUDED
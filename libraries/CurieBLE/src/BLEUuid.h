@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2016 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ARDUINO_BLE_UUID_H
+#define ARDUINO_BLE_UUID_H
+
+#include "BLECommon.h"
+
+/**
+ * A UUID in the binary form the stack uses, parsed from its string by the
+ *  compiler:
+ *
+ *      constexpr BLEUuid ledServiceUuid = BLE_UUID("19b10000-e8f2-537e-4f6c-d104768a1214");
+ *      BLECharacteristic c = peripheral.characteristic(BLE_UUID("2a19"));
+ *
+ *  Lookups taking a BLEUuid compare binary values and never parse or format
+ *  a string. Declaring it constexpr guarantees there is no parsing at run
+ *  time either. The string is read as uuidString2BT() does: 4 hex digits
+ *  give a 16-bit UUID, anything else a 128-bit one, and '-' is skipped.
+ */
+class BLEUuid
+{
+public:
+    template <size_t N>
+    constexpr explicit BLEUuid(const char (&uuid)[N]) :
+        _uuid{ { (uint8_t)(digits(uuid, N - 1) == 4 ? BT_UUID_TYPE_16 : BT_UUID_TYPE_128) },
+               { val(uuid, N - 1, 0),  val(uuid, N - 1, 1),  val(uuid, N - 1, 2),
+                 val(uuid, N - 1, 3),  val(uuid, N - 1, 4),  val(uuid, N - 1, 5),
+                 val(uuid, N - 1, 6),  val(uuid, N - 1, 7),  val(uuid, N - 1, 8),
+                 val(uuid, N - 1, 9),  val(uuid, N - 1, 10), val(uuid, N - 1, 11),
+                 val(uuid, N - 1, 12), val(uuid, N - 1, 13), val(uuid, N - 1, 14),
+                 val(uuid, N - 1, 15) } }
+    {
+    }
+
+    constexpr const bt_uuid_t* bt_uuid() const { return &_uuid.uuid; }
+    constexpr operator const bt_uuid_t*() const { return bt_uuid(); }
+
+private:
+    static constexpr uint8_t nibble(char c)
+    {
+        return (c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10);
+    }
+
+    static constexpr size_t digits(const char* s, size_t len)
+    {
+        return (len == 0) ? 0 : (s[len - 1] != '-') + digits(s, len - 1);
+    }
+
+    // Index of the n-th hex digit from the end
+    static constexpr size_t digitAt(const char* s, size_t len, size_t n)
+    {
+        return (s[len - 1] == '-') ? digitAt(s, len - 1, n)
+             : (n == 0) ? len - 1 : digitAt(s, len - 1, n - 1);
+    }
+
+    // Byte k of the little endian value, 0 past the digits in the string
+    static constexpr uint8_t byteAt(const char* s, size_t len, size_t k)
+    {
+        return (2 * k + 1 < digits(s, len))
+             ? (nibble(s[digitAt(s, len, 2 * k + 1)]) << 4) | nibble(s[digitAt(s, len, 2 * k)])
+             : 0;
+    }
+
+    // val[i] of the bt_uuid_128_t storage: a 16-bit UUID is laid out as
+    //  bt_uuid_16_t, whose val follows a byte of padding
+    static constexpr uint8_t val(const char* s, size_t len, size_t i)
+    {
+        return (digits(s, len) != 4) ? byteAt(s, len, i)
+             : (i == 1 || i == 2) ? byteAt(s, len, i - 1) : 0;
+    }
+
+    bt_uuid_128_t _uuid;
+};
+
+#define BLE_UUID(uuid)  BLEUuid(uuid)
+
+#endif // ARDUINO_BLE_UUID_H
@@ -29,8 +29,11 @@ class BLEDescriptor;
 class BLEService;
 class BLECharacteristicImp;
 class BLEDescriptorImp;
+class BLEUuid;
 
 #include "BLECommon.h"
+#include "BLEUuid.h"
+#include "BLEGattTable.h"
 
 #include "BLEDevice.h"
 #include "BLEAttributeWithValue.h"
@@ -39,6 +42,7 @@ class BLEDescriptorImp;
 #include "BLEService.h"
 
 #include "BLETypedCharacteristics.h"
+#include "BLEStream.h"
 
 #include "BLECentral.h"
 #include "BLEPeripheral.h"
@@ -46,3 +50,12 @@ class BLEDescriptorImp;
 extern BLEDevice BLE;
 
 #endif
+
+// BLESerial and BLEBulkTransfer hold a BLEService and BLECharacteristics by
+// value, so they can only be pulled in once both are complete. Reached from the top of
+// BLEService.h or BLECharacteristic.h they aren't yet; those headers
+// include this file again after their class definitions.
+#if defined(ARDUINO_BLE_SERVICE_DEFINED) && defined(ARDUINO_BLE_CHARACTERISTIC_DEFINED)
+#include "BLESerial.h"
+#include "BLEBulkTransfer.h"
+#endif
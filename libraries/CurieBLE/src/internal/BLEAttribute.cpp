@@ -49,10 +49,13 @@ BLEAttribute::type() const {
 
 bool BLEAttribute::compareUuid(const bt_uuid_t* uuid)
 {
-    int cmpresult = 0;
-    cmpresult = bt_uuid_cmp(uuid, (const bt_uuid_t*)&_uuid);
-    return (cmpresult == 0);
-    
+    // A 16-bit UUID can equal a 128-bit one on the SIG base, which
+    //  bt_uuid_cmp() works out by expanding both
+    if (uuid->type != _uuid.uuid.type)
+    {
+        return (0 == bt_uuid_cmp(uuid, (const bt_uuid_t*)&_uuid));
+    }
+    return BLEUtils::uuidBTSame(uuid, (const bt_uuid_t*)&_uuid);
 }
 
 bool BLEAttribute::compareUuid(const char* uuid)
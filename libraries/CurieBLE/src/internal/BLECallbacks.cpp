@@ -39,6 +39,10 @@ ssize_t profile_read_process(bt_conn_t *conn,
     if (BLETypeCharacteristic == type)
     {
         BLECharacteristicImp* blecharacteritic = (BLECharacteristicImp*)bleattr;
+        if (blecharacteritic->readStreaming())
+        {
+            return blecharacteritic->readStream((unsigned char *)buf, len, offset);
+        }
         pvalue = blecharacteritic->value();
         return bt_gatt_attr_read(conn, attr, buf, len, offset, pvalue,
                                  blecharacteritic->valueLength());
@@ -68,6 +72,13 @@ ssize_t profile_write_process(bt_conn_t *conn,
     }
     
     blecharacteritic = (BLECharacteristicImp*)bleattr;
+    if (blecharacteritic->writeStreaming())
+    {
+        // A single chunk, complete at once
+        blecharacteritic->setBuffer((const uint8_t *) buf, len, 0);
+        blecharacteritic->syncupBuffer2Value();
+        return len;
+    }
     blecharacteritic->setValue((const uint8_t *) buf, len);
     return len;
 }
@@ -157,18 +168,22 @@ uint8_t profile_read_rsp_process(bt_conn_t *conn,
                                  const void *data, 
                                  uint16_t length)
 {
-    if (NULL == data && 0 != length)
-    {
-        return BT_GATT_ITER_STOP;
-    }
     BLECharacteristicImp *chrc = NULL;
     BLEDevice bleDevice(bt_conn_get_dst(conn));
     
     // Get characteristic by handle params->single.handle
     chrc = BLEProfileManager::instance()->characteristic(bleDevice, params->single.handle);
+    if (NULL == chrc)  // KW issue: may be NULL and will be dereferenced
+    {
+        return BT_GATT_ITER_STOP;
+    }
     
-    if (chrc)  // KW issue: may be NULL and will be dereferenced
-      chrc->setValue((const unsigned char *)data, length);
+    // An error comes with no data. Still end the read, or it never ends
+    if (0 == err && (NULL != data || 0 == length))
+    {
+        chrc->setValue((const unsigned char *)data, length);
+    }
+    chrc->readComplete(err ? err : ((NULL == data && 0 != length) ? -EIO : 0));
     pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
     return BT_GATT_ITER_STOP;
 }
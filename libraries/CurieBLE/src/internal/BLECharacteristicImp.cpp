@@ -21,13 +21,35 @@
 #include "BLEAttribute.h"
 #include "BLEServiceImp.h"
 #include "BLECharacteristicImp.h"
+#include "BLEProfileManager.h"
 
 #include "BLECallbacks.h"
 #include "BLEUtils.h"
 
+// Only in a rebuilt libarc32drv; without it queued values are copied
+extern "C" int bt_gatt_notify_ref(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                  const void *data, uint16_t len,
+                                  bt_gatt_notify_sent_func_t cb,
+                                  void (*release)(void *), void *release_arg) __attribute__((weak));
+// Likewise; without it a write command completes once it is handed over
+extern "C" int bt_gatt_write_without_response_cb(struct bt_conn *conn, uint16_t handle,
+                                                 const void *data, uint16_t length,
+                                                 bt_gatt_write_rsp_func_t func) __attribute__((weak));
+
 bt_uuid_16_t BLECharacteristicImp::_gatt_chrc_uuid = {BT_UUID_TYPE_16, BT_UUID_GATT_CHRC_VAL};
 bt_uuid_16_t BLECharacteristicImp::_gatt_ccc_uuid = {BT_UUID_TYPE_16, BT_UUID_GATT_CCC_VAL};
-volatile bool BLECharacteristicImp::_gattc_writing = false;
+BLECharacteristicImp::WriteSlot BLECharacteristicImp::_write_slots[BLE_WRITE_QUEUE_DEPTH_CFG];
+uint16_t BLECharacteristicImp::_write_seq = 0;
+volatile int BLECharacteristicImp::_write_in_flight = 0;
+volatile bool BLECharacteristicImp::_write_pumping = false;
+BLECharacteristicImp* BLECharacteristicImp::_notify_waiting = NULL;
+BLECharacteristicImp* BLECharacteristicImp::_notify_waiting_tail = NULL;
+volatile int BLECharacteristicImp::_notify_in_flight = 0;
+volatile bool BLECharacteristicImp::_notify_pumping = false;
+#if BLE_COMPACT_PROFILE_CFG
+unsigned char* BLECharacteristicImp::_shared_buffer = NULL;
+BLECharacteristicImp* BLECharacteristicImp::_shared_buffer_owner = NULL;
+#endif
 
 BLECharacteristicImp::BLECharacteristicImp(const bt_uuid_t* uuid, 
                                            unsigned char properties,
@@ -37,14 +59,27 @@ BLECharacteristicImp::BLECharacteristicImp(const bt_uuid_t* uuid,
     _value_length(0),
     _value_buffer(NULL),
     _value_updated(false),
+    _value_const(false),
+    _value_user(false),
     _value_handle(handle),
     _cccd_handle(0),
+    _descriptors_pending(false),
     _attr_chrc_value(NULL),
     _attr_cccd(NULL),
     _subscribed(false),
     _reading(false),
+    _read_err(0),
+    _read_complete_handler(NULL),
+    _write_coalesce(false),
+    _notify_queue(NULL),
+    _notify_head(0),
+    _notify_count(0),
+    _notify_next(NULL),
+    _notify_coalesce(false),
+    _notify_latest(false),
     _ble_device()
 {
+    memset((void *)_notify_refs, 0, sizeof(_notify_refs));
     _value_size = BLE_MAX_ATTR_DATA_LEN;// Set as MAX value. TODO: long read/write need to twist
     _value = (unsigned char*)malloc(_value_size);
 
@@ -94,8 +129,9 @@ BLECharacteristicImp::BLECharacteristicImp(const bt_uuid_t* uuid,
         _sub_params.value |= BT_GATT_CCC_INDICATE;
     }
     _gatt_chrc.uuid = (bt_uuid_t*)this->bt_uuid();//&_characteristic_uuid;//this->uuid();
-    memset(_event_handlers, 0, sizeof(_event_handlers));
-    memset(_oldevent_handlers, 0, sizeof(_oldevent_handlers));
+    _event_handlers = (EventHandlers_t*)NULL;
+    _write_stream_handler = NULL;
+    _read_stream_handler = NULL;
     
     _sub_params.notify = profile_notify_process;
         
@@ -111,24 +147,73 @@ BLECharacteristicImp::BLECharacteristicImp(BLECharacteristic& characteristic,
     _value_length(0),
     _value_buffer(NULL),
     _value_updated(false),
+    _value_const(false),
+    _value_user(false),
     _value_handle(0),
     _cccd_handle(0),
+    _descriptors_pending(false),
     _attr_chrc_value(NULL),
     _attr_cccd(NULL),
     _subscribed(false),
     _reading(false),
+    _read_err(0),
+    _read_complete_handler(NULL),
+    _write_coalesce(false),
+    _notify_queue(NULL),
+    _notify_head(0),
+    _notify_count(0),
+    _notify_next(NULL),
+    _notify_coalesce(false),
+    _notify_latest(false),
     _ble_device()
 {
+    memset((void *)_notify_refs, 0, sizeof(_notify_refs));
     unsigned char properties = characteristic._properties;
+    _notify_coalesce = characteristic._notify_coalesce;
+    _notify_latest = characteristic._notify_latest;
     _value_size = characteristic._value_size;
-    _value = (unsigned char*)malloc(_value_size);
-    if (_value == NULL)
+    _write_stream_handler = characteristic._write_stream_handler;
+    _read_stream_handler = characteristic._read_stream_handler;
+    // Streamed writes need no staging buffer, and a fully streamed
+    // characteristic no value copy either
+    if (NULL != characteristic._const_value)
+    {
+        // Read only, served from the sketch's constant
+        _value = (unsigned char*)characteristic._const_value;
+        _value_length = _value_size;
+        _value_const = true;
+    }
+    else if (NULL != characteristic._user_value)
     {
-        errno = ENOMEM;
+        // Served from and written to the sketch's storage in place
+        _value = characteristic._user_value;
+        _value_length = _value_size;
+        _value_user = true;
+    }
+    else if (NULL == _write_stream_handler || NULL == _read_stream_handler)
+    {
+        _value = (unsigned char*)malloc(_value_size);
+        if (_value == NULL)
+        {
+            errno = ENOMEM;
+        }
+    }
+    else
+    {
+        _value = (unsigned char*)NULL;
     }
-    if (_value_size > BLE_MAX_ATTR_DATA_LEN)
+    if (_value_size > BLE_MAX_ATTR_DATA_LEN &&
+        NULL == _write_stream_handler &&
+        false == _value_const)
     {
+#if BLE_COMPACT_PROFILE_CFG
+        if (NULL == _shared_buffer)
+        {
+            _shared_buffer = (unsigned char*)malloc(BLE_MAX_ATTR_LONGDATA_LEN);
+        }
+#else
         _value_buffer = (unsigned char*)malloc(_value_size);
+#endif
     }
     
     memset(&_ccc_cfg, 0, sizeof(_ccc_cfg));
@@ -163,12 +248,26 @@ BLECharacteristicImp::BLECharacteristicImp(BLECharacteristic& characteristic,
     }
     _gatt_chrc.uuid = (bt_uuid_t*)this->bt_uuid();//&_characteristic_uuid;//this->uuid();
 
-    memcpy(_event_handlers, characteristic._event_handlers, sizeof(_event_handlers));
-    memcpy(_oldevent_handlers, characteristic._oldevent_handlers, sizeof(_oldevent_handlers));
+    _event_handlers = (EventHandlers_t*)NULL;
+    for (int i = 0; i < BLECharacteristicEventLast; i++)
+    {
+        if (NULL != characteristic._event_handlers[i] ||
+            NULL != characteristic._oldevent_handlers[i])
+        {
+            if (NULL != eventHandlers())
+            {
+                memcpy(_event_handlers->handlers, characteristic._event_handlers, 
+                       sizeof(_event_handlers->handlers));
+                memcpy(_event_handlers->oldhandlers, characteristic._oldevent_handlers, 
+                       sizeof(_event_handlers->oldhandlers));
+            }
+            break;
+        }
+    }
     
     _sub_params.notify = profile_notify_process;
     
-    if (NULL != characteristic._value)
+    if (NULL != characteristic._value && NULL != _value && false == _value_const)
     {
         memcpy(_value, characteristic._value, _value_size);
         _value_length = _value_size;
@@ -183,18 +282,62 @@ BLECharacteristicImp::BLECharacteristicImp(BLECharacteristic& characteristic,
 
 BLECharacteristicImp::~BLECharacteristicImp()
 {
+    uint32_t saved = interrupt_lock();
+    BLECharacteristicImp **link = &_notify_waiting;
+    BLECharacteristicImp *prev = NULL;
+    while (*link != NULL && *link != this)
+    {
+        prev = *link;
+        link = &prev->_notify_next;
+    }
+    if (*link == this)
+    {
+        *link = _notify_next;
+        if (_notify_waiting_tail == this)
+        {
+            _notify_waiting_tail = prev;
+        }
+    }
+    interrupt_unlock(saved);
+    if (_notify_queue)
+    {
+        // Let the IPC UART finish with slots sent in place; it only stalls
+        // if the BLE core stopped taking data
+        uint64_t start = millis();
+        for (int i = 0; i < BLE_NOTIFY_QUEUE_DEPTH_CFG; i++)
+        {
+            while (_notify_refs[i] > 0 && millis() - start < 100)
+            {
+                BLEUtils::waitForEvent();
+            }
+        }
+        free(_notify_queue);
+        _notify_queue = (unsigned char *)NULL;
+    }
+    
     releaseDescriptors();
-    if (_value)
+    if (_value && false == _value_const && false == _value_user)
     {
         free(_value);
-        _value = (unsigned char *)NULL;
     }
+    _value = (unsigned char *)NULL;
     
     if (_value_buffer)
     {
         free(_value_buffer);
         _value_buffer = (unsigned char *)NULL;
     }
+#if BLE_COMPACT_PROFILE_CFG
+    if (_shared_buffer_owner == this)
+    {
+        _shared_buffer_owner = NULL;
+    }
+#endif
+    if (_event_handlers)
+    {
+        free(_event_handlers);
+        _event_handlers = (EventHandlers_t*)NULL;
+    }
 }
 
 unsigned char
@@ -208,6 +351,11 @@ bool BLECharacteristicImp::writeValue(const byte value[], int length)
     int status;
     bool retVal = false;
     
+    if (_value_const)
+    {
+        return false;
+    }
+    
     _setValue(value, length, 0);
     
     // Address same is GATT server. Send notification if CCCD enabled
@@ -215,13 +363,17 @@ bool BLECharacteristicImp::writeValue(const byte value[], int length)
     if (true == BLEUtils::isLocalBLE(_ble_device) &&
         NULL != _attr_chrc_value)
     {
+        // Coalesced with the other queued updates, sent as the nRF core
+        // frees buffers; a full queue falls back to sending at once
+        if (_notify_coalesce &&
+            (_ccc_value.value & BT_GATT_CCC_NOTIFY) &&
+            queueNotification(value, length))
+        {
+            return true;
+        }
         // Notify for peripheral.
-        status = bt_gatt_notify(NULL, _attr_chrc_value, value, length, NULL);
-    // Sid.  KW found status is always 0
-    //        if (!status)
-    //        {
-            retVal = true;
-    //        }
+        status = sendNotification(value, length);
+        retVal = (status >= 0);
     }
     
     //Not schedule write request for central
@@ -235,6 +387,11 @@ bool BLECharacteristicImp::writeValue(const byte value[], int length, int offset
     int status;
     bool retVal = false;
     
+    if (_value_const)
+    {
+        return false;
+    }
+    
     _setValue(value, length, offset);
     
     // Address same is GATT server. Send notification if CCCD enabled
@@ -243,12 +400,8 @@ bool BLECharacteristicImp::writeValue(const byte value[], int length, int offset
         NULL != _attr_chrc_value)
     {
         // Notify for peripheral.
-        status = bt_gatt_notify(NULL, _attr_chrc_value, value, length, NULL);
-	// Sid.  KW found status is always 0.
-	//        if (!status)
-	//        {
-            retVal = true;
-	//        }
+        status = sendNotification(value, length);
+        retVal = (status >= 0);
     }
     
     //Not schedule write request for central
@@ -257,54 +410,322 @@ bool BLECharacteristicImp::writeValue(const byte value[], int length, int offset
     return retVal;
 }
 
+bool BLECharacteristicImp::notifyAsync(const byte value[], int length)
+{
+    if (false == BLEUtils::isLocalBLE(_ble_device) ||
+        NULL == _attr_chrc_value ||
+        0 == (_ccc_value.value & BT_GATT_CCC_NOTIFY))
+    {
+        return false;
+    }
+    
+    _setValue(value, length, 0);
+    return queueNotification(value, length);
+}
+
+bool BLECharacteristicImp::notifyValue()
+{
+    if (NULL == _value || _value_const ||
+        false == BLEUtils::isLocalBLE(_ble_device) ||
+        NULL == _attr_chrc_value)
+    {
+        return false;
+    }
+    if (_notify_coalesce &&
+        (_ccc_value.value & BT_GATT_CCC_NOTIFY) &&
+        queueNotification(_value, _value_length))
+    {
+        return true;
+    }
+    return (sendNotification(_value, _value_length) >= 0);
+}
+
+bool BLECharacteristicImp::queueNotification(const byte value[], int length)
+{
+    if (NULL == _notify_queue)
+    {
+        _notify_queue = (unsigned char*)malloc(BLE_NOTIFY_QUEUE_DEPTH_CFG * 
+                                               BLE_MAX_ATTR_DATA_LEN);
+        if (NULL == _notify_queue)
+        {
+            errno = ENOMEM;
+            return false;
+        }
+    }
+    
+    if (length > BLE_MAX_ATTR_DATA_LEN)
+    {
+        length = BLE_MAX_ATTR_DATA_LEN;
+    }
+    
+    uint32_t saved = interrupt_lock();
+    if (_notify_latest && _notify_count > 0)
+    {
+        // Latest value wins: overwrite the newest value not yet sent; the
+        // pump takes its reference before it lets go of the lock
+        uint8_t last = (_notify_head + _notify_count - 1) % BLE_NOTIFY_QUEUE_DEPTH_CFG;
+        if (_notify_refs[last] == 0)
+        {
+            memcpy(_notify_queue + last * BLE_MAX_ATTR_DATA_LEN, value, length);
+            _notify_len[last] = length;
+            interrupt_unlock(saved);
+            return true;
+        }
+    }
+    uint8_t slot = (_notify_head + _notify_count) % BLE_NOTIFY_QUEUE_DEPTH_CFG;
+    if (_notify_count == BLE_NOTIFY_QUEUE_DEPTH_CFG || _notify_refs[slot] > 0)
+    {
+        // Full, or the slot is still going out on the IPC UART
+        interrupt_unlock(saved);
+        return false;
+    }
+    memcpy(_notify_queue + slot * BLE_MAX_ATTR_DATA_LEN, value, length);
+    _notify_len[slot] = length;
+    if (_notify_count++ == 0)
+    {
+        _notify_next = NULL;
+        if (_notify_waiting_tail)
+        {
+            _notify_waiting_tail->_notify_next = this;
+        }
+        else
+        {
+            _notify_waiting = this;
+        }
+        _notify_waiting_tail = this;
+    }
+    interrupt_unlock(saved);
+    
+    pumpNotifications();
+    return true;
+}
+
+bool BLECharacteristicImp::canNotifyNow()
+{
+    return (true == BLEUtils::isLocalBLE(_ble_device) &&
+            NULL != _attr_chrc_value &&
+            (_ccc_value.value & BT_GATT_CCC_NOTIFY) &&
+            _notify_count == 0 &&
+            _notify_waiting == NULL &&
+            _notify_in_flight < BLE_MAX_NOTIFY_IN_FLIGHT_CFG);
+}
+
+int BLECharacteristicImp::sendNotification(const byte value[], int length)
+{
+    // Count the notification before sending it, so that its confirmation
+    // can't arrive before the count; a server has at most one central.
+    uint32_t saved = interrupt_lock();
+    _notify_in_flight++;
+    interrupt_unlock(saved);
+    
+    int status = bt_gatt_notify(NULL, _attr_chrc_value, value, length, 
+                                notificationSent);
+    int sent = notificationsSent(status);
+    if (sent != 1)
+    {
+        saved = interrupt_lock();
+        _notify_in_flight += sent - 1;
+        interrupt_unlock(saved);
+    }
+    return status;
+}
+
+int BLECharacteristicImp::notificationsSent(int status)
+{
+    // How many notificationSent() calls a bt_gatt_notify() will bring. A
+    //  libarc32drv without bt_gatt_notify_ref() predates the count and
+    //  returns 0 however many it sent; it sends to the central if subscribed
+    if (status != 0 || bt_gatt_notify_ref)
+    {
+        return (status > 0 ? status : 0);
+    }
+    return (_ccc_value.value & BT_GATT_CCC_NOTIFY) ? 1 : 0;
+}
+
+int BLECharacteristicImp::sendNotificationSlot(uint8_t slot)
+{
+    // As sendNotification(), without copying the slot into the RPC buffer.
+    // The caller has counted it in flight and taken an extra reference,
+    // which keeps the count above 0 until every frame the call produced has
+    // been added, however early they are released. bt_gatt_notify() has
+    // copied the value by the time it returns, so it holds no references.
+    const byte *value = _notify_queue + slot * BLE_MAX_ATTR_DATA_LEN;
+    int status;
+    if (bt_gatt_notify_ref)
+    {
+        status = bt_gatt_notify_ref(NULL, _attr_chrc_value,
+                                    value, _notify_len[slot], notificationSent,
+                                    notifySlotReleased,
+                                    (void *)&_notify_refs[slot]);
+    }
+    else
+    {
+        status = bt_gatt_notify(NULL, _attr_chrc_value,
+                                value, _notify_len[slot], notificationSent);
+    }
+    int sent = notificationsSent(status);
+    uint32_t saved = interrupt_lock();
+    _notify_refs[slot] += (bt_gatt_notify_ref ? sent : 0) - 1;
+    if (sent != 1)
+    {
+        _notify_in_flight += sent - 1;
+    }
+    interrupt_unlock(saved);
+    return status;
+}
+
+void BLECharacteristicImp::notifySlotReleased(void *refs)
+{
+    // From the IPC UART TX interrupt
+    (*(volatile int8_t *)refs)--;
+}
+
+void BLECharacteristicImp::pumpNotifications()
+{
+    uint32_t saved = interrupt_lock();
+    if (_notify_pumping)
+    {
+        // The running pump re-checks the in-flight count before it stops
+        interrupt_unlock(saved);
+        return;
+    }
+    _notify_pumping = true;
+    
+    while (_notify_waiting != NULL &&
+           _notify_in_flight < BLE_MAX_NOTIFY_IN_FLIGHT_CFG)
+    {
+        BLECharacteristicImp *chrc = _notify_waiting;
+        uint8_t slot = chrc->_notify_head;
+        _notify_in_flight++;
+        chrc->_notify_refs[slot]++;
+        interrupt_unlock(saved);
+        
+        chrc->sendNotificationSlot(slot);
+        
+        saved = interrupt_lock();
+        if (_notify_waiting != chrc || chrc->_notify_count == 0)
+        {
+            // Flushed by a disconnect meanwhile
+            continue;
+        }
+        chrc->_notify_head = (slot + 1) % BLE_NOTIFY_QUEUE_DEPTH_CFG;
+        _notify_waiting = chrc->_notify_next;
+        if (_notify_waiting == NULL)
+        {
+            _notify_waiting_tail = NULL;
+        }
+        chrc->_notify_next = NULL;
+        if (--chrc->_notify_count)
+        {
+            // Round robin: back of the line with its remaining values
+            if (_notify_waiting_tail)
+            {
+                _notify_waiting_tail->_notify_next = chrc;
+            }
+            else
+            {
+                _notify_waiting = chrc;
+            }
+            _notify_waiting_tail = chrc;
+        }
+    }
+    
+    _notify_pumping = false;
+    interrupt_unlock(saved);
+}
+
+void BLECharacteristicImp::notificationSent(bt_conn_t *conn,
+                                            bt_gatt_attr_t *attr,
+                                            uint8_t err)
+{
+    // The nRF core has freed the buffer, whether it was sent or not
+    uint32_t saved = interrupt_lock();
+    if (_notify_in_flight > 0)
+    {
+        _notify_in_flight--;
+    }
+    interrupt_unlock(saved);
+    
+    pumpNotifications();
+}
+
+void BLECharacteristicImp::flushNotifications()
+{
+    uint32_t saved = interrupt_lock();
+    while (_notify_waiting != NULL)
+    {
+        BLECharacteristicImp *chrc = _notify_waiting;
+        _notify_waiting = chrc->_notify_next;
+        chrc->_notify_next = NULL;
+        chrc->_notify_head = 0;
+        chrc->_notify_count = 0;
+    }
+    _notify_waiting_tail = NULL;
+    _notify_in_flight = 0;
+    interrupt_unlock(saved);
+}
+
+void BLECharacteristicImp::discardPreparedWrite()
+{
+#if BLE_COMPACT_PROFILE_CFG
+    _shared_buffer_owner = NULL;
+#endif
+}
+
 bool
 BLECharacteristicImp::setValue(const unsigned char value[], uint16_t length)
 {
     _setValue(value, length, 0);
+    valueChanged();
+    return true;
+}
+
+void
+BLECharacteristicImp::valueChanged()
+{
     _value_updated = true;
+    const EventHandlers_t* handlers = _event_handlers;
+    if (NULL == handlers)
+    {
+        return;
+    }
     if (BLEUtils::isLocalBLE(_ble_device) == true)
     {
         // GATT server
         // Write request for GATT server
-        if (_event_handlers[BLEWritten]) 
+        if (handlers->handlers[BLEWritten]) 
         {
             BLECharacteristic chrcTmp(this, &_ble_device);
-            _event_handlers[BLEWritten](_ble_device, chrcTmp);
+            handlers->handlers[BLEWritten](_ble_device, chrcTmp);
         }
         
-        if (_oldevent_handlers[BLEWritten]) 
+        if (handlers->oldhandlers[BLEWritten]) 
         {
             BLECharacteristic chrcTmp(this, &_ble_device);
             BLECentral central(_ble_device);
-            _oldevent_handlers[BLEWritten](central, chrcTmp);
+            handlers->oldhandlers[BLEWritten](central, chrcTmp);
         }
     }
     else
     {
         // GATT client
         // Discovered attribute
-        // Read response/Notification/Indication for GATT client
-        if (_reading)
-        {
-            // Read response received. Not block the other reading.
-            _reading = false;
-        }
+        // Read response/Notification/Indication for GATT client.
+        //  A read ends in readComplete(), not on a notification
         
-        if (_event_handlers[BLEValueUpdated]) 
+        if (handlers->handlers[BLEValueUpdated]) 
         {
             BLECharacteristic chrcTmp(this, &_ble_device);
-            _event_handlers[BLEValueUpdated](_ble_device, chrcTmp);
+            handlers->handlers[BLEValueUpdated](_ble_device, chrcTmp);
         }
         
-        if (_oldevent_handlers[BLEValueUpdated]) 
+        if (handlers->oldhandlers[BLEValueUpdated]) 
         {
             BLECharacteristic chrcTmp(this, &_ble_device);
             BLECentral central(_ble_device);
-            _oldevent_handlers[BLEValueUpdated](central, chrcTmp);
+            handlers->oldhandlers[BLEValueUpdated](central, chrcTmp);
         }
     }
-    
-    return true;
 }
 
 unsigned short
@@ -328,6 +749,10 @@ BLECharacteristicImp::valueLength() const
 unsigned char
 BLECharacteristicImp::operator[] (int offset) const
 {
+    if (NULL == _value)
+    {
+        return 0;
+    }
     return _value[offset];
 }
 
@@ -451,6 +876,9 @@ bool BLECharacteristicImp::subscribe(void)
         return false;
     }
     
+    // The CCCD handle comes with the descriptors
+    resolveDescriptors();
+    
     if (_gatt_chrc.properties & BT_GATT_CHRC_NOTIFY)
     {
         _sub_params.value |= BT_GATT_CCC_NOTIFY;
@@ -486,26 +914,75 @@ bool BLECharacteristicImp::subscribe(void)
     return _subscribed;
 }
 
+BLECharacteristicImp::EventHandlers_t* BLECharacteristicImp::eventHandlers()
+{
+    if (NULL == _event_handlers)
+    {
+        EventHandlers_t* handlers = (EventHandlers_t*)malloc(sizeof(EventHandlers_t));
+        if (NULL == handlers)
+        {
+            errno = ENOMEM;
+            return NULL;
+        }
+        memset(handlers, 0, sizeof(EventHandlers_t));
+        _event_handlers = handlers;
+    }
+    return _event_handlers;
+}
+
 void
 BLECharacteristicImp::setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandler callback)
 {
-    noInterrupts();
-    if (event < BLECharacteristicEventLast) {
-        _event_handlers[event] = callback;
+    if (event >= BLECharacteristicEventLast || 
+        (NULL == callback && NULL == _event_handlers) ||
+        NULL == eventHandlers())
+    {
+        return;
     }
+    noInterrupts();
+    _event_handlers->handlers[event] = callback;
     interrupts();
 }
 
 void
 BLECharacteristicImp::setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandlerOld callback)
 {
-    noInterrupts();
-    if (event < BLECharacteristicEventLast) {
-        _oldevent_handlers[event] = callback;
+    if (event >= BLECharacteristicEventLast || 
+        (NULL == callback && NULL == _event_handlers) ||
+        NULL == eventHandlers())
+    {
+        return;
     }
+    noInterrupts();
+    _event_handlers->oldhandlers[event] = callback;
+    interrupts();
+}
+
+void
+BLECharacteristicImp::setStreamHandlers(BLECharacteristicWriteStreamHandler writeHandler,
+                                        BLECharacteristicReadStreamHandler readHandler)
+{
+    noInterrupts();
+    _write_stream_handler = writeHandler;
+    _read_stream_handler = readHandler;
+    interrupts();
+}
+
+void
+BLECharacteristicImp::setNotifyCoalescing(bool enable, bool latestOnly)
+{
+    noInterrupts();
+    _notify_coalesce = enable;
+    _notify_latest = latestOnly;
     interrupts();
 }
 
+void
+BLECharacteristicImp::setWriteCoalescing(bool enable)
+{
+    _write_coalesce = enable;
+}
+
 void
 BLECharacteristicImp::setHandle(uint16_t handle)
 {
@@ -561,6 +1038,11 @@ BLEDescriptorImp* BLECharacteristicImp::descriptor(uint16_t handle)
 void
 BLECharacteristicImp::_setValue(const uint8_t value[], uint16_t length, uint16_t offset)
 {
+    if (NULL == _value || _value_const)
+    {
+        // Streamed or constant characteristic
+        return;
+    }
     if (length + offset > _value_size)
     {
         if (_value_size > offset)
@@ -577,8 +1059,12 @@ BLECharacteristicImp::_setValue(const uint8_t value[], uint16_t length, uint16_t
         }
     }
     
-    memcpy(_value + offset, value, length);
-    _value_length = length;
+    if (value != _value + offset)
+    {
+        memcpy(_value + offset, value, length);
+    }
+    // The sketch's storage is always its full size
+    _value_length = _value_user ? _value_size : length;
 }
 
 _bt_gatt_ccc_t* BLECharacteristicImp::getCccCfg(void)
@@ -651,99 +1137,485 @@ bool BLECharacteristicImp::read(bool blocked)
     }
     
     // Send read request
+    _read_err = 0;
+    _reading = true;
     retval = bt_gatt_read(conn, &_read_params);
-    if (0 == retval)
+    bt_conn_unref(conn);
+    if (0 != retval)
     {
-        _reading = true;
-        ret_bool = true;
-        
-        // Block the call
-        if (blocked == true)
+        _reading = false;
+        _read_complete_handler = NULL;
+        return false;
+    }
+    ret_bool = true;
+    
+    // Block the call
+    if (blocked == true)
+    {
+        while (_reading == true && ret_bool)
         {
-            while (_reading == true && ret_bool)
-            {
-                delay(5);
-                ret_bool = _ble_device.connected();
-            }
+            BLEUtils::waitForEvent();
+            ret_bool = _ble_device.connected();
         }
+        ret_bool = ret_bool && (0 == _read_err);
     }
-    bt_conn_unref(conn);
     return ret_bool;
 }
 
+bool BLECharacteristicImp::readAsync(BLECharacteristicReadCompleteHandler callback)
+{
+    if (_reading)
+    {
+        // Already in reading state
+        return false;
+    }
+    // Set before the request, the response may come in at once
+    _read_complete_handler = callback;
+    if (false == read(false))
+    {
+        _read_complete_handler = NULL;
+        return false;
+    }
+    return true;
+}
+
+void BLECharacteristicImp::readComplete(int err)
+{
+    BLECharacteristicReadCompleteHandler handler = _read_complete_handler;
+    
+    _read_complete_handler = NULL;
+    _read_err = err;
+    _reading = false;
+    if (NULL != handler)
+    {
+        BLECharacteristic chrcTmp(this, &_ble_device);
+        handler(_ble_device, chrcTmp, err);
+    }
+}
+
 void BLECharacteristicImp::writeResponseReceived(struct bt_conn *conn, 
                                                  uint8_t err,
                                                  const void *data)
 {
-    _gattc_writing = false;
+    if (NULL == conn)
+    {
+        // The peripheral has gone; flushWrites() fails its writes
+        return;
+    }
+    
+    // data is the slot's, so it tells apart the writes to one peripheral
+    const bt_addr_le_t* peer = bt_conn_get_dst(conn);
+    for (int i = 0; i < BLE_WRITE_QUEUE_DEPTH_CFG; i++)
+    {
+        WriteSlot* slot = &_write_slots[i];
+        uint32_t saved = interrupt_lock();
+        bool match = (NULL != slot->chrc && slot->sent &&
+                      data == slot->data &&
+                      0 == bt_addr_le_cmp(&slot->peer, peer));
+        uint16_t seq = slot->seq;
+        interrupt_unlock(saved);
+        if (match)
+        {
+            finishWrite(i, seq, err);
+            break;
+        }
+    }
 }
 
-bool BLECharacteristicImp::write(const unsigned char value[], 
-                                 uint16_t length)
+int BLECharacteristicImp::queueWrite(const unsigned char value[], 
+                                     uint16_t length,
+                                     BLECharacteristicWriteCompleteHandler callback,
+                                     volatile int* waiter)
 {
-    int retval = 0;
-    bt_conn_t* conn = NULL;
+    bool with_resp;
     
-    if (true == BLEUtils::isLocalBLE(_ble_device) || true == _gattc_writing)
+    if (true == BLEUtils::isLocalBLE(_ble_device) || 0 == _value_handle)
     {
-        // GATT server can't write
-        return false;
+        // GATT server can't write, or discover not complete
+        return -EINVAL;
+    }
+    if (_gatt_chrc.properties & BT_GATT_CHRC_WRITE)
+    {
+        with_resp = true;
+    }
+    else if (_gatt_chrc.properties & BT_GATT_CHRC_WRITE_WITHOUT_RESP)
+    {
+        with_resp = false;
+    }
+    else
+    {
+        return -EINVAL;
+    }
+    if (length > BLE_MAX_ATTR_DATA_LEN && (!with_resp || NULL == waiter))
+    {
+        // Only a write() request waits, and so can leave its buffer with us
+        return -EMSGSIZE;
+    }
+    if (false == _ble_device.connected())
+    {
+        return -ENOTCONN;
     }
     
-    conn = bt_conn_lookup_addr_le(_ble_device.bt_le_address());
-    if (NULL == conn)
+    uint32_t saved = interrupt_lock();
+    WriteSlot* slot = NULL;
+    for (int i = 0; i < BLE_WRITE_QUEUE_DEPTH_CFG; i++)
     {
-        return false;
+        WriteSlot* temp = &_write_slots[i];
+        if (_write_coalesce && NULL == waiter &&
+            this == temp->chrc && !temp->sent && NULL == temp->waiter)
+        {
+            // Latest value wins, in the superseded write's place in line
+            memcpy(temp->value, value, length);
+            temp->length = length;
+            temp->handler = callback;
+            interrupt_unlock(saved);
+            return 0;
+        }
+        if (NULL == slot && NULL == temp->chrc)
+        {
+            slot = temp;
+        }
+    }
+    if (NULL == slot)
+    {
+        interrupt_unlock(saved);
+        return -EAGAIN;
+    }
+    if (length > BLE_MAX_ATTR_DATA_LEN)
+    {
+        slot->data = value;
     }
+    else
+    {
+        memcpy(slot->value, value, length);
+        slot->data = slot->value;
+    }
+    slot->chrc = this;
+    slot->handler = callback;
+    slot->waiter = waiter;
+    memcpy(&slot->peer, _ble_device.bt_le_address(), sizeof(bt_addr_le_t));
+    slot->seq = _write_seq++;
+    slot->length = length;
+    slot->with_resp = with_resp;
+    slot->sent = false;
+    interrupt_unlock(saved);
     
-    // Send write request
-    if (_gatt_chrc.properties & BT_GATT_CHRC_WRITE)
+    pumpWrites();
+    return 0;
+}
+
+int BLECharacteristicImp::nextWrite()
+{
+    // The oldest write first in line for its peripheral. Called locked.
+    int next = -1;
+    for (int i = 0; i < BLE_WRITE_QUEUE_DEPTH_CFG; i++)
     {
-        _gattc_writing = true;
-        retval = bt_gatt_write(conn, 
-                               _value_handle,
-                               0,
-                               value, 
-                               length, 
-                               ble_on_write_no_rsp_complete);
-        while (_gattc_writing)
+        WriteSlot* slot = &_write_slots[i];
+        if (NULL == slot->chrc || slot->sent)
+        {
+            continue;
+        }
+        
+        bool first = true;
+        for (int j = 0; j < BLE_WRITE_QUEUE_DEPTH_CFG && first; j++)
+        {
+            WriteSlot* other = &_write_slots[j];
+            if (j == i || NULL == other->chrc ||
+                0 != bt_addr_le_cmp(&other->peer, &slot->peer))
+            {
+                continue;
+            }
+            // Behind an older write, or a request behind an unanswered one
+            first = (other->sent) ? !(other->with_resp && slot->with_resp)
+                                  : ((int16_t)(other->seq - slot->seq) > 0);
+        }
+        if (first &&
+            (next < 0 || (int16_t)(slot->seq - _write_slots[next].seq) < 0))
         {
-            delay(2);
+            next = i;
         }
-    } else if (_gatt_chrc.properties & BT_GATT_CHRC_WRITE_WITHOUT_RESP)
+    }
+    return next;
+}
+
+void BLECharacteristicImp::pumpWrites()
+{
+    uint32_t saved = interrupt_lock();
+    if (_write_pumping)
     {
-        retval = bt_gatt_write_without_response(conn, 
-                                                _value_handle,
-                                                value, 
-                                                length, 
-                                                false);
+        // The running pump looks for the next write before it stops
+        interrupt_unlock(saved);
+        return;
+    }
+    _write_pumping = true;
+    
+    int index;
+    while (_write_in_flight < BLE_MAX_WRITE_IN_FLIGHT_CFG &&
+           (index = nextWrite()) >= 0)
+    {
+        // Counted in flight before it is sent, the response can beat the
+        // return; what it needs is copied, a disconnect may free the slot
+        WriteSlot* slot = &_write_slots[index];
+        slot->sent = true;
+        _write_in_flight++;
+        uint16_t seq = slot->seq;
+        uint16_t handle = slot->chrc->_value_handle;
+        const unsigned char* data = slot->data;
+        uint16_t length = slot->length;
+        bool with_resp = slot->with_resp;
+        bt_addr_le_t peer = slot->peer;
+        interrupt_unlock(saved);
+        
+        int retval = -ENOTCONN;
+        bool complete = false;
+        bt_conn_t* conn = bt_conn_lookup_addr_le(&peer);
+        if (NULL != conn)
+        {
+            if (with_resp)
+            {
+                retval = bt_gatt_write(conn, handle, 0, data, length,
+                                       ble_on_write_no_rsp_complete);
+            }
+            else if (bt_gatt_write_without_response_cb)
+            {
+                retval = bt_gatt_write_without_response_cb(conn, handle,
+                                                           data, length,
+                                                           ble_on_write_no_rsp_complete);
+            }
+            else
+            {
+                // Copied into the IPC buffer, with no callback to wait for
+                retval = bt_gatt_write_without_response(conn, handle,
+                                                        data, length, false);
+                complete = true;
+            }
+            bt_conn_unref(conn);
+        }
+        if (0 != retval || complete)
+        {
+            finishWrite(index, seq, retval);
+        }
+        
+        saved = interrupt_lock();
+    }
+    
+    _write_pumping = false;
+    interrupt_unlock(saved);
+}
+
+void BLECharacteristicImp::finishWrite(uint8_t index, uint16_t seq, int err)
+{
+    WriteSlot* slot = &_write_slots[index];
+    uint32_t saved = interrupt_lock();
+    BLECharacteristicImp* chrc = slot->chrc;
+    if (NULL == chrc || seq != slot->seq)
+    {
+        // Finished already
+        interrupt_unlock(saved);
+        return;
+    }
+    BLECharacteristicWriteCompleteHandler handler = slot->handler;
+    volatile int* waiter = slot->waiter;
+    if (slot->sent && _write_in_flight > 0)
+    {
+        _write_in_flight--;
+    }
+    slot->chrc = NULL;
+    slot->sent = false;
+    interrupt_unlock(saved);
+    
+    if (NULL != waiter)
+    {
+        *waiter = err;
+    }
+    if (NULL != handler)
+    {
+        BLECharacteristic chrcTmp(chrc, &chrc->_ble_device);
+        handler(chrc->_ble_device, chrcTmp, err);
+    }
+    pumpWrites();
+}
+
+void BLECharacteristicImp::flushWrites(const bt_addr_le_t* peer)
+{
+    // Hold the pump off meanwhile, or it would send the peripheral's next
+    // write only to fail it
+    uint32_t saved = interrupt_lock();
+    bool pumping = _write_pumping;
+    _write_pumping = true;
+    interrupt_unlock(saved);
+    
+    for (int i = 0; i < BLE_WRITE_QUEUE_DEPTH_CFG; i++)
+    {
+        WriteSlot* slot = &_write_slots[i];
+        saved = interrupt_lock();
+        bool match = (NULL != slot->chrc &&
+                      0 == bt_addr_le_cmp(&slot->peer, peer));
+        uint16_t seq = slot->seq;
+        interrupt_unlock(saved);
+        if (match)
+        {
+            finishWrite(i, seq, -ENOTCONN);
+        }
+    }
+    
+    _write_pumping = pumping;
+    if (!pumping)
+    {
+        pumpWrites();
     }
-    bt_conn_unref(conn);
-    return (0 == retval);
+}
+
+bool BLECharacteristicImp::write(const unsigned char value[], 
+                                 uint16_t length)
+{
+    volatile int result = -EINPROGRESS;
+    bool with_resp = (0 == (_gatt_chrc.properties & BT_GATT_CHRC_WRITE)) ? false : true;
+    int retval;
+    
+    // Wait for room in the queue, then for the response to a request
+    while (-EAGAIN == (retval = queueWrite(value, length, NULL,
+                                           with_resp ? &result : NULL)))
+    {
+        BLEUtils::waitForEvent();
+    }
+    if (0 != retval)
+    {
+        return false;
+    }
+    while (with_resp && -EINPROGRESS == result)
+    {
+        BLEUtils::waitForEvent();
+    }
+    return (false == with_resp || 0 == result);
+}
+
+bool BLECharacteristicImp::writeAsync(const unsigned char value[], 
+                                      uint16_t length,
+                                      BLECharacteristicWriteCompleteHandler callback)
+{
+    return (0 == queueWrite(value, length, callback, NULL));
 }
 
 void BLECharacteristicImp::setBuffer(const uint8_t value[], 
                                       uint16_t length, 
                                       uint16_t offset)
 {
-  if ((length + offset > _value_size) ||
-      ((unsigned char *)NULL == _value_buffer)) {
+    if (length + offset > _value_size)
+    {
+        // Ignore the data
+        return;
+    }
+    if (_write_stream_handler)
+    {
+        BLECharacteristic chrcTmp(this, &_ble_device);
+        _write_stream_handler(_ble_device, chrcTmp, value, length, offset);
+        return;
+    }
+    unsigned char* buffer = writeBuffer();
+    if ((unsigned char *)NULL == buffer)
+    {
         // Ignore the data
         return;
     }
 
-    memcpy(_value_buffer + offset, value, length);
+    memcpy(buffer + offset, value, length);
+}
+
+// The prepared write staging buffer. A shared one is taken by the first
+//  characteristic written, holding its value, until the write is executed
+//  or cancelled.
+unsigned char* BLECharacteristicImp::writeBuffer()
+{
+#if BLE_COMPACT_PROFILE_CFG
+    if (NULL == _shared_buffer || _value_const ||
+        _value_size <= BLE_MAX_ATTR_DATA_LEN)
+    {
+        return NULL;
+    }
+    if (NULL == _shared_buffer_owner)
+    {
+        _shared_buffer_owner = this;
+        if (_value)
+        {
+            memcpy(_shared_buffer, _value, _value_size);
+        }
+    }
+    return (_shared_buffer_owner == this) ? _shared_buffer : NULL;
+#else
+    return _value_buffer;
+#endif
 }
 
 void BLECharacteristicImp::syncupBuffer2Value()
 {
+    if (_write_stream_handler)
+    {
+        // The chunks are with the handler already
+        valueChanged();
+        return;
+    }
+#if BLE_COMPACT_PROFILE_CFG
+    if (_shared_buffer_owner != this)
+    {
+        return;
+    }
+    setValue(_shared_buffer, _value_size);
+    _shared_buffer_owner = NULL;
+#else
     setValue(_value_buffer, _value_size);
+#endif
 }
 
 void BLECharacteristicImp::discardBuffer()
 {
+    if (_write_stream_handler)
+    {
+        BLECharacteristic chrcTmp(this, &_ble_device);
+        _write_stream_handler(_ble_device, chrcTmp, NULL, 0, 0);
+        return;
+    }
+#if BLE_COMPACT_PROFILE_CFG
+    if (_shared_buffer_owner == this)
+    {
+        _shared_buffer_owner = NULL;
+    }
+#else
   if(_value_buffer)
     memcpy(_value_buffer, _value, _value_size);
+#endif
+}
+
+bool BLECharacteristicImp::writeStreaming() const
+{
+    return (NULL != _write_stream_handler);
+}
+
+bool BLECharacteristicImp::readStreaming() const
+{
+    return (NULL != _read_stream_handler);
+}
+
+int BLECharacteristicImp::readStream(unsigned char buffer[], 
+                                     uint16_t length, 
+                                     uint16_t offset)
+{
+    if (offset > _value_size)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (length > _value_size - offset)
+    {
+        length = _value_size - offset;
+    }
+    
+    BLECharacteristic chrcTmp(this, &_ble_device);
+    int len = _read_stream_handler(_ble_device, chrcTmp, buffer, length, offset);
+    if (len < 0 || len > length)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+    return len;
 }
 
 bool BLECharacteristicImp::longCharacteristic()
@@ -1000,6 +1872,15 @@ bool BLECharacteristicImp::discoverAttributes(BLEDevice* device)
     return true;
 }
 
+void BLECharacteristicImp::resolveDescriptors()
+{
+    if (_descriptors_pending &&
+        BLEProfileManager::instance()->discoverDescriptors(_ble_device, this))
+    {
+        _descriptors_pending = false;
+    }
+}
+
 bool BLECharacteristicImp::isClientCharacteristicConfigurationDescriptor(const bt_uuid_t* uuid)
 {
     bool ret = false;
@@ -35,7 +35,7 @@ class BLEDescriptorImp;
 /**
  * BLE GATT Characteristic  : public BLEAttribute 
  */
-class BLECharacteristicImp: public BLEAttribute{
+class BLECharacteristicImp: public BLEAttribute, public PoolAllocated<BLECharacteristicImp, 6>{
 public:
     
     virtual ~BLECharacteristicImp();
@@ -73,6 +73,52 @@ public:
     bool writeValue(const byte value[], int length);
     bool writeValue(const byte value[], int length, int offset);
 
+    /**
+     * @brief   Queue a notification of the value to the subscribed central
+     *
+     * @param   value   The value buffer, copied. At most
+     *                  BLE_MAX_ATTR_DATA_LEN bytes are notified
+     *
+     * @param   length  The value buffer's length
+     *
+     * @return  bool    true - Queued, false - Not subscribed or queue full
+     *
+     * @note  GATT server only. Up to BLE_NOTIFY_QUEUE_DEPTH_CFG values wait
+     *        here while BLE_MAX_NOTIFY_IN_FLIGHT_CFG notifications are in
+     *        the nRF core; each confirmation from it sends the next one.
+     */
+    bool notifyAsync(const byte value[], int length);
+    
+    /**
+     * @brief   Notify the value as it is, see BLECharacteristic::notifyValue()
+     *
+     * @return  bool    true - Success, false - Failed
+     */
+    bool notifyValue();
+
+    /**
+     * @brief   Would notifyAsync() hand the value to the nRF core at once
+     *
+     * @return  bool    true - Yes, false - It would queue it or fail
+     *
+     * @note  GATT server only
+     */
+    bool canNotifyNow();
+
+    /**
+     * @brief   Drop all queued notifications and the in-flight count
+     *
+     * @note  Called when the central disconnects
+     */
+    static void flushNotifications();
+    
+    /**
+     * @brief   Free the shared prepared write buffer of a write never executed
+     *
+     * @note  Called when the central disconnects
+     */
+    static void discardPreparedWrite();
+
     /**
      * Set the current value of the Characteristic
      *
@@ -142,6 +188,9 @@ public:
      */
     void setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandler callback);
     void setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandlerOld callback);
+    void setStreamHandlers(BLECharacteristicWriteStreamHandler writeHandler,
+                           BLECharacteristicReadStreamHandler readHandler);
+    void setNotifyCoalescing(bool enable, bool latestOnly);
     
     /**
      * @brief   Schedule the read request to read the characteristic in peripheral
@@ -155,6 +204,28 @@ public:
      */
     bool read(bool blocked = true);
     
+    /**
+     * @brief   Schedule the read request, calling callback when it completes
+     *
+     * @param[in]   callback    The completion handler, may be NULL
+     *
+     * @return  bool    Indicate the request was sent
+     *
+     * @note  Only for GATT client
+     */
+    bool readAsync(BLECharacteristicReadCompleteHandler callback);
+    
+    /**
+     * @brief   The read response, or its error, came in
+     *
+     * @param[in]   err     0 or the ATT error
+     *
+     * @return  none
+     *
+     * @note  Called from the BLE interrupt, after the value is set
+     */
+    void readComplete(int err);
+    
     /**
      * @brief   Schedule the write request to update the characteristic in peripheral
      *
@@ -169,6 +240,33 @@ public:
     bool write(const unsigned char value[], 
                uint16_t length);
     
+    /**
+     * @brief   Queue a write to the characteristic in peripheral
+     *
+     * @param[in]   value       The value, copied. At most BLE_MAX_ATTR_DATA_LEN bytes
+     * @param[in]   length      Length, in bytes, of the value
+     * @param[in]   callback    The completion handler, may be NULL
+     *
+     * @return  bool    true - Queued, false - Not connected, too long or
+     *                  the queue is full
+     *
+     * @note  Only for GATT client
+     */
+    bool writeAsync(const unsigned char value[], 
+                    uint16_t length,
+                    BLECharacteristicWriteCompleteHandler callback);
+    
+    void setWriteCoalescing(bool enable);
+    
+    /**
+     * @brief   Fail the queued and unanswered writes to a peripheral
+     *
+     * @param[in]   peer    The peripheral's address
+     *
+     * @note  Called when the peripheral disconnects, before its profile goes
+     */
+    static void flushWrites(const bt_addr_le_t* peer);
+    
     static void writeResponseReceived(struct bt_conn *conn, 
                                       uint8_t err,
                                       const void *data);
@@ -183,6 +281,17 @@ public:
     BLEDescriptorImp* descrptor(const bt_uuid_t* uuid);
     BLEDescriptorImp* descrptor(const char* uuid);
     BLEDescriptorImp* descrptor(int index);
+    
+    /**
+     * @brief   Discover the descriptors left out by lazy discovery
+     *
+     * @param   none
+     *
+     * @return  none
+     *
+     * @note  GATT client only. Blocks until the peer has answered
+     */
+    void resolveDescriptors();
 
 protected:
     friend class BLEProfileManager;
@@ -209,6 +318,14 @@ protected:
                                      const struct bt_gatt_attr *attr,
                                      const void *buf, uint16_t len,
                                      uint16_t offset);
+    friend ssize_t profile_write_process(bt_conn_t *conn,
+                                         const bt_gatt_attr_t *attr,
+                                         const void *buf, uint16_t len,
+                                         uint16_t offset);
+    friend ssize_t profile_read_process(bt_conn_t *conn,
+                                        const bt_gatt_attr_t *attr,
+                                        void *buf, uint16_t len,
+                                        uint16_t offset);
     
     int updateProfile(bt_gatt_attr_t *attr_start, int& index);
     
@@ -221,6 +338,11 @@ protected:
                    uint16_t offset);
     void discardBuffer();
     void syncupBuffer2Value();
+    bool writeStreaming() const;
+    bool readStreaming() const;
+    int readStream(unsigned char buffer[], 
+                   uint16_t length, 
+                   uint16_t offset);
     
     /**
      * @brief   Get the characteristic value handle
@@ -298,11 +420,35 @@ protected:
    bt_gatt_subscribe_params_t* getSubscribeParams();
 
 private:
+    // Allocated with the first handler set; most characteristics have none
+    typedef struct {
+        BLECharacteristicEventHandler    handlers[BLECharacteristicEventLast];
+        BLECharacteristicEventHandlerOld oldhandlers[BLECharacteristicEventLast];
+    }EventHandlers_t;
     
     void setCCCDHandle(uint16_t handle);
     void setHandle(uint16_t handle);
     void _setValue(const uint8_t value[], uint16_t length, uint16_t offset);
+    void valueChanged();
+    EventHandlers_t* eventHandlers();
+    unsigned char* writeBuffer();
     bool isClientCharacteristicConfigurationDescriptor(const bt_uuid_t* uuid);
+    int sendNotification(const byte value[], int length);
+    int notificationsSent(int status);
+    bool queueNotification(const byte value[], int length);
+    int sendNotificationSlot(uint8_t slot);
+    static void notifySlotReleased(void *refs);
+    static void pumpNotifications();
+    int queueWrite(const unsigned char value[], 
+                   uint16_t length,
+                   BLECharacteristicWriteCompleteHandler callback,
+                   volatile int* waiter);
+    static void pumpWrites();
+    static void finishWrite(uint8_t index, uint16_t seq, int err);
+    static int nextWrite();
+    static void notificationSent(bt_conn_t *conn,
+                                 bt_gatt_attr_t *attr,
+                                 uint8_t err);
 
 private:
     // Those 2 UUIDs are used for define the characteristic.
@@ -314,10 +460,19 @@ private:
     unsigned char* _value;
     unsigned char* _value_buffer;
     bool _value_updated;
+    bool _value_const;  // _value is the sketch's, see BLECharacteristic::setConstantValue()
+    bool _value_user;   // _value is the sketch's, see BLECharacteristic::setValueStorage()
+#if BLE_COMPACT_PROFILE_CFG
+    // One prepared write at a time, staged in a buffer shared by all
+    // long characteristics
+    static unsigned char* _shared_buffer;
+    static BLECharacteristicImp* _shared_buffer_owner;
+#endif
 
     uint16_t            _value_handle; // GATT client only
     uint16_t            _cccd_handle;  // GATT client only
     bt_gatt_discover_params_t _discover_params;// GATT client only
+    bool                _descriptors_pending; // GATT client, lazy discovery
     
     bt_gatt_ccc_cfg_t   _ccc_cfg;
     _bt_gatt_ccc_t      _ccc_value;
@@ -331,15 +486,57 @@ private:
     bool        _subscribed;
     
     volatile bool _reading;
-    static volatile bool _gattc_writing;
+    volatile int _read_err;
+    BLECharacteristicReadCompleteHandler _read_complete_handler;
+
+    // GATT client writes, over all peripherals. A peripheral's writes go
+    // out in the order queued: a write request once the previous one is
+    // answered, a command whenever fewer than BLE_MAX_WRITE_IN_FLIGHT_CFG
+    // writes are with the nRF core. A slot's data is its value, or the
+    // buffer of a long write() waiting for the response.
+    typedef struct {
+        BLECharacteristicImp* chrc; // NULL - free
+        BLECharacteristicWriteCompleteHandler handler;
+        volatile int* waiter;       // write()'s result, or NULL
+        const unsigned char* data;
+        bt_addr_le_t peer;
+        uint16_t    seq;
+        uint16_t    length;
+        bool        with_resp;
+        bool        sent;
+        unsigned char value[BLE_MAX_ATTR_DATA_LEN];
+    } WriteSlot;
+    static WriteSlot _write_slots[BLE_WRITE_QUEUE_DEPTH_CFG];
+    static uint16_t _write_seq;
+    static volatile int _write_in_flight;
+    static volatile bool _write_pumping;
+    bool        _write_coalesce;   // writeAsync() replaces a queued value
+
+    // notifyAsync() queue: a ring of BLE_MAX_ATTR_DATA_LEN byte slots,
+    // allocated on first use. Characteristics with queued values are
+    // linked on _notify_waiting and served round robin. Slots are sent in
+    // place; _notify_refs counts the IPC frames still reading each one.
+    unsigned char* _notify_queue;
+    uint8_t     _notify_len[BLE_NOTIFY_QUEUE_DEPTH_CFG];
+    volatile int8_t _notify_refs[BLE_NOTIFY_QUEUE_DEPTH_CFG];
+    uint8_t     _notify_head;
+    uint8_t     _notify_count;
+    BLECharacteristicImp* _notify_next;
+    bool        _notify_coalesce;   // writeValue() notifies through the queue
+    bool        _notify_latest;     // a new value replaces the unsent newest
+    static BLECharacteristicImp* _notify_waiting;
+    static BLECharacteristicImp* _notify_waiting_tail;
+    static volatile int _notify_in_flight;
+    static volatile bool _notify_pumping;
     bt_gatt_read_params_t _read_params; // GATT read parameter
     
-    typedef LinkNode<BLEDescriptorImp *>  BLEDescriptorLinkNodeHeader;
+    typedef LinkList<BLEDescriptorImp *>  BLEDescriptorLinkNodeHeader;
     typedef LinkNode<BLEDescriptorImp *>* BLEDescriptorNodePtr;
     typedef LinkNode<BLEDescriptorImp *>  BLEDescriptorNode;
         
-    BLECharacteristicEventHandler _event_handlers[BLECharacteristicEventLast];
-    BLECharacteristicEventHandlerOld  _oldevent_handlers[BLECharacteristicEventLast];
+    EventHandlers_t* _event_handlers;
+    BLECharacteristicWriteStreamHandler _write_stream_handler;
+    BLECharacteristicReadStreamHandler _read_stream_handler;
     BLEDescriptorLinkNodeHeader  _descriptors_header;
     BLEDevice   _ble_device;
 };
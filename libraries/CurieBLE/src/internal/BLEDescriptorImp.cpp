@@ -214,7 +214,7 @@ bool BLEDescriptorImp::read()
     // Block the read
     while (_reading == true && ret_bool)
     {
-        delay(5);
+        BLEUtils::waitForEvent();
         ret_bool = _bledev.connected();
     }
     return _reading;
@@ -21,11 +21,12 @@
 #define _BLE_DESCRIPTORIMP_H_INCLUDED
 
 #include "CurieBLE.h"
+#include "BlockPool.h"
 
 /**
  * BLE GATT Descriptor class
  */
-class BLEDescriptorImp: public BLEAttribute{
+class BLEDescriptorImp: public BLEAttribute, public PoolAllocated<BLEDescriptorImp, 4>{
 public:
     /**
      * Constructor for BLE Descriptor
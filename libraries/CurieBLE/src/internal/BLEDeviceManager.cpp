@@ -16,6 +16,8 @@
   License along with this library; if not, write to the Free Software
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
+#include <errno.h>
+
 #include "CurieBLE.h"
 #include "BLEDeviceManager.h"
 #include "BLEProfileManager.h"
@@ -27,21 +29,43 @@
 
 #include "BLEUtils.h"
 #include "BLECallbacks.h"
+#include "BLECharacteristicImp.h"
+
+// Defined by libarc32drv builds that bring the BLE core up in the background
+extern "C" void ble_cfw_service_wait(void) __attribute__((weak));
+// Only in a rebuilt libarc32drv; without it an update restarts advertising
+extern "C" int bt_le_adv_update(const struct bt_data *ad, size_t ad_len,
+                                const struct bt_data *sd, size_t sd_len) __attribute__((weak));
 
 BLEDeviceManager* BLEDeviceManager::_instance;
 
+// Early scan filters, bits of _scan_filters. SCAN_FILTER_CRITICAL only
+//  reports what advertiseDataProc() matched; it is set by setAdvertiseCritical
+#define SCAN_FILTER_CRITICAL        0x01
+#define SCAN_FILTER_NAME            0x02
+#define SCAN_FILTER_MANUFACTURER    0x04
+#define SCAN_FILTER_RSSI            0x08
+#define SCAN_FILTER_AD_FIELDS       (SCAN_FILTER_CRITICAL | SCAN_FILTER_NAME | SCAN_FILTER_MANUFACTURER)
+
+// Entries of the duplicate filter looked at for one address
+#define BLE_DUPLICATE_FILTER_PROBE  8
+
 BLEDeviceManager::BLEDeviceManager():
     _min_conn_interval(0),
     _max_conn_interval(0),
+    _peer_adv_next(0),
+    _peer_adv_ready_head(0),
+    _peer_adv_ready_count(0),
     _peer_temp_dev_index(0),
     _adv_critical_local_name(""),
+    _scan_filters(0),
+    _scan_filter_rssi(0),
+    _scan_filter_name(""),
+    _scan_filter_company(0),
     _wait_for_connect_peripheral_adv_data_len(0),
     _wait_for_connect_peripheral_scan_rsp_data_len(0),
     _wait_for_connect_peripheral_adv_rssi(0),
-    _available_for_connect_peripheral_adv_data_len(0),
-    _available_for_connect_peripheral_scan_rsp_data_len(0),
-    _available_for_connect_peripheral_adv_rssi(0),
-    _available_for_connect_peripheral_connectable(false),
+    _available_for_connect_index(BLE_MAX_ADV_BUFFER_CFG),
     _connecting(false),
     _has_service_uuid(false),
     _has_service_solicit_uuid(false),
@@ -49,14 +73,13 @@ BLEDeviceManager::BLEDeviceManager():
     _manufacturer_data_length(0),
     _service_data_length(0),
     _adv_type(0),
+    _adv_data_valid(false),
     _adv_data_idx(0),
     _scan_rsp_data_idx(0),
     _local_name(""),
     _state(BLE_PERIPH_STATE_NOT_READY),
     _local_ble(NULL),
     _peer_peripheral_index(0),
-    _duplicate_filter_header(0),
-    _duplicate_filter_tail(0),
     _adv_duplicate_filter_enabled(false)
 {
     memset(&_local_bda, 0, sizeof(_local_bda));
@@ -85,6 +108,8 @@ BLEDeviceManager::BLEDeviceManager():
     memset(_peer_adv_rssi, 0, sizeof(_peer_adv_rssi));
     
     memset(_peer_adv_connectable, 0, sizeof(_peer_adv_connectable));
+    memset(_peer_adv_ready, 0, sizeof(_peer_adv_ready));
+    memset(_peer_adv_queued, 0, sizeof(_peer_adv_queued));
     
     memset(_peer_temp_adv_buffer, 0, sizeof(_peer_temp_adv_buffer));
     memset(_peer_temp_adv_data, 0, sizeof(_peer_temp_adv_data));
@@ -99,8 +124,7 @@ BLEDeviceManager::BLEDeviceManager():
     memset(&_wait_for_connect_peripheral_adv_data, 0, sizeof(_wait_for_connect_peripheral_adv_data));
     memset(&_wait_for_connect_peripheral_scan_rsp_data, 0, sizeof(_wait_for_connect_peripheral_scan_rsp_data));
     
-    memset(&_available_for_connect_peripheral_adv_data, 0, sizeof(_available_for_connect_peripheral_adv_data));
-    memset(&_available_for_connect_peripheral_scan_rsp_data, 0, sizeof(_available_for_connect_peripheral_scan_rsp_data));
+    memset(&_available_for_connect_peripheral, 0, sizeof(_available_for_connect_peripheral));
     
     memset(&_service_uuid, 0, sizeof(_service_uuid));
     memset(&_service_solicit_uuid, 0, sizeof(_service_solicit_uuid));
@@ -121,6 +145,7 @@ BLEDeviceManager::BLEDeviceManager():
     memset(_peer_peripheral_adv_rssi, 0, sizeof(_peer_peripheral_adv_rssi));
     
     memset(_device_events, 0, sizeof(_device_events));
+    _scan_report_handler = NULL;
 }
 
 BLEDeviceManager::~BLEDeviceManager()
@@ -132,6 +157,12 @@ bool BLEDeviceManager::begin(BLEDevice *device)
 {
     if (NULL == _local_ble)
     {
+        // The BLE core comes up in the background from boot
+        if (ble_cfw_service_wait)
+        {
+            ble_cfw_service_wait();
+            bootMark(BOOT_BLE);
+        }
         _local_ble = device;
         bt_le_set_mac_address(_local_bda);
         
@@ -151,6 +182,11 @@ bool BLEDeviceManager::begin(BLEDevice *device)
     }
 }
 
+void BLEDeviceManager::setScanReportHandler(BLEScanReportHandler handler)
+{
+    _scan_report_handler = handler;
+}
+
 void BLEDeviceManager::poll()
 {
     if (NULL != _device_events[BLEDiscovered])
@@ -230,7 +266,7 @@ bool BLEDeviceManager::disconnect(BLEDevice *device)
         {
             if (true == BLEUtils::macAddressValid(_peer_peripheral[i]))
             {
-                ret = disconnectSingle(&_peer_central);
+                ret = disconnectSingle(&_peer_peripheral[i]);
             }
         }
     }
@@ -240,6 +276,7 @@ bool BLEDeviceManager::disconnect(BLEDevice *device)
 void BLEDeviceManager::setAdvertisedServiceUuid(const char* advertisedServiceUuid)
 {
     _has_service_uuid = true;
+    _adv_data_valid = false;
     BLEUtils::uuidString2BT(advertisedServiceUuid, (bt_uuid_t *)&_service_uuid);
 }
 
@@ -255,11 +292,32 @@ void BLEDeviceManager::setAdvertisedServiceData(const bt_uuid_t* serviceDataUuid
     
     memcpy(_service_data, serviceData, serviceDataLength);
     _service_data_length = serviceDataLength;
+    _adv_data_valid = false;
+}
+
+BLE_STATUS_T BLEDeviceManager::updateAdvertisedServiceData(const bt_uuid_t* serviceDataUuid,
+                                                           const uint8_t* serviceData,
+                                                           uint8_t serviceDataLength)
+{
+    if (_adv_data_valid &&
+        serviceDataLength == _service_data_length &&
+        0 == bt_uuid_cmp(serviceDataUuid, (bt_uuid_t *)&_service_data_uuid))
+    {
+        // Same layout: patch the value in the encoded field
+        memcpy(_service_data, serviceData, serviceDataLength);
+        memcpy(_service_data_buf + sizeof(uint16_t), serviceData, serviceDataLength);
+    }
+    else
+    {
+        setAdvertisedServiceData(serviceDataUuid, serviceData, serviceDataLength);
+    }
+    return updateAdvertising();
 }
 
 void BLEDeviceManager::setServiceSolicitationUuid(const char* serviceSolicitationUuid)
 {
     _has_service_solicit_uuid = true;
+    _adv_data_valid = false;
     BLEUtils::uuidString2BT(serviceSolicitationUuid, (bt_uuid_t *)&_service_solicit_uuid);
 }
 
@@ -272,11 +330,28 @@ void BLEDeviceManager::setManufacturerData(const unsigned char manufacturerData[
     }
     _manufacturer_data_length = manufacturerDataLength;
     memcpy(_manufacturer_data, manufacturerData, manufacturerDataLength);
+    _adv_data_valid = false;
+}
+
+BLE_STATUS_T BLEDeviceManager::updateManufacturerData(const unsigned char manufacturerData[],
+                                                      unsigned char manufacturerDataLength)
+{
+    if (_adv_data_valid && manufacturerDataLength == _manufacturer_data_length)
+    {
+        // The manufacturer data field points at _manufacturer_data
+        memcpy(_manufacturer_data, manufacturerData, manufacturerDataLength);
+    }
+    else
+    {
+        setManufacturerData(manufacturerData, manufacturerDataLength);
+    }
+    return updateAdvertising();
 }
 
 void BLEDeviceManager::setLocalName(const char *localName)
 {
     _local_name = localName;
+    _adv_data_valid = false;
 }
 
 void BLEDeviceManager::setAdvertisingInterval(float advertisingInterval)
@@ -304,7 +379,7 @@ void BLEDeviceManager::getConnectionInterval(BLEDevice *device,
 int BLEDeviceManager::setConnectionInterval(BLEDevice *device)
 {
     bt_conn_t* conn = bt_conn_lookup_addr_le(device->bt_le_address());
-    int ret = 0;
+    int ret = -ENOTCONN;
     if (NULL != conn)
     {
         ret = bt_conn_le_param_update(conn, device->bt_conn_param());
@@ -512,6 +587,7 @@ BLEDeviceManager::_advDataInit(void)
         memcpy(adv_tmp, _service_data, _service_data_length);
     }
     
+    _adv_data_valid = (BLE_STATUS_SUCCESS == ret);
     return ret;
 }
 
@@ -519,10 +595,13 @@ BLE_STATUS_T BLEDeviceManager::startAdvertising()
 {
     int ret;
     BLE_STATUS_T status;
-    status = _advDataInit();
-    if (BLE_STATUS_SUCCESS != status)
+    if (!_adv_data_valid)
     {
-        return status;
+        status = _advDataInit();
+        if (BLE_STATUS_SUCCESS != status)
+        {
+            return status;
+        }
     }
 
     pr_info(LOG_MODULE_BLE, "%s-ad_len%d", __FUNCTION__, _adv_data_idx);
@@ -542,6 +621,50 @@ BLE_STATUS_T BLEDeviceManager::startAdvertising()
     return BLE_STATUS_SUCCESS;
 }
 
+BLE_STATUS_T BLEDeviceManager::updateAdvertising()
+{
+    BLE_STATUS_T status;
+    int ret;
+
+    if (BLE_PERIPH_STATE_ADVERTISING != _state)
+    {
+        // Picked up by the next startAdvertising()
+        return BLE_STATUS_SUCCESS;
+    }
+
+    if (!_adv_data_valid)
+    {
+        status = _advDataInit();
+        if (BLE_STATUS_SUCCESS != status)
+        {
+            return status;
+        }
+    }
+
+    if (!bt_le_adv_update)
+    {
+        ret = bt_le_adv_stop();
+        if (0 == ret)
+        {
+            ret = bt_le_adv_start(&_adv_param,
+                                  _adv_data, _adv_data_idx,
+                                  _scan_rsp_data, _scan_rsp_data_idx);
+            if (0 != ret)
+            {
+                _state = BLE_PERIPH_STATE_READY;
+            }
+        }
+        return errorno_to_ble_status(ret);
+    }
+
+    // As bt_le_adv_start(), no scan response unless scannable
+    bool scannable = (BT_LE_ADV_IND == _adv_param.type ||
+                      BT_LE_ADV_SCAN_IND == _adv_param.type);
+    ret = bt_le_adv_update(_adv_data, _adv_data_idx,
+                           _scan_rsp_data, scannable ? _scan_rsp_data_idx : 0);
+    return errorno_to_ble_status(ret);
+}
+
 bool BLEDeviceManager::advertising()
 {
     return (BLE_PERIPH_STATE_ADVERTISING == _state);
@@ -601,14 +724,23 @@ void BLEDeviceManager::_clearAdvertiseBuffer()
     memset(_peer_temp_adv_data_len, 0, sizeof(_peer_temp_adv_data_len));
     memset(_peer_temp_adv_connectable, 0, sizeof(_peer_adv_connectable));
     
-    memset(_peer_adv_buffer, 0, sizeof(_peer_adv_buffer));
-    memset(_peer_adv_mill, 0, sizeof(_peer_adv_mill));
-    memset(_peer_adv_data, 0, sizeof(_peer_adv_data));
-    memset(_peer_adv_data_len, 0, sizeof(_peer_adv_data_len));
-    memset(_peer_scan_rsp_data, 0, sizeof(_peer_scan_rsp_data));
-    memset(_peer_scan_rsp_data_len, 0, sizeof(_peer_scan_rsp_data_len));
-    memset(_peer_adv_rssi, 0, sizeof(_peer_adv_rssi));
-    
+    uint32_t saved = interrupt_lock();
+    for (uint8_t i = 0; i < BLE_MAX_ADV_BUFFER_CFG; i++)
+    {
+        // Keep the device available() returned, it is read in place
+        if (i == _available_for_connect_index)
+        {
+            continue;
+        }
+        memset(&_peer_adv_buffer[i], 0, sizeof(_peer_adv_buffer[i]));
+        _peer_adv_mill[i] = 0;
+        _peer_adv_data_len[i] = 0;
+        _peer_scan_rsp_data_len[i] = -1;
+        _peer_adv_rssi[i] = 0;
+        _peer_adv_queued[i] = false;
+    }
+    _peer_adv_ready_head = _peer_adv_ready_count = 0;
+    interrupt_unlock(saved);
 }
 
 bool BLEDeviceManager::startScanningWithDuplicates()
@@ -631,7 +763,7 @@ bool BLEDeviceManager::startScanningNewPeripherals()
 {
     _adv_duplicate_filter_enabled = true;
     memset(_peer_duplicate_address_buffer, 0, sizeof(_peer_duplicate_address_buffer));
-    _duplicate_filter_header = _duplicate_filter_tail = 0;
+    memset(_peer_duplicate_mill, 0, sizeof(_peer_duplicate_mill));
 
     _clearAdvertiseBuffer();
     
@@ -702,6 +834,78 @@ void BLEDeviceManager::setAdvertiseCritical(const char* macaddress)
     BLEUtils::macAddressString2BT(macaddress, _adv_accept_device);
 }
 
+void BLEDeviceManager::setScanFilterRssi(int8_t rssi)
+{
+    _scan_filter_rssi = rssi;
+    _scan_filters |= SCAN_FILTER_RSSI;
+}
+
+void BLEDeviceManager::setScanFilterNamePrefix(String prefix)
+{
+    _scan_filter_name = prefix;
+    _scan_filters |= SCAN_FILTER_NAME;
+}
+
+void BLEDeviceManager::setScanFilterManufacturer(uint16_t companyId)
+{
+    _scan_filter_company = companyId;
+    _scan_filters |= SCAN_FILTER_MANUFACTURER;
+}
+
+void BLEDeviceManager::clearScanFilters()
+{
+    _scan_filters = 0;
+}
+
+bool BLEDeviceManager::setScanParameters(uint16_t interval, 
+                                         uint16_t window, 
+                                         uint8_t type)
+{
+    // In 0.625 ms units, as the controller takes them
+    if (interval < 0x0004 || interval > 0x4000 ||
+        window < 0x0004 || window > interval)
+    {
+        return false;
+    }
+    _scan_param.type = type;
+    _scan_param.interval = interval;
+    _scan_param.window = window;
+    return true;
+}
+
+bool BLEDeviceManager::findAdvertiseField(const uint8_t* adv_data,
+                                          uint8_t adv_data_len,
+                                          const uint8_t eir_type, 
+                                          const uint8_t* &data,
+                                          uint8_t &data_len)
+{
+    while (NULL != adv_data && adv_data_len > 1)
+    {
+        uint8_t len = adv_data[0];
+        uint8_t type = adv_data[1];
+
+        /* Check for early termination */
+        if ((len == 0) || ((len + 1) > adv_data_len)) {
+            break;
+        }
+
+        if (type == eir_type)
+        {
+            if (len >= BLE_MAX_ADV_SIZE)
+            {
+                len = BLE_MAX_ADV_SIZE-1;
+            }
+            data = &adv_data[2];
+            data_len = len - 1;
+            return true;
+        }
+
+        adv_data_len -= len + 1;
+        adv_data += len + 1;
+    }
+    return false;
+}
+
 bool BLEDeviceManager::getDataFromAdvertiseByType(const BLEDevice* device,
                                                   const uint8_t eir_type, 
                                                   const uint8_t* &data,
@@ -709,50 +913,18 @@ bool BLEDeviceManager::getDataFromAdvertiseByType(const BLEDevice* device,
 {
     const uint8_t* adv_data = NULL;
     uint8_t adv_data_len = 0;
-    bool retval = false;
-    bool scan_response_proced = false;
     
     getDeviceAdvertiseBuffer(device->bt_le_address(),
                              adv_data,
                              adv_data_len);
-
-    while (NULL != adv_data)
+    if (findAdvertiseField(adv_data, adv_data_len, eir_type, data, data_len))
     {
-        while (adv_data_len > 1)
-        {
-            uint8_t len = adv_data[0];
-            uint8_t type = adv_data[1];
-
-            /* Check for early termination */
-            if ((len == 0) || ((len + 1) > adv_data_len)) {
-                break;
-            }
-
-            if (type == eir_type)
-            {
-                if (len >= BLE_MAX_ADV_SIZE)
-                {
-                    len = BLE_MAX_ADV_SIZE-1;
-                }
-                data = &adv_data[2];
-                data_len = len - 1;
-                retval = true;
-                break;
-            }
-
-            adv_data_len -= len + 1;
-            adv_data += len + 1;
-        }
-        if (retval == true || scan_response_proced == true)
-        {
-            break;
-        }
-        getDeviceScanResponseBuffer(device->bt_le_address(),
-                                    adv_data,
-                                    adv_data_len);
-        scan_response_proced = true;
+        return true;
     }
-    return retval;
+    getDeviceScanResponseBuffer(device->bt_le_address(),
+                                adv_data,
+                                adv_data_len);
+    return findAdvertiseField(adv_data, adv_data_len, eir_type, data, data_len);
 }
 
 
@@ -860,10 +1032,11 @@ void BLEDeviceManager::getDeviceAdvertiseBuffer(const bt_addr_le_t* addr,
     }
     
     // Available device
-    if (bt_addr_le_cmp(&_available_for_connect_peripheral, addr) == 0)
+    if (_available_for_connect_index < BLE_MAX_ADV_BUFFER_CFG &&
+        bt_addr_le_cmp(&_available_for_connect_peripheral, addr) == 0)
     {
-        adv_data = _available_for_connect_peripheral_adv_data;
-        adv_len = _available_for_connect_peripheral_adv_data_len;
+        adv_data = _peer_adv_data[_available_for_connect_index];
+        adv_len = _peer_adv_data_len[_available_for_connect_index];
         return;
     }
     return;
@@ -895,15 +1068,35 @@ void BLEDeviceManager::getDeviceScanResponseBuffer(const bt_addr_le_t* addr,
     }
     
     // Available device
-    if (bt_addr_le_cmp(&_available_for_connect_peripheral, addr) == 0)
+    if (_available_for_connect_index < BLE_MAX_ADV_BUFFER_CFG &&
+        bt_addr_le_cmp(&_available_for_connect_peripheral, addr) == 0)
     {
-        adv_data = _available_for_connect_peripheral_scan_rsp_data;
-        adv_len = _available_for_connect_peripheral_scan_rsp_data_len;
+        int8_t len = _peer_scan_rsp_data_len[_available_for_connect_index];
+        adv_data = _peer_scan_rsp_data[_available_for_connect_index];
+        adv_len = (len > 0) ? len : 0; // -1 is no scan response
         return;
     }
     return;
 }
 
+int BLEDeviceManager::advertisementData(const BLEDevice* device, 
+                                        const uint8_t* &data) const
+{
+    uint8_t len = 0;
+    data = NULL;
+    getDeviceAdvertiseBuffer(device->bt_le_address(), data, len);
+    return (NULL == data) ? 0 : len;
+}
+
+int BLEDeviceManager::scanResponseData(const BLEDevice* device, 
+                                       const uint8_t* &data) const
+{
+    uint8_t len = 0;
+    data = NULL;
+    getDeviceScanResponseBuffer(device->bt_le_address(), data, len);
+    return (NULL == data) ? 0 : len;
+}
+
 int BLEDeviceManager::advertisedServiceUuidCount(const BLEDevice* device) const
 {
     const uint8_t* adv_data = NULL;
@@ -960,34 +1153,54 @@ String BLEDeviceManager::localName(const BLEDevice* device) const
         return _local_name;
     }
 
+    char local_name_buff[BLE_MAX_ADV_SIZE];
+    localName(device, local_name_buff, sizeof(local_name_buff));
+    return String(local_name_buff);
+}
+
+int BLEDeviceManager::localName(const BLEDevice* device, char *buffer, int size) const
+{
     const uint8_t* local_name = NULL;
     uint8_t local_name_len = 0;
-    String temp("");
-    char local_name_buff[BLE_MAX_ADV_SIZE];
-    bool retval = getDataFromAdvertiseByType(device, 
-                                             BT_DATA_NAME_COMPLETE,
-                                             local_name, 
-                                             local_name_len);
-    if (false == retval)
+    bool retval = false;
+
+    if (NULL == buffer || size <= 0)
     {
-        retval = getDataFromAdvertiseByType(device,
-                                            BT_DATA_NAME_SHORTENED,
-                                            local_name,
-                                            local_name_len);
+        return 0;
     }
 
-    if (true == retval) 
+    if (BLEUtils::isLocalBLE(*device) == true)
     {
-        if (local_name_len >= BLE_MAX_ADV_SIZE)
+        local_name = (const uint8_t*)_local_name.c_str();
+        local_name_len = _local_name.length();
+        retval = (local_name != NULL);
+    }
+    else
+    {
+        retval = getDataFromAdvertiseByType(device, 
+                                            BT_DATA_NAME_COMPLETE,
+                                            local_name, 
+                                            local_name_len);
+        if (false == retval)
         {
-            local_name_len = BLE_MAX_ADV_SIZE - 1;
+            retval = getDataFromAdvertiseByType(device,
+                                                BT_DATA_NAME_SHORTENED,
+                                                local_name,
+                                                local_name_len);
         }
-        memcpy(local_name_buff, local_name, local_name_len);
-        local_name_buff[local_name_len] = '\0';
-        temp = local_name_buff;
     }
-    
-    return temp;
+
+    if (false == retval)
+    {
+        local_name_len = 0;
+    }
+    else if (local_name_len >= size)
+    {
+        local_name_len = size - 1;
+    }
+    memcpy(buffer, local_name, local_name_len);
+    buffer[local_name_len] = '\0';
+    return local_name_len;
 }
 
 String BLEDeviceManager::advertisedServiceUuid(const BLEDevice* device) const
@@ -996,15 +1209,32 @@ String BLEDeviceManager::advertisedServiceUuid(const BLEDevice* device) const
 }
 
 String BLEDeviceManager::advertisedServiceUuid(const BLEDevice* device, int index) const
+{
+    char uuid_string[37];
+
+    advertisedServiceUuid(device, index, uuid_string, sizeof(uuid_string));
+    return String(uuid_string);
+}
+
+int BLEDeviceManager::advertisedServiceUuid(const BLEDevice* device,
+                                            int index,
+                                            char *buffer,
+                                            int size) const
 {
     const uint8_t* adv_data = NULL;
     uint8_t adv_data_len = 0;
     uint8_t service_cnt = 0;
     bt_uuid_128_t service_uuid;
     char uuid_string[37];
+    int uuid_len;
     
     memset(uuid_string, 0, sizeof(uuid_string));
     
+    if (NULL == buffer || size <= 0)
+    {
+        return 0;
+    }
+
     if (BLEUtils::isLocalBLE(*device) == true)
     {
         // Local device only support advertise 1 service now.
@@ -1012,19 +1242,15 @@ String BLEDeviceManager::advertisedServiceUuid(const BLEDevice* device, int inde
         {
             BLEUtils::uuidBT2String(&_service_uuid.uuid, uuid_string);
         }
-        return  String(uuid_string);
     }
-    
-    getDeviceAdvertiseBuffer(device->bt_le_address(),
-                             adv_data,
-                             adv_data_len);
-    
-    if ((uint8_t *)NULL == adv_data)
+    else
     {
-        return String(uuid_string);
+        getDeviceAdvertiseBuffer(device->bt_le_address(),
+                                 adv_data,
+                                 adv_data_len);
     }
     
-    while (adv_data_len > 1)
+    while ((uint8_t *)NULL != adv_data && adv_data_len > 1)
     {
         uint8_t len = adv_data[0];
         uint8_t type = adv_data[1];
@@ -1065,7 +1291,15 @@ String BLEDeviceManager::advertisedServiceUuid(const BLEDevice* device, int inde
         adv_data_len -= len + 1;
         adv_data += len + 1;
     }
-    return String(uuid_string);
+    
+    uuid_len = strlen(uuid_string);
+    if (uuid_len >= size)
+    {
+        uuid_len = size - 1;
+    }
+    memcpy(buffer, uuid_string, uuid_len);
+    buffer[uuid_len] = '\0';
+    return uuid_len;
 }
 
 int BLEDeviceManager::rssi(const BLEDevice* device) const
@@ -1089,9 +1323,10 @@ int BLEDeviceManager::rssi(const BLEDevice* device) const
     }
     
     // Available device
-    if (bt_addr_le_cmp(&_available_for_connect_peripheral, addr) == 0)
+    if (_available_for_connect_index < BLE_MAX_ADV_BUFFER_CFG &&
+        bt_addr_le_cmp(&_available_for_connect_peripheral, addr) == 0)
     {
-        return _available_for_connect_peripheral_adv_rssi;
+        return _peer_adv_rssi[_available_for_connect_index];
     }
     return 0;
 }
@@ -1102,18 +1337,20 @@ bool BLEDeviceManager::connect(BLEDevice &device)
     uint64_t timestamp = millis();
     uint64_t timestampcur = timestamp;
     bool ret = true;
-    if (_available_for_connect_peripheral_connectable == false)
+    uint8_t index = _available_for_connect_index;
+    if (index >= BLE_MAX_ADV_BUFFER_CFG ||
+        _peer_adv_connectable[index] == false)
     {
         return false;
     }
     
     bt_addr_le_copy(&_wait_for_connect_peripheral, device.bt_le_address());
     // Buffer the ADV data
-    memcpy(_wait_for_connect_peripheral_adv_data, _available_for_connect_peripheral_adv_data, BLE_MAX_ADV_SIZE);
-    memcpy(_wait_for_connect_peripheral_scan_rsp_data, _available_for_connect_peripheral_scan_rsp_data, BLE_MAX_ADV_SIZE);
-    _wait_for_connect_peripheral_adv_data_len = _available_for_connect_peripheral_adv_data_len;
-    _wait_for_connect_peripheral_scan_rsp_data_len = _available_for_connect_peripheral_scan_rsp_data_len;
-    _wait_for_connect_peripheral_adv_rssi = _available_for_connect_peripheral_adv_rssi;
+    memcpy(_wait_for_connect_peripheral_adv_data, _peer_adv_data[index], BLE_MAX_ADV_SIZE);
+    memcpy(_wait_for_connect_peripheral_scan_rsp_data, _peer_scan_rsp_data[index], BLE_MAX_ADV_SIZE);
+    _wait_for_connect_peripheral_adv_data_len = _peer_adv_data_len[index];
+    _wait_for_connect_peripheral_scan_rsp_data_len = (_peer_scan_rsp_data_len[index] > 0) ? _peer_scan_rsp_data_len[index] : 0;
+    _wait_for_connect_peripheral_adv_rssi = _peer_adv_rssi[index];
 
     startScanningWithDuplicates();
     
@@ -1273,6 +1510,8 @@ void BLEDeviceManager::handleDisconnectEvent(bt_conn_t *conn, uint8_t reason)
     {
         // Central has established the connection with this peripheral device
         memset(&_peer_central, 0, sizeof (bt_addr_le_t));
+        BLECharacteristicImp::flushNotifications();
+        BLECharacteristicImp::discardPreparedWrite();
     }
     else
     {
@@ -1293,6 +1532,7 @@ void BLEDeviceManager::handleDisconnectEvent(bt_conn_t *conn, uint8_t reason)
             }
         }
         // Peripheral has established the connection with this Central device
+        BLECharacteristicImp::flushWrites(bt_conn_get_dst(conn));
         BLEProfileManager::instance()->handleDisconnectedEvent(bt_conn_get_dst(conn));
     }
     
@@ -1315,116 +1555,211 @@ void BLEDeviceManager::handleParamUpdated (bt_conn_t *conn,
     }
 }
 
-bool BLEDeviceManager::advertiseDataProc(uint8_t type, 
-                                         const uint8_t *dataPtr, 
-                                         uint8_t data_len)
+uint8_t BLEDeviceManager::advertiseDataProc(uint8_t type, 
+                                            const uint8_t *dataPtr, 
+                                            uint8_t data_len)
 {
-    //Serial1.print("[AD]:");
-    //Serial1.print(type);
-    //Serial1.print(" data_len ");
-    //Serial1.println(data_len);
+    uint8_t matched = 0;
     
-    //const bt_data_t zero = {0, 0,0};
-    if (_adv_accept_critical.type == 0 && 
-        _adv_accept_critical.data_len == 0 &&
-        _adv_accept_critical.data == NULL)
-    {
-        // Not set the critical. Accept all.
-        return true;
-    }
     if (type == _adv_accept_critical.type &&
         data_len == _adv_accept_critical.data_len &&
         0 == memcmp(dataPtr, _adv_accept_critical.data, data_len))
     {
         // Now Only support 1 critical. Change those code if want support multi-criticals
-        return true;
+        matched |= SCAN_FILTER_CRITICAL;
+    }
+    else if ((_adv_accept_critical.type == BT_DATA_UUID16_ALL &&
+              (type == BT_DATA_UUID16_ALL || type == BT_DATA_UUID16_SOME)) ||
+             (_adv_accept_critical.type == BT_DATA_UUID128_ALL &&
+              (type == BT_DATA_UUID128_ALL || type == BT_DATA_UUID128_SOME)))
+    {
+        // The service may be anywhere in a list of UUIDs
+        uint8_t uuid_len = _adv_accept_critical.data_len;
+        for (uint8_t i = 0; i + uuid_len <= data_len; i += uuid_len)
+        {
+            if (0 == memcmp(&dataPtr[i], _adv_accept_critical.data, uuid_len))
+            {
+                matched |= SCAN_FILTER_CRITICAL;
+                break;
+            }
+        }
+    }
+    
+    if ((_scan_filters & SCAN_FILTER_NAME) &&
+        (type == BT_DATA_NAME_COMPLETE || type == BT_DATA_NAME_SHORTENED) &&
+        data_len >= _scan_filter_name.length() &&
+        0 == memcmp(dataPtr, _scan_filter_name.c_str(), _scan_filter_name.length()))
+    {
+        matched |= SCAN_FILTER_NAME;
+    }
+    
+    if ((_scan_filters & SCAN_FILTER_MANUFACTURER) &&
+        type == BT_DATA_MANUFACTURER_DATA &&
+        data_len >= 2 &&
+        (dataPtr[0] | (dataPtr[1] << 8)) == _scan_filter_company)
+    {
+        matched |= SCAN_FILTER_MANUFACTURER;
     }
+    
+    return matched;
+}
 
-    return false;
+uint8_t BLEDeviceManager::duplicateFilterHash(const bt_addr_le_t* addr)
+{
+    uint32_t h = addr->val[0] | (addr->val[1] << 8) | 
+                 (addr->val[2] << 16) | ((uint32_t)addr->val[3] << 24);
+    h ^= (addr->val[4] | (addr->val[5] << 8)) << 7;
+    // Fibonacci hashing, the top bits are the best mixed
+    h *= 2654435761UL;
+    return (h >> 24) & (BLE_MAX_ADV_FILTER_SIZE_CFG - 1);
 }
 
 bool BLEDeviceManager::deviceInDuplicateFilterBuffer(const bt_addr_le_t* addr)
 {
-    bool retVal = false;
-    for (uint8_t i = 0; 
-         i < (sizeof(_peer_duplicate_address_buffer) / sizeof(bt_addr_le_t)); 
-         i++)
+    uint8_t i = duplicateFilterHash(addr);
+    
+    for (uint8_t n = 0; n < BLE_DUPLICATE_FILTER_PROBE; n++)
     {
-        if (0 == bt_addr_le_cmp(addr, &_peer_duplicate_address_buffer[i]))
+        const bt_addr_le_t* temp = &_peer_duplicate_address_buffer[i];
+        if (false == BLEUtils::macAddressValid(*temp))
         {
-            retVal = true;
             break;
         }
+        if (0 == bt_addr_le_cmp(addr, temp))
+        {
+            return (BLE_ADV_FILTER_AGE_MS == 0 ||
+                    (uint32_t)millis() - _peer_duplicate_mill[i] <= BLE_ADV_FILTER_AGE_MS);
+        }
+        i = (i + 1) & (BLE_MAX_ADV_FILTER_SIZE_CFG - 1);
     }
-    return retVal;
+    return false;
 }
 
 void BLEDeviceManager::updateDuplicateFilter(const bt_addr_le_t* addr)
 {
-    uint8_t i = (_duplicate_filter_header + 1) % (ARRAY_SIZE(_peer_duplicate_address_buffer));
-    if (deviceInDuplicateFilterBuffer(addr))
-    {
-        return;
-    }
-    bt_addr_le_copy(&_peer_duplicate_address_buffer[_duplicate_filter_header],
-                 addr);
-    if (i == _duplicate_filter_tail)
+    uint32_t timestamp = millis();
+    uint8_t i = duplicateFilterHash(addr);
+    uint8_t oldest = i;
+    
+    // The device, or the first free entry, in the probe window. When the
+    //  window is full the entry reported longest ago is replaced; it keeps
+    //  its place, so the probes for the others still reach them.
+    for (uint8_t n = 0; n < BLE_DUPLICATE_FILTER_PROBE; n++)
     {
-        _duplicate_filter_tail = (_duplicate_filter_tail + 1) % (ARRAY_SIZE(_peer_duplicate_address_buffer));
+        const bt_addr_le_t* temp = &_peer_duplicate_address_buffer[i];
+        if (false == BLEUtils::macAddressValid(*temp) ||
+            0 == bt_addr_le_cmp(addr, temp))
+        {
+            oldest = i;
+            break;
+        }
+        if (timestamp - _peer_duplicate_mill[i] > 
+            timestamp - _peer_duplicate_mill[oldest])
+        {
+            oldest = i;
+        }
+        i = (i + 1) & (BLE_MAX_ADV_FILTER_SIZE_CFG - 1);
     }
-    _duplicate_filter_header = i;
+    bt_addr_le_copy(&_peer_duplicate_address_buffer[oldest], addr);
+    _peer_duplicate_mill[oldest] = timestamp;
 }
 
 BLEDevice BLEDeviceManager::available()
 {
     BLEDevice tempdevice;
     bt_addr_le_t* temp = NULL;
+    
+    // The scan reports come in from the BLE core's interrupt
+    uint32_t saved = interrupt_lock();
     uint64_t timestamp = millis();
-    uint8_t index = BLE_MAX_ADV_BUFFER_CFG;
+    while (_peer_adv_ready_count > 0)
+    {
+        uint8_t index = _peer_adv_ready[_peer_adv_ready_head];
+        _peer_adv_ready_head = (_peer_adv_ready_head + 1) % BLE_MAX_ADV_BUFFER_CFG;
+        _peer_adv_ready_count--;
+        _peer_adv_queued[index] = false;
+        
+        temp = &_peer_adv_buffer[index];
+        // The slot may have expired, or been taken by a device still
+        //  waiting for its scan response, since it was queued
+        if (timestamp - _peer_adv_mill[index] > BLE_ADV_EXPIRE_MS ||
+            (_peer_scan_rsp_data_len[index] < 0 && _peer_adv_connectable[index]) ||
+            false == BLEUtils::macAddressValid(*temp))
+        {
+            continue;
+        }
+        // Eable the duplicate filter
+        if (_adv_duplicate_filter_enabled && 
+            true == deviceInDuplicateFilterBuffer(temp))
+        {
+            continue;
+        }
+        
+        tempdevice.setAddress(*temp);
+        bt_addr_le_copy(&_available_for_connect_peripheral, temp);
+        _available_for_connect_index = index;
+        //pr_debug(LOG_MODULE_BLE, "%s-%d:Con addr-%s", __FUNCTION__, __LINE__, BLEUtils::macAddressBT2String(*temp).c_str());
+        _peer_adv_mill[index] = timestamp - BLE_ADV_EXPIRE_MS - 1; // Set it as expired
+        if (_adv_duplicate_filter_enabled)
+        {
+            updateDuplicateFilter(temp);
+        }
+        break;
+    }
+    interrupt_unlock(saved);
+    return tempdevice;
+}
+
+uint8_t BLEDeviceManager::findAdvertiseBuffer(const bt_addr_le_t* bt_addr) const
+{
     uint8_t i = 0;
-    uint64_t max_delta = 0;
     
     for (i = 0; i < BLE_MAX_ADV_BUFFER_CFG; i++)
     {
-        uint64_t timestamp_delta = timestamp - _peer_adv_mill[i];
-        temp = &_peer_adv_buffer[i];
-        if ((timestamp_delta <= 2000) && (max_delta < timestamp_delta) && (_peer_scan_rsp_data_len[i] >= 0 || !_peer_adv_connectable[i]))
+        // The device available() returned is not updated under the reader
+        if (i != _available_for_connect_index &&
+            bt_addr_le_cmp(&_peer_adv_buffer[i], bt_addr) == 0)
         {
-            // Eable the duplicate filter
-            if (_adv_duplicate_filter_enabled && 
-                true == deviceInDuplicateFilterBuffer(temp))
-            {
-                _peer_adv_mill[i] -= 2000; // Invalid the item
-                continue;
-            }
-            max_delta = timestamp_delta;
-            index = i;
+            break;
         }
     }
-    //pr_debug(LOG_MODULE_BLE, "%s-%d:index %d, i-%d", __FUNCTION__, __LINE__, index, i);
+    return i;
+}
+
+uint8_t BLEDeviceManager::allocAdvertiseBuffer(uint64_t timestamp)
+{
+    uint8_t index = _peer_adv_next;
     
-    if (index < BLE_MAX_ADV_BUFFER_CFG)
+    // Take the first slot, from the one after the last taken, whose result
+    //  has been read or has expired. Busy slots are the newest ones, so
+    //  this is normally the first slot tried.
+    for (uint8_t n = 0; n < BLE_MAX_ADV_BUFFER_CFG; n++)
     {
-        temp = &_peer_adv_buffer[index];
-        if (true == BLEUtils::macAddressValid(*temp))
+        if (index != _available_for_connect_index &&
+            (false == BLEUtils::macAddressValid(_peer_adv_buffer[index]) ||
+             timestamp - _peer_adv_mill[index] > BLE_ADV_EXPIRE_MS))
         {
-            tempdevice.setAddress(*temp);
-            bt_addr_le_copy(&_available_for_connect_peripheral, temp);
-            memcpy(_available_for_connect_peripheral_adv_data, _peer_adv_data[index], BLE_MAX_ADV_SIZE);
-            memcpy(_available_for_connect_peripheral_scan_rsp_data, _peer_scan_rsp_data[index], BLE_MAX_ADV_SIZE);
-            _available_for_connect_peripheral_scan_rsp_data_len = _peer_scan_rsp_data_len[index];
-            _available_for_connect_peripheral_adv_data_len = _peer_adv_data_len[index];
-            _available_for_connect_peripheral_adv_rssi = _peer_adv_rssi[index];
-            _available_for_connect_peripheral_connectable = _peer_adv_connectable[index];
-            //pr_debug(LOG_MODULE_BLE, "%s-%d:Con addr-%s", __FUNCTION__, __LINE__, BLEUtils::macAddressBT2String(*temp).c_str());
-            _peer_adv_mill[index] -= 2000; // Set it as expired
-            if (_adv_duplicate_filter_enabled)
-            {
-                updateDuplicateFilter(temp);
-            }
+            _peer_adv_next = (index + 1) % BLE_MAX_ADV_BUFFER_CFG;
+            _peer_scan_rsp_data_len[index] = -1; // Invalid the scan response
+            return index;
         }
+        index = (index + 1) % BLE_MAX_ADV_BUFFER_CFG;
     }
-    return tempdevice;
+    return BLE_MAX_ADV_BUFFER_CFG;
+}
+
+void BLEDeviceManager::queueAdvertiseBuffer(uint8_t index)
+{
+    // A connectable device is reported once its scan response is in
+    if (_peer_adv_queued[index] ||
+        (_peer_scan_rsp_data_len[index] < 0 && _peer_adv_connectable[index]))
+    {
+        return;
+    }
+    uint8_t tail = (_peer_adv_ready_head + _peer_adv_ready_count) % BLE_MAX_ADV_BUFFER_CFG;
+    _peer_adv_ready[tail] = index;
+    _peer_adv_ready_count++;
+    _peer_adv_queued[index] = true;
 }
 
 bool BLEDeviceManager::setAdvertiseBuffer(const bt_addr_le_t* bt_addr,
@@ -1433,58 +1768,31 @@ bool BLEDeviceManager::setAdvertiseBuffer(const bt_addr_le_t* bt_addr,
                                           int8_t rssi,
                                           bool connectable)
 {
-    bt_addr_le_t* temp = NULL;
     uint64_t timestamp = millis();
-    uint8_t index = BLE_MAX_ADV_BUFFER_CFG;
-    uint8_t i = 0;
-    uint64_t max_delta = 0;
-    bool retval = false;
-    //pr_debug(LOG_MODULE_BLE, "%s-%d-1", __FUNCTION__, __LINE__);
-    for (i = 0; i < BLE_MAX_ADV_BUFFER_CFG; i++)
+    uint8_t index = findAdvertiseBuffer(bt_addr);
+    
+    if (index >= BLE_MAX_ADV_BUFFER_CFG)
     {
-        uint64_t timestamp_delta = timestamp - _peer_adv_mill[i];
-        temp = &_peer_adv_buffer[i];
-        if (max_delta < timestamp_delta)
-        {
-            max_delta = timestamp_delta;
-            if (max_delta > 2000) // expired
-            {
-                index = i;
-                _peer_scan_rsp_data_len[index] = -1; // Invalid the scan response
-            }
-        }
-        
-        if (bt_addr_le_cmp(temp, bt_addr) == 0)
+        index = allocAdvertiseBuffer(timestamp);
+        if (index >= BLE_MAX_ADV_BUFFER_CFG)
         {
-            // The device alread in the buffer
-            index = i;
-            break;
+            return false;
         }
+        memcpy(&_peer_adv_buffer[index], bt_addr, sizeof (bt_addr_le_t));
     }
-    //pr_debug(LOG_MODULE_BLE, "%s-%d:index %d, i-%d", __FUNCTION__, __LINE__, index, i);
     
-    //pr_debug(LOG_MODULE_BLE, "%s-%d-2", __FUNCTION__, __LINE__);
-    if (index < BLE_MAX_ADV_BUFFER_CFG)
+    if (data_len > BLE_MAX_ADV_SIZE)
     {
-        temp = &_peer_adv_buffer[index];
-        if (i >= BLE_MAX_ADV_BUFFER_CFG)
-        {
-            memcpy(temp, bt_addr, sizeof (bt_addr_le_t));
-        }
-        if (data_len > BLE_MAX_ADV_SIZE)
-        {
-            data_len = BLE_MAX_ADV_SIZE;
-        }
-        memcpy(_peer_adv_data[index], ad, data_len);
-        _peer_adv_data_len[index] = data_len;
-        _peer_adv_rssi[index] = rssi;
-        // Update the timestamp
-        _peer_adv_mill[index] = timestamp;
-        _peer_adv_connectable[index] = connectable;
-        retval = true;
+        data_len = BLE_MAX_ADV_SIZE;
     }
-    
-    return retval;
+    memcpy(_peer_adv_data[index], ad, data_len);
+    _peer_adv_data_len[index] = data_len;
+    _peer_adv_rssi[index] = rssi;
+    // Update the timestamp
+    _peer_adv_mill[index] = timestamp;
+    _peer_adv_connectable[index] = connectable;
+    queueAdvertiseBuffer(index);
+    return true;
 }
 
 bool BLEDeviceManager::setScanRespBuffer(const bt_addr_le_t* bt_addr,
@@ -1492,40 +1800,24 @@ bool BLEDeviceManager::setScanRespBuffer(const bt_addr_le_t* bt_addr,
                                           uint8_t data_len,
                                           int8_t rssi)
 {
-    bt_addr_le_t* temp = NULL;
-    uint64_t timestamp = millis();
-    uint8_t index = BLE_MAX_ADV_BUFFER_CFG;
-    uint8_t i = 0;
-    bool retval = false;
-    //pr_debug(LOG_MODULE_BLE, "%s-%d-1", __FUNCTION__, __LINE__);
-    for (i = 0; i < BLE_MAX_ADV_BUFFER_CFG; i++)
+    uint8_t index = findAdvertiseBuffer(bt_addr);
+    
+    if (index >= BLE_MAX_ADV_BUFFER_CFG)
     {
-        temp = &_peer_adv_buffer[i];
-        
-        if (bt_addr_le_cmp(temp, bt_addr) == 0)
-        {
-            // The device alread in the buffer
-            index = i;
-            break;
-        }
+        return false;
     }
     
-    //pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
-    if (index < BLE_MAX_ADV_BUFFER_CFG)
+    if (data_len > BLE_MAX_ADV_SIZE)
     {
-        if (data_len > BLE_MAX_ADV_SIZE)
-        {
-            data_len = BLE_MAX_ADV_SIZE;
-        }
-        memcpy(_peer_scan_rsp_data[index], ad, data_len);
-        _peer_scan_rsp_data_len[index] = data_len;
-        //_peer_adv_rssi[index] = rssi;
-        // Update the timestamp
-        _peer_adv_mill[index] = timestamp;
-        retval = true;
+        data_len = BLE_MAX_ADV_SIZE;
     }
-    
-    return retval;
+    memcpy(_peer_scan_rsp_data[index], ad, data_len);
+    _peer_scan_rsp_data_len[index] = data_len;
+    //_peer_adv_rssi[index] = rssi;
+    // Update the timestamp
+    _peer_adv_mill[index] = millis();
+    queueAdvertiseBuffer(index);
+    return true;
 }
 
 uint8_t BLEDeviceManager::getTempAdvertiseIndexFromBuffer(const bt_addr_le_t* bt_addr)
@@ -1645,9 +1937,18 @@ void BLEDeviceManager::handleDeviceFound(const bt_addr_le_t *addr,
 {
     const uint8_t *data = ad;
     uint8_t real_adv_len = data_len;
+    uint8_t wanted = _scan_filters & SCAN_FILTER_AD_FIELDS;
+    uint8_t matched = 0;
+    bool connecting = BLEUtils::macAddressValid(_wait_for_connect_peripheral);
     
     /* We're only interested in connectable events */
     //pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
+    // The cheap filters first, so a busy air doesn't cost a copy per report
+    if ((_scan_filters & SCAN_FILTER_RSSI) && rssi < _scan_filter_rssi && !connecting)
+    {
+        return;
+    }
+    
     // Filter address
     if (BLEUtils::macAddressValid(_adv_accept_device) == true && 
        (memcmp(addr->val, _adv_accept_device.val, sizeof (addr->val)) != 0))
@@ -1656,6 +1957,19 @@ void BLEDeviceManager::handleDeviceFound(const bt_addr_le_t *addr,
         return;
     }
     
+    // Already reported, and scan() was asked for new devices only
+    if (_adv_duplicate_filter_enabled && !connecting &&
+        true == deviceInDuplicateFilterBuffer(addr))
+    {
+        return;
+    }
+    
+    if (_adv_accept_critical.data_len != 0 &&
+        _adv_accept_critical.data != NULL)
+    {
+        wanted |= SCAN_FILTER_CRITICAL;
+    }
+    
     while (data_len > 1)
     {
         uint8_t len = data[0];
@@ -1663,7 +1977,7 @@ void BLEDeviceManager::handleDeviceFound(const bt_addr_le_t *addr,
         /* Check for early termination */
         if (len == 0)
         {
-            return;
+            break;
         }
 
         if ((len + 1) > data_len) {    // Sid. KW, cannot be (data_len < 2)
@@ -1671,17 +1985,42 @@ void BLEDeviceManager::handleDeviceFound(const bt_addr_le_t *addr,
             return;
         }
 
-        if (true == advertiseDataProc(data[1], &data[2], len - 1))
+        matched |= advertiseDataProc(data[1], &data[2], len - 1);
+        
+        data_len -= len + 1;
+        data += len + 1;
+    }
+    
+    // Every filter set has to be met by the ADV or by its scan response
+    if ((matched & wanted) == wanted)
+    {
+        if (NULL != _scan_report_handler && !connecting)
         {
-            advertiseAcceptHandler(addr, rssi, type, ad, real_adv_len);
-            //pr_debug(LOG_MODULE_BLE, "%s-%d: Done", __FUNCTION__, __LINE__);
+            // Straight to the sketch, from this interrupt, without a copy
+            if (_adv_duplicate_filter_enabled)
+            {
+                updateDuplicateFilter(addr);
+            }
+            BLEDevice device(addr);
+            _scan_report_handler(device, rssi, ad, real_adv_len, 
+                                 BT_LE_ADV_SCAN_RSP == type);
             return;
         }
-
-        data_len -= len + 1;
-        data += len + 1;
+        advertiseAcceptHandler(addr, rssi, type, ad, real_adv_len);
+        //pr_debug(LOG_MODULE_BLE, "%s-%d: Done", __FUNCTION__, __LINE__);
+        return;
     }
     //pr_debug(LOG_MODULE_BLE, "%s: done", __FUNCTION__);
+    if (NULL != _scan_report_handler && !connecting)
+    {
+        // Reports are filtered one by one, nothing is paired up
+        return;
+    }
+    if (BT_HCI_LE_SCAN_PASSIVE == _scan_param.type)
+    {
+        // No scan response will come to complete the match
+        return;
+    }
     // Doesn't accept the ADV/scan data
     // Check it in the buffer
     if (BT_LE_ADV_SCAN_RSP == type)
@@ -102,6 +102,13 @@ class BLEDeviceManager
     
     void setEventHandler(BLEDeviceEvent event, 
                          BLEDeviceEventHandler eventHandler);
+    void setScanReportHandler(BLEScanReportHandler handler);
+    // The data of an AD field of the type, in an ADV or scan response
+    static bool findAdvertiseField(const uint8_t* adv_data,
+                                   uint8_t adv_data_len,
+                                   const uint8_t eir_type, 
+                                   const uint8_t* &data,
+                                   uint8_t &data_len);
     /**
      * @brief   Set the service UUID that the BLE Peripheral Device advertises
      *
@@ -127,6 +134,24 @@ class BLEDeviceManager
     void setAdvertisedServiceData(const bt_uuid_t* serviceDataUuid,
                                   const uint8_t* serviceData,
                                   uint8_t serviceDataLength);
+    
+    /**
+     * @brief   Change the service data while advertising
+     *
+     * @param[in] serviceDataUuid       16-bit UUID of the service data
+     * @param[in] serviceData           The new service data
+     * @param[in] serviceDataLength     The length of the service data
+     *
+     * @return  BLE_STATUS_T       0 - Success. Others - error code
+     *
+     * @note  Same as setAdvertisedServiceData() when not advertising.
+     *         With the same UUID and length the value is patched in the
+     *         encoded advertisement, otherwise it is rebuilt. Either way
+     *         only the data goes to the controller; advertising goes on.
+     */
+    BLE_STATUS_T updateAdvertisedServiceData(const bt_uuid_t* serviceDataUuid,
+                                             const uint8_t* serviceData,
+                                             uint8_t serviceDataLength);
 
     /**
      * @brief   Set the manufacturer data in the BLE Peripheral Device advertises
@@ -140,6 +165,19 @@ class BLEDeviceManager
      */
     void setManufacturerData(const unsigned char manufacturerData[], 
                              unsigned char manufacturerDataLength);
+    
+    /**
+     * @brief   Change the manufacturer data while advertising
+     *
+     * @param[in] manufacturerData          The new manufacturer data
+     * @param[in] manufacturerDataLength    The length of the manufacturer data
+     *
+     * @return  BLE_STATUS_T       0 - Success. Others - error code
+     *
+     * @note  As updateAdvertisedServiceData()
+     */
+    BLE_STATUS_T updateManufacturerData(const unsigned char manufacturerData[],
+                                        unsigned char manufacturerDataLength);
     bool getManufacturerData (const BLEDevice* device, 
                               uint8_t* manu_data, 
                               uint8_t&manu_data_len) const;
@@ -253,6 +291,17 @@ class BLEDeviceManager
      */
     BLE_STATUS_T startAdvertising();
 
+    /**
+     * @brief   Send the current ADV data to the controller without
+     *           restarting advertising
+     *
+     * @return  BLE_STATUS_T       0 - Success. Others - error code
+     *
+     * @note  Does nothing when not advertising. Stops and restarts
+     *         advertising with a libarc32drv lacking bt_le_adv_update()
+     */
+    BLE_STATUS_T updateAdvertising();
+
     bool advertising();
     
     /**
@@ -293,6 +342,11 @@ class BLEDeviceManager
     void setAdvertiseCritical(String name);
     void setAdvertiseCritical(BLEService& service);
     void setAdvertiseCritical(const char* macaddress);
+    void setScanFilterRssi(int8_t rssi);
+    void setScanFilterNamePrefix(String prefix);
+    void setScanFilterManufacturer(uint16_t companyId);
+    void clearScanFilters();
+    bool setScanParameters(uint16_t interval, uint16_t window, uint8_t type);
     bool startScanningNewPeripherals(); // start scanning for new peripherals, don't report the detected ones
     bool startScanningWithDuplicates(); // start scanning for peripherals, and report all duplicates
     bool stopScanning(); // stop scanning for peripherals
@@ -311,8 +365,15 @@ class BLEDeviceManager
     String localName(const BLEDevice* device) const; // returns the advertised local name as a String
     String advertisedServiceUuid(const BLEDevice* device) const; // returns the advertised service as a UUID String
     String advertisedServiceUuid(const BLEDevice* device, int index) const; // returns the nth advertised service as a UUID String
+    // as above but copy into caller storage, NUL terminated and truncated
+    // to fit; return the number of characters copied
+    int localName(const BLEDevice* device, char *buffer, int size) const;
+    int advertisedServiceUuid(const BLEDevice* device, int index, char *buffer, int size) const;
 
     int rssi(const BLEDevice* device) const; // returns the RSSI of the peripheral at discovery
+    // point data into the kept ADV / scan response, no copy; return the length
+    int advertisementData(const BLEDevice* device, const uint8_t* &data) const;
+    int scanResponseData(const BLEDevice* device, const uint8_t* &data) const;
 
     bool connect(BLEDevice &device); // connect to the peripheral
     bool connectToDevice(BLEDevice &device);
@@ -342,9 +403,12 @@ private:
                                    uint8_t length);
     BLE_STATUS_T _advDataInit(void);
     void _clearAdvertiseBuffer();
-    bool advertiseDataProc(uint8_t type, 
-                           const uint8_t *dataPtr, 
-                           uint8_t data_len);
+    uint8_t advertiseDataProc(uint8_t type, 
+                              const uint8_t *dataPtr, 
+                              uint8_t data_len);
+    uint8_t findAdvertiseBuffer(const bt_addr_le_t* bt_addr) const;
+    uint8_t allocAdvertiseBuffer(uint64_t timestamp);
+    void queueAdvertiseBuffer(uint8_t index);
     bool setAdvertiseBuffer(const bt_addr_le_t* bt_addr,
                             const uint8_t *ad, 
                             uint8_t data_len,
@@ -367,6 +431,7 @@ private:
     bool disconnectSingle(const bt_addr_le_t *peer);
     void updateDuplicateFilter(const bt_addr_le_t* addr);    
     bool deviceInDuplicateFilterBuffer(const bt_addr_le_t* addr);
+    static uint8_t duplicateFilterHash(const bt_addr_le_t* addr);
     void advertiseAcceptHandler(const bt_addr_le_t *addr, 
                                 int8_t rssi, 
                                 uint8_t type,
@@ -395,6 +460,12 @@ private:
     int8_t     _peer_scan_rsp_data_len[BLE_MAX_ADV_BUFFER_CFG];
     int8_t     _peer_adv_rssi[BLE_MAX_ADV_BUFFER_CFG];
     bool       _peer_adv_connectable[BLE_MAX_ADV_BUFFER_CFG];
+    uint8_t    _peer_adv_next;      // Where to look first for a free slot
+    // The complete results not yet taken by available(), oldest first
+    uint8_t    _peer_adv_ready[BLE_MAX_ADV_BUFFER_CFG];
+    uint8_t    _peer_adv_ready_head;
+    uint8_t    _peer_adv_ready_count;
+    bool       _peer_adv_queued[BLE_MAX_ADV_BUFFER_CFG];
     
     // The accept critical may include in scan response
     bt_addr_le_t _peer_temp_adv_buffer[BLE_MAX_ADV_BUFFER_CFG];
@@ -408,6 +479,11 @@ private:
     String  _adv_critical_local_name;
     bt_uuid_128_t _adv_critical_service_uuid;
     bt_addr_le_t _adv_accept_device;
+    // Early filters, checked before anything is buffered
+    uint8_t     _scan_filters;          // SCAN_FILTER_* set
+    int8_t      _scan_filter_rssi;
+    String      _scan_filter_name;
+    uint16_t    _scan_filter_company;
     
     bt_addr_le_t _wait_for_connect_peripheral;
     uint8_t    _wait_for_connect_peripheral_adv_data[BLE_MAX_ADV_SIZE];
@@ -416,13 +492,10 @@ private:
     uint8_t    _wait_for_connect_peripheral_scan_rsp_data_len;
     int8_t     _wait_for_connect_peripheral_adv_rssi;
     
+    // The device last returned by available(). Its slot is not reused or
+    //  updated until the next one is returned, so it is read in place
     bt_addr_le_t _available_for_connect_peripheral;
-    uint8_t    _available_for_connect_peripheral_adv_data[BLE_MAX_ADV_SIZE];
-    uint8_t    _available_for_connect_peripheral_adv_data_len;
-    uint8_t    _available_for_connect_peripheral_scan_rsp_data[BLE_MAX_ADV_SIZE];
-    uint8_t    _available_for_connect_peripheral_scan_rsp_data_len;
-    int8_t     _available_for_connect_peripheral_adv_rssi;
-    bool       _available_for_connect_peripheral_connectable;
+    uint8_t    _available_for_connect_index;
     volatile bool    _connecting;
     
     // For peripheral
@@ -441,6 +514,7 @@ private:
     
     // ADV data for peripheral
     uint8_t     _adv_type;
+    bool        _adv_data_valid;    // _adv_data/_scan_rsp_data match the settings
     bt_data_t   _adv_data[6];  // KW: fount _advDataInit() can use 6 slots.
     size_t      _adv_data_idx;
     bt_data_t   _scan_rsp_data[6];
@@ -468,13 +542,16 @@ private:
     uint8_t    _peer_peripheral_adv_data_len[BLE_MAX_CONN_CFG];
     uint8_t    _peer_peripheral_scan_rsp_data[BLE_MAX_CONN_CFG][BLE_MAX_ADV_SIZE];
     uint8_t    _peer_peripheral_scan_rsp_data_len[BLE_MAX_CONN_CFG];
-    uint8_t    _peer_peripheral_adv_rssi[BLE_MAX_CONN_CFG];
+    int8_t     _peer_peripheral_adv_rssi[BLE_MAX_CONN_CFG];
+    // Open addressed set of the reported devices, and when each was
+    //  reported. An empty address ends a probe
     bt_addr_le_t _peer_duplicate_address_buffer[BLE_MAX_ADV_FILTER_SIZE_CFG];
-    uint8_t     _duplicate_filter_header;
-    uint8_t     _duplicate_filter_tail;
+    uint32_t    _peer_duplicate_mill[BLE_MAX_ADV_FILTER_SIZE_CFG];
     bool        _adv_duplicate_filter_enabled;
 
     BLEDeviceEventHandler _device_events[BLEDeviceLastEvent];
+    // Takes the scan reports instead of the ADV buffers
+    volatile BLEScanReportHandler _scan_report_handler;
 };
 
 #endif
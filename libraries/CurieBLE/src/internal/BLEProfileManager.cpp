@@ -46,25 +46,43 @@ BLEProfileManager::BLEProfileManager ():
     _discover_rsp_timestamp(0),
     _cur_discover_service(NULL),
     _discover_one_service(false),
-    _reading(false),
     _attr_base(NULL),
     _attr_index(0),
+    _static_attrs(NULL),
+    _static_attr_count(0),
     _profile_registered(false),
-    _disconnect_bitmap(0)
+    _disconnect_bitmap(0),
+    _discovery_cache(NULL),
+    _discovery_cache_stamp(0),
+    _discover_from_cache(false),
+    _lazy_discovery(false),
+    _discover_chrc_filter(false),
+    _lazy_discover_chrc(NULL)
 {
     //memset(_service_header_array, 0, sizeof(_service_header_array));
     memset(_discover_params, 0, sizeof(_discover_params));
     memset(_discover_uuid, 0, sizeof(_discover_uuid));
+    memset(&_discover_chrc_uuid, 0, sizeof(_discover_chrc_uuid));
     
     memset(_addresses, 0, sizeof(_addresses));
     memset(&_discovering_ble_addresses, 0, sizeof(_discovering_ble_addresses));
-    memset(&_read_params, 0, sizeof(_read_params));
+    memset(_read_params, 0, sizeof(_read_params));
+    memset(_reading, 0, sizeof(_reading));
     memset(&_read_service_header, 0, sizeof(_read_service_header));
     bt_addr_le_copy(&_addresses[BLE_MAX_CONN_CFG], BLEUtils::bleGetLoalAddress());
     for (int i = 0; i <= BLE_MAX_CONN_CFG; i++)
     {
         _service_header_array[i].next = NULL;
         _service_header_array[i].value = NULL;
+        _service_header_array[i].last = NULL;
+        _service_header_array[i].count = 0;
+    }
+    for (int i = 0; i < BLE_MAX_CONN_CFG; i++)
+    {
+        _handle_index[i] = (AttributeIndex_t *)NULL;
+        _handle_index_count[i] = 0;
+        _handle_index_size[i] = 0;
+        _handle_index_valid[i] = false;
     }
     
     pr_debug(LOG_MODULE_BLE, "%s-%d: Construct", __FUNCTION__, __LINE__);
@@ -83,6 +101,19 @@ BLEProfileManager::~BLEProfileManager (void)
         link_node_remove_first(&_read_service_header);
         node = link_node_get_first(&_read_service_header);
     }
+    for (int i = 0; i < BLE_MAX_CONN_CFG; i++)
+    {
+        if (_handle_index[i])
+        {
+            free(_handle_index[i]);
+            _handle_index[i] = (AttributeIndex_t *)NULL;
+        }
+    }
+    if (_discovery_cache)
+    {
+        free(_discovery_cache);
+        _discovery_cache = (DiscoveryCache_t *)NULL;
+    }
 }
 
 BLEServiceImp *
@@ -128,6 +159,7 @@ BLEProfileManager::addService (BLEDevice &bledevice, BLEService& service)
         return NULL;
     }
     link_node_insert_last(serviceheader, node);
+    invalidateIndex(serviceheader - _service_header_array);
     pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
     return serviceImp;
 }
@@ -239,6 +271,39 @@ int BLEProfileManager::serviceCount(const BLEDevice &bledevice) const
     return link_list_size(serviceHeader);
 }
 
+int BLEProfileManager::addAttributeTable(BLEDevice &bledevice,
+                                         const bt_gatt_attr_t* attrs,
+                                         int count)
+{
+    if ((bt_addr_le_cmp(bledevice.bt_le_address(), &_addresses[BLE_MAX_CONN_CFG]) != 0))
+    {
+        return BLE_STATUS_FORBIDDEN;
+    }
+    if (_profile_registered || NULL != _static_attrs)
+    {
+        return BLE_STATUS_WRONG_STATE;
+    }
+    if (NULL == attrs || count <= 0)
+    {
+        return BLE_STATUS_NOT_ALLOWED;
+    }
+    _static_attrs = attrs;
+    _static_attr_count = count;
+    return BLE_STATUS_SUCCESS;
+}
+
+int BLEProfileManager::registerAttributeTable()
+{
+    if (NULL == _static_attrs)
+    {
+        return 0;
+    }
+    // Nothing to build: the stack only reads the table and keeps
+    //  pointers into it, so it can stay in flash
+    return bt_gatt_register((bt_gatt_attr_t *)_static_attrs,
+                            _static_attr_count);
+}
+
 int BLEProfileManager::registerProfile(BLEDevice &bledevice)
 {
     int ret = 0;
@@ -256,7 +321,16 @@ int BLEProfileManager::registerProfile(BLEDevice &bledevice)
     int attr_counter = getAttributeCount(bledevice);
     if (0 == attr_counter)
     {
-        return BLE_STATUS_NO_SERVICE;
+        if (NULL == _static_attrs)
+        {
+            return BLE_STATUS_NO_SERVICE;
+        }
+        ret = registerAttributeTable();
+        if (0 == ret)
+        {
+            _profile_registered = true;
+        }
+        return ret;
     }
     
     if (NULL == _attr_base)
@@ -309,6 +383,11 @@ int BLEProfileManager::registerProfile(BLEDevice &bledevice)
     // End for debug
 #endif
     
+    ret = registerAttributeTable();
+    if (0 != ret)
+    {
+        return ret;
+    }
     ret = bt_gatt_register(_attr_base,
                             _attr_index);
     pr_debug(LOG_MODULE_APP, "%s: ret, %d,_attr_index-%d", __FUNCTION__, ret, _attr_index);
@@ -326,6 +405,7 @@ void BLEProfileManager::clearProfile(BLEServiceLinkNodeHeader* serviceHeader)
         return;
     }
     
+    invalidateIndex(serviceHeader - _service_header_array);
     BLEServiceNodePtr node = link_node_get_first(serviceHeader);
     
     while (NULL != node)
@@ -340,6 +420,16 @@ void BLEProfileManager::clearProfile(BLEServiceLinkNodeHeader* serviceHeader)
 BLEDescriptorImp* BLEProfileManager::descriptor(const BLEDevice &bledevice, uint16_t handle)
 {
     BLEDescriptorImp* descriptorImp = NULL;
+    if (getDeviceIndex(&bledevice) < BLE_MAX_CONN_CFG)
+    {
+        const AttributeIndex_t* entry = findHandle(bledevice, handle);
+        if (NULL != entry && BLETypeDescriptor == entry->attr->type())
+        {
+            descriptorImp = (BLEDescriptorImp*)entry->attr;
+        }
+        return descriptorImp;
+    }
+    
     BLEServiceLinkNodeHeader* serviceHeader = getServiceHeader(bledevice);
     if (NULL == serviceHeader)
     {
@@ -395,6 +485,16 @@ BLECharacteristicImp* BLEProfileManager::characteristic(const BLEDevice &bledevi
 BLECharacteristicImp* BLEProfileManager::characteristic(const BLEDevice &bledevice, uint16_t handle)
 {
     BLECharacteristicImp* characteristicImp = NULL;
+    if (getDeviceIndex(&bledevice) < BLE_MAX_CONN_CFG)
+    {
+        const AttributeIndex_t* entry = findHandle(bledevice, handle);
+        if (NULL != entry && BLETypeCharacteristic == entry->attr->type())
+        {
+            characteristicImp = (BLECharacteristicImp*)entry->attr;
+        }
+        return characteristicImp;
+    }
+    
     BLEServiceLinkNodeHeader* serviceHeader = getServiceHeader(bledevice);
     if (NULL == serviceHeader)
     {
@@ -434,6 +534,14 @@ BLECharacteristicImp* BLEProfileManager::characteristic(const BLEDevice &bledevi
 
 BLECharacteristicImp* BLEProfileManager::characteristic(const BLEDevice &bledevice, 
                                                         const char* uuid)
+{
+    bt_uuid_128_t uuid_tmp;
+    BLEUtils::uuidString2BT(uuid, (bt_uuid_t *)&uuid_tmp);
+    return characteristic(bledevice, (const bt_uuid_t *)&uuid_tmp);
+}
+
+BLECharacteristicImp* BLEProfileManager::characteristic(const BLEDevice &bledevice, 
+                                                        const bt_uuid_t* uuid)
 {
     BLECharacteristicImp* characteristicImp = NULL;
     BLEServiceLinkNodeHeader* serviceHeader = getServiceHeader(bledevice);
@@ -477,11 +585,6 @@ BLEServiceImp* BLEProfileManager::service(const BLEDevice &bledevice, const bt_u
     }
     BLEServiceNodePtr node = serviceHeader->next;
     
-    // Just for debug
-    char uuid_tmp[37];
-    BLEUtils::uuidBT2String(uuid, uuid_tmp);
-    pr_debug(LOG_MODULE_BLE, "%s-%d: %s", __FUNCTION__, __LINE__, uuid_tmp);
-    
     while (node != NULL)
     {
         serviceImp = node->value;
@@ -537,6 +640,16 @@ BLEServiceImp* BLEProfileManager::getServiceBySubHandle(const BLEDevice &bledevi
     uint16_t start_handle;
     uint16_t end_handle;
 
+    if (getDeviceIndex(&bledevice) < BLE_MAX_CONN_CFG)
+    {
+        // Exact hits only; other handles in the service take the walk
+        const AttributeIndex_t* entry = findHandle(bledevice, handle);
+        if (NULL != entry)
+        {
+            return entry->service;
+        }
+    }
+
     const BLEServiceLinkNodeHeader* serviceHeader = getServiceHeader(bledevice);
     if (NULL == serviceHeader)
     {
@@ -589,6 +702,7 @@ void BLEProfileManager::handleDisconnectedEvent(const bt_addr_le_t* deviceAddr)
         if ((bt_addr_le_cmp(deviceAddr, &_addresses[i]) == 0))
         {
             bitSet(_disconnect_bitmap, i);
+            _reading[i] = false;
             break;
         }
     }
@@ -654,6 +768,10 @@ bool BLEProfileManager::discoverAttributes(BLEDevice* device)
     temp->uuid = NULL;
     temp->type = BT_GATT_DISCOVER_PRIMARY;
     temp->func = profile_discover_process;
+    // A known peer: only the primary services are discovered, to check
+    //  the cached profile against
+    _discover_from_cache = (NULL != findDiscoveryCache(device->bt_le_address()));
+    _discover_chrc_filter = false;
     
     err = bt_gatt_discover(conn, temp);
     bt_conn_unref(conn);
@@ -669,14 +787,14 @@ bool BLEProfileManager::discoverAttributes(BLEDevice* device)
     ret = true;
     while (_start_discover)  // Sid. KW warning acknowldged
     {
-        delay(10);
+        BLEUtils::waitForEvent();
         if ((millis() - _discover_rsp_timestamp) > 5000)
         {
             // Doesn't receive the Service read response
             _start_discover = false;
             _cur_discover_service = NULL;
             ret = false;
-            _reading = false;
+            _reading[i] = false;
         }
         
         if (ENOMEM == errno)
@@ -686,10 +804,16 @@ bool BLEProfileManager::discoverAttributes(BLEDevice* device)
             break;
         }
     }
+    if (ret)
+    {
+        saveDiscoveryCache(*device);
+    }
     return ret;
 }
 
-bool BLEProfileManager::discoverAttributesByService(BLEDevice* device, const bt_uuid_t* svc_uuid)
+bool BLEProfileManager::discoverAttributesByService(BLEDevice* device, 
+                                                    const bt_uuid_t* svc_uuid,
+                                                    const bt_uuid_t* chrc_uuid)
 {
     errno = 0;
     if (_start_discover)
@@ -697,10 +821,17 @@ bool BLEProfileManager::discoverAttributesByService(BLEDevice* device, const bt_
         // Already in discover state
         return false;
     }
+    _discover_from_cache = false;
+    _discover_chrc_filter = (NULL != chrc_uuid);
+    if (_discover_chrc_filter)
+    {
+        memcpy(&_discover_chrc_uuid, chrc_uuid, sizeof(_discover_chrc_uuid));
+    }
     
     bool ret = discoverService(device, svc_uuid);
     if (false == ret)
     {
+        _discover_chrc_filter = false;
         return false;
     }
     // Block it 
@@ -711,14 +842,18 @@ bool BLEProfileManager::discoverAttributesByService(BLEDevice* device, const bt_
     
     while (_start_discover)  // Sid. KW warning acknowldged
     {
-        delay(10);
+        BLEUtils::waitForEvent();
         if ((millis() - _discover_rsp_timestamp) > 5000)
         {
             // Doesn't receive the Service read response
             _start_discover = false;
             _cur_discover_service = NULL;
             ret = false;
-            _reading = false;
+            int index = getDeviceIndex(device);
+            if (index < BLE_MAX_CONN_CFG)
+            {
+                _reading[index] = false;
+            }
         }
         
         if (ENOMEM == errno)
@@ -730,12 +865,418 @@ bool BLEProfileManager::discoverAttributesByService(BLEDevice* device, const bt_
     }
     pr_debug(LOG_MODULE_BLE, "%s-%d:Discover Done", __FUNCTION__, __LINE__);
     _discover_one_service = false;
+    _discover_chrc_filter = false;
     
     return ret;
 }
 
+bool BLEProfileManager::characteristicWanted(const bt_uuid_t* uuid) const
+{
+    return (false == _discover_chrc_filter ||
+            0 == bt_uuid_cmp(uuid, (const bt_uuid_t*)&_discover_chrc_uuid));
+}
+
+bool BLEProfileManager::discoverDescriptors(BLEDevice &bledevice, 
+                                            BLECharacteristicImp* characteristicImp)
+{
+    errno = 0;
+    if (_start_discover)
+    {
+        // Already in discover state
+        return false;
+    }
+    
+    _lazy_discover_chrc = characteristicImp;
+    if (false == characteristicImp->discoverAttributes(&bledevice))
+    {
+        _lazy_discover_chrc = NULL;
+        return false;
+    }
+    // Block it 
+    bool ret = true;
+    memcpy(&_discovering_ble_addresses, bledevice.bt_le_address(), sizeof(_discovering_ble_addresses));
+    _discover_rsp_timestamp = millis();
+    _start_discover = true;
+    while (_start_discover)
+    {
+        BLEUtils::waitForEvent();
+        if ((millis() - _discover_rsp_timestamp) > 5000)
+        {
+            _start_discover = false;
+            ret = false;
+        }
+    }
+    _lazy_discover_chrc = NULL;
+    if (ret && ENOMEM != errno)
+    {
+        // Keep the descriptors for the next connection too
+        characteristicImp->_descriptors_pending = false;
+        saveDiscoveryCache(bledevice);
+    }
+    return (ret && ENOMEM != errno);
+}
+
+
+// A discovery cache record is the peer's profile in list order. Each
+//  attribute is a tag, its handles and properties, then its UUID as its
+//  length (2 or 16) and value.
+#define DISCOVERY_CACHE_SERVICE         'S' // Start and end handle
+#define DISCOVERY_CACHE_CHARACTERISTIC  'C' // Value handle, properties, CCCD handle
+#define DISCOVERY_CACHE_DESCRIPTOR      'D' // Handle, permissions
+// The CCCD handle of a characteristic whose descriptors lazy discovery
+//  left out
+#define DISCOVERY_CACHE_UNRESOLVED      0xFFFF
+
+static bool discoveryCachePut(uint8_t* data, int &pos, const void* src, int len)
+{
+    if (pos + len > BLE_DISCOVERY_CACHE_SIZE_CFG)
+    {
+        return false;
+    }
+    memcpy(data + pos, src, len);
+    pos += len;
+    return true;
+}
+
+static bool discoveryCachePutUuid(uint8_t* data, int &pos, const bt_uuid_t* uuid)
+{
+    uint8_t len = UUID_SIZE_128;
+    const void* val = BT_UUID_128(uuid)->val;
+    if (BT_UUID_TYPE_16 == uuid->type)
+    {
+        len = UUID_SIZE_16;
+        val = &BT_UUID_16(uuid)->val;
+    }
+    return (discoveryCachePut(data, pos, &len, sizeof(len)) &&
+            discoveryCachePut(data, pos, val, len));
+}
+
+static bool discoveryCacheGet(const uint8_t* data, int length, int &pos, void* dst, int len)
+{
+    if (pos + len > length)
+    {
+        return false;
+    }
+    memcpy(dst, data + pos, len);
+    pos += len;
+    return true;
+}
+
+static bool discoveryCacheGetUuid(const uint8_t* data, int length, int &pos, bt_uuid_128_t* uuid)
+{
+    uint8_t len = 0;
+    memset(uuid, 0, sizeof(bt_uuid_128_t));
+    if (false == discoveryCacheGet(data, length, pos, &len, sizeof(len)))
+    {
+        return false;
+    }
+    if (UUID_SIZE_16 == len)
+    {
+        uuid->uuid.type = BT_UUID_TYPE_16;
+        return discoveryCacheGet(data, length, pos, 
+                                 &((bt_uuid_16_t*)uuid)->val, UUID_SIZE_16);
+    }
+    if (UUID_SIZE_128 == len)
+    {
+        uuid->uuid.type = BT_UUID_TYPE_128;
+        return discoveryCacheGet(data, length, pos, uuid->val, UUID_SIZE_128);
+    }
+    return false;
+}
+
+DiscoveryCache_t* BLEProfileManager::findDiscoveryCache(const bt_addr_le_t* address) const
+{
+    if (NULL == _discovery_cache)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < BLE_DISCOVERY_CACHE_CFG; i++)
+    {
+        if (_discovery_cache[i].length > 0 &&
+            bt_addr_le_cmp(address, &_discovery_cache[i].address) == 0)
+        {
+            return &_discovery_cache[i];
+        }
+    }
+    return NULL;
+}
+
+DiscoveryCache_t* BLEProfileManager::allocDiscoveryCache(const bt_addr_le_t* address)
+{
+    if (BLE_DISCOVERY_CACHE_CFG <= 0)
+    {
+        return NULL;
+    }
+    if (NULL == _discovery_cache)
+    {
+        _discovery_cache = (DiscoveryCache_t *)malloc(BLE_DISCOVERY_CACHE_CFG * sizeof(DiscoveryCache_t));
+        if (NULL == _discovery_cache)
+        {
+            return NULL;
+        }
+        memset(_discovery_cache, 0, BLE_DISCOVERY_CACHE_CFG * sizeof(DiscoveryCache_t));
+    }
+    
+    DiscoveryCache_t* entry = findDiscoveryCache(address);
+    if (NULL == entry)
+    {
+        // An unused entry, or the one used longest ago
+        entry = &_discovery_cache[0];
+        for (int i = 0; i < BLE_DISCOVERY_CACHE_CFG; i++)
+        {
+            if (0 == _discovery_cache[i].length)
+            {
+                entry = &_discovery_cache[i];
+                break;
+            }
+            if (_discovery_cache_stamp - _discovery_cache[i].stamp >
+                _discovery_cache_stamp - entry->stamp)
+            {
+                entry = &_discovery_cache[i];
+            }
+        }
+        bt_addr_le_copy(&entry->address, address);
+    }
+    entry->length = 0;
+    entry->stamp = ++_discovery_cache_stamp;
+    return entry;
+}
+
+void BLEProfileManager::saveDiscoveryCache(const BLEDevice &bledevice)
+{
+    const BLEServiceLinkNodeHeader* serviceHeader = getServiceHeader(bledevice);
+    if (NULL == serviceHeader)
+    {
+        return;
+    }
+    DiscoveryCache_t* entry = allocDiscoveryCache(bledevice.bt_le_address());
+    if (NULL == entry)
+    {
+        return;
+    }
+    
+    uint8_t* data = entry->data;
+    int pos = 0;
+    bool fit = true;
+    for (BLEServiceNodePtr node = serviceHeader->next; 
+         NULL != node && fit; 
+         node = node->next)
+    {
+        BLEServiceImp* serviceImp = node->value;
+        uint8_t tag = DISCOVERY_CACHE_SERVICE;
+        uint16_t start = serviceImp->startHandle();
+        uint16_t end = serviceImp->endHandle();
+        fit = (discoveryCachePut(data, pos, &tag, sizeof(tag)) &&
+               discoveryCachePut(data, pos, &start, sizeof(start)) &&
+               discoveryCachePut(data, pos, &end, sizeof(end)) &&
+               discoveryCachePutUuid(data, pos, serviceImp->bt_uuid()));
+        
+        for (BLEServiceImp::BLECharacteristicNodePtr chrcNode = serviceImp->_characteristics_header.next;
+             NULL != chrcNode && fit;
+             chrcNode = chrcNode->next)
+        {
+            BLECharacteristicImp* chrcImp = chrcNode->value;
+            uint16_t handle = chrcImp->valueHandle();
+            uint16_t cccd = chrcImp->_descriptors_pending ? 
+                            DISCOVERY_CACHE_UNRESOLVED : chrcImp->cccdHandle();
+            uint8_t properties = chrcImp->properties();
+            tag = DISCOVERY_CACHE_CHARACTERISTIC;
+            fit = (discoveryCachePut(data, pos, &tag, sizeof(tag)) &&
+                   discoveryCachePut(data, pos, &handle, sizeof(handle)) &&
+                   discoveryCachePut(data, pos, &properties, sizeof(properties)) &&
+                   discoveryCachePut(data, pos, &cccd, sizeof(cccd)) &&
+                   discoveryCachePutUuid(data, pos, chrcImp->bt_uuid()));
+            
+            for (BLECharacteristicImp::BLEDescriptorNodePtr descNode = chrcImp->_descriptors_header.next;
+                 NULL != descNode && fit;
+                 descNode = descNode->next)
+            {
+                BLEDescriptorImp* descImp = descNode->value;
+                handle = descImp->valueHandle();
+                properties = descImp->properties();
+                tag = DISCOVERY_CACHE_DESCRIPTOR;
+                fit = (discoveryCachePut(data, pos, &tag, sizeof(tag)) &&
+                       discoveryCachePut(data, pos, &handle, sizeof(handle)) &&
+                       discoveryCachePut(data, pos, &properties, sizeof(properties)) &&
+                       discoveryCachePutUuid(data, pos, descImp->bt_uuid()));
+            }
+        }
+    }
+    // A profile too large for the entry isn't cached
+    entry->length = fit ? pos : 0;
+}
+
+// Walks a record, checking it is well formed. With serviceHeader its
+//  services must be the ones in the list, in order; with apply too their
+//  characteristics and descriptors are added to them.
+bool BLEProfileManager::walkDiscoveryCache(BLEDevice &bledevice,
+                                           const uint8_t* data,
+                                           int length,
+                                           const BLEServiceLinkNodeHeader* serviceHeader,
+                                           bool apply)
+{
+    BLEServiceNodePtr node = (NULL == serviceHeader) ? NULL : serviceHeader->next;
+    BLEServiceImp* serviceImp = NULL;
+    BLECharacteristicImp* chrcImp = NULL;
+    bool inService = false;
+    bool inCharacteristic = false;
+    int pos = 0;
+    
+    while (pos < length)
+    {
+        uint8_t tag = 0;
+        uint16_t handle = 0;
+        uint16_t handle2 = 0;
+        uint8_t properties = 0;
+        bt_uuid_128_t uuid;
+        
+        discoveryCacheGet(data, length, pos, &tag, sizeof(tag));
+        switch (tag)
+        {
+            case DISCOVERY_CACHE_SERVICE:
+            {
+                if (false == discoveryCacheGet(data, length, pos, &handle, sizeof(handle)) ||
+                    false == discoveryCacheGet(data, length, pos, &handle2, sizeof(handle2)) ||
+                    false == discoveryCacheGetUuid(data, length, pos, &uuid))
+                {
+                    return false;
+                }
+                if (NULL != serviceHeader)
+                {
+                    if (NULL == node)
+                    {
+                        return false;
+                    }
+                    serviceImp = node->value;
+                    if (serviceImp->startHandle() != handle ||
+                        serviceImp->endHandle() != handle2 ||
+                        false == serviceImp->compareUuid((bt_uuid_t*)&uuid))
+                    {
+                        return false;
+                    }
+                    node = node->next;
+                }
+                inService = true;
+                inCharacteristic = false;
+                break;
+            }
+            case DISCOVERY_CACHE_CHARACTERISTIC:
+            {
+                if (false == inService ||
+                    false == discoveryCacheGet(data, length, pos, &handle, sizeof(handle)) ||
+                    false == discoveryCacheGet(data, length, pos, &properties, sizeof(properties)) ||
+                    false == discoveryCacheGet(data, length, pos, &handle2, sizeof(handle2)) ||
+                    false == discoveryCacheGetUuid(data, length, pos, &uuid))
+                {
+                    return false;
+                }
+                if (apply && NULL != serviceImp)
+                {
+                    if (BLE_STATUS_SUCCESS != serviceImp->addCharacteristic(bledevice, 
+                                                                            (bt_uuid_t*)&uuid, 
+                                                                            handle, 
+                                                                            properties))
+                    {
+                        errno = ENOMEM;
+                        return false;
+                    }
+                    chrcImp = serviceImp->characteristic(handle);
+                    if (NULL != chrcImp)
+                    {
+                        chrcImp->_descriptors_pending = (DISCOVERY_CACHE_UNRESOLVED == handle2);
+                        chrcImp->setCCCDHandle(chrcImp->_descriptors_pending ? 0 : handle2);
+                    }
+                }
+                inCharacteristic = true;
+                break;
+            }
+            case DISCOVERY_CACHE_DESCRIPTOR:
+            {
+                if (false == inCharacteristic ||
+                    false == discoveryCacheGet(data, length, pos, &handle, sizeof(handle)) ||
+                    false == discoveryCacheGet(data, length, pos, &properties, sizeof(properties)) ||
+                    false == discoveryCacheGetUuid(data, length, pos, &uuid))
+                {
+                    return false;
+                }
+                if (apply && NULL != chrcImp &&
+                    BLE_STATUS_SUCCESS != chrcImp->addDescriptor((bt_uuid_t*)&uuid, 
+                                                                 properties, 
+                                                                 handle))
+                {
+                    errno = ENOMEM;
+                    return false;
+                }
+                break;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+    return (NULL == node);
+}
+
+bool BLEProfileManager::restoreDiscoveryCache(BLEDevice &bledevice)
+{
+    DiscoveryCache_t* entry = findDiscoveryCache(bledevice.bt_le_address());
+    const BLEServiceLinkNodeHeader* serviceHeader = getServiceHeader(bledevice);
+    if (NULL == entry || NULL == serviceHeader)
+    {
+        return false;
+    }
+    
+    if (false == walkDiscoveryCache(bledevice, entry->data, entry->length, serviceHeader, false))
+    {
+        // The peer's profile changed
+        entry->length = 0;
+        return false;
+    }
+    invalidateIndex(getDeviceIndex(&bledevice));
+    entry->stamp = ++_discovery_cache_stamp;
+    return walkDiscoveryCache(bledevice, entry->data, entry->length, serviceHeader, true);
+}
+
+int BLEProfileManager::discoveryCache(const BLEDevice &bledevice, uint8_t* buffer, int size) const
+{
+    const DiscoveryCache_t* entry = findDiscoveryCache(bledevice.bt_le_address());
+    if (NULL == entry || entry->length > size)
+    {
+        return 0;
+    }
+    memcpy(buffer, entry->data, entry->length);
+    return entry->length;
+}
+
+bool BLEProfileManager::setDiscoveryCache(const BLEDevice &bledevice, const uint8_t* buffer, int length)
+{
+    BLEDevice device(bledevice);
+    if (length <= 0 || length > BLE_DISCOVERY_CACHE_SIZE_CFG ||
+        false == walkDiscoveryCache(device, buffer, length, NULL, false))
+    {
+        return false;
+    }
+    DiscoveryCache_t* entry = allocDiscoveryCache(bledevice.bt_le_address());
+    if (NULL == entry)
+    {
+        return false;
+    }
+    memcpy(entry->data, buffer, length);
+    entry->length = length;
+    return true;
+}
+
+void BLEProfileManager::clearDiscoveryCache(const BLEDevice &bledevice)
+{
+    DiscoveryCache_t* entry = findDiscoveryCache(bledevice.bt_le_address());
+    if (NULL != entry)
+    {
+        entry->length = 0;
+    }
+}
 
-int BLEProfileManager::getDeviceIndex(const bt_addr_le_t* macAddr)
+int BLEProfileManager::getDeviceIndex(const bt_addr_le_t* macAddr) const
 {
     int i;
     for (i = 0; i < BLE_MAX_CONN_CFG; i++)
@@ -748,11 +1289,133 @@ int BLEProfileManager::getDeviceIndex(const bt_addr_le_t* macAddr)
     return i;
 }
 
-int BLEProfileManager::getDeviceIndex(const BLEDevice* device)
+int BLEProfileManager::getDeviceIndex(const BLEDevice* device) const
 {
     return getDeviceIndex(device->bt_le_address());
 }
 
+void BLEProfileManager::invalidateIndex(int index)
+{
+    if (index >= 0 && index < BLE_MAX_CONN_CFG)
+    {
+        _handle_index_valid[index] = false;
+    }
+}
+
+bool BLEProfileManager::buildIndex(int index) const
+{
+    const BLEServiceLinkNodeHeader* serviceHeader = &_service_header_array[index];
+    BLEServiceNodePtr node;
+    int count = 0;
+    
+    for (node = serviceHeader->next; node != NULL; node = node->next)
+    {
+        BLEServiceImp *service = node->value;
+        count++;
+        for (BLEServiceImp::BLECharacteristicNodePtr chrcNode = service->_characteristics_header.next;
+             chrcNode != NULL;
+             chrcNode = chrcNode->next)
+        {
+            count += 1 + chrcNode->value->descriptorCount();
+        }
+    }
+    
+    if (count > _handle_index_size[index])
+    {
+        if (_handle_index[index])
+        {
+            free(_handle_index[index]);
+        }
+        _handle_index_size[index] = 0;
+        _handle_index[index] = (AttributeIndex_t *)malloc(count * sizeof(AttributeIndex_t));
+        if (NULL == _handle_index[index])
+        {
+            _handle_index_count[index] = 0;
+            return false;
+        }
+        _handle_index_size[index] = count;
+    }
+    
+    AttributeIndex_t *table = _handle_index[index];
+    int n = 0;
+    for (node = serviceHeader->next; node != NULL; node = node->next)
+    {
+        BLEServiceImp *service = node->value;
+        table[n].handle = service->startHandle();
+        table[n].attr = service;
+        table[n++].service = service;
+        for (BLEServiceImp::BLECharacteristicNodePtr chrcNode = service->_characteristics_header.next;
+             chrcNode != NULL;
+             chrcNode = chrcNode->next)
+        {
+            BLECharacteristicImp *chrc = chrcNode->value;
+            table[n].handle = chrc->valueHandle();
+            table[n].attr = chrc;
+            table[n++].service = service;
+            for (BLECharacteristicImp::BLEDescriptorNodePtr descNode = chrc->_descriptors_header.next;
+                 descNode != NULL;
+                 descNode = descNode->next)
+            {
+                table[n].handle = descNode->value->valueHandle();
+                table[n].attr = descNode->value;
+                table[n++].service = service;
+            }
+        }
+    }
+    
+    // Discovery runs in handle order, so this is close to linear
+    for (int i = 1; i < n; i++)
+    {
+        AttributeIndex_t entry = table[i];
+        int j = i;
+        while (j > 0 && table[j - 1].handle > entry.handle)
+        {
+            table[j] = table[j - 1];
+            j--;
+        }
+        table[j] = entry;
+    }
+    
+    _handle_index_count[index] = n;
+    _handle_index_valid[index] = true;
+    return true;
+}
+
+const AttributeIndex_t* BLEProfileManager::findHandle(const BLEDevice &bledevice, 
+                                                      uint16_t handle) const
+{
+    int index = getDeviceIndex(&bledevice);
+    if (index >= BLE_MAX_CONN_CFG)
+    {
+        return NULL;
+    }
+    if (!_handle_index_valid[index] && !buildIndex(index))
+    {
+        return NULL;
+    }
+    
+    const AttributeIndex_t *table = _handle_index[index];
+    int low = 0;
+    int high = _handle_index_count[index] - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) >> 1;
+        if (table[mid].handle == handle)
+        {
+            return &table[mid];
+        }
+        if (table[mid].handle < handle)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
 bool BLEProfileManager::discovering()
 {
     bool ret = _discovering;
@@ -778,12 +1441,25 @@ uint8_t BLEProfileManager::discoverResponseProc(bt_conn_t *conn,
     uint8_t retVal = BT_GATT_ITER_STOP;
     BLEServiceImp* service_tmp = NULL;
     _discover_rsp_timestamp = millis();
+    invalidateIndex(i);
     //pr_debug(LOG_MODULE_BLE, "%s-%d: index-%d", __FUNCTION__, __LINE__, i);
     
     if (i >= BLE_MAX_CONN_CFG)
     {
         return BT_GATT_ITER_STOP;
     }
+    
+    if (NULL != _lazy_discover_chrc && 
+        BT_GATT_DISCOVER_DESCRIPTOR == params->type)
+    {
+        retVal = _lazy_discover_chrc->discoverResponseProc(conn, attr, params);
+        if (BT_GATT_ITER_STOP == retVal)
+        {
+            _start_discover = false;
+            memset(&_discovering_ble_addresses, 0, sizeof(_discovering_ble_addresses));
+        }
+        return retVal;
+    }
 
     // Process the service
     switch (params->type)
@@ -819,7 +1495,16 @@ uint8_t BLEProfileManager::discoverResponseProc(bt_conn_t *conn,
                 }
                 else
                 {
-                    service_tmp = addService(device, svc_value->uuid);
+                    // One service may be discovered again, for another
+                    //  characteristic
+                    if (_discover_one_service)
+                    {
+                        service_tmp = service(device, svc_value->uuid);
+                    }
+                    if (NULL == service_tmp)
+                    {
+                        service_tmp = addService(device, svc_value->uuid);
+                    }
                     params->uuid = NULL;
                     
                     if (NULL != service_tmp)
@@ -909,6 +1594,25 @@ uint8_t BLEProfileManager::discoverResponseProc(bt_conn_t *conn,
                 // Doesn't find the service
                 return BT_GATT_ITER_STOP;
             }
+            
+            if (_discover_from_cache)
+            {
+                // The primary services are in. The rest comes from the
+                //  cache if they match it, else is discovered as usual.
+                _discover_from_cache = false;
+                if (restoreDiscoveryCache(device))
+                {
+                    pr_debug(LOG_MODULE_BLE, "%s-%d: Restored from cache", 
+                                         __FUNCTION__, __LINE__);
+                    _start_discover = false;
+                    memset(&_discovering_ble_addresses, 0, sizeof(_discovering_ble_addresses));
+                    return BT_GATT_ITER_STOP;
+                }
+                if (ENOMEM == errno)
+                {
+                    return BT_GATT_ITER_STOP;
+                }
+            }
             BLEServiceNodePtr node = serviceHeader->next;
             
             // Discover next service
@@ -990,16 +1694,18 @@ bool BLEProfileManager::readService(const BLEDevice &bledevice, uint16_t handle)
 {
     int retval = 0;
     bt_conn_t* conn = NULL;
+    int index = getDeviceIndex(&bledevice);
+    bt_gatt_read_params_t* params = NULL;
     
-    if (true == BLEUtils::isLocalBLE(bledevice))
+    if (true == BLEUtils::isLocalBLE(bledevice) || index >= BLE_MAX_CONN_CFG)
     {
         // GATT server can't write
         return false;
     }
     
-    if (_reading)
+    if (_reading[index])
     {
-        // Read response not back
+        // This peer's read response not back
         // Add to buffer
         ServiceRead_t temp;
         bt_addr_le_copy(&temp.address, bledevice.bt_le_address());
@@ -1009,12 +1715,13 @@ bool BLEProfileManager::readService(const BLEDevice &bledevice, uint16_t handle)
         return true;
     }
     
-    _read_params.func = profile_service_read_rsp_process;
-    _read_params.handle_count = 1;
-    _read_params.single.handle = handle;
-    _read_params.single.offset = 0;
+    params = &_read_params[index];
+    params->func = profile_service_read_rsp_process;
+    params->handle_count = 1;
+    params->single.handle = handle;
+    params->single.offset = 0;
     
-    if (0 == _read_params.single.handle)
+    if (0 == params->single.handle)
     {
         // Discover not complete
         return false;
@@ -1026,30 +1733,34 @@ bool BLEProfileManager::readService(const BLEDevice &bledevice, uint16_t handle)
         return false;
     }
     // Send read request
-    retval = bt_gatt_read(conn, &_read_params);
+    retval = bt_gatt_read(conn, params);
     bt_conn_unref(conn);
     if (0 == retval)
     {
         setDiscovering(true);
-        _reading = true;
+        _reading[index] = true;
     }
     pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
-    return _reading;
+    return _reading[index];
 }
 
 void BLEProfileManager::checkReadService()
 {
-    ServiceReadLinkNodePtr node = link_node_get_first(&_read_service_header);
-    while (NULL != node)
+    // Start the first waiting read of every idle peer. The reads of a
+    //  busy peer go back to the end of the queue, in their order.
+    int count = link_list_size(&_read_service_header);
+    while (count-- > 0)
     {
-        BLEDevice temp(&node->value.address);
-        bool readResult = readService(temp, node->value.handle);
-        link_node_remove_first(&_read_service_header);
-        if (true == readResult)
+        ServiceReadLinkNodePtr node = link_node_get_first(&_read_service_header);
+        if (NULL == node)
         {
             break;
         }
-        node = link_node_get_first(&_read_service_header);
+        ServiceRead_t value = node->value;
+        link_node_remove_first(&_read_service_header);
+        
+        BLEDevice temp(&value.address);
+        readService(temp, value.handle);
     }
 }
 
@@ -1109,13 +1820,19 @@ uint8_t BLEProfileManager::serviceReadRspProc(bt_conn_t *conn,
                                            const void *data, 
                                            uint16_t length)
 {
-    _reading = false;
+    const bt_addr_le_t* dst_addr = bt_conn_get_dst(conn);
+    int index = getDeviceIndex(dst_addr);
+    if (index < BLE_MAX_CONN_CFG)
+    {
+        _reading[index] = false;
+    }
     _discover_rsp_timestamp = millis();
     if (NULL == data)
     {
         return BT_GATT_ITER_STOP;
     }
-    BLEDevice bleDevice(bt_conn_get_dst(conn));
+    BLEDevice bleDevice(dst_addr);
+    invalidateIndex(index);
     
     pr_debug(LOG_MODULE_BLE, "%s-%d:length-%d", __FUNCTION__, __LINE__, length);
     if (length == UUID_SIZE_128)
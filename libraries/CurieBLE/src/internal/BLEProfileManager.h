@@ -32,6 +32,22 @@ typedef struct {
     uint16_t      handle;
 }ServiceRead_t;
 
+// One discovered attribute of a peer profile, keyed by handle: the service
+// start handle, the characteristic value handle or the descriptor handle
+typedef struct {
+    uint16_t      handle;
+    BLEAttribute  *attr;
+    BLEServiceImp *service;
+}AttributeIndex_t;
+
+// A peer's profile as last discovered, see BLEProfileManager::saveDiscoveryCache()
+typedef struct {
+    bt_addr_le_t  address;
+    uint16_t      length;   // 0 - unused
+    uint32_t      stamp;    // When last used, to pick the entry to replace
+    uint8_t       data[BLE_DISCOVERY_CACHE_SIZE_CFG];
+}DiscoveryCache_t;
+
 class BLEProfileManager{
 public:
     /**
@@ -73,6 +89,21 @@ public:
     
     inline bool hasRegisterProfile(){return _profile_registered;}
     
+    /**
+     * @brief   Set the compile time attribute table, registered as it is
+     *           by registerProfile() ahead of the services
+     *
+     * @param[in]   bledevice   The local BLE device
+     *
+     * @param[in]   attrs       The table
+     *
+     * @param[in]   count       The number of entries
+     *
+     * @return  int     BLE_STATUS_SUCCESS or the error
+     */
+    int addAttributeTable(BLEDevice &bledevice, const bt_gatt_attr_t* attrs, int count);
+    inline bool hasAttributeTable(){return NULL != _static_attrs;}
+    
     BLEDescriptorImp* descriptor(const BLEDevice &bledevice, uint16_t handle);
     /**
      * @brief   Get the BLE's Characteristic implementation object by uuid and index
@@ -92,6 +123,8 @@ public:
                                          int index);
     BLECharacteristicImp* characteristic(const BLEDevice &bledevice, 
                                          const char* uuid);
+    BLECharacteristicImp* characteristic(const BLEDevice &bledevice, 
+                                         const bt_uuid_t* uuid);
     BLECharacteristicImp* characteristic(const BLEDevice &bledevice, 
                                          int index);
     BLECharacteristicImp* characteristic(const BLEDevice &bledevice, 
@@ -108,10 +141,50 @@ public:
                                  bt_gatt_discover_params_t *params);
     
     bool discoverAttributes(BLEDevice* device);
-    bool discoverAttributesByService(BLEDevice* device, const bt_uuid_t* svc_uuid);
+    bool discoverAttributesByService(BLEDevice* device, 
+                                     const bt_uuid_t* svc_uuid,
+                                     const bt_uuid_t* chrc_uuid = NULL);
+    
+    /**
+     * @brief   Discover one characteristic's descriptors
+     *
+     * @param[in]   bledevice       The peer BLE device
+     *
+     * @param[in]   characteristicImp   A characteristic left by lazy discovery
+     *
+     * @return  bool    true - Done, false - Busy, failed or timed out
+     *
+     * @note  Blocks like discoverAttributes()
+     */
+    bool discoverDescriptors(BLEDevice &bledevice, BLECharacteristicImp* characteristicImp);
+    
+    // Leave the descriptors out of discovery, see BLEDevice::setLazyDiscovery()
+    inline void setLazyDiscovery(bool lazy){_lazy_discovery = lazy;}
+    inline bool lazyDiscovery() const {return _lazy_discovery;}
+    // Does the discovery in progress keep a characteristic of this UUID
+    bool characteristicWanted(const bt_uuid_t* uuid) const;
     void handleConnectedEvent(const bt_addr_le_t* deviceAddr);
     void handleDisconnectedEvent(const bt_addr_le_t* deviceAddr);
     void handleDisconnectedPutOffEvent();
+    
+    /**
+     * @brief   Copy out or load the peer's entry in the discovery cache
+     *
+     * @param[in]   bledevice   The peer BLE device
+     *
+     * @param   buffer      The record, to keep e.g. in EEPROM
+     *
+     * @param   size/length The buffer size / the record length
+     *
+     * @return  int  The record length, 0 - none or buffer too small
+     *          bool true - Loaded, false - Not a valid record
+     *
+     * @note  The record holds handles only, no values
+     */
+    int discoveryCache(const BLEDevice &bledevice, uint8_t* buffer, int size) const;
+    bool setDiscoveryCache(const BLEDevice &bledevice, const uint8_t* buffer, int length);
+    void clearDiscoveryCache(const BLEDevice &bledevice);
+    
     uint8_t serviceReadRspProc(bt_conn_t *conn, 
                                int err,
                                bt_gatt_read_params_t *params,
@@ -124,11 +197,11 @@ protected:
                                      uint16_t offset);
     bool discoverService(BLEDevice* device, const bt_uuid_t* svc_uuid);
 private:
-    typedef LinkNode<BLEServiceImp *> BLEServiceLinkNodeHeader;
+    typedef LinkList<BLEServiceImp *> BLEServiceLinkNodeHeader;
     typedef LinkNode<BLEServiceImp *>* BLEServiceNodePtr;
     typedef LinkNode<BLEServiceImp *> BLEServiceNode;
     
-    typedef LinkNode<ServiceRead_t> ServiceReadLinkNodeHeader;
+    typedef LinkList<ServiceRead_t> ServiceReadLinkNodeHeader;
     typedef LinkNode<ServiceRead_t>* ServiceReadLinkNodePtr;
     typedef LinkNode<ServiceRead_t> ServiceReadLinkNode;
     
@@ -137,8 +210,8 @@ private:
     
     void serviceDiscoverComplete(const BLEDevice &bledevice);
     
-    int getDeviceIndex(const bt_addr_le_t* macAddr);
-    int getDeviceIndex(const BLEDevice* device);
+    int getDeviceIndex(const bt_addr_le_t* macAddr) const;
+    int getDeviceIndex(const BLEDevice* device) const;
     /**
      * @brief   Get the unused service header index
      *
@@ -192,6 +265,21 @@ private:
     void setDiscovering(bool discover);
     void checkReadService();
     
+    DiscoveryCache_t* findDiscoveryCache(const bt_addr_le_t* address) const;
+    DiscoveryCache_t* allocDiscoveryCache(const bt_addr_le_t* address);
+    void saveDiscoveryCache(const BLEDevice &bledevice);
+    bool restoreDiscoveryCache(BLEDevice &bledevice);
+    bool walkDiscoveryCache(BLEDevice &bledevice,
+                            const uint8_t* data,
+                            int length,
+                            const BLEServiceLinkNodeHeader* serviceHeader,
+                            bool apply);
+    
+    void invalidateIndex(int index);
+    bool buildIndex(int index) const;
+    const AttributeIndex_t* findHandle(const BLEDevice &bledevice, 
+                                       uint16_t handle) const;
+    
 private:
     // The last header is for local BLE
     BLEServiceLinkNodeHeader _service_header_array[BLE_MAX_CONN_CFG + 1]; // The connected devices' service and self service
@@ -206,16 +294,42 @@ private:
     bt_uuid_128_t _discover_uuid[BLE_MAX_CONN_CFG];
     BLEServiceImp* _cur_discover_service;
     bool _discover_one_service;
-    bt_gatt_read_params_t _read_params;
-    bool _reading;
+    // One service read in flight per peer; the others wait in the queue
+    bt_gatt_read_params_t _read_params[BLE_MAX_CONN_CFG];
+    bool _reading[BLE_MAX_CONN_CFG];
     ServiceReadLinkNodeHeader _read_service_header;
     
+    int registerAttributeTable();
+    
     bt_gatt_attr_t *_attr_base; // Allocate the memory for BLE stack
     int _attr_index;
+    const bt_gatt_attr_t *_static_attrs; // From addAttributeTable(), in flash
+    int _static_attr_count;
     
     static BLEProfileManager* _instance; // The profile manager instance
     bool _profile_registered;
     uint8_t _disconnect_bitmap;
+    
+    // Handle-sorted tables of the peer profiles, rebuilt on the first
+    // lookup after discovery or a disconnect changed them
+    mutable AttributeIndex_t *_handle_index[BLE_MAX_CONN_CFG];
+    mutable uint16_t _handle_index_count[BLE_MAX_CONN_CFG];
+    mutable uint16_t _handle_index_size[BLE_MAX_CONN_CFG];
+    mutable bool _handle_index_valid[BLE_MAX_CONN_CFG];
+    
+    // Profiles of past peers, allocated on the first save; discovery
+    // takes the characteristics and descriptors from there when the
+    // primary services found match
+    DiscoveryCache_t *_discovery_cache;
+    uint32_t _discovery_cache_stamp;
+    bool _discover_from_cache;
+    
+    bool _lazy_discovery;
+    // discoverAttributesByService() with a characteristic UUID
+    bool _discover_chrc_filter;
+    bt_uuid_128_t _discover_chrc_uuid;
+    // The characteristic discoverDescriptors() is working on
+    BLECharacteristicImp* _lazy_discover_chrc;
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "BLECallbacks.h"
 #include "BLEUtils.h"
 #include "BLECharacteristicImp.h"
+#include "BLEProfileManager.h"
 
 bt_uuid_16_t BLEServiceImp::_gatt_primary_uuid = {BT_UUID_TYPE_16, BT_UUID_GATT_PRIMARY_VAL};
 bt_gatt_read_params_t BLEServiceImp::_read_params;
@@ -102,6 +103,7 @@ int BLEServiceImp::addCharacteristic(BLEDevice& bledevice,
     {
         return BLE_STATUS_NO_MEMORY;
     }
+    characteristicImp->_descriptors_pending = BLEProfileManager::instance()->lazyDiscovery();
     
     BLECharacteristicNodePtr node = link_node_create(characteristicImp);
     if (NULL == node)
@@ -353,6 +355,12 @@ uint8_t BLEServiceImp::discoverResponseProc(bt_conn_t *conn,
                     readCharacteristic(device, chrc_handle);
                     retVal = BT_GATT_ITER_CONTINUE;
                 }
+                else if (false == BLEProfileManager::instance()->characteristicWanted(chrc_uuid) ||
+                         NULL != characteristic(chrc_handle))
+                {
+                    // Not asked for, or kept from an earlier discovery
+                    retVal = BT_GATT_ITER_CONTINUE;
+                }
                 else
                 {
                     int retval = (int)addCharacteristic(device, 
@@ -424,7 +432,9 @@ void BLEServiceImp::discoverNextCharacteristic(BLEDevice &bledevice)
         
         if (NULL == _cur_discover_chrc)
         {
-            bool result = chrcCurImp->discoverAttributes(&bledevice);
+            // Lazy discovery finds the descriptors on first use
+            bool result = (false == chrcCurImp->_descriptors_pending &&
+                           chrcCurImp->discoverAttributes(&bledevice));
             pr_debug(LOG_MODULE_BLE, "%s-%d",__FUNCTION__, __LINE__);
             if (result == true)
             {
@@ -506,10 +516,15 @@ uint8_t BLEServiceImp::characteristicReadRspProc(bt_conn_t *conn,
         uint16_t chrc_handle = rspdata[1] | (rspdata[2] << 8);
         uuid_tmp.uuid.type = BT_UUID_TYPE_128;
         memcpy(uuid_tmp.val, &rspdata[3], UUID_SIZE_128);
-        int retval = (int)addCharacteristic(bleDevice, 
+        int retval = BLE_STATUS_SUCCESS;
+        if (BLEProfileManager::instance()->characteristicWanted((const bt_uuid_t*)&uuid_tmp) &&
+            NULL == characteristic(chrc_handle))
+        {
+            retval = (int)addCharacteristic(bleDevice, 
                                             (const bt_uuid_t*)&uuid_tmp,
                                             chrc_handle,
                                             rspdata[0]);
+        }
         
         if (BLE_STATUS_SUCCESS != retval)
         {
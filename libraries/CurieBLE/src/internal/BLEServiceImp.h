@@ -29,7 +29,7 @@
 /**
  * BLE GATT Service
  */
-class BLEServiceImp: public BLEAttribute{
+class BLEServiceImp: public BLEAttribute, public PoolAllocated<BLEServiceImp, 2>{
 public:
     /**
      * Constructor for BLE Service
@@ -97,7 +97,7 @@ private:
                             uint16_t start_handle, 
                             uint16_t end_handle);
 private:
-    typedef LinkNode<BLECharacteristicImp *>  BLECharacteristicLinkNodeHeader;
+    typedef LinkList<BLECharacteristicImp *>  BLECharacteristicLinkNodeHeader;
     typedef LinkNode<BLECharacteristicImp *>* BLECharacteristicNodePtr;
     typedef LinkNode<BLECharacteristicImp *>  BLECharacteristicNode;
     
@@ -108,9 +108,13 @@ bt_addr_le_t* BLEUtils::bleGetLoalAddress()
 
 
 
+static uint8_t hexNibble(char c)
+{
+    return (c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10);
+}
+
 void BLEUtils::uuidString2BT(const char* uuid, bt_uuid_t* pstuuid)
 {
-    char temp[] = {0, 0, 0};
     int strLength = strlen(uuid);
     int length = 0;
     bt_uuid_128_t uuid_tmp;
@@ -125,10 +129,7 @@ void BLEUtils::uuidString2BT(const char* uuid, bt_uuid_t* pstuuid)
             continue;
         }
 
-        temp[0] = uuid[i - 1];
-        temp[1] = uuid[i];
-
-        uuid_tmp.val[length] = strtoul(temp, NULL, 16);
+        uuid_tmp.val[length] = (hexNibble(uuid[i - 1]) << 4) | hexNibble(uuid[i]);
 
         length++;
     }
@@ -176,20 +177,32 @@ void BLEUtils::uuidBT2String(const bt_uuid_t* pstuuid, char* uuid)
 bool BLEUtils::uuidBTSame(const bt_uuid_t* pstuuid1,
                           const bt_uuid_t* pstuuid2)
 {
-    bool temp = (pstuuid1->type == pstuuid2->type);
-    if (true == temp)
+    if (pstuuid1->type != pstuuid2->type)
     {
-        if (pstuuid1->type == BT_UUID_TYPE_16)
-        {
-            temp = (0 == memcmp(&BT_UUID_16(pstuuid1)->val, &BT_UUID_16(pstuuid2)->val, 2));
-        }
-        else
+        return false;
+    }
+    if (pstuuid1->type == BT_UUID_TYPE_16)
+    {
+        uint16_t val1, val2;
+        memcpy(&val1, &BT_UUID_16(pstuuid1)->val, sizeof(val1));
+        memcpy(&val2, &BT_UUID_16(pstuuid2)->val, sizeof(val2));
+        return (val1 == val2);
+    }
+
+    // The 128-bit values sit at an odd offset, so no word loads. Compare
+    //  from the top byte down instead: UUIDs on one vendor base only differ
+    //  in bytes 12-13, which memcmp() would reach last.
+    const uint8_t* val1 = BT_UUID_128(pstuuid1)->val;
+    const uint8_t* val2 = BT_UUID_128(pstuuid2)->val;
+    for (int i = 15; i >= 0; i--)
+    {
+        if (val1[i] != val2[i])
         {
-            temp = (0 == memcmp(BT_UUID_128(pstuuid1)->val, BT_UUID_128(pstuuid2)->val, 16));
+            return false;
         }
     }
-    return temp;
-    
+    return true;
+
 }
 
 BLEDevice& BLEUtils::getLoacalBleDevice()
@@ -202,5 +215,9 @@ bool BLEUtils::isLocalBLE(const BLEDevice& device)
     return (device == BLE);
 }
 
-
+void BLEUtils::waitForEvent()
+{
+    yield();
+    idleFor(1000);
+}
 
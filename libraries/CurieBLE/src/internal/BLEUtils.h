@@ -32,5 +32,10 @@ namespace BLEUtils
     
     BLEDevice& getLoacalBleDevice();
     bool isLocalBLE(const BLEDevice& device);
+    
+    // One pass of a loop waiting for a BLE response: sleeps until the next
+    //  interrupt, at most 1 ms. The responses are handled in the IPC UART
+    //  interrupt, so the loop sees one as soon as it is in.
+    void waitForEvent();
 }
 
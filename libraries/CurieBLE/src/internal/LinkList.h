@@ -20,14 +20,52 @@
 #ifndef _LINKLIST_H_
 #define _LINKLIST_H_
 
+#include "BlockPool.h"
+
 template<typename T> struct LinkNode {
     LinkNode<T> *next;
     T value;
 };
 
+/* A list head that also tracks its last node and length, so appending and
+ * counting don't walk the list. The link_node_* functions take it wherever
+ * they take a head node and keep the two fields in step; zeroing it, e.g.
+ * with memset(), makes an empty list. */
+template<typename T> struct LinkList : LinkNode<T> {
+    LinkNode<T> *last;
+    int count;
+};
+
+/* Nodes come from one shared pool, taken from the heap in one piece, so
+ * that building and tearing down a profile doesn't fragment the heap.
+ * Nodes too big for it, or beyond its count, use malloc(). */
+#define LINK_NODE_POOL_SIZE 32
+
+inline BlockPool &link_node_pool()
+{
+    static BlockPool pool(sizeof(LinkNode<void*>), LINK_NODE_POOL_SIZE);
+    return pool;
+}
+
+template<typename T> LinkNode<T>* link_node_alloc()
+{
+    void *node = NULL;
+    if (sizeof(LinkNode<T>) <= link_node_pool().blockSize())
+        node = link_node_pool().alloc();
+    return (LinkNode<T>*)(node ? node : malloc(sizeof(LinkNode<T>)));
+}
+
+template<typename T> void link_node_free(LinkNode<T> *node)
+{
+    if (link_node_pool().owns(node))
+        link_node_pool().free(node);
+    else
+        free(node);
+}
+
 template<typename T> LinkNode<T>* link_node_create(T value)
 {
-    LinkNode<T>* node = (LinkNode<T>*)malloc(sizeof(LinkNode<T>));
+    LinkNode<T>* node = link_node_alloc<T>();
 
     if (node) {
       node->value = value;
@@ -47,7 +85,7 @@ template<typename T> void link_node_insert_last(LinkNode<T> *root, LinkNode<T> *
 
 template<typename T> void link_node_remove_last(LinkNode<T> *root)
 {
-    LinkNode<T> *temp1, *temp2;
+    LinkNode<T> *temp1, *temp2 = root;
     if (root->next != NULL)
     {
         temp1 = root->next;
@@ -57,7 +95,7 @@ template<typename T> void link_node_remove_last(LinkNode<T> *root)
             temp1 = temp1->next;
         }
         
-        free(temp1);
+        link_node_free(temp1);
         temp2->next = NULL;
     }
 }
@@ -69,7 +107,7 @@ template<typename T> void link_node_remove_first(LinkNode<T> *root)
     {
         temp1 = root->next;
         root->next = temp1->next;
-        free(temp1);
+        link_node_free(temp1);
     }
 }
 
@@ -96,5 +134,59 @@ template<typename T> int link_list_size(const LinkNode<T> *root)
     return counter;
 }
 
+template<typename T> void link_node_insert_last(LinkList<T> *list, LinkNode<T> *node)
+{
+    LinkNode<T> *tail = list->next ? list->last : list;
+    tail->next = node;
+    node->next = NULL;
+    list->last = node;
+    list->count++;
+}
+
+template<typename T> void link_node_insert_first(LinkList<T> *list, LinkNode<T> *node)
+{
+    if (list->next == NULL)
+    {
+        list->last = node;
+    }
+    link_node_insert_first((LinkNode<T> *)list, node);
+    list->count++;
+}
+
+template<typename T> void link_node_remove_first(LinkList<T> *list)
+{
+    if (list->next != NULL)
+    {
+        if (list->next == list->last)
+        {
+            list->last = NULL;
+        }
+        link_node_remove_first((LinkNode<T> *)list);
+        list->count--;
+    }
+}
+
+// Still a walk, for the new last node; nothing in the library uses it
+template<typename T> void link_node_remove_last(LinkList<T> *list)
+{
+    if (list->next != NULL)
+    {
+        LinkNode<T> *prev = list;
+        while (prev->next != list->last)
+        {
+            prev = prev->next;
+        }
+        link_node_free(list->last);
+        prev->next = NULL;
+        list->last = (prev == list) ? NULL : prev;
+        list->count--;
+    }
+}
+
+template<typename T> int link_list_size(const LinkList<T> *list)
+{
+    return list->count;
+}
+
 #endif
 
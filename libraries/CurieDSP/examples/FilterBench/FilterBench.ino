@@ -0,0 +1,110 @@
+/*
+ * FilterBench.ino: runs a 32 tap FIR and a 256 point FFT on a test tone,
+ * prints where the FFT puts the tone and how long each kernel took, next
+ * to a float FIR on the same samples.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+#include <CurieDSP.h>
+
+#define TAPS    32
+#define BLOCK   256
+
+q15_t taps[TAPS];
+q15_t firState[TAPS + BLOCK - 1];
+DspFirQ15 fir;
+
+q15_t twiddles[BLOCK];
+DspFftQ15 fft;
+
+q15_t samples[BLOCK];
+q15_t filtered[BLOCK];
+q15_t spectrum[2 * BLOCK];
+q31_t power[BLOCK / 2];
+
+float floatTaps[TAPS];
+float floatSamples[BLOCK];
+float floatFiltered[BLOCK];
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial);
+
+  // moving average taps, and a tone in bin 20 plus a little of bin 90
+  for (int i = 0; i < TAPS; i++) {
+    floatTaps[i] = 1.0f / TAPS;
+  }
+  dspFloatToQ15(floatTaps, taps, TAPS);
+  for (int i = 0; i < BLOCK; i++) {
+    floatSamples[i] = 0.5f * sinf(2 * M_PI * 20 * i / BLOCK) + 0.1f * sinf(2 * M_PI * 90 * i / BLOCK);
+  }
+  dspFloatToQ15(floatSamples, samples, BLOCK);
+
+  dspFirInitQ15(&fir, taps, TAPS, firState, BLOCK);
+  dspFftInitQ15(&fft, BLOCK, twiddles);
+}
+
+void loop() {
+  unsigned long start = micros();
+  dspFirQ15(&fir, samples, filtered, BLOCK);
+  unsigned long firMicros = micros() - start;
+
+  start = micros();
+  for (int i = 0; i < BLOCK; i++) {
+    float acc = 0;
+    for (int k = 0; k < TAPS && k <= i; k++) {
+      acc += floatTaps[k] * floatSamples[i - k];
+    }
+    floatFiltered[i] = acc;
+  }
+  unsigned long floatMicros = micros() - start;
+
+  for (int i = 0; i < BLOCK; i++) {
+    spectrum[2 * i] = samples[i];
+    spectrum[2 * i + 1] = 0;
+  }
+  start = micros();
+  dspFftQ15(&fft, spectrum);
+  unsigned long fftMicros = micros() - start;
+  dspFftMagnitudeSqQ15(&fft, spectrum, power);
+
+  int peak = 0;
+  for (int k = 1; k < BLOCK / 2; k++) {
+    if (power[k] > power[peak]) {
+      peak = k;
+    }
+  }
+
+  Serial.print("FIR Q15: ");
+  Serial.print(firMicros);
+  Serial.print(" us, float: ");
+  Serial.print(floatMicros);
+  Serial.println(" us");
+  Serial.print("FFT: ");
+  Serial.print(fftMicros);
+  Serial.print(" us, peak in bin ");
+  Serial.println(peak);
+  Serial.println();
+
+  delay(2000);
+}
+
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
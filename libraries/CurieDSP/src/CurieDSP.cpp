@@ -0,0 +1,342 @@
+/*
+ * Fixed point DSP kernels for Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieDSP.h"
+#include <math.h>
+#include <string.h>
+
+/* The multiply-accumulate of the kernels. With -mcpu=quarkse_em GCC builds
+ * a 16 x 16 product with one mpy and the upper word of a 32 x 32 product
+ * with one mpym, so keeping the products in those forms is what keeps the
+ * loops short. The MAC extension instructions of drivers/eiaextensions.h
+ * are bound by MetaWare #pragma intrinsic only; GCC has no builtin for
+ * them, and this is the one place to swap them in.
+ */
+#define DSP_MAC16(acc, a, b)    ((acc) += (int32_t)(a) * (b))
+#define DSP_MAC32H(acc, a, b)   ((acc) += (int32_t)(((int64_t)(a) * (b)) >> 32))
+#define DSP_MAC32(acc, a, b)    ((acc) += (int64_t)(a) * (b))
+#define DSP_MSU32(acc, a, b)    ((acc) -= (int64_t)(a) * (b))
+
+q15_t dspFloatToQ15(float v)
+{
+    v = v * 32768.0f;
+    if (v >= 32767.0f)
+        return 32767;
+    if (v <= -32768.0f)
+        return -32768;
+    return (q15_t)lroundf(v);
+}
+
+q31_t dspFloatToQ31(float v)
+{
+    // float has 24 bits of mantissa: anything from 2^31 - 64 rounds up
+    if (v >= 1.0f)
+        return 0x7fffffff;
+    if (v <= -1.0f)
+        return (q31_t)0x80000000;
+    return (q31_t)lroundf(v * 2147483648.0f);
+}
+
+void dspFloatToQ15(const float *src, q15_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspFloatToQ15(src[i]);
+}
+
+void dspFloatToQ31(const float *src, q31_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspFloatToQ31(src[i]);
+}
+
+void dspQ15ToFloat(const q15_t *src, float *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspQ15ToFloat(src[i]);
+}
+
+void dspQ31ToFloat(const q31_t *src, float *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspQ31ToFloat(src[i]);
+}
+
+void dspQ15ToQ31(const q15_t *src, q31_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = (q31_t)src[i] << 16;
+}
+
+void dspQ31ToQ15(const q31_t *src, q15_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = (q15_t)(src[i] >> 16);
+}
+
+void dspScaleQ15(const q15_t *src, q15_t scale, int8_t shift, q15_t *dst, uint32_t n)
+{
+    int right = 15 - shift;
+
+    if (right > 31)
+        right = 31;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t p = (int32_t)src[i] * scale;
+        if (right >= 0)
+            dst[i] = dspSaturate16(p >> right);
+        else
+            dst[i] = dspSaturate16(dspSaturate32((int64_t)p << -right));
+    }
+}
+
+void dspScaleQ31(const q31_t *src, q31_t scale, int8_t shift, q31_t *dst, uint32_t n)
+{
+    int right = 31 - shift;
+
+    if (right > 63)
+        right = 63;
+    for (uint32_t i = 0; i < n; i++) {
+        int64_t p = (int64_t)src[i] * scale;
+        if (right >= 0)
+            dst[i] = dspSaturate32(p >> right);
+        else
+            // |p| < 2^62: anything shifted further saturates
+            dst[i] = (right < -1 && p) ? (p > 0 ? 0x7fffffff : (q31_t)0x80000000)
+                                       : dspSaturate32(p << -right);
+    }
+}
+
+void dspAddQ15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspSaturate16((int32_t)a[i] + b[i]);
+}
+
+void dspAddQ31(const q31_t *a, const q31_t *b, q31_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspSaturate32((int64_t)a[i] + b[i]);
+}
+
+void dspSubQ15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspSaturate16((int32_t)a[i] - b[i]);
+}
+
+void dspSubQ31(const q31_t *a, const q31_t *b, q31_t *dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        dst[i] = dspSaturate32((int64_t)a[i] - b[i]);
+}
+
+int64_t dspDotQ15(const q15_t *a, const q15_t *b, uint32_t n)
+{
+    int64_t acc = 0;
+
+    // pairs of products fit 32 bits but for -1.0 * -1.0 twice: sum 32 bit
+    // products straight into the 64 bit total
+    for (uint32_t i = 0; i < n; i++)
+        DSP_MAC16(acc, a[i], b[i]);
+    return acc;
+}
+
+int64_t dspDotQ31(const q31_t *a, const q31_t *b, uint32_t n)
+{
+    int64_t acc = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+        DSP_MAC32H(acc, a[i], b[i]);
+    return acc;
+}
+
+void dspFirInitQ15(DspFirQ15 *fir, const q15_t *coeffs, uint16_t taps, q15_t *state, uint16_t blockSize)
+{
+    fir->coeffs = coeffs;
+    fir->state = state;
+    fir->taps = taps;
+    fir->blockSize = blockSize;
+    memset(state, 0, (taps + blockSize - 1) * sizeof(q15_t));
+}
+
+void dspFirQ15(DspFirQ15 *fir, const q15_t *src, q15_t *dst, uint32_t n)
+{
+    const q15_t *coeffs = fir->coeffs;
+    q15_t *state = fir->state;
+    uint16_t taps = fir->taps;
+    uint16_t history = taps - 1;
+
+    while (n > 0) {
+        uint32_t block = n < fir->blockSize ? n : fir->blockSize;
+
+        // state: the taps - 1 previous samples, then this block
+        memcpy(state + history, src, block * sizeof(q15_t));
+        for (uint32_t i = 0; i < block; i++) {
+            const q15_t *x = state + i + history;
+            int64_t acc = 0;
+            for (uint16_t k = 0; k < taps; k++)
+                DSP_MAC16(acc, coeffs[k], x[-(int)k]);
+            dst[i] = dspSaturate16(dspSaturate32((acc + (1 << 14)) >> 15));
+        }
+        memmove(state, state + block, history * sizeof(q15_t));
+
+        src += block;
+        dst += block;
+        n -= block;
+    }
+}
+
+void dspBiquadCoeffsQ31(q31_t *coeffs, float b0, float b1, float b2, float a1, float a2, uint8_t shift)
+{
+    float scale = 1.0f / (1 << shift);
+
+    coeffs[0] = dspFloatToQ31(b0 * scale);
+    coeffs[1] = dspFloatToQ31(b1 * scale);
+    coeffs[2] = dspFloatToQ31(b2 * scale);
+    coeffs[3] = dspFloatToQ31(a1 * scale);
+    coeffs[4] = dspFloatToQ31(a2 * scale);
+}
+
+void dspBiquadInitQ31(DspBiquadQ31 *iir, const q31_t *coeffs, uint8_t stages, uint8_t shift, q31_t *state)
+{
+    iir->coeffs = coeffs;
+    iir->state = state;
+    iir->stages = stages;
+    iir->shift = shift;
+    dspBiquadResetQ31(iir);
+}
+
+void dspBiquadResetQ31(DspBiquadQ31 *iir)
+{
+    memset(iir->state, 0, iir->stages * 4 * sizeof(q31_t));
+}
+
+void dspBiquadQ31(DspBiquadQ31 *iir, const q31_t *src, q31_t *dst, uint32_t n)
+{
+    const q31_t *c = iir->coeffs;
+    q31_t *s = iir->state;
+    int right = 31 - iir->shift;
+
+    for (uint8_t stage = 0; stage < iir->stages; stage++) {
+        q31_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+        q31_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+
+        for (uint32_t i = 0; i < n; i++) {
+            q31_t x = src[i];
+            int64_t acc = 0;
+            DSP_MAC32(acc, b0, x);
+            DSP_MAC32(acc, b1, x1);
+            DSP_MAC32(acc, b2, x2);
+            DSP_MSU32(acc, a1, y1);
+            DSP_MSU32(acc, a2, y2);
+            q31_t y = dspSaturate32(acc >> right);
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            dst[i] = y;
+        }
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+
+        // later stages filter the output of this one, in place
+        src = dst;
+        c += 5;
+        s += 4;
+    }
+}
+
+bool dspFftInitQ15(DspFftQ15 *fft, uint16_t n, q15_t *twiddles)
+{
+    uint8_t stages = 0;
+
+    if (n < 2 || n > 4096 || (n & (n - 1)))
+        return false;
+    while ((1u << stages) < n)
+        stages++;
+
+    for (uint16_t k = 0; k < n / 2; k++) {
+        float angle = 2.0f * (float)M_PI * k / n;
+        twiddles[2 * k] = dspFloatToQ15(cosf(angle));
+        twiddles[2 * k + 1] = dspFloatToQ15(sinf(angle));
+    }
+    fft->twiddles = twiddles;
+    fft->n = n;
+    fft->stages = stages;
+    return true;
+}
+
+void dspFftQ15(const DspFftQ15 *fft, q15_t *data, bool inverse)
+{
+    uint16_t n = fft->n;
+    const q15_t *tw = fft->twiddles;
+
+    // bit reversed order, so the stages can run in place
+    for (uint16_t i = 1, j = 0; i < n; i++) {
+        uint16_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j |= bit;
+        if (i < j) {
+            q15_t re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+
+    for (uint16_t half = 1, step = n / 2; half < n; half <<= 1, step >>= 1) {
+        for (uint16_t start = 0; start < n; start += 2 * half) {
+            for (uint16_t j = 0; j < half; j++) {
+                int32_t c = tw[2 * j * step];
+                int32_t s = tw[2 * j * step + 1];
+                q15_t *u = data + 2 * (start + j);
+                q15_t *v = u + 2 * half;
+                int32_t tr, ti;
+
+                // v * e^(-i angle) forward, v * e^(+i angle) inverse
+                if (inverse) {
+                    s = -s;
+                }
+                tr = (c * v[0] + s * v[1]) >> 15;
+                ti = (c * v[1] - s * v[0]) >> 15;
+
+                int32_t ur = u[0], ui = u[1];
+                u[0] = dspSaturate16((ur + tr) >> 1);
+                u[1] = dspSaturate16((ui + ti) >> 1);
+                v[0] = dspSaturate16((ur - tr) >> 1);
+                v[1] = dspSaturate16((ui - ti) >> 1);
+            }
+        }
+    }
+}
+
+void dspFftMagnitudeSqQ15(const DspFftQ15 *fft, const q15_t *data, q31_t *dst)
+{
+    for (uint16_t k = 0; k < fft->n / 2; k++) {
+        int64_t acc = 0;
+        DSP_MAC32(acc, data[2 * k], data[2 * k]);
+        DSP_MAC32(acc, data[2 * k + 1], data[2 * k + 1]);
+        dst[k] = dspSaturate32(acc);
+    }
+}
@@ -0,0 +1,140 @@
+/*
+ * Fixed point DSP kernels for Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CURIEDSP_H_
+#define _CURIEDSP_H_
+
+#include <Arduino.h>
+
+/* Fixed point kernels on plain arrays: conversions, vector arithmetic, dot
+ * product, FIR, biquad cascade and a radix-2 FFT. Q15 is int16_t with 15
+ * fraction bits (-1.0 .. 1.0 - 2^-15), Q31 int32_t with 31. Results
+ * saturate rather than wrap. Nothing allocates memory; the filters keep
+ * their state in caller provided arrays, so they can run on a CurieI2SDMA
+ * block or an IMU sample in interrupt context.
+ */
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+static inline q15_t dspSaturate16(int32_t v)
+{
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return (q15_t)v;
+}
+
+static inline q31_t dspSaturate32(int64_t v)
+{
+    if (v > 0x7fffffffLL)
+        return 0x7fffffff;
+    if (v < -0x80000000LL)
+        return (q31_t)0x80000000;
+    return (q31_t)v;
+}
+
+/* Conversions, rounding to nearest and saturating */
+q15_t dspFloatToQ15(float v);
+q31_t dspFloatToQ31(float v);
+static inline float dspQ15ToFloat(q15_t v) { return v * (1.0f / 32768); }
+static inline float dspQ31ToFloat(q31_t v) { return v * (1.0f / 2147483648.0f); }
+
+void dspFloatToQ15(const float *src, q15_t *dst, uint32_t n);
+void dspFloatToQ31(const float *src, q31_t *dst, uint32_t n);
+void dspQ15ToFloat(const q15_t *src, float *dst, uint32_t n);
+void dspQ31ToFloat(const q31_t *src, float *dst, uint32_t n);
+void dspQ15ToQ31(const q15_t *src, q31_t *dst, uint32_t n);
+void dspQ31ToQ15(const q31_t *src, q15_t *dst, uint32_t n);
+
+/* dst = src * scale * 2^shift; dst may be src. shift may be negative */
+void dspScaleQ15(const q15_t *src, q15_t scale, int8_t shift, q15_t *dst, uint32_t n);
+void dspScaleQ31(const q31_t *src, q31_t scale, int8_t shift, q31_t *dst, uint32_t n);
+
+/* dst = a + b and dst = a - b; dst may be a or b */
+void dspAddQ15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n);
+void dspAddQ31(const q31_t *a, const q31_t *b, q31_t *dst, uint32_t n);
+void dspSubQ15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n);
+void dspSubQ31(const q31_t *a, const q31_t *b, q31_t *dst, uint32_t n);
+
+/* Sum of a[i] * b[i], unscaled: Q30 for Q15 inputs, which cannot overflow
+ * below 2^33 elements. For Q31 inputs each product keeps its upper word,
+ * so the sum is Q30 with the low bits truncated.
+ */
+int64_t dspDotQ15(const q15_t *a, const q15_t *b, uint32_t n);
+int64_t dspDotQ31(const q31_t *a, const q31_t *b, uint32_t n);
+
+/* FIR filter with Q15 taps. state must hold taps + blockSize - 1 samples,
+ * and longer calls are filtered blockSize samples at a time;
+ * coeffs are in time order, coeffs[0] weighting the newest sample. The sum
+ * is kept in 64 bits, so any taps work, and saturates at the end.
+ */
+struct DspFirQ15 {
+    const q15_t *coeffs;
+    q15_t *state;
+    uint16_t taps;
+    uint16_t blockSize;
+};
+
+void dspFirInitQ15(DspFirQ15 *fir, const q15_t *coeffs, uint16_t taps, q15_t *state, uint16_t blockSize);
+void dspFirQ15(DspFirQ15 *fir, const q15_t *src, q15_t *dst, uint32_t n);
+
+/* Cascade of second order sections, direct form I:
+ *
+ *     y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2
+ *
+ * coeffs holds {b0, b1, b2, a1, a2} per stage in Q31, scaled down by
+ * 2^shift so they fit (shift 1 covers |a1| < 2.0, every stable section);
+ * dspBiquadCoeffsQ31() converts normalised float coefficients. state holds
+ * 4 samples per stage. src and dst may be the same array.
+ */
+struct DspBiquadQ31 {
+    const q31_t *coeffs;
+    q31_t *state;
+    uint8_t stages;
+    uint8_t shift;
+};
+
+void dspBiquadCoeffsQ31(q31_t *coeffs, float b0, float b1, float b2, float a1, float a2, uint8_t shift);
+void dspBiquadInitQ31(DspBiquadQ31 *iir, const q31_t *coeffs, uint8_t stages, uint8_t shift, q31_t *state);
+void dspBiquadQ31(DspBiquadQ31 *iir, const q31_t *src, q31_t *dst, uint32_t n);
+void dspBiquadResetQ31(DspBiquadQ31 *iir);
+
+/* In place complex FFT of n points, n a power of two up to 4096. data holds
+ * n interleaved {re, im} pairs; twiddles holds n Q15 values, written by
+ * dspFftInitQ15() and shared by every transform of that size. Each of the
+ * log2(n) stages halves the values so nothing overflows: the forward
+ * result is the DFT divided by n, and the inverse of that gives the input
+ * back, divided by n again.
+ */
+struct DspFftQ15 {
+    q15_t *twiddles;
+    uint16_t n;
+    uint8_t stages;
+};
+
+bool dspFftInitQ15(DspFftQ15 *fft, uint16_t n, q15_t *twiddles);
+void dspFftQ15(const DspFftQ15 *fft, q15_t *data, bool inverse = false);
+
+/* Squared magnitudes of the first n / 2 bins of a forward transform, Q30 */
+void dspFftMagnitudeSqQ15(const DspFftQ15 *fft, const q15_t *data, q31_t *dst);
+
+#endif /* _CURIEDSP_H_ */
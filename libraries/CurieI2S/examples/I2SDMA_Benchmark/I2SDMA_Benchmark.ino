@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+   This sketch measures CurieI2SDMA streaming: at each sample rate it runs
+   streamTX() and then streamRX() with ping-pong blocks for testMs. The
+   block callback only timestamps the block and hands it to loop(), which
+   refills (tx) or sums (rx) it, so the numbers show what a sketch doing
+   its work outside the interrupt gets: the words per second moved, the
+   interval between block callbacks and its jitter, the underruns and
+   overruns (a block came back before loop() had dealt with the previous
+   one) and the share of loop() time left idle. Compare with the
+   I2S_Benchmark rows for the interrupt driven CurieI2S. One CSV row per
+   direction and rate:
+
+     test,rate_hz,words_per_s,blocks,mean_us,jitter_us,max_us,xruns,idle_pct
+
+   Both directions run as master, so nothing needs to be connected.
+*/
+
+#include <CurieI2SDMA.h>
+
+const uint16_t rates[] = { 8000, 16000, 22050, 32000, 44100, 48000, 64000 };
+const int numRates = sizeof(rates) / sizeof(rates[0]);
+const unsigned long testMs = 2000;
+const int BLOCKS = 2;               // ping-pong
+const int FRAMES = 64;              // stereo frames per block
+
+uint32_t buff[BLOCKS * FRAMES * 2];
+uint32_t idleBaseline;
+volatile uint32_t checksum;
+
+volatile uint32_t blockCount, lastBlock, minGap, maxGap;
+volatile uint64_t sumGap;
+volatile uint32_t xruns;
+void * volatile pending;
+
+void onBlock(void *buf, uint32_t len) {
+  uint32_t now = cycles();
+  if (blockCount) {
+    uint32_t gap = now - lastBlock;
+    sumGap += gap;
+    if (gap < minGap)
+      minGap = gap;
+    if (gap > maxGap)
+      maxGap = gap;
+  }
+  lastBlock = now;
+  blockCount++;
+  if (pending)
+    xruns++;
+  pending = buf;
+}
+
+// Deals with each block the callback hands over, counting the loops with
+// nothing to do; with no stream running it gives the idle baseline
+uint32_t work(bool tx) {
+  uint32_t idle = 0;
+  unsigned long start = millis();
+
+  while (millis() - start < testMs) {
+    uint32_t *b = (uint32_t *)pending;
+    if (b) {
+      uint32_t sum = 0;
+      for (int i = 0; i < FRAMES * 2; i++) {
+        if (tx)
+          b[i] = (blockCount << 16) | i;
+        else
+          sum += b[i];
+      }
+      checksum += sum;
+      pending = NULL;
+    } else {
+      idle++;
+    }
+  }
+  return idle;
+}
+
+void bench(bool tx, uint16_t rate) {
+  blockCount = 0;
+  sumGap = 0;
+  minGap = 0xFFFFFFFF;
+  maxGap = 0;
+  xruns = 0;
+  pending = NULL;
+
+  int status;
+  if (tx) {
+    CurieI2SDMA.beginTX(rate, 32, 1, 1);
+    status = CurieI2SDMA.streamTX(buff, sizeof(buff), sizeof(uint32_t), BLOCKS, onBlock);
+  } else {
+    CurieI2SDMA.beginRX(rate, 32, 1, 1);
+    status = CurieI2SDMA.streamRX(buff, sizeof(buff), sizeof(uint32_t), BLOCKS, onBlock);
+  }
+  if (status) {
+    Serial.print("# could not start the stream at ");
+    Serial.println(rate);
+    return;
+  }
+  uint32_t idle = work(tx);
+  if (tx)
+    CurieI2SDMA.stopTX();
+  else
+    CurieI2SDMA.stopRX();
+
+  uint32_t n = blockCount > 1 ? blockCount - 1 : 1;
+  Serial.print(tx ? "dma_tx," : "dma_rx,");
+  Serial.print(rate);
+  Serial.print(',');
+  Serial.print(blockCount * FRAMES * 2 * 1000.0 / testMs, 0);
+  Serial.print(',');
+  Serial.print(blockCount);
+  Serial.print(',');
+  Serial.print(sumGap / 32.0 / n, 2);
+  Serial.print(',');
+  Serial.print(blockCount > 1 ? (maxGap - minGap) / 32.0 : 0, 2);
+  Serial.print(',');
+  Serial.print(maxGap / 32.0, 2);
+  Serial.print(',');
+  Serial.print(xruns);
+  Serial.print(',');
+  Serial.println(100.0 * idle / idleBaseline, 1);
+}
+
+void setup() {
+  Serial.begin(115200); // initialize Serial communication
+  while (!Serial);      // wait for the serial port to open
+
+  CurieI2SDMA.iniTX();
+  CurieI2SDMA.iniRX();
+
+  pending = NULL;
+  idleBaseline = work(false);
+
+  Serial.println("test,rate_hz,words_per_s,blocks,mean_us,jitter_us,max_us,xruns,idle_pct");
+  for (int i = 0; i < numRates; i++)
+    bench(true, rates[i]);
+  for (int i = 0; i < numRates; i++)
+    bench(false, rates[i]);
+  Serial.println("# done");
+}
+
+void loop() {
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
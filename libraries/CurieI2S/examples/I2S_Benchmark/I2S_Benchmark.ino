@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+   This sketch measures the interrupt driven CurieI2S transmitter: at each
+   sample rate divider it streams from loop() for testMs and reports the
+   words per second actually sent, the interval between TFIFO_AEMPTY
+   interrupts (as seen by the tx callback), the underruns (the ring ran
+   dry and tx stopped) and the share of loop() time left idle. The highest
+   divider with no underruns is the sustained maximum; compare the
+   I2SDMA_Benchmark rows for the DMA driver. One CSV row per rate:
+
+     test,divider,words_per_s,irqs,mean_us,jitter_us,max_us,xruns,idle_pct
+
+   Nothing needs to be connected; watch I2S_TXD (pin 7) with a scope to
+   see the gaps.
+*/
+
+#include <CurieI2S.h>
+
+const uint32_t dividers[] = { I2S_8K, I2S_12K, I2S_22K, I2S_24K, I2S_44K,
+                              I2S_48K, 0x00080008, 0x00060006, 0x00040004 };
+const int numDividers = sizeof(dividers) / sizeof(dividers[0]);
+const unsigned long testMs = 2000;
+const int BLOCK = 32;               // words pushed at a time
+
+uint32_t block[BLOCK];
+uint32_t idleBaseline;
+
+volatile uint32_t irqCount, lastIrq, minGap, maxGap;
+volatile uint64_t sumGap;
+volatile uint32_t underruns;
+volatile bool stopped;
+
+void onTx() {
+  uint32_t now = cycles();
+  if (irqCount) {
+    uint32_t gap = now - lastIrq;
+    sumGap += gap;
+    if (gap < minGap)
+      minGap = gap;
+    if (gap > maxGap)
+      maxGap = gap;
+  }
+  lastIrq = now;
+  irqCount++;
+}
+
+void onTxEmpty() {
+  underruns++;
+  stopped = true;
+}
+
+// Feeds the ring whenever a block fits, counting the loops with nothing
+// to do; need > I2S_BUFFER_SIZE never feeds, for the idle baseline
+uint32_t feed(int need, unsigned long *words) {
+  uint32_t idle = 0;
+  unsigned long start = millis();
+
+  while (millis() - start < testMs) {
+    if (CurieI2S.availableTx() >= need) {
+      *words += CurieI2S.pushData(block, BLOCK);
+      if (stopped) {
+        // after an underrun tx stops itself; start it again
+        stopped = false;
+        CurieI2S.startTX();
+      }
+    } else {
+      idle++;
+    }
+  }
+  return idle;
+}
+
+void bench(uint32_t divider) {
+  unsigned long words = 0;
+
+  CurieI2S.setSampleRate(divider);
+  irqCount = 0;
+  sumGap = 0;
+  minGap = 0xFFFFFFFF;
+  maxGap = 0;
+  underruns = 0;
+  stopped = false;
+
+  while (CurieI2S.pushData(block, BLOCK))
+    ;                               // start with the ring full
+  CurieI2S.startTX();
+  uint32_t idle = feed(BLOCK, &words);
+  CurieI2S.stopTX();
+
+  uint32_t n = irqCount > 1 ? irqCount - 1 : 1;
+  Serial.print("irq_tx,");
+  Serial.print(divider & 0x7FF);
+  Serial.print(',');
+  Serial.print(words * 1000.0 / testMs, 0);
+  Serial.print(',');
+  Serial.print(irqCount);
+  Serial.print(',');
+  Serial.print(sumGap / 32.0 / n, 2);
+  Serial.print(',');
+  Serial.print(irqCount > 1 ? (maxGap - minGap) / 32.0 : 0, 2);
+  Serial.print(',');
+  Serial.print(maxGap / 32.0, 2);
+  Serial.print(',');
+  Serial.print(underruns);
+  Serial.print(',');
+  Serial.println(100.0 * idle / idleBaseline, 1);
+}
+
+void setup() {
+  Serial.begin(115200); // initialize Serial communication
+  while (!Serial);      // wait for the serial port to open
+
+  for (int i = 0; i < BLOCK; i++)
+    block[i] = 0xA5A50000 | i;
+
+  CurieI2S.begin(I2S_44K, I2S_32bit);
+  CurieI2S.setI2SMode(PHILIPS_MODE);
+  CurieI2S.attachTxInterrupt(onTx);
+  CurieI2S.attachTxEmptyInterrupt(onTxEmpty);
+  CurieI2S.initTX();
+
+  unsigned long none = 0;
+  idleBaseline = feed(I2S_BUFFER_SIZE, &none);
+
+  Serial.println("test,divider,words_per_s,irqs,mean_us,jitter_us,max_us,xruns,idle_pct");
+  for (int i = 0; i < numDividers; i++)
+    bench(dividers[i]);
+  Serial.println("# done");
+}
+
+void loop() {
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
@@ -22,6 +22,7 @@
 
 #include "CurieI2S.h"
 #include <interrupt.h>
+#include <power.h>
 
 Curie_I2S CurieI2S;
 
@@ -34,8 +35,54 @@ static struct i2s_ring_buffer _i2s_Tx_Buffer;
 static struct i2s_ring_buffer *_i2s_Rx_BufferPtr = &_i2s_Rx_Buffer;
 static struct i2s_ring_buffer *_i2s_Tx_BufferPtr = &_i2s_Tx_Buffer;
 
+// begin() may run again without an end(): hold the clock once
+static bool _i2s_clock_held = false;
+
 //static int _i2s_frame_delay = 960;
 
+// Moves as many words from the tx buffer as the TX FIFO has room for, with
+// one read of its level; returns the number moved
+static int i2sFillTxFIFO(void)
+{
+    int tail = _i2s_Tx_BufferPtr->tail;
+    int count = (_i2s_Tx_BufferPtr->head - tail) & I2S_BUFFER_MASK;
+    int fifoSpace = I2S_FIFO_DEPTH - (*I2S_TFIFO_STAT & 0x0000000F);
+
+    if(count > fifoSpace)
+        count = fifoSpace;
+    for(int i = 0; i < count; i++)
+    {
+        *I2S_DATA_REG = _i2s_Tx_BufferPtr->data[tail];
+        tail = (tail + 1) & I2S_BUFFER_MASK;
+    }
+    _i2s_Tx_BufferPtr->tail = tail;
+    return count;
+}
+
+// Empties the RX FIFO into the rx buffer; words that don't fit are dropped
+static void i2sDrainRxFIFO(void)
+{
+    int head = _i2s_Rx_BufferPtr->head;
+    int tail = _i2s_Rx_BufferPtr->tail;
+    int fifoDataLength = (*I2S_RFIFO_STAT & 0x0000000F);
+
+    for(int i = 0; i < fifoDataLength; i++)
+    {
+        int index = (head + 1) & I2S_BUFFER_MASK;
+        uint32_t data = *I2S_DATA_REG;
+        if(index != tail)
+        {
+            _i2s_Rx_BufferPtr->data[head] = data;
+            head = index;
+        }
+        #ifdef I2S_DEBUG
+        digitalWrite(I2S_DEBUG_PIN, HIGH);
+        digitalWrite(I2S_DEBUG_PIN, LOW);
+        #endif
+    }
+    _i2s_Rx_BufferPtr->head = head;
+}
+
 static void i2sInterruptHandler(void)
 {
     //Serial.println("i2s int");
@@ -49,24 +96,7 @@ static void i2sInterruptHandler(void)
         //disable RFIFO_AFULL interrupts
         //*I2S_CID_CTRL = *I2S_CID_CTRL & 0x7FFFFFFF;
         
-        int index;
-        int fifoDataLength = (*I2S_RFIFO_STAT & 0x0000000F);
-
-        for(int i = 0; i < fifoDataLength; i++)
-        {
-            index = (uint32_t)(_i2s_Rx_BufferPtr->head +1) % I2S_BUFFER_SIZE;
-            uint32_t data = *I2S_DATA_REG;
-            if(index != _i2s_Rx_BufferPtr->tail)
-            {
-                _i2s_Rx_BufferPtr->data[_i2s_Rx_BufferPtr->head] = data;
-                _i2s_Rx_BufferPtr->head = index;
-            }
-            #ifdef I2S_DEBUG
-            digitalWrite(I2S_DEBUG_PIN, HIGH);
-            digitalWrite(I2S_DEBUG_PIN, LOW);
-            #endif
-
-        }
+        i2sDrainRxFIFO();
             
         //enable RFIFO_EMPTY interrupt
         *I2S_CID_CTRL = *I2S_CID_CTRL | 0x10000000;
@@ -127,22 +157,8 @@ static void i2sInterruptHandler(void)
         //call tx callback
         CurieI2S.i2s_tx_callback();
         
-        if(_i2s_Tx_BufferPtr->head != _i2s_Tx_BufferPtr->tail)
-        {
-            int index = _i2s_Tx_BufferPtr->tail;
-            int cnt = 0;
-            int fifoSpace = (4 - (*I2S_TFIFO_STAT & 0x0000000F));
-            for(cnt = 0; (index != (_i2s_Tx_BufferPtr->head)) && (cnt < fifoSpace); cnt++)
-            {
-                *I2S_DATA_REG  = _i2s_Tx_BufferPtr->data[index];
-                index = (index+1)%I2S_BUFFER_SIZE;
-            } 
-            _i2s_Tx_BufferPtr->tail = (_i2s_Tx_BufferPtr->tail + cnt)%I2S_BUFFER_SIZE;
-        }
-        else
-        {
-            //Serial.println("buff empty");
-        }
+        i2sFillTxFIFO();
+
         //clear TX flags
         i2s_stat = i2s_stat & 0xFFFFFCFF;
         *I2S_STAT = i2s_stat | 0x00000001;
@@ -203,17 +219,8 @@ static void i2sInterruptHandler(void)
             #endif
             
             //make sure buffer there is no more data in buffer to put into fifo
-            if(_i2s_Tx_BufferPtr->head != _i2s_Tx_BufferPtr->tail)
+            if(i2sFillTxFIFO())
             {
-                int index = _i2s_Tx_BufferPtr->tail;
-                int cnt = 0;
-                for(cnt = 0; (index != (_i2s_Tx_BufferPtr->head)) && (cnt < 4); cnt++)
-                {
-                    *I2S_DATA_REG  = _i2s_Tx_BufferPtr->data[index];
-                    index = (index+1)%I2S_BUFFER_SIZE;
-                }
-                _i2s_Tx_BufferPtr->tail = (_i2s_Tx_BufferPtr->tail + cnt)%I2S_BUFFER_SIZE;
-
                 //enable Tx interrrupts
                 *I2S_CID_CTRL = *I2S_CID_CTRL | 0x07000000;
             }
@@ -281,7 +288,10 @@ void Curie_I2S::begin(uint32_t sampleRate, uint32_t resolution)
 void Curie_I2S::end()
 {
     //disable I2S PCLK Clock Gate
-    *CLK_GATE_CTL = *CLK_GATE_CTL & 0xFFDFFDFF;
+    if (_i2s_clock_held) {
+        power_clock_release(POWER_CLOCK_I2S);
+        _i2s_clock_held = false;
+    }
     muxRX(0);
     enableRXChannel(0);
     syncRX(0);
@@ -316,16 +326,8 @@ void Curie_I2S::startTX()
     digitalWrite(I2S_DEBUG_PIN, LOW);
     #endif
     resetTXFIFO();
-    int cnt = 0;
-    if(_i2s_Tx_BufferPtr->head != _i2s_Tx_BufferPtr->tail)
+    if(i2sFillTxFIFO())
     {
-        int index = _i2s_Tx_BufferPtr->tail;
-        for(cnt = 0; (index != _i2s_Tx_BufferPtr->head) && (cnt < 4); cnt++)
-        {
-            *I2S_DATA_REG  = _i2s_Tx_BufferPtr->data[index];
-            index = (index+1)%I2S_BUFFER_SIZE;
-        } 
-        _i2s_Tx_BufferPtr->tail = (_i2s_Tx_BufferPtr->tail + cnt)%I2S_BUFFER_SIZE;
         enableTX();
         //enable TFIFO_EMPTY and TFIFO_AEMPTY interrupt
         *I2S_CID_CTRL = *I2S_CID_CTRL | 0x02000000;
@@ -363,6 +365,20 @@ void Curie_I2S::setSampleRate(uint32_t dividerValue)
     frameDelay = (dividerValue&0x000000FF)*32*2;
 }
 
+void Curie_I2S::setFIFOThresholds(uint8_t txAlmostEmpty, uint8_t rxAlmostFull)
+{
+    if(txAlmostEmpty >= I2S_FIFO_DEPTH)
+        txAlmostEmpty = I2S_FIFO_DEPTH - 1;
+    if(rxAlmostFull >= I2S_FIFO_DEPTH)
+        rxAlmostFull = I2S_FIFO_DEPTH - 1;
+    if(rxAlmostFull == 0)
+        rxAlmostFull = 1;
+
+    //almost full threshold in bits 16+, almost empty in bits 0+
+    *I2S_TFIFO_CTRL = 0x00030000 | txAlmostEmpty;
+    *I2S_RFIFO_CTRL = ((uint32_t)rxAlmostFull << 16) | 0x00000002;
+}
+
 void Curie_I2S::setResolution(uint32_t resolution)
 {
     switch(resolution)
@@ -390,7 +406,10 @@ void Curie_I2S::setResolution(uint32_t resolution)
 void Curie_I2S::init()
 {   
     //enable I2S PCLK Clock Gate and I2S Clock
-    *CLK_GATE_CTL = *CLK_GATE_CTL | 0x00200200;
+    if (!_i2s_clock_held) {
+        power_clock_acquire(POWER_CLOCK_I2S);
+        _i2s_clock_held = true;
+    }
     
     //configure I2S_CTRL register and set TX as master and RX as slave
     uint32_t i2s_ctrl = *I2S_CTRL;
@@ -399,8 +418,7 @@ void Curie_I2S::init()
     *I2S_CTRL = i2s_ctrl;
     
     //set threshold for FIFOs
-    *I2S_TFIFO_CTRL |= 0x00030002;
-    *I2S_RFIFO_CTRL |= 0x00010002;
+    setFIFOThresholds(I2S_TFIFO_AEMPTY_THRESHOLD, I2S_RFIFO_AFULL_THRESHOLD);
     
     //enable interrupts
     //ToDo: Use DMA instead of relying on interrupts
@@ -541,26 +559,40 @@ void Curie_I2S::enableInterrupts()
     interrupt_enable(IRQ_I2S_INTR); 
 }
 
+bool Curie_I2S::setInterruptPriority(uint32_t priority)
+{
+    return ::setInterruptPriority(IRQ_I2S_INTR, priority);
+}
+
 int Curie_I2S::pushData(uint32_t data)
 {
-    //disable TFIFO_AEMPTY interrupts
-    *I2S_CID_CTRL = *I2S_CID_CTRL & 0xFDFFFFFF;
+    return pushData(&data, 1);
+}
+
+int Curie_I2S::pushData(const uint32_t *data, int n)
+{
+    // Only this side moves head and only the interrupt moves tail, so the
+    // buffer needs no locking; TFIFO_AEMPTY is enabled when it stops being
+    // empty
+    int head = _i2s_Tx_BufferPtr->head;
+    int tail = _i2s_Tx_BufferPtr->tail;
+    int space = (tail - head - 1) & I2S_BUFFER_MASK;
+    int cnt = n < space ? n : space;
 
-    int i = (uint32_t)(_i2s_Tx_BufferPtr->head +1) % I2S_BUFFER_SIZE;
-    if(i != _i2s_Tx_BufferPtr->tail)
+    for(int i = 0; i < cnt; i++)
     {
-        _i2s_Tx_BufferPtr->data[_i2s_Tx_BufferPtr->head] = data;
-        _i2s_Tx_BufferPtr->head = i;
-        //enable TFIFO_AEMPTY interrupts
-        *I2S_CID_CTRL = *I2S_CID_CTRL | 0x02000000;
-        return 1;
+        _i2s_Tx_BufferPtr->data[(head + i) & I2S_BUFFER_MASK] = data[i];
     }
-    else
+    if(cnt == 0)
+        return 0;
+    _i2s_Tx_BufferPtr->head = (head + cnt) & I2S_BUFFER_MASK;
+
+    if(head == tail)
     {
         //enable TFIFO_AEMPTY interrupts
         *I2S_CID_CTRL = *I2S_CID_CTRL | 0x02000000;
-        return 0;
     }
+    return cnt;
 }
 
 void Curie_I2S::fastPushData(uint32_t data)
@@ -574,12 +606,27 @@ uint32_t Curie_I2S::pullData()
     return data;
 }
 
+int Curie_I2S::pullData(uint32_t *data, int n)
+{
+    int head = _i2s_Rx_BufferPtr->head;
+    int tail = _i2s_Rx_BufferPtr->tail;
+    int avail = (head - tail) & I2S_BUFFER_MASK;
+    int cnt = n < avail ? n : avail;
+
+    for(int i = 0; i < cnt; i++)
+    {
+        data[i] = _i2s_Rx_BufferPtr->data[(tail + i) & I2S_BUFFER_MASK];
+    }
+    _i2s_Rx_BufferPtr->tail = (tail + cnt) & I2S_BUFFER_MASK;
+    return cnt;
+}
+
 uint32_t Curie_I2S::requestdword()
 {
     if(_i2s_Rx_BufferPtr->head != _i2s_Rx_BufferPtr->tail)
     {
         uint32_t data = _i2s_Rx_BufferPtr->data[_i2s_Rx_BufferPtr->tail];
-        _i2s_Rx_BufferPtr->tail = (_i2s_Rx_BufferPtr->tail + 1)%I2S_BUFFER_SIZE;
+        _i2s_Rx_BufferPtr->tail = (_i2s_Rx_BufferPtr->tail + 1) & I2S_BUFFER_MASK;
         return data;
     }
     else
@@ -587,14 +634,14 @@ uint32_t Curie_I2S::requestdword()
         //check if there is data in the FIFO
         if(*I2S_RFIFO_STAT & 0x0000000F)
         {
-            int index = (uint32_t)(_i2s_Rx_BufferPtr->head +1) % I2S_BUFFER_SIZE;
+            int index = (uint32_t)(_i2s_Rx_BufferPtr->head +1) & I2S_BUFFER_MASK;
             uint32_t data = *I2S_DATA_REG;
             if(index != _i2s_Rx_BufferPtr->tail)
             {
                 _i2s_Rx_BufferPtr->data[_i2s_Rx_BufferPtr->head] = data;
                 _i2s_Rx_BufferPtr->head = index;
             }
-            _i2s_Rx_BufferPtr->tail = (_i2s_Rx_BufferPtr->tail + 1)%I2S_BUFFER_SIZE;
+            _i2s_Rx_BufferPtr->tail = (_i2s_Rx_BufferPtr->tail + 1) & I2S_BUFFER_MASK;
             return data;
         }
     }
@@ -603,19 +650,12 @@ uint32_t Curie_I2S::requestdword()
 
 uint16_t Curie_I2S::available()
 {
-    return (uint16_t)(_i2s_Rx_BufferPtr->head - _i2s_Rx_BufferPtr->tail)%I2S_BUFFER_SIZE;
+    return (uint16_t)((_i2s_Rx_BufferPtr->head - _i2s_Rx_BufferPtr->tail) & I2S_BUFFER_MASK);
 }
 
 uint16_t Curie_I2S::availableTx()
 {   
-    if(_i2s_Tx_BufferPtr->tail == _i2s_Tx_BufferPtr->head)
-    {
-        return I2S_BUFFER_SIZE;
-    }
-    else
-    {
-        return ((_i2s_Tx_BufferPtr->tail+I2S_BUFFER_SIZE) - _i2s_Tx_BufferPtr->head+1)%I2S_BUFFER_SIZE;
-    }
+    return (uint16_t)((_i2s_Tx_BufferPtr->tail - _i2s_Tx_BufferPtr->head - 1) & I2S_BUFFER_MASK);
 }
 
 uint8_t Curie_I2S::getTxFIFOLength()
@@ -76,7 +76,27 @@
 #define I2S_RWS     3
 #define I2S_RSCK    8
 
+// Words in each of the rx and tx ring buffers; a power of two, so the
+// indexes wrap with a mask. One slot is kept free to tell full from empty.
+#ifndef I2S_BUFFER_SIZE
 #define I2S_BUFFER_SIZE 256
+#endif
+#define I2S_BUFFER_MASK (I2S_BUFFER_SIZE - 1)
+
+// Words in each hardware FIFO
+#define I2S_FIFO_DEPTH 4
+
+// Default FIFO thresholds, see setFIFOThresholds()
+#ifndef I2S_TFIFO_AEMPTY_THRESHOLD
+#define I2S_TFIFO_AEMPTY_THRESHOLD 2
+#endif
+#ifndef I2S_RFIFO_AFULL_THRESHOLD
+#define I2S_RFIFO_AFULL_THRESHOLD 1
+#endif
+
+#if (I2S_BUFFER_SIZE < 8) || (I2S_BUFFER_SIZE & I2S_BUFFER_MASK)
+#error "I2S_BUFFER_SIZE must be a power of two, at least 8"
+#endif
 
 //#define I2S_DEBUG
 
@@ -89,7 +109,6 @@ struct i2s_ring_buffer
     volatile uint32_t data[I2S_BUFFER_SIZE];
     volatile int head = 0;
     volatile int tail= 0;
-    volatile bool lock = false;
 };
 
 class Curie_I2S
@@ -167,6 +186,18 @@ class Curie_I2S
         //  sets sample rate bor both i2s channels
         void setSampleRate(uint32_t dividerValues);
         
+        // Sets the FIFO levels that raise the tx refill and rx drain
+        // interrupts, 0 to I2S_FIFO_DEPTH - 1. A lower txAlmostEmpty and a
+        // higher rxAlmostFull move more words per interrupt, and so cause
+        // fewer interrupts, but leave less time before an underrun/overrun.
+        void setFIFOThresholds(uint8_t txAlmostEmpty, uint8_t rxAlmostFull);
+        
+        // INTERRUPT_PRIORITY_HIGH lets the FIFO interrupt preempt bulk work,
+        // e.g. the BLE IPC, so refills aren't late. The rx/tx callbacks then
+        // run at that priority too. False when refused: see
+        // ::setInterruptPriority()
+        bool setInterruptPriority(uint32_t priority);
+        
         // sets the bit resolution for both i2s cahnnels
         void setResolution(uint32_t resolution);
         
@@ -181,6 +212,9 @@ class Curie_I2S
         // Pushes a dword into the TX buffer
         int pushData(uint32_t data);
         
+        // Pushes up to n dwords into the TX buffer; returns the number pushed
+        int pushData(const uint32_t *data, int n);
+        
         // Pushes a dword into the TX FIFO
         void fastPushData(uint32_t data);
         
@@ -189,6 +223,9 @@ class Curie_I2S
         // Pulls a dword directly from the RX FIFO
         uint32_t pullData();
         
+        // Pulls up to n dwords from the rx buffer; returns the number pulled
+        int pullData(uint32_t *data, int n);
+        
         // Pulls a dword from the tail of the rx buffer
         uint32_t read() {return requestdword(); };
         
@@ -23,6 +23,7 @@
 #include "CurieI2SDMA.h"
 #include "soc_i2s.h"
 #include "soc_dma.h"
+#include "dma_channel.h"
 #include "variant.h"
 #include <interrupt.h>
 
@@ -30,6 +31,8 @@ static void txi2s_done(void* x);
 static void rxi2s_done(void* x);
 static void txi2s_err(void* x);
 static void rxi2s_err(void* x);
+static void txi2s_block(void* x);
+static void rxi2s_block(void* x);
 
 volatile uint8_t txdone_flag = 0;
 volatile uint8_t txerror_flag = 0;
@@ -38,8 +41,59 @@ volatile uint8_t rxdone_flag = 0;
 volatile uint8_t rxerror_flag = 0;
 uint8_t frameDelay = 0;
 
+// completion callbacks of transTXAsync()/transRXAsync(), cleared as they run
+static volatile I2SDMADoneCallback txdone_cb = NULL;
+static volatile I2SDMADoneCallback rxdone_cb = NULL;
+
+// Circular stream state; the driver only reports that a block is done, so
+// the blocks are counted here in the order the DMA list visits them
+struct i2s_dma_stream
+{
+	uint8_t* buf;
+	uint32_t len_per_buf;
+	uint8_t num_bufs;
+	volatile uint8_t next;
+	I2SDMABlockCallback callback;
+};
+
+static struct i2s_dma_stream txstream;
+static struct i2s_dma_stream rxstream;
+
+static void stream_block(struct i2s_dma_stream* stream)
+{
+	uint8_t* block = stream->buf + stream->next * stream->len_per_buf;
+
+	if(++stream->next == stream->num_bufs)
+		stream->next = 0;
+	if(stream->callback)
+		stream->callback(block, stream->len_per_buf);
+}
+
+static int stream_setup(struct i2s_dma_stream* stream,void* buf,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMABlockCallback callback)
+{
+	if(num_bufs < 2 || len_per_data == 0 || len % (num_bufs * len_per_data))
+		return I2S_DMA_FAIL;
+
+	stream->buf = (uint8_t *)buf;
+	stream->len_per_buf = len / num_bufs;
+	stream->num_bufs = num_bufs;
+	stream->next = 0;
+	stream->callback = callback;
+	return I2S_DMA_OK;
+}
+
 static void txi2s_done(void* x)
 {
+	I2SDMADoneCallback callback = txdone_cb;
+
+	if(callback)
+	{
+		// no delay from the interrupt; the last frame may still be on the wire
+		txdone_cb = NULL;
+		callback(I2S_DMA_OK);
+		return;
+	}
+
 	CurieI2SDMA.lastFrameDelay();
 	txdone_flag = 1;
 
@@ -48,21 +102,85 @@ static void txi2s_done(void* x)
 
 static void rxi2s_done(void* x)
 {
+	I2SDMADoneCallback callback = rxdone_cb;
+
+	if(callback)
+	{
+		rxdone_cb = NULL;
+		callback(I2S_DMA_OK);
+		return;
+	}
+
 	rxdone_flag = 1;
 
 	return;
 }
 
+// Full duplex: both streams count their blocks and the pair callback runs
+// once both have finished the same block index
+static I2SDMADuplexCallback duplex_cb = NULL;
+static volatile uint32_t duplex_tx_blocks;
+static volatile uint32_t duplex_rx_blocks;
+static uint32_t duplex_pairs;
+
+static void duplex_pair(void)
+{
+	while(duplex_pairs != duplex_tx_blocks && duplex_pairs != duplex_rx_blocks)
+	{
+		uint32_t offset = (duplex_pairs % txstream.num_bufs) * txstream.len_per_buf;
+
+		duplex_pairs++;
+		if(duplex_cb)
+			duplex_cb(rxstream.buf + offset, txstream.buf + offset, txstream.len_per_buf);
+	}
+}
+
+static void duplex_tx_block(void* buf, uint32_t len)
+{
+	duplex_tx_blocks++;
+	duplex_pair();
+}
+
+static void duplex_rx_block(void* buf, uint32_t len)
+{
+	duplex_rx_blocks++;
+	duplex_pair();
+}
+
+static void txi2s_block(void* x)
+{
+	stream_block(&txstream);
+}
+
+static void rxi2s_block(void* x)
+{
+	stream_block(&rxstream);
+}
+
 static void txi2s_err(void* x)
 {
+	I2SDMADoneCallback callback = txdone_cb;
+
 	txerror_flag = 1;
+	if(callback)
+	{
+		txdone_cb = NULL;
+		callback(I2S_DMA_FAIL);
+	}
 
 	return;
 }
 
 static void rxi2s_err(void* x)
 {
+	I2SDMADoneCallback callback = rxdone_cb;
+
 	rxerror_flag = 1;
+	if(callback)
+	{
+		rxdone_cb = NULL;
+		callback(I2S_DMA_FAIL);
+	}
     
 	return;
 }
@@ -86,7 +204,7 @@ int Curie_I2SDMA::iniTX()
 {
 	muxTX(1);
 	soc_i2s_init();
-	soc_dma_init();
+	dma_channel_init();
 	return I2S_DMA_OK; 
 }
 
@@ -94,7 +212,7 @@ int Curie_I2SDMA::iniRX()
 {
 	muxRX(1);
 	soc_i2s_init();
-	soc_dma_init();
+	dma_channel_init();
 	return I2S_DMA_OK; 
 }
 
@@ -195,10 +313,49 @@ int Curie_I2SDMA::beginRX(uint16_t sample_rate,uint8_t resolution,uint8_t master
 	return I2S_DMA_OK;
 }
 
-int Curie_I2SDMA::transTX(void* buf_TX,uint32_t len,uint32_t len_per_data)
+int Curie_I2SDMA::transTXAsync(void* buf_TX,uint32_t len,uint32_t len_per_data,I2SDMADoneCallback callback)
 {
+	txdone_flag = 0;
+	txerror_flag = 0;
+	txdone_cb = callback;
+
 	int status = soc_i2s_stream(buf_TX, len,len_per_data,0); 
 	if(status)
+	{
+		txdone_cb = NULL;
+		return I2S_DMA_FAIL;
+	}
+	return I2S_DMA_OK;
+}
+
+int Curie_I2SDMA::transRXAsync(void* buf_RX,uint32_t len,uint32_t len_per_data,I2SDMADoneCallback callback)
+{
+	rxdone_flag = 0;
+	rxerror_flag = 0;
+	rxdone_cb = callback;
+
+	int status = soc_i2s_listen(buf_RX, len ,len_per_data,0);
+	if(status)
+	{
+		rxdone_cb = NULL;
+		return I2S_DMA_FAIL;
+	}
+	return I2S_DMA_OK;
+}
+
+bool Curie_I2SDMA::doneTX()
+{
+	return txdone_flag || txerror_flag;
+}
+
+bool Curie_I2SDMA::doneRX()
+{
+	return rxdone_flag || rxerror_flag;
+}
+
+int Curie_I2SDMA::transTX(void* buf_TX,uint32_t len,uint32_t len_per_data)
+{
+	if(transTXAsync(buf_TX, len, len_per_data, NULL))
 		return I2S_DMA_FAIL;
 	while (1) 
 	{   
@@ -218,8 +375,7 @@ int Curie_I2SDMA::transTX(void* buf_TX,uint32_t len,uint32_t len_per_data)
 
 int Curie_I2SDMA::transRX(void* buf_RX,uint32_t len,uint32_t len_per_data)
 {
-	int status = soc_i2s_listen(buf_RX, len ,len_per_data,0);
-	if(status)
+	if(transRXAsync(buf_RX, len, len_per_data, NULL))
 		return I2S_DMA_FAIL;
 
 	while (1) 
@@ -239,43 +395,246 @@ int Curie_I2SDMA::transRX(void* buf_RX,uint32_t len,uint32_t len_per_data)
 	return I2S_DMA_OK;
 }
 
+int Curie_I2SDMA::streamTX(void* buf_TX,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMABlockCallback callback)
+{
+	if(stream_setup(&txstream, buf_TX, len, len_per_data, num_bufs, callback))
+		return I2S_DMA_FAIL;
+
+	// in circular mode the driver calls cb_done once per block
+	txcfg.cb_done = txi2s_block;
+	txerror_flag = 0;
+	if(soc_i2s_config(I2S_CHANNEL_TX, &txcfg))
+		return I2S_DMA_FAIL;
+
+	if(soc_i2s_stream(buf_TX, len, len_per_data, num_bufs))
+		return I2S_DMA_FAIL;
+	return I2S_DMA_OK;
+}
+
+int Curie_I2SDMA::streamRX(void* buf_RX,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMABlockCallback callback)
+{
+	if(stream_setup(&rxstream, buf_RX, len, len_per_data, num_bufs, callback))
+		return I2S_DMA_FAIL;
+
+	rxcfg.cb_done = rxi2s_block;
+	rxerror_flag = 0;
+	if(soc_i2s_config(I2S_CHANNEL_RX, &rxcfg))
+		return I2S_DMA_FAIL;
+
+	if(soc_i2s_listen(buf_RX, len, len_per_data, num_bufs))
+		return I2S_DMA_FAIL;
+	return I2S_DMA_OK;
+}
+
+int Curie_I2SDMA::streamDuplex(void* buf_TX,void* buf_RX,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMADuplexCallback callback)
+{
+	if(stream_setup(&txstream, buf_TX, len, len_per_data, num_bufs, duplex_tx_block) ||
+	   stream_setup(&rxstream, buf_RX, len, len_per_data, num_bufs, duplex_rx_block))
+		return I2S_DMA_FAIL;
+
+	duplex_cb = callback;
+	duplex_tx_blocks = 0;
+	duplex_rx_blocks = 0;
+	duplex_pairs = 0;
+
+	txcfg.cb_done = txi2s_block;
+	rxcfg.cb_done = rxi2s_block;
+	txerror_flag = 0;
+	rxerror_flag = 0;
+	if(soc_i2s_config(I2S_CHANNEL_TX, &txcfg) || soc_i2s_config(I2S_CHANNEL_RX, &rxcfg))
+		return I2S_DMA_FAIL;
+
+	// Start both channels back to back, a few cycles apart, well within one
+	// frame; no block interrupt can run in between
+	uint32_t flags = interrupt_lock();
+	if(soc_i2s_listen(buf_RX, len, len_per_data, num_bufs))
+	{
+		interrupt_unlock(flags);
+		return I2S_DMA_FAIL;
+	}
+	if(soc_i2s_stream(buf_TX, len, len_per_data, num_bufs))
+	{
+		soc_i2s_stop_listen();
+		interrupt_unlock(flags);
+		return I2S_DMA_FAIL;
+	}
+	interrupt_unlock(flags);
+	return I2S_DMA_OK;
+}
+
+void Curie_I2SDMA::stopDuplex()
+{
+	stopTX();
+	stopRX();
+	duplex_cb = NULL;
+}
+
 void Curie_I2SDMA::stopTX()
 {
 	soc_i2s_stop_stream();
 	muxTX(0);
+
+	// back to one-shot transfers
+	if(txcfg.cb_done != txi2s_done)
+	{
+		txcfg.cb_done = txi2s_done;
+		soc_i2s_config(I2S_CHANNEL_TX, &txcfg);
+	}
 }
 
 void Curie_I2SDMA::stopRX()
 {
 	soc_i2s_stop_listen();
 	muxRX(0);
+
+	if(rxcfg.cb_done != rxi2s_done)
+	{
+		rxcfg.cb_done = rxi2s_done;
+		soc_i2s_config(I2S_CHANNEL_RX, &rxcfg);
+	}
+}
+
+// Interleave/deinterleave kernels, one instance per sample width. The
+// frame loops are unrolled by four; 8 and 16 bit samples are moved a word at
+// a time when all three buffers are word aligned, as the ARC EM core without
+// the DSP option has no packing instructions and byte/halfword accesses cost
+// a bus cycle each.
+template <typename T>
+static void interleave(T* out, const T* left, const T* right, uint32_t frames)
+{
+	uint32_t i = 0;
+
+	for(; i + 4 <= frames; i += 4)
+	{
+		out[0] = left[0];
+		out[1] = right[0];
+		out[2] = left[1];
+		out[3] = right[1];
+		out[4] = left[2];
+		out[5] = right[2];
+		out[6] = left[3];
+		out[7] = right[3];
+		out += 8;
+		left += 4;
+		right += 4;
+	}
+	for(; i < frames; ++i)
+	{
+		*out++ = *left++;
+		*out++ = *right++;
+	}
+}
+
+template <typename T>
+static void deinterleave(T* left, T* right, const T* in, uint32_t frames)
+{
+	uint32_t i = 0;
+
+	for(; i + 4 <= frames; i += 4)
+	{
+		left[0] = in[0];
+		right[0] = in[1];
+		left[1] = in[2];
+		right[1] = in[3];
+		left[2] = in[4];
+		right[2] = in[5];
+		left[3] = in[6];
+		right[3] = in[7];
+		in += 8;
+		left += 4;
+		right += 4;
+	}
+	for(; i < frames; ++i)
+	{
+		*left++ = *in++;
+		*right++ = *in++;
+	}
+}
+
+static inline bool wordAligned(const void* a, const void* b, const void* c)
+{
+	return (((uintptr_t)a | (uintptr_t)b | (uintptr_t)c) & 3) == 0;
+}
+
+// two frames per pair of words
+static uint32_t interleave16(uint32_t* out, const uint32_t* left, const uint32_t* right, uint32_t frames)
+{
+	uint32_t words = frames / 2;
+
+	for(uint32_t i = 0; i < words; ++i)
+	{
+		uint32_t l = left[i];
+		uint32_t r = right[i];
+		out[2*i] = (l & 0xFFFF) | (r << 16);
+		out[2*i+1] = (l >> 16) | (r & 0xFFFF0000);
+	}
+	return words * 2;
+}
+
+static uint32_t deinterleave16(uint32_t* left, uint32_t* right, const uint32_t* in, uint32_t frames)
+{
+	uint32_t words = frames / 2;
+
+	for(uint32_t i = 0; i < words; ++i)
+	{
+		uint32_t a = in[2*i];
+		uint32_t b = in[2*i+1];
+		left[i] = (a & 0xFFFF) | (b << 16);
+		right[i] = (a >> 16) | (b & 0xFFFF0000);
+	}
+	return words * 2;
+}
+
+// four frames per pair of words
+static uint32_t interleave8(uint32_t* out, const uint32_t* left, const uint32_t* right, uint32_t frames)
+{
+	uint32_t words = frames / 4;
+
+	for(uint32_t i = 0; i < words; ++i)
+	{
+		uint32_t l = left[i];
+		uint32_t r = right[i];
+		out[2*i] = (l & 0xFF) | ((r & 0xFF) << 8) | ((l & 0xFF00) << 8) | ((r & 0xFF00) << 16);
+		out[2*i+1] = ((l >> 16) & 0xFF) | ((r >> 8) & 0xFF00) | ((l >> 8) & 0xFF0000) | (r & 0xFF000000);
+	}
+	return words * 4;
+}
+
+static uint32_t deinterleave8(uint32_t* left, uint32_t* right, const uint32_t* in, uint32_t frames)
+{
+	uint32_t words = frames / 4;
+
+	for(uint32_t i = 0; i < words; ++i)
+	{
+		uint32_t a = in[2*i];
+		uint32_t b = in[2*i+1];
+		left[i] = (a & 0xFF) | ((a >> 8) & 0xFF00) | ((b & 0xFF) << 16) | ((b << 8) & 0xFF000000);
+		right[i] = ((a >> 8) & 0xFF) | ((a >> 16) & 0xFF00) | ((b << 8) & 0xFF0000) | (b & 0xFF000000);
+	}
+	return words * 4;
 }
 
 int Curie_I2SDMA::mergeData(void* buf_left,void* buf_right,void* buf_TX,uint32_t length_TX,uint32_t len_per_data)
 {
+	uint32_t frames = length_TX/2;
+	uint32_t done = 0;
+	bool aligned = wordAligned(buf_left, buf_right, buf_TX);
+
 	if(len_per_data == 1)
 	{
-		for(uint32_t i = 0; i < length_TX/2;++i)
-		{
-			*((uint8_t *)buf_TX+2*i) = *((uint8_t *)buf_left+i);
-			*((uint8_t *)buf_TX+2*i+1) = *((uint8_t *)buf_right+i);
-		}
+		if(aligned)
+			done = interleave8((uint32_t *)buf_TX, (const uint32_t *)buf_left, (const uint32_t *)buf_right, frames);
+		interleave((uint8_t *)buf_TX + 2*done, (const uint8_t *)buf_left + done, (const uint8_t *)buf_right + done, frames - done);
 	}
 	else if(len_per_data == 2)
 	{
-		for(uint32_t i = 0; i < length_TX/2;++i)
-		{
-			*((uint16_t *)buf_TX+2*i) = *((uint16_t *)buf_left+i);
-			*((uint16_t *)buf_TX+2*i+1) = *((uint16_t *)buf_right+i);
-		}
+		if(aligned)
+			done = interleave16((uint32_t *)buf_TX, (const uint32_t *)buf_left, (const uint32_t *)buf_right, frames);
+		interleave((uint16_t *)buf_TX + 2*done, (const uint16_t *)buf_left + done, (const uint16_t *)buf_right + done, frames - done);
 	}
 	else if(len_per_data == 4)
 	{
-		for(uint32_t i = 0; i < length_TX/2;++i)
-		{
-			*((uint32_t *)buf_TX+2*i) = *((uint32_t *)buf_left+i);
-			*((uint32_t *)buf_TX+2*i+1) = *((uint32_t *)buf_right+i);
-		}
+		interleave((uint32_t *)buf_TX, (const uint32_t *)buf_left, (const uint32_t *)buf_right, frames);
 	}
 	else
 		return I2S_DMA_FAIL;
@@ -285,29 +644,25 @@ int Curie_I2SDMA::mergeData(void* buf_left,void* buf_right,void* buf_TX,uint32_t
 
 int Curie_I2SDMA::separateData(void* buf_left,void* buf_right,void* buf_RX,uint32_t length_RX,uint32_t len_per_data)
 {	 
+	uint32_t frames = length_RX/2;
+	uint32_t done = 0;
+	bool aligned = wordAligned(buf_left, buf_right, buf_RX);
+
 	if(len_per_data == 1)
 	{
-		for(uint32_t i = 0; i < length_RX/2;++i)
-		{
-			*((uint8_t *)buf_left+i) = *((uint8_t *)buf_RX+2*i);
-			*((uint8_t *)buf_right+i) = *((uint8_t *)buf_RX+2*i+1);
-		}
+		if(aligned)
+			done = deinterleave8((uint32_t *)buf_left, (uint32_t *)buf_right, (const uint32_t *)buf_RX, frames);
+		deinterleave((uint8_t *)buf_left + done, (uint8_t *)buf_right + done, (const uint8_t *)buf_RX + 2*done, frames - done);
 	}
 	else if(len_per_data == 2)
 	{
-		for(uint32_t i = 0; i < length_RX/2;++i)
-		{
-			*((uint16_t *)buf_left+i) = *((uint16_t *)buf_RX+2*i);
-			*((uint16_t *)buf_right+i) = *((uint16_t *)buf_RX+2*i+1);
-		}
+		if(aligned)
+			done = deinterleave16((uint32_t *)buf_left, (uint32_t *)buf_right, (const uint32_t *)buf_RX, frames);
+		deinterleave((uint16_t *)buf_left + done, (uint16_t *)buf_right + done, (const uint16_t *)buf_RX + 2*done, frames - done);
 	}
 	else if(len_per_data == 4)
 	{
-		for(uint32_t i = 0; i < length_RX/2;++i)
-		{
-			*((uint32_t *)buf_left+i) = *((uint32_t *)buf_RX+2*i);
-			*((uint32_t *)buf_right+i) = *((uint32_t *)buf_RX+2*i+1);
-		}
+		deinterleave((uint32_t *)buf_left, (uint32_t *)buf_right, (const uint32_t *)buf_RX, frames);
 	}
 	else
 		return I2S_DMA_FAIL;
@@ -35,6 +35,20 @@
 
 #define I2S_DMA_OK 0
 #define I2S_DMA_FAIL 1
+
+// called from the DMA interrupt with a block of a stream that has just been
+// sent (TX, refill it) or filled (RX, consume it); len is in bytes
+typedef void (*I2SDMABlockCallback)(void* buf, uint32_t len);
+
+// called from the DMA interrupt in full duplex mode with the rx block just
+// filled and the tx block with the same index, just sent; len is in bytes
+typedef void (*I2SDMADuplexCallback)(void* rx, void* tx, uint32_t len);
+
+// called from the interrupt when a one-shot transfer has finished, with
+// I2S_DMA_OK or I2S_DMA_FAIL; the driver releases the channel only after
+// it returns, so start the next transfer from loop(), not from here
+typedef void (*I2SDMADoneCallback)(int status);
+
 class Curie_I2SDMA
 {
 	private:
@@ -65,6 +79,35 @@ class Curie_I2SDMA
 		// starts listening to the rx channel
 		int transRX(void* buf_RX,uint32_t len,uint32_t len_per_data);
 
+		// as transTX()/transRX(), but return as soon as the transfer has
+		// started; the buffer must stay untouched until callback runs, or
+		// doneTX()/doneRX() is true when callback is NULL
+		int transTXAsync(void* buf_TX,uint32_t len,uint32_t len_per_data,I2SDMADoneCallback callback);
+		int transRXAsync(void* buf_RX,uint32_t len,uint32_t len_per_data,I2SDMADoneCallback callback);
+		bool doneTX();
+		bool doneRX();
+
+		// starts continuous transmission: buf_TX is split into num_bufs (at
+		// least 2) equal blocks that the DMA sends back to back, wrapping to
+		// the first, until stopTX(); returns at once
+		int streamTX(void* buf_TX,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMABlockCallback callback);
+
+		// starts continuous listening into num_bufs blocks of buf_RX, as
+		// streamTX(), until stopRX()
+		int streamRX(void* buf_RX,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMABlockCallback callback);
+
+		// starts capture and playback together, both split into num_bufs
+		// blocks as streamTX()/streamRX(); beginTX() and beginRX() must have
+		// set the same sample rate. The callback gets each captured block
+		// with the tx block of the same index to fill, e.g. in place; what it
+		// writes is played num_bufs - 1 blocks after the capture ended. For
+		// exact sample alignment clock RX from the TX frame sync (RX slave,
+		// TWS/TSCK wired to RWS/RSCK).
+		int streamDuplex(void* buf_TX,void* buf_RX,uint32_t len,uint32_t len_per_data,uint8_t num_bufs,I2SDMADuplexCallback callback);
+
+		// stops both directions of streamDuplex()
+		void stopDuplex();
+
 		// merge data of left and right channel into one buffer
 		int mergeData(void* buf_left,void* buf_right,void* buf_TX,uint32_t length_TX,uint32_t len_per_data);
         
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+/*
+   This sketch measures what the CurieIMU library delivers on this board:
+   the sustained readMotionSensor() rate, the SPI time per burst, FIFO
+   drain throughput, the interrupt-to-callback latency and the samples
+   lost at each output data rate. Results go out over Serial as CSV, one
+   row per measurement, so runs of different library versions or boards
+   can be compared:
+
+     test,odr_hz,count,per_s,mean_us,max_us,lost
+
+   Leave the board still while it runs; it takes about half a minute.
+*/
+
+#include "CurieIMU.h"
+#include "soc_gpio.h"
+
+/* The AON GPIO the BMI160 INT1 pin is wired to, as in CurieIMU.cpp */
+#define IMU_INT_AON_PIN   4
+
+const int odrs[] = { 25, 50, 100, 200, 400, 800, 1600 };
+const int numOdrs = sizeof(odrs) / sizeof(odrs[0]);
+const unsigned long testMs = 1000;
+
+CurieIMUSample samples[192];      // a full FIFO of accel + gyro frames
+CurieIMUSample ring[256];
+
+volatile uint32_t callbackCycles;
+volatile bool callbackFired;
+
+void imuCallback() {
+  callbackCycles = cycles();
+  callbackFired = true;
+}
+
+void printRow(const char *test, int odr, unsigned long count, float perSec,
+              float meanUs, float maxUs, long lost) {
+  Serial.print(test);
+  Serial.print(',');
+  Serial.print(odr);
+  Serial.print(',');
+  Serial.print(count);
+  Serial.print(',');
+  Serial.print(perSec, 1);
+  Serial.print(',');
+  Serial.print(meanUs, 2);
+  Serial.print(',');
+  Serial.print(maxUs, 2);
+  Serial.print(',');
+  Serial.println(lost);
+}
+
+void setRates(int odr) {
+  CurieIMU.setAccelerometerRate(odr);
+  CurieIMU.setGyroRate(odr);
+}
+
+// back-to-back readMotionSensor() calls for testMs
+void benchRead() {
+  int ax, ay, az, gx, gy, gz;
+  unsigned long count = 0;
+  uint64_t total = 0;
+  uint32_t worst = 0;
+  unsigned long start = millis();
+
+  while (millis() - start < testMs) {
+    uint32_t t = cycles();
+    CurieIMU.readMotionSensor(ax, ay, az, gx, gy, gz);
+    t = cycles() - t;
+    total += t;
+    if (t > worst)
+      worst = t;
+    count++;
+  }
+
+  printRow("read_motion", 0, count, count * 1000.0 / testMs,
+           total / 32.0 / count, worst / 32.0, 0);
+}
+
+// SPI time of the 3, 12 and 15 byte bursts the library uses most
+void benchBurst() {
+  const int runs = 1000;
+  int16_t ax, ay, az, gx, gy, gz;
+  uint32_t time;
+
+  for (int len = 3; len <= 15; len += len == 3 ? 9 : 3) {
+    uint64_t total = 0;
+    uint32_t worst = 0;
+
+    for (int i = 0; i < runs; i++) {
+      uint32_t t = cycles();
+      if (len == 3)
+        CurieIMU.getSensorTime();
+      else if (len == 12)
+        CurieIMU.getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+      else
+        CurieIMU.getMotion6(&ax, &ay, &az, &gx, &gy, &gz, &time);
+      t = cycles() - t;
+      total += t;
+      if (t > worst)
+        worst = t;
+    }
+
+    char name[16];
+    sprintf(name, "spi_burst_%d", len);
+    printRow(name, 0, runs, 0, total / 32.0 / runs, worst / 32.0, 0);
+  }
+}
+
+// one-burst drains of a nearly full FIFO at 1600 Hz; per_s is bytes/s
+void benchFIFODrain() {
+  const int runs = 10;
+  uint64_t total = 0;
+  uint32_t worst = 0;
+  unsigned long bytes = 0;
+
+  setRates(1600);
+  CurieIMU.beginFIFO(ACCEL | GYRO, 0, false);
+
+  for (int i = 0; i < runs; i++) {
+    CurieIMU.resetFIFO();
+    delay(70);                          // ~1000 bytes at 12 bytes a frame
+    unsigned count = CurieIMU.getFIFOCount() & BMI160_FIFO_LENGTH_MASK;
+
+    uint32_t t = cycles();
+    CurieIMU.readFIFO(samples, sizeof(samples) / sizeof(samples[0]));
+    t = cycles() - t;
+    total += t;
+    if (t > worst)
+      worst = t;
+    bytes += count;
+  }
+
+  CurieIMU.endFIFO();
+  printRow("fifo_drain", 1600, bytes, bytes / (total / 32.0e6),
+           total / 32.0 / runs, worst / 32.0, 0);
+}
+
+// From the INT1 edge, seen with interrupts locked, to imuCallback()
+void benchLatency(int odr) {
+  const int runs = 50;
+  uint64_t total = 0;
+  uint32_t worst = 0;
+  int done = 0;
+  boolean_t level;
+
+  setRates(odr);
+  CurieIMU.attachInterrupt(imuCallback);
+  CurieIMU.setInterruptLatch(BMI160_LATCH_MODE_312_5_US);
+  CurieIMU.interrupts(CURIE_IMU_DATA_READY);
+
+  for (int i = 0; i < runs; i++) {
+    uint32_t limit = 4 * 32000000UL / odr;
+    uint32_t start = cycles();
+    uint32_t saved = interrupt_lock();
+    bool seen = false;
+
+    /* wait for high, then for the falling edge */
+    do {
+      soc_gpio_read(SOC_GPIO_AON, IMU_INT_AON_PIN, &level);
+    } while (!level && cycles() - start < limit);
+    do {
+      soc_gpio_read(SOC_GPIO_AON, IMU_INT_AON_PIN, &level);
+      seen = !level;
+    } while (!seen && cycles() - start < limit);
+
+    uint32_t edge = cycles();
+    callbackFired = false;
+    interrupt_unlock(saved);
+    if (!seen)
+      continue;
+
+    start = cycles();
+    while (!callbackFired && cycles() - start < limit)
+      ;
+    if (!callbackFired)
+      continue;
+    uint32_t t = callbackCycles - edge;
+    total += t;
+    if (t > worst)
+      worst = t;
+    done++;
+  }
+
+  CurieIMU.noInterrupts(CURIE_IMU_DATA_READY);
+  CurieIMU.detachInterrupt();
+  printRow("irq_latency", odr, done, 0, done ? total / 32.0 / done : 0,
+           worst / 32.0, runs - done);
+}
+
+// accel + gyro streamed from the watermark interrupt for testMs, then
+// what is left drained; lost is frames expected minus frames received
+void benchDropped(int odr) {
+  CurieIMUSample batch[32];
+  unsigned long frames = 0;
+  /* about 20 ms of 13 byte frames between interrupts */
+  unsigned watermark = constrain(odr * 13 / 50, 16, 512);
+
+  setRates(odr);
+  CurieIMU.beginFIFO(ACCEL | GYRO, watermark, true);
+  unsigned long start = micros();
+  CurieIMU.beginFIFOStream(ring, sizeof(ring) / sizeof(ring[0]));
+
+  while (micros() - start < testMs * 1000UL) {
+    size_t n = CurieIMU.readStream(batch, sizeof(batch) / sizeof(batch[0]));
+    for (size_t i = 0; i < n; i++)
+      frames += batch[i].type == CURIE_IMU_SAMPLE_GYRO;
+  }
+  CurieIMU.endFIFOStream();
+
+  size_t n;
+  while ((n = CurieIMU.readFIFO(batch, sizeof(batch) / sizeof(batch[0]))))
+    for (size_t i = 0; i < n; i++)
+      frames += batch[i].type == CURIE_IMU_SAMPLE_GYRO;
+  unsigned long elapsed = micros() - start;
+  CurieIMU.endFIFO();
+
+  long expected = (long)((float)odr * elapsed / 1e6);
+  long lost = expected - (long)frames;
+  printRow("stream_lost", odr, frames, frames * 1e6 / elapsed, 0, 0,
+           lost > 0 ? lost : 0);
+}
+
+void setup() {
+  Serial.begin(115200); // initialize Serial communication
+  while (!Serial);      // wait for the serial port to open
+
+  if (!CurieIMU.begin()) {
+    Serial.println("# CurieIMU connection failed");
+    while (1);
+  }
+
+  Serial.println("test,odr_hz,count,per_s,mean_us,max_us,lost");
+  setRates(1600);
+  benchRead();
+  benchBurst();
+  benchFIFODrain();
+  for (int i = 0; i < numOdrs; i++)
+    benchLatency(odrs[i]);
+  for (int i = 0; i < numOdrs; i++)
+    benchDropped(odrs[i]);
+  Serial.println("# done");
+}
+
+void loop() {
+}
+
+/*
+   Copyright (c) 2017 Intel Corporation.  All rights reserved.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
@@ -42,18 +42,21 @@ void loop() {
 
 
 static void eventCallback(void){
-  if (CurieIMU.getInterruptStatus(CURIE_IMU_MOTION)) {
-    if (CurieIMU.motionDetected(X_AXIS, POSITIVE))
+  // one SPI read for all the checks below
+  CurieIMUInterruptStatus status = CurieIMU.readInterruptStatus();
+
+  if (status.feature(CURIE_IMU_MOTION)) {
+    if (status.motion(X_AXIS, POSITIVE))
       Serial.println("Negative motion detected on X-axis");
-    if (CurieIMU.motionDetected(X_AXIS, NEGATIVE))
+    if (status.motion(X_AXIS, NEGATIVE))
       Serial.println("Positive motion detected on X-axis");
-    if (CurieIMU.motionDetected(Y_AXIS, POSITIVE))
+    if (status.motion(Y_AXIS, POSITIVE))
       Serial.println("Negative motion detected on Y-axis");
-    if (CurieIMU.motionDetected(Y_AXIS, NEGATIVE))
+    if (status.motion(Y_AXIS, NEGATIVE))
       Serial.println("Positive motion detected on Y-axis");
-    if (CurieIMU.motionDetected(Z_AXIS, POSITIVE))
+    if (status.motion(Z_AXIS, POSITIVE))
       Serial.println("Negative motion detected on Z-axis");
-    if (CurieIMU.motionDetected(Z_AXIS, NEGATIVE))
+    if (status.motion(Z_AXIS, NEGATIVE))
       Serial.println("Positive motion detected on Z-axis");
     interruptsTime = millis(); 
   } 
@@ -36,18 +36,21 @@ void loop() {
 
 static void eventCallback()
 {
-  if (CurieIMU.getInterruptStatus(CURIE_IMU_TAP)) {
-    if (CurieIMU.tapDetected(X_AXIS, NEGATIVE))
+  // one SPI read for all the checks below
+  CurieIMUInterruptStatus status = CurieIMU.readInterruptStatus();
+
+  if (status.feature(CURIE_IMU_TAP)) {
+    if (status.tap(X_AXIS, NEGATIVE))
       Serial.println("Tap detected on negative X-axis");
-    if (CurieIMU.tapDetected(X_AXIS, POSITIVE))
+    if (status.tap(X_AXIS, POSITIVE))
       Serial.println("Tap detected on positive X-axis");
-    if (CurieIMU.tapDetected(Y_AXIS, NEGATIVE))
+    if (status.tap(Y_AXIS, NEGATIVE))
       Serial.println("Tap detected on negative Y-axis");
-    if (CurieIMU.tapDetected(Y_AXIS, POSITIVE))
+    if (status.tap(Y_AXIS, POSITIVE))
       Serial.println("Tap detected on positive Y-axis");
-    if (CurieIMU.tapDetected(Z_AXIS, NEGATIVE))
+    if (status.tap(Z_AXIS, NEGATIVE))
       Serial.println("Tap detected on negative Z-axis");
-    if (CurieIMU.tapDetected(Z_AXIS, POSITIVE))
+    if (status.tap(Z_AXIS, POSITIVE))
       Serial.println("Tap detected on positive Z-axis");
   }
 }
@@ -42,40 +42,49 @@ THE SOFTWARE.
 
 /******************************************************************************/
 
-uint8_t BMI160Class::reg_read (uint8_t reg)
+/* Register accesses go through the RegisterCache base; these are the bus
+ * transfers behind it.  Writes burst from reg, which the BMI160 auto-increments.
+ */
+void BMI160Class::busRead(uint8_t reg, uint8_t *data, unsigned len)
 {
-    uint8_t buffer[1];
+    uint8_t buffer[1 + BMI160_CACHE_COUNT];
+
     buffer[0] = reg;
-    serial_buffer_transfer(buffer, 1, 1);
-    return buffer[0];
+    serial_buffer_transfer(buffer, 1, len);
+    memcpy(data, buffer, len);
 }
 
-void BMI160Class::reg_write(uint8_t reg, uint8_t data)
+void BMI160Class::busWrite(uint8_t reg, const uint8_t *data, unsigned len)
 {
-    uint8_t buffer[2];
+    uint8_t buffer[1 + BMI160_CACHE_COUNT];
+
     buffer[0] = reg;
-    buffer[1] = data;
-    serial_buffer_transfer(buffer, 2, 0);
+    memcpy(&buffer[1], data, len);
+    serial_buffer_transfer(buffer, 1 + len, 0);
+}
+
+uint8_t BMI160Class::reg_read (uint8_t reg)
+{
+    return read(reg);
+}
+
+void BMI160Class::reg_write(uint8_t reg, uint8_t data)
+{
+    write(reg, data);
+
+    /* A soft reset puts every register back to its default */
+    if (reg == BMI160_RA_CMD && data == BMI160_CMD_SOFT_RESET)
+        invalidate();
 }
 
 void BMI160Class::reg_write_bits(uint8_t reg, uint8_t data, unsigned pos, unsigned len)
 {
-    uint8_t b = reg_read(reg);
-    uint8_t mask = ((1 << len) - 1) << pos;
-    data <<= pos; // shift data into correct position
-    data &= mask; // zero all non-important bits in data
-    b &= ~(mask); // zero all important bits in existing byte
-    b |= data; // combine data with existing byte
-    reg_write(reg, b);
+    writeBits(reg, data, pos, len);
 }
 
 uint8_t BMI160Class::reg_read_bits(uint8_t reg, unsigned pos, unsigned len)
 {
-    uint8_t b = reg_read(reg);
-    uint8_t mask = (1 << len) - 1;
-    b >>= pos;
-    b &= mask;
-    return b;
+    return readBits(reg, pos, len);
 }
 
 int BMI160Class::isBitSet(uint8_t value, unsigned bit)
@@ -92,44 +101,81 @@ int BMI160Class::isBitSet(uint8_t value, unsigned bit)
  */
 void BMI160Class::initialize(unsigned int flags)
 {
+    initializeAsync(flags);
+    while (poll())
+        delay(1);
+}
+
+/* Steps of the operation poll() is running */
+enum {
+    BMI160_STEP_IDLE = 0,
+    BMI160_STEP_RESET,          /* soft reset sent */
+    BMI160_STEP_SPI,            /* dummy read sent */
+    BMI160_STEP_ACC_UP,         /* waiting for the accelerometer */
+    BMI160_STEP_GYR_UP,         /* waiting for the gyroscope */
+    BMI160_STEP_FOC,            /* waiting for the offset compensation */
+};
+
+/* Time between the steps, and between the status checks */
+#define BMI160_STEP_US              1000
+
+void BMI160Class::asyncWait(uint8_t step)
+{
+    _async_step = step;
+    _async_time = micros32();
+}
+
+/** Start initialize() without waiting for the device.
+ * The soft reset is sent right away; poll() then powers up the sensors
+ * requested and loads the defaults, a step each time one is due.
+ * @return False if another operation is still running
+ * @see poll()
+ */
+bool BMI160Class::initializeAsync(unsigned int flags)
+{
+    if (_async_step != BMI160_STEP_IDLE)
+        return false;
+
     sensors_enabled = 0;
+    _async_flags = flags;
+    _async_op = BMI160_ASYNC_INIT;
+
+    /* Registers the device updates, or whose writes start something */
+    for (uint8_t reg = BMI160_RA_MAG_IF_0; reg <= BMI160_RA_MAG_IF_4; reg++)
+        setVolatile(reg);
+    setVolatile(BMI160_RA_SELF_TEST);
+    for (uint8_t reg = BMI160_RA_OFFSET_0; reg <= BMI160_RA_STEP_CNT_H; reg++)
+        setVolatile(reg);
 
     /* Issue a soft-reset to bring the device into a clean state */
     reg_write(BMI160_RA_CMD, BMI160_CMD_SOFT_RESET);
-    delay(1);
-
-    /* Issue a dummy-read to force the device into SPI comms mode */
-    reg_read(0x7F);
-    delay(1);
+    asyncWait(BMI160_STEP_RESET);
+    return true;
+}
 
-    if (flags & ACCEL) {
-        /* Power up the accelerometer */
+/* Powers up the next sensor asked for, or ends the initialization */
+void BMI160Class::asyncPowerUp(void)
+{
+    if ((_async_flags & ACCEL) && !(sensors_enabled & ACCEL)) {
         reg_write(BMI160_RA_CMD, BMI160_CMD_ACC_MODE_NORMAL);
-        delay(1);
-
-        /* Wait for power-up to complete */
-        while (0x1 != reg_read_bits(BMI160_RA_PMU_STATUS,
-                                BMI160_ACC_PMU_STATUS_BIT,
-                                BMI160_ACC_PMU_STATUS_LEN))
-            delay(1);
-
-        sensors_enabled |= ACCEL;
+        asyncWait(BMI160_STEP_ACC_UP);
+        return;
     }
 
-    if (flags & GYRO) {
-        /* Power up the gyroscope */
+    if ((_async_flags & GYRO) && !(sensors_enabled & GYRO)) {
         reg_write(BMI160_RA_CMD, BMI160_CMD_GYR_MODE_NORMAL);
-        delay(1);
-
-        /* Wait for power-up to complete */
-        while (0x1 != reg_read_bits(BMI160_RA_PMU_STATUS,
-                                BMI160_GYR_PMU_STATUS_BIT,
-                                BMI160_GYR_PMU_STATUS_LEN))
-            delay(1);
-
-        sensors_enabled |= GYRO;
+        asyncWait(BMI160_STEP_GYR_UP);
+        return;
     }
 
+    /* Load the configuration registers in one read, so the setters below
+     * only write.  With a sensor in normal mode the writes can also go out
+     * as bursts; with both suspended the device needs 450us between writes.
+     */
+    prefetch();
+    if (sensors_enabled)
+        beginBatch();
+
     setFullScaleGyroRange(BMI160_GYRO_RANGE_250, 250.0f);
     setFullScaleAccelRange(BMI160_ACCEL_RANGE_2G, 2.0f);
 
@@ -137,6 +183,77 @@ void BMI160Class::initialize(unsigned int flags)
     reg_write(BMI160_RA_INT_MAP_0, 0xFF);
     reg_write(BMI160_RA_INT_MAP_1, 0xF0);
     reg_write(BMI160_RA_INT_MAP_2, 0x00);
+
+    if (sensors_enabled)
+        endBatch();
+
+    _async_step = BMI160_STEP_IDLE;
+}
+
+/** Run the next step of initializeAsync() or autoCalibrate*Async(), if
+ * it's due.  Call it from loop() or a timer; the other calls must wait
+ * until it returns false.
+ * @return True while the operation is still running
+ * @see getAsyncOperation()
+ */
+bool BMI160Class::poll()
+{
+    if (_async_step == BMI160_STEP_IDLE)
+        return false;
+    if (micros32() - _async_time < BMI160_STEP_US)
+        return true;
+
+    switch (_async_step) {
+        case BMI160_STEP_RESET:
+            /* Issue a dummy-read to force the device into SPI comms mode */
+            reg_read(0x7F);
+            asyncWait(BMI160_STEP_SPI);
+            break;
+
+        case BMI160_STEP_SPI:
+            asyncPowerUp();
+            break;
+
+        case BMI160_STEP_ACC_UP:
+            if (0x1 != reg_read_bits(BMI160_RA_PMU_STATUS,
+                                     BMI160_ACC_PMU_STATUS_BIT,
+                                     BMI160_ACC_PMU_STATUS_LEN)) {
+                asyncWait(BMI160_STEP_ACC_UP);
+                break;
+            }
+            sensors_enabled |= ACCEL;
+            asyncPowerUp();
+            break;
+
+        case BMI160_STEP_GYR_UP:
+            if (0x1 != reg_read_bits(BMI160_RA_PMU_STATUS,
+                                     BMI160_GYR_PMU_STATUS_BIT,
+                                     BMI160_GYR_PMU_STATUS_LEN)) {
+                asyncWait(BMI160_STEP_GYR_UP);
+                break;
+            }
+            sensors_enabled |= GYRO;
+            asyncPowerUp();
+            break;
+
+        case BMI160_STEP_FOC:
+            if (!reg_read_bits(BMI160_RA_STATUS, BMI160_STATUS_FOC_RDY, 1)) {
+                asyncWait(BMI160_STEP_FOC);
+                break;
+            }
+            _async_step = BMI160_STEP_IDLE;
+            break;
+    }
+
+    return _async_step != BMI160_STEP_IDLE;
+}
+
+/** The operation poll() is running, or finished last.
+ * @see BMI160AsyncOp
+ */
+BMI160AsyncOp BMI160Class::getAsyncOperation()
+{
+    return (BMI160AsyncOp)_async_op;
 }
 
 /** Get Device ID.
@@ -332,6 +449,49 @@ void BMI160Class::setAccelDLPFMode(uint8_t mode) {
                           BMI160_ACCEL_DLPF_SEL_LEN);
 }
 
+/** Get accelerometer undersampling enabled value.
+ * @see setAccelUndersampling()
+ * @see BMI160_RA_ACCEL_CONF
+ */
+bool BMI160Class::getAccelUndersampling() {
+    return !!(reg_read_bits(BMI160_RA_ACCEL_CONF,
+                            BMI160_ACCEL_US_BIT,
+                            1));
+}
+
+/** Set accelerometer undersampling enabled value.
+ * With undersampling, the accelerometer in low power mode samples in bursts
+ * and sleeps in between; the DLPF setting (@see setAccelDLPFMode()) then
+ * selects the number of samples averaged, 2^bwp, rather than the filter.
+ * @param enabled New undersampling enabled value
+ * @see BMI160_RA_ACCEL_CONF
+ */
+void BMI160Class::setAccelUndersampling(bool enabled) {
+    reg_write_bits(BMI160_RA_ACCEL_CONF, enabled ? 0x1 : 0,
+                   BMI160_ACCEL_US_BIT,
+                   1);
+}
+
+/** Get accelerometer power mode.
+ * @return BMI160_PMU_SUSPEND, BMI160_PMU_NORMAL or BMI160_PMU_LOW_POWER
+ * @see BMI160_RA_PMU_STATUS
+ */
+uint8_t BMI160Class::getAccelPowerMode() {
+    return reg_read_bits(BMI160_RA_PMU_STATUS,
+                         BMI160_ACC_PMU_STATUS_BIT,
+                         BMI160_ACC_PMU_STATUS_LEN);
+}
+
+/** Get gyroscope power mode.
+ * @return BMI160_PMU_SUSPEND, BMI160_PMU_NORMAL or BMI160_PMU_FAST_STARTUP
+ * @see BMI160_RA_PMU_STATUS
+ */
+uint8_t BMI160Class::getGyroPowerMode() {
+    return reg_read_bits(BMI160_RA_PMU_STATUS,
+                         BMI160_GYR_PMU_STATUS_BIT,
+                         BMI160_GYR_PMU_STATUS_LEN);
+}
+
 /** Get full-scale gyroscope range.
  * The gyr_range parameter allows setting the full-scale range of the gyro sensors,
  * as described in the table below.
@@ -363,6 +523,8 @@ void BMI160Class::setFullScaleGyroRange(uint8_t range, float real) {
                    BMI160_GYRO_RANGE_SEL_BIT,
                    BMI160_GYRO_RANGE_SEL_LEN);
     gyro_range = real;
+    gyro_slope = (real * 2.0f) / BMI160_SENSOR_RANGE;
+    gyro_range_int = (int32_t)real;
 }
 
 /** Get full-scale accelerometer range.
@@ -396,6 +558,8 @@ void BMI160Class::setFullScaleAccelRange(uint8_t range, float real) {
                    BMI160_ACCEL_RANGE_SEL_BIT,
                    BMI160_ACCEL_RANGE_SEL_LEN);
     accel_range = real;
+    accel_slope = (real * 2.0f) / BMI160_SENSOR_RANGE;
+    accel_range_int = (int32_t)real;
 }
 
 /** Get accelerometer offset compensation enabled value.
@@ -437,22 +601,9 @@ void BMI160Class::setAccelOffsetEnabled(bool enabled) {
  * @see BMI160_RA_CMD
  */
 void BMI160Class::autoCalibrateXAccelOffset(int target) {
-    uint8_t foc_conf;
-    if (target == 1)
-        foc_conf = (0x1 << BMI160_FOC_ACC_X_BIT);
-    else if (target == -1)
-        foc_conf = (0x2 << BMI160_FOC_ACC_X_BIT);
-    else if (target == 0)
-        foc_conf = (0x3 << BMI160_FOC_ACC_X_BIT);
-    else
-        return;  /* Invalid target value */
-
-    reg_write(BMI160_RA_FOC_CONF, foc_conf);
-    reg_write(BMI160_RA_CMD, BMI160_CMD_START_FOC);
-    while (!(reg_read_bits(BMI160_RA_STATUS,
-                           BMI160_STATUS_FOC_RDY,
-                           1)))
-        delay(1);
+    if (autoCalibrateAccelOffsetAsync(BMI160_FOC_ACC_X_BIT, target))
+        while (poll())
+            delay(1);
 }
 
 /** Execute internal calibration to generate Accelerometer Y-Axis offset value.
@@ -474,22 +625,9 @@ void BMI160Class::autoCalibrateXAccelOffset(int target) {
  * @see BMI160_RA_CMD
  */
 void BMI160Class::autoCalibrateYAccelOffset(int target) {
-    uint8_t foc_conf;
-    if (target == 1)
-        foc_conf = (0x1 << BMI160_FOC_ACC_Y_BIT);
-    else if (target == -1)
-        foc_conf = (0x2 << BMI160_FOC_ACC_Y_BIT);
-    else if (target == 0)
-        foc_conf = (0x3 << BMI160_FOC_ACC_Y_BIT);
-    else
-        return;  /* Invalid target value */
-
-    reg_write(BMI160_RA_FOC_CONF, foc_conf);
-    reg_write(BMI160_RA_CMD, BMI160_CMD_START_FOC);
-    while (!(reg_read_bits(BMI160_RA_STATUS,
-                           BMI160_STATUS_FOC_RDY,
-                           1)))
-        delay(1);
+    if (autoCalibrateAccelOffsetAsync(BMI160_FOC_ACC_Y_BIT, target))
+        while (poll())
+            delay(1);
 }
 
 /** Execute internal calibration to generate Accelerometer Z-Axis offset value.
@@ -511,22 +649,9 @@ void BMI160Class::autoCalibrateYAccelOffset(int target) {
  * @see BMI160_RA_CMD
  */
 void BMI160Class::autoCalibrateZAccelOffset(int target) {
-    uint8_t foc_conf;
-    if (target == 1)
-        foc_conf = (0x1 << BMI160_FOC_ACC_Z_BIT);
-    else if (target == -1)
-        foc_conf = (0x2 << BMI160_FOC_ACC_Z_BIT);
-    else if (target == 0)
-        foc_conf = (0x3 << BMI160_FOC_ACC_Z_BIT);
-    else
-        return;  /* Invalid target value */
-
-    reg_write(BMI160_RA_FOC_CONF, foc_conf);
-    reg_write(BMI160_RA_CMD, BMI160_CMD_START_FOC);
-    while (!(reg_read_bits(BMI160_RA_STATUS,
-                           BMI160_STATUS_FOC_RDY,
-                           1)))
-        delay(1);
+    if (autoCalibrateAccelOffsetAsync(BMI160_FOC_ACC_Z_BIT, target))
+        while (poll())
+            delay(1);
 }
 
 /** Get offset compensation value for accelerometer X-axis data.
@@ -626,13 +751,51 @@ void BMI160Class::setGyroOffsetEnabled(bool enabled) {
  * @see BMI160_RA_CMD
  */
 void BMI160Class::autoCalibrateGyroOffset() {
-    uint8_t foc_conf = (1 << BMI160_FOC_GYR_EN);
+    if (autoCalibrateGyroOffsetAsync())
+        while (poll())
+            delay(1);
+}
+
+/* Starts the fast offset compensation, which poll() waits for */
+bool BMI160Class::startFOC(uint8_t foc_conf, uint8_t op) {
+    if (_async_step != BMI160_STEP_IDLE)
+        return false;
+
+    _async_op = op;
     reg_write(BMI160_RA_FOC_CONF, foc_conf);
     reg_write(BMI160_RA_CMD, BMI160_CMD_START_FOC);
-    while (!(reg_read_bits(BMI160_RA_STATUS,
-                           BMI160_STATUS_FOC_RDY,
-                           1)))
-        delay(1);
+    asyncWait(BMI160_STEP_FOC);
+    return true;
+}
+
+/** Start autoCalibrateGyroOffset() without waiting for it to complete.
+ * The same restrictions apply until poll() returns false.
+ * @return False if another operation is still running
+ * @see poll()
+ */
+bool BMI160Class::autoCalibrateGyroOffsetAsync() {
+    return startFOC(1 << BMI160_FOC_GYR_EN, BMI160_ASYNC_FOC_GYRO);
+}
+
+/** Start autoCalibrate[X/Y/Z]AccelOffset() without waiting for it to complete.
+ * The same restrictions apply until poll() returns false.
+ * @param bit BMI160_FOC_ACC_X_BIT, BMI160_FOC_ACC_Y_BIT or BMI160_FOC_ACC_Z_BIT
+ * @param target axis target value (0 = 0g, 1 = +1g, -1 = -1g)
+ * @return False if target is invalid or another operation is still running
+ * @see poll()
+ */
+bool BMI160Class::autoCalibrateAccelOffsetAsync(unsigned bit, int target) {
+    uint8_t foc_conf;
+    if (target == 1)
+        foc_conf = (0x1 << bit);
+    else if (target == -1)
+        foc_conf = (0x2 << bit);
+    else if (target == 0)
+        foc_conf = (0x3 << bit);
+    else
+        return false;  /* Invalid target value */
+
+    return startFOC(foc_conf, BMI160_ASYNC_FOC_ACCEL);
 }
 
 /** Get offset compensation value for gyroscope X-axis data.
@@ -1502,6 +1665,31 @@ void BMI160Class::setIntFIFOBufferFullEnabled(bool enabled) {
                    1);
 }
 
+/** Get FIFO Watermark interrupt enabled status.
+ * Will be set 0 for disabled, 1 for enabled.
+ * @return Current interrupt enabled status
+ * @see BMI160_RA_INT_EN_1
+ * @see BMI160_FWM_EN_BIT
+ **/
+bool BMI160Class::getIntFIFOWatermarkEnabled() {
+    return !!(reg_read_bits(BMI160_RA_INT_EN_1,
+                            BMI160_FWM_EN_BIT,
+                            1));
+}
+
+/** Set FIFO Watermark interrupt enabled status.
+ * @param enabled New interrupt enabled status
+ * @see getIntFIFOWatermarkEnabled()
+ * @see setFIFOWatermark()
+ * @see BMI160_RA_INT_EN_1
+ * @see BMI160_FWM_EN_BIT
+ **/
+void BMI160Class::setIntFIFOWatermarkEnabled(bool enabled) {
+    reg_write_bits(BMI160_RA_INT_EN_1, enabled ? 0x1 : 0x0,
+                   BMI160_FWM_EN_BIT,
+                   1);
+}
+
 /** Get Data Ready interrupt enabled setting.
  * This event occurs each time a write operation to all of the sensor registers
  * has been completed. Will be set 0 for disabled, 1 for enabled.
@@ -1591,6 +1779,27 @@ uint16_t BMI160Class::getFIFOCount() {
     return (((int16_t)buffer[1]) << 8) | buffer[0];
 }
 
+/** Get FIFO watermark level.
+ * The FIFO Watermark interrupt fires when the FIFO fill level reaches this
+ * many bytes.
+ * @return Watermark level in bytes, a multiple of 4
+ * @see BMI160_RA_FIFO_CONFIG_0
+ */
+uint16_t BMI160Class::getFIFOWatermark() {
+    return reg_read(BMI160_RA_FIFO_CONFIG_0) * 4;
+}
+
+/** Set FIFO watermark level.
+ * @param bytes New watermark level in bytes, rounded down to a multiple of 4
+ * @see getFIFOWatermark()
+ * @see BMI160_RA_FIFO_CONFIG_0
+ */
+void BMI160Class::setFIFOWatermark(uint16_t bytes) {
+    if (bytes > BMI160_FIFO_SIZE - 4)
+        bytes = BMI160_FIFO_SIZE - 4;
+    reg_write(BMI160_RA_FIFO_CONFIG_0, bytes / 4);
+}
+
 /** Reset the FIFO.
  * This command clears all data in the FIFO buffer.  It is recommended
  * to invoke this after reconfiguring the FIFO.
@@ -2062,6 +2271,19 @@ bool BMI160Class::getIntFIFOBufferFullStatus() {
                             1));
 }
 
+/** Get FIFO Watermark interrupt status.
+ * This bit is set while the FIFO holds at least the watermark number of
+ * bytes, and clears once it has been read below it.
+ * @return Current interrupt status
+ * @see BMI160_RA_INT_STATUS_1
+ * @see BMI160_FWM_INT_BIT
+ */
+bool BMI160Class::getIntFIFOWatermarkStatus() {
+    return !!(reg_read_bits(BMI160_RA_INT_STATUS_1,
+                            BMI160_FWM_INT_BIT,
+                            1));
+}
+
 /** Get Data Ready interrupt status.
  * This bit automatically sets to 1 when a Data Ready interrupt has been
  * generated. The bit clears to 0 after the data registers have been read.
@@ -2218,6 +2440,183 @@ void BMI160Class::getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx,
     *az = (((int16_t)buffer[11]) << 8) | buffer[10];
 }
 
+/** Get raw 6-axis motion sensor readings with the sensor time.
+ * The same burst read continues through the SENSORTIME registers, which
+ * are shadowed with the data registers during a burst, so time is the
+ * sensor time of these readings.
+ * @param time 24-bit container for the sensor time, 39.0625 us per count
+ * @see getMotion6()
+ * @see getSensorTime()
+ */
+void BMI160Class::getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz, uint32_t* time) {
+    uint8_t buffer[15];
+    buffer[0] = BMI160_RA_GYRO_X_L;
+    serial_buffer_transfer(buffer, 1, 15);
+    *gx = (((int16_t)buffer[1])  << 8) | buffer[0];
+    *gy = (((int16_t)buffer[3])  << 8) | buffer[2];
+    *gz = (((int16_t)buffer[5])  << 8) | buffer[4];
+    *ax = (((int16_t)buffer[7])  << 8) | buffer[6];
+    *ay = (((int16_t)buffer[9])  << 8) | buffer[8];
+    *az = (((int16_t)buffer[11]) << 8) | buffer[10];
+    *time = ((uint32_t)buffer[14] << 16) | (buffer[13] << 8) | buffer[12];
+}
+
+/** Get the sensor time.
+ * A 24-bit counter running at 25.6 kHz (39.0625 us per count) while the
+ * device is powered, wrapping every 655.36 seconds.
+ * @return Current sensor time
+ * @see BMI160_RA_SENSORTIME_0
+ */
+uint32_t BMI160Class::getSensorTime() {
+    uint8_t buffer[3];
+    buffer[0] = BMI160_RA_SENSORTIME_0;
+    serial_buffer_transfer(buffer, 1, 3);
+    return ((uint32_t)buffer[2] << 16) | (buffer[1] << 8) | buffer[0];
+}
+
+/** Get raw 9-axis readings, with a magnetometer behind MAG_IF.
+ * One burst from the magnetometer data registers through the accelerometer
+ * ones, so the three come from the same sampling instant.
+ * @see getMotion6()
+ * @see setMagAutoMode()
+ */
+void BMI160Class::getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz,
+                             int16_t* mx, int16_t* my, int16_t* mz) {
+    uint8_t buffer[20];
+    buffer[0] = BMI160_RA_MAG_X_L;
+    serial_buffer_transfer(buffer, 1, 20);
+    *mx = (((int16_t)buffer[1])  << 8) | buffer[0];
+    *my = (((int16_t)buffer[3])  << 8) | buffer[2];
+    *mz = (((int16_t)buffer[5])  << 8) | buffer[4];
+    *gx = (((int16_t)buffer[9])  << 8) | buffer[8];
+    *gy = (((int16_t)buffer[11]) << 8) | buffer[10];
+    *gz = (((int16_t)buffer[13]) << 8) | buffer[12];
+    *ax = (((int16_t)buffer[15]) << 8) | buffer[14];
+    *ay = (((int16_t)buffer[17]) << 8) | buffer[16];
+    *az = (((int16_t)buffer[19]) << 8) | buffer[18];
+}
+
+/** Get the magnetometer data registers.
+ * These hold the 8 bytes of the last MAG_IF read, as the magnetometer
+ * stores them: for a BMM150, X, Y and Z with their flag bits and RHALL,
+ * which its own compensation turns into field values.
+ * @see BMI160_RA_MAG_X_L
+ */
+void BMI160Class::getMagnetometer(int16_t* x, int16_t* y, int16_t* z, uint16_t* rhall) {
+    uint8_t buffer[BMI160_MAG_DATA_LEN];
+    buffer[0] = BMI160_RA_MAG_X_L;
+    serial_buffer_transfer(buffer, 1, BMI160_MAG_DATA_LEN);
+    *x = (((int16_t)buffer[1]) << 8) | buffer[0];
+    *y = (((int16_t)buffer[3]) << 8) | buffer[2];
+    *z = (((int16_t)buffer[5]) << 8) | buffer[4];
+    *rhall = (((uint16_t)buffer[7]) << 8) | buffer[6];
+}
+
+/* Longest wait for a manual MAG_IF transfer, in 100us polls */
+#define BMI160_MAG_IF_TIMEOUT       20
+
+/* Waits for the manual MAG_IF transfer to finish; false on timeout */
+bool BMI160Class::waitMagIdle() {
+    for (int i = 0; i < BMI160_MAG_IF_TIMEOUT; i++) {
+        if (!reg_read_bits(BMI160_RA_STATUS, BMI160_STATUS_MAG_MAN_OP, 1))
+            return true;
+        delayMicroseconds(100);
+    }
+    return false;
+}
+
+/** Power up the secondary I2C interface in manual mode.
+ * The magnetometer can then be set up with magWriteRegister() before
+ * setMagAutoMode() hands it to the BMI160 to poll.
+ * @param address 7-bit I2C address of the magnetometer (0x10 for a BMM150)
+ * @return False if the interface doesn't come up
+ * @see BMI160_RA_MAG_IF_0
+ */
+bool BMI160Class::initializeMagInterface(uint8_t address) {
+    reg_write(BMI160_RA_CMD, BMI160_CMD_MAG_MODE_NORMAL);
+    delay(1);
+
+    for (int i = 0; i < BMI160_MAG_IF_TIMEOUT; i++) {
+        if (reg_read_bits(BMI160_RA_PMU_STATUS,
+                          BMI160_MAG_PMU_STATUS_BIT,
+                          BMI160_MAG_PMU_STATUS_LEN) == BMI160_PMU_NORMAL)
+            break;
+        if (i == BMI160_MAG_IF_TIMEOUT - 1)
+            return false;
+        delayMicroseconds(100);
+    }
+
+    reg_write_bits(BMI160_RA_IF_CONF, BMI160_IF_MODE_MAG,
+                   BMI160_IF_MODE_BIT,
+                   BMI160_IF_MODE_LEN);
+    reg_write(BMI160_RA_MAG_IF_0, address << 1);
+    setMagManualMode();
+    return true;
+}
+
+/** Write a magnetometer register through MAG_IF, in manual mode.
+ * @return False if the transfer didn't complete
+ * @see setMagManualMode()
+ */
+bool BMI160Class::magWriteRegister(uint8_t reg, uint8_t data) {
+    reg_write(BMI160_RA_MAG_IF_4, data);
+    reg_write(BMI160_RA_MAG_IF_3, reg);
+    return waitMagIdle();
+}
+
+/** Read a magnetometer register through MAG_IF, in manual mode.
+ * @return The register value, or -1 if the transfer didn't complete
+ * @see setMagManualMode()
+ */
+int BMI160Class::magReadRegister(uint8_t reg) {
+    reg_write(BMI160_RA_MAG_IF_2, reg);
+    if (!waitMagIdle())
+        return -1;
+    return reg_read(BMI160_RA_MAG_X_L);
+}
+
+/** Let the BMI160 read the magnetometer by itself.
+ * Every period it reads 8 bytes from dataReg into the magnetometer data
+ * registers, and into the FIFO when enabled there, so one burst or FIFO
+ * frame holds all three sensors.  The magnetometer must already be set
+ * to measure on its own (or a forced measurement per read).
+ * @param dataReg First magnetometer data register (0x42 for a BMM150)
+ * @param rate Read rate, from the same codes as BMI160AccelRate
+ * @see getMotion9()
+ */
+void BMI160Class::setMagAutoMode(uint8_t dataReg, uint8_t rate) {
+    reg_write_bits(BMI160_RA_MAG_CONF, rate,
+                   BMI160_MAG_RATE_SEL_BIT,
+                   BMI160_MAG_RATE_SEL_LEN);
+    reg_write(BMI160_RA_MAG_IF_2, dataReg);
+    reg_write(BMI160_RA_MAG_IF_1, BMI160_MAG_RD_BURST_8 << BMI160_MAG_RD_BURST_BIT);
+    sensors_enabled |= MAG;
+}
+
+/** Stop the automatic reads, to access the magnetometer directly.
+ * Manual reads return one byte at a time.
+ * @see magReadRegister()
+ * @see magWriteRegister()
+ */
+void BMI160Class::setMagManualMode() {
+    reg_write(BMI160_RA_MAG_IF_1, 1 << BMI160_MAG_MANUAL_EN_BIT);
+    waitMagIdle();
+    sensors_enabled &= ~MAG;
+}
+
+/** Suspend the secondary I2C interface.
+ * The magnetometer itself is left as it is; put it to sleep first through
+ * magWriteRegister() if it should stop drawing current.
+ */
+void BMI160Class::disableMagInterface() {
+    setMagManualMode();
+    reg_write_bits(BMI160_RA_IF_CONF, 0,
+                   BMI160_IF_MODE_BIT,
+                   BMI160_IF_MODE_LEN);
+    reg_write(BMI160_RA_CMD, BMI160_CMD_MAG_MODE_SUSPEND);
+    delay(1);
+}
+
 /** Get 3-axis accelerometer readings.
  * These registers store the most recent accelerometer measurements.
  * Accelerometer measurements are written to these registers at the Output Data Rate
@@ -34,6 +34,7 @@ THE SOFTWARE.
 #define _BMI160_H_
 
 #include "Arduino.h"
+#include "RegisterCache.h"
 
 #define BMI160_SENSOR_RANGE         65535.0f
 #define BMI160_SENSOR_LOW           32768.0f
@@ -47,8 +48,22 @@ THE SOFTWARE.
 #define BMI160_GYR_PMU_STATUS_BIT   2
 #define BMI160_GYR_PMU_STATUS_LEN   2
 
+/* PMU_STATUS field values */
+#define BMI160_PMU_SUSPEND          0x0
+#define BMI160_PMU_NORMAL           0x1
+#define BMI160_PMU_LOW_POWER        0x2
+#define BMI160_PMU_FAST_STARTUP     0x3
+
+#define BMI160_MAG_PMU_STATUS_BIT   0
+#define BMI160_MAG_PMU_STATUS_LEN   2
+
 #define BMI160_RA_PMU_STATUS        0x03
 
+/* Auxiliary magnetometer data, as read by the MAG_IF burst */
+#define BMI160_RA_MAG_X_L           0x04
+#define BMI160_RA_MAG_RHALL_L       0x0A
+#define BMI160_MAG_DATA_LEN         8
+
 #define BMI160_RA_GYRO_X_L          0x0C
 #define BMI160_RA_GYRO_X_H          0x0D
 #define BMI160_RA_GYRO_Y_L          0x0E
@@ -62,8 +77,16 @@ THE SOFTWARE.
 #define BMI160_RA_ACCEL_Z_L         0x16
 #define BMI160_RA_ACCEL_Z_H         0x17
 
+/* 24-bit free-running counter, 39.0625 us (1 / 25.6 kHz) a count */
+#define BMI160_RA_SENSORTIME_0      0x18
+#define BMI160_RA_SENSORTIME_1      0x19
+#define BMI160_RA_SENSORTIME_2      0x1A
+#define BMI160_SENSORTIME_MASK      0xFFFFFF
+
+#define BMI160_STATUS_MAG_MAN_OP    2
 #define BMI160_STATUS_FOC_RDY       3
 #define BMI160_STATUS_NVM_RDY       4
+#define BMI160_STATUS_DRDY_MAG      5
 #define BMI160_STATUS_DRDY_GYR      6
 #define BMI160_STATUS_DRDY_ACC      7
 
@@ -75,6 +98,7 @@ THE SOFTWARE.
 #define BMI160_S_TAP_INT_BIT        5
 #define BMI160_NOMOTION_INT_BIT     7
 #define BMI160_FFULL_INT_BIT        5
+#define BMI160_FWM_INT_BIT          6
 #define BMI160_DRDY_INT_BIT         4
 #define BMI160_LOW_G_INT_BIT        3
 #define BMI160_HIGH_G_INT_BIT       2
@@ -108,6 +132,19 @@ THE SOFTWARE.
 #define BMI160_FIFO_DATA_INVALID    0x80
 #define BMI160_RA_FIFO_DATA         0x24
 
+#define BMI160_FIFO_SIZE            1024
+#define BMI160_FIFO_LENGTH_MASK     0x7FF
+
+/* Header-mode frame headers: a regular frame sets one bit per sensor */
+#define BMI160_FIFO_HEAD_DATA       0x80
+#define BMI160_FIFO_HEAD_MAG        0x10
+#define BMI160_FIFO_HEAD_GYR        0x08
+#define BMI160_FIFO_HEAD_ACC        0x04
+#define BMI160_FIFO_HEAD_SKIP       0x40
+#define BMI160_FIFO_HEAD_TIME       0x44
+#define BMI160_FIFO_HEAD_CONFIG     0x48
+#define BMI160_FIFO_TIME_LEN        4
+
 #define BMI160_ACCEL_RATE_SEL_BIT    0
 #define BMI160_ACCEL_RATE_SEL_LEN    4
 
@@ -120,13 +157,31 @@ THE SOFTWARE.
 #define BMI160_RA_GYRO_CONF         0X42
 #define BMI160_RA_GYRO_RANGE        0X43
 
+#define BMI160_FIFO_TIME_EN_BIT     1
 #define BMI160_FIFO_HEADER_EN_BIT   4
+#define BMI160_FIFO_MAG_EN_BIT      5
 #define BMI160_FIFO_ACC_EN_BIT      6
 #define BMI160_FIFO_GYR_EN_BIT      7
 
 #define BMI160_RA_FIFO_CONFIG_0     0x46
 #define BMI160_RA_FIFO_CONFIG_1     0x47
 
+#define BMI160_MAG_RATE_SEL_BIT     0
+#define BMI160_MAG_RATE_SEL_LEN     4
+
+#define BMI160_RA_MAG_CONF          0x44
+
+#define BMI160_MAG_RD_BURST_BIT     0
+#define BMI160_MAG_RD_BURST_LEN     2
+#define BMI160_MAG_RD_BURST_8       0x3
+#define BMI160_MAG_MANUAL_EN_BIT    7
+
+#define BMI160_RA_MAG_IF_0          0x4B    /* I2C address << 1 */
+#define BMI160_RA_MAG_IF_1          0x4C    /* manual mode, read burst */
+#define BMI160_RA_MAG_IF_2          0x4D    /* register to read */
+#define BMI160_RA_MAG_IF_3          0x4E    /* register to write */
+#define BMI160_RA_MAG_IF_4          0x4F    /* data to write */
+
 #define BMI160_ANYMOTION_EN_BIT     0
 #define BMI160_ANYMOTION_EN_LEN     3
 #define BMI160_D_TAP_EN_BIT         4
@@ -141,6 +196,7 @@ THE SOFTWARE.
 #define BMI160_STEP_EN_BIT          3
 #define BMI160_DRDY_EN_BIT          4
 #define BMI160_FFULL_EN_BIT         5
+#define BMI160_FWM_EN_BIT           6
 
 #define BMI160_RA_INT_EN_0          0x50
 #define BMI160_RA_INT_EN_1          0x51
@@ -200,6 +256,14 @@ THE SOFTWARE.
 
 #define BMI160_RA_FOC_CONF          0x69
 
+#define BMI160_IF_MODE_BIT          4
+#define BMI160_IF_MODE_LEN          2
+#define BMI160_IF_MODE_MAG          0x2     /* SPI primary, MAG_IF on */
+
+#define BMI160_RA_IF_CONF           0x6B
+
+#define BMI160_RA_SELF_TEST         0x6D
+
 #define BMI160_GYR_OFFSET_X_MSB_BIT 0
 #define BMI160_GYR_OFFSET_X_MSB_LEN 2
 #define BMI160_GYR_OFFSET_Y_MSB_BIT 2
@@ -253,13 +317,18 @@ THE SOFTWARE.
 
 #define BMI160_ACCEL_DLPF_SEL_BIT   4
 #define BMI160_ACCEL_DLPF_SEL_LEN   3
+#define BMI160_ACCEL_US_BIT         7
 
 #define BMI160_ACCEL_RANGE_SEL_BIT  0
 #define BMI160_ACCEL_RANGE_SEL_LEN  4
 
 #define BMI160_CMD_START_FOC        0x03
 #define BMI160_CMD_ACC_MODE_NORMAL  0x11
+#define BMI160_CMD_ACC_MODE_LOWPOWER 0x12
+#define BMI160_CMD_GYR_MODE_SUSPEND 0x14
 #define BMI160_CMD_GYR_MODE_NORMAL  0x15
+#define BMI160_CMD_MAG_MODE_SUSPEND 0x18
+#define BMI160_CMD_MAG_MODE_NORMAL  0x19
 #define BMI160_CMD_FIFO_FLUSH       0xB0
 #define BMI160_CMD_INT_RESET        0xB1
 #define BMI160_CMD_STEP_CNT_CLR     0xB2
@@ -270,7 +339,8 @@ THE SOFTWARE.
 /* Bit flags for selecting individual sensors */
 typedef enum {
     GYRO = 0x1,
-    ACCEL = 0x2
+    ACCEL = 0x2,
+    MAG = 0x4       /* a magnetometer behind MAG_IF, @see setMagAutoMode() */
 } CurieIMUSensor;
 
 /**
@@ -475,9 +545,27 @@ typedef enum {
     BMI160_ZERO_MOTION_DURATION_430_08S,        /**< 430.08 seconds */
 } BMI160ZeroMotionDuration;
 
-class BMI160Class {
+/**
+ * Operations run in the background by poll()
+ * @see BMI160Class::getAsyncOperation()
+ */
+typedef enum {
+    BMI160_ASYNC_NONE = 0,
+    BMI160_ASYNC_INIT,          /**< initializeAsync() */
+    BMI160_ASYNC_FOC_GYRO,      /**< autoCalibrateGyroOffsetAsync() */
+    BMI160_ASYNC_FOC_ACCEL,     /**< autoCalibrateAccelOffsetAsync() */
+} BMI160AsyncOp;
+
+/* Registers from ACC_CONF up to, but not including, CMD are cached */
+#define BMI160_CACHE_FIRST          0x40
+#define BMI160_CACHE_COUNT          (BMI160_RA_CMD - BMI160_CACHE_FIRST)
+
+class BMI160Class : private RegisterCache<BMI160_CACHE_FIRST, BMI160_CACHE_COUNT> {
     public:
         void initialize(unsigned int flags);
+        bool initializeAsync(unsigned int flags);
+        bool poll();
+        BMI160AsyncOp getAsyncOperation();
         bool testConnection();
 
         bool isEnabled(unsigned int sensors);
@@ -492,6 +580,11 @@ class BMI160Class {
 
         uint8_t getAccelDLPFMode();
         void setAccelDLPFMode(uint8_t bandwidth);
+        bool getAccelUndersampling();
+        void setAccelUndersampling(bool enabled);
+
+        uint8_t getAccelPowerMode();
+        uint8_t getGyroPowerMode();
 
         uint8_t getFullScaleGyroRange();
         void setFullScaleGyroRange(uint8_t range, float real);
@@ -499,6 +592,7 @@ class BMI160Class {
         void setFullScaleAccelRange(uint8_t range, float real);
 
         void autoCalibrateGyroOffset();
+        bool autoCalibrateGyroOffsetAsync();
         bool getGyroOffsetEnabled();
         void setGyroOffsetEnabled(bool enabled);
 
@@ -512,6 +606,7 @@ class BMI160Class {
         void autoCalibrateXAccelOffset(int target);
         void autoCalibrateYAccelOffset(int target);
         void autoCalibrateZAccelOffset(int target);
+        bool autoCalibrateAccelOffsetAsync(unsigned bit, int target);
         bool getAccelOffsetEnabled();
         void setAccelOffsetEnabled(bool enabled);
 
@@ -587,6 +682,8 @@ class BMI160Class {
 
         bool getIntFIFOBufferFullEnabled();
         void setIntFIFOBufferFullEnabled(bool enabled);
+        bool getIntFIFOWatermarkEnabled();
+        void setIntFIFOWatermarkEnabled(bool enabled);
         bool getIntDataReadyEnabled();
         void setIntDataReadyEnabled(bool enabled);
 
@@ -602,9 +699,23 @@ class BMI160Class {
         bool getIntTapStatus();
         bool getIntDoubleTapStatus();
         bool getIntFIFOBufferFullStatus();
+        bool getIntFIFOWatermarkStatus();
         bool getIntDataReadyStatus();
 
         void getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
+        void getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz, uint32_t* time);
+        uint32_t getSensorTime();
+        void getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz,
+                        int16_t* mx, int16_t* my, int16_t* mz);
+        void getMagnetometer(int16_t* x, int16_t* y, int16_t* z, uint16_t* rhall);
+
+        bool initializeMagInterface(uint8_t address);
+        bool magWriteRegister(uint8_t reg, uint8_t data);
+        int magReadRegister(uint8_t reg);
+        void setMagAutoMode(uint8_t dataReg, uint8_t rate);
+        void setMagManualMode();
+        void disableMagInterface();
+
         void getAcceleration(int16_t* x, int16_t* y, int16_t* z);
         int16_t getAccelerationX();
         int16_t getAccelerationY();
@@ -643,6 +754,8 @@ class BMI160Class {
         void resetFIFO();
 
         uint16_t getFIFOCount();
+        uint16_t getFIFOWatermark();
+        void setFIFOWatermark(uint16_t bytes);
         void getFIFOBytes(uint8_t *data, uint16_t length);
 
         uint8_t getDeviceID();
@@ -665,6 +778,12 @@ class BMI160Class {
         unsigned sensors_enabled;
         float accel_range;
         float gyro_range;
+        /* Cached by the range setters: scaled units per raw count, and the
+         * range as an integer for the Q16 conversions */
+        float accel_slope;
+        float gyro_slope;
+        int32_t accel_range_int;
+        int32_t gyro_range_int;
 
     protected:
         virtual int serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt, unsigned rx_cnt) = 0;
@@ -674,6 +793,20 @@ class BMI160Class {
         void reg_write(uint8_t reg, uint8_t data);
         void reg_write_bits(uint8_t reg, uint8_t data, unsigned pos, unsigned len);
         uint8_t reg_read_bits(uint8_t reg, unsigned pos, unsigned len);
+
+        void busRead(uint8_t reg, uint8_t *data, unsigned len);
+        void busWrite(uint8_t reg, const uint8_t *data, unsigned len);
+
+        bool waitMagIdle();
+
+        void asyncWait(uint8_t step);
+        void asyncPowerUp(void);
+        bool startFOC(uint8_t foc_conf, uint8_t op);
+
+        uint8_t _async_op;          /* BMI160AsyncOp */
+        uint8_t _async_step;        /* where poll() is in it */
+        unsigned _async_flags;      /* sensors initializeAsync() powers up */
+        uint32_t _async_time;       /* micros32() of the last step */
 };
 
 #endif /* _BMI160_H_ */
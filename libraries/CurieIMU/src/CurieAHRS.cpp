@@ -0,0 +1,409 @@
+/*
+ * Orientation filter for the BMI160 on Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "CurieAHRS.h"
+
+#define AHRS_BETA_DEFAULT       0.1f
+#define AHRS_KP_DEFAULT         0.5f
+
+/* The fixed point gains carry 8 bits more than Q30, so that the smallest
+ * ones (a low gyro range at 1600 Hz) keep their precision */
+#define AHRS_K_SHIFT            8
+#define AHRS_K_ONE              ((float)(1ULL << (30 + AHRS_K_SHIFT)))
+
+#define AHRS_DEG_TO_RAD         ((float)DEG_TO_RAD)
+#define AHRS_RAD_TO_DEG         ((float)RAD_TO_DEG)
+
+/* 1 / sqrt(x) from the bit trick and two Newton steps, to about 5e-6 */
+static inline float invSqrt(float x)
+{
+    float half = 0.5f * x;
+    float y;
+    int32_t i;
+
+    memcpy(&i, &x, sizeof(i));
+    i = 0x5f3759df - (i >> 1);
+    memcpy(&y, &i, sizeof(y));
+    y *= 1.5f - half * y * y;
+    return y * (1.5f - half * y * y);
+}
+
+static inline int32_t mul30(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+static uint32_t isqrt32(uint32_t n)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > n)
+        bit >>= 2;
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+CurieAHRSClass::CurieAHRSClass()
+{
+    _filter = CURIE_AHRS_MADGWICK;
+    _dt = 0.01f;
+    _gain = AHRS_BETA_DEFAULT;
+    _ki_dt = 0.0f;
+    _gyro_scale = 0.0f;
+    _accel_slope = 0.0f;
+    _half_dt_count = _kp_half_dt = _ki_half_dt2 = 0;
+    reset();
+}
+
+void CurieAHRSClass::begin(float sampleRate, CurieAHRSFilter filter,
+                           float gain, float ki)
+{
+    _filter = filter;
+    _dt = 1.0f / sampleRate;
+    if (gain <= 0.0f)
+        gain = filter == CURIE_AHRS_MADGWICK ? AHRS_BETA_DEFAULT : AHRS_KP_DEFAULT;
+    _gain = gain;
+    _ki_dt = ki * _dt;
+
+    _gyro_scale = CurieIMU.gyro_slope * AHRS_DEG_TO_RAD;
+    _accel_slope = CurieIMU.accel_slope;
+
+    _half_dt_count = (int32_t)(_gyro_scale * _dt * 0.5f * AHRS_K_ONE + 0.5f);
+    _kp_half_dt = (int32_t)(gain * _dt * 0.5f * AHRS_K_ONE + 0.5f);
+    _ki_half_dt2 = (int32_t)(ki * _dt * _dt * 0.5f * AHRS_K_ONE + 0.5f);
+
+    reset();
+}
+
+void CurieAHRSClass::reset(void)
+{
+    _q[0] = 1.0f;
+    _q[1] = _q[2] = _q[3] = 0.0f;
+    _ix = _iy = _iz = 0.0f;
+
+    _fq[0] = CURIE_AHRS_Q30_ONE;
+    _fq[1] = _fq[2] = _fq[3] = 0;
+    _fix = _fiy = _fiz = 0;
+
+    _last_ax = _last_ay = _last_az = 0;
+}
+
+void CurieAHRSClass::update(float gx, float gy, float gz, float ax, float ay, float az)
+{
+    if (_filter == CURIE_AHRS_MAHONY_FIXED) {
+        float g = AHRS_DEG_TO_RAD / _gyro_scale;
+        float a = 1.0f / _accel_slope;
+
+        stepFixed(lrintf(gx * g), lrintf(gy * g), lrintf(gz * g),
+                  lrintf(ax * a), lrintf(ay * a), lrintf(az * a));
+        return;
+    }
+
+    gx *= AHRS_DEG_TO_RAD;
+    gy *= AHRS_DEG_TO_RAD;
+    gz *= AHRS_DEG_TO_RAD;
+    if (_filter == CURIE_AHRS_MAHONY)
+        stepMahony(gx, gy, gz, ax, ay, az);
+    else
+        stepMadgwick(gx, gy, gz, ax, ay, az);
+}
+
+void CurieAHRSClass::updateRaw(int gx, int gy, int gz, int ax, int ay, int az)
+{
+    if (_filter == CURIE_AHRS_MAHONY_FIXED) {
+        stepFixed(gx, gy, gz, ax, ay, az);
+        return;
+    }
+
+    /* the accelerometer is normalized, so its scale doesn't matter */
+    if (_filter == CURIE_AHRS_MAHONY)
+        stepMahony(gx * _gyro_scale, gy * _gyro_scale, gz * _gyro_scale, ax, ay, az);
+    else
+        stepMadgwick(gx * _gyro_scale, gy * _gyro_scale, gz * _gyro_scale, ax, ay, az);
+}
+
+size_t CurieAHRSClass::update(const CurieIMUSample *samples, size_t count)
+{
+    size_t steps = 0;
+
+    /* a FIFO frame holds the gyroscope before the accelerometer, so the
+     * correction runs one frame behind, which the filter can't tell */
+    for (size_t i = 0; i < count; i++) {
+        const CurieIMUSample *s = &samples[i];
+
+        if (s->type == CURIE_IMU_SAMPLE_ACCEL) {
+            _last_ax = s->x;
+            _last_ay = s->y;
+            _last_az = s->z;
+        } else if (s->type == CURIE_IMU_SAMPLE_GYRO) {
+            updateRaw(s->x, s->y, s->z, _last_ax, _last_ay, _last_az);
+            steps++;
+        }
+    }
+
+    return steps;
+}
+
+void CurieAHRSClass::stepMadgwick(float gx, float gy, float gz, float ax, float ay, float az)
+{
+    float q0 = _q[0], q1 = _q[1], q2 = _q[2], q3 = _q[3];
+    float recipNorm;
+
+    /* rate of change of the quaternion from the gyroscope */
+    float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qDot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qDot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qDot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    if (ax != 0.0f || ay != 0.0f || az != 0.0f) {
+        recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        float _2q0 = 2.0f * q0;
+        float _2q1 = 2.0f * q1;
+        float _2q2 = 2.0f * q2;
+        float _2q3 = 2.0f * q3;
+        float _4q0 = 4.0f * q0;
+        float _4q1 = 4.0f * q1;
+        float _4q2 = 4.0f * q2;
+        float _8q1 = 8.0f * q1;
+        float _8q2 = 8.0f * q2;
+        float q0q0 = q0 * q0;
+        float q1q1 = q1 * q1;
+        float q2q2 = q2 * q2;
+        float q3q3 = q3 * q3;
+
+        /* gradient of the gravity error */
+        float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 +
+                   _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 +
+                   _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+        float n = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (n > 0.0f) {
+            recipNorm = _gain * invSqrt(n);
+            qDot0 -= recipNorm * s0;
+            qDot1 -= recipNorm * s1;
+            qDot2 -= recipNorm * s2;
+            qDot3 -= recipNorm * s3;
+        }
+    }
+
+    q0 += qDot0 * _dt;
+    q1 += qDot1 * _dt;
+    q2 += qDot2 * _dt;
+    q3 += qDot3 * _dt;
+
+    recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    _q[0] = q0 * recipNorm;
+    _q[1] = q1 * recipNorm;
+    _q[2] = q2 * recipNorm;
+    _q[3] = q3 * recipNorm;
+}
+
+void CurieAHRSClass::stepMahony(float gx, float gy, float gz, float ax, float ay, float az)
+{
+    float q0 = _q[0], q1 = _q[1], q2 = _q[2], q3 = _q[3];
+    float recipNorm;
+
+    if (ax != 0.0f || ay != 0.0f || az != 0.0f) {
+        recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        /* gravity as the quaternion sees it, and its error */
+        float vx = 2.0f * (q1 * q3 - q0 * q2);
+        float vy = 2.0f * (q0 * q1 + q2 * q3);
+        float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        if (_ki_dt > 0.0f) {
+            _ix += _ki_dt * ex;
+            _iy += _ki_dt * ey;
+            _iz += _ki_dt * ez;
+            gx += _ix;
+            gy += _iy;
+            gz += _iz;
+        }
+        gx += _gain * ex;
+        gy += _gain * ey;
+        gz += _gain * ez;
+    }
+
+    float h = 0.5f * _dt;
+    gx *= h;
+    gy *= h;
+    gz *= h;
+
+    _q[0] = q0 - q1 * gx - q2 * gy - q3 * gz;
+    _q[1] = q1 + q0 * gx + q2 * gz - q3 * gy;
+    _q[2] = q2 + q0 * gy - q1 * gz + q3 * gx;
+    _q[3] = q3 + q0 * gz + q1 * gy - q2 * gx;
+
+    recipNorm = invSqrt(_q[0] * _q[0] + _q[1] * _q[1] + _q[2] * _q[2] + _q[3] * _q[3]);
+    _q[0] *= recipNorm;
+    _q[1] *= recipNorm;
+    _q[2] *= recipNorm;
+    _q[3] *= recipNorm;
+}
+
+void CurieAHRSClass::stepFixed(int32_t gx, int32_t gy, int32_t gz,
+                               int32_t ax, int32_t ay, int32_t az)
+{
+    int32_t q0 = _fq[0], q1 = _fq[1], q2 = _fq[2], q3 = _fq[3];
+
+    /* half of this step's rotation, Q30 */
+    int32_t hx = ((int64_t)gx * _half_dt_count) >> AHRS_K_SHIFT;
+    int32_t hy = ((int64_t)gy * _half_dt_count) >> AHRS_K_SHIFT;
+    int32_t hz = ((int64_t)gz * _half_dt_count) >> AHRS_K_SHIFT;
+
+    if (ax != 0 || ay != 0 || az != 0) {
+        /* |a| <= norm, so a * (2^30 / norm) stays within Q30 */
+        uint32_t norm = isqrt32((uint32_t)(ax * ax) + (uint32_t)(ay * ay) +
+                                (uint32_t)(az * az));
+        int32_t inv = (int32_t)((uint32_t)CURIE_AHRS_Q30_ONE / (norm ? norm : 1));
+        ax *= inv;
+        ay *= inv;
+        az *= inv;
+
+        int32_t vx = 2 * (mul30(q1, q3) - mul30(q0, q2));
+        int32_t vy = 2 * (mul30(q0, q1) + mul30(q2, q3));
+        int32_t vz = mul30(q0, q0) - mul30(q1, q1) - mul30(q2, q2) + mul30(q3, q3);
+        int32_t ex = mul30(ay, vz) - mul30(az, vy);
+        int32_t ey = mul30(az, vx) - mul30(ax, vz);
+        int32_t ez = mul30(ax, vy) - mul30(ay, vx);
+
+        if (_ki_half_dt2) {
+            _fix += (int64_t)ex * _ki_half_dt2;
+            _fiy += (int64_t)ey * _ki_half_dt2;
+            _fiz += (int64_t)ez * _ki_half_dt2;
+            hx += (int32_t)(_fix >> (30 + AHRS_K_SHIFT));
+            hy += (int32_t)(_fiy >> (30 + AHRS_K_SHIFT));
+            hz += (int32_t)(_fiz >> (30 + AHRS_K_SHIFT));
+        }
+        hx += ((int64_t)ex * _kp_half_dt) >> (30 + AHRS_K_SHIFT);
+        hy += ((int64_t)ey * _kp_half_dt) >> (30 + AHRS_K_SHIFT);
+        hz += ((int64_t)ez * _kp_half_dt) >> (30 + AHRS_K_SHIFT);
+    }
+
+    int32_t n0 = q0 - mul30(q1, hx) - mul30(q2, hy) - mul30(q3, hz);
+    int32_t n1 = q1 + mul30(q0, hx) + mul30(q2, hz) - mul30(q3, hy);
+    int32_t n2 = q2 + mul30(q0, hy) - mul30(q1, hz) + mul30(q3, hx);
+    int32_t n3 = q3 + mul30(q0, hz) + mul30(q1, hy) - mul30(q2, hx);
+
+    /* each step moves |q| only slightly off 1, where one Newton step of
+     * 1 / sqrt(n), 1.5 - n / 2, is exact to well below an LSB */
+    int32_t n = mul30(n0, n0) + mul30(n1, n1) + mul30(n2, n2) + mul30(n3, n3);
+    int32_t inv = CURIE_AHRS_Q30_ONE + ((CURIE_AHRS_Q30_ONE - n) >> 1);
+    _fq[0] = mul30(n0, inv);
+    _fq[1] = mul30(n1, inv);
+    _fq[2] = mul30(n2, inv);
+    _fq[3] = mul30(n3, inv);
+}
+
+void CurieAHRSClass::loadQuaternion(float q[4])
+{
+    if (_filter == CURIE_AHRS_MAHONY_FIXED) {
+        for (int i = 0; i < 4; i++)
+            q[i] = _fq[i] * (1.0f / CURIE_AHRS_Q30_ONE);
+    } else {
+        for (int i = 0; i < 4; i++)
+            q[i] = _q[i];
+    }
+}
+
+void CurieAHRSClass::getQuaternion(float &w, float &x, float &y, float &z)
+{
+    float q[4];
+
+    loadQuaternion(q);
+    w = q[0];
+    x = q[1];
+    y = q[2];
+    z = q[3];
+}
+
+void CurieAHRSClass::getQuaternionQ30(int32_t &w, int32_t &x, int32_t &y, int32_t &z)
+{
+    if (_filter == CURIE_AHRS_MAHONY_FIXED) {
+        w = _fq[0];
+        x = _fq[1];
+        y = _fq[2];
+        z = _fq[3];
+    } else {
+        w = lrintf(_q[0] * CURIE_AHRS_Q30_ONE);
+        x = lrintf(_q[1] * CURIE_AHRS_Q30_ONE);
+        y = lrintf(_q[2] * CURIE_AHRS_Q30_ONE);
+        z = lrintf(_q[3] * CURIE_AHRS_Q30_ONE);
+    }
+}
+
+float CurieAHRSClass::getRoll(void)
+{
+    float q[4];
+
+    loadQuaternion(q);
+    return atan2f(2.0f * (q[0] * q[1] + q[2] * q[3]),
+                  1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) * AHRS_RAD_TO_DEG;
+}
+
+float CurieAHRSClass::getPitch(void)
+{
+    float q[4];
+    float s;
+
+    loadQuaternion(q);
+    s = 2.0f * (q[0] * q[2] - q[3] * q[1]);
+    if (s > 1.0f)
+        s = 1.0f;
+    else if (s < -1.0f)
+        s = -1.0f;
+    return asinf(s) * AHRS_RAD_TO_DEG;
+}
+
+float CurieAHRSClass::getYaw(void)
+{
+    float q[4];
+
+    loadQuaternion(q);
+    return atan2f(2.0f * (q[0] * q[3] + q[1] * q[2]),
+                  1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) * AHRS_RAD_TO_DEG;
+}
+
+CurieAHRSClass CurieAHRS;
@@ -0,0 +1,106 @@
+/*
+ * Orientation filter for the BMI160 on Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CURIEAHRS_H_
+#define _CURIEAHRS_H_
+
+#include "CurieIMU.h"
+
+/**
+ * Filter options
+ *@see CurieAHRSClass::begin()
+ */
+typedef enum {
+    CURIE_AHRS_MADGWICK = 0,    // gradient descent, float
+    CURIE_AHRS_MAHONY,          // PI feedback on the gravity error, float
+    CURIE_AHRS_MAHONY_FIXED,    // as MAHONY, in Q30 integer arithmetic
+} CurieAHRSFilter;
+
+/* Quaternion scale of the fixed point filter: 1.0 == 1 << 30 */
+#define CURIE_AHRS_Q30_ONE      (1L << 30)
+
+/* Accelerometer and gyroscope orientation filter with a fixed time step of
+ * 1 / sampleRate, so it suits data at the gyroscope ODR, e.g. straight from
+ * CurieIMU.readStream(). Orientation is kept as a unit quaternion (w, x, y,
+ * z) rotating the sensor frame into the earth frame; yaw is only relative,
+ * as there is no magnetometer. The ranges are taken from CurieIMU when
+ * begin() is called, so set them first and call begin() again after a
+ * change.
+ */
+class CurieAHRSClass {
+    public:
+        CurieAHRSClass();
+
+        // gain is beta for MADGWICK (default 0.1) and Kp for MAHONY
+        // (default 0.5); ki is the MAHONY integral gain, 0 for none
+        void begin(float sampleRate, CurieAHRSFilter filter = CURIE_AHRS_MADGWICK,
+                   float gain = 0.0f, float ki = 0.0f);
+        // back to level, facing the initial yaw
+        void reset(void);
+
+        // One step: gyroscope in deg/s, accelerometer in g; an all-zero
+        // accelerometer vector (free fall) skips the correction.
+        // MAHONY_FIXED converts both to raw counts first.
+        void update(float gx, float gy, float gz, float ax, float ay, float az);
+        // One step from raw counts, as readMotionSensor()
+        void updateRaw(int gx, int gy, int gz, int ax, int ay, int az);
+        // Runs a step for every GYRO record, with the last ACCEL record
+        // seen; returns the number of steps
+        size_t update(const CurieIMUSample *samples, size_t count);
+
+        void getQuaternion(float &w, float &x, float &y, float &z);
+        // scaled by CURIE_AHRS_Q30_ONE; exact for MAHONY_FIXED
+        void getQuaternionQ30(int32_t &w, int32_t &x, int32_t &y, int32_t &z);
+        // Euler angles in degrees, computed on each call
+        float getRoll(void);
+        float getPitch(void);
+        float getYaw(void);
+
+    private:
+        void stepMadgwick(float gx, float gy, float gz, float ax, float ay, float az);
+        void stepMahony(float gx, float gy, float gz, float ax, float ay, float az);
+        void stepFixed(int32_t gx, int32_t gy, int32_t gz, int32_t ax, int32_t ay, int32_t az);
+        void loadQuaternion(float q[4]);
+
+        CurieAHRSFilter _filter;
+
+        /* float filters */
+        float _q[4];
+        float _dt;
+        float _gain;
+        float _ki_dt;
+        float _ix, _iy, _iz;
+        float _gyro_scale;      // rad/s per raw count
+        float _accel_slope;     // g per raw count
+
+        /* fixed point filter: quaternion Q30, constants Q38 */
+        int32_t _fq[4];
+        int32_t _half_dt_count; // half of the angle per step, per raw count
+        int32_t _kp_half_dt;    // Kp * dt / 2
+        int32_t _ki_half_dt2;   // Ki * dt^2 / 2
+        int64_t _fix, _fiy, _fiz;   // integral term, Q68
+
+        int16_t _last_ax, _last_ay, _last_az;
+};
+
+extern CurieAHRSClass CurieAHRS;
+
+#endif /* _CURIEAHRS_H_ */
@@ -18,13 +18,26 @@
  */
 
 #include "CurieIMU.h"
+#include "RingBuffer.h"
 #include "ss_spi.h"
 #include "interrupt.h"
 
+/* Only in a rebuilt system library; without them transfers are synchronous */
+extern "C" int ss_spi_xfer_async(SPI_CONTROLLER controller_id, uint8_t *buf,
+                                 unsigned tx_cnt, unsigned rx_cnt,
+                                 void (*callback)(uint32_t),
+                                 uint32_t cb_data) __attribute__((weak));
+extern "C" int ss_spi_busy(SPI_CONTROLLER controller_id) __attribute__((weak));
+
 #define CURIE_IMU_CHIP_ID 0xD1
 
+Task CurieIMUClass::_fifo_task(CurieIMUClass::fifoTask, &CurieIMU);
+
 #define BMI160_GPIN_AON_PIN 4
 
+/* 39.0625 us per sensor time count, Q16 */
+#define SENSORTIME_SCALE_Q16 (625UL << 12)
+
 /******************************************************************************/
 
 /** Power on and prepare for general usage.
@@ -33,16 +46,59 @@
  * BMI160 accelerometer and gyroscpoe with default settings.
  */
 
-bool CurieIMUClass::configure_imu(unsigned int sensors)
+/* Bits of _shadow_valid: settings converted once from the registers and
+ * then returned by the getters, until a setter or begin() changes them */
+#define SHADOW_GYRO_RATE            (1 << 0)
+#define SHADOW_ACCEL_RATE           (1 << 1)
+#define SHADOW_FREEFALL_THS         (1 << 2)
+#define SHADOW_SHOCK_THS            (1 << 3)
+#define SHADOW_MOTION_THS           (1 << 4)
+#define SHADOW_ZERO_MOTION_THS      (1 << 5)
+#define SHADOW_TAP_THS              (1 << 6)
+/* scaled by the accelerometer range */
+#define SHADOW_RANGE_THS            (SHADOW_SHOCK_THS | SHADOW_MOTION_THS | \
+                                     SHADOW_ZERO_MOTION_THS | SHADOW_TAP_THS)
+
+/* _wom_state: beginWakeOnMotion() parks the stream while ENTERING, the
+ * interrupt moves ARMED to WOKE, and poll() brings the sensors back up */
+#define WOM_OFF                     0
+#define WOM_ENTERING                1
+#define WOM_ARMED                   2
+#define WOM_WOKE                    3
+#define WOM_ACC_UP                  4
+#define WOM_GYR_UP                  5
+
+/* Between the power mode commands, and between the PMU status checks */
+#define WOM_STEP_US                 1000
+/* Longest single sleep in sleepUntilMotion() */
+#define WOM_IDLE_MS                 100
+
+bool CurieIMUClass::shadowValid(unsigned bit)
+{
+    if (_shadow_accel_range != accel_range_int) {
+        _shadow_valid &= ~SHADOW_RANGE_THS;
+        _shadow_accel_range = accel_range_int;
+    }
+    return _shadow_valid & bit;
+}
+
+void CurieIMUClass::start_spi(void)
 {
     ss_spi_init(SPI_SENSING_1, 2000, SPI_BUSMODE_0, SPI_8_BIT, SPI_SE_1);
 
     /* Perform a dummy read from 0x7f to switch to spi interface */
     uint8_t dummy_reg = 0x7F;
     serial_buffer_transfer(&dummy_reg, 1, 1);
+}
+
+bool CurieIMUClass::configure_imu(unsigned int sensors)
+{
+    start_spi();
 
     /* The SPI interface is ready - now invoke the base class initialization */
     initialize(sensors);
+    _st_synced = false;
+    _shadow_valid = 0;
 
     /** Verify the SPI connection.
      * MakgetGyroRatee sure the device is connected and responds as expected.
@@ -64,6 +120,219 @@ bool CurieIMUClass::begin(unsigned int sensors)
     return configure_imu(sensors);
 }
 
+bool CurieIMUClass::beginAsync(unsigned int sensors)
+{
+    if (_async_pending)
+        return false;
+
+    start_spi();
+
+    /* The ID reads back before the reset, so a missing device fails here
+     * rather than at the end */
+    if (CURIE_IMU_CHIP_ID != getDeviceID())
+        return false;
+
+    _async_pending = initializeAsync(sensors);
+    return _async_pending;
+}
+
+bool CurieIMUClass::autoCalibrateGyroOffsetAsync()
+{
+    _async_pending = BMI160Class::autoCalibrateGyroOffsetAsync();
+    return _async_pending;
+}
+
+bool CurieIMUClass::autoCalibrateAccelerometerOffsetAsync(int axis, int target)
+{
+    unsigned bit;
+
+    switch (axis) {
+        case X_AXIS:
+            bit = BMI160_FOC_ACC_X_BIT;
+            break;
+
+        case Y_AXIS:
+            bit = BMI160_FOC_ACC_Y_BIT;
+            break;
+
+        case Z_AXIS:
+            bit = BMI160_FOC_ACC_Z_BIT;
+            break;
+
+        default:
+            return false;
+    }
+
+    _async_pending = autoCalibrateAccelOffsetAsync(bit, target);
+    return _async_pending;
+}
+
+bool CurieIMUClass::poll()
+{
+    if (_wom_state >= WOM_WOKE && resumeFromMotion())
+        return true;
+    if (BMI160Class::poll())
+        return true;
+
+    if (_async_pending) {
+        /* What the blocking calls do once the device is done */
+        _async_pending = false;
+        switch (getAsyncOperation()) {
+            case BMI160_ASYNC_INIT:
+                _st_synced = false;
+                _shadow_valid = 0;
+                break;
+
+            case BMI160_ASYNC_FOC_GYRO:
+                setGyroOffsetEnabled(true);
+                break;
+
+            case BMI160_ASYNC_FOC_ACCEL:
+                setAccelOffsetEnabled(true);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return false;
+}
+
+bool CurieIMUClass::beginWakeOnMotion(float threshold, float rate)
+{
+    if (_wom_state != WOM_OFF || _async_pending || !isEnabled(ACCEL))
+        return false;
+
+    /* Park the stream; what the FIFO collects meanwhile is flushed */
+    _wom_state = WOM_ENTERING;
+    _wom_stream = _ring != NULL;
+    if (_wom_stream) {
+        setIntFIFOWatermarkEnabled(false);
+        while (_fifo_busy)
+            ;
+    }
+
+    _wom_acc_conf = getRegister(BMI160_RA_ACCEL_CONF);
+    _wom_sensors = sensors_enabled;
+    _wom_motion_int = getIntMotionEnabled();
+
+    /* Configure while still in normal mode, where writes need no spacing */
+    setDetectionThreshold(CURIE_IMU_MOTION, threshold);
+    setAccelerometerRate(rate);
+    setAccelDLPFMode(BMI160_DLPF_MODE_OSR4);    /* 2^0: no averaging */
+    setAccelUndersampling(true);
+    attachInterrupt(_user_callback);
+    enableInterrupt(CURIE_IMU_MOTION, true);
+
+    _wom_state = WOM_ARMED;
+    if (_wom_sensors & GYRO) {
+        setRegister(BMI160_RA_CMD, BMI160_CMD_GYR_MODE_SUSPEND);
+        delay(1);
+    }
+    setRegister(BMI160_RA_CMD, BMI160_CMD_ACC_MODE_LOWPOWER);
+    delay(1);
+    return true;
+}
+
+void CurieIMUClass::endWakeOnMotion(void)
+{
+    if (_wom_state == WOM_OFF)
+        return;
+
+    if (_wom_state == WOM_ARMED)
+        _wom_state = WOM_WOKE;
+    while (resumeFromMotion())
+        delay(1);
+}
+
+bool CurieIMUClass::wakeOnMotionArmed(void)
+{
+    return _wom_state == WOM_ARMED;
+}
+
+bool CurieIMUClass::sleepUntilMotion(uint32_t timeout)
+{
+    uint32_t start = millis();
+
+    while (_wom_state == WOM_ARMED) {
+        uint32_t wait = WOM_IDLE_MS;
+
+        if (timeout) {
+            uint32_t elapsed = (uint32_t)millis() - start;
+            if (elapsed >= timeout)
+                return false;
+            if (timeout - elapsed < wait)
+                wait = timeout - elapsed;
+        }
+        idleFor(wait * 1000);
+    }
+
+    while (poll())
+        delay(1);
+    return true;
+}
+
+/* One step of bringing the sensors back after a wake; true until done */
+bool CurieIMUClass::resumeFromMotion(void)
+{
+    switch (_wom_state) {
+        case WOM_WOKE:
+            setRegister(BMI160_RA_CMD, BMI160_CMD_ACC_MODE_NORMAL);
+            _wom_state = WOM_ACC_UP;
+            _wom_time = micros32();
+            return true;
+
+        case WOM_ACC_UP:
+            if (micros32() - _wom_time < WOM_STEP_US)
+                return true;
+            if (getAccelPowerMode() != BMI160_PMU_NORMAL) {
+                _wom_time = micros32();
+                return true;
+            }
+            if (_wom_sensors & GYRO) {
+                /* the gyroscope takes up to 80ms to start */
+                setRegister(BMI160_RA_CMD, BMI160_CMD_GYR_MODE_NORMAL);
+                _wom_state = WOM_GYR_UP;
+                _wom_time = micros32();
+                return true;
+            }
+            break;
+
+        case WOM_GYR_UP:
+            if (micros32() - _wom_time < WOM_STEP_US)
+                return true;
+            if (getGyroPowerMode() != BMI160_PMU_NORMAL) {
+                _wom_time = micros32();
+                return true;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    /* Both are up again: back to the rate and filter from before */
+    setRegister(BMI160_RA_ACCEL_CONF, _wom_acc_conf);
+    _shadow_valid &= ~SHADOW_ACCEL_RATE;
+    if (!_wom_motion_int)
+        enableInterrupt(CURIE_IMU_MOTION, false);
+    _wom_state = WOM_OFF;
+
+    if (_wom_stream) {
+        /* drop the undersampled data, and start from an empty FIFO */
+        setRegister(BMI160_RA_CMD, BMI160_CMD_FIFO_FLUSH);
+        _fifo_pos = _fifo_len = 0;
+        setInterruptLatch(BMI160_LATCH_MODE_NONE);
+        setIntFIFOWatermarkEnabled(true);
+        serviceFIFO();
+    } else if (!_user_callback) {
+        detachInterrupt();
+    }
+
+    return false;
+}
+
 void CurieIMUClass::end()
 {
     ss_spi_disable(SPI_SENSING_1);
@@ -115,6 +384,9 @@ int CurieIMUClass::getGyroRate()
 {
     int rate;
 
+    if (shadowValid(SHADOW_GYRO_RATE))
+        return _gyro_rate;
+
     switch (BMI160Class::getGyroRate()) {
         case BMI160_GYRO_RATE_25HZ:
             rate = 25;
@@ -150,6 +422,8 @@ int CurieIMUClass::getGyroRate()
             break;
     }
 
+    _gyro_rate = rate;
+    _shadow_valid |= SHADOW_GYRO_RATE;
     return rate;
 }
 
@@ -176,12 +450,16 @@ void CurieIMUClass::setGyroRate(int rate)
     }
 
     BMI160Class::setGyroRate(bmiRate);
+    _shadow_valid &= ~SHADOW_GYRO_RATE;
 }
 
 float CurieIMUClass::getAccelerometerRate()
 {
     float rate;
 
+    if (shadowValid(SHADOW_ACCEL_RATE))
+        return _accel_rate;
+
     switch (BMI160Class::getAccelRate()) {
         case BMI160_ACCEL_RATE_25_2HZ:
             rate = 12.5;
@@ -217,6 +495,8 @@ float CurieIMUClass::getAccelerometerRate()
             break;
     }
 
+    _accel_rate = rate;
+    _shadow_valid |= SHADOW_ACCEL_RATE;
     return rate;
 }
 
@@ -243,12 +523,18 @@ void CurieIMUClass::setAccelerometerRate(float rate)
     }
 
     setAccelRate(bmiRate);
+    _shadow_valid &= ~SHADOW_ACCEL_RATE;
 }
 
 int CurieIMUClass::getGyroRange()
 {
     int range;
 
+    /* kept by setFullScaleGyroRange(), which every range change goes
+     * through, including initialize() */
+    if (gyro_range_int)
+        return gyro_range_int;
+
     switch (getFullScaleGyroRange()) {
         case BMI160_GYRO_RANGE_2000:
             range = 2000;
@@ -304,6 +590,9 @@ int CurieIMUClass::getAccelerometerRange()
 {
     int range;
 
+    if (accel_range_int)
+        return accel_range_int;
+
     switch (getFullScaleAccelRange()) {
         case BMI160_ACCEL_RANGE_2G:
             range = 2;
@@ -495,6 +784,7 @@ float CurieIMUClass::getDetectionThreshold(int feature)
         case CURIE_IMU_DOUBLE_TAP:
         case CURIE_IMU_FIFO_FULL:
         case CURIE_IMU_DATA_READY:
+        case CURIE_IMU_FIFO_WATERMARK:
         default:
             return -1;
     }
@@ -527,6 +817,7 @@ void CurieIMUClass::setDetectionThreshold(int feature, float threshold)
         case CURIE_IMU_DOUBLE_TAP:
         case CURIE_IMU_FIFO_FULL:
         case CURIE_IMU_DATA_READY:
+        case CURIE_IMU_FIFO_WATERMARK:
         default:
             break;
     }
@@ -560,6 +851,7 @@ float CurieIMUClass::getDetectionDuration(int feature)
         case CURIE_IMU_STEP:
         case CURIE_IMU_FIFO_FULL:
         case CURIE_IMU_DATA_READY:
+        case CURIE_IMU_FIFO_WATERMARK:
         default:
             return -1;
     }
@@ -567,9 +859,16 @@ float CurieIMUClass::getDetectionDuration(int feature)
 
 float CurieIMUClass::getFreefallDetectionThreshold()
 {
-    int bmiThreshold = BMI160Class::getFreefallDetectionThreshold();
+    int bmiThreshold;
+
+    if (shadowValid(SHADOW_FREEFALL_THS))
+        return _freefall_ths;
 
-    return (bmiThreshold * 7.81) + 3.91;
+    bmiThreshold = BMI160Class::getFreefallDetectionThreshold();
+
+    _freefall_ths = (bmiThreshold * 7.81) + 3.91;
+    _shadow_valid |= SHADOW_FREEFALL_THS;
+    return _freefall_ths;
 }
 
 void CurieIMUClass::setFreefallDetectionThreshold(float threshold)
@@ -583,14 +882,20 @@ void CurieIMUClass::setFreefallDetectionThreshold(float threshold)
     }
 
     BMI160Class::setFreefallDetectionThreshold(bmiThreshold);
+    _shadow_valid &= ~SHADOW_FREEFALL_THS;
 }
 
 float CurieIMUClass::getShockDetectionThreshold()
 {
-    int bmiThreshold = BMI160Class::getShockDetectionThreshold();
+    int bmiThreshold;
     float step;
     float min;
 
+    if (shadowValid(SHADOW_SHOCK_THS))
+        return _shock_ths;
+
+    bmiThreshold = BMI160Class::getShockDetectionThreshold();
+
     switch (getAccelerometerRange()) {
         case 2:
             step = 7.81;
@@ -614,7 +919,9 @@ float CurieIMUClass::getShockDetectionThreshold()
             break;
     }
 
-    return (bmiThreshold * step) + min;
+    _shock_ths = (bmiThreshold * step) + min;
+    _shadow_valid |= SHADOW_SHOCK_THS;
+    return _shock_ths;
 }
 
 void CurieIMUClass::setShockDetectionThreshold(float threshold)
@@ -647,13 +954,19 @@ void CurieIMUClass::setShockDetectionThreshold(float threshold)
     }
 
     BMI160Class::setShockDetectionThreshold(bmiThreshold);
+    _shadow_valid &= ~SHADOW_SHOCK_THS;
 }
 
 float CurieIMUClass::getMotionDetectionThreshold()
 {
-    int bmiThreshold = BMI160Class::getMotionDetectionThreshold();
+    int bmiThreshold;
     float step;
 
+    if (shadowValid(SHADOW_MOTION_THS))
+        return _motion_ths;
+
+    bmiThreshold = BMI160Class::getMotionDetectionThreshold();
+
     switch (getAccelerometerRange()) {
         case 2:
             step = 3.91;
@@ -673,7 +986,9 @@ float CurieIMUClass::getMotionDetectionThreshold()
             break;
     }
 
-    return (bmiThreshold * step);
+    _motion_ths = (bmiThreshold * step);
+    _shadow_valid |= SHADOW_MOTION_THS;
+    return _motion_ths;
 }
 
 void CurieIMUClass::setMotionDetectionThreshold(float threshold)
@@ -706,13 +1021,19 @@ void CurieIMUClass::setMotionDetectionThreshold(float threshold)
     }
 
     BMI160Class::setMotionDetectionThreshold(bmiThreshold);
+    _shadow_valid &= ~SHADOW_MOTION_THS;
 }
 
 float CurieIMUClass::getZeroMotionDetectionThreshold()
 {
-    int bmiThreshold = BMI160Class::getZeroMotionDetectionThreshold();
+    int bmiThreshold;
     float step;
 
+    if (shadowValid(SHADOW_ZERO_MOTION_THS))
+        return _zero_motion_ths;
+
+    bmiThreshold = BMI160Class::getZeroMotionDetectionThreshold();
+
     switch (getAccelerometerRange()) {
         case 2:
             step = 3.91;
@@ -732,7 +1053,9 @@ float CurieIMUClass::getZeroMotionDetectionThreshold()
             break;
     }
 
-    return (bmiThreshold * step);
+    _zero_motion_ths = (bmiThreshold * step);
+    _shadow_valid |= SHADOW_ZERO_MOTION_THS;
+    return _zero_motion_ths;
 }
 
 void CurieIMUClass::setZeroMotionDetectionThreshold(float threshold)
@@ -765,14 +1088,20 @@ void CurieIMUClass::setZeroMotionDetectionThreshold(float threshold)
     }
 
     BMI160Class::setZeroMotionDetectionThreshold(bmiThreshold);
+    _shadow_valid &= ~SHADOW_ZERO_MOTION_THS;
 }
 
 float CurieIMUClass::getTapDetectionThreshold()
 {
-    int bmiThreshold = BMI160Class::getTapDetectionThreshold();
+    int bmiThreshold;
     float step;
     float min;
 
+    if (shadowValid(SHADOW_TAP_THS))
+        return _tap_ths;
+
+    bmiThreshold = BMI160Class::getTapDetectionThreshold();
+
     switch (getAccelerometerRange()) {
         case 2:
             step = 62.5;
@@ -796,7 +1125,9 @@ float CurieIMUClass::getTapDetectionThreshold()
             break;
     }
 
-    return (bmiThreshold * step) + min;
+    _tap_ths = (bmiThreshold * step) + min;
+    _shadow_valid |= SHADOW_TAP_THS;
+    return _tap_ths;
 }
 
 void CurieIMUClass::setTapDetectionThreshold(float threshold)
@@ -829,6 +1160,7 @@ void CurieIMUClass::setTapDetectionThreshold(float threshold)
     }
 
     BMI160Class::setTapDetectionThreshold(bmiThreshold);
+    _shadow_valid &= ~SHADOW_TAP_THS;
 }
 
 void CurieIMUClass::setDetectionDuration(int feature, float value)
@@ -866,6 +1198,7 @@ void CurieIMUClass::setDetectionDuration(int feature, float value)
         case CURIE_IMU_STEP:
         case CURIE_IMU_FIFO_FULL:
         case CURIE_IMU_DATA_READY:
+        case CURIE_IMU_FIFO_WATERMARK:
         default:
             break;
     }
@@ -1519,6 +1852,10 @@ void CurieIMUClass::enableInterrupt(int feature, bool enabled)
             setIntDataReadyEnabled(enabled);
             break;
 
+        case CURIE_IMU_FIFO_WATERMARK:
+            setIntFIFOWatermarkEnabled(enabled);
+            break;
+
         default:
             break;
     }
@@ -1554,46 +1891,99 @@ bool CurieIMUClass::interruptsEnabled(int feature)
         case CURIE_IMU_DATA_READY:
             return getIntDataReadyEnabled();
 
+        case CURIE_IMU_FIFO_WATERMARK:
+            return getIntFIFOWatermarkEnabled();
+
         default:
             return false;
     }
 }
 
 bool CurieIMUClass::getInterruptStatus(int feature)
+{
+    return readInterruptStatus().feature(feature);
+}
+
+CurieIMUInterruptStatus CurieIMUClass::readInterruptStatus()
+{
+    CurieIMUInterruptStatus status;
+    uint8_t buffer[4];
+
+    buffer[0] = BMI160_RA_INT_STATUS_0;
+    serial_buffer_transfer(buffer, 1, 4);
+    memcpy(status.reg, buffer, sizeof(status.reg));
+    return status;
+}
+
+bool CurieIMUInterruptStatus::feature(int feature) const
 {
     switch (feature) {
         case CURIE_IMU_FREEFALL:
-            return getIntFreefallStatus();
+            return reg[1] & (1 << BMI160_LOW_G_INT_BIT);
 
         case CURIE_IMU_SHOCK:
-            return getIntShockStatus();
+            return reg[1] & (1 << BMI160_HIGH_G_INT_BIT);
 
         case CURIE_IMU_STEP:
-            return getIntStepStatus();
+            return reg[0] & (1 << BMI160_STEP_INT_BIT);
 
         case CURIE_IMU_MOTION:
-            return getIntMotionStatus();
+            return reg[0] & (1 << BMI160_ANYMOTION_INT_BIT);
 
         case CURIE_IMU_ZERO_MOTION:
-            return getIntZeroMotionStatus();
+            return reg[1] & (1 << BMI160_NOMOTION_INT_BIT);
 
         case CURIE_IMU_TAP:
-            return getIntTapStatus();
+            return reg[0] & (1 << BMI160_S_TAP_INT_BIT);
 
         case CURIE_IMU_DOUBLE_TAP:
-            return getIntDoubleTapStatus();
+            return reg[0] & (1 << BMI160_D_TAP_INT_BIT);
 
         case CURIE_IMU_FIFO_FULL:
-            return getIntFIFOBufferFullStatus();
+            return reg[1] & (1 << BMI160_FFULL_INT_BIT);
 
         case CURIE_IMU_DATA_READY:
-            return getIntDataReadyStatus();
+            return reg[1] & (1 << BMI160_DRDY_INT_BIT);
+
+        case CURIE_IMU_FIFO_WATERMARK:
+            return reg[1] & (1 << BMI160_FWM_INT_BIT);
 
         default:
             return false;
     }
 }
 
+/* The first axis to trigger and the sign of its motion, as INT_STATUS_2
+ * reports them for tap and any-motion and INT_STATUS_3 for high-g */
+static bool axisDetected(uint8_t status, int firstXBit, int signBit, int axis, int direction)
+{
+    if (axis < X_AXIS || axis > Z_AXIS ||
+        (direction != POSITIVE && direction != NEGATIVE))
+        return false;
+
+    bool negative = status & (1 << signBit);
+    return (status & (1 << (firstXBit + axis))) &&
+           negative == (direction == NEGATIVE);
+}
+
+bool CurieIMUInterruptStatus::shock(int axis, int direction) const
+{
+    return axisDetected(reg[3], BMI160_HIGH_G_1ST_X_BIT, BMI160_HIGH_G_SIGN_BIT,
+                        axis, direction);
+}
+
+bool CurieIMUInterruptStatus::motion(int axis, int direction) const
+{
+    return axisDetected(reg[2], BMI160_ANYMOTION_1ST_X_BIT, BMI160_ANYMOTION_SIGN_BIT,
+                        axis, direction);
+}
+
+bool CurieIMUInterruptStatus::tap(int axis, int direction) const
+{
+    return axisDetected(reg[2], BMI160_TAP_1ST_X_BIT, BMI160_TAP_SIGN_BIT,
+                        axis, direction);
+}
+
 CurieIMUStepMode CurieIMUClass::getStepDetectionMode()
 {
     return (CurieIMUStepMode)BMI160Class::getStepDetectionMode();
@@ -1604,16 +1994,20 @@ void CurieIMUClass::setStepDetectionMode(int mode)
     BMI160Class::setStepDetectionMode((BMI160StepMode)mode);
 }
 
-float CurieIMUClass::convertRaw(int16_t raw, float range_abs)
+float CurieIMUClass::convertRaw(int16_t raw, float slope)
 {
-    float slope;
-    float val;
-
     /* Input range will be -32768 to 32767
-     * Output range must be -range_abs to range_abs */
-    val = (float)raw;
-    slope = (range_abs * 2.0f) / BMI160_SENSOR_RANGE;
-    return -(range_abs) + slope * (val + BMI160_SENSOR_LOW);
+     * Output range must be -range_abs to range_abs:
+     * -range_abs + slope * (raw + 32768) == slope * (raw + 0.5) */
+    return slope * ((float)raw + 0.5f);
+}
+
+int32_t CurieIMUClass::convertRawQ16(int16_t raw, int32_t range_abs)
+{
+    /* range_abs * (2 * raw + 1) / 65535, times 65536; 1/65535 is taken as
+     * 1/65536 + 1/2^32, which is off by less than one Q16 LSB */
+    int32_t t = (2 * (int32_t)raw + 1) * range_abs;
+    return t + (t >> 16);
 }
 
 void CurieIMUClass::readMotionSensor(int &ax, int &ay, int &az, int &gx,
@@ -1631,6 +2025,51 @@ void CurieIMUClass::readMotionSensor(int &ax, int &ay, int &az, int &gx,
     gz = sgz;
 }
 
+void CurieIMUClass::readMotionSensor(int &ax, int &ay, int &az, int &gx,
+                                     int &gy, int &gz, uint32_t &time)
+{
+    short sax, say, saz, sgx, sgy, sgz;
+
+    getMotion6(&sax, &say, &saz, &sgx, &sgy, &sgz, &time);
+
+    ax = sax;
+    ay = say;
+    az = saz;
+    gx = sgx;
+    gy = sgy;
+    gz = sgz;
+}
+
+void CurieIMUClass::readMotionSensor(int &ax, int &ay, int &az, int &gx,
+                                     int &gy, int &gz, int &mx, int &my, int &mz)
+{
+    int16_t sax, say, saz, sgx, sgy, sgz, smx, smy, smz;
+
+    getMotion9(&sax, &say, &saz, &sgx, &sgy, &sgz, &smx, &smy, &smz);
+
+    ax = sax;
+    ay = say;
+    az = saz;
+    gx = sgx;
+    gy = sgy;
+    gz = sgz;
+    mx = smx;
+    my = smy;
+    mz = smz;
+}
+
+void CurieIMUClass::readMagnetometer(int &x, int &y, int &z)
+{
+    int16_t sx, sy, sz;
+    uint16_t rhall;
+
+    getMagnetometer(&sx, &sy, &sz, &rhall);
+
+    x = sx;
+    y = sy;
+    z = sz;
+}
+
 void CurieIMUClass::readMotionSensorScaled(float &ax, float &ay, float &az,
                                            float &gx, float &gy, float &gz)
 {
@@ -1638,12 +2077,72 @@ void CurieIMUClass::readMotionSensorScaled(float &ax, float &ay, float &az,
 
     getMotion6(&sax, &say, &saz, &sgx, &sgy, &sgz);
 
-    ax = convertRaw(sax, accel_range);
-    ay = convertRaw(say, accel_range);
-    az = convertRaw(saz, accel_range);
-    gx = convertRaw(sgx, gyro_range);
-    gy = convertRaw(sgy, gyro_range);
-    gz = convertRaw(sgz, gyro_range);
+    ax = convertRaw(sax, accel_slope);
+    ay = convertRaw(say, accel_slope);
+    az = convertRaw(saz, accel_slope);
+    gx = convertRaw(sgx, gyro_slope);
+    gy = convertRaw(sgy, gyro_slope);
+    gz = convertRaw(sgz, gyro_slope);
+}
+
+void CurieIMUClass::readMotionSensorQ16(int32_t &ax, int32_t &ay, int32_t &az,
+                                        int32_t &gx, int32_t &gy, int32_t &gz)
+{
+    int16_t sax, say, saz, sgx, sgy, sgz;
+
+    getMotion6(&sax, &say, &saz, &sgx, &sgy, &sgz);
+
+    ax = convertRawQ16(sax, accel_range_int);
+    ay = convertRawQ16(say, accel_range_int);
+    az = convertRawQ16(saz, accel_range_int);
+    gx = convertRawQ16(sgx, gyro_range_int);
+    gy = convertRawQ16(sgy, gyro_range_int);
+    gz = convertRawQ16(sgz, gyro_range_int);
+}
+
+void CurieIMUClass::convertSamples(const CurieIMUSample *in, float *out, size_t count)
+{
+    /* Hoisted out of the loop, as the range can't change in between */
+    float aslope = accel_slope;
+    float gslope = gyro_slope;
+
+    for (size_t i = 0; i < count; i++, out += 3) {
+        float slope;
+
+        if (in[i].type == CURIE_IMU_SAMPLE_ACCEL) {
+            slope = aslope;
+        } else if (in[i].type == CURIE_IMU_SAMPLE_GYRO) {
+            slope = gslope;
+        } else {
+            out[0] = out[1] = out[2] = 0.0f;
+            continue;
+        }
+        out[0] = convertRaw(in[i].x, slope);
+        out[1] = convertRaw(in[i].y, slope);
+        out[2] = convertRaw(in[i].z, slope);
+    }
+}
+
+void CurieIMUClass::convertSamples(const CurieIMUSample *in, int32_t *out, size_t count)
+{
+    int32_t arange = accel_range_int;
+    int32_t grange = gyro_range_int;
+
+    for (size_t i = 0; i < count; i++, out += 3) {
+        int32_t range;
+
+        if (in[i].type == CURIE_IMU_SAMPLE_ACCEL) {
+            range = arange;
+        } else if (in[i].type == CURIE_IMU_SAMPLE_GYRO) {
+            range = grange;
+        } else {
+            out[0] = out[1] = out[2] = 0;
+            continue;
+        }
+        out[0] = convertRawQ16(in[i].x, range);
+        out[1] = convertRawQ16(in[i].y, range);
+        out[2] = convertRawQ16(in[i].z, range);
+    }
 }
 
 void CurieIMUClass::readAccelerometer(int &x, int &y, int &z)
@@ -1663,9 +2162,9 @@ void CurieIMUClass::readAccelerometerScaled(float &x, float &y, float &z)
 
     getAcceleration(&sx, &sy, &sz);
 
-    x = convertRaw(sx, accel_range);
-    y = convertRaw(sy, accel_range);
-    z = convertRaw(sz, accel_range);
+    x = convertRaw(sx, accel_slope);
+    y = convertRaw(sy, accel_slope);
+    z = convertRaw(sz, accel_slope);
 }
 
 void CurieIMUClass::readGyro(int &x, int &y, int &z)
@@ -1685,9 +2184,9 @@ void CurieIMUClass::readGyroScaled(float &x, float &y, float &z)
 
     getRotation(&sx, &sy, &sz);
 
-    x = convertRaw(sx, gyro_range);
-    y = convertRaw(sy, gyro_range);
-    z = convertRaw(sz, gyro_range);
+    x = convertRaw(sx, gyro_slope);
+    y = convertRaw(sy, gyro_slope);
+    z = convertRaw(sz, gyro_slope);
 }
 
 int CurieIMUClass::readAccelerometer(int axis)
@@ -1717,7 +2216,7 @@ float CurieIMUClass::readAccelerometerScaled(int axis)
         return 0;
     }
 
-    return convertRaw(raw, accel_range);
+    return convertRaw(raw, accel_slope);
 }
 
 int CurieIMUClass::readGyro(int axis)
@@ -1747,7 +2246,7 @@ float CurieIMUClass::readGyroScaled(int axis)
         return 0;
     }
 
-    return convertRaw(raw, gyro_range);
+    return convertRaw(raw, gyro_slope);
 }
 
 int CurieIMUClass::readTemperature()
@@ -1757,71 +2256,17 @@ int CurieIMUClass::readTemperature()
 
 bool CurieIMUClass::shockDetected(int axis, int direction)
 {
-    if (direction == POSITIVE) {
-        if (axis == X_AXIS) {
-            return getXPosShockDetected();
-        } else if (axis == Y_AXIS) {
-            return getYPosShockDetected();
-        } else if (axis == Z_AXIS) {
-            return getZPosShockDetected();
-        }
-    } else if (direction == NEGATIVE) {
-        if (axis == X_AXIS) {
-            return getXNegShockDetected();
-        } else if (axis == Y_AXIS) {
-            return getYNegShockDetected();
-        } else if (axis == Z_AXIS) {
-            return getZNegShockDetected();
-        }
-    }
-
-    return false;
+    return readInterruptStatus().shock(axis, direction);
 }
 
 bool CurieIMUClass::motionDetected(int axis, int direction)
 {
-    if (direction == POSITIVE) {
-        if (axis == X_AXIS) {
-            return getXPosMotionDetected();
-        } else if (axis == Y_AXIS) {
-            return getYPosMotionDetected();
-        } else if (axis == Z_AXIS) {
-            return getZPosMotionDetected();
-        }
-    } else if (direction == NEGATIVE) {
-        if (axis == X_AXIS) {
-            return getXNegMotionDetected();
-        } else if (axis == Y_AXIS) {
-            return getYNegMotionDetected();
-        } else if (axis == Z_AXIS) {
-            return getZNegMotionDetected();
-        }
-    }
-
-    return false;
+    return readInterruptStatus().motion(axis, direction);
 }
 
 bool CurieIMUClass::tapDetected(int axis, int direction)
 {
-    if (direction == POSITIVE) {
-        if (axis == X_AXIS) {
-            return getXPosTapDetected();
-        } else if (axis == Y_AXIS) {
-            return getYPosTapDetected();
-        } else if (axis == Z_AXIS) {
-            return getZPosTapDetected();
-        }
-    } else if (direction == NEGATIVE) {
-        if (axis == X_AXIS) {
-            return getXNegTapDetected();
-        } else if (axis == Y_AXIS) {
-            return getYNegTapDetected();
-        } else if (axis == Z_AXIS) {
-            return getZNegTapDetected();
-        }
-    }
-
-    return false;
+    return readInterruptStatus().tap(axis, direction);
 }
 
 bool CurieIMUClass::stepsDetected()
@@ -1829,6 +2274,50 @@ bool CurieIMUClass::stepsDetected()
     return getIntStepStatus();
 }
 
+uint32_t CurieIMUClass::readSensorTime()
+{
+    return getSensorTime();
+}
+
+void CurieIMUClass::syncSensorTime()
+{
+    uint64_t before, now;
+    uint32_t time;
+
+    /* The SPI read takes ~16us; take its midpoint */
+    before = micros();
+    time = getSensorTime();
+    now = micros();
+    now = before + (now - before) / 2;
+
+    if (!_st_synced) {
+        _st_scale = SENSORTIME_SCALE_Q16;
+    } else if (now - _st_ref_us >= 1000000) {
+        uint64_t elapsed = now - _st_ref_us;
+        uint64_t ticks = (time - _st_ref) & BMI160_SENSORTIME_MASK;
+        uint64_t expect = (elapsed << 16) / SENSORTIME_SCALE_Q16;
+
+        /* Whole wraps of the counter since the last sync, from micros() */
+        ticks += (expect - ticks + (1 << 23)) & ~(uint64_t)BMI160_SENSORTIME_MASK;
+        _st_scale = (elapsed << 16) / ticks;
+    }
+    _st_ref = time;
+    _st_ref_us = now;
+    _st_synced = true;
+}
+
+uint64_t CurieIMUClass::sensorTimeToMicros(uint32_t time)
+{
+    int32_t delta;
+
+    if (!_st_synced)
+        syncSensorTime();
+
+    /* Signed 24-bit difference, so earlier samples map back in time */
+    delta = (int32_t)((time - _st_ref) << 8) >> 8;
+    return _st_ref_us + (((int64_t)delta * _st_scale) >> 16);
+}
+
 /** Provides a serial buffer transfer implementation for the BMI160 base class
  *  to use for accessing device registers.  This implementation uses the SPI
  *  bus on the Intel Curie module to communicate with the BMI160.
@@ -1836,25 +2325,406 @@ bool CurieIMUClass::stepsDetected()
 int CurieIMUClass::serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt,
                                           unsigned rx_cnt)
 {
+    int ret;
+
     if (rx_cnt) /* For read transfers, assume 1st byte contains register address */
         buf[0] |= (1 << BMI160_SPI_READ_BIT);
 
-    return ss_spi_xfer(SPI_SENSING_1, buf, tx_cnt, rx_cnt);
+    _spi_active++;
+    ret = ss_spi_xfer(SPI_SENSING_1, buf, tx_cnt, rx_cnt);
+    _spi_active--;
+    return ret;
+}
+
+static void imu_read_done(uint32_t data)
+{
+    void (*callback)(void) = (void (*)(void))data;
+
+    if (callback)
+        callback();
+}
+
+/* A burst read of rx_cnt bytes into buf, calling callback(cb_data) when it
+ * completes: from the SPI interrupt, or before returning if the system
+ * library can only do synchronous transfers */
+static int imu_xfer_async(uint8_t *buf, unsigned rx_cnt,
+                          void (*callback)(uint32_t), uint32_t cb_data)
+{
+    int ret;
+
+    if (ss_spi_xfer_async)
+        return ss_spi_xfer_async(SPI_SENSING_1, buf, 1, rx_cnt, callback,
+                                 cb_data);
+
+    ret = ss_spi_xfer(SPI_SENSING_1, buf, 1, rx_cnt);
+    if (ret == 0)
+        callback(cb_data);
+    return ret;
+}
+
+static bool imu_xfer_busy(void)
+{
+    return ss_spi_busy && ss_spi_busy(SPI_SENSING_1);
+}
+
+/** Starts a burst read over the SPI interrupts, so that loop() isn't held
+ *  up for the length of the transfer.  Other register accesses wait for it
+ *  to complete.
+ */
+bool CurieIMUClass::readRegistersAsync(uint8_t reg, uint8_t *data,
+                                       unsigned length,
+                                       void (*callback)(void))
+{
+    if (length == 0)
+        return false;
+
+    data[0] = reg | (1 << BMI160_SPI_READ_BIT);
+    return imu_xfer_async(data, length, imu_read_done,
+                          (uint32_t)callback) == 0;
+}
+
+bool CurieIMUClass::readRegistersBusy()
+{
+    return imu_xfer_busy();
+}
+
+/** Configures the FIFO for the given sensors and flushes it.  Header mode
+ *  tags each frame, so the sensors can run at different rates, and appends
+ *  the sensor time when the FIFO is read to the end.
+ */
+bool CurieIMUClass::beginFIFO(unsigned int sensors, unsigned int watermark,
+                              bool headers)
+{
+    uint8_t config = 0;
+
+    sensors &= sensors_enabled;
+    if (!sensors)
+        return false;
+
+    if (!_fifo_buf) {
+        _fifo_buf = (uint8_t *)malloc(BMI160_FIFO_SIZE + BMI160_FIFO_TIME_LEN);
+        if (!_fifo_buf)
+            return false;
+    }
+    _fifo_pos = _fifo_len = 0;
+    _fifo_sensors = sensors;
+    _fifo_headers = headers;
+
+    if (sensors & GYRO)
+        config |= 1 << BMI160_FIFO_GYR_EN_BIT;
+    if (sensors & ACCEL)
+        config |= 1 << BMI160_FIFO_ACC_EN_BIT;
+    if (sensors & MAG)
+        config |= 1 << BMI160_FIFO_MAG_EN_BIT;
+    if (headers)
+        config |= (1 << BMI160_FIFO_HEADER_EN_BIT) | (1 << BMI160_FIFO_TIME_EN_BIT);
+
+    setFIFOWatermark(watermark);
+    setRegister(BMI160_RA_FIFO_CONFIG_1, config);
+    resetFIFO();
+    return true;
+}
+
+void CurieIMUClass::endFIFO(void)
+{
+    setRegister(BMI160_RA_FIFO_CONFIG_1, 0);
+    resetFIFO();
+    free(_fifo_buf);
+    _fifo_buf = NULL;
+    _fifo_pos = _fifo_len = 0;
+}
+
+static void fifo_axes(CurieIMUSample *out, uint8_t type, const uint8_t *data)
+{
+    out->type = type;
+    out->x = (int16_t)((data[1] << 8) | data[0]);
+    out->y = (int16_t)((data[3] << 8) | data[2]);
+    out->z = (int16_t)((data[5] << 8) | data[4]);
+    out->time = 0;
+}
+
+/** Converts the frames between _fifo_pos and _fifo_len, stopping at the
+ *  first one that doesn't fit in out.  Frames are stored magnetometer,
+ *  gyroscope, accelerometer.
+ */
+size_t CurieIMUClass::parseFIFO(CurieIMUSample *out, size_t max)
+{
+    const uint8_t *buf = _fifo_buf;
+    size_t n = 0;
+
+    while (_fifo_pos < _fifo_len) {
+        unsigned pos = _fifo_pos;
+        unsigned left = _fifo_len - pos;
+        unsigned head, len, samples;
+        bool mag, gyr, acc;
+
+        if (_fifo_headers) {
+            head = buf[pos++];
+            left--;
+            if ((head & 0xC0) == BMI160_FIFO_HEAD_DATA &&
+                head != BMI160_FIFO_DATA_INVALID) {
+                mag = head & BMI160_FIFO_HEAD_MAG;
+                gyr = head & BMI160_FIFO_HEAD_GYR;
+                acc = head & BMI160_FIFO_HEAD_ACC;
+            } else if (head == BMI160_FIFO_HEAD_SKIP ||
+                       head == BMI160_FIFO_HEAD_TIME ||
+                       head == BMI160_FIFO_HEAD_CONFIG) {
+                len = head == BMI160_FIFO_HEAD_TIME ? 3 : 1;
+                if (len > left)
+                    break;
+                if (head != BMI160_FIFO_HEAD_CONFIG) {
+                    if (n == max)
+                        return n;
+                    out[n].type = head == BMI160_FIFO_HEAD_TIME ?
+                        CURIE_IMU_SAMPLE_TIME : CURIE_IMU_SAMPLE_SKIP;
+                    out[n].x = out[n].y = out[n].z = 0;
+                    out[n].time = buf[pos];
+                    if (head == BMI160_FIFO_HEAD_TIME)
+                        out[n].time |= (buf[pos + 1] << 8) |
+                                       ((uint32_t)buf[pos + 2] << 16);
+                    n++;
+                }
+                _fifo_pos = pos + len;
+                continue;
+            } else {
+                /* 0x80 past the end of the data, or garbage */
+                break;
+            }
+        } else {
+            mag = _fifo_sensors & MAG;
+            gyr = _fifo_sensors & GYRO;
+            acc = _fifo_sensors & ACCEL;
+        }
+
+        len = (mag ? BMI160_MAG_DATA_LEN : 0) + (gyr ? 6 : 0) + (acc ? 6 : 0);
+        samples = mag + gyr + acc;
+        if (len > left)
+            break;
+        if (n + samples > max)
+            return n;
+        if (mag) {
+            fifo_axes(&out[n], CURIE_IMU_SAMPLE_MAG, &buf[pos]);
+            out[n++].time = (buf[pos + 7] << 8) | buf[pos + 6];
+            pos += BMI160_MAG_DATA_LEN;
+        }
+        if (gyr) {
+            fifo_axes(&out[n++], CURIE_IMU_SAMPLE_GYRO, &buf[pos]);
+            pos += 6;
+        }
+        if (acc) {
+            fifo_axes(&out[n++], CURIE_IMU_SAMPLE_ACCEL, &buf[pos]);
+            pos += 6;
+        }
+        _fifo_pos = pos;
+    }
+
+    /* Whatever is left is a part frame, which the device sends again */
+    _fifo_pos = _fifo_len = 0;
+    return n;
+}
+
+size_t CurieIMUClass::readFIFO(CurieIMUSample *out, size_t max)
+{
+    size_t n;
+    unsigned count;
+
+    if (!_fifo_buf || _ring || max == 0)
+        return 0;
+
+    /* Records left over from the last burst go first */
+    n = parseFIFO(out, max);
+    if (n == max || _fifo_len)
+        return n;
+
+    count = getFIFOCount() & BMI160_FIFO_LENGTH_MASK;
+    if (count == 0)
+        return n;
+    if (count > BMI160_FIFO_SIZE)
+        count = BMI160_FIFO_SIZE;
+    /* Reading past the data returns the sensor time frame */
+    if (_fifo_headers)
+        count += BMI160_FIFO_TIME_LEN;
+
+    getFIFOBytes(_fifo_buf, count);
+    _fifo_pos = 0;
+    _fifo_len = count;
+    return n + parseFIFO(out + n, max - n);
+}
+
+/** Starts a burst read of the FIFO if it is at the watermark.  Runs in
+ *  thread context, as reading the count waits on the SPI bus; if the bus
+ *  is in use, fifoTask() tries again.
+ */
+void CurieIMUClass::serviceFIFO(void)
+{
+    unsigned count;
+
+    if (!_ring || _fifo_busy || _wom_state != WOM_OFF)
+        return;
+    if (_spi_active || imu_xfer_busy()) {
+        _fifo_pending = true;
+        return;
+    }
+    _fifo_pending = false;
+
+    count = getFIFOCount() & BMI160_FIFO_LENGTH_MASK;
+    if (count < _fifo_watermark)
+        return;
+    if (count > BMI160_FIFO_SIZE)
+        count = BMI160_FIFO_SIZE;
+    if (_fifo_headers)
+        count += BMI160_FIFO_TIME_LEN;
+
+    _fifo_buf[0] = BMI160_RA_FIFO_DATA | (1 << BMI160_SPI_READ_BIT);
+    _fifo_pos = 0;
+    _fifo_len = count;
+    _fifo_busy = true;
+    if (imu_xfer_async(_fifo_buf, count, fifoBurstDone,
+                       (uint32_t)this) != 0) {
+        _fifo_busy = false;
+        _fifo_len = 0;
+        _fifo_pending = true;
+    }
+}
+
+/** SPI interrupt: moves the burst into the ring, then has fifoTask() look
+ *  again in case the FIFO refilled past the watermark meanwhile, as that
+ *  makes no new edge.
+ */
+void CurieIMUClass::fifoBurstDone(uint32_t self)
+{
+    CurieIMUClass *imu = (CurieIMUClass *)self;
+    CurieIMUSample batch[8];
+    size_t n, i, head, next;
+
+    do {
+        n = imu->parseFIFO(batch, 8);
+        for (i = 0; i < n; i++) {
+            head = imu->_ring_head;
+            next = head + 1 == imu->_ring_size ? 0 : head + 1;
+            if (next == imu->_ring_tail) {
+                imu->_ring_overruns++;
+                continue;
+            }
+            imu->_ring[head] = batch[i];
+            RING_BUFFER_BARRIER();
+            imu->_ring_head = next;
+        }
+    } while (imu->_fifo_len);
+
+    imu->_fifo_busy = false;
+    imu->_fifo_pending = true;
+}
+
+/** Every millisecond from yield() and the main loop while streaming:
+ *  services the watermark interrupts and bursts latched since the last run.
+ */
+void CurieIMUClass::fifoTask(void *arg)
+{
+    CurieIMUClass *imu = (CurieIMUClass *)arg;
+
+    if (imu->_fifo_pending)
+        imu->serviceFIFO();
+}
+
+bool CurieIMUClass::beginFIFOStream(CurieIMUSample *ring, size_t size)
+{
+    if (!_fifo_buf || !ring || size < 2)
+        return false;
+    _fifo_watermark = getFIFOWatermark();
+    if (_fifo_watermark == 0)
+        return false;
+
+    _ring_size = size;
+    _ring_head = _ring_tail = 0;
+    _ring_overruns = 0;
+    _fifo_pos = _fifo_len = 0;
+    _ring = ring;
+
+    attachInterrupt(_user_callback);
+    setInterruptLatch(BMI160_LATCH_MODE_NONE);
+    setIntFIFOWatermarkEnabled(true);
+
+    /* It may be past the watermark already, with no edge to come */
+    serviceFIFO();
+    _fifo_task.start(1, 1);
+    return true;
+}
+
+void CurieIMUClass::endFIFOStream(void)
+{
+    uint32_t saved;
+
+    if (!_ring)
+        return;
+    setIntFIFOWatermarkEnabled(false);
+    _fifo_task.stop();
+    while (_fifo_busy)
+        ;
+
+    saved = interrupt_lock();
+    _ring = NULL;
+    _fifo_pending = false;
+    interrupt_unlock(saved);
+    _fifo_pos = _fifo_len = 0;
+
+    if (!_user_callback)
+        detachInterrupt();
+}
+
+size_t CurieIMUClass::streamAvailable(void)
+{
+    size_t head = _ring_head;
+    size_t tail = _ring_tail;
+
+    return head >= tail ? head - tail : head + _ring_size - tail;
+}
+
+size_t CurieIMUClass::readStream(CurieIMUSample *out, size_t max)
+{
+    size_t tail = _ring_tail;
+    size_t n = 0;
+
+    if (!_ring)
+        return 0;
+    while (n < max && tail != _ring_head) {
+        out[n++] = _ring[tail];
+        tail = tail + 1 == _ring_size ? 0 : tail + 1;
+    }
+    RING_BUFFER_BARRIER();
+    _ring_tail = tail;
+    return n;
+}
+
+uint32_t CurieIMUClass::streamOverruns(void)
+{
+    return _ring_overruns;
 }
 
 /** Interrupt handler for interrupts from PIN1 on the BMI160
- *  Calls a user callback if available.  The user callback is
+ *  Ends a wake-on-motion sleep, or starts draining the FIFO while
+ *  streaming, then calls a user callback
+ *  if available.  The user callback is
  *  responsible for checking the source of the interrupt using
  *  the relevant API functions from the BMI160Class base class.
  */
 void bmi160_pin1_isr(void)
 {
     soc_gpio_mask_interrupt(SOC_GPIO_AON, BMI160_GPIN_AON_PIN);
+    if (CurieIMU._wom_state == WOM_ARMED)
+        CurieIMU._wom_state = WOM_WOKE;     /* poll() takes it from here */
+    else if (CurieIMU._ring)
+        CurieIMU._fifo_pending = true;      /* and fifoTask() from here */
     if (CurieIMU._user_callback)
         CurieIMU._user_callback();
     soc_gpio_unmask_interrupt(SOC_GPIO_AON, BMI160_GPIN_AON_PIN);
 }
 
+bool CurieIMUClass::setInterruptPriority(uint32_t priority)
+{
+    return ::setInterruptPriority(SOC_GPIO_AON_INTERRUPT, priority);
+}
+
 /** Stores a user callback, and enables PIN1 interrupts from the
  *  BMI160 module.
  */
@@ -23,6 +23,7 @@
 #define _CURIEIMU_H_
 
 #include "BMI160.h"
+#include "Task.h"
 
 /**
  * axis options
@@ -67,6 +68,7 @@ typedef enum {
     CURIE_IMU_DOUBLE_TAP,
     CURIE_IMU_FIFO_FULL,
     CURIE_IMU_DATA_READY,
+    CURIE_IMU_FIFO_WATERMARK,
 } CurieIMUFeature;
 
 /**
@@ -80,6 +82,38 @@ typedef enum {
     CURIE_IMU_STEP_MODE_UNKNOWN = BMI160_STEP_MODE_UNKNOWN
 } CurieIMUStepMode;
 
+/**
+ * Record types returned by readFIFO()
+ */
+typedef enum {
+    CURIE_IMU_SAMPLE_ACCEL = 0,
+    CURIE_IMU_SAMPLE_GYRO,
+    CURIE_IMU_SAMPLE_TIME,      // sensor time at the end of the data read
+    CURIE_IMU_SAMPLE_SKIP,      // frames lost to a FIFO overflow
+    CURIE_IMU_SAMPLE_MAG,       // magnetometer, from MAG_IF
+} CurieIMUSampleType;
+
+typedef struct {
+    uint8_t type;               // CurieIMUSampleType
+    int16_t x, y, z;            // ACCEL, GYRO, MAG: raw values, as readMotionSensor()
+    uint32_t time;              // TIME: 24 bits, 39.0625 us a count; SKIP: frames;
+                                // MAG: the fourth data word (BMM150 RHALL)
+} CurieIMUSample;
+
+/**
+ * INT_STATUS_0..3 from one SPI burst, @see readInterruptStatus(). Answers
+ * the getInterruptStatus() and *Detected() queries without another read.
+ */
+typedef struct CurieIMUInterruptStatus {
+    uint8_t reg[4];
+
+    bool feature(int feature) const;    // as getInterruptStatus()
+    bool shock(int axis, int direction) const;
+    bool motion(int axis, int direction) const;
+    bool tap(int axis, int direction) const;
+    bool steps() const { return feature(CURIE_IMU_STEP); }
+} CurieIMUInterruptStatus;
+
 /* Note that this CurieIMUClass class inherits methods from the BMI160Class which
  * is defined in BMI160.h.  BMI160Class provides methods for configuring and
  * accessing features of the BMI160 IMU device.  This CurieIMUClass extends that
@@ -98,9 +132,36 @@ class CurieIMUClass : public BMI160Class {
         bool begin(void);
         void end(void);
 
+        // begin() and the auto calibrations without waiting for the device,
+        // e.g. while the radio starts up: call poll() from loop() until it
+        // returns false, and leave the IMU alone until then. beginAsync()
+        // checks the device ID first and returns false if it doesn't match.
+        bool beginAsync(unsigned int sensors = GYRO | ACCEL);
+        bool autoCalibrateGyroOffsetAsync();
+        bool autoCalibrateAccelerometerOffsetAsync(int axis, int target);
+        bool poll();
+
+        // Wake-on-motion: the gyroscope is suspended and the accelerometer
+        // runs undersampled in low power mode at rate (Hz), until any-motion
+        // over threshold (mg, as CURIE_IMU_MOTION) pulls the interrupt pin.
+        // poll() or sleepUntilMotion() then power both back up, restore the
+        // rate and resume a readStream() stream, flushing the FIFO.
+        bool beginWakeOnMotion(float threshold, float rate = 25.0f);
+        // resumes right away, waiting for the sensors
+        void endWakeOnMotion(void);
+        bool wakeOnMotionArmed(void);
+        // Sleeps the core until motion or timeout ms (0 for none), then
+        // resumes as above; false on timeout, still armed
+        bool sleepUntilMotion(uint32_t timeout = 0);
+
         bool dataReady();
         bool dataReady(unsigned int sensors);
 
+        // The rate and threshold getters convert the registers once and
+        // return that value until the setter here changes it, so don't mix
+        // them with the raw BMI160Class ones such as setAccelRate(). The
+        // ranges come from accel_range/gyro_range, which always follow.
+
         // supported values: 25, 50, 100, 200, 400, 800, 1600, 3200 (Hz)
         int getGyroRate();
         void setGyroRate(int rate);
@@ -186,12 +247,28 @@ class CurieIMUClass : public BMI160Class {
         bool interruptsEnabled(int feature);
 
         bool getInterruptStatus(int feature);
+        // Every interrupt status bit, with the tap, motion and shock axes
+        CurieIMUInterruptStatus readInterruptStatus();
 
         CurieIMUStepMode getStepDetectionMode();
         void setStepDetectionMode(int mode);
 
         void readMotionSensor(int& ax, int& ay, int& az, int& gx, int& gy, int& gz);
+        // as above, with the sensor time of the readings from the same burst
+        void readMotionSensor(int& ax, int& ay, int& az, int& gx, int& gy, int& gz, uint32_t& time);
+        // with the magnetometer data registers, raw as the magnetometer
+        // stores them, from the same burst; @see setMagAutoMode()
+        void readMotionSensor(int& ax, int& ay, int& az, int& gx, int& gy, int& gz, int& mx, int& my, int& mz);
+        void readMagnetometer(int& x, int& y, int& z);
         void readMotionSensorScaled(float& ax, float& ay, float& az, float& gx, float& gy, float& gz);
+        // as readMotionSensorScaled(), in Q16 fixed point: g and deg/s
+        // times 65536, with no float arithmetic
+        void readMotionSensorQ16(int32_t& ax, int32_t& ay, int32_t& az, int32_t& gx, int32_t& gy, int32_t& gz);
+        // Scales the ACCEL and GYRO records from readFIFO() or readStream()
+        // into out, three values (x, y, z) a record; the other records
+        // give zeros, so out[3 * i] always belongs to in[i]
+        void convertSamples(const CurieIMUSample *in, float *out, size_t count);
+        void convertSamples(const CurieIMUSample *in, int32_t *out, size_t count);
         void readAccelerometer(int& x, int& y, int& z);
         void readAccelerometerScaled(float& x, float& y, float& z);
         void readGyro(int& x, int& y, int& z);
@@ -207,10 +284,57 @@ class CurieIMUClass : public BMI160Class {
         bool tapDetected(int axis, int direction);
         bool stepsDetected();
 
+        // BMI160 sensor time: 24 bits, 39.0625 us a count, wraps every 655 s
+        uint32_t readSensorTime();
+        // Pairs the sensor time with micros() for sensorTimeToMicros(). Call
+        // it every few minutes: times within +/-327 s of the last call map
+        // correctly, and calls a second or more apart also measure the
+        // BMI160 clock against the Curie one.
+        void syncSensorTime();
+        // The micros() at a sensor time from readMotionSensor() or a
+        // CURIE_IMU_SAMPLE_TIME record
+        uint64_t sensorTimeToMicros(uint32_t time);
+
         void attachInterrupt(void (*callback)(void));
         void detachInterrupt(void);
+        // Of the always-on GPIO interrupt behind attachInterrupt(), shared
+        // with the other always-on pins: see ::setInterruptPriority()
+        bool setInterruptPriority(uint32_t priority);
+
+        // Burst-reads length registers from reg into data and returns without
+        // waiting; callback, from interrupt context, runs once data is filled.
+        // Returns false while a previous read is still running. A system
+        // library without interrupt-driven SPI reads before returning, and
+        // calls callback from here.
+        bool readRegistersAsync(uint8_t reg, uint8_t *data, unsigned length, void (*callback)(void));
+        bool readRegistersBusy();
+
+        // Streams ACCEL, GYRO and/or MAG samples through the BMI160 FIFO, at
+        // the configured rates. watermark is in bytes, rounded down to 4, for
+        // the FIFO interrupt; headers adds sensor time and overflow
+        // records. Allocates a FIFO sized buffer until endFIFO().
+        bool beginFIFO(unsigned int sensors, unsigned int watermark = 0, bool headers = true);
+        void endFIFO(void);
+        // Returns up to max records, oldest first, draining the FIFO with a
+        // single SPI burst whenever the last one has been used up
+        size_t readFIFO(CurieIMUSample *out, size_t max);
+
+        // Drains the FIFO into ring, size records, in SPI bursts started
+        // on the watermark interrupt by a Task, so from yield() and the
+        // main loop, and read in the background; call beginFIFO() with a
+        // watermark first. The interrupt pin becomes non-latched, so that
+        // each watermark crossing is a new edge.
+        bool beginFIFOStream(CurieIMUSample *ring, size_t size);
+        void endFIFOStream(void);
+        size_t streamAvailable(void);
+        // Takes up to max records from the ring, oldest first
+        size_t readStream(CurieIMUSample *out, size_t max);
+        // Records dropped because the ring was full
+        uint32_t streamOverruns(void);
 
     private:
+        void start_spi(void);
+        bool resumeFromMotion(void);
         bool configure_imu(unsigned int sensors);
         int serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt, unsigned rx_cnt);
 
@@ -240,11 +364,58 @@ class CurieIMUClass : public BMI160Class {
         int getDoubleTapDetectionDuration();
         void setDoubleTapDetectionDuration(int duration);
 
-        float convertRaw(int16_t raw, float range_abs);
+        bool shadowValid(unsigned bit);
+
+        float convertRaw(int16_t raw, float slope);
+        static int32_t convertRawQ16(int16_t raw, int32_t range_abs);
 
         void enableInterrupt(int feature, bool enabled);
 
         void (*_user_callback)(void);
+
+        size_t parseFIFO(CurieIMUSample *out, size_t max);
+        void serviceFIFO(void);
+        static void fifoBurstDone(uint32_t self);
+        static void fifoTask(void *arg);
+        static Task _fifo_task;
+
+        uint8_t *_fifo_buf;
+        unsigned _fifo_pos;
+        unsigned _fifo_len;
+        unsigned _fifo_sensors;
+        bool _fifo_headers;
+        unsigned _fifo_watermark;
+        volatile bool _fifo_busy;       // burst read in flight
+        volatile bool _fifo_pending;    // watermark or burst end for fifoTask()
+        volatile unsigned _spi_active;  // serial_buffer_transfer() depth
+
+        volatile uint8_t _wom_state;    // WOM_*, see CurieIMU.cpp
+        uint8_t _wom_acc_conf;          // ACC_CONF to restore
+        unsigned _wom_sensors;          // sensors_enabled before
+        bool _wom_motion_int;           // any-motion interrupt was on
+        bool _wom_stream;               // a stream was running
+        uint32_t _wom_time;             // micros32() of the last step
+        bool _async_pending;            // poll() has to finish an operation
+        unsigned _shadow_valid;         // SHADOW_* bits, see CurieIMU.cpp
+        int32_t _shadow_accel_range;    // accel_range_int the thresholds are for
+        int _gyro_rate;
+        float _accel_rate;
+        float _freefall_ths;
+        float _shock_ths;
+        float _motion_ths;
+        float _zero_motion_ths;
+        float _tap_ths;
+
+        bool _st_synced;
+        uint32_t _st_ref;               // sensor time at the last sync
+        uint64_t _st_ref_us;            // micros() at the last sync
+        uint32_t _st_scale;             // us per sensor time count, Q16
+
+        CurieIMUSample *_ring;
+        size_t _ring_size;
+        volatile size_t _ring_head;
+        volatile size_t _ring_tail;
+        volatile uint32_t _ring_overruns;
 };
 
 extern CurieIMUClass CurieIMU;
@@ -0,0 +1,130 @@
+/*
+ * ImuRecords.ino: streams accelerometer and gyro frames from the IMU FIFO
+ * as delta encoded records, all six axes into a circular log on the
+ * onboard flash and the accelerometer over BLE notifications while a
+ * central is subscribed. Once a second it prints the bytes per frame each
+ * path took, against 2 per axis and 4 for a timestamp as raw values.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+#include <CurieIMU.h>
+#include <CurieBLE.h>
+#include <CurieFlashLog.h>
+#include <CurieRecord.h>
+
+#define ODR 200
+
+CurieFlashChip flash;
+CurieFlashLog flashLog;
+
+BLEService recordService("19B10200-E8F2-537E-4F6C-D104768A1214");
+BLECharacteristic recordCharacteristic("19B10201-E8F2-537E-4F6C-D104768A1214", BLENotify, 20);
+
+CurieIMUSample ring[256];
+CurieIMUSample batch[32];
+
+uint8_t logBlock[CURIE_FLASH_LOG_MAX_RECORD];
+uint8_t bleBlock[20];
+CurieRecordEncoder logRecords;
+CurieRecordEncoder bleRecords;
+
+unsigned long frames, logBytes, bleFrames, bleBytes;
+unsigned long lastReport;
+
+bool toLog(const uint8_t *block, uint16_t len, void *arg) {
+  logBytes += len;
+  return flashLog.append(block, len);
+}
+
+bool toBle(const uint8_t *block, uint16_t len, void *arg) {
+  // nobody listening: drop the block rather than hold up the encoder
+  if (!recordCharacteristic.subscribed())
+    return true;
+  if (!recordCharacteristic.notifyAsync(block, len))
+    return false;
+  bleBytes += len;
+  return true;
+}
+
+void setup() {
+  Serial.begin(9600);
+
+  if (!flash.begin() ||
+      !flashLog.begin(flash, flash.capacity() - CURIE_FLASH_BLOCK_SIZE, CURIE_FLASH_BLOCK_SIZE, 2)) {
+    Serial.println("No flash log");
+    while (1) ;
+  }
+
+  BLE.begin();
+  BLE.setLocalName("ImuRecords");
+  BLE.setAdvertisedService(recordService);
+  recordService.addCharacteristic(recordCharacteristic);
+  BLE.addService(recordService);
+  BLE.advertise();
+
+  // frames are numbered, which at a fixed rate is as good as a time and
+  // costs one byte; a keyframe every 50 frames bounds what a lost BLE
+  // notification takes with it
+  logRecords.begin(6, logBlock, sizeof(logBlock), toLog);
+  bleRecords.begin(3, bleBlock, sizeof(bleBlock), toBle, NULL, 50);
+
+  CurieIMU.begin();
+  CurieIMU.setAccelerometerRate(ODR);
+  CurieIMU.setGyroRate(ODR);
+  CurieIMU.beginFIFO(ACCEL | GYRO, 128, true);
+  CurieIMU.beginFIFOStream(ring, sizeof(ring) / sizeof(ring[0]));
+}
+
+void loop() {
+  static int16_t axes[6];
+  size_t n = CurieIMU.readStream(batch, sizeof(batch) / sizeof(batch[0]));
+
+  for (size_t i = 0; i < n; i++) {
+    const CurieIMUSample &s = batch[i];
+    if (s.type == CURIE_IMU_SAMPLE_ACCEL) {
+      axes[0] = s.x;
+      axes[1] = s.y;
+      axes[2] = s.z;
+    } else if (s.type == CURIE_IMU_SAMPLE_GYRO) {
+      // the gyro closes an accel + gyro frame
+      axes[3] = s.x;
+      axes[4] = s.y;
+      axes[5] = s.z;
+      logRecords.add(frames, axes);
+      if (bleRecords.add(frames, axes))
+        bleFrames++;
+      frames++;
+    }
+  }
+  flashLog.poll();
+
+  if (millis() - lastReport >= 1000) {
+    lastReport = millis();
+    Serial.print(frames);
+    Serial.print(" frames, log ");
+    Serial.print(frames ? (float)logBytes / frames : 0);
+    Serial.print(" bytes a frame, BLE ");
+    Serial.print(bleFrames ? (float)bleBytes / bleFrames : 0);
+    Serial.println(" bytes a frame");
+  }
+}
+
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
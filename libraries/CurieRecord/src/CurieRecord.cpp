@@ -0,0 +1,220 @@
+/*
+ * Compact delta encoded sensor records for Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieRecord.h"
+#include "crc.h"
+
+/* offset of the frame count in the header */
+#define FRAMES_AT   2
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline uint8_t *putVarint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+bool CurieRecordEncoder::begin(uint8_t channels, uint8_t *block, uint16_t size,
+                               CurieRecordSink sink, void *arg, uint8_t keyframeInterval)
+{
+    if (channels == 0 || channels > CURIE_RECORD_MAX_CHANNELS || !block || !sink ||
+        size < CURIE_RECORD_OVERHEAD + 1 + channels)
+        return false;
+
+    _sink = sink;
+    _arg = arg;
+    _block = block;
+    _size = size;
+    _channels = channels;
+    _interval = (keyframeInterval && keyframeInterval < CURIE_RECORD_MAX_FRAMES) ?
+        keyframeInterval : CURIE_RECORD_MAX_FRAMES;
+    _frames = 0;
+    _len = 0;
+    _full = false;
+    _seq = 0;
+    return true;
+}
+
+/* A keyframe as the first of a block, a delta from the last frame after */
+uint16_t CurieRecordEncoder::encode(uint8_t *out, uint32_t time, const int32_t *values)
+{
+    uint8_t *p = out;
+    uint8_t i;
+
+    if (_frames == 0) {
+        p = putVarint(p, time);
+        for (i = 0; i < _channels; i++)
+            p = putVarint(p, zigzag(values[i]));
+    } else {
+        p = putVarint(p, time - _time);
+        for (i = 0; i < _channels; i++)
+            p = putVarint(p, zigzag((int32_t)((uint32_t)values[i] - (uint32_t)_values[i])));
+    }
+    return p - out;
+}
+
+/* Closes the block with its CRC and offers it to the sink */
+bool CurieRecordEncoder::emit()
+{
+    if (!_full) {
+        _block[FRAMES_AT] = _frames;
+        uint16_t crc = crc16_ccitt(0xFFFF, _block, _len);
+        _block[_len++] = crc & 0xFF;
+        _block[_len++] = crc >> 8;
+        _full = true;
+    }
+    if (!_sink(_block, _len, _arg))
+        return false;
+
+    _full = false;
+    _frames = 0;
+    _len = 0;
+    _seq++;
+    return true;
+}
+
+bool CurieRecordEncoder::add(uint32_t time, const int32_t *values)
+{
+    uint8_t frame[CURIE_RECORD_MAX_FRAME];
+    uint16_t len;
+
+    if (!_sink || (_full && !emit()))
+        return false;
+
+    len = encode(frame, time, values);
+    if (_frames && _len + len + 2 > _size) {
+        /* no room: the frame opens the next block as its keyframe */
+        if (!emit())
+            return false;
+        len = encode(frame, time, values);
+    }
+    if (_frames == 0) {
+        _block[0] = CURIE_RECORD_MAGIC;
+        _block[1] = _channels;
+        _len = putVarint(_block + FRAMES_AT + 1, _seq) - _block;
+        if (_len + len + 2 > _size)
+            return false;
+    }
+
+    memcpy(_block + _len, frame, len);
+    _len += len;
+    _frames++;
+    _time = time;
+    memcpy(_values, values, _channels * sizeof(_values[0]));
+
+    /* a full block goes once the sink takes it, on this call or the next */
+    if (_frames >= _interval)
+        emit();
+    return true;
+}
+
+bool CurieRecordEncoder::add(uint32_t time, const int16_t *values)
+{
+    int32_t wide[CURIE_RECORD_MAX_CHANNELS];
+
+    for (uint8_t i = 0; i < _channels; i++)
+        wide[i] = values[i];
+    return add(time, wide);
+}
+
+bool CurieRecordEncoder::flush()
+{
+    if (!_sink || (_frames == 0 && !_full))
+        return true;
+    return emit();
+}
+
+bool CurieRecordDecoder::varint(uint32_t &v)
+{
+    uint8_t shift = 0;
+
+    v = 0;
+    while (_pos < _end && shift < 35) {
+        uint8_t b = *_pos++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+        shift += 7;
+    }
+    return false;
+}
+
+bool CurieRecordDecoder::begin(const uint8_t *block, uint16_t len)
+{
+    _left = 0;
+    if (len < 6 || block[0] != CURIE_RECORD_MAGIC ||
+        block[1] == 0 || block[1] > CURIE_RECORD_MAX_CHANNELS || block[FRAMES_AT] == 0)
+        return false;
+    if (crc16_ccitt(0xFFFF, block, len - 2) != (block[len - 2] | (block[len - 1] << 8)))
+        return false;
+
+    _pos = block + FRAMES_AT + 1;
+    _end = block + len - 2;
+    if (!varint(_seq))
+        return false;
+    _channels = block[1];
+    _frames = block[FRAMES_AT];
+    _left = _frames;
+    _done = 0;
+    return true;
+}
+
+bool CurieRecordDecoder::next(uint32_t &time, int32_t *values)
+{
+    uint32_t v;
+    uint8_t i;
+
+    if (!_left)
+        return false;
+
+    if (!varint(v))
+        goto damaged;
+    _time = _done ? _time + v : v;
+    for (i = 0; i < _channels; i++) {
+        if (!varint(v))
+            goto damaged;
+        _values[i] = _done ? (int32_t)((uint32_t)_values[i] + (uint32_t)unzigzag(v)) : unzigzag(v);
+    }
+    _left--;
+    _done++;
+
+    time = _time;
+    memcpy(values, _values, _channels * sizeof(_values[0]));
+    return true;
+
+damaged:
+    /* the CRC matched but the frames don't: a different encoder's block */
+    _left = 0;
+    return false;
+}
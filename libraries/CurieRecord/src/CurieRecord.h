@@ -0,0 +1,138 @@
+/*
+ * Compact delta encoded sensor records for Intel(R) Curie(TM) devices.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CURIERECORD_H_
+#define _CURIERECORD_H_
+
+#include <Arduino.h>
+
+/* Frames of up to CURIE_RECORD_MAX_CHANNELS samples with a timestamp,
+ * packed into blocks for a BLE notification, a CurieFlashLog record or a
+ * serial link. Each block stands alone:
+ *
+ *     magic    0xC5
+ *     channels
+ *     frames   in this block, 1..255
+ *     seq      varint, one more per block, to count the blocks lost
+ *     keyframe varint time, then a zigzag varint per channel value
+ *     frames   varint time since the frame before, then a zigzag varint
+ *              per channel of the change since the frame before
+ *     crc      CRC-16/CCITT-FALSE of the bytes before, little endian
+ *
+ * Varints are 7 bits a byte, low bits first; zigzag maps 0, -1, 1, -2 ...
+ * to 0, 1, 2, 3 ... so that small changes either way take one byte. A
+ * slowly changing 16-bit channel costs one or two bytes a sample instead
+ * of two, and the timestamp one byte a frame instead of four. Since every
+ * block opens with a keyframe, a lost or damaged block costs only its own
+ * frames and decoding picks up at the next one. Times and values are
+ * 32-bit and wrap, so any units work: micros(), an IMU sensor time or an
+ * analogReadTriggered() tick index.
+ */
+
+#define CURIE_RECORD_MAGIC          0xC5
+#define CURIE_RECORD_MAX_CHANNELS   16
+#define CURIE_RECORD_MAX_FRAMES     255
+
+/* The header and the CRC, at most; a block needs room for them and a
+ * keyframe, a varint being at most 5 bytes */
+#define CURIE_RECORD_OVERHEAD       10
+#define CURIE_RECORD_MAX_FRAME      (5 * (1 + CURIE_RECORD_MAX_CHANNELS))
+
+/* Takes a finished block, e.g. to BLECharacteristic::notifyAsync() or
+ * CurieFlashLog::append(). Returning false keeps the block, and add() or
+ * flush() offers it again on the next call. */
+typedef bool (*CurieRecordSink)(const uint8_t *block, uint16_t len, void *arg);
+
+class CurieRecordEncoder {
+public:
+  CurieRecordEncoder() : _sink(NULL) {}
+
+  /* Frames of channels values go into blocks of up to size bytes in
+   * block, handed to sink once full, once keyframeInterval frames are in
+   * (0 for as many as fit) or on flush(). Blocks of
+   * CURIE_RECORD_OVERHEAD + 5 * (1 + channels) bytes hold any keyframe;
+   * smaller ones, down to a 20 byte BLE notification, do for values and
+   * times that are small enough. */
+  bool begin(uint8_t channels, uint8_t *block, uint16_t size,
+             CurieRecordSink sink, void *arg = NULL, uint8_t keyframeInterval = 0);
+
+  /* Adds a frame; false, without adding it, while sink refuses a block or
+   * if as a keyframe it doesn't fit in size */
+  bool add(uint32_t time, const int32_t *values);
+  bool add(uint32_t time, const int16_t *values);
+
+  /* Hands the frames gathered so far to sink; true if none are left */
+  bool flush();
+
+  /* Sequence number of the block being filled */
+  uint32_t seq() { return _seq; }
+
+  /* Frames in the block being filled */
+  uint8_t frames() { return _frames; }
+
+private:
+  bool emit();
+  uint16_t encode(uint8_t *out, uint32_t time, const int32_t *values);
+
+  CurieRecordSink _sink;
+  void *_arg;
+  uint8_t *_block;
+  uint16_t _size;
+  uint16_t _len;
+  uint8_t _channels;
+  uint8_t _interval;
+  uint8_t _frames;
+  bool _full;                 /* waiting for sink to take it */
+  uint32_t _seq;
+  uint32_t _time;
+  int32_t _values[CURIE_RECORD_MAX_CHANNELS];
+};
+
+class CurieRecordDecoder {
+public:
+  CurieRecordDecoder() : _channels(0), _left(0) {}
+
+  /* Checks the CRC and header of a block; false if it is damaged */
+  bool begin(const uint8_t *block, uint16_t len);
+
+  /* Decodes the next frame into time and values, channels() of them;
+   * false after the last */
+  bool next(uint32_t &time, int32_t *values);
+
+  uint8_t channels() { return _channels; }
+  uint8_t frames() { return _frames; }
+  uint32_t seq() { return _seq; }
+
+private:
+  bool varint(uint32_t &v);
+
+  const uint8_t *_pos;
+  const uint8_t *_end;
+  uint8_t _channels;
+  uint8_t _frames;
+  uint8_t _left;
+  uint8_t _done;
+  uint32_t _seq;
+  uint32_t _time;
+  int32_t _values[CURIE_RECORD_MAX_CHANNELS];
+};
+
+#endif /* _CURIERECORD_H_ */
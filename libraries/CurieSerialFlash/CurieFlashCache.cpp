@@ -0,0 +1,103 @@
+/*
+ * CurieFlashCache.cpp - read cache for the Arduino/Genuino 101 onboard
+ * SPI flash
+ *
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CurieFlashCache.h"
+
+#define CACHE_EMPTY     0xFFFFFFFF
+
+void CurieFlashCache::begin(CurieFlashChip &flash)
+{
+    _flash = &flash;
+    _clock = 0;
+    _hits = 0;
+    _misses = 0;
+    invalidateAll();
+}
+
+void CurieFlashCache::invalidateAll()
+{
+    for (int i = 0; i < CURIE_FLASH_CACHE_LINES; i++)
+        _lines[i].addr = CACHE_EMPTY;
+}
+
+void CurieFlashCache::invalidate(uint32_t addr, uint32_t len)
+{
+    for (int i = 0; i < CURIE_FLASH_CACHE_LINES; i++) {
+        uint32_t line = _lines[i].addr;
+        if (line != CACHE_EMPTY && line < addr + len &&
+            addr < line + CURIE_FLASH_CACHE_LINE)
+            _lines[i].addr = CACHE_EMPTY;
+    }
+}
+
+CurieFlashCache::Line *CurieFlashCache::lookup(uint32_t addr)
+{
+    for (int i = 0; i < CURIE_FLASH_CACHE_LINES; i++) {
+        if (_lines[i].addr == addr)
+            return &_lines[i];
+    }
+    return NULL;
+}
+
+void CurieFlashCache::read(uint32_t addr, void *buf, uint32_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+
+    while (len > 0) {
+        uint32_t base = addr & ~(CURIE_FLASH_CACHE_LINE - 1);
+        uint32_t off = addr - base;
+        uint32_t n = CURIE_FLASH_CACHE_LINE - off;
+        if (n > len)
+            n = len;
+
+        Line *line = lookup(base);
+        if (line) {
+            _hits++;
+        } else if (n == CURIE_FLASH_CACHE_LINE) {
+            /* a bulk read: take every whole line that misses in one go */
+            while (n + CURIE_FLASH_CACHE_LINE <= len &&
+                   !lookup(base + n))
+                n += CURIE_FLASH_CACHE_LINE;
+            _misses++;
+            _flash->read(addr, p, n);
+            addr += n;
+            p += n;
+            len -= n;
+            continue;
+        } else {
+            _misses++;
+            line = &_lines[0];
+            for (int i = 1; i < CURIE_FLASH_CACHE_LINES; i++) {
+                if (_lines[i].addr == CACHE_EMPTY ||
+                    (line->addr != CACHE_EMPTY && _lines[i].used < line->used))
+                    line = &_lines[i];
+            }
+            _flash->read(base, line->data, CURIE_FLASH_CACHE_LINE);
+            line->addr = base;
+        }
+        line->used = ++_clock;
+        memcpy(p, line->data + off, n);
+        addr += n;
+        p += n;
+        len -= n;
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * CurieFlashCache.h - read cache for the Arduino/Genuino 101 onboard SPI
+ * flash
+ *
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CURIE_FLASH_CACHE_H_
+#define _CURIE_FLASH_CACHE_H_
+
+#include "CurieFlashChip.h"
+
+/* Each read of the chip costs a command, three address bytes and a dummy
+ * byte on the bus before any data, plus the transaction around them, so a
+ * run of small reads from a table spends most of its time on overhead.
+ * This keeps the most recently used lines of the chip in RAM and serves
+ * reads from them, filling a line with one burst on a miss; the least
+ * recently used line is replaced. Reads of a whole line or more that
+ * miss go straight to the chip without displacing anything.
+ *
+ * The onboard flash isn't memory mapped, so this is the nearest thing to
+ * execute in place. Nothing is written through: after programming or
+ * erasing a cached area, invalidate() it. */
+
+/* Bytes per line, a power of two */
+#ifndef CURIE_FLASH_CACHE_LINE
+#define CURIE_FLASH_CACHE_LINE    256
+#endif
+
+#ifndef CURIE_FLASH_CACHE_LINES
+#define CURIE_FLASH_CACHE_LINES   8
+#endif
+
+class CurieFlashCache {
+public:
+  CurieFlashCache() : _flash(NULL) {}
+
+  void begin(CurieFlashChip &flash);
+
+  void read(uint32_t addr, void *buf, uint32_t len);
+
+  /* Drops the lines holding any of the area, or all of them */
+  void invalidate(uint32_t addr, uint32_t len);
+  void invalidateAll();
+
+  uint32_t hits() { return _hits; }
+  uint32_t misses() { return _misses; }
+
+private:
+  struct Line {
+    uint32_t addr;              /* CACHE_EMPTY when unused */
+    uint32_t used;              /* _clock at the last hit */
+    uint8_t data[CURIE_FLASH_CACHE_LINE];
+  };
+
+  Line *lookup(uint32_t addr);
+
+  CurieFlashChip *_flash;
+  uint32_t _clock;
+  uint32_t _hits;
+  uint32_t _misses;
+  Line _lines[CURIE_FLASH_CACHE_LINES];
+};
+
+#endif /* _CURIE_FLASH_CACHE_H_ */
@@ -0,0 +1,322 @@
+/*
+ * CurieFlashChip.cpp - fast raw access to the Arduino/Genuino 101 onboard
+ * SPI flash
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CurieFlashChip.h"
+
+#define CMD_WRITE_ENABLE    0x06
+#define CMD_READ_STATUS     0x05
+#define CMD_FAST_READ       0x0B
+#define CMD_PAGE_PROGRAM    0x02
+#define CMD_SECTOR_ERASE    0x20
+#define CMD_BLOCK_ERASE     0xD8
+#define CMD_CHIP_ERASE      0xC7
+#define CMD_JEDEC_ID        0x9F
+#define CMD_RELEASE_PD      0xAB
+#define CMD_READ_STATUS2    0x35
+#define CMD_SUSPEND         0x75
+#define CMD_RESUME          0x7A
+
+#define STATUS_BUSY         0x01
+#define STATUS2_SUS         0x80
+
+#define JEDEC_WINBOND       0xEF
+#define JEDEC_GIGADEVICE    0xC8
+
+/* an erase needs time between a resume and the next suspend to get
+ * anywhere; the chips ask for at least 20 us */
+#define RESUME_GAP_US       100
+
+bool CurieFlashChip::begin(SPIClass &spi, uint8_t csPin)
+{
+    uint8_t id[3];
+
+    _spi = &spi;
+    _settings = SPISettings(CURIE_FLASH_CLOCK, MSBFIRST, SPI_MODE0);
+    _busy = false;
+    _eraseSize = 0;
+    _queued = 0;
+    _resumed = micros();
+    pinMode(csPin, OUTPUT);
+    fastPinInit(&_cs, csPin);
+    fastPinHigh(&_cs);
+    _device = SPIDevice(csPin, _settings);
+    _spi->begin();
+
+    /* in case it was left powered down */
+    select();
+    _spi->transfer(CMD_RELEASE_PD);
+    deselect();
+    delayMicroseconds(30);
+
+    readID(id);
+    /* the third byte is log2 of the size on the usual parts */
+    if (id[0] == 0x00 || id[0] == 0xFF || id[2] < 16 || id[2] > 28) {
+        _capacity = 0;
+        return false;
+    }
+    _capacity = 1UL << id[2];
+    _canSuspend = id[0] == JEDEC_WINBOND || id[0] == JEDEC_GIGADEVICE;
+    return true;
+}
+
+void CurieFlashChip::select()
+{
+    _spi->beginTransaction(_settings);
+    fastPinLow(&_cs);
+}
+
+void CurieFlashChip::deselect()
+{
+    fastPinHigh(&_cs);
+    _spi->endTransaction();
+}
+
+/* cmd and len - 1 bytes of address, most significant first */
+void CurieFlashChip::command(uint8_t cmd, uint32_t addr, uint8_t len)
+{
+    uint8_t buf[5] = { cmd, (uint8_t)(addr >> 16), (uint8_t)(addr >> 8),
+                       (uint8_t)addr, 0 };
+
+    _spi->transfer(buf, NULL, len);
+}
+
+void CurieFlashChip::readID(uint8_t *id)
+{
+    wait();
+    select();
+    _spi->transfer(CMD_JEDEC_ID);
+    _spi->transfer(NULL, id, 3);
+    deselect();
+}
+
+uint8_t CurieFlashChip::readStatus(uint8_t cmd)
+{
+    select();
+    _spi->transfer(cmd);
+    uint8_t status = _spi->transfer(0);
+    deselect();
+    return status;
+}
+
+bool CurieFlashChip::ready()
+{
+    if (!_busy)
+        return true;
+
+    _busy = readStatus(CMD_READ_STATUS) & STATUS_BUSY;
+    if (!_busy)
+        _eraseSize = 0;
+    return !_busy;
+}
+
+void CurieFlashChip::wait()
+{
+    while (!ready())
+        ;
+}
+
+void CurieFlashChip::writeEnable()
+{
+    select();
+    _spi->transfer(CMD_WRITE_ENABLE);
+    deselect();
+}
+
+/* Suspends the running erase if it can be and doesn't touch the area;
+ * true if the caller must resume() it */
+bool CurieFlashChip::suspendFor(uint32_t addr, uint32_t len)
+{
+    if (!_canSuspend || !_busy || _eraseSize == 0)
+        return false;
+    if (addr < _eraseAddr + _eraseSize && _eraseAddr < addr + len)
+        return false;
+
+    while (micros() - _resumed < RESUME_GAP_US)
+        ;
+    select();
+    _spi->transfer(CMD_SUSPEND);
+    deselect();
+    while (readStatus(CMD_READ_STATUS) & STATUS_BUSY)
+        ;
+    if (!(readStatus(CMD_READ_STATUS2) & STATUS2_SUS)) {
+        /* it finished first */
+        _busy = false;
+        _eraseSize = 0;
+        return false;
+    }
+    return true;
+}
+
+void CurieFlashChip::resume()
+{
+    select();
+    _spi->transfer(CMD_RESUME);
+    deselect();
+    _resumed = micros();
+}
+
+void CurieFlashChip::read(uint32_t addr, void *buf, uint32_t len)
+{
+    bool suspended = suspendFor(addr, len);
+
+    if (!suspended)
+        wait();
+    select();
+    /* fast read: command, address and a dummy byte */
+    command(CMD_FAST_READ, addr, 5);
+    _spi->transfer(NULL, buf, len);
+    deselect();
+    if (suspended)
+        resume();
+}
+
+void CurieFlashChip::readAsync(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    wait();
+    while (_spi->busy())
+        ;
+    /* the command goes out of the front of buf and the chip's bytes come
+     * back over it, so the data starts CURIE_FLASH_ASYNC_HEADER in */
+    buf[0] = CMD_FAST_READ;
+    buf[1] = addr >> 16;
+    buf[2] = addr >> 8;
+    buf[3] = addr;
+    buf[4] = 0;
+    _async.device = &_device;
+    _async.tx = buf;
+    _async.rx = buf;
+    _async.len = CURIE_FLASH_ASYNC_HEADER + len;
+    _async.callback = NULL;
+    _spi->queue(&_async);
+}
+
+void CurieFlashChip::write(uint32_t addr, const void *buf, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    takeQueued(addr, len);
+    bool suspended = suspendFor(addr, len);
+
+    while (len > 0) {
+        uint32_t n = CURIE_FLASH_PAGE_SIZE - (addr % CURIE_FLASH_PAGE_SIZE);
+        if (n > len)
+            n = len;
+
+        if (!suspended)
+            wait();
+        writeEnable();
+        select();
+        command(CMD_PAGE_PROGRAM, addr, 4);
+        _spi->transfer(p, NULL, n);
+        deselect();
+        if (suspended) {
+            /* the erase resumes only once the page is programmed */
+            while (readStatus(CMD_READ_STATUS) & STATUS_BUSY)
+                ;
+        } else {
+            _busy = true;
+        }
+
+        addr += n;
+        p += n;
+        len -= n;
+    }
+    if (suspended)
+        resume();
+}
+
+void CurieFlashChip::startErase(uint8_t cmd, uint32_t addr, uint32_t size)
+{
+    wait();
+    writeEnable();
+    select();
+    command(cmd, addr, 4);
+    deselect();
+    _busy = true;
+    _eraseAddr = addr & ~(size - 1);
+    _eraseSize = size;
+}
+
+void CurieFlashChip::eraseSector(uint32_t addr)
+{
+    startErase(CMD_SECTOR_ERASE, addr, CURIE_FLASH_SECTOR_SIZE);
+}
+
+void CurieFlashChip::eraseBlock(uint32_t addr)
+{
+    startErase(CMD_BLOCK_ERASE, addr, CURIE_FLASH_BLOCK_SIZE);
+}
+
+void CurieFlashChip::eraseAll()
+{
+    /* this covers the queued ones */
+    _queued = 0;
+    wait();
+    writeEnable();
+    select();
+    _spi->transfer(CMD_CHIP_ERASE);
+    deselect();
+    /* a chip erase can't be suspended */
+    _busy = true;
+}
+
+bool CurieFlashChip::queueErase(uint32_t addr)
+{
+    uint32_t sector = addr & ~(CURIE_FLASH_SECTOR_SIZE - 1);
+
+    for (uint8_t i = 0; i < _queued; i++) {
+        if (_queue[i] == sector)
+            return true;
+    }
+    if (_queued == CURIE_FLASH_ERASE_QUEUE)
+        return false;
+    _queue[_queued++] = sector;
+    return true;
+}
+
+/* Starts now the queued erases of sectors in the area, so that what is
+ * about to be programmed there isn't erased after */
+void CurieFlashChip::takeQueued(uint32_t addr, uint32_t len)
+{
+    uint8_t i = 0;
+
+    while (i < _queued) {
+        uint32_t sector = _queue[i];
+        if (sector < addr + len && addr < sector + CURIE_FLASH_SECTOR_SIZE) {
+            _queued--;
+            memmove(&_queue[i], &_queue[i + 1], (_queued - i) * sizeof(_queue[0]));
+            eraseSector(sector);
+        } else {
+            i++;
+        }
+    }
+}
+
+void CurieFlashChip::poll()
+{
+    if (_queued == 0 || !ready())
+        return;
+
+    uint32_t sector = _queue[0];
+    _queued--;
+    memmove(&_queue[0], &_queue[1], _queued * sizeof(_queue[0]));
+    eraseSector(sector);
+}
@@ -0,0 +1,141 @@
+/*
+ * CurieFlashChip.h - fast raw access to the Arduino/Genuino 101 onboard
+ * SPI flash
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CURIE_FLASH_CHIP_H_
+#define _CURIE_FLASH_CHIP_H_
+
+#if !defined (__arc__)
+#error CurieFlashChip only works with the onboard SPI flash on Arduino/Genuino 101 board
+#endif
+
+#include <Arduino.h>
+#include <SPI.h>
+
+/* SerialFlash moves every byte with its own SPI.transfer(); this talks to
+ * the same chip in bursts, so reads of SPI_DMA_THRESHOLD bytes or more go
+ * by DMA and a page program keeps the TX FIFO full. It is raw access, for
+ * data logging and the like; the SerialFlash file system is separate and
+ * the two shouldn't share an area of the chip.
+ *
+ * The SoC SPI master drives one data line each way, so the dual and quad
+ * read commands of the chip can't be used; fast read (0x0B) at the
+ * controller's top clock of 16 MHz is as quick as this bus gets.
+ *
+ * A sector erase takes tens of milliseconds and a block erase hundreds.
+ * On chips with erase suspend (Winbond, GigaDevice) a read or page
+ * program outside the sector being erased suspends the erase instead of
+ * waiting for it, and queueErase() with poll() lets sectors be erased
+ * ahead of time while the chip would otherwise be idle. */
+
+#define CURIE_FLASH_PAGE_SIZE     256
+#define CURIE_FLASH_SECTOR_SIZE   4096
+#define CURIE_FLASH_BLOCK_SIZE    65536
+
+#ifndef CURIE_FLASH_CLOCK
+#define CURIE_FLASH_CLOCK         16000000
+#endif
+
+/* Room readAsync() needs in front of the data for the command */
+#define CURIE_FLASH_ASYNC_HEADER  5
+
+/* Sector erases queueErase() holds until poll() can start them */
+#ifndef CURIE_FLASH_ERASE_QUEUE
+#define CURIE_FLASH_ERASE_QUEUE   8
+#endif
+
+class CurieFlashChip {
+public:
+  CurieFlashChip() : _spi(NULL), _device(ONBOARD_FLASH_CS_PIN, SPISettings()),
+    _capacity(0), _queued(0) {}
+
+  /* Reads the JEDEC id; false when no known chip answers */
+  bool begin(SPIClass &spi = ONBOARD_FLASH_SPI_PORT, uint8_t csPin = ONBOARD_FLASH_CS_PIN);
+
+  /* In bytes, from the JEDEC id */
+  uint32_t capacity() { return _capacity; }
+  void readID(uint8_t *id);
+
+  /* Reads len bytes. A running sector or block erase elsewhere on the
+   * chip is suspended for the read where the chip allows it; otherwise
+   * this waits for the running program or erase. */
+  void read(uint32_t addr, void *buf, uint32_t len);
+
+  /* Starts reading len bytes into buf + CURIE_FLASH_ASYNC_HEADER, which
+   * must have room for CURIE_FLASH_ASYNC_HEADER + len bytes, and returns
+   * once the chip is idle and the transfer is queued on the SPI bus; the
+   * transfer runs from interrupt context, by DMA outside DCCM, while the
+   * caller carries on. readBusy() stays true until it is done, and buf
+   * must stay valid until then. Other calls wait for it. */
+  void readAsync(uint32_t addr, uint8_t *buf, uint32_t len);
+  bool readBusy() { return _spi->busy(); }
+
+  /* Programs len bytes (the area must be erased), split at page
+   * boundaries into full page bursts. Returns once the last page has
+   * been sent; the chip programs it meanwhile. An erase elsewhere is
+   * suspended as for read(), and an erase still queued for the area is
+   * done first. */
+  void write(uint32_t addr, const void *buf, uint32_t len);
+
+  /* Start an erase and return; ready() tells when it is done */
+  void eraseSector(uint32_t addr);  /* the 4 KB holding addr */
+  void eraseBlock(uint32_t addr);   /* the 64 KB holding addr */
+  void eraseAll();
+
+  /* Queues an erase of the 4 KB holding addr for poll() to start;
+   * false when the queue is full */
+  bool queueErase(uint32_t addr);
+  uint8_t erasesQueued() { return _queued; }
+
+  /* Starts the next queued erase once the chip is idle; call it from
+   * loop() */
+  void poll();
+
+  /* false while a program or erase is running */
+  bool ready();
+  void wait();
+
+private:
+  void select();
+  void deselect();
+  void command(uint8_t cmd, uint32_t addr, uint8_t len);
+  void writeEnable();
+  uint8_t readStatus(uint8_t cmd);
+  void startErase(uint8_t cmd, uint32_t addr, uint32_t size);
+  bool suspendFor(uint32_t addr, uint32_t len);
+  void resume();
+  void takeQueued(uint32_t addr, uint32_t len);
+
+  SPIClass *_spi;
+  SPISettings _settings;
+  FastPin _cs;
+  SPIDevice _device;
+  SPITransaction _async;
+  uint32_t _capacity;
+  bool _busy;
+  bool _canSuspend;
+  uint32_t _eraseAddr;        /* of the erase running, if _eraseSize */
+  uint32_t _eraseSize;        /* 0 for none, or one that can't suspend */
+  uint32_t _resumed;          /* micros() of the last resume */
+  uint32_t _queue[CURIE_FLASH_ERASE_QUEUE];
+  uint8_t _queued;
+};
+
+#endif /* _CURIE_FLASH_CHIP_H_ */
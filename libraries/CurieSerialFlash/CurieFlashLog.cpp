@@ -0,0 +1,325 @@
+/*
+ * CurieFlashLog.cpp - circular record log on the Arduino/Genuino 101
+ * onboard SPI flash
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CurieFlashLog.h"
+#include <crc.h>
+
+#define LOG_MAGIC   0x474F4C43
+
+struct SectorHeader {
+    uint32_t magic;
+    uint32_t sectorSeq;
+    uint32_t firstSeq;      /* of the first record in the sector */
+};
+
+/* len 0xFFFF, erased flash, ends the records of a sector */
+struct RecordHeader {
+    uint16_t len;
+    uint16_t crc;           /* CRC-16/CCITT of seq and the payload */
+    uint32_t seq;
+};
+
+#define SECTOR_START    sizeof(SectorHeader)
+
+static uint16_t recordCRC(uint32_t seq, const void *data, uint16_t len)
+{
+    return crc16_ccitt(crc16_ccitt(0xFFFF, &seq, sizeof(seq)), data, len);
+}
+
+bool CurieFlashLog::begin(CurieFlashChip &flash, uint32_t start, uint32_t size, uint8_t ahead)
+{
+    SectorHeader sh;
+    uint32_t newest = 0, oldest = 0;
+    bool found = false;
+
+    if (start % CURIE_FLASH_SECTOR_SIZE || size % CURIE_FLASH_SECTOR_SIZE ||
+        size < 2 * CURIE_FLASH_SECTOR_SIZE || start + size > flash.capacity())
+        return false;
+
+    _flash = &flash;
+    _start = start;
+    _sectors = size / CURIE_FLASH_SECTOR_SIZE;
+    _ahead = ahead < _sectors - 2 ? ahead : _sectors - 2;
+    _erased = 0;
+    _bufLen = 0;
+
+    for (uint16_t s = 0; s < _sectors; s++) {
+        _flash->read(sectorAddr(s), &sh, sizeof(sh));
+        if (sh.magic != LOG_MAGIC)
+            continue;
+        if (!found || (int32_t)(sh.sectorSeq - newest) > 0) {
+            newest = sh.sectorSeq;
+            _head = s;
+        }
+        if (!found || (int32_t)(sh.sectorSeq - oldest) < 0) {
+            oldest = sh.sectorSeq;
+            _first = s;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        /* the first append starts sector 0 */
+        _empty = true;
+        _first = 0;
+        _head = _sectors - 1;
+        _offset = CURIE_FLASH_SECTOR_SIZE;
+        _sectorSeq = 0;
+        _seq = 0;
+        return true;
+    }
+
+    /* find the end of the newest sector */
+    _empty = false;
+    _flash->read(sectorAddr(_head), &sh, sizeof(sh));
+    _sectorSeq = sh.sectorSeq;
+    _seq = sh.firstSeq;
+
+    uint32_t off = SECTOR_START;
+    uint8_t data[CURIE_FLASH_LOG_MAX_RECORD];
+    while (off + sizeof(RecordHeader) <= CURIE_FLASH_SECTOR_SIZE) {
+        RecordHeader rh;
+        _flash->read(sectorAddr(_head) + off, &rh, sizeof(rh));
+        if (rh.len == 0xFFFF)
+            break;
+        if (rh.len > CURIE_FLASH_LOG_MAX_RECORD ||
+            off + sizeof(rh) + rh.len > CURIE_FLASH_SECTOR_SIZE) {
+            off = CURIE_FLASH_SECTOR_SIZE;
+            break;
+        }
+        _flash->read(sectorAddr(_head) + off + sizeof(rh), data, rh.len);
+        if (recordCRC(rh.seq, data, rh.len) == rh.crc)
+            _seq = rh.seq + 1;
+        off += sizeof(rh) + rh.len;
+    }
+    /* anything programmed past the end (a torn header) closes the sector */
+    if (off < CURIE_FLASH_SECTOR_SIZE &&
+        !erased(sectorAddr(_head) + off, CURIE_FLASH_SECTOR_SIZE - off))
+        off = CURIE_FLASH_SECTOR_SIZE;
+    _offset = off;
+    _bufAddr = sectorAddr(_head) + off;
+    return true;
+}
+
+void CurieFlashLog::format()
+{
+    if (!_flash)
+        return;
+
+    for (uint16_t s = 0; s < _sectors; s++)
+        _flash->eraseSector(sectorAddr(s));
+    _flash->wait();
+
+    _empty = true;
+    _first = 0;
+    _head = _sectors - 1;
+    _offset = CURIE_FLASH_SECTOR_SIZE;
+    _erased = _sectors - 1 < 255 ? _sectors - 1 : 255;
+    _bufLen = 0;
+    _sectorSeq = 0;
+    _seq = 0;
+}
+
+bool CurieFlashLog::erased(uint32_t addr, uint32_t len)
+{
+    uint8_t chunk[64];
+
+    while (len > 0) {
+        uint32_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        _flash->read(addr, chunk, n);
+        for (uint32_t i = 0; i < n; i++) {
+            if (chunk[i] != 0xFF)
+                return false;
+        }
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+void CurieFlashLog::queue(const void *data, uint16_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len > 0) {
+        if (_bufLen == CURIE_FLASH_LOG_BUFFER)
+            flushBuffer();
+        uint16_t n = CURIE_FLASH_LOG_BUFFER - _bufLen;
+        if (n > len)
+            n = len;
+        memcpy(_buf + _bufLen, p, n);
+        _bufLen += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void CurieFlashLog::flushBuffer()
+{
+    if (_bufLen == 0)
+        return;
+    _flash->write(_bufAddr, _buf, _bufLen);
+    _bufAddr += _bufLen;
+    _bufLen = 0;
+}
+
+/* The oldest sector is about to be erased: its records go */
+void CurieFlashLog::makeRoom(uint16_t sector)
+{
+    if (!_empty && sector == _first && sector != _head)
+        _first = nextSector(_first);
+}
+
+void CurieFlashLog::startSector()
+{
+    uint16_t sector = nextSector(_head);
+
+    flushBuffer();
+    if (_erased) {
+        _erased--;
+    } else {
+        makeRoom(sector);
+        _flash->eraseSector(sectorAddr(sector));
+    }
+    if (_empty) {
+        _first = sector;
+        _empty = false;
+    }
+    _head = sector;
+    _sectorSeq++;
+
+    SectorHeader sh = { LOG_MAGIC, _sectorSeq, _seq };
+    _bufAddr = sectorAddr(sector);
+    queue(&sh, sizeof(sh));
+    _offset = SECTOR_START;
+}
+
+bool CurieFlashLog::append(const void *data, uint16_t len)
+{
+    if (!_flash || len > CURIE_FLASH_LOG_MAX_RECORD)
+        return false;
+
+    if (_offset + sizeof(RecordHeader) + len > CURIE_FLASH_SECTOR_SIZE)
+        startSector();
+
+    RecordHeader rh = { len, recordCRC(_seq, data, len), _seq };
+    queue(&rh, sizeof(rh));
+    queue(data, len);
+    _offset += sizeof(rh) + len;
+    _seq++;
+    return true;
+}
+
+void CurieFlashLog::poll()
+{
+    if (!_flash || !_flash->ready())
+        return;
+
+    if (_bufLen) {
+        flushBuffer();
+        return;
+    }
+    if (_erased < _ahead) {
+        uint16_t sector = _head;
+        for (uint8_t i = 0; i <= _erased; i++)
+            sector = nextSector(sector);
+        if (sector == _head)
+            return;
+        makeRoom(sector);
+        _flash->eraseSector(sectorAddr(sector));
+        _erased++;
+    }
+}
+
+void CurieFlashLog::flush()
+{
+    if (!_flash)
+        return;
+    flushBuffer();
+    _flash->wait();
+}
+
+uint32_t CurieFlashLog::firstSeq()
+{
+    SectorHeader sh;
+
+    if (!_flash || _empty)
+        return _seq;
+    flushBuffer();
+    _flash->read(sectorAddr(_first), &sh, sizeof(sh));
+    return sh.magic == LOG_MAGIC ? sh.firstSeq : _seq;
+}
+
+uint32_t CurieFlashLog::read(CurieFlashLogCallback callback, void *arg, uint32_t fromSeq)
+{
+    uint8_t data[CURIE_FLASH_LOG_MAX_RECORD];
+    uint32_t count = 0;
+
+    if (!_flash || _empty)
+        return 0;
+    flushBuffer();
+
+    for (uint16_t s = _first; ; s = nextSector(s)) {
+        SectorHeader sh;
+        _flash->read(sectorAddr(s), &sh, sizeof(sh));
+
+        uint32_t off = SECTOR_START;
+        while (sh.magic == LOG_MAGIC && off + sizeof(RecordHeader) <= CURIE_FLASH_SECTOR_SIZE) {
+            RecordHeader rh;
+            _flash->read(sectorAddr(s) + off, &rh, sizeof(rh));
+            if (rh.len > CURIE_FLASH_LOG_MAX_RECORD ||
+                off + sizeof(rh) + rh.len > CURIE_FLASH_SECTOR_SIZE)
+                break;
+            if ((int32_t)(rh.seq - fromSeq) >= 0) {
+                _flash->read(sectorAddr(s) + off + sizeof(rh), data, rh.len);
+                if (recordCRC(rh.seq, data, rh.len) == rh.crc) {
+                    callback(data, rh.len, rh.seq, arg);
+                    count++;
+                }
+            }
+            off += sizeof(rh) + rh.len;
+        }
+        if (s == _head)
+            break;
+    }
+    return count;
+}
+
+struct WriteTo {
+    Print *out;
+    uint32_t bytes;
+};
+
+static void writeRecord(const uint8_t *data, uint16_t len, uint32_t seq, void *arg)
+{
+    WriteTo *w = (WriteTo *)arg;
+
+    w->bytes += w->out->write(data, len);
+    (void)seq;
+}
+
+uint32_t CurieFlashLog::writeTo(Print &out, uint32_t fromSeq)
+{
+    WriteTo w = { &out, 0 };
+
+    read(writeRecord, &w, fromSeq);
+    return w.bytes;
+}
@@ -0,0 +1,111 @@
+/*
+ * CurieFlashLog.h - circular record log on the Arduino/Genuino 101
+ * onboard SPI flash
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CURIE_FLASH_LOG_H_
+#define _CURIE_FLASH_LOG_H_
+
+#include "CurieFlashChip.h"
+
+/* Records are appended to an area of whole 4 KB sectors used as a ring:
+ * each sector starts with a header holding its sequence number and that
+ * of its first record, and each record carries its length, a CRC-16 and
+ * its own sequence number. When the ring is full the oldest sector is
+ * erased and its records are lost.
+ *
+ * Appends are gathered in RAM and programmed a burst at a time; poll(),
+ * called from loop(), programs what is waiting and erases the sectors
+ * ahead of the write position while the chip is otherwise idle, so an
+ * append seldom waits for an erase. begin() finds the newest sector from
+ * the headers and the end of the log within it, stepping over a record
+ * cut short by a reset. */
+
+#define CURIE_FLASH_LOG_MAX_RECORD  248     /* payload bytes */
+
+/* RAM gathering appends; a multiple of CURIE_FLASH_PAGE_SIZE */
+#ifndef CURIE_FLASH_LOG_BUFFER
+#define CURIE_FLASH_LOG_BUFFER      256
+#endif
+
+/* Called by read() for each record, oldest first */
+typedef void (*CurieFlashLogCallback)(const uint8_t *data, uint16_t len, uint32_t seq, void *arg);
+
+class CurieFlashLog {
+public:
+  CurieFlashLog() : _flash(NULL), _sectors(0) {}
+
+  /* Uses size bytes from start, both multiples of CURIE_FLASH_SECTOR_SIZE
+   * and at least two sectors, and recovers the log found there; ahead is
+   * the number of sectors poll() keeps erased past the write position */
+  bool begin(CurieFlashChip &flash, uint32_t start, uint32_t size, uint8_t ahead = 1);
+
+  /* Erases the whole area */
+  void format();
+
+  /* Queues a record; false if len is over CURIE_FLASH_LOG_MAX_RECORD.
+   * Waits only when the RAM buffer is full and the chip is busy. */
+  bool append(const void *data, uint16_t len);
+
+  /* Programs queued records and erases ahead when the chip is idle;
+   * call it often */
+  void poll();
+
+  /* Programs everything queued and waits for it */
+  void flush();
+
+  /* Calls callback for each intact record with a sequence number of at
+   * least fromSeq, oldest first; returns how many */
+  uint32_t read(CurieFlashLogCallback callback, void *arg, uint32_t fromSeq = 0);
+
+  /* Streams the payloads of those records back to back, e.g. to Serial
+   * or a BLE characteristic wrapper; returns the bytes written */
+  uint32_t writeTo(Print &out, uint32_t fromSeq = 0);
+
+  /* Sequence number the next append gets; those below it and at least
+   * firstSeq() are in the log */
+  uint32_t nextSeq() { return _seq; }
+  uint32_t firstSeq();
+
+private:
+  uint32_t sectorAddr(uint16_t sector) { return _start + (uint32_t)sector * CURIE_FLASH_SECTOR_SIZE; }
+  uint16_t nextSector(uint16_t sector) { return sector + 1 < _sectors ? sector + 1 : 0; }
+  void queue(const void *data, uint16_t len);
+  void flushBuffer();
+  void startSector();
+  void makeRoom(uint16_t sector);
+  bool erased(uint32_t addr, uint32_t len);
+
+  CurieFlashChip *_flash;
+  uint32_t _start;
+  uint16_t _sectors;
+  uint8_t _ahead;
+  uint16_t _first;            /* oldest sector with records */
+  uint16_t _head;             /* sector being written */
+  uint16_t _offset;           /* in _head, including what is queued */
+  uint8_t _erased;            /* sectors after _head erased (or erasing) */
+  bool _empty;
+  uint32_t _sectorSeq;
+  uint32_t _seq;
+  uint32_t _bufAddr;          /* flash address of _buf[0] */
+  uint16_t _bufLen;
+  uint8_t _buf[CURIE_FLASH_LOG_BUFFER];
+};
+
+#endif /* _CURIE_FLASH_LOG_H_ */
@@ -0,0 +1,127 @@
+/*
+ * CurieFlashStream.cpp - sequential read-ahead from the Arduino/Genuino
+ * 101 onboard SPI flash
+ *
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CurieFlashStream.h"
+
+void CurieFlashStream::begin(CurieFlashChip &flash, uint32_t addr, uint32_t len)
+{
+    end();
+    _flash = &flash;
+    _fetchAddr = addr;
+    _fetchLeft = len;
+    _left = len;
+    pump();
+}
+
+void CurieFlashStream::end()
+{
+    if (_flash) {
+        while (_flash->readBusy())
+            ;
+    }
+    _left = 0;
+    _fetchLeft = 0;
+    _cur = 0;
+    _pos = 0;
+    _state[0] = _state[1] = CHUNK_EMPTY;
+}
+
+void CurieFlashStream::fill(uint8_t chunk)
+{
+    uint32_t n = _fetchLeft < CURIE_FLASH_STREAM_CHUNK ?
+                 _fetchLeft : CURIE_FLASH_STREAM_CHUNK;
+
+    _flash->readAsync(_fetchAddr, _buf[chunk], n);
+    _len[chunk] = n;
+    _state[chunk] = CHUNK_FILLING;
+    _fetchAddr += n;
+    _fetchLeft -= n;
+}
+
+/* Takes in a finished fetch and starts the next; one is in flight at a
+ * time, so an idle bus means it is done */
+void CurieFlashStream::pump()
+{
+    uint8_t other = _cur ^ 1;
+
+    if (_flash->readBusy())
+        return;
+    for (int i = 0; i < 2; i++) {
+        if (_state[i] == CHUNK_FILLING)
+            _state[i] = CHUNK_FULL;
+    }
+    if (_fetchLeft == 0)
+        return;
+    if (_state[_cur] == CHUNK_EMPTY)
+        fill(_cur);
+    else if (_state[other] == CHUNK_EMPTY)
+        fill(other);
+}
+
+uint32_t CurieFlashStream::read(void *buf, uint32_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+    uint32_t done = 0;
+
+    if (!_flash)
+        return 0;
+
+    while (len > 0) {
+        pump();
+        if (_state[_cur] == CHUNK_FILLING)
+            continue;
+        if (_state[_cur] == CHUNK_EMPTY)
+            break;
+
+        uint32_t n = _len[_cur] - _pos;
+        if (n > len)
+            n = len;
+        memcpy(p, _buf[_cur] + CURIE_FLASH_ASYNC_HEADER + _pos, n);
+        _pos += n;
+        p += n;
+        len -= n;
+        done += n;
+        if (_pos == _len[_cur]) {
+            _state[_cur] = CHUNK_EMPTY;
+            _cur ^= 1;
+            _pos = 0;
+        }
+    }
+    _left -= done;
+    pump();
+    return done;
+}
+
+uint32_t CurieFlashStream::available()
+{
+    uint32_t n = 0;
+
+    if (!_flash)
+        return 0;
+    pump();
+    if (_state[_cur] == CHUNK_FULL) {
+        n = _len[_cur] - _pos;
+        if (_state[_cur ^ 1] == CHUNK_FULL)
+            n += _len[_cur ^ 1];
+    }
+    return n;
+}
@@ -0,0 +1,76 @@
+/*
+ * CurieFlashStream.h - sequential read-ahead from the Arduino/Genuino 101
+ * onboard SPI flash
+ *
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CURIE_FLASH_STREAM_H_
+#define _CURIE_FLASH_STREAM_H_
+
+#include "CurieFlashChip.h"
+
+/* Reads an area of the chip front to back, for playing a clip into a
+ * CurieI2SDMA buffer and the like. Two chunk buffers take turns: while
+ * read() copies out of one, the next chunk is coming into the other by
+ * CurieFlashChip::readAsync(), so read() only waits when it catches up
+ * with the bus. Only one stream should be open at a time, and the chip
+ * shouldn't be programmed or erased in the area while it is. */
+
+#ifndef CURIE_FLASH_STREAM_CHUNK
+#define CURIE_FLASH_STREAM_CHUNK  512
+#endif
+
+class CurieFlashStream {
+public:
+  CurieFlashStream() : _flash(NULL) {}
+
+  /* Starts fetching len bytes from addr */
+  void begin(CurieFlashChip &flash, uint32_t addr, uint32_t len);
+
+  /* Copies up to len bytes out, waiting for the bus if need be; returns
+   * how many, 0 at the end */
+  uint32_t read(void *buf, uint32_t len);
+
+  /* Bytes read() can return without waiting */
+  uint32_t available();
+
+  /* Bytes left to read */
+  uint32_t remaining() { return _left; }
+
+  /* Drops the rest, once the fetch in flight is done */
+  void end();
+
+private:
+  enum { CHUNK_EMPTY, CHUNK_FILLING, CHUNK_FULL };
+
+  void pump();
+  void fill(uint8_t chunk);
+
+  CurieFlashChip *_flash;
+  uint32_t _fetchAddr;
+  uint32_t _fetchLeft;
+  uint32_t _left;
+  uint8_t _cur;                 /* the chunk read() copies from */
+  uint16_t _pos;                /* in _cur */
+  uint8_t _state[2];
+  uint16_t _len[2];
+  uint8_t _buf[2][CURIE_FLASH_ASYNC_HEADER + CURIE_FLASH_STREAM_CHUNK];
+};
+
+#endif /* _CURIE_FLASH_STREAM_H_ */
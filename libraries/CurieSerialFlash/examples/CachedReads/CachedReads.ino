@@ -0,0 +1,63 @@
+// Times random small reads of a table on the onboard flash, straight from
+// the chip and through CurieFlashCache, then a sequential read of the
+// same area through CurieFlashStream. Only reads the last 64 KB block.
+
+#include <CurieFlashCache.h>
+#include <CurieFlashStream.h>
+
+CurieFlashChip flash;
+CurieFlashCache cache;
+CurieFlashStream stream;
+
+// a 2 KB table, so it fits in the cache
+const uint32_t tableBytes = 2048;
+const int lookups = 1000;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) ;
+
+  if (!flash.begin()) {
+    Serial.println("No flash chip found");
+    return;
+  }
+  cache.begin(flash);
+  uint32_t table = flash.capacity() - CURIE_FLASH_BLOCK_SIZE;
+  uint32_t value, sum = 0;
+
+  randomSeed(1);
+  unsigned long start = micros();
+  for (int i = 0; i < lookups; i++)
+    flash.read(table + random(tableBytes / 4) * 4, &value, 4);
+  Serial.print("Direct: ");
+  Serial.print((micros() - start) / lookups);
+  Serial.println(" us per lookup");
+
+  randomSeed(1);
+  start = micros();
+  for (int i = 0; i < lookups; i++)
+    cache.read(table + random(tableBytes / 4) * 4, &value, 4);
+  Serial.print("Cached: ");
+  Serial.print((micros() - start) / lookups);
+  Serial.print(" us per lookup, ");
+  Serial.print(cache.hits());
+  Serial.print(" hits, ");
+  Serial.print(cache.misses());
+  Serial.println(" misses");
+
+  uint8_t buf[256];
+  uint32_t n;
+  start = micros();
+  stream.begin(flash, table, CURIE_FLASH_BLOCK_SIZE);
+  while ((n = stream.read(buf, sizeof(buf))) > 0)
+    sum += buf[0];
+  unsigned long us = micros() - start;
+  Serial.print("Streamed 64 KB in ");
+  Serial.print(us);
+  Serial.print(" us (");
+  Serial.print(CURIE_FLASH_BLOCK_SIZE * 1000UL / us);
+  Serial.println(" KB/s)");
+}
+
+void loop() {
+}
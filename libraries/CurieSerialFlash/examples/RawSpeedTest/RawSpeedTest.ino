@@ -0,0 +1,59 @@
+// Times raw writes and reads of the onboard flash through CurieFlashChip,
+// which moves whole pages per SPI burst (reads by DMA) rather than a byte
+// per SPI.transfer(). The last 64 KB block of the chip is erased and
+// overwritten; keep SerialFlash files out of it.
+
+#include <CurieFlashChip.h>
+
+CurieFlashChip flash;
+
+const uint32_t testBytes = 16384;
+uint8_t buf[4096];
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) ;
+
+  if (!flash.begin()) {
+    Serial.println("No flash chip found");
+    return;
+  }
+  uint32_t area = flash.capacity() - CURIE_FLASH_BLOCK_SIZE;
+  Serial.print("Capacity: ");
+  Serial.println(flash.capacity());
+
+  unsigned long start = millis();
+  flash.eraseBlock(area);
+  flash.wait();
+  Serial.print("64 KB erase: ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+
+  for (uint32_t i = 0; i < sizeof(buf); i++)
+    buf[i] = i * 7;
+
+  start = micros();
+  for (uint32_t off = 0; off < testBytes; off += sizeof(buf))
+    flash.write(area + off, buf, sizeof(buf));
+  flash.wait();
+  unsigned long us = micros() - start;
+  Serial.print("Write: ");
+  Serial.print(testBytes * 1000.0 / us);
+  Serial.println(" KB/s");
+
+  bool ok = true;
+  start = micros();
+  for (uint32_t off = 0; off < testBytes; off += sizeof(buf)) {
+    flash.read(area + off, buf, sizeof(buf));
+    for (uint32_t i = 0; i < sizeof(buf); i++)
+      ok &= buf[i] == (uint8_t)(i * 7);
+  }
+  us = micros() - start;
+  Serial.print("Read and check: ");
+  Serial.print(testBytes * 1000.0 / us);
+  Serial.println(" KB/s");
+  Serial.println(ok ? "Data verified" : "Data mismatch");
+}
+
+void loop() {
+}
@@ -0,0 +1,70 @@
+// Logs an analog reading with a timestamp every 100 ms to a circular log
+// in the last 64 KB block of the onboard flash, and sends the whole log
+// to the Serial Monitor when 'd' is typed; 'f' formats the log. The log
+// survives a reset or power loss. Keep SerialFlash files out of the block.
+
+#include <CurieFlashLog.h>
+
+CurieFlashChip flash;
+CurieFlashLog flashLog;
+
+struct Sample {
+  uint32_t ms;
+  uint16_t value;
+};
+
+unsigned long last;
+
+void printSample(const uint8_t *data, uint16_t len, uint32_t seq, void *arg) {
+  Sample s;
+
+  if (len != sizeof(s))
+    return;
+  memcpy(&s, data, sizeof(s));
+  Serial.print(seq);
+  Serial.print(',');
+  Serial.print(s.ms);
+  Serial.print(',');
+  Serial.println(s.value);
+}
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) ;
+
+  if (!flash.begin()) {
+    Serial.println("No flash chip found");
+    while (1) ;
+  }
+  uint32_t area = flash.capacity() - CURIE_FLASH_BLOCK_SIZE;
+  if (!flashLog.begin(flash, area, CURIE_FLASH_BLOCK_SIZE, 2)) {
+    Serial.println("Bad log area");
+    while (1) ;
+  }
+  Serial.print("Records ");
+  Serial.print(flashLog.firstSeq());
+  Serial.print(" to ");
+  Serial.println(flashLog.nextSeq());
+}
+
+void loop() {
+  if (millis() - last >= 100) {
+    last = millis();
+    Sample s = { last, (uint16_t)analogRead(A0) };
+    flashLog.append(&s, sizeof(s));
+  }
+
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'd') {
+      Serial.println("seq,ms,value");
+      flashLog.read(printSample, NULL);
+    } else if (c == 'f') {
+      flashLog.format();
+      Serial.println("Formatted");
+    }
+  }
+
+  // programs queued records and erases ahead while the chip is idle
+  flashLog.poll();
+}
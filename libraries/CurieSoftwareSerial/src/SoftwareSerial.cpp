@@ -37,9 +37,19 @@ Rx does not work for pin 13
 // Statics
 //
 SoftwareSerial *SoftwareSerial::active_object = 0;
-char *SoftwareSerial::_receive_buffer;
-volatile uint8_t SoftwareSerial::_receive_buffer_tail = 0;
-volatile uint8_t SoftwareSerial::_receive_buffer_head = 0;
+SoftwareSerial *SoftwareSerial::edge_ports[_SS_MAX_EDGE_PORTS];
+
+// attachInterruptFast() handlers carry no argument, so each listening
+// SS_RX_EDGES port gets a vector of its own
+template <int N>
+void SoftwareSerial::edgeVector(uint32_t cycles)
+{
+  edge_ports[N]->edgeRecv(cycles);
+}
+
+const fastInterruptHandler SoftwareSerial::edge_vectors[_SS_MAX_EDGE_PORTS] = {
+  edgeVector<0>, edgeVector<1>, edgeVector<2>, edgeVector<3>
+};
 
 static uint8_t _rxPin;
 static uint16_t bitDelay;
@@ -49,7 +59,6 @@ static int initRxIntraBitDelay;
 static int firstIntraBitDelay;
 static int initRxCenteringDelay;
 static bool firstStartBit = true;
-static bool bufferOverflow = true;
 static bool invertedLogic = false;
 static bool isSOCGpio = false;
 
@@ -81,12 +90,15 @@ inline void SoftwareSerial::tunedDelay(uint16_t delay)
 // one and returns true if it replaces another 
 bool SoftwareSerial::listen()
 {
+  if (_rx_mode == SS_RX_EDGES)
+    return listenEdges();
+
   if (active_object != this)
   {
     if (active_object)
       active_object->stopListening();
 
-    bufferOverflow = false;
+    _buffer_overflow = false;
     _receive_buffer_head = _receive_buffer_tail = 0;
     active_object = this;
     _rxPin = _receivePin;
@@ -112,9 +124,56 @@ bool SoftwareSerial::listen()
   return false;
 }
 
+// SS_RX_EDGES: takes a free edge vector, leaving the other ports alone.
+// Returns false if already listening or all the vectors are taken.
+bool SoftwareSerial::listenEdges()
+{
+  if (_edge_slot >= 0)
+    return false;
+
+  int8_t slot = 0;
+  while (slot < _SS_MAX_EDGE_PORTS && edge_ports[slot])
+    slot++;
+  if (slot == _SS_MAX_EDGE_PORTS)
+    return false;
+
+  PinDescription *p = &g_APinDescription[_receivePin];
+  _buffer_overflow = false;
+  _receive_buffer_head = _receive_buffer_tail = 0;
+  fastPinInit(&_rx_fast_pin, _receivePin);
+  _rx_bit = -1;
+  _rx_level = 1;
+  _rx_polarity_reg = 0;
+  // The SS GPIOs can't interrupt on both edges; the handler turns the
+  // polarity round after each one instead
+  if (p->ulGPIOType == SS_GPIO)
+  {
+    _rx_polarity_reg = p->ulGPIOBase + SS_GPIO_INT_POLARITY;
+    _rx_polarity_mask = 1 << p->ulGPIOId;
+  }
+  edge_ports[slot] = this;
+  _edge_slot = slot;
+  attachInterruptFast(_receivePin, edge_vectors[slot], CHANGE);
+  if (_rx_polarity_reg)
+  {
+    if (fastPinRead(&_rx_fast_pin))
+      WRITE_ARC_REG(READ_ARC_REG(_rx_polarity_reg) & ~_rx_polarity_mask, _rx_polarity_reg);
+    else
+      WRITE_ARC_REG(READ_ARC_REG(_rx_polarity_reg) | _rx_polarity_mask, _rx_polarity_reg);
+  }
+  return true;
+}
+
 // Stop listening. Returns true if we were actually listening.
 bool SoftwareSerial::stopListening()
 {
+  if (_edge_slot >= 0)
+  {
+    detachInterrupt(_receivePin);
+    edge_ports[_edge_slot] = NULL;
+    _edge_slot = -1;
+    return true;
+  }
   if (active_object == this)
   {
     active_object = NULL;
@@ -129,7 +188,7 @@ bool SoftwareSerial::stopListening()
 //
 void SoftwareSerial::recv()
 {
-  noInterrupts();
+  uint32_t flags = interrupt_lock();
   uint8_t d = 0;
   // If RX line is high, then we don't see any start bit
   // so interrupt is probably not for us
@@ -172,18 +231,8 @@ void SoftwareSerial::recv()
     if (invertedLogic)
       d = ~d;
 
-    uint8_t next = (_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF;
-    if (next != _receive_buffer_head)
-    {
-      // save new data in buffer: tail points to where byte goes
-      _receive_buffer[_receive_buffer_tail] = d; // save new byte
-      _receive_buffer_tail = next;
-    } 
-    else 
-    {
-      DebugPulse(_DEBUG_PIN1, 1);
-      bufferOverflow = true;
-    }
+    if (active_object)
+      active_object->store(d);
 
     // wait until we see a stop bit/s or timeout;
     uint8_t loopTimeout = 32;
@@ -205,7 +254,98 @@ void SoftwareSerial::recv()
     }
     DebugPulse(_DEBUG_PIN1, 1);
   }
-  interrupts();
+  interrupt_unlock(flags);
+}
+
+void SoftwareSerial::store(uint8_t d)
+{
+  uint16_t next = (_receive_buffer_tail + 1) % _receive_buffer_size;
+  if (next != _receive_buffer_head)
+  {
+    // save new data in buffer: tail points to where byte goes
+    _receive_buffer[_receive_buffer_tail] = d; // save new byte
+    _receive_buffer_tail = next;
+  } 
+  else 
+  {
+    DebugPulse(_DEBUG_PIN1, 1);
+    _buffer_overflow = true;
+  }
+}
+
+//
+// SS_RX_EDGES: the line held _rx_level from the last edge until now, so
+// every bit whose centre has passed since is _rx_level. Called with
+// interrupts masked.
+//
+void SoftwareSerial::decode(uint32_t now)
+{
+  while (_rx_bit >= 0 && (int32_t)(now - _rx_sample_at) >= 0)
+  {
+    if (_rx_bit == 0)
+    {
+      // a glitch rather than a start bit
+      if (_rx_level)
+      {
+        _rx_bit = -1;
+        return;
+      }
+    }
+    else if (_rx_bit <= 8)
+    {
+      _rx_data = (_rx_data >> 1) | (_rx_level << 7);
+    }
+    else
+    {
+      // a space for the stop bit is a framing error; drop the byte
+      if (_rx_level)
+        store(_rx_data);
+      _rx_bit = -1;
+      return;
+    }
+    _rx_bit++;
+    _rx_sample_at += _bit_delay;
+  }
+}
+
+// Called from this port's GPIO vector for every edge, with cycles() at
+// its entry
+void SoftwareSerial::edgeRecv(uint32_t cycles)
+{
+  uint8_t level = fastPinRead(&_rx_fast_pin) ? 1 : 0;
+
+  if (_rx_polarity_reg)
+  {
+    // wait for the opposite edge next
+    if (level)
+      WRITE_ARC_REG(READ_ARC_REG(_rx_polarity_reg) & ~_rx_polarity_mask, _rx_polarity_reg);
+    else
+      WRITE_ARC_REG(READ_ARC_REG(_rx_polarity_reg) | _rx_polarity_mask, _rx_polarity_reg);
+  }
+  if (_inverse_logic)
+    level ^= 1;
+  if (level == _rx_level)
+    return;
+
+  decode(cycles);
+  _rx_level = level;
+  if (_rx_bit < 0 && level == 0)
+  {
+    // a start bit: sample each bit at its centre
+    _rx_bit = 0;
+    _rx_data = 0;
+    _rx_sample_at = cycles + _bit_delay / 2;
+  }
+}
+
+// Finishes a frame whose last edge has gone by
+void SoftwareSerial::pollEdges()
+{
+  if (_edge_slot < 0 || _rx_bit < 0)
+    return;
+  uint32_t flags = interrupt_lock();
+  decode(cycles());
+  interrupt_unlock(flags);
 }
 
 uint32_t SoftwareSerial::rx_pin_read()
@@ -217,20 +357,39 @@ uint32_t SoftwareSerial::rx_pin_read()
 //
 // Constructor
 //
-SoftwareSerial::SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic /* = false */) : 
+SoftwareSerial::SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic /* = false */,
+                               uint16_t rxBufferSize /* = _SS_MAX_RX_BUFF */) : 
   _rx_delay_centering(0),
   _rx_delay_intrabit(0),
   _rx_delay_stopbit(0),
   _tx_delay(0),
   _buffer_overflow(false),
-  _inverse_logic(inverse_logic)
+  _inverse_logic(inverse_logic),
+  _rx_mode(SS_RX_SAMPLED),
+  _tx_timer_mode(false),
+  _tx_bits(0),
+  _tx_head(0),
+  _tx_tail(0),
+  _receive_buffer_size(rxBufferSize < 2 ? 2 : rxBufferSize),
+  _receive_buffer_heap(false),
+  _receive_buffer_tail(0),
+  _receive_buffer_head(0),
+  _edge_slot(-1),
+  _rx_bit(-1)
 {
   _inverse_logic = inverse_logic;
   setTX(transmitPin);
   _transmitPin = transmitPin;
   setRX(receivePin);
   _receivePin = receivePin;
-  _receive_buffer = (char*)dccm_malloc(_SS_MAX_RX_BUFF);
+  _receive_buffer = (char*)dccm_malloc(_receive_buffer_size);
+  if (!_receive_buffer)
+  {
+    // DCCM is full; normal RAM will do
+    _receive_buffer = (char*)malloc(_receive_buffer_size);
+    _receive_buffer_heap = true;
+  }
+  hwtimerInit(&_tx_timer, txTick, this);
 }
 
 //
@@ -239,6 +398,10 @@ SoftwareSerial::SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool i
 SoftwareSerial::~SoftwareSerial()
 {
   end();
+  if (_receive_buffer_heap)
+    free(_receive_buffer);
+  else
+    dccm_free(_receive_buffer);
 }
 
 void SoftwareSerial::setTX(uint8_t tx)
@@ -270,8 +433,12 @@ uint16_t SoftwareSerial::subtract_cap(uint16_t num, uint16_t sub) {
 // Public methods
 //
 
-void SoftwareSerial::begin(long speed)
+void SoftwareSerial::begin(long speed, uint8_t mode)
 {
+  _rx_mode = mode & SS_RX_EDGES;
+  _tx_timer_mode = mode & SS_TX_TIMER;
+  if (_tx_timer_mode)
+    fastPinInit(&_tx_pin, _transmitPin);
   _rx_delay_centering = _rx_delay_intrabit = _rx_delay_stopbit = _tx_delay = 0;
   //pre-calculate delays
   _bit_delay = (F_CPU/speed);
@@ -320,6 +487,9 @@ void SoftwareSerial::begin(long speed)
 
 void SoftwareSerial::end()
 {
+  // let the TX buffer drain
+  while (hwtimerActive(&_tx_timer))
+    ;
   stopListening();
 }
 
@@ -330,13 +500,15 @@ int SoftwareSerial::read()
   if (!isListening())
     return -1;
 
+  pollEdges();
+
   // Empty buffer?
   if (_receive_buffer_head == _receive_buffer_tail)
     return -1;
 
   // Read from "head"
   uint8_t d = _receive_buffer[_receive_buffer_head]; // grab next byte
-  _receive_buffer_head = (_receive_buffer_head + 1) % _SS_MAX_RX_BUFF;
+  _receive_buffer_head = (_receive_buffer_head + 1) % _receive_buffer_size;
   return d;
 }
 
@@ -345,7 +517,42 @@ int SoftwareSerial::available()
   if (!isListening())
     return -1;
 
-  return (_receive_buffer_tail + _SS_MAX_RX_BUFF - _receive_buffer_head) % _SS_MAX_RX_BUFF;
+  pollEdges();
+  return (_receive_buffer_tail + _receive_buffer_size - _receive_buffer_head) % _receive_buffer_size;
+}
+
+//
+// SS_TX_TIMER: called by the hwtimer once a bit time
+//
+void SoftwareSerial::txTick(void *arg)
+{
+  SoftwareSerial *ss = (SoftwareSerial *)arg;
+
+  if (ss->_tx_bits == 0)
+  {
+    if (ss->_tx_head == ss->_tx_tail)
+    {
+      // the stop bit has had its time; idle
+      hwtimerStop(&ss->_tx_timer);
+      return;
+    }
+    // start bit, data lowest first, stop bit
+    ss->_tx_frame = (ss->_tx_buffer[ss->_tx_head] << 1) | 0x200;
+    ss->_tx_head = (ss->_tx_head + 1) % _SS_MAX_TX_BUFF;
+    ss->_tx_bits = 10;
+  }
+  uint8_t level = ss->_tx_frame & 1;
+  ss->_tx_frame >>= 1;
+  ss->_tx_bits--;
+  fastPinWrite(&ss->_tx_pin, ss->_inverse_logic ? !level : level);
+}
+
+int SoftwareSerial::availableForWrite()
+{
+  // bit-banged writes wait for their own bits, however many there are
+  if (!_tx_timer_mode)
+    return -1;
+  return (_tx_head + _SS_MAX_TX_BUFF - _tx_tail - 1) % _SS_MAX_TX_BUFF;
 }
 
 size_t SoftwareSerial::write(uint8_t b)
@@ -354,6 +561,35 @@ size_t SoftwareSerial::write(uint8_t b)
     setWriteError();
     return 0;
   }
+  if (!_tx_timer_mode)
+    return writeBlocking(b);
+
+  uint8_t next = (_tx_tail + 1) % _SS_MAX_TX_BUFF;
+  // a full buffer has to wait for the timer to take a byte
+  while (next == _tx_head)
+    ;
+
+  uint32_t flags = interrupt_lock();
+  _tx_buffer[_tx_tail] = b;
+  _tx_tail = next;
+  if (!hwtimerActive(&_tx_timer) &&
+      hwtimerStart(&_tx_timer, 1, _bit_delay) < 0)
+  {
+    // no timer free: send what is queued the old way
+    interrupt_unlock(flags);
+    while (_tx_head != _tx_tail)
+    {
+      writeBlocking(_tx_buffer[_tx_head]);
+      _tx_head = (_tx_head + 1) % _SS_MAX_TX_BUFF;
+    }
+    return 1;
+  }
+  interrupt_unlock(flags);
+  return 1;
+}
+
+size_t SoftwareSerial::writeBlocking(uint8_t b)
+{
   
   // By declaring these as local variables, the compiler will put them
   // in registers _before_ disabling interrupts and entering the
@@ -402,9 +638,9 @@ void SoftwareSerial::flush()
   if (!isListening())
     return;
 
-  noInterrupts();
+  uint32_t flags = interrupt_lock();
   _receive_buffer_head = _receive_buffer_tail = 0;
-  interrupts();
+  interrupt_unlock(flags);
 }
 
 int SoftwareSerial::peek()
@@ -412,6 +648,8 @@ int SoftwareSerial::peek()
   if (!isListening())
     return -1;
 
+  pollEdges();
+
   // Empty buffer?
   if (_receive_buffer_head == _receive_buffer_tail)
     return -1;
@@ -28,11 +28,37 @@ Rx does not work for pin 13
 #include <inttypes.h>
 #include <Stream.h>
 #include <Arduino.h>
+#include <hwtimer.h>
 /******************************************************************************
 * Definitions
 ******************************************************************************/
 
-#define _SS_MAX_RX_BUFF 64 // RX buffer size
+#define _SS_MAX_RX_BUFF 64 // default RX buffer size
+#define _SS_MAX_EDGE_PORTS 4 // SS_RX_EDGES ports that can listen at once
+#define _SS_MAX_TX_BUFF 64 // TX buffer size, SS_TX_TIMER only
+
+// Modes for begin(), an RX mode or'ed with a TX mode
+// SS_RX_SAMPLED: the start bit interrupt samples the whole byte with
+//   interrupts masked, about a millisecond per byte at 9600 bps; one
+//   such port listens at a time
+// SS_RX_EDGES: every edge of the line is timestamped from the GPIO vector
+//   and the bytes are rebuilt from the timestamps, with interrupts masked
+//   only for the few microseconds of each edge. The last byte of a burst
+//   is complete once its frame time has passed and read(), available() or
+//   peek() is called. Up to _SS_MAX_EDGE_PORTS such ports listen at
+//   once, each into its own buffer, and listen() on one doesn't stop
+//   the others.
+// SS_TX_BLOCKING: write() bit-bangs the byte with interrupts masked
+// SS_TX_TIMER: write() puts the byte in a TX buffer and returns; a
+//   periodic hwtimer (timer1, shared with tone(), Servo and the rest)
+//   sends a bit per tick from its interrupt. Each instance has its own
+//   timer, so several can transmit at once. Anything that masks
+//   interrupts for a bit time skews the bits, SS_RX_SAMPLED reception
+//   included, so pair it with SS_RX_EDGES.
+#define SS_RX_SAMPLED  0
+#define SS_RX_EDGES    1
+#define SS_TX_BLOCKING 0
+#define SS_TX_TIMER    2
 
 class SoftwareSerial : public Stream
 {
@@ -54,15 +80,50 @@ private:
 
   uint32_t _buffer_overflow:1;
   bool _inverse_logic = false;
+  uint8_t _rx_mode;
+
+  // SS_TX_TIMER
+  bool _tx_timer_mode;
+  hwtimer_t _tx_timer;
+  FastPin _tx_pin;
+  volatile uint16_t _tx_frame;  // bits still to send, lowest first
+  volatile uint8_t _tx_bits;
+  volatile uint8_t _tx_head;
+  volatile uint8_t _tx_tail;
+  uint8_t _tx_buffer[_SS_MAX_TX_BUFF];
+
+  // RX buffer
+  char *_receive_buffer;
+  uint16_t _receive_buffer_size;
+  bool _receive_buffer_heap;    // from malloc() rather than DCCM
+  volatile uint16_t _receive_buffer_tail;
+  volatile uint16_t _receive_buffer_head;
+
+  // SS_RX_EDGES decoder, run from this port's edge vector
+  int8_t _edge_slot;            // in edge_ports, -1 when not listening
+  FastPin _rx_fast_pin;
+  uint32_t _rx_polarity_reg;    // SS_GPIO INT_POLARITY aux register, or 0
+  uint32_t _rx_polarity_mask;
+  volatile int8_t _rx_bit;      // next bit of the frame to sample, -1 when idle
+  volatile uint32_t _rx_sample_at; // cycles() at the centre of that bit
+  volatile uint8_t _rx_level;   // line level since the last edge, 1 = mark
+  volatile uint8_t _rx_data;
 
   // static data
-  static char *_receive_buffer;
-  static volatile uint8_t _receive_buffer_tail;
-  static volatile uint8_t _receive_buffer_head;
-  static SoftwareSerial *active_object;
+  static SoftwareSerial *active_object;   // the SS_RX_SAMPLED listener
+  static SoftwareSerial *edge_ports[_SS_MAX_EDGE_PORTS];
+  static const fastInterruptHandler edge_vectors[_SS_MAX_EDGE_PORTS];
 
   // private methods
   static void recv();
+  template <int N> static void edgeVector(uint32_t cycles);
+  void edgeRecv(uint32_t cycles);
+  void decode(uint32_t now);
+  void pollEdges();
+  void store(uint8_t d);
+  bool listenEdges();
+  static void txTick(void *arg);
+  size_t writeBlocking(uint8_t byte);
   uint32_t rx_pin_read();
   void tx_pin_write(uint32_t pin_state) __attribute__((__always_inline__));
   void setTX(uint8_t transmitPin);
@@ -76,17 +137,19 @@ private:
 
 public:
   // public methods
-  SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic = false);
+  SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic = false,
+                 uint16_t rxBufferSize = _SS_MAX_RX_BUFF);
   virtual ~SoftwareSerial();
-  void begin(long speed);
+  void begin(long speed, uint8_t mode = SS_RX_SAMPLED | SS_TX_BLOCKING);
   bool listen();
   void end();
-  bool isListening() { return this == active_object; }
+  bool isListening() { return this == active_object || _edge_slot >= 0; }
   bool stopListening();
   bool overflow() { bool ret = _buffer_overflow; if (ret) _buffer_overflow = false; return ret; }
   int peek();
 
   virtual size_t write(uint8_t byte);
+  int availableForWrite();
   virtual int read();
   virtual int available();
   virtual void flush();
@@ -14,18 +14,22 @@ void setup() {
 }
 
 void loop() {
+  tmElements_t tm;
+
+  now(tm); // one RTC read, so the fields below all belong to the same second
+
   Serial.print("Ok, Time = ");
-  print2digits(hour());
+  print2digits(tm.Hour);
   Serial.write(':');
-  print2digits(minute());
+  print2digits(tm.Minute);
   Serial.write(':');
-  print2digits(second());
+  print2digits(tm.Second);
   Serial.print(", Date (D/M/Y) = ");
-  Serial.print(day());
+  Serial.print(tm.Day);
   Serial.write('/');
-  Serial.print(month());
+  Serial.print(tm.Month);
   Serial.write('/');
-  Serial.print(year());
+  Serial.print(tmYearToCalendar(tm.Year));
   Serial.println();
   delay(1000);
 }
@@ -21,111 +21,188 @@
  */
 
 #include <time.h>
+#include <Arduino.h>
+#include <interrupt.h>
+#include <scss_registers.h>
 
 #include "CurieTime.h"
 
 #define YEAR_OFFSET     1900
 #define MONTH_OFFSET    1
 
+#define SECS_PER_DAY    86400UL
+
+#define USECS_PER_SEC   1000000ULL
+
+// Behind the RTC by more than this at a tick, the time is stepped forward
+// rather than slewed; ahead of it, it is always slewed, at no less than
+// half speed, so that it never steps backwards
+#define SYNC_STEP_US    100000
+#define SYNC_SLEW_MAX_US (USECS_PER_SEC / 2)
+
+// nowMicros() is the line through (syncCycles, syncMicros), rising by
+// syncScale / 2^32 microseconds per timer0 cycle. Each RTC tick starts a
+// new line where the last one stood, aimed at the next tick's second.
+static volatile bool syncRunning = false;
+static bool syncLocked;
+static uint64_t syncCycles;
+static uint64_t syncMicros;
+static uint32_t syncScale;
+static uint32_t syncSecond;     // RTC second of the last tick
+static uint64_t tickCycles;     // cycles64() at the last tick, 0 for none
+static uint32_t syncRate = F_CPU; // timer0 cycles per RTC second, averaged
+
+// The last conversion, so the fields of one RTC second cost one breakTime()
+static unsigned long cachedTime = ~0UL;
+static tmElements_t cachedTm;
+
 unsigned long now()
 {
     return *RTC_CCVR;
 }
 
-struct tm* tTm(unsigned long  t)
+unsigned long now(tmElements_t &tm)
 {
-    time_t time = t;
-  
-    return gmtime(&time);
+    unsigned long t = now();
+
+    breakTime(t, tm);
+    return t;
 }
 
-int year()
+// Days since 1970-01-01 to year/month/day, after Howard Hinnant's
+// civil_from_days(): the year here starts in March, so the leap day falls
+// at its end and the month lengths follow (153 * m + 2) / 5.
+void breakTime(unsigned long t, tmElements_t &tm)
 {
-    unsigned long t = now();
+    uint32_t saved = interrupt_lock();
+    if (t == cachedTime) {
+        tm = cachedTm;
+        interrupt_unlock(saved);
+        return;
+    }
+    interrupt_unlock(saved);
+
+    uint32_t days = t / SECS_PER_DAY;
+    uint32_t secs = t % SECS_PER_DAY;
+
+    tm.Second = secs % 60;
+    tm.Minute = (secs / 60) % 60;
+    tm.Hour = secs / 3600;
+    tm.Wday = (days + 4) % 7 + 1;         // 1970-01-01 was a Thursday
+
+    uint32_t z = days + 719468;           // days since 0000-03-01
+    uint32_t era = z / 146097;
+    uint32_t doe = z - era * 146097;      // [0, 146096]
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;    // March is 0
+    uint32_t year = yoe + era * 400;
+
+    tm.Day = doy - (153 * mp + 2) / 5 + 1;
+    tm.Month = mp < 10 ? mp + 3 : mp - 9;
+    if (tm.Month <= 2)
+        year++;
+    tm.Year = CalendarYrToTm(year);
+
+    saved = interrupt_lock();
+    cachedTime = t;
+    cachedTm = tm;
+    interrupt_unlock(saved);
+}
 
-    return year(t);
+int year()
+{
+    return year(now());
 }
 
 int year(unsigned long t)
 {
-    struct tm* tm = tTm(t);
+    tmElements_t tm;
 
-    return (tm) ? (tm->tm_year + YEAR_OFFSET) : -1;
+    breakTime(t, tm);
+    return tmYearToCalendar(tm.Year);
 }
 
 int month()
 {
-    unsigned long t = now();
-
-    return month(t);
+    return month(now());
 }
 
 int month(unsigned long t)
 {
-    struct tm* tm = tTm(t);
+    tmElements_t tm;
 
-    return (tm) ? (tm->tm_mon + MONTH_OFFSET) : -1;
+    breakTime(t, tm);
+    return tm.Month;
 }
 
 int day()
 {
-    unsigned long t = now();
-
-    return day(t);
+    return day(now());
 }
 
 int day(unsigned long t)
 {
-    struct tm* tm = tTm(t);
+    tmElements_t tm;
 
-    return (tm) ? tm->tm_mday : -1;
+    breakTime(t, tm);
+    return tm.Day;
 }
 
 int hour()
 {
-    unsigned long t = now();
-
-    return hour(t);
+    return hour(now());
 }
 
 int hour(unsigned long t)
 {
-    struct tm* tm = tTm(t);
-
-    return (tm) ? tm->tm_hour : -1;
+    return (t % SECS_PER_DAY) / 3600;
 }
 
 int minute()
 {
-    unsigned long t = now();
-
-    return minute(t);
+    return minute(now());
 }
 
 int minute(unsigned long t)
 {
-    struct tm* tm = tTm(t);
-
-    return (tm) ? tm->tm_min : -1;
+    return (t / 60) % 60;
 }
 
 int second()
 {
-    unsigned long t = now();
-
-    return second(t);
+    return second(now());
 }
 
 int second(unsigned long t)
 {
-    struct tm* tm = tTm(t);
+    return t % 60;
+}
 
-    return (tm) ? tm->tm_sec : -1;
+int weekday()
+{
+    return weekday(now());
+}
+
+int weekday(unsigned long t)
+{
+    return (t / SECS_PER_DAY + 4) % 7 + 1;
 }
 
 void setTime(unsigned long t)
 {
+    uint32_t saved = interrupt_lock();
     *RTC_CLR = t;
+    if (syncRunning) {
+        // Step onto the new time at the next tick
+        MMIO_REG_VAL(RTC_CMR) = t + 1;
+        syncCycles = cycles64();
+        syncMicros = (uint64_t)t * USECS_PER_SEC;
+        syncSecond = t;
+        tickCycles = 0;
+        syncLocked = false;
+    }
+    interrupt_unlock(saved);
 }
 
 void setTime(int hour, int minute, int second, int day, int month, int year)
@@ -145,3 +222,101 @@ void setTime(int hour, int minute, int second, int day, int month, int year)
 
     setTime(t);
 }
+
+static uint64_t syncAt(uint64_t c)
+{
+    uint64_t elapsed = c - syncCycles;
+
+    // Ticks only go missing with interrupts masked for seconds; hold the
+    // line there rather than let the product overflow
+    if (elapsed > 0xffffffffULL)
+        elapsed = 0xffffffffULL;
+    return syncMicros + ((elapsed * syncScale) >> 32);
+}
+
+static void rtcTickIsr(void)
+{
+    uint64_t c = cycles64();
+    uint32_t second = *RTC_CCVR;
+
+    (void)MMIO_REG_VAL(RTC_EOI);
+    MMIO_REG_VAL(RTC_CMR) = second + 1;
+
+    uint32_t ds = second - syncSecond;
+    if (tickCycles != 0 && ds > 0 && ds < 16) {
+        int32_t measured = (uint32_t)((c - tickCycles) / ds);
+        syncRate += (measured - (int32_t)syncRate) / 8;
+    }
+    tickCycles = c;
+    syncSecond = second;
+
+    uint64_t target = (uint64_t)second * USECS_PER_SEC;
+    uint64_t v = syncAt(c);
+    int64_t error = (int64_t)(target - v);
+    if (error > SYNC_STEP_US || (!syncLocked && error > 0)) {
+        v = target;
+        error = 0;
+    }
+    if (error < -(int64_t)SYNC_SLEW_MAX_US)
+        error = -(int64_t)SYNC_SLEW_MAX_US;
+    syncLocked = true;
+    syncCycles = c;
+    syncMicros = v;
+    syncScale = (uint32_t)(((USECS_PER_SEC + error) << 32) / syncRate);
+}
+
+void timeSyncBegin()
+{
+    if (syncRunning)
+        return;
+
+    uint32_t saved = interrupt_lock();
+    uint32_t second = *RTC_CCVR;
+    // Until the first tick, from the start of the current second: the
+    // tick then only steps forward
+    syncCycles = cycles64();
+    syncMicros = (uint64_t)second * USECS_PER_SEC;
+    syncRate = F_CPU;
+    syncScale = (uint32_t)((USECS_PER_SEC << 32) / F_CPU);
+    syncSecond = second;
+    tickCycles = 0;
+    syncLocked = false;
+    syncRunning = true;
+
+    MMIO_REG_VAL(RTC_CMR) = second + 1;
+    interrupt_connect(IRQ_RTC_INTR, rtcTickIsr);
+    interrupt_enable(IRQ_RTC_INTR);
+    // Route the RTC to this core as well, leaving LMT's mask as it is
+    MMIO_REG_VAL_FROM_BASE(SCSS_REGISTER_BASE, SCSS_INT_RTC_MASK_OFFSET) &= ENABLE_SSS_INTERRUPTS;
+    MMIO_REG_VAL(RTC_CCR) = (MMIO_REG_VAL(RTC_CCR) | RTC_CCR_IEN | RTC_CCR_EN) & ~RTC_CCR_MASK;
+    interrupt_unlock(saved);
+}
+
+void timeSyncEnd()
+{
+    uint32_t saved = interrupt_lock();
+    if (syncRunning) {
+        MMIO_REG_VAL(RTC_CCR) |= RTC_CCR_MASK;
+        MMIO_REG_VAL_FROM_BASE(SCSS_REGISTER_BASE, SCSS_INT_RTC_MASK_OFFSET) |= DISABLE_SSS_INTERRUPTS;
+        interrupt_disable(IRQ_RTC_INTR);
+        syncRunning = false;
+    }
+    interrupt_unlock(saved);
+}
+
+uint64_t nowMicros()
+{
+    if (!syncRunning)
+        timeSyncBegin();
+
+    uint32_t saved = interrupt_lock();
+    uint64_t t = syncAt(cycles64());
+    interrupt_unlock(saved);
+    return t;
+}
+
+long timeSyncDriftPpm()
+{
+    int32_t rate = syncRate;
+    return ((int64_t)(rate - (int32_t)F_CPU) * 1000000) / (int32_t)F_CPU;
+}
@@ -5,6 +5,8 @@
 #ifndef CurieTime_h
 #define CurieTime_h
 
+#include <stdint.h>
+
 #define RTC_CCVR    (volatile int*)0xb0000400 // Current Counter Value Register
 #define RTC_CMR     0xb0000404 // Counter Match Register
 #define RTC_CLR     (volatile int*)0xb0000408 // Counter Load Register
@@ -13,10 +15,30 @@
 #define RTC_RSTAT   0xb0000414 // Interrupt Raw Status Register
 #define RTC_EOI     0xb0000418 // End of Interrupt Register
 
+#define RTC_CCR_IEN     (1 << 0) // Interrupt enable
+#define RTC_CCR_MASK    (1 << 1) // Interrupt mask
+#define RTC_CCR_EN      (1 << 2) // Counter enable
+
 // The following API is based on Paul Stoffregen's Arduino Time Library:
 //   https://github.com/PaulStoffregen/Time 
 
+typedef struct {
+  uint8_t Second;
+  uint8_t Minute;
+  uint8_t Hour;
+  uint8_t Wday;   // day of week, Sunday is day 1
+  uint8_t Day;
+  uint8_t Month;
+  uint8_t Year;   // offset from 1970
+} tmElements_t;
+
+#define tmYearToCalendar(Y) ((Y) + 1970)
+#define CalendarYrToTm(Y)   ((Y) - 1970)
+
 unsigned long now(); // current time as seconds since Jan 1 1970 
+unsigned long now(tmElements_t &tm); // same, and its fields from the one RTC read
+
+void breakTime(unsigned long t, tmElements_t &tm); // fields of t, in one pass
 
 int year();                     // current year as an integer
 int year(unsigned long  t);     // year of t as an integer
@@ -30,8 +52,22 @@ int minute();                   // current minute as an integer (0 - 59)
 int minute(unsigned long  t);   // minute of t as an integer (0 - 59)
 int second();                   // current second as an integer (0 - 59)
 int second(unsigned long  t);   // second of t as an integer (0 - 59)
+int weekday();                  // current day of week, Sunday is day 1
+int weekday(unsigned long  t);  // day of week of t, Sunday is day 1
 
 void setTime(int hour, int minute, int second, int day, int month, int year); // set the current time
 void setTime(unsigned long t); // set the current time from seconds since Jan 1 1970
 
+// Microseconds since Jan 1 1970: the RTC second, interpolated with timer0.
+// An RTC interrupt latches timer0 at every second and the interpolation is
+// slewed onto the RTC, so the result follows the RTC's crystal, never runs
+// backwards (apart from setTime()) and costs a few register reads. Ahead of
+// the RTC, say after another core set it back, it runs at half speed until
+// it meets it again.
+// The first call starts the time base; it is exact after the next second.
+uint64_t nowMicros();
+void timeSyncBegin();           // start the time base, one interrupt a second
+void timeSyncEnd();             // stop it, nowMicros() starts it again
+long timeSyncDriftPpm();        // timer0 rate against the RTC, in ppm
+
 #endif
@@ -40,7 +40,7 @@
 
 CurieTimer  CurieTimerOne;
 
-static void timerOneIsrWrapper(void)
+static void timerOneIsrWrapper(void *arg)
 {
   CurieTimerOne.timerIsr();
 }
@@ -51,13 +51,11 @@ static void timerOnePwmCbWrapper(void)
 
 
 CurieTimer::CurieTimer() :
-  tickCnt(0), currState(IDLE), userCB(NULL)
+  tickCnt(0), currState(IDLE), userCB(NULL), hwChannels(0)
 {
-  timerCountAddr = ARC_V2_TMR1_COUNT;
-  timerControlAddr = ARC_V2_TMR1_CONTROL;
-  timerLimitAddr = ARC_V2_TMR1_LIMIT;
-  timerIrqNum = ARCV2_IRQ_TIMER1;
-  isrFuncPtr = &timerOneIsrWrapper;
+  // timer1 is shared with tone(), Servo and delay() through hwtimer
+  hwtimerInit(&timer, timerOneIsrWrapper, NULL);
+  timerPeriod = 0;
   pwmCB = &timerOnePwmCbWrapper;
 }
 
@@ -68,32 +66,21 @@ CurieTimer::CurieTimer() :
 
 void CurieTimer::kill()
 {
-  interrupt_disable(timerIrqNum);  // Disable Timer at controller
-  aux_reg_write(timerControlAddr, 0);  // Disable Timer itself
-  aux_reg_write(timerLimitAddr, 0);
-  aux_reg_write(timerCountAddr, 0);
+  hwtimerStop(&timer);
 
   tickCnt = 0;
   userCB = NULL;
   currState = IDLE;
-  pauseCntrl = pauseCount = dutyCycle = nonDutyCycle = periodInUsec = 0;
+  timerPeriod = pauseCount = dutyCycle = nonDutyCycle = periodInUsec = 0;
 }
 
 
 void CurieTimer::attachInterrupt(void (*userCallBack)())
 {
-  unsigned int reg;
-
-  // Disable timer interrupt first.
-  reg = aux_reg_read(timerControlAddr) & ~ARC_TIMER_EN_INTR_BIT_FLAG;
-  aux_reg_write(timerControlAddr, reg);
-
-  // Record the user call back routine.
+  // Record the user call back routine, out of the timer interrupt's way.
+  uint32_t saved = interrupt_lock();
   userCB = userCallBack;
-
-  // Let timer interrupt go again.
-  reg |= ARC_TIMER_EN_INTR_BIT_FLAG;
-  aux_reg_write(timerControlAddr, reg);
+  interrupt_unlock(saved);
 }
 
 
@@ -112,11 +99,12 @@ void CurieTimer::pause(void)
   if(currState != RUNNING)
     return;
 
-  pauseCntrl = aux_reg_read(timerControlAddr);
-  pauseCount = aux_reg_read(timerCountAddr);
-
-  interrupt_disable(timerIrqNum);  // Disable Timer at controller
-  aux_reg_write(timerControlAddr, 0);  // Disable Timer itself
+  // Count reached in the current period, as the hardware counter would have.
+  uint32_t saved = interrupt_lock();
+  unsigned int remaining = hwtimerRemaining(&timer);
+  pauseCount = remaining < timerPeriod ? timerPeriod - remaining : 0;
+  hwtimerStop(&timer);
+  interrupt_unlock(saved);
 
   currState = PAUSED;
 }
@@ -127,12 +115,8 @@ void CurieTimer::resume(void)
   if(currState != PAUSED)
     return;
 
-  aux_reg_write(timerCountAddr, pauseCount);
-  aux_reg_write(timerControlAddr, pauseCntrl);
   currState = RUNNING;
-
-  // Re-enable timer interrupt once timer is reloaded with previous stop values.
-  interrupt_enable(timerIrqNum);
+  hwtimerStart(&timer, timerPeriod - pauseCount, timerPeriod);
 }
 
 
@@ -151,6 +135,9 @@ int CurieTimer::pwmStart(unsigned int outputPin, double dutyPercentage, unsigned
   if((dutyPercentage < 0.0) || (dutyPercentage > 100.0))
     return -(INVALID_DUTY_CYCLE);
 
+  if(digitalPinHasPWM(outputPin))
+    return hwPwmStart(outputPin, dutyPercentage, periodUsec);
+
   periodInUsec = periodUsec;
   pwmPin = outputPin;
   pinMode(pwmPin, OUTPUT);
@@ -180,9 +167,8 @@ int CurieTimer::pwmStart(unsigned int outputPin, double dutyPercentage, unsigned
   if(nonDutyCycle < (10 * HZ_USEC))
     nonDutyCycle = (10 * HZ_USEC);
 
-  // Account for s/w overhead.
-  dutyCycle -= (4 *  HZ_USEC);
-  nonDutyCycle -= (4 *  HZ_USEC);
+  // Each edge is timed from the previous one with hwtimerAdvance(), so no
+  // allowance for interrupt latency is needed.
 
   dutyToggle = true;
   digitalWrite(pwmPin, HIGH);
@@ -200,6 +186,108 @@ int CurieTimer::pwmStart(unsigned int outputPin, int dutyRange, unsigned int per
 }
 
 
+// Method: hwPwmStart
+//   PWM from the PWM block: the period and high time go straight into the
+// channel's load counts, and new ones take effect at the end of the running
+// period.
+
+int CurieTimer::hwPwmStart(unsigned int outputPin, double dutyPercentage, unsigned int periodUsec)
+{
+  unsigned int chan = g_APinDescription[outputPin].ulPwmChan;
+  unsigned int pwmPeriodHz = periodUsec * HZ_USEC;
+
+  if(!(hwChannels & (1 << chan))) {
+    hwSavedPeriod[chan] = pwmPeriod[chan];
+    hwPins[chan] = outputPin;
+    hwChannels |= 1 << chan;
+  }
+
+  if((dutyPercentage == 0.0) || (dutyPercentage == 100.0)) {
+    pinMode(outputPin, OUTPUT);
+    digitalWrite(outputPin, (dutyPercentage == 0.0) ? LOW : HIGH);
+    return SUCCESS;
+  }
+
+  analogWritePulse(outputPin, pwmPeriodHz,
+                   (unsigned int)(((double)pwmPeriodHz / 100.0) * dutyPercentage));
+  return SUCCESS;
+}
+
+
+bool CurieTimer::hwPwmRunning(unsigned int outputPin)
+{
+  return digitalPinHasPWM(outputPin) &&
+         (hwChannels & (1 << g_APinDescription[outputPin].ulPwmChan));
+}
+
+
+void CurieTimer::pwmStop(unsigned int outputPin)
+{
+  if(!hwPwmRunning(outputPin)) {
+    if(outputPin == pwmPin)
+      kill();
+    digitalWrite(outputPin, LOW);
+    return;
+  }
+
+  unsigned int chan = g_APinDescription[outputPin].ulPwmChan;
+
+  // Back to GPIO, low, with the analogWrite() period.
+  pinMode(outputPin, OUTPUT);
+  digitalWrite(outputPin, LOW);
+  pwmPeriod[chan] = hwSavedPeriod[chan];
+  hwChannels &= ~(1 << chan);
+}
+
+
+void CurieTimer::pwmStop(void)
+{
+  for(unsigned int chan = 0; chan < 4; chan++) {
+    if(hwChannels & (1 << chan))
+      pwmStop(hwPins[chan]);
+  }
+  kill();
+  digitalWrite(pwmPin, LOW);
+}
+
+
+// Method: pwmSync
+//   Restart the channels of hardware PWM pins with the given offsets.  The
+// offsets are timed by spinning on timer0 with interrupts masked, so they
+// are exact to a few clocks.
+
+int CurieTimer::pwmSync(const unsigned int *outputPins, const unsigned int *phaseUsec,
+  unsigned int count)
+{
+  uint8_t pins[4];
+  uint32_t phases[4];
+
+  if(count > 4)
+    return -(INVALID_PIN);
+
+  for(unsigned int i = 0; i < count; i++) {
+    if(!hwPwmRunning(outputPins[i]))
+      return -(INVALID_PIN);
+    pins[i] = outputPins[i];
+    phases[i] = phaseUsec ? phaseUsec[i] * HZ_USEC : 0;
+    if(phases[i] >= pwmPeriod[g_APinDescription[outputPins[i]].ulPwmChan])
+      return -(INVALID_PERIOD);
+  }
+
+  analogWriteSync(pins, phases, count);
+  return SUCCESS;
+}
+
+
+int CurieTimer::pwmPhase(unsigned int outputPin, unsigned int referencePin, unsigned int phaseUsec)
+{
+  unsigned int pins[2] = { referencePin, outputPin };
+  unsigned int phases[2] = { 0, phaseUsec };
+
+  return pwmSync(pins, phases, 2);
+}
+
+
 // Method:  pwmCallBack
 //   Software PWM ISR.  Timer generates interrupt and calls this method in
 // its ISR.  This routine is responsible to toggle the PWM signal according
@@ -211,8 +299,7 @@ inline void CurieTimer::pwmCallBack(void)
 
   digitalWrite(pwmPin, dutyToggle ? HIGH : LOW);
 
-  aux_reg_write(timerLimitAddr, dutyToggle ? dutyCycle : nonDutyCycle);
-  aux_reg_write(timerCountAddr, 0);
+  hwtimerAdvance(&timer, dutyToggle ? dutyCycle : nonDutyCycle);
 }
 
 
@@ -232,7 +319,7 @@ void CurieTimer::setPeriod(unsigned long microseconds)
   periodHz = microseconds * HZ_USEC;
   pause();
 
-  aux_reg_write(timerLimitAddr, periodHz);  // Load Timer period
+  timerPeriod = periodHz;  // Load Timer period
 
   if(pauseCount >= periodHz)
     pauseCount = 0;
@@ -252,27 +339,16 @@ int CurieTimer::init(const unsigned int periodHz,
   if((periodHz == 0) || (periodHz > MAX_PERIOD_HZ))
     return -(INVALID_PERIOD);
 
-  interrupt_disable(timerIrqNum);  // Disable Timer at controller
-  aux_reg_write(timerControlAddr, 0);  // Disable Timer itself
+  hwtimerStop(&timer);
 
   if(userCallBack != NULL)
     userCB = userCallBack;
-  aux_reg_write(timerLimitAddr, periodHz);  // Load Timer period
-
-  aux_reg_write(timerCountAddr, 0);  // Reset variables
+  timerPeriod = periodHz;  // Load Timer period
+  pauseCount = 0;  // Reset variables
   tickCnt = 0;
 
-  if(isrFuncPtr != NULL) {  // Enable timer running with interrupt
-    interrupt_connect(timerIrqNum, isrFuncPtr);
-    aux_reg_write(timerControlAddr, ARC_TIMER_EN_INTR_BIT_FLAG |
-		  ARC_TIMER_NON_HALT_ONLY_BIT_FLAG);
-    interrupt_enable(timerIrqNum);
-  }
-  else {  // Timer runs without interrupt
-    aux_reg_write(timerControlAddr, ARC_TIMER_NON_HALT_ONLY_BIT_FLAG);
-  }
-
   currState = RUNNING;
+  hwtimerStart(&timer, periodHz, periodHz);
   return SUCCESS;
 }
 
@@ -282,16 +358,10 @@ int CurieTimer::init(const unsigned int periodHz,
 
 inline void CurieTimer::timerIsr(void)
 {
-  unsigned int reg;
-
   tickCnt++;  // Account for the interrupt
 
   if(userCB != NULL)  // Call user ISR if available
     userCB();
-
-  // Clear the interrupt pending bit upon exit.
-  reg = aux_reg_read(timerControlAddr) & ~ARC_TIMER_INTR_PENDING_BIT_FLAG;
-  aux_reg_write(timerControlAddr, reg);
 }
 
 
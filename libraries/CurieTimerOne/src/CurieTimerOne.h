@@ -45,6 +45,7 @@
 #include <aux_regs.h>
 #include <interrupt.h>
 #include <conf.h>
+#include <hwtimer.h>
 
 // Timer-1 is clocked at ARCV2_TIMER1_CLOCK_FREQ defined in conf.h
 const unsigned int HZ_USEC = (ARCV2_TIMER1_CLOCK_FREQ / 1000000);  // Hz per micro second.
@@ -63,7 +64,8 @@ const unsigned int ARC_TIMER_INTR_PENDING_BIT_FLAG = 0x08;  // Bit 3. Interrupt
 typedef enum {
   SUCCESS = 0,
   INVALID_PERIOD,
-  INVALID_DUTY_CYCLE
+  INVALID_DUTY_CYCLE,
+  INVALID_PIN
 } timerErrType;
 
 typedef enum {
@@ -137,7 +139,7 @@ class CurieTimer
     }
 
     inline void disablePwm(char pin) {
-      pwmStop();
+      pwmStop(pin);
     }
 
     //****************************
@@ -180,14 +182,29 @@ class CurieTimer
     // Pausing the timer = no count up, no interrupt.
     void pause(void);
 
-    // Start software PWM.  Note that the timer is consumed once PWM is set.
+    // Start PWM.  On the PWM pins (3, 5, 6 and 9) the output comes from the
+    // PWM block, costs no interrupts and leaves the timer free; on the other
+    // pins it is software PWM and the timer is consumed once PWM is set.
     int pwmStart(unsigned int outputPin, double dutyPercentage, unsigned int periodUsec);
 
-    // Start software PWM.  Use a range of 0-1023 for duty cycle. 0=always Low, 1023=always high
+    // Start PWM.  Use a range of 0-1023 for duty cycle. 0=always Low, 1023=always high
     int pwmStart(unsigned int outputPin, int dutyRange, unsigned int periodUsec);
 
-    // Stop software PWM.  Put the time back to default and de-assert the selected port.
-    inline void pwmStop(void) { kill(); return digitalWrite(pwmPin, LOW); }
+    // Stop software PWM and every hardware PWM pin.  Put the time back to
+    // default and de-assert the ports.
+    void pwmStop(void);
+
+    // Stop PWM on one pin only.
+    void pwmStop(unsigned int outputPin);
+
+    // Restart hardware PWM pins together, each phaseUsec[i] after the call
+    // (all at once if phaseUsec is NULL), to line up or stagger their edges.
+    // Interrupts are masked until the last one starts.
+    int pwmSync(const unsigned int *outputPins, const unsigned int *phaseUsec, unsigned int count);
+
+    // Shift one hardware PWM pin to start phaseUsec after referencePin,
+    // within the period.
+    int pwmPhase(unsigned int outputPin, unsigned int referencePin, unsigned int phaseUsec);
 
     // Generic timer ISR.  It will call user call back routine if set.
     void timerIsr(void);
@@ -195,15 +212,12 @@ class CurieTimer
     void pwmCallBack(void);
 
   private:
-    unsigned int timerCountAddr;
-    unsigned int timerControlAddr;
-    unsigned int timerLimitAddr;
-    unsigned int timerIrqNum;
+    hwtimer_t timer;
+    unsigned int timerPeriod;
 
     unsigned int tickCnt;
 
     timerStateType currState;
-    unsigned int pauseCntrl;
     unsigned int pauseCount;
 
     bool dutyToggle;
@@ -212,10 +226,18 @@ class CurieTimer
     unsigned int nonDutyCycle;
     unsigned int periodInUsec;
 
-    void (*isrFuncPtr)();
     void (*userCB)();
     void (*pwmCB)();
 
+    // Hardware PWM, per channel: the pin and its analogWrite() period to
+    // put back when it stops.
+    uint8_t hwChannels;
+    uint8_t hwPins[4];
+    unsigned int hwSavedPeriod[4];
+
+    int hwPwmStart(unsigned int outputPin, double dutyPercentage, unsigned int periodUsec);
+    bool hwPwmRunning(unsigned int outputPin);
+
     // Init:  Kick off a timer by initializing it with a period.
     int init(const unsigned int periodHz, void (*userCallBack)());
 };
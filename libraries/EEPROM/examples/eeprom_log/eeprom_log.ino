@@ -0,0 +1,50 @@
+/***
+    eeprom_log example.
+
+    Counts resets in a value kept with EEPROMLog. Each update appends a
+    record rather than rewriting the 2 KB page, so it takes milliseconds
+    and the page is only erased once the log fills up.
+
+    Note, this formats the EEPROM page as a log the first time it runs,
+    clearing what the byte examples stored there.
+***/
+
+#include <EEPROMLog.h>
+
+const uint16_t BOOT_KEY = 1;
+
+struct BootInfo {
+  uint32_t count;
+  unsigned long lastUptime;
+};
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  if (!EEPROMLog.begin()) {
+    Serial.println("Formatting the EEPROM page as a log");
+    EEPROMLog.format();
+  }
+
+  BootInfo info = { 0, 0 };
+  EEPROMLog.get(BOOT_KEY, info);
+  info.count++;
+
+  unsigned long start = millis();
+  EEPROMLog.put(BOOT_KEY, info);
+  Serial.print("Boot number ");
+  Serial.print(info.count);
+  Serial.print(", stored in ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+
+  Serial.print(EEPROMLog.freeBytes());
+  Serial.println(" bytes left before the next compaction");
+}
+
+void loop() {
+  /* Empty loop */
+}
@@ -17,28 +17,60 @@
 */
 
 #include "EEPROM.h"
+#include "hwtimer.h"
+#include "interrupt.h"
 
 EEPROMClass EEPROM;
 
-void CurieClear()
+//busy-wait for a FLASH_STTS done bit; a program takes tens of
+//microseconds, an erase a few milliseconds
+static bool CurieFlashWait(uint32_t done, uint32_t timeout)
+{
+  uint32_t start = micros();
+
+  while(((*(volatile uint32_t*)FLASH_STTS) & done) == 0) {
+    if (micros() - start > timeout) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline void CurieStartErase()
 {
   //erase the 2k bytes of the eeprom section inside the otp area
   *(uint32_t*)(ROM_WR_CTRL) = 0x4002;
-  //wait for erase to be complete
-  #if 0
-  // TODO: wait for FLASH_STTS.ER_DONE to be set to 1
-  while(((*(uint32_t*)FLASH_STTS) & 0x01) == 0) {
-    delay(1);
-  }
-  #endif
-  delay(5);
 }
 
-void CurieRestoreMemory(uint32_t* buffer, uint32_t size)
+static void CurieStartWrite32(uint32_t address, uint32_t data)
 {
   uint32_t rom_wr_ctrl = 0;
-  uint32_t address;
 
+  //store data into ROM_WR_DATA register
+  *(uint32_t*)(ROM_WR_DATA) = data;
+  address = ((address >> 2) << 2) + EEPROM_OFFSET;
+  //shift left 2 bits to store offset into bits 19:2 (WR_ADDR)
+  rom_wr_ctrl = (address)<<2;
+  rom_wr_ctrl |= 0x00000001; //set (WR_REQ) bit
+  *(uint32_t*)(ROM_WR_CTRL) = rom_wr_ctrl;
+}
+
+void CurieClear()
+{
+  CurieStartErase();
+  //wait for erase to be complete
+  CurieFlashWait(FLASH_STTS_ER_DONE, FLASH_ERASE_TIMEOUT);
+}
+
+void CurieWrite32(uint32_t address, uint32_t data)
+{
+  CurieStartWrite32(address, data);
+  //wait for the word to be programmed
+  CurieFlashWait(FLASH_STTS_WR_DONE, FLASH_WRITE_TIMEOUT);
+}
+
+void CurieRestoreMemory(uint32_t* buffer, uint32_t size)
+{
   for (uint32_t i=0; i<size; i++) {
 
     uint32_t data32 = buffer[i];
@@ -46,27 +78,50 @@ void CurieRestoreMemory(uint32_t* buffer, uint32_t size)
       continue;
     }
 
-    //store data into ROM_WR_DATA register
-    *(uint32_t*)(ROM_WR_DATA) = data32;
-    address = i * 4 + EEPROM_OFFSET;
-    //shift left 2 bits to store offset into bits 19:2 (WR_ADDR)
-    rom_wr_ctrl = (address)<<2;
-    rom_wr_ctrl |= 0x00000001; //set (WR_REQ) bit
-    *(uint32_t*)(ROM_WR_CTRL) = rom_wr_ctrl;
-
-    delay(5); //give it enough time to finish writing
+    CurieWrite32(i * 4, data32);
   }
 }
 
+//RAM copy of the page: the image a rewrite is built in, and the batch
+//that writes go to between beginBatch() and commit(). Static rather than
+//on the stack, where 2 KB could overflow a deep call chain.
+static uint32_t scratch[EEPROM_SIZE/4];
+static volatile bool batch = false;
+
+//commitAsync() state, advanced from a hwtimer: one flash request is
+//started per tick, and the next tick checks that it is done
+enum { COMMIT_IDLE, COMMIT_ERASE, COMMIT_PROGRAM };
+static volatile uint8_t commitState = COMMIT_IDLE;
+static volatile bool commitDirty;       //written to since the pass began
+static uint16_t commitWord;
+static uint32_t commitPending;          //FLASH_STTS bit awaited, or 0
+static uint32_t commitStarted;
+static void (*commitCallback)(void);
+static hwtimer_t commitTimer;
+
+static inline const uint32_t *CurieImage()
+{
+  return batch ? scratch : (const uint32_t *)EEPROM_ADDR;
+}
+
+uint32_t *CurieScratch()
+{
+  return batch ? NULL : scratch;
+}
+
+static inline uint32_t CurieByteShift(uint32_t address)
+{
+  return (3 - address % 4) * 8;
+}
+
 uint8_t CurieRead8(uint32_t address)
 {
   if((address > 0x7FF))
   {
     return 0;
   }
-  int offset = address%4;
-  uint32_t value = *(uint32_t*)(EEPROM_ADDR+(address/4)*4);
-  value = (value >> ((3-offset)*8)) & 0xFF;
+  uint32_t value = CurieImage()[address/4];
+  value = (value >> CurieByteShift(address)) & 0xFF;
   return (uint8_t)value;
 }
 
@@ -76,10 +131,109 @@ uint32_t CurieRead32(uint32_t address)
   {
     return 0;
   }
-  uint32_t value = *(uint32_t*)(EEPROM_ADDR+(address/4)*4);
+  uint32_t value = CurieImage()[address/4];
   return value;
 }
 
+void CurieReadBlock(uint32_t address, uint8_t *data, uint32_t len)
+{
+  const uint32_t *image = CurieImage();
+
+  //bytes out of range read as 0, as from CurieRead8()
+  if ((address > 0x7FF) || (len > EEPROM_SIZE - address))
+  {
+    for (; len; len--) {
+      *data++ = CurieRead8(address++);
+    }
+    return;
+  }
+
+  for (; len && (address % 4); len--) {
+    *data++ = CurieRead8(address++);
+  }
+  //byte 0 of each word is its top byte, so whole words are a swap away
+  for (; len >= 4; len -= 4, address += 4, data += 4) {
+    uint32_t value = __builtin_bswap32(image[address/4]);
+    memcpy(data, &value, 4);
+  }
+  for (; len; len--) {
+    *data++ = CurieRead8(address++);
+  }
+}
+
+//bytes only go from erased to programmed without an erase
+static bool CurieNeedsErase(const uint32_t *image)
+{
+  const uint32_t *current = (const uint32_t *)EEPROM_ADDR;
+
+  for (int i = 0; i < EEPROM_SIZE/4; i++) {
+    uint32_t changed = current[i] ^ image[i];
+    for (int b = 0; b < 32; b += 8) {
+      if (((changed >> b) & 0xFF) && ((current[i] >> b) & 0xFF) != 0xFF) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void CurieCommit(const uint32_t *image)
+{
+  const uint32_t *current = (const uint32_t *)EEPROM_ADDR;
+
+  if (CurieNeedsErase(image)) {
+    CurieClear();
+    CurieRestoreMemory((uint32_t *)image, EEPROM_SIZE/sizeof(uint32_t));
+    return;
+  }
+  for (int i = 0; i < EEPROM_SIZE/4; i++) {
+    if (current[i] != image[i]) {
+      CurieWrite32(i * 4, image[i]);
+    }
+  }
+}
+
+void CurieWriteBlock(uint32_t address, const uint8_t *data, uint32_t len)
+{
+  if ((address > 0x7FF) || (len > EEPROM_SIZE - address))
+  {
+    return;
+  }
+
+  uint32_t *image = scratch;
+  if (!batch) {
+    memcpy(scratch, (uint32_t *)EEPROM_ADDR, EEPROM_SIZE);
+  }
+
+  for (uint32_t i = 0; i < len; i++, address++) {
+    uint32_t shift = CurieByteShift(address);
+    image[address/4] = (image[address/4] & ~((uint32_t)0xFF << shift)) | ((uint32_t)data[i] << shift);
+  }
+
+  if (!batch) {
+    CurieCommit(scratch);
+  } else if (commitState != COMMIT_IDLE) {
+    commitDirty = true;
+  }
+}
+
+void CurieUpdate32(uint32_t address, uint32_t data)
+{
+  if ((address > 0x7FF))
+  {
+    return;
+  }
+  address &= ~3;
+  if (CurieRead32(address) == data)
+  {
+    return;
+  }
+
+  uint8_t bytes[4] = { (uint8_t)(data >> 24), (uint8_t)(data >> 16),
+                       (uint8_t)(data >> 8), (uint8_t)data };
+  CurieWriteBlock(address, bytes, 4);
+}
+
 void CurieWrite8(uint32_t address, uint8_t data)
 {
   //make sure address is valid
@@ -95,31 +249,146 @@ void CurieWrite8(uint32_t address, uint8_t data)
     return;
   }
 
-  uint32_t currentDword = CurieRead32(address);
+  if (batch) {
+    CurieWriteBlock(address, &data, 1);
+    return;
+  }
 
-  int offset = address%4;
+  uint32_t currentDword = CurieRead32(address);
 
-  uint32_t data32 = (currentDword & ~(uint32_t)(0xFF << ((3-offset)*8)));
-  data32 = data32 | (data << ((3-offset)*8));
+  uint32_t data32 = (currentDword & ~(uint32_t)(0xFF << CurieByteShift(address)));
+  data32 = data32 | (data << CurieByteShift(address));
 
   if (currentValue != 0xFF) {
-    uint32_t dump[EEPROM_SIZE/4];
-    memcpy(dump, (uint32_t *)EEPROM_ADDR, EEPROM_SIZE);
-    dump[(address >> 2)] = data32;
+    memcpy(scratch, (uint32_t *)EEPROM_ADDR, EEPROM_SIZE);
+    scratch[(address >> 2)] = data32;
     CurieClear();
-    CurieRestoreMemory((uint32_t *)dump, EEPROM_SIZE/sizeof(uint32_t));
+    CurieRestoreMemory(scratch, EEPROM_SIZE/sizeof(uint32_t));
     return;
   }
 
-  uint32_t rom_wr_ctrl = 0;
+  CurieWrite32(address, data32);
+}
 
-  //store data into ROM_WR_DATA register
-  *(uint32_t*)(ROM_WR_DATA) = data32;
-  address = ((address >> 2) << 2) + EEPROM_OFFSET;
-  //shift left 2 bits to store offset into bits 19:2 (WR_ADDR)
-  rom_wr_ctrl = (address)<<2;
-  rom_wr_ctrl |= 0x00000001; //set (WR_REQ) bit
-  *(uint32_t*)(ROM_WR_CTRL) = rom_wr_ctrl;
+bool EEPROMClass::beginBatch()
+{
+  if (!batch) {
+    memcpy(scratch, (uint32_t *)EEPROM_ADDR, EEPROM_SIZE);
+    batch = true;
+  }
+  return true;
+}
+
+void EEPROMClass::commit()
+{
+  if (commitState != COMMIT_IDLE) {
+    //let the background pass finish
+    while (commitState != COMMIT_IDLE)
+      ;
+    return;
+  }
+  if (!batch) {
+    return;
+  }
+  batch = false;
+  CurieCommit(scratch);
+}
+
+void EEPROMClass::abortBatch()
+{
+  if (commitState == COMMIT_IDLE) {
+    batch = false;
+  }
+}
+
+static void CurieCommitPass()
+{
+  commitDirty = false;
+  commitWord = 0;
+  if (CurieNeedsErase(scratch)) {
+    commitState = COMMIT_ERASE;
+    commitPending = FLASH_STTS_ER_DONE;
+    commitStarted = micros();
+    CurieStartErase();
+  } else {
+    commitState = COMMIT_PROGRAM;
+    commitPending = 0;
+  }
+}
+
+static void CurieCommitTick(void *arg)
+{
+  const uint32_t *current = (const uint32_t *)EEPROM_ADDR;
+
+  if (commitPending) {
+    uint32_t timeout = commitState == COMMIT_ERASE ? FLASH_ERASE_TIMEOUT : FLASH_WRITE_TIMEOUT;
+    if (((*(volatile uint32_t*)FLASH_STTS) & commitPending) == 0 &&
+        micros() - commitStarted <= timeout) {
+      return;
+    }
+    commitPending = 0;
+  }
+  commitState = COMMIT_PROGRAM;
+
+  //the next word that differs; after an erase that is every programmed one
+  while (commitWord < EEPROM_SIZE/4 && current[commitWord] == scratch[commitWord]) {
+    commitWord++;
+  }
+  if (commitWord < EEPROM_SIZE/4) {
+    commitPending = FLASH_STTS_WR_DONE;
+    commitStarted = micros();
+    CurieStartWrite32(commitWord * 4, scratch[commitWord]);
+    commitWord++;
+    return;
+  }
+
+  if (commitDirty) {
+    CurieCommitPass();
+    return;
+  }
+  hwtimerStop(&commitTimer);
+  batch = false;
+  commitState = COMMIT_IDLE;
+  if (commitCallback) {
+    commitCallback();
+  }
+}
+
+bool EEPROMClass::commitAsync(void (*callback)(void), uint32_t tick)
+{
+  if (commitState != COMMIT_IDLE) {
+    return false;
+  }
+  if (!batch) {
+    if (callback) {
+      callback();
+    }
+    return true;
+  }
 
-  delay(5); //give it enough time to finish writing
+  commitCallback = callback;
+  hwtimerInit(&commitTimer, CurieCommitTick, NULL);
+  uint32_t saved = interrupt_lock();
+  CurieCommitPass();
+  if (hwtimerStart(&commitTimer, tick * 32, tick * 32)) {
+    commitState = COMMIT_IDLE;
+    interrupt_unlock(saved);
+    //no timer free: finish in the foreground, after the erase if one
+    //was started
+    if (commitPending) {
+      CurieFlashWait(commitPending, FLASH_ERASE_TIMEOUT);
+    }
+    commit();
+    if (callback) {
+      callback();
+    }
+    return true;
+  }
+  interrupt_unlock(saved);
+  return true;
+}
+
+bool EEPROMClass::committing()
+{
+  return commitState != COMMIT_IDLE;
 }
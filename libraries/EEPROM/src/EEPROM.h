@@ -21,10 +21,23 @@
 
 #define ROM_WR_CTRL 0xb0100004
 #define ROM_WR_DATA 0xb0100008
-#define FLASH_STTS  0xb0000014
+#define FLASH_STTS  0xb0100014
 #define EEPROM_ADDR 0xfffff000
 #define EEPROM_OFFSET 0x00001000
-#define CTRL_REG    0xb0000018
+#define CTRL_REG    0xb0100018
+
+//FLASH_STTS bits, set when the last request completes
+#define FLASH_STTS_ER_DONE 0x01
+#define FLASH_STTS_WR_DONE 0x02
+
+//Upper bounds on a page erase and a word program, in microseconds
+#define FLASH_ERASE_TIMEOUT 20000
+#define FLASH_WRITE_TIMEOUT 5000
+
+//Microseconds between the word programs of EEPROM.commitAsync()
+#ifndef EEPROM_COMMIT_TICK
+#define EEPROM_COMMIT_TICK 500
+#endif
 
 #define EEPROM_SIZE 2048 //EEPROM size in bytes
 
@@ -34,11 +47,25 @@
 /* Curie specific implementation of "atomic" read8 and write8 on OTP flash storage */
 
 void CurieClear();
+// programs one erased (0xFFFFFFFF) word; address is a byte offset
+void CurieWrite32(uint32_t address, uint32_t data);
 void CurieRestoreMemory(uint32_t* buffer, uint32_t size);
 
 uint8_t CurieRead8(uint32_t address);
 uint32_t CurieRead32(uint32_t address);
 void CurieWrite8(uint32_t address, uint8_t data);
+// writes len bytes with at most one page erase, programming only the
+// words that change
+void CurieWriteBlock(uint32_t address, const uint8_t *data, uint32_t len);
+// reads len bytes, a word at a time where it can
+void CurieReadBlock(uint32_t address, uint8_t *data, uint32_t len);
+// updates the word holding address; bytes address & ~3 to address | 3,
+// most significant first, as CurieRead32() returns them
+void CurieUpdate32(uint32_t address, uint32_t data);
+// brings the page to image (EEPROM_SIZE bytes) the same way
+void CurieCommit(const uint32_t *image);
+// the page sized buffer rewrites are built in, NULL while a batch holds it
+uint32_t *CurieScratch();
 
 /***
     EERef class.
@@ -135,6 +162,15 @@ struct EEPROMClass{
     uint8_t read( int idx )              { return EERef( idx ); }
     void write( int idx, uint8_t val )   { (EERef( idx )) = val; }
     void update( int idx, uint8_t val )  { EERef( idx ).update( val ); }
+
+    //Word access, idx a multiple of 4: byte idx is the top byte.
+    uint32_t read32( int idx )           { return CurieRead32( (uint32_t) idx ); }
+    void write32( int idx, uint32_t val ) { CurieUpdate32( (uint32_t) idx, val ); }
+
+    //The page as it is mapped, for reading configuration in place; word
+    //n holds bytes 4n (top byte) to 4n + 3, and batched writes don't show
+    //until commit().
+    const uint32_t *words()              { return (const uint32_t *) EEPROM_ADDR; }
     
     //STL and C++11 iteration capability.
     EEPtr begin()                        { return 0x00; }
@@ -143,18 +179,30 @@ struct EEPROMClass{
     
     //Functionality to 'get' and 'put' objects to and from EEPROM.
     template< typename T > T &get( int idx, T &t ){
-        EEPtr e = idx;
-        uint8_t *ptr = (uint8_t*) &t;
-        for( int count = sizeof(T) ; count ; --count, ++e )  *ptr++ = *e;
+        CurieReadBlock( (uint32_t) idx, (uint8_t*) &t, sizeof(T) );
         return t;
     }
     
     template< typename T > const T &put( int idx, const T &t ){
-        EEPtr e = idx;
-        const uint8_t *ptr = (const uint8_t*) &t;
-        for( int count = sizeof(T) ; count ; --count, ++e )  (*e).update( *ptr++ );
+        CurieWriteBlock( (uint32_t) idx, (const uint8_t*) &t, sizeof(T) );
         return t;
     }
+
+    //Batched writes: until commit(), writes go to a RAM copy of the page
+    //and reads see them; commit() then erases the page at most once and
+    //programs only the words that changed.
+    bool beginBatch();
+    void commit();
+    void abortBatch();
+
+    //Commits the batch in the background: a timer programs one word
+    //every tick microseconds, so the CPU only stops for the page erase
+    //itself when one is needed. Reads see the batch until it is done,
+    //writes made meanwhile go into the same pass, and callback, if any,
+    //runs from the timer interrupt at the end. false while a commit is
+    //already running.
+    bool commitAsync( void (*callback)(void) = NULL, uint32_t tick = EEPROM_COMMIT_TICK );
+    bool committing();
 };
 
 extern EEPROMClass EEPROM;
@@ -0,0 +1,222 @@
+/*
+  EEPROMLog.cpp - log structured key/value storage on the Curie EEPROM page
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "EEPROMLog.h"
+#include <crc.h>
+
+EEPROMLogClass EEPROMLog;
+
+/*
+  Word 0 holds LOG_MAGIC. Records follow it back to back: a header word
+  (key << 16 | length << 8 | crc8 of key, length and value), then the
+  value in (length + 3) / 4 words. The last record of a key wins, one of
+  length 0 removes it. The header goes first, so a record cut short by a
+  reset keeps its length, fails the crc and is stepped over.
+*/
+#define LOG_MAGIC 0x474F4C45
+#define LOG_WORDS (EEPROM_SIZE / 4)
+#define LOG_FREE 0xFFFFFFFF
+
+static inline uint32_t logWord(uint16_t word)
+{
+  return ((const volatile uint32_t *)EEPROM_ADDR)[word];
+}
+
+static inline const uint8_t *logBytes(uint16_t word)
+{
+  return (const uint8_t *)EEPROM_ADDR + word * 4;
+}
+
+static inline uint16_t headerKey(uint32_t header) { return header >> 16; }
+static inline uint8_t headerLen(uint32_t header) { return (header >> 8) & 0xFF; }
+static inline uint16_t valueWords(uint8_t len) { return (len + 3) / 4; }
+
+static uint32_t makeHeader(uint16_t key, const void *data, uint8_t len)
+{
+  uint8_t head[3] = { (uint8_t)(key >> 8), (uint8_t)key, len };
+  uint8_t crc = crc8(crc8(0, head, 3), data, len);
+
+  return (uint32_t)key << 16 | (uint32_t)len << 8 | crc;
+}
+
+bool EEPROMLogClass::begin()
+{
+  _keys = 0;
+  _end = LOG_WORDS;
+  _mounted = false;
+  if (logWord(0) != LOG_MAGIC)
+    return false;
+
+  uint16_t pos = 1;
+  while (pos < LOG_WORDS) {
+    uint32_t header = logWord(pos);
+    if (header == LOG_FREE)
+      break;
+
+    uint16_t key = headerKey(header);
+    uint8_t len = headerLen(header);
+    uint16_t next = pos + 1 + valueWords(len);
+    if (next > LOG_WORDS) {
+      // a torn header; leave the rest to the next compaction
+      pos = LOG_WORDS;
+      break;
+    }
+    if (key != EEPROM_LOG_NO_KEY && len <= EEPROM_LOG_MAX_VALUE &&
+        makeHeader(key, logBytes(pos + 1), len) == header)
+      index(key, pos, len);
+    pos = next;
+  }
+  _end = pos;
+  _mounted = true;
+  return true;
+}
+
+void EEPROMLogClass::format()
+{
+  CurieClear();
+  CurieWrite32(0, LOG_MAGIC);
+  begin();
+}
+
+int EEPROMLogClass::find(uint16_t key)
+{
+  for (int i = 0; i < _keys; i++) {
+    if (_index[i].key == key)
+      return i;
+  }
+  return -1;
+}
+
+void EEPROMLogClass::index(uint16_t key, uint16_t word, uint8_t len)
+{
+  int i = find(key);
+
+  if (len == 0) {
+    if (i >= 0)
+      _index[i] = _index[--_keys];
+  } else if (i >= 0) {
+    _index[i].word = word;
+  } else if (_keys < EEPROM_LOG_MAX_KEYS) {
+    _index[_keys].key = key;
+    _index[_keys].word = word;
+    _keys++;
+  }
+}
+
+int EEPROMLogClass::read(uint16_t key, void *data, uint8_t len)
+{
+  int i = find(key);
+  if (i < 0)
+    return -1;
+
+  uint16_t word = _index[i].word;
+  uint8_t stored = headerLen(logWord(word));
+  memcpy(data, logBytes(word + 1), len < stored ? len : stored);
+  return stored;
+}
+
+bool EEPROMLogClass::write(uint16_t key, const void *data, uint8_t len)
+{
+  if (!_mounted || key == EEPROM_LOG_NO_KEY || len == 0 ||
+      len > EEPROM_LOG_MAX_VALUE)
+    return false;
+
+  int i = find(key);
+  if (i >= 0) {
+    uint16_t word = _index[i].word;
+    if (headerLen(logWord(word)) == len &&
+        memcmp(logBytes(word + 1), data, len) == 0)
+      return true;
+  } else if (_keys == EEPROM_LOG_MAX_KEYS) {
+    return false;
+  }
+  return append(key, data, len);
+}
+
+bool EEPROMLogClass::remove(uint16_t key)
+{
+  if (!_mounted || find(key) < 0)
+    return false;
+  return append(key, NULL, 0);
+}
+
+bool EEPROMLogClass::append(uint16_t key, const void *data, uint8_t len)
+{
+  uint16_t words = valueWords(len);
+
+  if (_end + 1 + words > LOG_WORDS)
+    return rewrite(key, data, len);
+  for (uint16_t w = _end; w <= _end + words; w++) {
+    // left by a write cut short after the last header
+    if (logWord(w) != LOG_FREE)
+      return rewrite(key, data, len);
+  }
+
+  CurieWrite32(_end * 4, makeHeader(key, data, len));
+  for (uint16_t w = 0; w < words; w++) {
+    uint32_t value = LOG_FREE;
+    uint8_t n = len - w * 4 < 4 ? len - w * 4 : 4;
+    memcpy(&value, (const uint8_t *)data + w * 4, n);
+    if (value != LOG_FREE)
+      CurieWrite32((_end + 1 + w) * 4, value);
+  }
+  index(key, _end, len);
+  _end += 1 + words;
+  return true;
+}
+
+bool EEPROMLogClass::rewrite(uint16_t key, const void *data, uint8_t len)
+{
+  uint32_t *dump = CurieScratch();
+  uint16_t pos = 1;
+
+  if (!dump)
+    return false;
+  memset(dump, 0xFF, EEPROM_SIZE);
+  dump[0] = LOG_MAGIC;
+  for (int i = 0; i < _keys; i++) {
+    if (_index[i].key == key)
+      continue;
+    uint16_t word = _index[i].word;
+    uint16_t n = 1 + valueWords(headerLen(logWord(word)));
+    memcpy(&dump[pos], logBytes(word), n * 4);
+    pos += n;
+  }
+  if (len) {
+    if (pos + 1 + valueWords(len) > LOG_WORDS)
+      return false;
+    dump[pos] = makeHeader(key, data, len);
+    memcpy(&dump[pos + 1], data, len);
+  }
+
+  CurieClear();
+  CurieRestoreMemory(dump, LOG_WORDS);
+  return begin();
+}
+
+bool EEPROMLogClass::compact()
+{
+  if (!_mounted)
+    return false;
+  return rewrite(EEPROM_LOG_NO_KEY, NULL, 0);
+}
+
+uint16_t EEPROMLogClass::freeBytes()
+{
+  if (!_mounted || _end + 1 >= LOG_WORDS)
+    return 0;
+  return (LOG_WORDS - _end - 1) * 4;
+}
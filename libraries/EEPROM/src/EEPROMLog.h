@@ -0,0 +1,95 @@
+/*
+  EEPROMLog.h - log structured key/value storage on the Curie EEPROM page
+  Copyright (c) 2017 Intel Corporation.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef EEPROM_LOG_H
+#define EEPROM_LOG_H
+
+#include "EEPROM.h"
+
+/***
+    EEPROMLogClass class.
+
+    Stores values by key as records appended to the 2 KB page: an update
+    programs only the words of the new record (a header and the value),
+    and the page is erased and rewritten with the live records only when
+    the log reaches its end. On the byte interface every changed byte
+    that isn't erased costs a page erase and 512 word writes.
+
+    The log uses the same page as EEPROM, so a sketch uses one or the
+    other; format() turns the page into an empty log. Power lost during a
+    compaction loses the log, as it loses the page for CurieWrite8().
+***/
+
+// Keys held in the RAM index
+#ifndef EEPROM_LOG_MAX_KEYS
+#define EEPROM_LOG_MAX_KEYS 32
+#endif
+
+#define EEPROM_LOG_MAX_VALUE 252 // bytes in one value
+#define EEPROM_LOG_NO_KEY 0xFFFF // reserved, the header of a free word
+
+struct EEPROMLogClass{
+
+    EEPROMLogClass() : _keys(0), _end(EEPROM_SIZE / 4), _mounted(false) {}
+
+    // scans the log and indexes the latest record of each key; false if
+    // the page doesn't hold a log
+    bool begin();
+    // erases the page as an empty log
+    void format();
+
+    // stores len bytes under key, skipped when the value is already the
+    // same; false if len is too big or nothing makes room for it
+    bool write( uint16_t key, const void *data, uint8_t len );
+    // copies up to len bytes of the value; returns its stored length, or
+    // -1 when key has none
+    int read( uint16_t key, void *data, uint8_t len );
+    bool exists( uint16_t key )          { return find( key ) >= 0; }
+    bool remove( uint16_t key );
+
+    // rewrites the page with only the live records
+    bool compact();
+
+    uint16_t freeBytes();
+    uint8_t count()                      { return _keys; }
+
+    template< typename T > T &get( uint16_t key, T &t ){
+        read( key, &t, sizeof(T) );
+        return t;
+    }
+
+    template< typename T > const T &put( uint16_t key, const T &t ){
+        write( key, &t, sizeof(T) );
+        return t;
+    }
+
+private:
+    int find( uint16_t key );
+    void index( uint16_t key, uint16_t word, uint8_t len );
+    bool append( uint16_t key, const void *data, uint8_t len );
+    bool rewrite( uint16_t key, const void *data, uint8_t len );
+
+    struct {
+        uint16_t key;
+        uint16_t word;                   // header of the latest record
+    } _index[EEPROM_LOG_MAX_KEYS];
+    uint8_t _keys;
+    uint16_t _end;                       // first free word
+    bool _mounted;
+};
+
+extern EEPROMLogClass EEPROMLog;
+#endif
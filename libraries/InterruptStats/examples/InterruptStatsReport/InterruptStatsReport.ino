@@ -0,0 +1,46 @@
+/*
+ * InterruptStatsReport.ino: prints, every few seconds, how often each
+ * interrupt ran and how long its handler took, to find the handlers that
+ * hurt the latency of the others.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+#include <InterruptStats.h>
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial);
+  if (!interruptStatsEnable(true))
+    Serial.println("interrupt statistics need a newer system library");
+}
+
+void loop() {
+  // let the sketch's own work run: here, some analogRead() and timer1
+  delay(5000);
+  analogRead(A0);
+  tone(13, 1000, 100);
+
+  interruptStatsPrint(Serial);
+  Serial.println();
+  interruptStatsReset();
+}
+
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "InterruptStats.h"
+#include <board.h>
+
+/* Only in a rebuilt system library; without them there are no statistics */
+extern "C" void interrupt_stats_enable(int enable) __attribute__((weak));
+extern "C" void interrupt_stats_reset(void) __attribute__((weak));
+extern "C" const struct interrupt_stats *interrupt_stats_get(unsigned int irq) __attribute__((weak));
+
+/* From IRQ_TIMER0 on, as in board.h */
+static const char * const irqNames[] = {
+    "TIMER0", "TIMER1",
+    "I2C0_RX_AVAIL", "I2C0_TX_REQ", "I2C0_STOP_DET", "I2C0_ERR",
+    "I2C1_RX_AVAIL", "I2C1_TX_REQ", "I2C1_STOP_DET", "I2C1_ERR",
+    "SPI0_ERR", "SPI0_RX_AVAIL", "SPI0_TX_REQ",
+    "SPI1_ERR", "SPI1_RX_AVAIL", "SPI1_TX_REQ",
+    "ADC", "ADC_ERR", "GPIO0", "GPIO1",
+    "I2C_MST0", "I2C_MST1", "SPI_MST0", "SPI_MST1", "SPI_SLV",
+    "UART0", "UART1", "I2S", "GPIO", "PWM_TIMER", "USB", "RTC", "WDOG",
+    "DMA_CHAN0", "DMA_CHAN1", "DMA_CHAN2", "DMA_CHAN3",
+    "DMA_CHAN4", "DMA_CHAN5", "DMA_CHAN6", "DMA_CHAN7",
+    "MAILBOXES", "COMPARATORS", "SYS_PMU", "DMA_CHANS_ERR",
+    "SRAM_CTLR", "FLASH0_CTLR", "FLASH1_CTLR", "ALWAYS_ON_TMR",
+    "ADC_PWR", "ADC_CALIB", "ALWAYS_ON_GPIO",
+};
+
+const char *irqName(unsigned int irq)
+{
+    if (irq < IRQ_TIMER0 || irq - IRQ_TIMER0 >= sizeof(irqNames) / sizeof(irqNames[0]))
+        return "";
+    return irqNames[irq - IRQ_TIMER0];
+}
+
+bool interruptStatsEnable(bool enable)
+{
+    if (!interrupt_stats_enable)
+        return false;
+    interrupt_stats_enable(enable);
+    return true;
+}
+
+void interruptStatsReset(void)
+{
+    if (interrupt_stats_reset)
+        interrupt_stats_reset();
+}
+
+void interruptStatsPrint(Print &out)
+{
+    if (!interrupt_stats_get) {
+        out.println("no interrupt statistics in this system library");
+        return;
+    }
+    out.println("irq  name              count   avg us   max us   lat us");
+    for (unsigned int irq = IRQ_TIMER0; irq <= IRQ_ALWAYS_ON_GPIO; irq++) {
+        const struct interrupt_stats *s = interrupt_stats_get(irq);
+        char line[72];
+
+        if (s == NULL || s->count == 0)
+            continue;
+        /* copied with the interrupts masked, as a handler may update it */
+        uint32_t flags = interrupt_lock();
+        struct interrupt_stats copy = *s;
+        interrupt_unlock(flags);
+
+        uint64_t avg = copy.total_cycles / copy.count;
+        snprintf(line, sizeof(line), "%3u  %-14s %8lu %8lu %8lu", irq, irqName(irq),
+                 (unsigned long)copy.count,
+                 (unsigned long)(cyclesToNanos((uint32_t)avg) / 1000),
+                 (unsigned long)(cyclesToNanos(copy.max_cycles) / 1000));
+        out.print(line);
+        if (irq == IRQ_TIMER0 || irq == IRQ_TIMER1) {
+            snprintf(line, sizeof(line), " %8lu",
+                     (unsigned long)(cyclesToNanos(copy.max_latency) / 1000));
+            out.println(line);
+        } else {
+            out.println("        -");
+        }
+    }
+}
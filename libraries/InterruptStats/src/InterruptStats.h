@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef INTERRUPTSTATS_H
+#define INTERRUPTSTATS_H
+
+#include <Arduino.h>
+#include <interrupt.h>
+
+/*
+ * Name of an IRQ of board.h, e.g. "UART0" for IRQ_UART0_INTR
+ */
+const char *irqName(unsigned int irq);
+
+/*
+ * Turns the statistics of interrupt_stats_enable() on or off. Returns false
+ * if the system library was built without them.
+ */
+bool interruptStatsEnable(bool enable);
+
+/*
+ * Clears the statistics, as interrupt_stats_reset()
+ */
+void interruptStatsReset(void);
+
+/*
+ * Prints one line per IRQ that ran since interruptStatsEnable() or
+ * interruptStatsReset(): its number and name, the count, the average and
+ * the longest handler time and, for the timers, the worst latency, all in
+ * microseconds.
+ */
+void interruptStatsPrint(Print &out);
+
+#endif
@@ -27,6 +27,8 @@
  */
 
 #include <malloc.h>
+#include <stdlib.h>
+#include "Arduino.h"
 #include "MemoryFree.h"
 
 extern char __start_heap;
@@ -34,6 +36,33 @@ extern char __end_heap;
 extern char __stack_size;
 extern char __stack_start;
 
+#define STACK_PAINT         0xA5A5A5A5
+#define STACK_PAINT_MARGIN  64
+
+/* Runs before setup(), while the stack is still shallow; everything below
+ * the current frame, minus a margin, is painted */
+__attribute__((constructor))
+static void paintStack(void)
+{
+    volatile uint32_t *p = (volatile uint32_t *)
+        (((int)&__stack_start - (int)&__stack_size + 3) & ~3);
+    volatile uint32_t *top = (volatile uint32_t *)
+        (((int)__builtin_frame_address(0) - STACK_PAINT_MARGIN) & ~3);
+
+    while (p < top)
+        *p++ = STACK_PAINT;
+}
+
+int freeStackMin(void) {
+    const uint32_t *p = (const uint32_t *)
+        (((int)&__stack_start - (int)&__stack_size + 3) & ~3);
+    const uint32_t *start = p;
+
+    while (p < (const uint32_t *)&__stack_start && *p == STACK_PAINT)
+        p++;
+    return (int)p - (int)start;
+}
+
 int freeStack() {
     int stack_end;
     int mark;
@@ -56,3 +85,123 @@ int freeMemory (void) {
     int stack = freeStack();
     return (stack < 0) ? heap : stack + heap;
 }
+
+int largestFreeBlock(void) {
+    /* The biggest size malloc() accepts, by bisection; freed blocks go
+     * straight back where they came from */
+    int lo = 0;
+    int hi = freeHeap();
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        void *p = malloc(mid);
+        if (p) {
+            free(p);
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+int heapFragmentation(void) {
+    int total = freeHeap();
+
+    if (total <= 0)
+        return 0;
+    return 100 - (int)((int64_t)largestFreeBlock() * 100 / total);
+}
+
+/* Each traced block is preceded by its tag index and size; 8 bytes keep
+ * malloc()'s alignment */
+typedef struct {
+    uint32_t index;
+    uint32_t size;
+} TraceHeader;
+
+static MemoryTrace traces[MEMORY_TRACE_TAGS];
+static int traceCount;
+
+static int traceIndex(const char *tag) {
+    int i;
+
+    if (!tag)
+        tag = "untagged";
+    for (i = 0; i < traceCount; i++)
+        if (traces[i].tag == tag)
+            return i;
+    if (traceCount == MEMORY_TRACE_TAGS - 1) {
+        traces[traceCount].tag = "other";
+        traceCount++;
+    }
+    if (traceCount == MEMORY_TRACE_TAGS)
+        return MEMORY_TRACE_TAGS - 1;
+    traces[traceCount].tag = tag;
+    return traceCount++;
+}
+
+void *tracedMalloc(size_t size, const char *tag) {
+    TraceHeader *h = (TraceHeader *)malloc(sizeof(TraceHeader) + size);
+
+    if (!h)
+        return NULL;
+
+    uint32_t saved = interrupt_lock();
+    MemoryTrace *t = &traces[traceIndex(tag)];
+    h->index = t - traces;
+    h->size = size;
+    t->allocs++;
+    t->bytes += size;
+    if (t->bytes > t->peak)
+        t->peak = t->bytes;
+    interrupt_unlock(saved);
+
+    return h + 1;
+}
+
+void tracedFree(void *ptr) {
+    TraceHeader *h = (TraceHeader *)ptr - 1;
+
+    if (!ptr)
+        return;
+
+    uint32_t saved = interrupt_lock();
+    MemoryTrace *t = &traces[h->index];
+    t->frees++;
+    t->bytes -= h->size;
+    interrupt_unlock(saved);
+
+    free(h);
+}
+
+int memoryTraceCount(void) {
+    return traceCount;
+}
+
+int memoryTraceGet(int index, MemoryTrace *trace) {
+    if (index < 0 || index >= traceCount || !trace)
+        return 0;
+
+    uint32_t saved = interrupt_lock();
+    *trace = traces[index];
+    interrupt_unlock(saved);
+    return 1;
+}
+
+void memoryTracePrint(Print &out) {
+    MemoryTrace t;
+    int i;
+
+    for (i = 0; memoryTraceGet(i, &t); i++) {
+        out.print(t.tag);
+        out.print(": allocs ");
+        out.print(t.allocs);
+        out.print(", frees ");
+        out.print(t.frees);
+        out.print(", bytes ");
+        out.print(t.bytes);
+        out.print(", peak ");
+        out.println(t.peak);
+    }
+}
@@ -18,6 +18,9 @@
 #ifndef MEMORYFREE_H
 #define MEMORYFREE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,8 +44,68 @@ int freeStack(void);
  * space will be returned. */
 int freeMemory(void);
 
+/* largestFreeBlock: returns the size (in bytes) of the biggest single
+ * allocation 'malloc()' can currently satisfy. Found by trial allocations,
+ * so it takes a few dozen microseconds; don't call it from an ISR. */
+int largestFreeBlock(void);
+
+/* heapFragmentation: returns the percentage of free heap that is not part of
+ * the largest free block; 0 means all free space is in one piece. */
+int heapFragmentation(void);
+
+/* freeStackMin: returns the smallest amount of free stack there has been since
+ * boot, measured by painting the unused stack when the sketch starts. */
+int freeStackMin(void);
+
+/* tracedMalloc/tracedFree: malloc() and free() that keep allocation counts and
+ * bytes per tag. The tag is compared by address, so use a string literal or
+ * __func__; NULL counts as "untagged". Only free tracedMalloc() memory with
+ * tracedFree(). Each allocation costs 8 bytes of header. */
+void *tracedMalloc(size_t size, const char *tag);
+void tracedFree(void *ptr);
+
+#define MEMORY_TRACE_TAGS 16
+
+typedef struct {
+    const char *tag;
+    uint32_t allocs;    /* calls since boot */
+    uint32_t frees;
+    uint32_t bytes;     /* bytes currently allocated */
+    uint32_t peak;      /* most bytes allocated at once */
+} MemoryTrace;
+
+/* memoryTraceCount/memoryTraceGet: the tags seen so far, in first-use order.
+ * Tags beyond MEMORY_TRACE_TAGS are added up in the last entry, "other". */
+int memoryTraceCount(void);
+int memoryTraceGet(int index, MemoryTrace *trace);
+
 #ifdef __cplusplus
 }
+
+#include "new.h"
+
+class Print;
+
+/* prints one line per tag: tag, allocs, frees, bytes, peak */
+void memoryTracePrint(Print &out);
+
+/* C++ objects on tracedMalloc() memory:
+ *   Node *n = tracedNew<Node>("nodes", arg);  ...  tracedDelete(n); */
+template <typename T, typename... Args>
+T *tracedNew(const char *tag, Args&&... args)
+{
+    void *p = tracedMalloc(sizeof(T), tag);
+    return p ? new (p) T(static_cast<Args&&>(args)...) : NULL;
+}
+
+template <typename T>
+void tracedDelete(T *obj)
+{
+    if (obj) {
+        obj->~T();
+        tracedFree(obj);
+    }
+}
 #endif
 
 #endif
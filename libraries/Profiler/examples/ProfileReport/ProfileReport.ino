@@ -0,0 +1,64 @@
+/*
+ * ProfileReport.ino: profiles a sketch doing some float maths and some
+ * pin toggling, and prints the histogram every 10 seconds. Paste the PROF
+ * lines through
+ *
+ *     arc-elf32-addr2line -f -e ProfileReport.ino.elf <addresses>
+ *
+ * (the .elf is in the IDE's build folder, shown with verbose compile
+ * output) to see which functions the time went to.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ * See the bottom of this file for the license terms.
+ */
+
+#include <Profiler.h>
+
+uint16_t histogram[2048];
+volatile float result;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial);
+
+  pinMode(2, OUTPUT);
+  if (!profilerBegin(histogram, 2048, 1000)) {
+    Serial.println("profilerBegin() failed");
+  }
+}
+
+void loop() {
+  static unsigned long last = millis();
+
+  for (int i = 1; i < 200; i++) {
+    result = sqrtf(result + i) * sinf(i);
+  }
+  for (int i = 0; i < 200; i++) {
+    digitalWrite(2, HIGH);
+    digitalWrite(2, LOW);
+  }
+
+  if (millis() - last >= 10000) {
+    profilerPrint(Serial);
+    profilerReset();
+    last = millis();
+  }
+}
+
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
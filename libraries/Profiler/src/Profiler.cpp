@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Profiler.h"
+#include <hwtimer.h>
+
+/* flash.ld */
+extern char __text_start[], __text_end[];
+
+static hwtimer_t timer;
+static uint16_t *histogram;
+static uint16_t buckets;
+static uint8_t shift;
+static uint32_t rate;
+static volatile uint32_t samples;
+static volatile uint32_t outside;
+
+static void sample(void *arg)
+{
+    uint32_t pc;
+
+    // interrupt entry left the interrupted PC in ilink, and this runs in
+    // the timer1 handler before anything can overwrite it
+    __asm__ volatile ("mov %0, ilink" : "=r" (pc));
+
+    samples++;
+    uint32_t offset = pc - (uint32_t)__text_start;
+    if (pc < (uint32_t)__text_start || pc >= (uint32_t)__text_end) {
+        outside++;
+        return;
+    }
+    uint16_t *bucket = &histogram[offset >> shift];
+    if (*bucket != 0xFFFF)
+        (*bucket)++;
+}
+
+bool profilerBegin(uint16_t *b, uint16_t count, uint32_t hz)
+{
+    uint32_t size = __text_end - __text_start;
+
+    if (hz == 0 || count == 0)
+        return false;
+
+    profilerEnd();
+    // instructions are 16-bit aligned: 2 byte buckets are exact
+    for (shift = 1; (size >> shift) >= count; shift++)
+        if (shift == 16)
+            return false;
+
+    histogram = b;
+    buckets = count;
+    rate = hz;
+    profilerReset();
+
+    hwtimerInit(&timer, sample, NULL);
+    uint32_t period = F_CPU / hz;
+    return hwtimerStart(&timer, period, period) == 0;
+}
+
+void profilerEnd(void)
+{
+    if (histogram != NULL)
+        hwtimerStop(&timer);
+}
+
+void profilerReset(void)
+{
+    uint32_t saved = interrupt_lock();
+    memset(histogram, 0, buckets * sizeof(uint16_t));
+    samples = 0;
+    outside = 0;
+    interrupt_unlock(saved);
+}
+
+uint32_t profilerSamples(void)
+{
+    return samples;
+}
+
+void profilerPrint(Print &out)
+{
+    if (histogram == NULL)
+        return;
+
+    // Serial would otherwise be what gets profiled
+    bool running = hwtimerActive(&timer);
+    hwtimerStop(&timer);
+
+    out.print("PROF_BEGIN ");
+    out.print(samples);
+    out.print(' ');
+    out.print(rate);
+    out.print(' ');
+    out.println(1UL << shift);
+    for (uint16_t i = 0; i < buckets; i++) {
+        if (histogram[i] == 0)
+            continue;
+        out.print("PROF 0x");
+        out.print((uint32_t)__text_start + ((uint32_t)i << shift), HEX);
+        out.print(' ');
+        out.println(histogram[i]);
+    }
+    out.print("PROF_OUTSIDE ");
+    out.println(outside);
+    out.println("PROF_END");
+
+    if (running) {
+        uint32_t period = F_CPU / rate;
+        hwtimerStart(&timer, period, period);
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+/*
+ * Starts sampling the interrupted program counter hz times a second, from
+ * a timer1 callback (hwtimer.h), into count 16-bit buckets that evenly
+ * cover the sketch's code; a bucket spans the fewest bytes, a power of
+ * two, that fit. buckets must stay valid until profilerEnd(). Code that
+ * runs with interrupts locked is sampled where it unlocks, as is another
+ * priority 1 interrupt handler; priority 0 handlers are sampled.
+ *
+ * Returns false if hz or count is 0, or count buckets of 64 KB can't
+ * cover the code.
+ */
+bool profilerBegin(uint16_t *buckets, uint16_t count, uint32_t hz = 1000);
+
+void profilerEnd(void);
+
+/* Clears the histogram and counts */
+void profilerReset(void);
+
+/* Samples taken, including those outside the code (e.g. in the ROM) */
+uint32_t profilerSamples(void);
+
+/*
+ * Prints, with sampling paused,
+ *
+ *     PROF_BEGIN <samples> <hz> <bucket bytes>
+ *     PROF <bucket start address> <count>       (one per hit bucket)
+ *     PROF_OUTSIDE <count>
+ *     PROF_END
+ *
+ * Turn the addresses into functions with the sketch's .elf, which the IDE
+ * leaves in its build folder:  arc-elf32-addr2line -f -e sketch.elf 0x...
+ */
+void profilerPrint(Print &out);
+
+#endif
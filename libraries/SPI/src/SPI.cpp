@@ -17,10 +17,55 @@
  *
  */
 #include "SPI.h"
+#include "aux_regs.h"
+#include "dma_channel.h"
+
+/* largest transfer one DMA configuration can describe */
+#define SPI_DMA_CHUNK 0xFFFC
+/* request TX DMA while at most this many entries are queued, leaving room
+ * for a burst; RX is requested for every entry */
+#define SPI_DMA_TX_LEVEL 4
+/* added to twice the time a DMA chunk takes on the bus before waitAsync()
+ * gives up on it */
+#define SPI_DMA_TIMEOUT_MS 2
+
+#define SPI_REV2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define SPI_REV4(n) SPI_REV2(n), SPI_REV2(n + 2 * 16), SPI_REV2(n + 1 * 16), SPI_REV2(n + 3 * 16)
+#define SPI_REV6(n) SPI_REV4(n), SPI_REV4(n + 2 * 4), SPI_REV4(n + 1 * 4), SPI_REV4(n + 3 * 4)
+
+/* const, in .rodata: nothing at boot has to copy it */
+const uint8_t spi_bit_reverse_table[256] = {
+    SPI_REV6(0), SPI_REV6(2), SPI_REV6(1), SPI_REV6(3)
+};
+
+void spi_reverse_buffer(uint8_t *buf, size_t count)
+{
+    while (count && ((uint32_t)buf & 3)) {
+        *buf = SPI_REVERSE_8(*buf);
+        buf++;
+        count--;
+    }
+    for (; count >= 4; count -= 4, buf += 4)
+        *(uint32_t *)buf = spi_reverse_bytes(*(uint32_t *)buf);
+    while (count--) {
+        *buf = SPI_REVERSE_8(*buf);
+        buf++;
+    }
+}
 
 SPIClass SPI(SPIDEV_1);
 SPIClass SPI1(SPIDEV_0);
 
+static void spi0Isr(void)
+{
+    SPI1.fifoIsr();
+}
+
+static void spi1Isr(void)
+{
+    SPI.fifoIsr();
+}
+
 void SPIClass::setClockDivider(uint8_t clockDiv)
 {
     /* disable controller */
@@ -75,15 +120,17 @@ void SPIClass::begin()
         SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
 		
 		/* Enable clock to peripheral */
-		MMIO_REG_VAL(PERIPH_CLK_GATE_CTRL) |= enable_val;
+		power_clock_acquire(clock);
 		
         /* Configure defaults for clock divider, frame size and data mode */
         SPI_M_REG_VAL(spi_addr, BAUDR) = SPI_CLOCK_DIV4;
         SPI_M_REG_VAL(spi_addr, CTRL0) =
                 (frameSize << SPI_FSIZE_SHIFT) | (SPI_MODE0 << SPI_MODE_SHIFT);
 
-        /* Disable interrupts */
+        /* Disable interrupts; transferAsync() turns them on as needed */
         SPI_M_REG_VAL(spi_addr, IMR) = SPI_DISABLE_INT;
+        SET_INTERRUPT_HANDLER(irq, irq == SOC_SPIM0_INTERRUPT ? spi0Isr : spi1Isr);
+        SOC_UNMASK_INTERRUPTS(irq_mask);
         /* Enable at least one slave device (mandatory, though
          * SS signals are unused) */
         SPI_M_REG_VAL(spi_addr, SER) = 0x1;
@@ -103,6 +150,7 @@ void SPIClass::begin()
 }
 
 void SPIClass::end() {
+    waitAsync();
     /* Protect from a scheduler and prevent transactionBegin */
     uint32_t flags = interrupt_lock();
     /* Decrease the reference counter */
@@ -111,7 +159,8 @@ void SPIClass::end() {
     /* If there are no more references disable SPI */
     if (!initialized) {
         SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
-        MMIO_REG_VAL(PERIPH_CLK_GATE_CTRL) &= disable_val;
+        power_clock_release(clock);
+        dmaDeinit();
 #ifdef SPI_TRANSACTION_MISMATCH_LED
         inTransactionFlag = 0;
 #endif
@@ -169,3 +218,491 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
     }
     interrupts();
 }
+
+void SPIClass::dmaComplete(void *arg)
+{
+    SPIClass *spi = (SPIClass *)arg;
+
+    /* the last byte has been received, so the bus is idle */
+    SPI_M_REG_VAL(spi->spi_addr, DMACR) = 0;
+    spi->dmaRunning = false;
+    spi->asyncRxPos += spi->dmaChunkLen;
+    spi->inDmaCallback = true;
+    spi->asyncFinish();
+    spi->inDmaCallback = false;
+}
+
+void SPIClass::dmaError(void *arg)
+{
+    SPIClass *spi = (SPIClass *)arg;
+
+    /* keep what was received and finish from there on the FIFO: an in-place
+     * transfer(buf, count) has already overwritten what came before it */
+    spi->inDmaCallback = true;
+    spi->dmaAbort();
+    spi->inDmaCallback = false;
+}
+
+bool SPIClass::dmaInit(void)
+{
+    if (dmaReady)
+        return true;
+
+    if (dma_channel_acquire(&dmaRx) != DRV_RC_OK)
+        return false;
+    if (dma_channel_acquire(&dmaTx) != DRV_RC_OK) {
+        soc_dma_release(&dmaRx);
+        return false;
+    }
+
+    memset(&dmaRxCfg, 0, sizeof(dmaRxCfg));
+    dmaRxCfg.type = SOC_DMA_TYPE_PER2MEM;
+    dmaRxCfg.src_interface = dma_if_rx;
+    dmaRxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+    dmaRxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dmaRxCfg.xfer.src.addr = (void *)(spi_addr + DR);
+    dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+    dmaRxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    /* the last byte in is the end of the transfer */
+    dmaRxCfg.cb_done = dmaComplete;
+    dmaRxCfg.cb_done_arg = this;
+    dmaRxCfg.cb_err = dmaError;
+    dmaRxCfg.cb_err_arg = this;
+
+    memset(&dmaTxCfg, 0, sizeof(dmaTxCfg));
+    dmaTxCfg.type = SOC_DMA_TYPE_MEM2PER;
+    dmaTxCfg.dest_interface = dma_if_tx;
+    dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+    dmaTxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dmaTxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+    dmaTxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    dmaTxCfg.xfer.dest.addr = (void *)(spi_addr + DR);
+    dmaTxCfg.cb_err = dmaError;
+    dmaTxCfg.cb_err_arg = this;
+
+    dmaReady = true;
+    return true;
+}
+
+void SPIClass::dmaDeinit(void)
+{
+    if (!dmaReady)
+        return;
+    soc_dma_release(&dmaTx);
+    soc_dma_release(&dmaRx);
+    dmaReady = false;
+}
+
+static inline bool dmaReachable(const void *buf)
+{
+    uint32_t addr = (uint32_t)buf;
+    return addr < DCCM_START || addr >= DCCM_START + DCCM_SIZE;
+}
+
+/* completion is signalled from an interrupt, so neither DMA nor the FIFO
+ * interrupts can be waited for with interrupts masked or from an ISR */
+static inline bool canWaitForInterrupt(void)
+{
+    return (__builtin_arc_lr(ARC_V2_STATUS32) & ARC_V2_STATUS32_IE) &&
+        !__builtin_arc_lr(ARC_V2_AUX_IRQ_ACT);
+}
+
+/* where received bytes go when the caller doesn't want them, and what is
+ * sent when there is no TX buffer */
+static uint8_t dmaDiscard;
+static const uint8_t dmaFill = SPI_TX_FILL;
+
+bool SPIClass::dmaChunk(void)
+{
+    size_t left = asyncLen - asyncRxPos;
+
+    dmaChunkLen = (left > SPI_DMA_CHUNK) ? SPI_DMA_CHUNK : left;
+    if (asyncRx) {
+        dmaRxCfg.xfer.dest.addr = asyncRx + asyncRxPos;
+        dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+    } else {
+        dmaRxCfg.xfer.dest.addr = &dmaDiscard;
+        dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+    }
+    dmaRxCfg.xfer.size = dmaChunkLen;
+    if (asyncTx) {
+        dmaTxCfg.xfer.src.addr = (void *)(asyncTx + asyncRxPos);
+        dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+    } else {
+        dmaTxCfg.xfer.src.addr = (void *)&dmaFill;
+        dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+    }
+    dmaTxCfg.xfer.size = dmaChunkLen;
+
+    soc_dma_deconfig(&dmaRx);
+    soc_dma_deconfig(&dmaTx);
+    /* RX first, so it is listening before the first byte is clocked */
+    if (soc_dma_config(&dmaRx, &dmaRxCfg) != DRV_RC_OK ||
+        soc_dma_config(&dmaTx, &dmaTxCfg) != DRV_RC_OK ||
+        soc_dma_start_transfer(&dmaRx) != DRV_RC_OK)
+        return false;
+    if (soc_dma_start_transfer(&dmaTx) != DRV_RC_OK) {
+        soc_dma_stop_transfer(&dmaRx);
+        return false;
+    }
+    /* eight bits of BAUDR cycles each, at the 32 MHz base clock */
+    uint64_t busMs = (uint64_t)dmaChunkLen * 8 * SPI_M_REG_VAL(spi_addr, BAUDR) /
+        (CLOCK_SPEED * 1000UL);
+    dmaTimeout = 2 * busMs + SPI_DMA_TIMEOUT_MS;
+    dmaStarted = millis();
+    dmaRunning = true;
+    SPI_M_REG_VAL(spi_addr, DMACR) = SPI_DMACR_RDMAE | SPI_DMACR_TDMAE;
+    return true;
+}
+
+/* Stops the running chunk, timed out or failed, and hands the rest of the
+ * transfer to the FIFO interrupts, from the first byte not yet received */
+void SPIClass::dmaAbort(void)
+{
+    uint32_t flags = interrupt_lock();
+    size_t got = 0;
+
+    if (!dmaRunning) {
+        /* completed meanwhile */
+        interrupt_unlock(flags);
+        return;
+    }
+    dmaRunning = false;
+    SPI_M_REG_VAL(spi_addr, DMACR) = 0;
+    soc_dma_stop_transfer(&dmaTx);
+    soc_dma_stop_transfer(&dmaRx);
+
+    /* what TX DMA already queued still goes out; its replies stay in the
+     * RX FIFO. Bounded in case the bus itself is stuck */
+    uint32_t start = cycles();
+    while (((SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_BUSY) ||
+            !(SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_TFE)) &&
+           cycles() - start < SPI_DMA_TIMEOUT_MS * 1000UL * CLOCK_SPEED)
+        ;
+
+    if (asyncRx) {
+        got = (uint8_t *)soc_dma_get_dest_addr(&dmaRx) - (asyncRx + asyncRxPos);
+        if (got > dmaChunkLen)
+            got = dmaChunkLen;
+    } else if (asyncTx) {
+        /* nothing is kept, so whatever was sent is done */
+        got = (const uint8_t *)soc_dma_get_src_addr(&dmaTx) - (asyncTx + asyncRxPos);
+        if (got > dmaChunkLen)
+            got = dmaChunkLen;
+    }
+    for (uint32_t n = SPI_M_REG_VAL(spi_addr, RXFL); n > 0; n--) {
+        uint8_t b = SPI_M_REG_VAL(spi_addr, DR);
+        if (asyncRx && asyncRxPos + got < asyncLen)
+            asyncRx[asyncRxPos + got++] = b;
+    }
+
+    /* DMA sends the buffer as it is */
+    asyncReverse = false;
+    fifoStart(asyncRxPos + got);
+    interrupt_unlock(flags);
+}
+
+bool SPIClass::dmaStart(void)
+{
+    if ((asyncTx && !dmaReachable(asyncTx)) || (asyncRx && !dmaReachable(asyncRx)) ||
+        !dmaInit())
+        return false;
+
+    SPI_M_REG_VAL(spi_addr, DMATDLR) = SPI_DMA_TX_LEVEL;
+    SPI_M_REG_VAL(spi_addr, DMARDLR) = 0;
+    asyncRxPos = 0;
+    asyncBusy = true;
+    if (!dmaChunk()) {
+        asyncBusy = false;
+        return false;
+    }
+    return true;
+}
+
+size_t SPIClass::dmaTransfer(const uint8_t *tx, uint8_t *rx, size_t count)
+{
+    if (!canWaitForInterrupt())
+        return 0;
+
+    asyncTx = tx;
+    asyncRx = rx;
+    asyncLen = count;
+    asyncCallback = NULL;
+    if (!dmaStart())
+        return 0;
+    /* one chunk per start: the driver disables the channels once the
+     * completion callback returns */
+    for (size_t done = 0;; done = asyncRxPos) {
+        waitAsync();
+        if (asyncRxPos == done || asyncRxPos >= asyncLen)
+            break;
+        asyncBusy = true;
+        if (!dmaChunk()) {
+            asyncBusy = false;
+            break;
+        }
+    }
+    return asyncRxPos;
+}
+
+void SPIClass::asyncFinish(void)
+{
+    SPICallback callback = asyncCallback;
+
+    asyncCallback = NULL;
+    if (queueHead) {
+        /* on to the next queued transfer, staying busy until the last */
+        SPITransaction *t = queueHead;
+        if (!t->device->hardwareCS)
+            fastPinHigh(&t->device->cs);
+        queueHead = t->next;
+        if (queueHead)
+            queueStart();
+        else {
+            queueTail = NULL;
+            asyncBusy = false;
+        }
+    } else {
+        asyncBusy = false;
+    }
+    if (callback)
+        callback();
+}
+
+void SPIClass::fifoIsr(void)
+{
+    uint32_t rxLevel = SPI_M_REG_VAL(spi_addr, RXFL);
+
+    while (rxLevel--) {
+        uint8_t b = SPI_M_REG_VAL(spi_addr, DR);
+        if (asyncRx)
+            asyncRx[asyncRxPos] = asyncReverse ? SPI_REVERSE_8(b) : b;
+        asyncRxPos++;
+    }
+    if (asyncRxPos >= asyncLen) {
+        SPI_M_REG_VAL(spi_addr, IMR) = SPI_DISABLE_INT;
+        asyncFinish();
+        return;
+    }
+
+    /* each byte sent brings one back, so keeping no more than a FIFO's
+     * worth in flight means RX can't overflow */
+    while (asyncTxPos < asyncLen && asyncTxPos - asyncRxPos < SPI_FIFO_DEPTH) {
+        uint8_t b = asyncTx ? asyncTx[asyncTxPos] : SPI_TX_FILL;
+        asyncTxPos++;
+        SPI_M_REG_VAL(spi_addr, DR) = asyncReverse ? SPI_REVERSE_8(b) : b;
+    }
+
+    /* come back when half of it has arrived, while TX still has the other
+     * half to send, or for the tail */
+    uint32_t inFlight = asyncTxPos - asyncRxPos;
+    if (inFlight > SPI_FIFO_DEPTH / 2)
+        inFlight = SPI_FIFO_DEPTH / 2;
+    SPI_M_REG_VAL(spi_addr, RXFTLR) = inFlight - 1;
+}
+
+void SPIClass::fifoStart(size_t pos)
+{
+    asyncTxPos = pos;
+    asyncRxPos = pos;
+    asyncBusy = true;
+
+    uint32_t flags = interrupt_lock();
+    fifoIsr();
+    SPI_M_REG_VAL(spi_addr, IMR) = SPI_INT_RXFIM;
+    interrupt_unlock(flags);
+}
+
+void SPIClass::transferAsync(const void *txBuf, void *rxBuf, size_t len,
+                             SPICallback callback)
+{
+    waitAsync();
+    setFrameSize(SPI_8_BIT);
+
+    if (len == 0 || !canWaitForInterrupt()) {
+        /* nothing to wait for, or nothing to wait with */
+        transfer(txBuf, rxBuf, len);
+        if (callback)
+            callback();
+        return;
+    }
+
+    asyncTx = (const uint8_t *)txBuf;
+    asyncRx = (uint8_t *)rxBuf;
+    asyncLen = len;
+    asyncCallback = callback;
+    asyncStart();
+}
+
+void SPIClass::asyncStart(void)
+{
+    asyncReverse = lsbFirst;
+    /* DMA sends the buffer as it is, and for a single chunk only, since a
+     * new one can't be started from the completion callback: a queued
+     * transfer following a DMA one goes through the FIFO */
+    if (!lsbFirst && !inDmaCallback && asyncLen >= SPI_DMA_THRESHOLD && asyncLen <= SPI_DMA_CHUNK &&
+        dmaStart())
+        return;
+    fifoStart(0);
+}
+
+void SPIClass::deviceInit(SPIDevice *device)
+{
+    if (device->hardwareCS && device->csPin != hwcs_pin)
+        device->hardwareCS = false;
+    if (device->hardwareCS) {
+        /* SER already selects slave 0, so the line follows every transfer
+         * once the pad is muxed to the controller */
+        SET_PIN_MODE(g_APinDescription[device->csPin].ulSocPin, SPI_MUX_MODE);
+        pinmuxMode[device->csPin] = SPI_MUX_MODE;
+    } else {
+        digitalWrite(device->csPin, HIGH);
+        pinMode(device->csPin, OUTPUT);
+        fastPinInit(&device->cs, device->csPin);
+    }
+    device->ready = true;
+}
+
+/* Runs queueHead: from queue() when idle, or from the completion of the
+ * one before it */
+void SPIClass::queueStart(void)
+{
+    SPITransaction *t = queueHead;
+
+    applySettings(t->device->settings);
+    if (!t->device->hardwareCS)
+        fastPinLow(&t->device->cs);
+    asyncTx = (const uint8_t *)t->tx;
+    asyncRx = (uint8_t *)t->rx;
+    asyncLen = t->len;
+    asyncCallback = t->callback;
+    asyncStart();
+}
+
+bool SPIClass::queue(SPITransaction *t)
+{
+    if (t->len == 0)
+        return false;
+    if (!t->device->ready)
+        deviceInit(t->device);
+    t->next = NULL;
+
+    uint32_t flags = interrupt_lock();
+    /* a running transferAsync() is finished first */
+    while (!queueTail && asyncBusy) {
+        interrupt_unlock(flags);
+        flags = interrupt_lock();
+    }
+    if (queueTail) {
+        queueTail->next = t;
+        queueTail = t;
+    } else {
+        queueHead = queueTail = t;
+        queueStart();
+    }
+    interrupt_unlock(flags);
+    return true;
+}
+
+void SPIClass::transferTxOnly(const uint8_t *tx, size_t count)
+{
+    uint8_t fill = lsbFirst ? SPI_REVERSE_8(SPI_TX_FILL) : SPI_TX_FILL;
+
+    /* In transmit-only mode nothing is written to the RX FIFO, so there is
+     * nothing to drain and the TX FIFO can be kept full */
+    SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
+    SPI_M_REG_VAL(spi_addr, CTRL0) = (SPI_M_REG_VAL(spi_addr, CTRL0)
+        & ~SPI_TMOD_MASK) | SPI_TMOD_TX;
+    SPI_M_REG_VAL(spi_addr, SPIEN) |= SPI_ENABLE;
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t b = fill;
+        if (tx)
+            b = lsbFirst ? SPI_REVERSE_8(tx[i]) : tx[i];
+        while (!(SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_TFNF))
+            ;
+        SPI_M_REG_VAL(spi_addr, DR) = b;
+    }
+    while (!(SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_TFE))
+        ;
+    while (SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_BUSY)
+        ;
+
+    SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
+    SPI_M_REG_VAL(spi_addr, CTRL0) &= ~SPI_TMOD_MASK;
+    SPI_M_REG_VAL(spi_addr, SPIEN) |= SPI_ENABLE;
+}
+
+void SPIClass::transfer(const void *txBuf, void *rxBuf, size_t count)
+{
+    const uint8_t *tx = (const uint8_t *)txBuf;
+    uint8_t *rx = (uint8_t *)rxBuf;
+    uint8_t fill = lsbFirst ? SPI_REVERSE_8(SPI_TX_FILL) : SPI_TX_FILL;
+    size_t txPos = 0, rxPos = 0;
+
+    waitAsync();
+    setFrameSize(SPI_8_BIT);
+    if (!rx) {
+        transferTxOnly(tx, count);
+        return;
+    }
+
+    if (!lsbFirst && count >= SPI_DMA_THRESHOLD) {
+        txPos = rxPos = dmaTransfer(tx, rx, count);
+        if (tx)
+            tx += txPos;
+    }
+
+    /* Keep up to a FIFO's worth in flight, so TX never waits for RX to be
+     * drained */
+    while (rxPos < count) {
+        while (txPos < count && txPos - rxPos < SPI_FIFO_DEPTH) {
+            uint8_t b = fill;
+            if (tx) {
+                b = *tx++;
+                if (lsbFirst)
+                    b = SPI_REVERSE_8(b);
+            }
+            SPI_M_REG_VAL(spi_addr, DR) = b;
+            txPos++;
+        }
+        for (uint32_t n = SPI_M_REG_VAL(spi_addr, RXFL); n > 0; n--) {
+            uint8_t b = SPI_M_REG_VAL(spi_addr, DR);
+            rx[rxPos++] = lsbFirst ? SPI_REVERSE_8(b) : b;
+        }
+    }
+}
+
+void SPIClass::transferFrames(void *buf, size_t count, uint32_t size)
+{
+    uint16_t *p16 = (uint16_t *)buf;
+    uint32_t *p32 = (uint32_t *)buf;
+    /* SPI_REVERSE_16/24 for any frame size */
+    uint32_t shift = SPI_32_BIT - size;
+    size_t txPos = 0, rxPos = 0;
+
+    waitAsync();
+    setFrameSize(size);
+
+    /* A FIFO entry holds a whole frame: keep up to a FIFO's worth in
+     * flight, in place since each entry is read back before it is reused */
+    while (rxPos < count) {
+        while (txPos < count && txPos - rxPos < SPI_FIFO_DEPTH) {
+            uint32_t w = (size == SPI_16_BIT) ? p16[txPos] : p32[txPos];
+            if (lsbFirst)
+                w = SPI_REVERSE_32(w) >> shift;
+            SPI_M_REG_VAL(spi_addr, DR) = w;
+            txPos++;
+        }
+        for (uint32_t n = SPI_M_REG_VAL(spi_addr, RXFL); n > 0; n--) {
+            uint32_t w = SPI_M_REG_VAL(spi_addr, DR);
+            if (lsbFirst)
+                w = SPI_REVERSE_32(w) >> shift;
+            if (size == SPI_16_BIT)
+                p16[rxPos] = w;
+            else
+                p32[rxPos] = w;
+            rxPos++;
+        }
+    }
+}
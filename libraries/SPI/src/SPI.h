@@ -18,6 +18,8 @@
 #include <Arduino.h>
 
 #include "SPI_registers.h"
+#include "soc_dma.h"
+#include "power.h"
 
 /* SPI_HAS_TRANSACTION means SPI has beginTransaction(), endTransaction(),
  * usingInterrupt(), and SPISetting(clock, bitOrder, dataMode) */
@@ -72,42 +74,103 @@
 
 #define NUM_SPIDEVS 2
 
+/* transfer(buf, count) of at least this many bytes is done by DMA, keeping
+ * the TX FIFO topped up so SCK runs without gaps. Buffers in DCCM, which
+ * the DMA engine can't reach, and calls with interrupts masked or from an
+ * ISR always use the FIFO loop. */
+#ifndef SPI_DMA_THRESHOLD
+#define SPI_DMA_THRESHOLD 32
+#endif
+
+/* Sent by transfer(tx, rx, count) and transferAsync() when tx is NULL */
+#ifndef SPI_TX_FILL
+#define SPI_TX_FILL 0xFF
+#endif
+
+/* Called once a transferAsync() has completed, from interrupt context */
+typedef void (*SPICallback)(void);
+
 class SPISettings {
 public:
-  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
+  /* constexpr, so settings built from constants cost nothing at run time */
+  constexpr SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) :
     /* Set frame size, bus mode and transfer mode */
-    ctrl0 = (SPI_8_BIT << SPI_FSIZE_SHIFT)
-            | ((dataMode << SPI_MODE_SHIFT) & SPI_MODE_MASK);
+    ctrl0((SPI_8_BIT << SPI_FSIZE_SHIFT)
+          | ((dataMode << SPI_MODE_SHIFT) & SPI_MODE_MASK)),
     /* Set SPI Clock Divider */
-    baudr = (SPI_BASE_CLOCK / clock) & SPI_CLOCK_MASK;
-
-    /* clock value passed is > than max supported;
-     * set baudr to 2 for max. speed */
-    if (baudr == 0)
-        baudr = 2;
-
+    baudr(clockDivider(clock)),
     /* Only MSBFIRST supported in hardware, need to swizzle the bits if
      * LSBFIRST selected */
-    lsbFirst = (bitOrder == LSBFIRST) ? true : false;
+    lsbFirst(bitOrder == LSBFIRST) {
   }
-  SPISettings() {
-    SPISettings(4000000, MSBFIRST, SPI_MODE0);
+  constexpr SPISettings() : SPISettings(4000000, MSBFIRST, SPI_MODE0) {
   }
 private:
+  /* clock value passed is > than max supported;
+   * set baudr to 2 for max. speed */
+  static constexpr uint32_t clockDivider(uint32_t clock) {
+    return ((SPI_BASE_CLOCK / clock) & SPI_CLOCK_MASK) ?
+        ((SPI_BASE_CLOCK / clock) & SPI_CLOCK_MASK) : 2;
+  }
+
   uint32_t ctrl0;
   uint32_t baudr;
   bool lsbFirst;
   friend class SPIClass;
 };
 
+/* Pin SS of the SPI bus can be muxed to the controller's own slave select,
+ * which it drives around every run of frames without any CPU time; the
+ * line goes high again whenever the TX FIFO runs dry */
+#define SPI_NO_HARDWARE_CS 0xFF
+
+/* A slave on the bus, for SPIClass::queue(): its settings and chip select.
+ * With hardwareCS the controller's slave select is used where the pin has
+ * one (see SPIClass::hardwareCSPin()), otherwise the pin is driven as a
+ * GPIO, low for the length of each queued transfer. */
+class SPIDevice {
+public:
+  SPIDevice(uint8_t csPin, SPISettings settings, bool hardwareCS = false) :
+    settings(settings), csPin(csPin), hardwareCS(hardwareCS), ready(false) {
+  }
+private:
+  SPISettings settings;
+  uint8_t csPin;
+  bool hardwareCS;
+  bool ready;
+  FastPin cs;
+  friend class SPIClass;
+};
+
+/* A transfer waiting in SPIClass::queue(). It belongs to the queue, and
+ * must stay valid, until its callback has run. */
+struct SPITransaction {
+  SPIDevice *device;
+  const void *tx;        /* NULL sends SPI_TX_FILL */
+  void *rx;              /* NULL drops what is received */
+  size_t len;
+  SPICallback callback;  /* from interrupt context, may be NULL */
+  SPITransaction *next;  /* used by the queue */
+};
+
 
 class SPIClass {
 public:
   SPIClass(int dev) {
 	  spi_addr = spidevs[dev][0];
-	  enable_val = spidevs[dev][1];
-	  disable_val = spidevs[dev][2];
-	  ss_gpio = spidevs[dev][3];
+	  clock = (dev == SPIDEV_0) ? POWER_CLOCK_SPI0 : POWER_CLOCK_SPI1;
+	  ss_gpio = spidevs[dev][1];
+	  dma_if_tx = (dev == SPIDEV_0) ? SOC_DMA_INTERFACE_SPIM0_TX : SOC_DMA_INTERFACE_SPIM1_TX;
+	  dma_if_rx = (dev == SPIDEV_0) ? SOC_DMA_INTERFACE_SPIM0_RX : SOC_DMA_INTERFACE_SPIM1_RX;
+	  irq = (dev == SPIDEV_0) ? SOC_SPIM0_INTERRUPT : SOC_SPIM1_INTERRUPT;
+	  irq_mask = (dev == SPIDEV_0) ? INT_SPI_MST_0_MASK : INT_SPI_MST_1_MASK;
+	  hwcs_pin = (dev == SPIDEV_1) ? SS : SPI_NO_HARDWARE_CS;
+	  dmaReady = false;
+	  dmaRunning = false;
+	  inDmaCallback = false;
+	  asyncBusy = false;
+	  queueHead = NULL;
+	  queueTail = NULL;
   }
 
   /* Initialize the SPI library */
@@ -131,6 +194,9 @@ public:
    * this function is used to gain exclusive access to the SPI bus
    * and configure the correct settings. */
   inline void beginTransaction(SPISettings settings) {
+      /* Transactions queue behind a transferAsync() still running for
+       * another device */
+      waitAsync();
       if (interruptMode > 0) {
           if (interruptMode < 8) {
               if (interruptMode & 1)
@@ -152,19 +218,12 @@ public:
       inTransactionFlag = 1;
 #endif
 
-      /* disable controller */
-      SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
-      /* Configure clock divider, frame size and data mode */
-      SPI_M_REG_VAL(spi_addr, BAUDR) = settings.baudr;
-      SPI_M_REG_VAL(spi_addr, CTRL0) = settings.ctrl0;
-      frameSize = SPI_8_BIT;
-      lsbFirst = settings.lsbFirst;
-      /* Enable controller */
-      SPI_M_REG_VAL(spi_addr, SPIEN) |= SPI_ENABLE;
+      applySettings(settings);
   }
 
   /* Write to the SPI bus (MOSI pin) and also receive (MISO pin) */
   inline uint8_t transfer(uint8_t data) {
+    waitAsync();
     setFrameSize(SPI_8_BIT);
     if (lsbFirst)
         return SPI_REVERSE_8(singleTransfer(SPI_REVERSE_8(data)));
@@ -173,6 +232,7 @@ public:
   }
 
   inline uint16_t transfer16(uint16_t data) {
+    waitAsync();
     setFrameSize(SPI_16_BIT);
     if (lsbFirst)
         return SPI_REVERSE_16(singleTransfer(SPI_REVERSE_16(data)));
@@ -181,6 +241,7 @@ public:
   }
 
   inline uint32_t transfer24(uint32_t data) {
+    waitAsync();
     setFrameSize(SPI_24_BIT);
     if (lsbFirst)
         return SPI_REVERSE_24(singleTransfer(SPI_REVERSE_24(data)));
@@ -189,6 +250,7 @@ public:
   }
 
   inline uint32_t transfer32(uint32_t data) {
+    waitAsync();
     setFrameSize(SPI_32_BIT);
     if (lsbFirst)
         return SPI_REVERSE_32(singleTransfer(SPI_REVERSE_32(data)));
@@ -196,13 +258,31 @@ public:
         return singleTransfer(data);
   }
 
+  /* Bulk transfers of 16, 24 (low bits of each word) and 32-bit frames,
+   * in place like transfer(buf, count) */
+  inline void transfer16(uint16_t *buf, size_t count) {
+      transferFrames(buf, count, SPI_16_BIT);
+  }
+
+  inline void transfer24(uint32_t *buf, size_t count) {
+      transferFrames(buf, count, SPI_24_BIT);
+  }
+
+  inline void transfer32(uint32_t *buf, size_t count) {
+      transferFrames(buf, count, SPI_32_BIT);
+  }
+
   inline void transfer(void *buf, size_t count) {
+      waitAsync();
       setFrameSize(SPI_8_BIT);
       size_t remaining = count;
       uint8_t *p = (uint8_t *)buf;
-      if (lsbFirst) {
-          for (uint32_t i = 0; i < count; i++)
-              p[i] = SPI_REVERSE_8(p[i]);
+      if (lsbFirst)
+          spi_reverse_buffer(p, count);
+      if (count >= SPI_DMA_THRESHOLD) {
+          size_t done = dmaTransfer(p, p, count);
+          p += done;
+          remaining -= done;
       }
       while (remaining > 0) {
           uint32_t transferSize = SPI_FIFO_DEPTH > remaining ? remaining : SPI_FIFO_DEPTH;
@@ -221,13 +301,42 @@ public:
               transferSize -= rxLevel;
           } while (transferSize);
       }
-      if (lsbFirst) {
-          p = (uint8_t *)buf;
-          for (uint32_t i = 0; i < count; i++)
-              p[i] = SPI_REVERSE_8(p[i]);
-      }
+      if (lsbFirst)
+          spi_reverse_buffer((uint8_t *)buf, count);
   }
 
+  /* Sends count bytes from tx while receiving into rx. tx may be NULL to
+   * send SPI_TX_FILL, rx may be NULL to drop what is received, in which
+   * case the controller runs transmit-only and the RX FIFO is never read.
+   * The buffers may be the same. */
+  void transfer(const void *txBuf, void *rxBuf, size_t count);
+
+  /* Starts a transfer of len bytes and returns straight away; callback, if
+   * not NULL, runs from interrupt context once it has completed. txBuf and
+   * rxBuf may be NULL as for transfer(tx, rx, count). Both buffers
+   * must stay valid until then. Large transfers outside DCCM use DMA, the
+   * rest the FIFO interrupts. With interrupts masked, or from an ISR, the
+   * transfer is done before returning.
+   * Other transfers and beginTransaction() wait for it to finish, so an ISR
+   * must not use the bus while one is running. */
+  void transferAsync(const void *txBuf, void *rxBuf, size_t len, SPICallback callback);
+
+  /* Adds a transfer to the queue and returns; queued transfers run back to
+   * back from interrupt context, each with its device's settings and chip
+   * select. Returns false, without queuing, for an empty transfer.
+   * Not for use inside beginTransaction() / endTransaction(). */
+  bool queue(SPITransaction *t);
+
+  /* The pin with a hardware slave select on this bus, or
+   * SPI_NO_HARDWARE_CS */
+  inline uint8_t hardwareCSPin(void) { return hwcs_pin; }
+
+  /* true while a transferAsync() or queued transfer is running */
+  inline bool busy(void) { return asyncBusy; }
+
+  /* SPI controller interrupt handler, used by transferAsync() */
+  void fifoIsr(void);
+
   /* After performing a group of transfers and releasing the chip select
    * signal, this function allows others to access the SPI bus */
   inline void endTransaction(void) {
@@ -276,8 +385,7 @@ public:
 private:
   int ss_gpio;
   uint32_t spi_addr;
-  uint32_t enable_val;
-  uint32_t disable_val;
+  enum power_clock clock;
   uint32_t initialized;
   uint32_t interruptMode;    /* 0=none, 1-7=mask, 8=global */
   uint32_t interruptMask[3]; /* which interrupts to mask */
@@ -286,6 +394,77 @@ private:
   #endif
   bool lsbFirst;
   uint32_t frameSize;
+  uint8_t dma_if_tx;
+  uint8_t dma_if_rx;
+  uint8_t irq;
+  uint32_t irq_mask;
+  bool dmaReady;
+  bool inDmaCallback;
+  struct soc_dma_channel dmaTx;
+  struct soc_dma_channel dmaRx;
+  struct soc_dma_cfg dmaTxCfg;
+  struct soc_dma_cfg dmaRxCfg;
+
+  /* the transfer in progress, by DMA or by the FIFO interrupts */
+  volatile bool asyncBusy;
+  bool asyncReverse;
+  const uint8_t *asyncTx;
+  uint8_t *asyncRx;
+  size_t asyncLen;
+  size_t asyncTxPos;
+  volatile size_t asyncRxPos;
+  uint16_t dmaChunkLen;
+  volatile bool dmaRunning;
+  uint32_t dmaStarted;      /* millis() when the chunk was started */
+  uint32_t dmaTimeout;      /* ms the chunk may take */
+  SPICallback asyncCallback;
+
+  uint8_t hwcs_pin;
+  SPITransaction *queueHead;
+  SPITransaction *queueTail;
+
+  /* a DMA chunk that hasn't completed well after it should have is
+   * stopped and the rest of the transfer done by the FIFO interrupts */
+  inline void waitAsync(void) {
+      while (asyncBusy)
+          if (dmaRunning && millis() - dmaStarted > dmaTimeout)
+              dmaAbort();
+  }
+
+  bool dmaInit(void);
+  void dmaDeinit(void);
+  bool dmaStart(void);
+  bool dmaChunk(void);
+  void dmaAbort(void);
+  /* returns the number of bytes transferred, 0 if DMA can't be used */
+  size_t dmaTransfer(const uint8_t *tx, uint8_t *rx, size_t count);
+  static void dmaComplete(void *arg);
+  static void dmaError(void *arg);
+  void asyncFinish(void);
+  void transferTxOnly(const uint8_t *tx, size_t count);
+  void transferFrames(void *buf, size_t count, uint32_t size);
+  void fifoStart(size_t pos);
+  void asyncStart(void);
+  void queueStart(void);
+  void deviceInit(SPIDevice *device);
+
+  inline void applySettings(const SPISettings &settings) {
+      lsbFirst = settings.lsbFirst;
+      /* The registers themselves hold the last settings applied, whichever
+       * of beginTransaction(), setClockDivider() or a frame size change
+       * wrote them; rewriting means cycling the controller */
+      if (SPI_M_REG_VAL(spi_addr, BAUDR) == settings.baudr &&
+          SPI_M_REG_VAL(spi_addr, CTRL0) == settings.ctrl0)
+          return;
+      /* disable controller */
+      SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
+      /* Configure clock divider, frame size and data mode */
+      SPI_M_REG_VAL(spi_addr, BAUDR) = settings.baudr;
+      SPI_M_REG_VAL(spi_addr, CTRL0) = settings.ctrl0;
+      frameSize = SPI_8_BIT;
+      /* Enable controller */
+      SPI_M_REG_VAL(spi_addr, SPIEN) |= SPI_ENABLE;
+  }
 
   inline void setFrameSize(uint32_t size) {
     if (frameSize != size) {
@@ -313,11 +492,11 @@ private:
 
     void init();
 	void set_dev(int dev);
-	int spidevs[NUM_SPIDEVS][4] =
+	int spidevs[NUM_SPIDEVS][2] =
     {
-        /* base addr.                     Clk. enable value    Clk. disable value    SS GPIO */
-        {(int)SOC_MST_SPI0_REGISTER_BASE, ENABLE_SPI_MASTER_0, DISABLE_SPI_MASTER_0, SPI0_CS},
-        {(int)SOC_MST_SPI1_REGISTER_BASE, ENABLE_SPI_MASTER_1, DISABLE_SPI_MASTER_1, SPI1_CS}
+        /* base addr.                     SS GPIO */
+        {(int)SOC_MST_SPI0_REGISTER_BASE, SPI0_CS},
+        {(int)SOC_MST_SPI1_REGISTER_BASE, SPI1_CS}
     };
 };
 
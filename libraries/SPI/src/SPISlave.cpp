@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2016 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+#include "SPISlave.h"
+#include "dma_channel.h"
+
+/* request TX DMA while at most this many entries are queued, leaving room
+ * for a burst; RX is requested for every entry */
+#define SPIS_DMA_TX_LEVEL 4
+
+/* how long disarm() waits for RX DMA to empty the FIFO, 100 us */
+#define SPIS_DRAIN_CYCLES (100UL * CLOCK_SPEED)
+
+/* sent when there is no response */
+#define SPIS_TX_FILL 0xFF
+
+SPISlaveClass SPISlave;
+
+extern "C" void spiSlavePinmux(void) __attribute__((weak));
+extern "C" void spiSlavePinmux(void)
+{
+}
+
+static void spiSlaveCsIsr(uint32_t cycles)
+{
+    SPISlave.csIsr();
+}
+
+static inline bool dmaReachable(const void *buf)
+{
+    uint32_t addr = (uint32_t)buf;
+    return addr < DCCM_START || addr >= DCCM_START + DCCM_SIZE;
+}
+
+/* where received bytes go without a receive buffer, and what is sent
+ * without a response */
+static uint8_t dmaDiscard;
+static const uint8_t dmaFill = SPIS_TX_FILL;
+
+void SPISlaveClass::dmaRxComplete(void *arg)
+{
+    SPISlaveClass *spis = (SPISlaveClass *)arg;
+
+    /* the buffer is full; the rest of the transaction is dropped */
+    spis->rxFull = true;
+}
+
+bool SPISlaveClass::dmaInit(void)
+{
+    if (dma_channel_acquire(&dmaRx) != DRV_RC_OK)
+        return false;
+    if (dma_channel_acquire(&dmaTx) != DRV_RC_OK) {
+        soc_dma_release(&dmaRx);
+        return false;
+    }
+
+    memset(&dmaRxCfg, 0, sizeof(dmaRxCfg));
+    dmaRxCfg.type = SOC_DMA_TYPE_PER2MEM;
+    dmaRxCfg.src_interface = SOC_DMA_INTERFACE_SPIS_RX;
+    dmaRxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+    dmaRxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dmaRxCfg.xfer.src.addr = (void *)(SOC_SLV_SPI_REGISTER_BASE + DR);
+    dmaRxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    dmaRxCfg.cb_done = dmaRxComplete;
+    dmaRxCfg.cb_done_arg = this;
+
+    memset(&dmaTxCfg, 0, sizeof(dmaTxCfg));
+    dmaTxCfg.type = SOC_DMA_TYPE_MEM2PER;
+    dmaTxCfg.dest_interface = SOC_DMA_INTERFACE_SPIS_TX;
+    dmaTxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dmaTxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+    dmaTxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    dmaTxCfg.xfer.dest.addr = (void *)(SOC_SLV_SPI_REGISTER_BASE + DR);
+    return true;
+}
+
+/* Sets up both channels for the next transaction and turns the controller
+ * on, so TX DMA fills the FIFO before the host clocks the first byte */
+bool SPISlaveClass::arm(void)
+{
+    if (txPending) {
+        txBuf = nextTx;
+        txLen = nextTxLen;
+        txPending = false;
+    }
+
+    rxArmed = rxBuf;
+    rxArmedSize = rxSize;
+    if (rxArmed && rxArmedSize) {
+        dmaRxCfg.xfer.dest.addr = rxArmed;
+        dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+        dmaRxCfg.xfer.size = rxArmedSize;
+    } else {
+        dmaRxCfg.xfer.dest.addr = &dmaDiscard;
+        dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+        dmaRxCfg.xfer.size = SPI_SLAVE_MAX_LEN;
+    }
+    if (txBuf && txLen) {
+        dmaTxCfg.xfer.src.addr = (void *)txBuf;
+        dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+        dmaTxCfg.xfer.size = txLen;
+    } else {
+        dmaTxCfg.xfer.src.addr = (void *)&dmaFill;
+        dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+        dmaTxCfg.xfer.size = SPI_SLAVE_MAX_LEN;
+    }
+    rxFull = false;
+
+    soc_dma_deconfig(&dmaRx);
+    soc_dma_deconfig(&dmaTx);
+    if (soc_dma_config(&dmaRx, &dmaRxCfg) != DRV_RC_OK ||
+        soc_dma_config(&dmaTx, &dmaTxCfg) != DRV_RC_OK ||
+        soc_dma_start_transfer(&dmaRx) != DRV_RC_OK)
+        return false;
+    if (soc_dma_start_transfer(&dmaTx) != DRV_RC_OK) {
+        soc_dma_stop_transfer(&dmaRx);
+        return false;
+    }
+    SPI_M_REG_VAL(SOC_SLV_SPI_REGISTER_BASE, SPIEN) = SPI_ENABLE;
+    SPI_M_REG_VAL(SOC_SLV_SPI_REGISTER_BASE, DMACR) = SPI_DMACR_RDMAE | SPI_DMACR_TDMAE;
+    return true;
+}
+
+/* Stops the transaction that just ended and returns how many bytes of it
+ * reached the receive buffer. Turning the controller off empties both
+ * FIFOs, so what the host didn't read of the response is dropped. */
+size_t SPISlaveClass::disarm(void)
+{
+    uint32_t base = SOC_SLV_SPI_REGISTER_BASE;
+    size_t received = 0;
+    uint32_t start = cycles();
+
+    /* the last bytes may still be on their way out of the RX FIFO; a stalled
+     * channel leaves them there and they are dropped */
+    while (!rxFull && SPI_M_REG_VAL(base, RXFL) && cycles() - start < SPIS_DRAIN_CYCLES) ;
+
+    SPI_M_REG_VAL(base, DMACR) = 0;
+    if (rxArmed && rxArmedSize)
+        received = rxFull ? rxArmedSize : soc_dma_get_dest_addr(&dmaRx) - (uint32_t)rxArmed;
+    soc_dma_stop_transfer(&dmaRx);
+    soc_dma_stop_transfer(&dmaTx);
+    SPI_M_REG_VAL(base, SPIEN) = SPI_DISABLE;
+    return received;
+}
+
+bool SPISlaveClass::begin(uint8_t pin, uint8_t mode)
+{
+    uint32_t base = SOC_SLV_SPI_REGISTER_BASE;
+
+    if (running)
+        return true;
+    if (pin >= NUM_DIGITAL_PINS || !dmaInit())
+        return false;
+
+    power_clock_acquire(POWER_CLOCK_SPIS);
+    SPI_M_REG_VAL(base, SPIEN) = SPI_DISABLE;
+    /* 8-bit frames, transmit and receive, MISO driven */
+    SPI_M_REG_VAL(base, CTRL0) =
+            (SPI_8_BIT << SPI_FSIZE_SHIFT) | ((mode & 3) << SPI_MODE_SHIFT);
+    /* DMA and the chip select pin do the work, not the controller's
+     * interrupts */
+    SPI_M_REG_VAL(base, IMR) = SPI_DISABLE_INT;
+    SPI_M_REG_VAL(base, DMATDLR) = SPIS_DMA_TX_LEVEL;
+    SPI_M_REG_VAL(base, DMARDLR) = 0;
+    spiSlavePinmux();
+
+    uint32_t flags = interrupt_lock();
+    if (!arm()) {
+        interrupt_unlock(flags);
+        SPI_M_REG_VAL(base, SPIEN) = SPI_DISABLE;
+        power_clock_release(POWER_CLOCK_SPIS);
+        soc_dma_release(&dmaTx);
+        soc_dma_release(&dmaRx);
+        return false;
+    }
+    csPin = pin;
+    running = true;
+    interrupt_unlock(flags);
+
+    pinMode(csPin, INPUT);
+    attachInterruptFast(csPin, spiSlaveCsIsr, RISING);
+    return true;
+}
+
+void SPISlaveClass::end()
+{
+    if (!running)
+        return;
+
+    detachInterrupt(csPin);
+    uint32_t flags = interrupt_lock();
+    disarm();
+    running = false;
+    interrupt_unlock(flags);
+
+    soc_dma_deconfig(&dmaRx);
+    soc_dma_deconfig(&dmaTx);
+    soc_dma_release(&dmaTx);
+    soc_dma_release(&dmaRx);
+    power_clock_release(POWER_CLOCK_SPIS);
+}
+
+bool SPISlaveClass::setReceiveBuffer(void *buf, size_t size)
+{
+    if ((buf && !dmaReachable(buf)) || size > SPI_SLAVE_MAX_LEN)
+        return false;
+
+    /* the DMA channel keeps the old one until the transaction ends */
+    uint32_t flags = interrupt_lock();
+    rxBuf = (uint8_t *)buf;
+    rxSize = buf ? size : 0;
+    interrupt_unlock(flags);
+    return true;
+}
+
+bool SPISlaveClass::setResponse(const void *buf, size_t len)
+{
+    if ((buf && !dmaReachable(buf)) || len > SPI_SLAVE_MAX_LEN)
+        return false;
+
+    uint32_t flags = interrupt_lock();
+    if (running) {
+        nextTx = (const uint8_t *)buf;
+        nextTxLen = buf ? len : 0;
+        txPending = true;
+    } else {
+        txBuf = (const uint8_t *)buf;
+        txLen = buf ? len : 0;
+    }
+    interrupt_unlock(flags);
+    return true;
+}
+
+void SPISlaveClass::csIsr(void)
+{
+    if (!running)
+        return;
+
+    size_t received = disarm();
+    if (callback)
+        callback(received);
+    arm();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2016 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef _SPISLAVE_H_INCLUDED
+#define _SPISLAVE_H_INCLUDED
+
+#include "SPI.h"
+
+/* The SoC SPI slave controller, for a host that clocks data out of the
+ * board, e.g. IMU FIFO batches:
+ *
+ *     SPISlave.setReceiveBuffer(cmd, sizeof(cmd));
+ *     SPISlave.setResponse(batch[0], len);
+ *     SPISlave.onTransaction(done);
+ *     SPISlave.begin(7);             // a pin wired to the host's chip select
+ *
+ * Both directions are moved by DMA, so the host can clock at up to a
+ * quarter of the 32MHz bus clock with no interrupt per byte. A transaction
+ * runs from the chip select falling to it rising: the pin given to begin()
+ * is watched for the rising edge, which ends the transaction, calls the
+ * callback with what was received and arms the next one. The controller is
+ * off in between, so the host must leave chip select high for that long,
+ * some microseconds plus the time the callback takes.
+ *
+ * The response is double buffered. setResponse() only takes effect at the
+ * end of the running transaction, so the host never reads half of the old
+ * response and half of the new one; prepare the next response in a second
+ * buffer while the first is sent. A buffer is free again once the
+ * callback of the transaction after the setResponse() that replaced it has
+ * run. What the host reads past the end of the response is undefined.
+ *
+ * Buffers must be outside DCCM, which the DMA engine can't reach, and no
+ * longer than SPI_SLAVE_MAX_LEN. */
+
+/* Called from interrupt context once the chip select has gone high, with
+ * the number of bytes received. setReceiveBuffer() and setResponse() may be
+ * called from it, and take effect for the next transaction. */
+typedef void (*SPISlaveCallback)(size_t received);
+
+/* largest receive buffer or response one transaction can use */
+#define SPI_SLAVE_MAX_LEN 0xFFFC
+
+class SPISlaveClass {
+public:
+  SPISlaveClass() {
+	  csPin = 0xFF;
+	  running = false;
+	  rxBuf = NULL;
+	  rxSize = 0;
+	  rxArmed = NULL;
+	  rxArmedSize = 0;
+	  rxFull = false;
+	  txBuf = NULL;
+	  txLen = 0;
+	  nextTx = NULL;
+	  nextTxLen = 0;
+	  txPending = false;
+	  callback = NULL;
+  }
+
+  /* Starts listening, in mode SPI_MODE0..3, with chip select read on pin.
+   * Returns false if the DMA channels can't be had or pin isn't a
+   * digital pin. */
+  bool begin(uint8_t pin, uint8_t mode = SPI_MODE0);
+
+  /* Stops listening and gives back the controller and its DMA channels */
+  void end();
+
+  /* Where the next transactions store what the host sends. Bytes past
+   * size are dropped; NULL drops them all, and the callback then gets 0. */
+  bool setReceiveBuffer(void *buf, size_t size);
+
+  /* What the host reads from the next transaction on. Like
+   * setReceiveBuffer(), returns false for a buffer in DCCM or longer than
+   * SPI_SLAVE_MAX_LEN. */
+  bool setResponse(const void *buf, size_t len);
+
+  /* true from setResponse() until the end of the transaction that takes it */
+  inline bool responsePending(void) { return txPending; }
+
+  inline void onTransaction(SPISlaveCallback cb) { callback = cb; }
+
+  /* Chip select interrupt handler, used by begin() */
+  void csIsr(void);
+
+private:
+  bool dmaInit(void);
+  bool arm(void);
+  size_t disarm(void);
+
+  uint8_t csPin;
+  bool running;
+  uint8_t *rxBuf;
+  size_t rxSize;
+  uint8_t *rxArmed;      /* the buffer of the running transaction */
+  size_t rxArmedSize;
+  volatile bool rxFull;
+  const uint8_t *txBuf;
+  size_t txLen;
+  const uint8_t *nextTx;
+  size_t nextTxLen;
+  volatile bool txPending;
+  SPISlaveCallback callback;
+
+  struct soc_dma_channel dmaTx;
+  struct soc_dma_channel dmaRx;
+  struct soc_dma_cfg dmaTxCfg;
+  struct soc_dma_cfg dmaRxCfg;
+
+  static void dmaRxComplete(void *arg);
+};
+
+extern SPISlaveClass SPISlave;
+
+/* Routes SCK, MOSI, MISO and SS of the SPI slave controller to pads.
+ * Arduino 101 brings none of them to its headers, so by default begin()
+ * leaves the pin mux alone; a board that wires them defines this to set
+ * the mux of those pads. */
+extern "C" void spiSlavePinmux(void);
+
+#endif
@@ -29,17 +29,28 @@
 #define     SPIEN                 (0x08) /* SoC SPI Enable */
 #define     SER                   (0x10) /* SoC SPI Slave Enable */
 #define     BAUDR                 (0x14) /* SoC SPI Baud Rate Select */
+#define     TXFTLR                (0x18) /* SoC SPI Transmit FIFO Threshold */
+#define     RXFTLR                (0x1C) /* SoC SPI Receive FIFO Threshold */
 #define     TXFL                  (0x20) /* SoC SPI Transmit FIFO Level */
 #define     RXFL                  (0x24) /* SoC SPI Receive FIFO Level */
 #define     SR                    (0x28) /* SoC SPI Status Register */
 #define     IMR                   (0x2C) /* SoC SPI Interrupt Mask */
+#define     DMACR                 (0x4C) /* SoC SPI DMA Control */
+#define     DMATDLR               (0x50) /* SoC SPI DMA Transmit Data Level */
+#define     DMARDLR               (0x54) /* SoC SPI DMA Receive Data Level */
 #define     DR                    (0x60) /* SoC SPI Data */
 
 /* SPI specific macros */
 #define     SPI_DISABLE_INT       (0x0)  /* Disable SoC SPI Interrupts */
+#define     SPI_INT_TXEIM         (0x1)  /* TX FIFO at or below TXFTLR */
+#define     SPI_INT_RXFIM         (0x10) /* RX FIFO above RXFTLR */
 #define     SPI_ENABLE            (0x1)  /* Enable SoC SPI Device */
 #define     SPI_DISABLE           (0x0)  /* Disable SoC SPI Device */
 #define     SPI_STATUS_BUSY       (0x1)               /* Busy status */
+#define     SPI_STATUS_TFNF       (0x2)               /* TX FIFO not full */
+#define     SPI_STATUS_TFE        (0x4)               /* TX FIFO empty */
+#define     SPI_DMACR_RDMAE       (0x1)  /* Receive DMA Enable */
+#define     SPI_DMACR_TDMAE       (0x2)  /* Transmit DMA Enable */
 
 #define     SPI_8_BIT             (7)    /*  8-bit frame size */
 #define     SPI_16_BIT            (15)   /* 16-bit frame size */
@@ -48,6 +59,9 @@
 
 #define     SPI_MODE_MASK         (0xC0) /* CPOL=bit 7, CPHA=bit 6 on CTRL0 */
 #define     SPI_MODE_SHIFT        (6)
+#define     SPI_TMOD_MASK         (0x300) /* Transfer mode, bits 8-9 on CTRL0 */
+#define     SPI_TMOD_TX           (0x100) /* Transmit only */
+#define     SPI_SLV_OE            (0x400) /* Slave: MISO not driven, bit 10 */
 #define     SPI_FSIZE_MASK        (0x1F0000) /* Valid frame sizes: 1-32 bits */
 #define     SPI_FSIZE_SHIFT       (16)
 #define     SPI_CLOCK_MASK        (0xFFFE)  /* Clock divider: any even value
@@ -83,9 +97,31 @@ static inline uint32_t arc32_bit_reverse(register uint32_t src,
         );
     return dst;
 }
-#define SPI_REVERSE_8(b)  arc32_bit_reverse((b), 8)
-#define SPI_REVERSE_16(b) arc32_bit_reverse((b), 16)
-#define SPI_REVERSE_24(b) arc32_bit_reverse((b), 24)
-#define SPI_REVERSE_32(b) arc32_bit_reverse((b), 32)
+
+/* The controller only shifts MSB first, so LSB-first data is reversed in
+ * software: bytes through a table, words with mask-and-shift steps that
+ * reverse all four bytes at once */
+extern const uint8_t spi_bit_reverse_table[256];
+
+static inline uint32_t spi_reverse_bytes(uint32_t w)
+{
+    w = ((w >> 1) & 0x55555555) | ((w & 0x55555555) << 1);
+    w = ((w >> 2) & 0x33333333) | ((w & 0x33333333) << 2);
+    w = ((w >> 4) & 0x0F0F0F0F) | ((w & 0x0F0F0F0F) << 4);
+    return w;
+}
+
+static inline uint32_t spi_reverse_32(uint32_t w)
+{
+    return __builtin_bswap32(spi_reverse_bytes(w));
+}
+
+/* Reverses each byte of a buffer in place */
+void spi_reverse_buffer(uint8_t *buf, size_t count);
+
+#define SPI_REVERSE_8(b)  spi_bit_reverse_table[(uint8_t)(b)]
+#define SPI_REVERSE_16(b) (spi_reverse_32(b) >> 16)
+#define SPI_REVERSE_24(b) (spi_reverse_32(b) >> 8)
+#define SPI_REVERSE_32(b) spi_reverse_32(b)
 
 #endif /* _SPI_REGISTERS_H_ */
@@ -23,41 +23,91 @@
 #include "Arduino.h"
 #include "conf.h"
 #include "aux_regs.h"
+#include "hwtimer.h"
 #include "Servo.h"
 
-static servo_t servos[MAX_SERVOS];         // static array of servo structures
+static servo_t servos[MAX_SERVOS] DCCM_BSS;       // static array of servo structures
 static volatile int32_t Channel;           // counter for the servo being pulsed for timer 1
 static uint32_t ServoCount;                // the total number of attached servos
+static uint32_t pwmSavedPeriod[4];         // analogWrite() period of the PWM channel, put back on detach
+static FastPin servoPins[MAX_SERVOS] DCCM_BSS;    // for the SERVO_FRAMED edges
+static uint8_t servoMode = SERVO_SEQUENCED;
+
+/* SERVO_FRAMED: the attached timer1 servos by pulse end, from the start of
+ * the frame. loop() fills the table the interrupt isn't using and hands it
+ * over through framePending; the interrupt takes it at a frame start. */
+typedef struct {
+    uint8_t count;
+    uint8_t order[MAX_SERVOS];             // servo indices
+    uint32_t end[MAX_SERVOS];              // ticks, ascending
+} servo_frame_t;
+
+#define FRAME_START 0xFF                   // frameEdge before the pulses go high
+
+static servo_frame_t frames[2] DCCM_BSS;
+static volatile uint8_t frameCurrent;
+static volatile int8_t framePending = -1;
+static uint8_t frameEdge = FRAME_START;    // next entry of frames[frameCurrent] to end
+static uint64_t frameStart;
 
 /************ static functions common to all instances ***********************/
 static void timer1_disable_servo(void);
-static void timer1_isr_servo(void);
+static void timer1_isr_servo(void *arg);
 static void timer1_init_servo(uint32_t ticktime);
 
+/* timer1 is shared with tone(), CurieTimerOne and delay() through hwtimer */
+static hwtimer_t servo_timer = { 0, 0, timer1_isr_servo, NULL, -1 };
+static bool in_servo_isr = false;
+
 static void timer1_disable_servo(void)
 {
-    uint32_t saved;
-    uint32_t ctrl_val;   /* timer control register value */
-
-    saved = interrupt_lock();
+    hwtimerStop(&servo_timer);
+}
 
-    /* disable interrupt generation */
-    ctrl_val = aux_reg_read(ARC_V2_TMR1_CONTROL);
-    aux_reg_write(ARC_V2_TMR1_CONTROL, ctrl_val & ~ARC_V2_TMR_CTRL_IE);
+static void timer1_isr_frame(void)
+{
+    servo_frame_t *f;
+    uint32_t offset, next;
 
-    interrupt_unlock(saved);
+    if (frameEdge == FRAME_START) {
+        if (framePending >= 0) {
+            frameCurrent = framePending;
+            framePending = -1;
+        }
+        f = &frames[frameCurrent];
+        frameStart = servo_timer.expiry;
+        for (uint8_t i = 0; i < f->count; i++)
+            fastPinHigh(&servoPins[f->order[i]]);
+        frameEdge = 0;
+        offset = 0;
+    } else {
+        /* everything due by now, so equal widths take one interrupt */
+        f = &frames[frameCurrent];
+        offset = servo_timer.expiry - frameStart;
+        while (frameEdge < f->count && f->end[frameEdge] <= offset)
+            fastPinLow(&servoPins[f->order[frameEdge++]]);
+    }
 
-    /* disable interrupt in the interrupt controller */
-    interrupt_disable(ARCV2_IRQ_TIMER1);
+    if (frameEdge < f->count) {
+        next = f->end[frameEdge];
+    } else {
+        next = usToTicks(REFRESH_INTERVAL);
+        frameEdge = FRAME_START;
+    }
+    hwtimerAdvance(&servo_timer, next - offset);
 }
 
-static void timer1_isr_servo(void)
+static void timer1_isr_servo(void *arg)
 {
     static uint32_t total_count = 0;
     uint32_t time_leftover = 0;
 
-    /* clear the interrupt (by writing 0 to IP bit of the control register) */
-    aux_reg_write(ARC_V2_TMR1_CONTROL, ARC_V2_TMR_CTRL_NH | ARC_V2_TMR_CTRL_IE);
+    if (servoMode == SERVO_FRAMED) {
+        timer1_isr_frame();
+        return;
+    }
+
+    in_servo_isr = true;
 
     if (Channel < 0) {
         /* channel set to -1 indicated that refresh interval completed so reset timer count */
@@ -71,6 +121,9 @@ static void timer1_isr_servo(void)
     }
 
     Channel++;    // increment to the next channel
+    /* the PWM block pulses its own servos, they take no time here */
+    while (Channel < (int32_t)ServoCount && servos[Channel].Pin.isPwm)
+        Channel++;
 
     if(Channel < (int32_t)ServoCount) {
         total_count +=  servos[Channel].ticks;
@@ -88,47 +141,96 @@ static void timer1_isr_servo(void)
             timer1_init_servo(time_leftover);
         } else {
             /* missed the refresh period, re-run this function to begin a new cycle immediately */
-            timer1_isr_servo();
+            timer1_isr_servo(arg);
         }
     }
+
+    in_servo_isr = false;
 }
 
 static void timer1_init_servo(uint32_t ticktime)
 {
-    /* ensure that the timer will not generate interrupts */
-    aux_reg_write(ARC_V2_TMR1_CONTROL, 0);
-    aux_reg_write(ARC_V2_TMR1_COUNT, 0);    /* clear the count value */
-
-    /* connect specified routine/parameter to the timer 0 interrupt vector */
-    interrupt_connect(ARCV2_IRQ_TIMER1, timer1_isr_servo);
-
-    /*
-     * Set the reload value to achieve the configured tick rate, enable the
-     * counter and interrupt generation.
-     *
-     * The global variable 'tickunit' represents the #cycles/tick.
-     */
-
-    aux_reg_write(ARC_V2_TMR1_LIMIT, ticktime); /* write the limit value */
-    /* count only when not halted for debug and enable interrupts */
-    aux_reg_write(ARC_V2_TMR1_CONTROL, ARC_V2_TMR_CTRL_NH | ARC_V2_TMR_CTRL_IE);
-    aux_reg_write(ARC_V2_TMR1_COUNT, 0); /* write the start value */
-
-    /* Everything has been configured. It is now safe to enable the interrupt */
-    interrupt_enable(ARCV2_IRQ_TIMER1);
+    /* From the timer callback the next edge is timed from the previous one,
+     * so interrupt latency doesn't stretch the pulses */
+    if (in_servo_isr)
+        hwtimerAdvance(&servo_timer, ticktime);
+    else
+        hwtimerStart(&servo_timer, ticktime, 0);
 }
 
 static boolean isTimerActive()
 {
     /* returns true if any servo is active on this timer */
     for (uint32_t channel=0; channel < MAX_SERVOS; channel++) {
-        if (servos[channel].Pin.isActive == true)
+        if (servos[channel].Pin.isActive == true && !servos[channel].Pin.isPwm)
             return true;
         }
 
     return false;
 }
 
+/* Sorts the attached timer1 servos into the table the interrupt isn't
+ * using and queues it for the next frame */
+static void frame_rebuild(void)
+{
+    uint32_t flags = interrupt_lock();
+    /* with nothing pending the interrupt stays on frameCurrent */
+    framePending = -1;
+    uint8_t target = 1 - frameCurrent;
+    interrupt_unlock(flags);
+
+    servo_frame_t *f = &frames[target];
+    uint8_t n = 0;
+
+    for (uint32_t channel = 0; channel < ServoCount; channel++) {
+        if (servos[channel].Pin.isActive == false || servos[channel].Pin.isPwm)
+            continue;
+        /* fastPinLow() needs no trim for digitalWrite() */
+        uint32_t end = servos[channel].ticks + usToTicks(TRIM_DURATION);
+        uint8_t j = n++;
+        while (j > 0 && f->end[j - 1] > end) {
+            f->end[j] = f->end[j - 1];
+            f->order[j] = f->order[j - 1];
+            j--;
+        }
+        f->end[j] = end;
+        f->order[j] = channel;
+    }
+    f->count = n;
+    framePending = target;
+}
+
+static void timer1_start_servo(uint32_t ticktime)
+{
+    if (servoMode == SERVO_FRAMED) {
+        frameEdge = FRAME_START;
+        hwtimerStart(&servo_timer, ticktime, 0);
+    } else {
+        Channel = -1;
+        timer1_init_servo(ticktime);
+    }
+}
+
+/* Stops timer1 without leaving a pulse high */
+static void timer1_stop_servo(void)
+{
+    timer1_disable_servo();
+    if (servoMode == SERVO_FRAMED) {
+        servo_frame_t *f = &frames[frameCurrent];
+        for (uint8_t i = 0; i < f->count; i++)
+            fastPinLow(&servoPins[f->order[i]]);
+    } else if (Channel >= 0) {
+        digitalWrite(servos[Channel].Pin.nbr, LOW);
+    }
+}
+
+/* High time of a PWM servo: the trim for digitalWrite() isn't needed */
+static void pwm_write_servo(uint32_t channel)
+{
+    analogWritePulse(servos[channel].Pin.nbr, usToTicks(REFRESH_INTERVAL),
+                     servos[channel].ticks + usToTicks(TRIM_DURATION));
+}
+
 /****************** end of static functions ******************************/
 Servo::Servo()
 {
@@ -153,13 +255,25 @@ uint32_t Servo::attach(int pin, int min, int max)
         this->min  = (MIN_PULSE_WIDTH - min)/4;   //resolution of min/max is 4 uS
         this->max  = (MAX_PULSE_WIDTH - max)/4;
 
-        if (isTimerActive() == false) {
-            Channel = -1;
-            timer1_init_servo(servos[this->servoIndex].ticks);
+        if (digitalPinHasPWM(pin)) {
+            uint32_t chan = g_APinDescription[pin].ulPwmChan;
+
+            pwmSavedPeriod[chan] = pwmPeriod[chan];
+            servos[this->servoIndex].Pin.isPwm = true;
+            pwm_write_servo(this->servoIndex);
+            servos[this->servoIndex].Pin.isActive = true;
+            return this->servoIndex;
         }
+        servos[this->servoIndex].Pin.isPwm = false;
+        fastPinInit(&servoPins[this->servoIndex], pin);
 
-        /* this must be set after the check for isTimerActive */
+        /* the check for isTimerActive must come before isActive is set */
+        bool start = isTimerActive() == false;
         servos[this->servoIndex].Pin.isActive = true;
+        if (servoMode == SERVO_FRAMED)
+            frame_rebuild();
+        if (start)
+            timer1_start_servo(servos[this->servoIndex].ticks);
     }
 
     return this->servoIndex;
@@ -167,11 +281,43 @@ uint32_t Servo::attach(int pin, int min, int max)
 
 void Servo::detach()
 {
+    if (this->servoIndex >= MAX_SERVOS)
+        return;
+
     servos[this->servoIndex].Pin.isActive = false;
 
-    if (isTimerActive() == false) {
-        timer1_disable_servo();
+    if (servos[this->servoIndex].Pin.isPwm) {
+        uint32_t pin = servos[this->servoIndex].Pin.nbr;
+
+        servos[this->servoIndex].Pin.isPwm = false;
+        /* back to GPIO, low, with the analogWrite() period */
+        pinMode(pin, OUTPUT);
+        digitalWrite(pin, LOW);
+        pwmPeriod[g_APinDescription[pin].ulPwmChan] =
+            pwmSavedPeriod[g_APinDescription[pin].ulPwmChan];
+        return;
     }
+
+    if (isTimerActive() == false)
+        timer1_stop_servo();
+    else if (servoMode == SERVO_FRAMED)
+        frame_rebuild();
+}
+
+void Servo::setMode(uint8_t mode)
+{
+    if (mode == servoMode || (mode != SERVO_SEQUENCED && mode != SERVO_FRAMED))
+        return;
+
+    bool running = isTimerActive();
+    if (running)
+        timer1_stop_servo();
+    servoMode = mode;
+    if (mode == SERVO_FRAMED)
+        frame_rebuild();
+    /* a refresh interval of low lines between the two */
+    if (running)
+        timer1_start_servo(usToTicks(REFRESH_INTERVAL));
 }
 
 void Servo::write(int value)
@@ -208,9 +354,14 @@ void Servo::writeMicroseconds(int value)
         value = value - TRIM_DURATION;
         value = usToTicks(value);
 
-        noInterrupts();
+        uint32_t flags = interrupt_lock();
         servos[channel].ticks = value;
-        interrupts();
+        interrupt_unlock(flags);
+
+        if (servos[channel].Pin.isActive && servos[channel].Pin.isPwm)
+            pwm_write_servo(channel);
+        else if (servos[channel].Pin.isActive && servoMode == SERVO_FRAMED)
+            frame_rebuild();
     }
 }
 
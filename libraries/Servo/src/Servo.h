@@ -37,6 +37,21 @@
     readMicroseconds()   - Gets the last written servo pulse width in microseconds.
     attached()  - Returns true if there is a servo attached.
     detach()    - Stops an attached servos from pulsing its i/o pin.
+
+  On the PWM pins (3, 5, 6 and 9) the pulses come from the PWM block, at
+  the refresh interval and clock accurate whatever the other interrupts are
+  doing; the other pins are pulsed from a timer1 interrupt, which only runs
+  while at least one of them is attached, in one of two ways:
+
+    SERVO_SEQUENCED - one pulse after another, an interrupt per edge; the
+                      frame stretches past REFRESH_INTERVAL once the pulses
+                      add up to more
+    SERVO_FRAMED    - all pulses start together every REFRESH_INTERVAL and
+                      end in order of width; pulses ending together share
+                      an interrupt, and writes from loop() all take effect
+                      at the start of the next frame
+
+    Servo::setMode(mode) - picks one for all servos, SERVO_SEQUENCED by default
  */
 
 #ifndef Servo_h
@@ -61,9 +76,13 @@
 
 #define TRIM_DURATION           3    // compensation ticks for digitalWrite
 
+#define SERVO_SEQUENCED         0    // setMode(): pulses one after another
+#define SERVO_FRAMED            1    // setMode(): pulses start together
+
 typedef struct  {
   uint32_t nbr        :6 ;           // a pin number from 0 to 63
   uint32_t isActive   :1 ;           // true if this channel is enabled, pin not pulsed if false
+  uint32_t isPwm      :1 ;           // pulsed by the PWM block rather than the timer1 sequence
 } ServoPin_t;
 
 typedef struct {
@@ -83,6 +102,7 @@ public:
   int read();                        // returns current pulse width as an angle between 0 and 180 degrees
   int readMicroseconds();            // returns current pulse width in microseconds for this servo
   bool attached();                   // return true if this servo is attached, otherwise false
+  static void setMode(uint8_t mode); // SERVO_SEQUENCED or SERVO_FRAMED, for all the timer1 servos
 private:
   uint32_t servoIndex;               // index into the channel data for this servo
   int32_t min;                       // minimum is this value times 4 added to MIN_PULSE_WIDTH
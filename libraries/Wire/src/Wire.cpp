@@ -30,11 +30,26 @@ extern "C" {
 #include "variant.h"
 
 TwoWire::TwoWire(I2C_CONTROLLER _controller_id)
-    : rxBufferIndex(0), rxBufferLength(0), init_status(-1),
+    : rxBufferIndex(0), rxBufferLength(0), txBufferLength(0),
+      bufferLength(BUFFER_LENGTH), init_status(-1),
       controller_id(_controller_id)
 {
-    rxBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
-    txBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
+    rxBuffer = defaultRxBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
+    txBuffer = defaultTxBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
+}
+
+void TwoWire::setBuffers(uint8_t *rxBuf, uint8_t *txBuf, size_t size)
+{
+    if (!rxBuf || !txBuf || size == 0) {
+        rxBuf = defaultRxBuffer;
+        txBuf = defaultTxBuffer;
+        size = BUFFER_LENGTH;
+    }
+    rxBuffer = rxBuf;
+    txBuffer = txBuf;
+    bufferLength = size;
+    rxBufferIndex = rxBufferLength = 0;
+    txBufferLength = 0;
 }
 
 void TwoWire::begin(void)
@@ -49,30 +64,47 @@ void TwoWire::begin(int i2c_speed)
 
 void TwoWire::setClock(long speed)
 {
-    if (speed == 400000L) {
-        init_status = i2c_openadapter_speed(controller_id, I2C_SPEED_FAST);
-    } else if (speed == 100000L) {
-        init_status = i2c_openadapter_speed(controller_id, I2C_SPEED_SLOW);
-    } else if (speed == I2C_SPEED_FAST) {
-        init_status = i2c_openadapter_speed(controller_id, I2C_SPEED_FAST);
-    } else {
+    // I2C_SPEED_SLOW and I2C_SPEED_FAST are accepted as well as rates
+    if (speed == I2C_SPEED_SLOW)
+        speed = 100000L;
+    else if (speed == I2C_SPEED_FAST)
+        speed = 400000L;
+    if (speed <= 0)
+        return;
+
+    if (init_status < 0)
         init_status = i2c_openadapter(controller_id);
-    }
+    if (init_status >= 0)
+        i2c_setclock(controller_id, speed);
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity,
                              uint8_t sendStop)
 {
-    int ret;
-    if (quantity > BUFFER_LENGTH)
-        quantity = BUFFER_LENGTH;
+    return request(address, quantity, sendStop);
+}
 
-    /* Set slave address via ioctl  */
-    i2c_setslave(controller_id, address);
-    ret = i2c_readbytes(controller_id, rxBuffer, quantity, !sendStop);
-    if (ret < 0) {
-        return 0;
-    }
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+    return request(address, quantity, true);
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity)
+{
+    return request(address, quantity < 0 ? 0 : quantity, true);
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity, int sendStop)
+{
+    return request(address, quantity < 0 ? 0 : quantity, sendStop);
+}
+
+size_t TwoWire::request(uint8_t address, size_t quantity, bool sendStop)
+{
+    if (quantity > bufferLength)
+        quantity = bufferLength;
+
+    quantity = readInto(address, rxBuffer, quantity, sendStop);
     // set rx buffer iterator vars
     rxBufferIndex = 0;
     rxBufferLength = quantity;
@@ -80,19 +112,102 @@ uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity,
     return quantity;
 }
 
-uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+size_t TwoWire::readInto(uint8_t address, uint8_t *buf, size_t len,
+                         bool sendStop)
 {
-    return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t) true);
+    /* Set slave address via ioctl  */
+    i2c_setslave(controller_id, address);
+    if (i2c_readbytes(controller_id, buf, len, !sendStop) < 0)
+        return 0;
+    return len;
 }
 
-uint8_t TwoWire::requestFrom(int address, int quantity)
+uint8_t TwoWire::writeFrom(uint8_t address, const uint8_t *buf, size_t len,
+                           bool sendStop)
+{
+    int err;
+
+    if (init_status < 0)
+        return -I2C_ERROR_OTHER;
+    if (len == 0) {
+        beginTransmission(address);
+        return endTransmission(sendStop);
+    }
+    i2c_setslave(controller_id, address);
+    err = i2c_writebytes(controller_id, (uint8_t *)buf, len, !sendStop);
+    if (err < 0)
+        return -err;
+    return 0;
+}
+
+uint8_t TwoWire::writeRead(uint8_t address, const uint8_t *txBuf,
+                           uint8_t txLen, uint8_t *rxBuf, uint8_t rxLen)
+{
+    int ret;
+
+    if (init_status < 0)
+        return -I2C_ERROR_OTHER;
+    i2c_setslave(controller_id, address);
+    if (txLen == 0)
+        ret = i2c_readbytes(controller_id, rxBuf, rxLen, false);
+    else
+        ret = i2c_writeread(controller_id, txBuf, txLen, rxBuf, rxLen);
+    if (ret < 0)
+        return -ret;
+    return 0;
+}
+
+bool TwoWire::submit(i2c_xfer_t *xfer)
 {
-    return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t) true);
+    if (init_status < 0)
+        return false;
+    return i2c_submit(controller_id, xfer) == I2C_OK;
 }
 
-uint8_t TwoWire::requestFrom(int address, int quantity, int sendStop)
+bool TwoWire::busy(void)
+{
+    return i2c_queue_busy(controller_id);
+}
+
+int TwoWire::scan(uint8_t *bitmap)
+{
+    if (init_status < 0) {
+        memset(bitmap, 0, I2C_SCAN_BYTES);
+        return I2C_ERROR;
+    }
+    return i2c_scan(controller_id, bitmap);
+}
+
+i2c_stats_t TwoWire::stats(void)
+{
+    i2c_stats_t s;
+
+    i2c_get_stats(controller_id, &s);
+    return s;
+}
+
+void TwoWire::resetStats(void)
 {
-    return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop);
+    i2c_reset_stats(controller_id);
+}
+
+int TwoWire::readBatch(const uint8_t *addresses, int count, uint8_t reg,
+                       uint8_t *data, int len, int *status)
+{
+    int ret, i;
+
+    if (init_status < 0)
+        return 0;
+    ret = i2c_read_batch(controller_id, addresses, count, reg, data, len,
+                         status);
+    if (ret < 0)
+        return 0;
+    if (status) {
+        // the endTransmission() codes, as elsewhere in Wire
+        for (i = 0; i < count; i++)
+            status[i] = -status[i];
+    }
+    return ret;
 }
 
 void TwoWire::beginTransmission(uint8_t address)
@@ -154,7 +269,7 @@ uint8_t TwoWire::endTransmission(void)
 
 size_t TwoWire::write(uint8_t data)
 {
-    if (txBufferLength >= BUFFER_LENGTH)
+    if (txBufferLength >= bufferLength)
         return 0;
     txBuffer[txBufferLength++] = data;
     return 1;
@@ -163,7 +278,7 @@ size_t TwoWire::write(uint8_t data)
 size_t TwoWire::write(const uint8_t *data, size_t quantity)
 {
     for (size_t i = 0; i < quantity; ++i) {
-        if (txBufferLength >= BUFFER_LENGTH)
+        if (txBufferLength >= bufferLength)
             return i;
         txBuffer[txBufferLength++] = data[i];
     }
@@ -24,6 +24,7 @@
 #include "Stream.h"
 #include "variant.h"
 #include "ss_i2c_iface.h"
+#include "i2c.h"
 
 #define BUFFER_LENGTH   32
 #define I2C_SPEED_SLOW  1
@@ -34,6 +35,8 @@ public:
 	TwoWire(I2C_CONTROLLER _controller_id);
 	void begin(void);
     void begin(int speed);
+    // Any SCL rate up to 1 MHz (Fm+); retunes the timing between transfers.
+    // Rounds down to 100 or 400 kHz with a system library too old for that
     void setClock(long speed);
 	void beginTransmission(uint8_t);
 	void beginTransmission(int);
@@ -43,6 +46,42 @@ public:
 	uint8_t requestFrom(uint8_t, uint8_t, uint8_t);
 	uint8_t requestFrom(int, int);
 	uint8_t requestFrom(int, int, int);
+	// Writes txLen bytes then reads rxLen bytes into rxBuf after a repeated
+	// start, as one bus transfer; returns 0 or an endTransmission() error
+	uint8_t writeRead(uint8_t address, const uint8_t *txBuf, uint8_t txLen,
+	                  uint8_t *rxBuf, uint8_t rxLen);
+	// Queues a transfer to run in the background; see i2c_xfer_t. Returns
+	// false if the descriptor is empty or begin() failed
+	bool submit(i2c_xfer_t *xfer);
+	// True while submitted transfers are queued or on the bus
+	bool busy(void);
+	// Sets bit (address & 7) of bitmap[address >> 3], I2C_SCAN_BYTES bytes,
+	// for every address that ACKs a minimal probe; returns the number
+	// found, or a negative error if the bus doesn't respond
+	int scan(uint8_t *bitmap);
+	// Reads len bytes from register reg of each device in addresses, one
+	// queued transfer each, into data + i * len; status, if given, gets 0
+	// or the endTransmission() error of each. Returns the number read
+	int readBatch(const uint8_t *addresses, int count, uint8_t reg,
+	              uint8_t *data, int len, int *status = NULL);
+	// Transfer and wait-time counters since startup or resetStats(); the
+	// wait times are cycles(), see cyclesToNanos()
+	i2c_stats_t stats(void);
+	void resetStats(void);
+	// Replaces the BUFFER_LENGTH byte buffers with caller storage of size
+	// bytes each, for requestFrom() and write() beyond 32 bytes. The
+	// buffers must outlive their use; NULL goes back to the defaults.
+	// requestFrom() still returns a uint8_t; available() has the full
+	// count of a longer read
+	void setBuffers(uint8_t *rxBuf, uint8_t *txBuf, size_t size);
+	template <size_t N>
+	void setBuffers(uint8_t (&rxBuf)[N], uint8_t (&txBuf)[N]) { setBuffers(rxBuf, txBuf, N); }
+	size_t bufferSize(void) const { return bufferLength; }
+	// Transfer straight to or from buf, whatever its length, without the
+	// internal buffers. readInto() returns the bytes read, 0 on error;
+	// writeFrom() returns 0 or an endTransmission() error
+	size_t readInto(uint8_t address, uint8_t *buf, size_t len, bool sendStop = true);
+	uint8_t writeFrom(uint8_t address, const uint8_t *buf, size_t len, bool sendStop = true);
 	virtual size_t write(uint8_t);
 	virtual size_t write(const uint8_t *, size_t);
 	virtual int available(void);
@@ -59,13 +98,20 @@ public:
 private:
 	// RX Buffer
 	uint8_t *rxBuffer;
-	uint8_t rxBufferIndex;
-	uint8_t rxBufferLength;
+	size_t rxBufferIndex;
+	size_t rxBufferLength;
 
 	// TX Buffer
 	uint8_t txAddress;
 	uint8_t *txBuffer;
-	uint8_t txBufferLength;
+	size_t txBufferLength;
+
+	size_t request(uint8_t address, size_t quantity, bool sendStop);
+
+	// BUFFER_LENGTH DCCM buffers from the constructor, for setBuffers(NULL)
+	uint8_t *defaultRxBuffer;
+	uint8_t *defaultTxBuffer;
+	size_t bufferLength;
 
 	int init_status;
 
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2015 Intel Corporation.  All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef __BOOT_TIME_H__
+#define __BOOT_TIME_H__
+
+#include <stdint.h>
+#include "aux_regs.h"
+#include "scss_registers.h"
+
+/*
+ * Boot phases, in order, timed by bootTime()
+ */
+enum {
+    BOOT_RESET,         /* reset vector */
+    BOOT_RAM_INIT,      /* .data and .bss set up */
+    BOOT_CTORS,         /* static constructors run */
+    BOOT_MAIN,          /* interrupts, timer0 and balloc set up, main() called */
+    BOOT_VARIANT,       /* initVariant() entered */
+    BOOT_GPIO_INIT,     /* variantGpioInit() done */
+    BOOT_PWM_INIT,      /* variantPwmInit() done, at first use unless eager */
+    BOOT_ADC_INIT,      /* variantAdcInit() done, at first use unless eager */
+    BOOT_FRAMEWORK,     /* cfw_platform_init() done: framework and IPC started */
+    BOOT_VARIANT_DONE,  /* initVariant() returned */
+    BOOT_SETUP,         /* setup() called */
+    BOOT_LOOP,          /* setup() returned, first loop() */
+    BOOT_BLE,           /* BLE core up, noticed from the main loop or BLE.begin() */
+    BOOT_PHASES
+};
+
+/*
+ * Raw counts at each phase: TMR0, the CPU clock, and the always-on 32 kHz
+ * counter, which runs from power-on. TMR0 counts from the ARC reset until
+ * timer0_driver_init() clears it, just before BOOT_MAIN.
+ */
+struct boot_stamps {
+    /* One bit per phase reached */
+    uint32_t reached;
+    /* TMR0 when timer0_driver_init() cleared it */
+    uint32_t tmr0_restart;
+    uint32_t tmr0[BOOT_PHASES];
+    uint32_t aon[BOOT_PHASES];
+};
+
+static inline __attribute__((always_inline))
+void boot_stamp_raw(struct boot_stamps *s, unsigned int phase,
+                    uint32_t tmr0, uint32_t aon)
+{
+    if (phase < BOOT_PHASES && !(s->reached & (1u << phase))) {
+        s->tmr0[phase] = tmr0;
+        s->aon[phase] = aon;
+        s->reached |= 1u << phase;
+    }
+}
+
+static inline __attribute__((always_inline))
+void boot_stamp(struct boot_stamps *s, unsigned int phase)
+{
+    boot_stamp_raw(s, phase, aux_reg_read(ARC_V2_TMR0_COUNT),
+                   SCSS_REG_VAL(SCSS_AONC_CNT));
+}
+
+#endif /* __BOOT_TIME_H__ */
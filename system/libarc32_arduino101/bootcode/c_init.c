@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "interrupt.h"
 #include "arcv2_timer0.h"
+#include "boot_time.h"
 #include "os/os.h"
 
 /* Application main() function prototype */
@@ -40,6 +41,47 @@ extern char __data_rom_start[];
 extern char __data_ram_start[];
 extern char __data_ram_end[];
 
+/* DCCM section markers */
+extern char __dccm_rom_start[];
+extern char __dccm_data_start[];
+extern char __dccm_data_end[];
+extern char __dccm_bss_start[];
+extern char __dccm_bss_end[];
+
+/* Defined by the core, which reports them through bootTime() */
+extern struct boot_stamps boot_stamps __attribute__((weak));
+
+/*
+ * RAM set up a word at a time, four per pass: flash.ld keeps every section
+ * boundary below 4 byte aligned, so no byte tail is left.
+ */
+static void _copy_words (uint32_t *dst, const uint32_t *src, const uint32_t *end)
+{
+    while (end - dst >= 4) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = src[3];
+        dst += 4;
+        src += 4;
+    }
+    while (dst < end)
+        *dst++ = *src++;
+}
+
+static void _zero_words (uint32_t *dst, const uint32_t *end)
+{
+    while (end - dst >= 4) {
+        dst[0] = 0;
+        dst[1] = 0;
+        dst[2] = 0;
+        dst[3] = 0;
+        dst += 4;
+    }
+    while (dst < end)
+        *dst++ = 0;
+}
+
 static void _exec_ctors (void)
 {
     unsigned long i, nctors = (unsigned long)(__CTOR_LIST__[0]);
@@ -48,21 +90,36 @@ static void _exec_ctors (void)
         __CTOR_LIST__[i]();
 }
 
- __attribute__((__noreturn__)) void _main (void)
+ __attribute__((__noreturn__)) void _main (uint32_t reset_tmr0, uint32_t reset_aon)
 {
-    /* Zero BSS section */
-    memset(__bss_start, 0, __bss_end - __bss_start);
-    /* Relocate DATA section to RAM */
-    memcpy(__data_ram_start, __data_rom_start, __data_ram_end - __data_ram_start);
+    /* Zero BSS section; .noinit, after it, is left as it was */
+    _zero_words((uint32_t *)__bss_start, (uint32_t *)__bss_end);
+    /* Relocate DATA section, and the .ramfunc code at its start, to RAM */
+    _copy_words((uint32_t *)__data_ram_start, (const uint32_t *)__data_rom_start,
+                (uint32_t *)__data_ram_end);
+    /* Same for the DCCM_DATA and DCCM_BSS variables */
+    _copy_words((uint32_t *)__dccm_data_start, (const uint32_t *)__dccm_rom_start,
+                (uint32_t *)__dccm_data_end);
+    _zero_words((uint32_t *)__dccm_bss_start, (uint32_t *)__dccm_bss_end);
+    if (&boot_stamps) {
+        boot_stamp_raw(&boot_stamps, BOOT_RESET, reset_tmr0, reset_aon);
+        boot_stamp(&boot_stamps, BOOT_RAM_INIT);
+    }
     /* Execute C++ Constructors */
     _exec_ctors();
+    if (&boot_stamps)
+        boot_stamp(&boot_stamps, BOOT_CTORS);
     /* Init the the interrupt unit device - disable all the interrupts; The
      * default value of IRQ_ENABLE is 0x01 for all configured interrupts */
     interrupt_unit_device_init();
     /* Start the system's virtual 64-bit Real Time Counter */
+    if (&boot_stamps)
+        boot_stamps.tmr0_restart = aux_reg_read(ARC_V2_TMR0_COUNT);
     timer0_driver_init();
     /* Initialize the memory buffer for balloc() calls. */
     os_abstraction_init_malloc();
+    if (&boot_stamps)
+        boot_stamp(&boot_stamps, BOOT_MAIN);
     /* Jump to application main() */
     main ();
     /* Never reached */
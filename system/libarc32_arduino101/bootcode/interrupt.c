@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "aux_regs.h"
 #include "interrupt.h"
 #include "board.h"
+#include <string.h>
 
 
 struct _IsrTableEntry
@@ -29,6 +30,10 @@ struct _IsrTableEntry
 
 struct _IsrTableEntry __attribute__((section(".data"))) _IsrTable[SS_NUM_IRQS];
 
+/* Read by _do_isr */
+volatile uint32_t _isr_stats_on;
+static struct interrupt_stats _isr_stats[SS_NUM_IRQS];
+
 static void _dummy_isr(void)
 {
     __asm__ ("flag 0x01"); /* Set the halt flag => halt the CPU  */
@@ -74,6 +79,20 @@ void interrupt_priority_set (int irq, unsigned char priority)
     interrupt_unlock(flags);
 }
 
+unsigned char interrupt_priority_get (int irq)
+{
+    unsigned int flags = interrupt_lock();
+    aux_reg_write (ARC_V2_IRQ_SELECT, irq);
+    unsigned char priority = aux_reg_read (ARC_V2_IRQ_PRIORITY);
+    interrupt_unlock(flags);
+    return priority;
+}
+
+__attribute__((weak)) unsigned char interrupt_priority_default (int irq)
+{
+    return INTERRUPT_PRIORITY_LOW;
+}
+
 void interrupt_unit_device_init(void)
 {
     int irq_index;
@@ -82,7 +101,9 @@ void interrupt_unit_device_init(void)
     for (irq_index = min_irq_no; irq_index < max_irq_no; irq_index++)
     {
         aux_reg_write(ARC_V2_IRQ_SELECT, irq_index);
-        aux_reg_write(ARC_V2_IRQ_PRIORITY, (INTERRUPT_THRESHOLD - 1) );
+        aux_reg_write(ARC_V2_IRQ_PRIORITY,
+                      interrupt_priority_default(irq_index) ? INTERRUPT_PRIORITY_LOW
+                                                            : INTERRUPT_PRIORITY_HIGH);
         aux_reg_write(ARC_V2_IRQ_ENABLE, ARC_V2_INT_DISABLE);
         aux_reg_write(ARC_V2_IRQ_TRIGGER, ARC_V2_INT_LEVEL);
     }
@@ -97,3 +118,46 @@ void interrupt_unit_device_init(void)
     __builtin_arc_nop();
 }
 
+/* _do_isr calls this instead of the handler while the statistics are on.
+ * An IRQ doesn't preempt itself, so its entry needs no lock. */
+void _isr_dispatch_timed(unsigned int index)
+{
+    struct interrupt_stats *s = &_isr_stats[index];
+    uint32_t start = aux_reg_read(ARC_V2_TMR0_COUNT);
+    uint32_t latency = 0;
+    uint32_t cycles;
+
+    if (index == IRQ_TIMER0 - SS_NUM_EXCEPTIONS)
+        latency = start;
+    else if (index == IRQ_TIMER1 - SS_NUM_EXCEPTIONS)
+        latency = aux_reg_read(ARC_V2_TMR1_COUNT);
+
+    _IsrTable[index].isr();
+
+    cycles = aux_reg_read(ARC_V2_TMR0_COUNT) - start;
+    s->count++;
+    s->total_cycles += cycles;
+    if (cycles > s->max_cycles)
+        s->max_cycles = cycles;
+    if (latency > s->max_latency)
+        s->max_latency = latency;
+}
+
+void interrupt_stats_enable(int enable)
+{
+    _isr_stats_on = enable ? 1 : 0;
+}
+
+void interrupt_stats_reset(void)
+{
+    unsigned int flags = interrupt_lock();
+    memset(_isr_stats, 0, sizeof(_isr_stats));
+    interrupt_unlock(flags);
+}
+
+const struct interrupt_stats *interrupt_stats_get(unsigned int irq)
+{
+    if (irq < SS_NUM_EXCEPTIONS || irq - SS_NUM_EXCEPTIONS >= SS_NUM_IRQS)
+        return NULL;
+    return &_isr_stats[irq - SS_NUM_EXCEPTIONS];
+}
@@ -19,12 +19,23 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef __INTERRUPT_H__
 #define __INTERRUPT_H__
 
+#include <stdint.h>
+
 #define INTERRUPT_ENABLE    (1 << 4)
  /* According to IRQ_BUILD register the ARC core has only 2 interrupt priority
   * levels (0 and 1).
   * */
 #define INTERRUPT_THRESHOLD (1)
 
+/* Priority levels for interrupt_priority_set(). Every interrupt starts at
+ * INTERRUPT_PRIORITY_LOW; one raised to INTERRUPT_PRIORITY_HIGH preempts
+ * low priority handlers and is not held off by interrupt_lock_low(). */
+#define INTERRUPT_PRIORITY_HIGH (0)
+#define INTERRUPT_PRIORITY_LOW  (INTERRUPT_THRESHOLD)
+
+/* seti operand: take IE and the threshold E from the low bits */
+#define INTERRUPT_SET_LEVEL (1 << 5)
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -34,9 +45,36 @@ extern void interrupt_disconnect(unsigned int irq);
 extern void interrupt_enable(unsigned int irq);
 extern void interrupt_disable(unsigned int irq);
 extern void interrupt_priority_set (int irq, unsigned char priority);
+extern unsigned char interrupt_priority_get (int irq);
+/*
+ * The system-wide priority map: the priority interrupt_unit_device_init()
+ * gives each IRQ at boot, INTERRUPT_PRIORITY_LOW for all of them. Weak, so
+ * a sketch defines its own to start with, say, IRQ_I2S_INTR high.
+ */
+extern unsigned char interrupt_priority_default (int irq);
 
 extern void interrupt_unit_device_init(void);
 
+/*
+ * Per-IRQ statistics, gathered by the interrupt dispatch once
+ * interrupt_stats_enable() has been called. Cycles are of the 32 MHz
+ * timer0 and include any higher priority interrupt that preempted the
+ * handler. The latency, from the event to the handler, is only known for
+ * the timers, whose count restarts from 0 as they fire.
+ */
+struct interrupt_stats {
+    uint32_t count;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t max_latency;   /* IRQ_TIMER0/IRQ_TIMER1 only, else 0 */
+};
+
+/* Turns the statistics on or off; off, the dispatch costs one load */
+extern void interrupt_stats_enable(int enable);
+extern void interrupt_stats_reset(void);
+/* Statistics of an IRQ numbered as for interrupt_connect(), or NULL */
+extern const struct interrupt_stats *interrupt_stats_get(unsigned int irq);
+
 static inline __attribute__((always_inline))
 unsigned int interrupt_lock(void)
 {
@@ -51,6 +89,26 @@ void interrupt_unlock(unsigned int key)
 {
     __asm__ volatile ("seti %0" :: "ir" (key));
 }
+
+/*
+ * Masks INTERRUPT_PRIORITY_LOW interrupts only, by lowering the threshold,
+ * so the high priority ones keep their latency. Release with
+ * interrupt_unlock(). Data shared with a high priority handler needs
+ * interrupt_lock() or the atomic_* primitives instead. It only masks
+ * anything with a rebuilt system library: the prebuilt one leaves every
+ * IRQ at priority 0, which this doesn't hold off.
+ */
+static inline __attribute__((always_inline))
+unsigned int interrupt_lock_low(void)
+{
+    unsigned int key = interrupt_lock();
+
+    if (key & INTERRUPT_ENABLE) {
+        __asm__ volatile ("seti %0" :: "r" (INTERRUPT_SET_LEVEL |
+                          INTERRUPT_ENABLE | INTERRUPT_PRIORITY_HIGH));
+    }
+    return key;
+}
 #ifdef __cplusplus
 }
 #endif
@@ -105,6 +105,35 @@ typedef struct i2c_cfg_data{
     uint32_t            cb_err_data;        /*!< this will be passed back by the callback routine - can be used as an controller identifier */
 }i2c_cfg_data_t;
 
+/**
+ * Spike suppression, in controller clocks, used above 400 kHz: the 50 ns
+ * the Fm+ specification asks for
+ */
+#define I2C_FMP_SPKLEN      (2)
+
+/**
+*  SCL high and low counts of the DesignWare controllers, both clocked at
+*  CLOCK_SPEED MHz, for an SCL of scl_hz: the high phase lasts
+*  hcnt + spk_len + 7 clocks and the low phase lcnt + 1. Low gets 55% of the
+*  period, which meets the standard, fast and fast-plus minimums; rates the
+*  controller can't reach come out at its fastest.
+*/
+static inline void i2c_scl_counts(uint32_t scl_hz, uint32_t spk_len,
+                                  uint32_t *hcnt, uint32_t *lcnt)
+{
+    uint32_t period = (CLOCK_SPEED * 1000000UL + scl_hz / 2) / scl_hz;
+    uint32_t low = period * 11 / 20;
+    uint32_t high = period - low;
+
+    /* databook minimums: hcnt >= spk_len + 5, lcnt >= spk_len + 7 */
+    if (high < 2 * spk_len + 12)
+        high = 2 * spk_len + 12;
+    if (low < spk_len + 8)
+        low = spk_len + 8;
+    *hcnt = high - spk_len - 7;
+    *lcnt = low - 1;
+}
+
 /** @} */
 
 #endif /* COMMON_I2C_H_ */
@@ -186,6 +186,20 @@ DRIVER_API_RC ss_i2c_read(I2C_CONTROLLER controller_id, uint8_t *data, uint32_t
 */
 DRIVER_API_RC ss_i2c_transfer(I2C_CONTROLLER controller_id, uint8_t *data_write, uint32_t data_write_len, uint8_t *data_read, uint32_t data_read_len, uint32_t slave_addr, bool no_stop);
 
+/*! \fn     DRIVER_API_RC ss_i2c_set_clock(I2C_CONTROLLER controller_id, uint32_t scl_hz)
+*
+*  \brief   Retunes the SCL timing of a configured controller, standard mode
+*           up to 100 kHz and fast mode above, without reconfiguring it
+*
+*  \param   controller_id   : I2C controller_id identifier
+*  \param   scl_hz          : SCL frequency in Hz
+*
+*  \return  RC_OK on success\n
+*           RC_CONTROLLER_IN_USE during a transfer\n
+*           RC_FAIL otherwise
+*/
+DRIVER_API_RC ss_i2c_set_clock(I2C_CONTROLLER controller_id, uint32_t scl_hz);
+
 /*! \fn     DRIVER_I2C_STATUS_CODE ss_i2c_status(I2C_CONTROLLER controller_id, bool no_stop)
 *
 *  \brief   Function to determine controllers current state
@@ -40,6 +40,15 @@
 #else
 #define FUNC_NO_FP	 __attribute__((optimize("-fomit-frame-pointer")))
 #endif
+
+/*
+ * The primitives mask interrupts only around their read-modify-write, so
+ * they are safe from any interrupt priority. With the atomic extension
+ * (-matomic, __ARC_ATOMIC__) the compiler builtins use LLOCK/SCOND and
+ * nothing is masked. atomic_set() and atomic_clear() always use EX, which
+ * every ARCv2 core has.
+ */
+
 /**
  *
  * @brief Atomic compare-and-set primitive
@@ -63,6 +72,10 @@
 FUNC_NO_FP int atomic_cas(atomic_t *target, atomic_val_t old_value,
 			  atomic_val_t new_value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_compare_exchange_n(target, &old_value, new_value, 0,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	int ret = 0;
 
@@ -76,6 +89,7 @@ FUNC_NO_FP int atomic_cas(atomic_t *target, atomic_val_t old_value,
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -93,6 +107,9 @@ FUNC_NO_FP int atomic_cas(atomic_t *target, atomic_val_t old_value,
  */
 FUNC_NO_FP atomic_val_t atomic_add(atomic_t *target, atomic_val_t value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -104,6 +121,7 @@ FUNC_NO_FP atomic_val_t atomic_add(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -121,6 +139,9 @@ FUNC_NO_FP atomic_val_t atomic_add(atomic_t *target, atomic_val_t value)
  */
 FUNC_NO_FP atomic_val_t atomic_sub(atomic_t *target, atomic_val_t value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_sub(target, value, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -132,6 +153,7 @@ FUNC_NO_FP atomic_val_t atomic_sub(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -147,6 +169,9 @@ FUNC_NO_FP atomic_val_t atomic_sub(atomic_t *target, atomic_val_t value)
  */
 FUNC_NO_FP atomic_val_t atomic_inc(atomic_t *target)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_add(target, 1, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -158,6 +183,7 @@ FUNC_NO_FP atomic_val_t atomic_inc(atomic_t *target)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -173,6 +199,9 @@ FUNC_NO_FP atomic_val_t atomic_inc(atomic_t *target)
  */
 FUNC_NO_FP atomic_val_t atomic_dec(atomic_t *target)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_sub(target, 1, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -184,6 +213,7 @@ FUNC_NO_FP atomic_val_t atomic_dec(atomic_t *target)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -217,6 +247,12 @@ FUNC_NO_FP atomic_val_t atomic_get(const atomic_t *target)
  */
 FUNC_NO_FP atomic_val_t atomic_set(atomic_t *target, atomic_val_t value)
 {
+#ifdef __CPU_ARC__
+	atomic_val_t ret = value;
+
+	__asm__ volatile ("ex %0, [%1]" : "+r" (ret) : "r" (target) : "memory");
+	return ret;
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -228,6 +264,7 @@ FUNC_NO_FP atomic_val_t atomic_set(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -244,6 +281,9 @@ FUNC_NO_FP atomic_val_t atomic_set(atomic_t *target, atomic_val_t value)
  */
 FUNC_NO_FP atomic_val_t atomic_clear(atomic_t *target)
 {
+#ifdef __CPU_ARC__
+	return atomic_set(target, 0);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -255,6 +295,7 @@ FUNC_NO_FP atomic_val_t atomic_clear(atomic_t *target)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -272,6 +313,9 @@ FUNC_NO_FP atomic_val_t atomic_clear(atomic_t *target)
  */
 FUNC_NO_FP atomic_val_t atomic_or(atomic_t *target, atomic_val_t value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_or(target, value, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -283,6 +327,7 @@ FUNC_NO_FP atomic_val_t atomic_or(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -300,6 +345,9 @@ FUNC_NO_FP atomic_val_t atomic_or(atomic_t *target, atomic_val_t value)
  */
 FUNC_NO_FP atomic_val_t atomic_xor(atomic_t *target, atomic_val_t value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_xor(target, value, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -311,6 +359,7 @@ FUNC_NO_FP atomic_val_t atomic_xor(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -328,6 +377,9 @@ FUNC_NO_FP atomic_val_t atomic_xor(atomic_t *target, atomic_val_t value)
  */
 FUNC_NO_FP atomic_val_t atomic_and(atomic_t *target, atomic_val_t value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_and(target, value, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -339,6 +391,7 @@ FUNC_NO_FP atomic_val_t atomic_and(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
 
 /**
@@ -356,6 +409,9 @@ FUNC_NO_FP atomic_val_t atomic_and(atomic_t *target, atomic_val_t value)
  */
 FUNC_NO_FP atomic_val_t atomic_nand(atomic_t *target, atomic_val_t value)
 {
+#ifdef __ARC_ATOMIC__
+	return __atomic_fetch_nand(target, value, __ATOMIC_SEQ_CST);
+#else
 	unsigned int key;
 	atomic_val_t ret;
 
@@ -367,4 +423,5 @@ FUNC_NO_FP atomic_val_t atomic_nand(atomic_t *target, atomic_val_t value)
 	irq_unlock(key);
 
 	return ret;
+#endif
 }
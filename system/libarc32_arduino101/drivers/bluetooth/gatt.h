@@ -742,11 +742,32 @@ typedef void (*bt_gatt_notify_sent_func_t)(struct bt_conn *conn, struct bt_gatt_
  *  @param value Attribute value.
  *  @param len Attribute value length.
  *  @param cb callback function called when send is complete (or NULL)
+ *
+ *  @return Number of notifications handed to the controller, each of which
+ *  gets one cb call with a NULL conn if the peer has disconnected meanwhile,
+ *  or negative value in case of error.
  */
 int bt_gatt_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 		   const void *data, uint16_t len,
 		   bt_gatt_notify_sent_func_t cb);
 
+/** @brief Notify attribute value change without copying the value.
+ *
+ *  As bt_gatt_notify(), but data is sent from where it is: each
+ *  notification handed to the controller calls release once its copy of
+ *  data has gone out, possibly from an interrupt, and data must not change
+ *  until then. release is never called when 0 or an error is returned.
+ *
+ *  @param release Called once per notification when data may change again.
+ *  @param release_arg Parameter of release.
+ *
+ *  @return As bt_gatt_notify().
+ */
+int bt_gatt_notify_ref(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+		       const void *data, uint16_t len,
+		       bt_gatt_notify_sent_func_t cb,
+		       void (*release)(void *), void *release_arg);
+
 /** @brief Indication complete result callback.
  *
  *  @param conn Connection object.
@@ -968,6 +989,25 @@ int bt_gatt_write_without_response(struct bt_conn *conn, uint16_t handle,
 				   const void *data, uint16_t length,
 				   bool sign);
 
+/** @brief Write Attribute Value by handle without response, with completion
+ *
+ * As bt_gatt_write_without_response(), but func is called once the nRF core
+ * has queued the write command, so the caller can bound how many commands it
+ * has handed over. func is called even if the connection is gone by then,
+ * with a NULL conn.
+ *
+ * @param conn Connection object.
+ * @param handle Attribute handle.
+ * @param data Data to be written.
+ * @param length Data length.
+ * @param func Callback function.
+ *
+ * @return 0 in case of success or negative value in case of error.
+ */
+int bt_gatt_write_without_response_cb(struct bt_conn *conn, uint16_t handle,
+				      const void *data, uint16_t length,
+				      bt_gatt_write_rsp_func_t func);
+
 struct bt_gatt_subscribe_params;
 
 /** @brief Notification callback function
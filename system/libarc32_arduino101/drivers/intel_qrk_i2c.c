@@ -44,6 +44,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "clk_system.h"
 #include "platform.h"
@@ -51,6 +52,7 @@
 #include "scss_registers.h"
 
 #include "soc_i2c_priv.h"
+#include "soc_dma.h"
 
 typedef uint8_t DATA_BUFF;
 typedef void (*MY_ISR)();
@@ -96,6 +98,18 @@ typedef struct {
     uint32_t slave_addr;
     /* Slave specific */
     SOC_I2C_SLAVE_MODE slave_mode;
+
+    /* DMA, see soc_i2c_master_set_dma() */
+    bool dma;
+    volatile bool dma_active;   /* this transfer uses the channels */
+    volatile bool dma_rx_busy;  /* RX channel still storing bytes */
+    volatile bool dma_stop_seen;
+    uint32_t dma_tx_len;
+    uint32_t dma_cmd;           /* read command the TX channel repeats */
+    struct soc_dma_channel dma_tx;
+    struct soc_dma_channel dma_rx;
+    struct soc_dma_cfg dma_tx_cfg;
+    struct soc_dma_cfg dma_rx_cfg;
 } i2c_internal_data_t;
 
 /* device config keeper */
@@ -129,10 +143,23 @@ static void soc_i2c_enable_device(i2c_internal_data_t *dev, bool enable)
     return;
 }
 
+static void soc_i2c_dma_stop(i2c_internal_data_t *dev)
+{
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DMA_CR) = 0;
+    soc_dma_stop_transfer(&dev->dma_tx);
+    soc_dma_stop_transfer(&dev->dma_rx);
+    dev->dma_rx_busy = false;
+    dev->dma_active = false;
+}
+
 static void soc_end_data_transfer(i2c_internal_data_t *dev)
 {
     uint32_t state = dev->state;
 
+    if (dev->dma_active) {
+        soc_i2c_dma_stop(dev);
+    }
+
     if ((dev->mode == I2C_MASTER) && (dev->send_stop)) {
         soc_i2c_enable_device(dev, false);
     }
@@ -172,6 +199,29 @@ static void soc_i2c_recv_data(i2c_internal_data_t *dev)
     return;
 }
 
+/* Writes the next data or read command, with any pending restart and the
+ * stop on the last one */
+static void soc_i2c_push_cmd(i2c_internal_data_t *dev)
+{
+    uint32_t cmd = 0;
+    if (dev->send_restart) {
+        cmd |= IC_RESTART_BIT;
+        dev->send_restart = false;
+    }
+
+    if (((dev->total_write_bytes + 1) == dev->rx_tx_len) && dev->send_stop) {
+        cmd |= IC_STOP_BIT;
+    }
+
+    if (dev->tx_len > 0) { // something to transmit
+        cmd |= dev->i2c_write_buff[dev->total_write_bytes];
+    } else {
+        cmd |= IC_CMD_BIT;
+    }
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DATA_CMD) = cmd;
+    dev->total_write_bytes++;
+}
+
 static void soc_i2c_xmit_data(i2c_internal_data_t *dev)
 {
     uint32_t tx_limit, rx_limit;
@@ -193,26 +243,11 @@ static void soc_i2c_xmit_data(i2c_internal_data_t *dev)
 
     while (dev->total_write_bytes < dev->rx_tx_len && tx_limit > 0 &&
            rx_limit > 0) {
-        uint32_t cmd = 0;
-        if (dev->send_restart) {
-            cmd |= IC_RESTART_BIT;
-            dev->send_restart = false;
-        }
-
-        if (((dev->total_write_bytes + 1) == dev->rx_tx_len) &&
-            dev->send_stop) {
-            cmd |= IC_STOP_BIT;
-        }
-
-        if (dev->tx_len > 0) { // something to transmit
-            cmd |= dev->i2c_write_buff[dev->total_write_bytes];
-        } else {
-            cmd |= IC_CMD_BIT;
+        if (dev->tx_len == 0) {
             rx_limit--;
         }
-        MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DATA_CMD) = cmd;
+        soc_i2c_push_cmd(dev);
         tx_limit--;
-        dev->total_write_bytes++;
     }
 }
 
@@ -290,6 +325,11 @@ static void soc_i2c_isr(i2c_internal_data_t *dev)
     }
 
     if (stat & IC_INTR_STOP_DET) {
+        /* the RX channel may still be storing the last bytes */
+        if (dev->dma_rx_busy) {
+            dev->dma_stop_seen = true;
+            return;
+        }
         goto done;
     }
 
@@ -309,7 +349,8 @@ DECLARE_INTERRUPT_HANDLER void isr_dev_1()
     soc_i2c_isr(&devices[1]);
 }
 
-static void soc_i2c_master_init_transfer(i2c_internal_data_t *dev)
+static void soc_i2c_master_init_transfer(i2c_internal_data_t *dev,
+                                         uint32_t int_mask)
 {
     volatile uint32_t ic_con = 0, ic_tar = 0;
 
@@ -340,11 +381,194 @@ static void soc_i2c_master_init_transfer(i2c_internal_data_t *dev)
     soc_i2c_enable_device(dev, true);
 
     /* Enable necesary interrupts */
-    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_INTR_MASK) = SOC_ENABLE_RX_TX_INT_I2C;
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_INTR_MASK) = int_mask;
 
     return;
 }
 
+/* TX channel done: the last command, with the stop, and anything past
+ * SOC_I2C_DMA_MAX_LEN are left to the FIFO interrupt, which also ends the
+ * transfer as it would without DMA */
+static void soc_i2c_dma_tx_done(void *arg)
+{
+    i2c_internal_data_t *dev = (i2c_internal_data_t *)arg;
+
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DMA_CR) &= ~IC_DMA_TDMAE;
+    dev->total_write_bytes += dev->dma_tx_len;
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_INTR_MASK) = SOC_DMA_TAIL_INT_I2C;
+}
+
+static void soc_i2c_dma_rx_done(void *arg)
+{
+    i2c_internal_data_t *dev = (i2c_internal_data_t *)arg;
+
+    dev->total_read_bytes = dev->rx_len;
+    dev->dma_rx_busy = false;
+    if (dev->dma_stop_seen) {
+        soc_end_data_transfer(dev);
+    }
+}
+
+static void soc_i2c_dma_error(void *arg)
+{
+    i2c_internal_data_t *dev = (i2c_internal_data_t *)arg;
+
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_INTR_MASK) = SOC_DISABLE_ALL_I2C_INT;
+    dev->cb_err_data = 0;
+    dev->state = I2C_CMD_ERROR;
+    dev->send_stop = true;
+    soc_end_data_transfer(dev);
+}
+
+static bool soc_i2c_dma_reachable(const uint8_t *buf)
+{
+    uint32_t addr = (uint32_t)buf;
+    return addr < SOC_I2C_DCCM_START ||
+           addr >= SOC_I2C_DCCM_START + SOC_I2C_DCCM_SIZE;
+}
+
+/* Master transfers one way, longer than SOC_I2C_DMA_MIN_LEN */
+static bool soc_i2c_dma_usable(i2c_internal_data_t *dev)
+{
+    if (!dev->dma || dev->mode != I2C_MASTER ||
+        dev->rx_tx_len <= SOC_I2C_DMA_MIN_LEN)
+        return false;
+    if (dev->tx_len > 0)
+        return dev->rx_len == 0 && soc_i2c_dma_reachable(dev->i2c_write_buff);
+    return dev->rx_len <= SOC_I2C_DMA_MAX_LEN &&
+           soc_i2c_dma_reachable(dev->i2c_read_buff);
+}
+
+/* The TX channel writes the data, or read commands, but the last; a
+ * pending restart goes first by hand. For reads the RX channel stores
+ * every byte. */
+static DRIVER_API_RC soc_i2c_dma_start(i2c_internal_data_t *dev)
+{
+    uint32_t len;
+
+    if (dev->send_restart) {
+        soc_i2c_push_cmd(dev);
+    }
+    len = dev->rx_tx_len - dev->total_write_bytes - 1;
+    if (len > SOC_I2C_DMA_MAX_LEN) {
+        len = SOC_I2C_DMA_MAX_LEN;
+    }
+    dev->dma_tx_len = len;
+
+    if (dev->tx_len > 0) {
+        dev->dma_tx_cfg.xfer.src.addr =
+            dev->i2c_write_buff + dev->total_write_bytes;
+        dev->dma_tx_cfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+        dev->dma_tx_cfg.xfer.src.width = SOC_DMA_WIDTH_8;
+        dev->dma_tx_cfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    } else {
+        dev->dma_tx_cfg.xfer.src.addr = &dev->dma_cmd;
+        dev->dma_tx_cfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+        dev->dma_tx_cfg.xfer.src.width = SOC_DMA_WIDTH_32;
+        dev->dma_tx_cfg.xfer.dest.width = SOC_DMA_WIDTH_32;
+    }
+    dev->dma_tx_cfg.xfer.size = len;
+    dev->dma_rx_cfg.xfer.dest.addr = dev->i2c_read_buff;
+    dev->dma_rx_cfg.xfer.size = dev->rx_len;
+
+    soc_dma_deconfig(&dev->dma_tx);
+    soc_dma_deconfig(&dev->dma_rx);
+    if (soc_dma_config(&dev->dma_tx, &dev->dma_tx_cfg) != DRV_RC_OK) {
+        return DRV_RC_FAIL;
+    }
+    dev->dma_stop_seen = false;
+    dev->dma_rx_busy = dev->rx_len > 0;
+    if (dev->dma_rx_busy &&
+        (soc_dma_config(&dev->dma_rx, &dev->dma_rx_cfg) != DRV_RC_OK ||
+         soc_dma_start_transfer(&dev->dma_rx) != DRV_RC_OK)) {
+        dev->dma_rx_busy = false;
+        return DRV_RC_FAIL;
+    }
+    if (soc_dma_start_transfer(&dev->dma_tx) != DRV_RC_OK) {
+        soc_dma_stop_transfer(&dev->dma_rx);
+        dev->dma_rx_busy = false;
+        return DRV_RC_FAIL;
+    }
+    dev->dma_active = true;
+
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DMA_TDLR) = SOC_I2C_DMA_TX_LEVEL;
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DMA_RDLR) = 0;
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_DMA_CR) =
+        IC_DMA_TDMAE | (dev->rx_len > 0 ? IC_DMA_RDMAE : 0);
+
+    return DRV_RC_OK;
+}
+
+DRIVER_API_RC soc_i2c_master_set_dma(SOC_I2C_CONTROLLER controller_id,
+                                     bool enable)
+{
+    i2c_internal_data_t *dev = NULL;
+
+    if (controller_id == SOC_I2C_0) {
+        dev = &devices[0];
+    } else if (controller_id == SOC_I2C_1) {
+        dev = &devices[1];
+    } else {
+        return DRV_RC_FAIL;
+    }
+    if (dev->state != I2C_STATE_READY) {
+        return DRV_RC_CONTROLLER_IN_USE;
+    }
+    if (enable == dev->dma) {
+        return DRV_RC_OK;
+    }
+
+    if (!enable) {
+        dev->dma = false;
+        soc_dma_deconfig(&dev->dma_tx);
+        soc_dma_deconfig(&dev->dma_rx);
+        soc_dma_release(&dev->dma_tx);
+        soc_dma_release(&dev->dma_rx);
+        return DRV_RC_OK;
+    }
+
+    soc_dma_init();
+    if (soc_dma_acquire(&dev->dma_rx) != DRV_RC_OK) {
+        return DRV_RC_FAIL;
+    }
+    if (soc_dma_acquire(&dev->dma_tx) != DRV_RC_OK) {
+        soc_dma_release(&dev->dma_rx);
+        return DRV_RC_FAIL;
+    }
+
+    dev->dma_cmd = IC_CMD_BIT;
+
+    memset(&dev->dma_tx_cfg, 0, sizeof(dev->dma_tx_cfg));
+    dev->dma_tx_cfg.type = SOC_DMA_TYPE_MEM2PER;
+    dev->dma_tx_cfg.dest_interface = (controller_id == SOC_I2C_0)
+                                         ? SOC_DMA_INTERFACE_I2C0_TX
+                                         : SOC_DMA_INTERFACE_I2C1_TX;
+    dev->dma_tx_cfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+    dev->dma_tx_cfg.xfer.dest.addr = (void *)(dev->BASE + IC_DATA_CMD);
+    dev->dma_tx_cfg.cb_done = soc_i2c_dma_tx_done;
+    dev->dma_tx_cfg.cb_done_arg = dev;
+    dev->dma_tx_cfg.cb_err = soc_i2c_dma_error;
+    dev->dma_tx_cfg.cb_err_arg = dev;
+
+    memset(&dev->dma_rx_cfg, 0, sizeof(dev->dma_rx_cfg));
+    dev->dma_rx_cfg.type = SOC_DMA_TYPE_PER2MEM;
+    dev->dma_rx_cfg.src_interface = (controller_id == SOC_I2C_0)
+                                        ? SOC_DMA_INTERFACE_I2C0_RX
+                                        : SOC_DMA_INTERFACE_I2C1_RX;
+    dev->dma_rx_cfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+    dev->dma_rx_cfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dev->dma_rx_cfg.xfer.src.addr = (void *)(dev->BASE + IC_DATA_CMD);
+    dev->dma_rx_cfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+    dev->dma_rx_cfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    dev->dma_rx_cfg.cb_done = soc_i2c_dma_rx_done;
+    dev->dma_rx_cfg.cb_done_arg = dev;
+    dev->dma_rx_cfg.cb_err = soc_i2c_dma_error;
+    dev->dma_rx_cfg.cb_err_arg = dev;
+
+    dev->dma = true;
+    return DRV_RC_OK;
+}
+
 static DRIVER_API_RC soc_i2c_init(i2c_internal_data_t *dev)
 {
     volatile uint32_t ic_con = 0;
@@ -632,6 +856,49 @@ DRIVER_API_RC soc_i2c_set_transfer_speed(SOC_I2C_CONTROLLER controller_id,
     return DRV_RC_OK;
 }
 
+DRIVER_API_RC soc_i2c_set_transfer_clock(SOC_I2C_CONTROLLER controller_id,
+                                         uint32_t scl_hz)
+{
+    uint32_t ic_con, hcnt, lcnt, spk_len;
+    i2c_internal_data_t *dev = NULL;
+
+    if (controller_id == SOC_I2C_0) {
+        dev = &devices[0];
+    } else if (controller_id == SOC_I2C_1) {
+        dev = &devices[1];
+    } else {
+        return DRV_RC_FAIL;
+    }
+    if (scl_hz == 0)
+        return DRV_RC_FAIL;
+    if ((dev->state != I2C_STATE_READY) ||
+        (MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_STATUS) & IC_STATUS_ACTIVITY))
+        return DRV_RC_CONTROLLER_IN_USE;
+
+    spk_len = (scl_hz > 400000) ? I2C_FMP_SPKLEN
+                                : MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_FS_SPKLEN);
+    dev->speed = (scl_hz > 100000) ? I2C_FAST : I2C_SLOW;
+    i2c_scl_counts(scl_hz, spk_len, &hcnt, &lcnt);
+
+    soc_i2c_enable_device(dev, false);
+
+    ic_con = MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_CON);
+    ic_con &= ~(0x3 << 1);
+    ic_con |= (dev->speed << 1);
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_CON) = ic_con;
+
+    MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_FS_SPKLEN) = spk_len;
+    if (I2C_FAST == dev->speed) {
+        MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_FS_SCL_HCNT) = hcnt;
+        MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_FS_SCL_LCNT) = lcnt;
+    } else {
+        MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_STD_SCL_HCNT) = hcnt;
+        MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_STD_SCL_LCNT) = lcnt;
+    }
+
+    return DRV_RC_OK;
+}
+
 DRIVER_API_RC soc_i2c_set_transfer_mode(SOC_I2C_CONTROLLER controller_id,
                                         uint32_t mode)
 {
@@ -788,8 +1055,21 @@ DRIVER_API_RC soc_i2c_master_transfer(SOC_I2C_CONTROLLER controller_id,
         dev->send_stop = false;
     }
 
+    if (soc_i2c_dma_usable(dev)) {
+        /* only errors interrupt until the TX channel is done */
+        if (need_init) {
+            soc_i2c_master_init_transfer(dev, SOC_DMA_INT_I2C);
+        } else {
+            MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_INTR_MASK) = SOC_DMA_INT_I2C;
+        }
+        if (soc_i2c_dma_start(dev) == DRV_RC_OK) {
+            return DRV_RC_OK;
+        }
+        need_init = false;
+    }
+
     if (need_init) {
-        soc_i2c_master_init_transfer(dev);
+        soc_i2c_master_init_transfer(dev, SOC_ENABLE_RX_TX_INT_I2C);
     } else {
         /* Enable necesary interrupts */
         MMIO_REG_VAL_FROM_BASE(dev->BASE, IC_INTR_MASK) =
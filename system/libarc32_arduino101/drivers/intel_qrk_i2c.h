@@ -253,6 +253,35 @@ DRIVER_API_RC soc_i2c_slave_enable_tx(SOC_I2C_CONTROLLER controller_id,
 DRIVER_API_RC soc_i2c_set_transfer_speed(SOC_I2C_CONTROLLER controller_id,
                                         uint32_t speed);
 /**
+*  Function to set the SCL frequency, standard mode up to 100 kHz and fast
+*  mode above, with the counts computed for the controller clock
+*
+*  @param   controller_id   : I2C controller_id identifier
+*  @param   scl_hz          : SCL frequency in Hz
+*
+*  @return
+*           - DRV_RC_OK on success
+*           - DRV_RC_CONTROLLER_IN_USE during a transfer
+*           - DRV_RC_FAIL otherwise
+*/
+DRIVER_API_RC soc_i2c_set_transfer_clock(SOC_I2C_CONTROLLER controller_id,
+                                        uint32_t scl_hz);
+/**
+*  Function to move master transfers through DMA: reads or writes longer
+*  than SOC_I2C_DMA_MIN_LEN, with buffers outside DCCM, then interrupt
+*  only at the end. Two DMA channels are held while enabled.
+*
+*  @param   controller_id   : I2C controller_id identifier
+*  @param   enable          : acquire (true) or release (false) the channels
+*
+*  @return
+*           - DRV_RC_OK on success
+*           - DRV_RC_CONTROLLER_IN_USE during a transfer
+*           - DRV_RC_FAIL if no channels are free
+*/
+DRIVER_API_RC soc_i2c_master_set_dma(SOC_I2C_CONTROLLER controller_id,
+                                     bool enable);
+/**
 *  Function to set I2C address mode
 *
 *  @param   controller_id   : I2C controller_id identifier
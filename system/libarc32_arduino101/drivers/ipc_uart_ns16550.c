@@ -44,11 +44,28 @@
 
 #include "portable.h"
 
+#ifdef CONFIG_IPC_UART_DMA
+#include "soc_dma.h"
+#include "dccm_alloc.h"
+#endif
+
 #define BOTH_EMPTY (0x40|0x20) /* TEMT & THRE emtpy */
 #define IPC_UART_MAX_PAYLOAD 128 /* TODO: make it a globals setting to be in sync with nordic */
 
 #define IPC_UART_HDR_REQUEST_LEN (IPC_HEADER_LEN+sizeof(uint32_t)) /* ipc header + request len */
 
+/* RX frames up to IPC_UART_MAX_PAYLOAD bytes come from a pool of their own,
+ * longer ones from balloc(); at most 32 */
+#define IPC_UART_RX_POOL_LEN 4
+
+/* An RPC frame has 3 bytes (signature, function, structure length) ahead of
+ * its structure. Starting pool bodies 1 byte into a word aligns the
+ * structure, which rpc_deserialize() then passes on in place. */
+#define IPC_UART_RX_BODY_OFFSET 1
+
+/* frames send_pdu accepts behind the one on the wire, a power of 2 */
+#define IPC_UART_TX_QUEUE_LEN 8
+
 enum {
 	STATUS_TX_IDLE = 0,
 	STATUS_TX_BUSY,
@@ -58,11 +75,25 @@ enum {
 enum {
 	STATUS_RX_IDLE = 0,
 	STATUS_RX_HDR,
-	STATUS_RX_DATA
+	STATUS_RX_DATA,
+	STATUS_RX_DMA,
+	STATUS_RX_WAIT_BUF
+};
+
+struct ipc_uart_tx_frame {
+	uint8_t *data;
+	const uint8_t *ext;
+	uint16_t len;
+	uint16_t ext_len;
+	uint8_t channel;
 };
 
 struct ipc_uart {
 	uint8_t *tx_data;
+	/* frame body is tx_len bytes at tx_data, then tx_ext_len at tx_ext */
+	const uint8_t *tx_ext;
+	uint16_t tx_len;
+	uint16_t tx_ext_len;
 	uint8_t *rx_ptr;
 	struct ipc_uart_channels channels[IPC_UART_MAX_CHANNEL];
 	struct ipc_uart_header tx_hdr;
@@ -78,10 +109,32 @@ struct ipc_uart {
 	//struct td_device *device;
 	void (*tx_cb)(bool wake_state, void *); /*!< Callback to be called to set wake state when TX is starting or ending */
 	void *tx_cb_param;              /*!< tx_cb function parameter */
+	/* frames waiting for the UART, started from the TX done interrupt */
+	struct ipc_uart_tx_frame tx_q[IPC_UART_TX_QUEUE_LEN];
+	uint8_t tx_q_head;
+	uint8_t tx_q_count;
 };
 
 static struct ipc_uart ipc = {};
 
+static uint8_t ipc_rx_pool[IPC_UART_RX_POOL_LEN][IPC_UART_MAX_PAYLOAD + 4]
+	__attribute__((aligned(4)));
+static uint32_t ipc_rx_pool_used;
+
+#ifdef CONFIG_IPC_UART_DMA
+/* Bodies shorter than this go through the FIFO: setting up a channel costs
+ * about as much as a few FIFO interrupts. The header always does. */
+#define IPC_UART_DMA_MIN_LEN 16
+/* largest block the DMA controller moves in one go */
+#define IPC_UART_DMA_MAX_LEN 4095
+
+static struct soc_dma_channel ipc_dma_tx;
+static struct soc_dma_channel ipc_dma_rx;
+static struct soc_dma_cfg ipc_dma_tx_cfg;
+static struct soc_dma_cfg ipc_dma_rx_cfg;
+static uint8_t ipc_dma_ready;
+#endif
+
 static const struct uart_init_info uart_dev_info[] = {
 	{
 		.regs = PERIPH_ADDR_BASE_UART0,
@@ -123,6 +176,283 @@ void ipc_uart_ns16550_disable(int num)
     
 	UART_IRQ_TX_DISABLE(num);
 	UART_IRQ_RX_DISABLE(num);
+#ifdef CONFIG_IPC_UART_DMA
+	if (ipc_dma_ready) {
+		soc_dma_stop_transfer(&ipc_dma_tx);
+		soc_dma_stop_transfer(&ipc_dma_rx);
+	}
+#endif
+}
+
+static void ipc_uart_push_frame(uint16_t len, uint8_t *p_data);
+
+static void ipc_uart_rx_reset(void)
+{
+	ipc.rx_size = sizeof(ipc.rx_hdr);
+	ipc.rx_ptr = (uint8_t *)&ipc.rx_hdr;
+	ipc.rx_state = STATUS_RX_IDLE;
+}
+
+static void ipc_uart_tx_load(const struct ipc_uart_tx_frame *frame)
+{
+	ipc.tx_hdr.len = frame->len + frame->ext_len;
+	ipc.tx_hdr.channel = frame->channel;
+	ipc.tx_hdr.src_cpu_id = 0;
+	ipc.tx_data = frame->data;
+	ipc.tx_len = frame->len;
+	ipc.tx_ext = frame->ext;
+	ipc.tx_ext_len = frame->ext_len;
+}
+
+/* What is left of the header, data or ext part send_counter is in */
+static int ipc_uart_tx_segment(const uint8_t **p_tx)
+{
+	uint16_t pos = ipc.send_counter;
+
+	if (pos < sizeof(ipc.tx_hdr)) {
+		*p_tx = (const uint8_t *)&ipc.tx_hdr + pos;
+		return sizeof(ipc.tx_hdr) - pos;
+	}
+	pos -= sizeof(ipc.tx_hdr);
+	if (pos < ipc.tx_len) {
+		*p_tx = ipc.tx_data + pos;
+		return ipc.tx_len - pos;
+	}
+	pos -= ipc.tx_len;
+	*p_tx = ipc.tx_ext + pos;
+	return ipc.tx_ext_len - pos;
+}
+
+/* The whole frame is in the UART: start the next queued one, so its header
+ * follows in the same FIFO pass, then hand the buffer back to its channel */
+static void ipc_uart_tx_frame_sent(void)
+{
+	uint8_t *p_tx = ipc.tx_data;
+	uint8_t channel = ipc.tx_hdr.channel;
+	uint16_t len = ipc.tx_len;
+
+	ipc.send_counter = 0;
+#ifdef IPC_UART_DBG_TX
+	pr_debug(LOG_MODULE_IPC, "ipc_uart_isr: sent IPC FRAME len %d",
+		 ipc.tx_hdr.len);
+#endif
+	if (ipc.tx_q_count) {
+		ipc_uart_tx_load(&ipc.tx_q[ipc.tx_q_head]);
+		ipc.tx_q_head = (ipc.tx_q_head + 1) & (IPC_UART_TX_QUEUE_LEN - 1);
+		ipc.tx_q_count--;
+	} else {
+		ipc.tx_data = NULL;
+		ipc.tx_state = STATUS_TX_DONE;
+	}
+
+	/* free sent message and pull send next frame one in the queue */
+	if (ipc.channels[channel].cb)
+		ipc.channels[channel].cb(channel, IPC_MSG_TYPE_FREE, len, p_tx);
+	else
+		bfree(p_tx);
+}
+
+#ifdef CONFIG_IPC_UART_DMA
+static int ipc_uart_dma_reachable(const void *buf, uint16_t len)
+{
+	uint32_t addr = (uint32_t)buf;
+
+	if (!ipc_dma_ready || buf == NULL ||
+	    len < IPC_UART_DMA_MIN_LEN || len > IPC_UART_DMA_MAX_LEN)
+		return 0;
+	/* DCCM is private to the ARC core */
+	return addr < DCCM_START || addr >= DCCM_START + DCCM_SIZE;
+}
+
+static void ipc_uart_dma_tx_done(void *arg)
+{
+	(void)arg;
+	ipc.send_counter += ipc_dma_tx_cfg.xfer.size;
+	if (ipc.send_counter == ipc.tx_hdr.len + sizeof(ipc.tx_hdr))
+		ipc_uart_tx_frame_sent();
+	/* the TX ready interrupt goes on with the next part, or reports the
+	 * end of the frame once the FIFO has drained, as on the FIFO path */
+	UART_IRQ_TX_ENABLE(IPC_UART);
+}
+
+static void ipc_uart_dma_tx_err(void *arg)
+{
+	(void)arg;
+	pr_error(LOG_MODULE_IPC, "uart_ipc: TX DMA failed, frame len %d",
+		 ipc.tx_hdr.len);
+	ipc_uart_dma_tx_done(arg);
+}
+
+static void ipc_uart_dma_rx_done(void *arg)
+{
+	(void)arg;
+	ipc_uart_push_frame(ipc.rx_hdr.len, ipc.rx_ptr);
+	ipc_uart_rx_reset();
+	UART_IRQ_RX_ENABLE(IPC_UART);
+}
+
+static void ipc_uart_dma_rx_err(void *arg)
+{
+	(void)arg;
+	pr_error(LOG_MODULE_IPC, "uart_ipc: RX DMA failed, frame len %d",
+		 ipc.rx_hdr.len);
+	ipc_uart_rx_free(ipc.rx_ptr);
+	ipc_uart_rx_reset();
+	UART_IRQ_RX_ENABLE(IPC_UART);
+}
+
+static void ipc_uart_dma_init(void)
+{
+	void *data_reg = (void *)uart_dev_info[IPC_UART].regs;
+
+	if (ipc_dma_ready)
+		return;
+	soc_dma_init();
+	if (soc_dma_acquire(&ipc_dma_tx) != DRV_RC_OK)
+		goto fail;
+	if (soc_dma_acquire(&ipc_dma_rx) != DRV_RC_OK) {
+		soc_dma_release(&ipc_dma_tx);
+		goto fail;
+	}
+
+	memset(&ipc_dma_tx_cfg, 0, sizeof(ipc_dma_tx_cfg));
+	ipc_dma_tx_cfg.type = SOC_DMA_TYPE_MEM2PER;
+	ipc_dma_tx_cfg.dest_interface = IPC_UART ? SOC_DMA_INTERFACE_UART1_TX :
+						  SOC_DMA_INTERFACE_UART0_TX;
+	ipc_dma_tx_cfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+	ipc_dma_tx_cfg.xfer.src.width = SOC_DMA_WIDTH_8;
+	ipc_dma_tx_cfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+	ipc_dma_tx_cfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+	ipc_dma_tx_cfg.xfer.dest.addr = data_reg;
+	ipc_dma_tx_cfg.cb_done = ipc_uart_dma_tx_done;
+	ipc_dma_tx_cfg.cb_err = ipc_uart_dma_tx_err;
+
+	memset(&ipc_dma_rx_cfg, 0, sizeof(ipc_dma_rx_cfg));
+	ipc_dma_rx_cfg.type = SOC_DMA_TYPE_PER2MEM;
+	ipc_dma_rx_cfg.src_interface = IPC_UART ? SOC_DMA_INTERFACE_UART1_RX :
+						 SOC_DMA_INTERFACE_UART0_RX;
+	ipc_dma_rx_cfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+	ipc_dma_rx_cfg.xfer.src.width = SOC_DMA_WIDTH_8;
+	ipc_dma_rx_cfg.xfer.src.addr = data_reg;
+	ipc_dma_rx_cfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+	ipc_dma_rx_cfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+	ipc_dma_rx_cfg.cb_done = ipc_uart_dma_rx_done;
+	ipc_dma_rx_cfg.cb_err = ipc_uart_dma_rx_err;
+
+	ipc_dma_ready = 1;
+	return;
+fail:
+	pr_warning(LOG_MODULE_IPC, "uart_ipc: no DMA channel, using the FIFO");
+}
+
+/* Moves the frame body with the DMA controller and masks the UART interrupt
+ * for that direction until the done callback; 0 leaves it to the FIFO path */
+static int ipc_uart_dma_start(struct soc_dma_channel *channel,
+			      struct soc_dma_cfg *cfg)
+{
+	soc_dma_deconfig(channel);
+	if (soc_dma_config(channel, cfg) != DRV_RC_OK ||
+	    soc_dma_start_transfer(channel) != DRV_RC_OK)
+		return 0;
+	return 1;
+}
+
+static int ipc_uart_dma_tx_segment(const uint8_t *p_tx, uint16_t len)
+{
+	if (!ipc_uart_dma_reachable(p_tx, len))
+		return 0;
+	ipc_dma_tx_cfg.xfer.src.addr = (void *)p_tx;
+	ipc_dma_tx_cfg.xfer.size = len;
+	UART_IRQ_TX_DISABLE(IPC_UART);
+	if (!ipc_uart_dma_start(&ipc_dma_tx, &ipc_dma_tx_cfg)) {
+		UART_IRQ_TX_ENABLE(IPC_UART);
+		return 0;
+	}
+	return 1;
+}
+
+static int ipc_uart_dma_rx_body(void)
+{
+	if (!ipc_uart_dma_reachable(ipc.rx_ptr, ipc.rx_hdr.len))
+		return 0;
+	ipc_dma_rx_cfg.xfer.dest.addr = ipc.rx_ptr;
+	ipc_dma_rx_cfg.xfer.size = ipc.rx_hdr.len;
+	/* the body bytes already in the FIFO are left there for the DMA */
+	UART_IRQ_RX_DISABLE(IPC_UART);
+	ipc.rx_state = STATUS_RX_DMA;
+	if (!ipc_uart_dma_start(&ipc_dma_rx, &ipc_dma_rx_cfg)) {
+		ipc.rx_state = STATUS_RX_DATA;
+		UART_IRQ_RX_ENABLE(IPC_UART);
+		return 0;
+	}
+	return 1;
+}
+#endif
+
+static void *ipc_uart_rx_alloc(uint16_t len)
+{
+	OS_ERR_TYPE err;
+	void *p_data;
+
+	if (len <= IPC_UART_MAX_PAYLOAD) {
+		uint32_t flags = interrupt_lock();
+		uint32_t free_map = ~ipc_rx_pool_used &
+				    ((1ULL << IPC_UART_RX_POOL_LEN) - 1);
+
+		if (free_map) {
+			int i = __builtin_ctz(free_map);
+
+			ipc_rx_pool_used |= 1UL << i;
+			interrupt_unlock(flags);
+			return ipc_rx_pool[i] + IPC_UART_RX_BODY_OFFSET;
+		}
+		interrupt_unlock(flags);
+	}
+
+	p_data = balloc(len, &err);
+	/* running out is waited for, a frame no pool can hold is fatal */
+	if (p_data == NULL && err != E_OS_ERR_NO_MEMORY)
+		panic(err);
+	return p_data;
+}
+
+/* Header in: get a buffer for the body. Without one the RX interrupt stays
+ * masked, the FIFO fills and RTS holds the BLE core off until
+ * ipc_uart_rx_free() hands a buffer back. */
+static int ipc_uart_rx_start_body(void)
+{
+	ipc.rx_ptr = ipc_uart_rx_alloc(ipc.rx_hdr.len);
+	if (ipc.rx_ptr == NULL) {
+		UART_IRQ_RX_DISABLE(IPC_UART);
+		ipc.rx_state = STATUS_RX_WAIT_BUF;
+		return 0;
+	}
+	ipc.rx_size = ipc.rx_hdr.len;
+	ipc.rx_state = STATUS_RX_DATA;
+#ifdef CONFIG_IPC_UART_DMA
+	ipc_uart_dma_rx_body();
+#endif
+	return 1;
+}
+
+void ipc_uart_rx_free(void *p_data)
+{
+	uint32_t offset = (uint8_t *)p_data - &ipc_rx_pool[0][0];
+	uint32_t flags;
+
+	if (offset < sizeof(ipc_rx_pool)) {
+		flags = interrupt_lock();
+		ipc_rx_pool_used &= ~(1UL << (offset / sizeof(ipc_rx_pool[0])));
+		interrupt_unlock(flags);
+	} else {
+		bfree(p_data);
+	}
+
+	flags = interrupt_lock();
+	if (ipc.rx_state == STATUS_RX_WAIT_BUF &&
+	    ipc_uart_rx_start_body() && ipc.rx_state == STATUS_RX_DATA)
+		UART_IRQ_RX_ENABLE(IPC_UART);
+	interrupt_unlock(flags);
 }
 
 void ipc_uart_init(int num)
@@ -142,11 +472,17 @@ void ipc_uart_init(int num)
 	
 	ipc.uart_enabled = 0;
 	ipc.tx_wakelock_acquired = 0;
+	ipc.tx_q_head = 0;
+	ipc.tx_q_count = 0;
 
 	/* Initialize the reception pointer */
 	ipc.rx_size = sizeof(ipc.rx_hdr);
 	ipc.rx_ptr = (uint8_t *)&ipc.rx_hdr;
 	ipc.rx_state = STATUS_RX_IDLE;
+
+#ifdef CONFIG_IPC_UART_DMA
+	ipc_uart_dma_init();
+#endif
 }
 
 static void ipc_uart_push_frame(uint16_t len, uint8_t *p_data)
@@ -164,7 +500,7 @@ static void ipc_uart_push_frame(uint16_t len, uint8_t *p_data)
 						    len,
 						    p_data);
 	} else {
-		bfree(p_data);
+		ipc_uart_rx_free(p_data);
 		pr_error(LOG_MODULE_IPC, "uart_ipc: bad channel %d",
 			 ipc.rx_hdr.channel);
 	}
@@ -173,7 +509,7 @@ static void ipc_uart_push_frame(uint16_t len, uint8_t *p_data)
 void ipc_uart_isr()
 {
     /* TODO: remove once IRQ supports parameter */
-    uint8_t *p_tx;
+    const uint8_t *p_tx;
 
     while (UART_IRQ_HW_UPDATE(IPC_UART) && 
            UART_IRQ_IS_PENDING(IPC_UART)) {
@@ -188,7 +524,9 @@ void ipc_uart_isr()
         if (UART_IRQ_RX_READY(IPC_UART)) {
             int rx_cnt;
 
-            while ((rx_cnt =
+            while ((ipc.rx_state != STATUS_RX_DMA) &&
+                   (ipc.rx_state != STATUS_RX_WAIT_BUF) &&
+                   (rx_cnt =
                     UART_FIFO_READ(IPC_UART,
                                ipc.rx_ptr,
                                ipc.rx_size)) != 0)
@@ -209,15 +547,7 @@ void ipc_uart_isr()
                 if (ipc.rx_size == 0) {
                     if (ipc.rx_state == STATUS_RX_HDR) {
     //pr_error(0, "%s-%d", __FUNCTION__, ipc.rx_hdr.len);
-                        ipc.rx_ptr = balloc(
-                            ipc.rx_hdr.len, NULL);
-                        
-                            //pr_debug(
-                            //  LOG_MODULE_IPC,
-                            //  "ipc_uart_isr: rx_ptr is %p",
-                            //  ipc.rx_ptr);
-                        ipc.rx_size = ipc.rx_hdr.len;
-                        ipc.rx_state = STATUS_RX_DATA;
+                        ipc_uart_rx_start_body();
                     } else {
 #ifdef IPC_UART_DBG_RX
                         uint8_t *p_rx = ipc.rx_ptr -
@@ -236,10 +566,7 @@ void ipc_uart_isr()
                             ipc.rx_hdr.len,
                             ipc.rx_ptr -
                             ipc.rx_hdr.len);
-                        ipc.rx_size = sizeof(ipc.rx_hdr);
-                        ipc.rx_ptr =
-                            (uint8_t *)&ipc.rx_hdr;
-                        ipc.rx_state = STATUS_RX_IDLE;
+                        ipc_uart_rx_reset();
                     }
                 }
             }
@@ -279,48 +606,20 @@ void ipc_uart_isr()
                 }
                 //pm_wakelock_acquire(&info->tx_wl);
             }
-            if (ipc.send_counter < sizeof(ipc.tx_hdr)) {
-                p_tx = (uint8_t *)&ipc.tx_hdr +
-                       ipc.send_counter;
-                tx_len = sizeof(ipc.tx_hdr) - ipc.send_counter;
-            } else {
-                p_tx = ipc.tx_data +
-                       (ipc.send_counter - sizeof(ipc.tx_hdr));
-                tx_len = ipc.tx_hdr.len -
-                     (ipc.send_counter - sizeof(ipc.tx_hdr));
-            }
+            tx_len = ipc_uart_tx_segment(&p_tx);
+#ifdef CONFIG_IPC_UART_DMA
+            /* the header always goes through the FIFO */
+            if ((ipc.send_counter >= sizeof(ipc.tx_hdr)) &&
+                ipc_uart_dma_tx_segment(p_tx, tx_len))
+                continue;
+#endif
             ipc.send_counter += UART_FIFO_FILL(IPC_UART, 
                                                p_tx,
                                                tx_len);
 
             if (ipc.send_counter ==
                 (ipc.tx_hdr.len + sizeof(ipc.tx_hdr))) {
-                ipc.send_counter = 0;
-#ifdef IPC_UART_DBG_TX
-                pr_debug(
-                    LOG_MODULE_IPC,
-                    "ipc_uart_isr: sent IPC FRAME "
-                    "len %d", ipc.tx_hdr.len);
-#endif
-
-                p_tx = ipc.tx_data;
-                ipc.tx_data = NULL;
-                ipc.tx_state = STATUS_TX_DONE;
-
-                /* free sent message and pull send next frame one in the queue */
-                if (ipc.channels[ipc.tx_hdr.channel].cb)
-                {
-                    ipc.channels[ipc.tx_hdr.channel].cb(
-                        ipc.tx_hdr.channel,
-                        IPC_MSG_TYPE_FREE,
-                        ipc.tx_hdr.len,
-                        p_tx);
-                }
-                else
-                {
-                    bfree(p_tx);
-                }
-                
+                ipc_uart_tx_frame_sent();
 #ifdef IPC_UART_DBG_TX
                 uint8_t lsr = UART_LINE_STATUS(IPC_UART);//(info->uart_num);
                 pr_debug(LOG_MODULE_IPC,
@@ -365,26 +664,47 @@ void *ipc_uart_channel_open(int channel_id,
 }
 
 int ipc_uart_ns16550_send_pdu(void *handle, int len, void *p_data)
+{
+	return ipc_uart_ns16550_send_pdu_ext(handle, len, p_data, 0, NULL);
+}
+
+int ipc_uart_ns16550_send_pdu_ext(void *handle, int len, void *p_data,
+				  int ext_len, const void *p_ext)
 {
 	struct ipc_uart_channels *chan = (struct ipc_uart_channels *)handle;
+	struct ipc_uart_tx_frame frame;
+	uint32_t flags;
+
+	frame.data = p_data;
+	frame.ext = p_ext;
+	frame.len = len;
+	frame.ext_len = p_ext ? ext_len : 0;
+	frame.channel = chan->index;
 
     //pr_debug(LOG_MODULE_IPC, "%s: %d", __FUNCTION__, ipc.tx_state);
 
+	flags = interrupt_lock();
 	if (ipc.tx_state == STATUS_TX_BUSY) {
-		return IPC_UART_TX_BUSY;
+		/* queued, the TX done interrupt starts it */
+		if (ipc.tx_q_count == IPC_UART_TX_QUEUE_LEN) {
+			interrupt_unlock(flags);
+			return IPC_UART_TX_BUSY;
+		}
+		ipc.tx_q[(ipc.tx_q_head + ipc.tx_q_count) &
+			 (IPC_UART_TX_QUEUE_LEN - 1)] = frame;
+		ipc.tx_q_count++;
+		interrupt_unlock(flags);
+		return IPC_UART_ERROR_OK;
 	}
 	
 	/* It is eventually possible to be in DONE state (sending last bytes of previous message),
 	 * so we move immediately to BUSY and configure the next frame */
 	ipc.tx_state = STATUS_TX_BUSY;
-
-	ipc.tx_hdr.len = len;
-	ipc.tx_hdr.channel = chan->index;
-	ipc.tx_hdr.src_cpu_id = 0;
-	ipc.tx_data = p_data;
+	ipc_uart_tx_load(&frame);
 
 	/* Enable the interrupt (ready will expire if it was disabled) */
 	UART_IRQ_TX_ENABLE(IPC_UART);
+	interrupt_unlock(flags);
 
 	return IPC_UART_ERROR_OK;
 }
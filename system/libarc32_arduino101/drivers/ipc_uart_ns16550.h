@@ -38,7 +38,7 @@
 enum IPC_UART_RESULT_CODES {
 	IPC_UART_ERROR_OK = 0,
 	IPC_UART_ERROR_DATA_TO_BIG,
-	IPC_UART_TX_BUSY /**< A transmission is already ongoing, message is NOT sent */
+	IPC_UART_TX_BUSY /**< The TX queue is full, message is NOT sent */
 };
 
 
@@ -95,7 +95,15 @@ void ipc_uart_isr();
 void ipc_uart_ns16550_disable(int num);
 void ipc_uart_close_channel(int channel_id);
 void ipc_uart_ns16550_set_tx_cb(void (*cb)(bool, void *), void *param);
+/* Returns a frame passed to the channel callback with
+ * IPC_MSG_TYPE_MESSAGE, in place of bfree() */
+void ipc_uart_rx_free(void *p_data);
 int ipc_uart_ns16550_send_pdu(void *handle, int len, void *p_data);
+/* One frame of len bytes at p_data followed by ext_len at p_ext, e.g. an
+ * RPC header and a payload sent in place. The IPC_MSG_TYPE_FREE callback
+ * gets p_data; p_ext must stay untouched until then. */
+int ipc_uart_ns16550_send_pdu_ext(void *handle, int len, void *p_data,
+				  int ext_len, const void *p_ext);
 void *ipc_uart_channel_open(int channel_id,
 			    int (*cb)(int, int, int, void *));
 
@@ -101,6 +101,7 @@ INCLUDE FILES: drivers/uart.h
 #define IIR_RLS 0x06   /* receiver line status */
 #define IIR_ID 0x06    /* interupt ID mask without IP */
 #define IIR_SEOB 0x06  /* serialization error or break */
+#define IIR_CTO 0x0C   /* character timeout, rx FIFO idle with data */
 
 /* equates for FIFO control register */
 
@@ -473,6 +474,22 @@ int uart_irq_rx_ready(int which /* UART to check */
 	return ((IIRC(which) & IIR_ID) == IIR_RBRF);
 }
 
+/*******************************************************************************
+*
+* uart_irq_rx_timeout - check if Rx IRQ is a character timeout
+*
+* The receiver raises this when the FIFO holds data but nothing was received
+* for four character times, i.e. the line went idle after a burst.
+*
+* RETURNS: 1 if the pending Rx IRQ is a timeout, 0 otherwise
+*/
+
+int uart_irq_rx_timeout(int which /* UART to check */
+			       )
+{
+	return ((IIRC(which) & (IIR_ID | 0x08)) == IIR_CTO);
+}
+
 /*******************************************************************************
 *
 * uart_irq_err_enable - enable error interrupt in IER
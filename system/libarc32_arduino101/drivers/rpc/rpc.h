@@ -52,6 +52,21 @@ uint8_t * rpc_alloc_cb(uint16_t length);
  */
 void rpc_transmit_cb(uint8_t * p_buf, uint16_t length);
 
+/**
+ * RPC scatter-gather transmission function, must be implemented by the user of the RPC.
+ *
+ * Sends p_buf and then p_ext as one message, without copying p_ext.
+ *
+ * @param p_buf Pointer to the buffer allocated for transmission by @ref rpc_alloc_cb
+ * @param length Length of the buffer to transmit
+ * @param p_ext Pointer to the data sent after p_buf, untouched until release is called
+ * @param ext_length Length of p_ext
+ * @param release Function called, possibly from an interrupt, once p_ext has been sent
+ * @param arg Parameter of release
+ */
+void rpc_transmit_ext_cb(uint8_t * p_buf, uint16_t length, const uint8_t * p_ext,
+		uint16_t ext_length, void (*release)(void *), void * arg);
+
 /**
  * RPC serialization function to serialize a function that does not require any parameter.
  *
@@ -98,6 +113,20 @@ void rpc_serialize_p(uint8_t fn_index, void * p_priv);
  */
 void rpc_serialize_s_b(uint8_t fn_index, const void * struct_data, uint8_t struct_length, const void * vbuf, uint16_t vbuf_length);
 
+/**
+ * As @ref rpc_serialize_s_b, with the buffer sent in place instead of copied.
+ *
+ * @param fn_index Index of the function
+ * @param struct_data Pointer to the structure to serialize
+ * @param struct_length Length of the structure to serialize
+ * @param vbuf Pointer to the buffer to send, untouched until release is called
+ * @param vbuf_length Length of the buffer to send
+ * @param release Function called, possibly from an interrupt, once vbuf has been sent
+ * @param arg Parameter of release
+ */
+void rpc_serialize_s_b_ref(uint8_t fn_index, const void * struct_data, uint8_t struct_length,
+		const void * vbuf, uint16_t vbuf_length, void (*release)(void *), void * arg);
+
 /**
  * RPC serialization function to serialize a function that expects a structure
  * and a buffer as parameters.
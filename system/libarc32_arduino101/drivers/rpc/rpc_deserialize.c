@@ -103,6 +103,38 @@ static uint8_t m_size_s_b_b_p[] = { LIST_FN_SIG_S_B_B_P };
 #undef FN_SIG_S_B_P
 #undef FN_SIG_S_B_B_P
 
+/* 1b - the alignment each structure needs to be passed in place */
+#define FN_SIG_NONE(__fn)
+
+#define FN_SIG_S(__fn, __s) __alignof__(*((__s)0)),
+
+#define FN_SIG_P(__fn, __type)
+
+#define FN_SIG_S_B(__fn, __s, __type, __length) __alignof__(*((__s)0)),
+
+#define FN_SIG_B_B_P(__fn, __type1, __length1, __type2, __length2, __type3)
+
+#define FN_SIG_S_P(__fn, __s, __type) __alignof__(*((__s)0)),
+
+#define FN_SIG_S_B_P(__fn, __s, __type, __length, __type_ptr) __alignof__(*((__s)0)),
+
+#define FN_SIG_S_B_B_P(__fn, __s, __type1, __length1, __type2, __length2, __type3) __alignof__(*((__s)0)),
+
+static const uint8_t m_align_s[] = { LIST_FN_SIG_S };
+static const uint8_t m_align_s_b[] = { LIST_FN_SIG_S_B };
+static const uint8_t m_align_s_p[] = { LIST_FN_SIG_S_P };
+static const uint8_t m_align_s_b_p[] = { LIST_FN_SIG_S_B_P };
+static const uint8_t m_align_s_b_b_p[] = { LIST_FN_SIG_S_B_B_P };
+
+#undef FN_SIG_NONE
+#undef FN_SIG_S
+#undef FN_SIG_P
+#undef FN_SIG_S_B
+#undef FN_SIG_B_B_P
+#undef FN_SIG_S_P
+#undef FN_SIG_S_B_P
+#undef FN_SIG_S_B_B_P
+
 /* 2- build the enumerations list */
 #define FN_SIG_NONE(__fn)                                                          fn_index_##__fn,
 #define FN_SIG_S(__fn, __s)                                                        FN_SIG_NONE(__fn)
@@ -151,6 +183,15 @@ static void (*m_fct_s_p[])(void * structure, void * pointer) = { LIST_FN_SIG_S_P
 static void (*m_fct_s_b_p[])(void * structure, void * buffer, uint8_t length, void * pointer) = { LIST_FN_SIG_S_B_P };
 static void (*m_fct_s_b_b_p[])(void * structure, void * buffer1, uint8_t length1, void * buffer2, uint8_t length2, void * pointer) = { LIST_FN_SIG_S_B_B_P };
 
+/*
+ * Structures and buffers are passed to the callee where they are in the
+ * received frame, which is only freed once rpc_deserialize() returns. Only
+ * those not aligned as the callee needs are copied: a structure as its type
+ * requires (the IPC UART RX pool places it on a word), a buffer on a word
+ * boundary, as callees may read it as an array of structures.
+ */
+#define IN_PLACE(p, align) ((((uintptr_t)(p)) & ((align) - 1)) == 0)
+
 static const uint8_t * deserialize_struct(const uint8_t *p, const uint8_t **pp_struct, uint8_t *p_struct_length) {
 	uint8_t struct_length;
 
@@ -199,8 +240,13 @@ static void deserialize_s(uint8_t fn_index, const uint8_t * p_buf, uint16_t leng
 	   (struct_length != m_size_s[fn_index]))
 		panic(-1);
 
+	if (IN_PLACE(p_struct_data, m_align_s[fn_index])) {
+		m_fct_s[fn_index]((void *)p_struct_data);
+		return;
+	}
+
 	{
-		/* Always align structures on word boundary */
+		/* Copies, if needed, aligned on word boundary */
 		uintptr_t struct_data[(struct_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 
 		memcpy(struct_data, p_struct_data, struct_length);
@@ -236,19 +282,26 @@ static void deserialize_s_b(uint8_t fn_index, const uint8_t * p_buf, uint16_t le
 		panic(-1);
 
 	{
-		/* Always align structures on word boundary */
+		/* Copies, if needed, aligned on word boundary */
 		uintptr_t struct_data[(struct_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 		uintptr_t vbuf[(vbuf_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
+		void * st = (void *)p_struct_data;
 		void * buf = NULL;
 
-		memcpy(struct_data, p_struct_data, struct_length);
+		if (!IN_PLACE(st, m_align_s_b[fn_index])) {
+			memcpy(struct_data, p_struct_data, struct_length);
+			st = struct_data;
+		}
 
 		if (vbuf_length) {
-			memcpy(vbuf, p_vbuf, vbuf_length);
-			buf = vbuf;
+			buf = (void *)p_vbuf;
+			if (!IN_PLACE(buf, sizeof(uintptr_t))) {
+				memcpy(vbuf, p_vbuf, vbuf_length);
+				buf = vbuf;
+			}
 		}
 
-		m_fct_s_b[fn_index](struct_data, buf, vbuf_length);
+		m_fct_s_b[fn_index](st, buf, vbuf_length);
 	}
 }
 
@@ -268,20 +321,26 @@ static void deserialize_b_b_p(uint8_t fn_index, const uint8_t * p_buf, uint16_t
 		panic(-1);
 
 	{
-		/* Always align structures on word boundary */
+		/* Copies, if needed, aligned on word boundary */
 		uintptr_t vbuf1[(vbuf1_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 		uintptr_t vbuf2[(vbuf2_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 		void * buf1 = NULL;
 		void * buf2 = NULL;
 
 		if (vbuf1_length) {
-			memcpy(vbuf1, p_vbuf1, vbuf1_length);
-			buf1 = vbuf1;
+			buf1 = (void *)p_vbuf1;
+			if (!IN_PLACE(buf1, sizeof(uintptr_t))) {
+				memcpy(vbuf1, p_vbuf1, vbuf1_length);
+				buf1 = vbuf1;
+			}
 		}
 
 		if (vbuf2_length) {
-			memcpy(vbuf2, p_vbuf2, vbuf2_length);
-			buf2 = vbuf2;
+			buf2 = (void *)p_vbuf2;
+			if (!IN_PLACE(buf2, sizeof(uintptr_t))) {
+				memcpy(vbuf2, p_vbuf2, vbuf2_length);
+				buf2 = vbuf2;
+			}
 		}
 		p = p_vbuf2 + vbuf2_length;
 
@@ -307,16 +366,20 @@ static void deserialize_s_p(uint8_t fn_index, const uint8_t * p_buf, uint16_t le
 		panic(-1);
 
 	{
-		/* Always align structures on word boundary */
+		/* Copies, if needed, aligned on word boundary */
 		uintptr_t struct_data[(struct_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
+		void * st = (void *)p_struct_data;
 
-		memcpy(struct_data, p_struct_data, struct_length);
+		if (!IN_PLACE(st, m_align_s_p[fn_index])) {
+			memcpy(struct_data, p_struct_data, struct_length);
+			st = struct_data;
+		}
 		p = p_struct_data + struct_length;
 
 		/* little endian conversion */
 		p_priv = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
 
-		m_fct_s_p[fn_index](struct_data, (void *)p_priv);
+		m_fct_s_p[fn_index](st, (void *)p_priv);
 	}
 }
 
@@ -338,23 +401,30 @@ static void deserialize_s_b_p(uint8_t fn_index, const uint8_t * p_buf, uint16_t
 		panic(-1);
 
 	{
-		/* Always align structures on word boundary */
+		/* Copies, if needed, aligned on word boundary */
 		uintptr_t struct_data[(struct_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 		uintptr_t vbuf[(vbuf_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
+		void * st = (void *)p_struct_data;
 		void * buf = NULL;
 
-		memcpy(struct_data, p_struct_data, struct_length);
+		if (!IN_PLACE(st, m_align_s_b_p[fn_index])) {
+			memcpy(struct_data, p_struct_data, struct_length);
+			st = struct_data;
+		}
 
 		if (vbuf_length) {
-			memcpy(vbuf, p_vbuf, vbuf_length);
-			buf = vbuf;
+			buf = (void *)p_vbuf;
+			if (!IN_PLACE(buf, sizeof(uintptr_t))) {
+				memcpy(vbuf, p_vbuf, vbuf_length);
+				buf = vbuf;
+			}
 		}
 		p = p_vbuf + vbuf_length;
 
 		/* little endian conversion */
 		p_priv = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
 
-		m_fct_s_b_p[fn_index](struct_data, buf, vbuf_length, (void *)p_priv);
+		m_fct_s_b_p[fn_index](st, buf, vbuf_length, (void *)p_priv);
 	}
 }
 
@@ -377,22 +447,32 @@ static void deserialize_s_b_b_p(uint8_t fn_index, const uint8_t * p_buf, uint16_
 		panic(-1);
 
 	{
-		/* Always align structures on word boundary */
+		/* Copies, if needed, aligned on word boundary */
 		uintptr_t struct_data[(struct_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 		uintptr_t vbuf1[(vbuf1_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
 		uintptr_t vbuf2[(vbuf2_length + (sizeof(uintptr_t) - 1))/(sizeof(uintptr_t))];
+		void * st = (void *)p_struct_data;
 		void * buf1 = NULL;
 		void * buf2 = NULL;
 
-		memcpy(struct_data, p_struct_data, struct_length);
+		if (!IN_PLACE(st, m_align_s_b_b_p[fn_index])) {
+			memcpy(struct_data, p_struct_data, struct_length);
+			st = struct_data;
+		}
 
 		if (vbuf1_length) {
-			memcpy(vbuf1, p_vbuf1, vbuf1_length);
-			buf1 = vbuf1;
+			buf1 = (void *)p_vbuf1;
+			if (!IN_PLACE(buf1, sizeof(uintptr_t))) {
+				memcpy(vbuf1, p_vbuf1, vbuf1_length);
+				buf1 = vbuf1;
+			}
 		}
 		if (vbuf2_length) {
-			memcpy(vbuf2, p_vbuf2, vbuf2_length);
-			buf2 = vbuf2;
+			buf2 = (void *)p_vbuf2;
+			if (!IN_PLACE(buf2, sizeof(uintptr_t))) {
+				memcpy(vbuf2, p_vbuf2, vbuf2_length);
+				buf2 = vbuf2;
+			}
 		}
 
 		p = p_vbuf2 + vbuf2_length;
@@ -400,7 +480,7 @@ static void deserialize_s_b_b_p(uint8_t fn_index, const uint8_t * p_buf, uint16_
 		/* little endian conversion */
 		p_priv = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
 
-		m_fct_s_b_b_p[fn_index](struct_data, buf1, vbuf1_length, buf2, vbuf2_length, (void *)p_priv);
+		m_fct_s_b_b_p[fn_index](st, buf1, vbuf1_length, buf2, vbuf2_length, (void *)p_priv);
 	}
 }
 
@@ -112,6 +112,15 @@ LIST_FN_SIG_S_P
 LIST_FN_SIG_S_B_P
 LIST_FN_SIG_S_B_B_P
 
+#if !defined(CONFIG_QUARK_SE_BLE_CORE)
+/* Notification with the value sent in place, see rpc_serialize_s_b_ref() */
+void nble_gatt_send_notif_ref_req(const struct nble_gatt_send_notif_params *p_params,
+		const uint8_t *p_value, uint16_t length, void (*release)(void *), void *arg) {
+	rpc_serialize_s_b_ref(fn_index_nble_gatt_send_notif_req, p_params,
+			sizeof(*p_params), p_value, length, release, arg);
+}
+#endif
+
 #define SIG_TYPE_SIZE 1
 #define FN_INDEX_SIZE 1
 #define POINTER_SIZE 4
@@ -143,13 +152,8 @@ static uint16_t encoded_buflen(const uint8_t *buf, uint16_t buflen) {
 	}
 }
 
-static uint8_t *serialize_buf(uint8_t *p, const uint8_t *buf, uint16_t buflen) {
-	uint16_t varint;
-
-	if (NULL == buf)
-		buflen = 0;
-
-	varint = buflen;
+static uint8_t *serialize_buflen(uint8_t *p, uint16_t buflen) {
+	uint16_t varint = buflen;
 
 	*p = varint & 0x7F;
 	if (varint >= (1 << 7)) {
@@ -158,6 +162,14 @@ static uint8_t *serialize_buf(uint8_t *p, const uint8_t *buf, uint16_t buflen) {
 		*p = varint >> 7;
 	}
 	p++;
+	return p;
+}
+
+static uint8_t *serialize_buf(uint8_t *p, const uint8_t *buf, uint16_t buflen) {
+	if (NULL == buf)
+		buflen = 0;
+
+	p = serialize_buflen(p, buflen);
 	memcpy(p, buf, buflen);
 	p += buflen;
 	return p;
@@ -238,6 +250,29 @@ void rpc_serialize_s_b(uint8_t fn_index, const void * struct_data, uint8_t struc
 	_send(buf, length);
 }
 
+void rpc_serialize_s_b_ref(uint8_t fn_index, const void * struct_data, uint8_t struct_length,
+		const void * vbuf, uint16_t vbuf_length, void (*release)(void *), void * arg) {
+	uint16_t length;
+	uint8_t * buf;
+	uint8_t * p;
+
+	if (NULL == vbuf)
+		vbuf_length = 0;
+
+	/* the buffer is the last field, so only its length prefix is in buf */
+	length = SIG_TYPE_SIZE + FN_INDEX_SIZE + encoded_structlen(struct_length) +
+			encoded_buflen(vbuf, vbuf_length) - vbuf_length;
+
+	p = buf = rpc_alloc_cb(length);
+
+	*p++ = SIG_TYPE_S_B;
+	*p++ = fn_index;
+	p = serialize_struct(p, struct_data, struct_length);
+	p = serialize_buflen(p, vbuf_length);
+
+	rpc_transmit_ext_cb(buf, length, vbuf, vbuf_length, release, arg);
+}
+
 void rpc_serialize_b_b_p(uint8_t fn_index, const void * vbuf1, uint16_t vbuf1_length, const void * vbuf2, uint16_t vbuf2_length, void * p_priv) {
 	uint16_t length;
 	uint8_t * buf;
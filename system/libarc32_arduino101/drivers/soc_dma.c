@@ -33,6 +33,7 @@
 #include "os/os.h"
 #include "data_type.h"
 #include "clk_system.h"
+#include <string.h>
 
 #include "soc_dma.h"
 #include "soc_dma_priv.h"
@@ -59,8 +60,9 @@
 static void dma_disable(struct soc_dma_channel *channel);
 static void dma_enable(struct soc_dma_channel *channel);
 static struct soc_dma_xfer_item *dma_find_list_end(struct soc_dma_xfer_item *head);
-static struct dma_lli *dma_find_ll_end(struct dma_lli *head);
 static DRIVER_API_RC dma_create_ll(struct soc_dma_channel *channel, struct soc_dma_cfg *cfg);
+static struct dma_lli *dma_lli_get(void);
+static void dma_lli_put(struct dma_lli *lli);
 static void dma_interrupt_handler(void *num);
 DRIVER_API_RC soc_dma_config(struct soc_dma_channel *channel, struct soc_dma_cfg *cfg);
 DRIVER_API_RC soc_dma_deconfig(struct soc_dma_channel *channel);
@@ -82,6 +84,36 @@ DECLARE_INTERRUPT_HANDLER static void dma_ch1_interrupt_handler()
     dma_interrupt_handler((void *)1);
 }
 
+DECLARE_INTERRUPT_HANDLER static void dma_ch2_interrupt_handler()
+{
+    dma_interrupt_handler((void *)2);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_ch3_interrupt_handler()
+{
+    dma_interrupt_handler((void *)3);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_ch4_interrupt_handler()
+{
+    dma_interrupt_handler((void *)4);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_ch5_interrupt_handler()
+{
+    dma_interrupt_handler((void *)5);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_ch6_interrupt_handler()
+{
+    dma_interrupt_handler((void *)6);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_ch7_interrupt_handler()
+{
+    dma_interrupt_handler((void *)7);
+}
+
 struct soc_dma_info g_dma_info = {
 	.int_mask = {
 		INT_DMA_CHANNEL_0_MASK,
@@ -106,12 +138,12 @@ struct soc_dma_info g_dma_info = {
 	.int_handler = {
 		dma_ch0_interrupt_handler,
 		dma_ch1_interrupt_handler,
-		NULL,
-		NULL,
-		NULL,
-		NULL,
-		NULL,
-		NULL
+		dma_ch2_interrupt_handler,
+		dma_ch3_interrupt_handler,
+		dma_ch4_interrupt_handler,
+		dma_ch5_interrupt_handler,
+		dma_ch6_interrupt_handler,
+		dma_ch7_interrupt_handler
 	},
 	.err_mask = INT_DMA_ERROR_MASK,
 	.err_vector = SOC_DMA_ERR_INTERRUPT
@@ -119,6 +151,23 @@ struct soc_dma_info g_dma_info = {
 
 static struct soc_dma_info* dma_info = &g_dma_info;
 
+// Channels with an interrupt handler here; the core looks for this symbol to
+// tell this build from the prebuilt library, which only handled 0 and 1
+const uint8_t soc_dma_isr_channels = SOC_DMA_NUM_CHANNELS;
+
+// Set once soc_dma_init() has run, so several drivers can share the engine
+static uint8_t dma_initialized = 0;
+
+// Descriptors given back by soc_dma_deconfig() and soc_dma_free_list(), kept
+// for the next config instead of going back to balloc(); the pools only grow
+// to the most ever in use at once, so repeated transfers don't allocate
+static struct dma_lli *dma_lli_pool = NULL;
+static struct soc_dma_xfer_item *dma_xfer_pool = NULL;
+
+// Where each channel's LL loops back to (NULL if it doesn't), recorded when
+// it is built so that freeing it needs no cycle search
+static struct dma_lli *dma_ll_end[SOC_DMA_NUM_CHANNELS];
+
 /* Internal Functions */
 static void dma_disable(struct soc_dma_channel *channel)
 {
@@ -198,6 +247,43 @@ static void dma_enable(struct soc_dma_channel *channel)
 	return;
 }
 
+static struct dma_lli *dma_lli_get(void)
+{
+	OS_ERR_TYPE err;
+	struct dma_lli *lli;
+	uint32_t save;
+
+	save = interrupt_lock();
+	lli = dma_lli_pool;
+	if (lli)
+	{
+		dma_lli_pool = (struct dma_lli *)(lli->llp);
+	}
+	interrupt_unlock(save);
+
+	if (lli == NULL)
+	{
+		lli = balloc(sizeof(struct dma_lli), &err);
+		if (lli == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	memset(lli, 0, sizeof(struct dma_lli));
+	return lli;
+}
+
+static void dma_lli_put(struct dma_lli *lli)
+{
+	uint32_t save;
+
+	save = interrupt_lock();
+	lli->llp = (uint32_t)dma_lli_pool;
+	dma_lli_pool = lli;
+	interrupt_unlock(save);
+}
+
 static struct soc_dma_xfer_item *dma_find_list_end(struct soc_dma_xfer_item *head)
 {
 	struct soc_dma_xfer_item *t;
@@ -239,50 +325,8 @@ static struct soc_dma_xfer_item *dma_find_list_end(struct soc_dma_xfer_item *hea
 	return t;
 }
 
-static struct dma_lli *dma_find_ll_end(struct dma_lli *head)
-{
-	struct dma_lli *t;
-	struct dma_lli *h;
-
-	// Get rid of easy cases
-	if ((head == NULL) || (((struct dma_lli *)(head->llp)) == NULL) ||
-	    (((struct dma_lli *)(((struct dma_lli *)(head->llp))->llp)) == NULL)) 
-	{
-		return NULL;
-	}
-
-	// Tortoise and hare check for cyclic ll
-	t = (struct dma_lli *)(head->llp);
-	h = (struct dma_lli *)(((struct dma_lli *)(head->llp))->llp);
-	while (t != h)
-	{
-		h = (struct dma_lli *)(h->llp);
-		if (h == NULL)
-		{
-			return NULL;
-		}
-		h = (struct dma_lli *)(h->llp);
-		if (h == NULL)
-		{
-			return NULL;
-		}
-		t = (struct dma_lli *)(t->llp);
-	}
-
-	// Find the meeting place since a cycle was detected
-	t = head;
-	while (t != h) 
-	{
-		t = (struct dma_lli *)(t->llp);
-		h = (struct dma_lli *)(h->llp);
-	}
-
-	return t;
-}
-
 static DRIVER_API_RC dma_create_ll(struct soc_dma_channel *channel, struct soc_dma_cfg *cfg)
 {
-	OS_ERR_TYPE err;
 	struct dma_lli *lli;
 	struct dma_lli *last_lli;
 	struct soc_dma_xfer_item *xfer;
@@ -296,7 +340,7 @@ static DRIVER_API_RC dma_create_ll(struct soc_dma_channel *channel, struct soc_d
 	uint32_t reg;
 
 	// Save the LL
-	channel->ll = balloc(sizeof(struct dma_lli), &err);
+	channel->ll = dma_lli_get();
 	lli = (struct dma_lli *)(channel->ll);
 	last_lli = NULL;
 
@@ -374,7 +418,7 @@ static DRIVER_API_RC dma_create_ll(struct soc_dma_channel *channel, struct soc_d
 			if (size_left > SOC_DMA_BLOCK_SIZE_MAX) 
 			{
 				lli->end_group = 0;
-				lli->llp = (uint32_t)balloc(sizeof(struct dma_lli), &err);
+				lli->llp = (uint32_t)dma_lli_get();
 
 				if (lli->llp  == 0) 
 				{
@@ -424,6 +468,7 @@ static DRIVER_API_RC dma_create_ll(struct soc_dma_channel *channel, struct soc_d
 		if ((xfer->next) == last_xfer) 
 		{
 			lli->llp = (uint32_t)last_lli;
+			dma_ll_end[channel->id] = last_lli;
 			list_done = 1;
 
 			if (lli->llp == 0) 
@@ -435,7 +480,7 @@ static DRIVER_API_RC dma_create_ll(struct soc_dma_channel *channel, struct soc_d
 		} 
 		else 
 		{
-			lli->llp = (uint32_t)balloc(sizeof(struct dma_lli), &err);
+			lli->llp = (uint32_t)dma_lli_get();
 
 			if (lli->llp == 0) 
 			{
@@ -591,26 +636,19 @@ DRIVER_API_RC soc_dma_deconfig(struct soc_dma_channel *channel)
 		return DRV_RC_CONTROLLER_IN_USE;
 	}
 
-	// Free the link list
+	// Give the link list back to the pool
 	lli = (struct dma_lli *)(channel->ll);
-	last_lli = dma_find_ll_end(lli);
+	last_lli = dma_ll_end[channel->id];
 
 	while (lli) 
 	{
-		if (((struct dma_lli *)(lli->llp)) == last_lli) 
-		{
-			bfree(lli);
-			lli = NULL;
-		} 
-		else 
-		{
-			lli_next = ((struct dma_lli *)(lli->llp));
-			bfree(lli);
-			lli = lli_next;
-		}
+		lli_next = ((struct dma_lli *)(lli->llp));
+		dma_lli_put(lli);
+		lli = (lli_next == last_lli) ? NULL : lli_next;
 	}
 
 	channel->ll = NULL;
+	dma_ll_end[channel->id] = NULL;
 
 	channel->cfgd = 0;
 
@@ -710,8 +748,20 @@ DRIVER_API_RC soc_dma_stop_transfer(struct soc_dma_channel *channel)
 DRIVER_API_RC soc_dma_alloc_list_item(struct soc_dma_xfer_item **ret, struct soc_dma_xfer_item *base)
 {
 	OS_ERR_TYPE err;
+	uint32_t save;
+
+	save = interrupt_lock();
+	*ret = dma_xfer_pool;
+	if (*ret)
+	{
+		dma_xfer_pool = (*ret)->next;
+	}
+	interrupt_unlock(save);
 
-	*ret = balloc(sizeof(struct soc_dma_xfer_item), &err);
+	if (*ret == NULL)
+	{
+		*ret = balloc(sizeof(struct soc_dma_xfer_item), &err);
+	}
 
 	if (*ret == NULL) 
 	{
@@ -740,17 +790,14 @@ DRIVER_API_RC soc_dma_free_list(struct soc_dma_cfg *cfg)
 
 	while (p) 
 	{
-		if (p->next == lp) 
-		{
-			bfree(p);
-			p = NULL;
-		} 
-		else 
-		{
-			np = p->next;
-			bfree(p);
-			p = np;
-		}
+		uint32_t save;
+
+		np = (p->next == lp) ? NULL : p->next;
+		save = interrupt_lock();
+		p->next = dma_xfer_pool;
+		dma_xfer_pool = p;
+		interrupt_unlock(save);
+		p = np;
 	}
 
 	cfg->xfer.next = NULL;
@@ -763,6 +810,12 @@ DRIVER_API_RC soc_dma_init()
 {
 	struct soc_dma_channel ch;
 
+	// Already up: don't disable channels another driver is using
+	if (dma_initialized)
+	{
+		return DRV_RC_OK;
+	}
+
 	dma_info->active = 0;
 
 	// Enable global clock
@@ -788,6 +841,8 @@ DRIVER_API_RC soc_dma_init()
 		dma_info->channel[i] = NULL;
 	}
 
+	dma_initialized = 1;
+
 	return DRV_RC_OK;
 }
 
@@ -33,6 +33,7 @@
 
 #include "data_type.h"
 #include "os/os.h"
+#include "scss_registers.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -206,6 +207,35 @@ DRIVER_API_RC soc_dma_start_transfer(struct soc_dma_channel *channel);
  */
 DRIVER_API_RC soc_dma_stop_transfer(struct soc_dma_channel *channel);
 
+/**
+ *  Function to read the address the channel will write next, e.g. to track
+ *  how far a circular peripheral-to-memory transfer has progressed. Inline,
+ *  as a register read, so it doesn't depend on the system library version
+ *
+ *  @param   channel         : pointer to channel object
+ *
+ *  @return  current destination address of the channel
+ */
+static inline uint32_t soc_dma_get_dest_addr(struct soc_dma_channel *channel)
+{
+	/* DAR0 is at 0x008 and each channel's registers take 0x058 */
+	return MMIO_REG_VAL_FROM_BASE(SOC_DMA_BASE, 0x008 + channel->id * 0x058);
+}
+
+/**
+ *  Function to read the address the channel will read next, the source side
+ *  of soc_dma_get_dest_addr()
+ *
+ *  @param   channel         : pointer to channel object
+ *
+ *  @return  current source address of the channel
+ */
+static inline uint32_t soc_dma_get_src_addr(struct soc_dma_channel *channel)
+{
+	/* SAR0 is at 0x000 */
+	return MMIO_REG_VAL_FROM_BASE(SOC_DMA_BASE, channel->id * 0x058);
+}
+
 /**
  *  Function to create a new node for a DMA xfer list. If base is provided, the allocated item will
  *  inherit all the fields from base and the new item will be linked as the item after base
@@ -49,6 +49,12 @@
      IC_INTR_TX_EMPTY | IC_INTR_TX_ABRT | IC_INTR_STOP_DET)
 #define SOC_ENABLE_TX_INT_I2C                                                  \
     (IC_INTR_TX_OVER | IC_INTR_TX_EMPTY | IC_INTR_TX_ABRT | IC_INTR_STOP_DET)
+/* While DMA feeds the FIFOs only errors interrupt; the tail is then run by
+ * the ISR without the RX_FULL interrupt, RX staying with DMA */
+#define SOC_DMA_INT_I2C                                                        \
+    (IC_INTR_RX_UNDER | IC_INTR_RX_OVER | IC_INTR_TX_OVER | IC_INTR_TX_ABRT)
+#define SOC_DMA_TAIL_INT_I2C                                                   \
+    (SOC_DMA_INT_I2C | IC_INTR_TX_EMPTY | IC_INTR_STOP_DET)
 #define SOC_ENABLE_INT_I2C_SLAVE                                               \
 	(IC_INTR_TX_OVER | IC_INTR_TX_ABRT | IC_INTR_RD_REQ | IC_INTR_RX_DONE |    \
     IC_INTR_RX_FULL | IC_INTR_RX_OVER | IC_INTR_RX_UNDER | IC_INTR_STOP_DET)
@@ -157,6 +163,19 @@
 #define IC_SLAVE_ADDR_MODE_BIT          (1 << 3)
 #define IC_ACTIVITY                     (1 << 0)
 #define IC_TAR_10BITADDR_MASTER         (1 << 12)
+#define IC_DMA_RDMAE                    (1 << 0)
+#define IC_DMA_TDMAE                    (1 << 1)
+
+/* Master transfers of more than SOC_I2C_DMA_MIN_LEN bytes use DMA once
+ * enabled; one DMA block moves at most SOC_I2C_DMA_MAX_LEN */
+#define SOC_I2C_DMA_MIN_LEN             16
+#define SOC_I2C_DMA_MAX_LEN             4095
+/* FIFO level at which the TX channel refills */
+#define SOC_I2C_DMA_TX_LEVEL            8
+
+/* ARC DCCM, which the DMA controller can't reach */
+#define SOC_I2C_DCCM_START              0x80000000
+#define SOC_I2C_DCCM_SIZE               8192
 
 /* Out of convention */
 #define IC_SPEED_POS                    2
@@ -394,6 +394,49 @@ DRIVER_API_RC ss_i2c_transfer(I2C_CONTROLLER controller_id, uint8_t *data_write,
     return DRV_RC_OK;
 }
 
+DRIVER_API_RC ss_i2c_set_clock(I2C_CONTROLLER controller_id, uint32_t scl_hz)
+{
+    i2c_info_pt dev;
+    uint32_t    i2c_con, hcnt, lcnt, spk_len, speed;
+    uint32_t saved;
+
+    if ((is_valid_controller(controller_id) != DRV_RC_OK) || (scl_hz == 0))
+    {
+        return DRV_RC_FAIL;
+    }
+    dev = &i2c_master_devs[SS_CTRL_ID(controller_id)];
+
+    spk_len = (scl_hz > 400000) ? I2C_FMP_SPKLEN : I2C_SPKLEN;
+    speed = (scl_hz > 100000) ? FAST_SPEED : STANDARD_SPEED;
+    i2c_scl_counts(scl_hz, spk_len, &hcnt, &lcnt);
+
+    saved = interrupt_lock();
+    if ((dev->state != I2C_STATE_READY) || (REG_READ(I2C_STATUS) & I2C_STATUS_ACTIVITY))
+    {
+        interrupt_unlock(saved);
+        return DRV_RC_CONTROLLER_IN_USE;
+    }
+
+    /* the timing registers only take writes with the master disabled */
+    i2c_con = REG_READ(I2C_CON);
+    REG_WRITE(I2C_CON, i2c_con & ~(I2C_ENABLE_MASTER));
+    if (speed == FAST_SPEED)
+    {
+        REG_WRITE(I2C_FS_SCL_CNT, (hcnt << 16) | lcnt);
+    }
+    else
+    {
+        REG_WRITE(I2C_SS_SCL_CNT, (hcnt << 16) | lcnt);
+    }
+    i2c_con &= ~((0xff << 22) | (0x3 << 3));
+    i2c_con |= (spk_len << 22) | (speed << 3);
+    REG_WRITE(I2C_CON, i2c_con);
+    drv_config[SS_CTRL_ID(controller_id)].public.speed = speed;
+    interrupt_unlock(saved);
+
+    return DRV_RC_OK;
+}
+
 DRIVER_I2C_STATUS_CODE ss_i2c_status(I2C_CONTROLLER controller_id, bool no_stop)
 {
     i2c_info_pt dev = &i2c_master_devs[SS_CTRL_ID(controller_id)];
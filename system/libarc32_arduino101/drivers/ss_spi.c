@@ -43,6 +43,9 @@
 #include "soc_gpio.h"
 #include "spi_priv.h"
 #include "clk_system.h"
+#include "io_config.h"
+#include "scss_registers.h"
+#include "aux_regs.h"
 
 #include "ss_spi.h"
 
@@ -54,9 +57,30 @@
 #define FREQ_SPI_CLOCK_IN                                                      \
     (CLOCK_SPEED * 1000 * 1000) /* CONFIG_CLOCK_SPEED in MHz */
 
+static void ss_spi_async_proc(spi_info_pt dev);
+
+static spi_info_t ss_spi_master_devs[SPI_MAX_CNT];
+
+DECLARE_INTERRUPT_HANDLER static void ss_spi0_ISR()
+{
+    ss_spi_async_proc(&ss_spi_master_devs[0]);
+}
+
+DECLARE_INTERRUPT_HANDLER static void ss_spi1_ISR()
+{
+    ss_spi_async_proc(&ss_spi_master_devs[1]);
+}
+
 static spi_info_t ss_spi_master_devs[SPI_MAX_CNT] = {
     {.instID = 0,
      .reg_base = AR_IO_SPI_MST0_CTRL,
+     .fifo_depth = IO_SPI_MST0_FS,
+     .rx_vector = IO_SPI_MST0_INT_RX_AVAIL,
+     .tx_vector = IO_SPI_MST0_INT_TX_REQ,
+     .rx_isr = ss_spi0_ISR,
+     .tx_isr = ss_spi0_ISR,
+     .spi_rx_avail_mask = SCSS_REGISTER_BASE + INT_SS_SPI_0_RX_AVAIL_MASK,
+     .spi_tx_req_mask = SCSS_REGISTER_BASE + INT_SS_SPI_0_TX_REQ_MASK,
      .creg_spi_clk_ctrl = CREG_CLK_CTRL_SPI0,
      .clk_gate_info =
          &(struct clk_gate_info_s){
@@ -65,6 +89,13 @@ static spi_info_t ss_spi_master_devs[SPI_MAX_CNT] = {
          }},
     {.instID = 1,
      .reg_base = AR_IO_SPI_MST1_CTRL,
+     .fifo_depth = IO_SPI_MST1_FS,
+     .rx_vector = IO_SPI_MST1_INT_RX_AVAIL,
+     .tx_vector = IO_SPI_MST1_INT_TX_REQ,
+     .rx_isr = ss_spi1_ISR,
+     .tx_isr = ss_spi1_ISR,
+     .spi_rx_avail_mask = SCSS_REGISTER_BASE + INT_SS_SPI_1_RX_AVAIL_MASK,
+     .spi_tx_req_mask = SCSS_REGISTER_BASE + INT_SS_SPI_1_TX_REQ_MASK,
      .creg_spi_clk_ctrl = CREG_CLK_CTRL_SPI1,
      .clk_gate_info =
          &(struct clk_gate_info_s){
@@ -165,6 +196,13 @@ void ss_spi_init(SPI_CONTROLLER controller_id, uint32_t speed,
 
     /* Disable interrupts */
     WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+
+    /* Interrupts are only unmasked in the controller by ss_spi_xfer_async() */
+    dev->state = SPI_STATE_READY;
+    SET_INTERRUPT_HANDLER(dev->rx_vector, dev->rx_isr);
+    SET_INTERRUPT_HANDLER(dev->tx_vector, dev->tx_isr);
+    MMIO_REG_VAL(dev->spi_rx_avail_mask) &= ENABLE_SSS_INTERRUPTS;
+    MMIO_REG_VAL(dev->spi_tx_req_mask) &= ENABLE_SSS_INTERRUPTS;
 }
 
 void ss_spi_disable(SPI_CONTROLLER controller_id)
@@ -202,13 +240,11 @@ static inline void spi_receive(spi_info_pt dev, uint8_t *buf, size_t count)
     }
 }
 
-/* Polling-based SPI transfer to allow use within an ISR */
-int ss_spi_xfer(SPI_CONTROLLER controller_id, uint8_t *buf, unsigned tx_cnt,
-                unsigned rx_cnt)
+/* Selects the transfer mode and count, then asserts the slave-select */
+static void spi_start(spi_info_pt dev, unsigned tx_cnt, unsigned rx_cnt)
 {
     uint32_t spien = 0;
     uint32_t ctrl = 0;
-    spi_info_pt dev = &ss_spi_master_devs[controller_id];
 
     spien = READ_ARC_REG(dev->reg_base + SPIEN);
     spien &= SPI_ENB_SET_MASK;
@@ -230,6 +266,21 @@ int ss_spi_xfer(SPI_CONTROLLER controller_id, uint8_t *buf, unsigned tx_cnt,
 
     // Assert the slave-select and start the SPI transfer
     WRITE_ARC_REG(spien | SPI_ENABLE, dev->reg_base + SPIEN);
+}
+
+/* Polling-based SPI transfer to allow use within an ISR */
+int ss_spi_xfer(SPI_CONTROLLER controller_id, uint8_t *buf, unsigned tx_cnt,
+                unsigned rx_cnt)
+{
+    spi_info_pt dev = &ss_spi_master_devs[controller_id];
+
+    /* An ISR can't wait for an ss_spi_xfer_async() to complete */
+    if (dev->state == SPI_STATE_TRANSMIT && _lr(ARC_V2_AUX_IRQ_ACT))
+        return -1;
+    while (dev->state == SPI_STATE_TRANSMIT)
+        ;
+
+    spi_start(dev, tx_cnt, rx_cnt);
 
     if (tx_cnt)
         spi_transmit(dev, buf, tx_cnt,
@@ -246,3 +297,96 @@ int ss_spi_xfer(SPI_CONTROLLER controller_id, uint8_t *buf, unsigned tx_cnt,
 
     return 0;
 }
+
+static void spi_async_done(spi_info_pt dev)
+{
+    WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+    // De-assert the slave-select and end the SPI transfer
+    WRITE_ARC_REG(0, dev->reg_base + SPIEN);
+    dev->state = SPI_STATE_READY;
+    if (dev->xfer_cb)
+        dev->xfer_cb(dev->cb_xfer_data);
+}
+
+/* Both the RX-available and TX-request interrupts come here */
+static void ss_spi_async_proc(spi_info_pt dev)
+{
+    uint32_t left;
+
+    while (dev->rx_count < dev->rx_len &&
+           READ_ARC_REG(dev->reg_base + RXFLR) > 0) {
+        WRITE_ARC_REG(SPI_POP_DATA, dev->reg_base + DR);
+        dev->rx_buf[dev->rx_count++] = READ_ARC_REG(dev->reg_base + DR);
+    }
+    while (dev->tx_count < dev->tx_len &&
+           (READ_ARC_REG(dev->reg_base + SR) & SPI_STATUS_TFNF))
+        WRITE_ARC_REG(SPI_PUSH_DATA | dev->tx_buf[dev->tx_count++],
+                      dev->reg_base + DR);
+
+    if (dev->rx_len) {
+        if (dev->rx_count == dev->rx_len) {
+            spi_async_done(dev);
+            return;
+        }
+        /* Ask for the rest, up to a FIFO's worth at a time */
+        left = dev->rx_len - dev->rx_count;
+        if (left > dev->fifo_depth)
+            left = dev->fifo_depth;
+        WRITE_ARC_REG(((left - 1) << 16) | 0, dev->reg_base + FTLR);
+        if (dev->tx_count == dev->tx_len)
+            WRITE_ARC_REG(SPI_ENABLE_RX_INT, dev->reg_base + INTR_MASK);
+    } else if (dev->tx_count == dev->tx_len &&
+               (READ_ARC_REG(dev->reg_base + SR) & SPI_STATUS_TFE)) {
+        /* Only the last frame is still being shifted out */
+        while (READ_ARC_REG(dev->reg_base + SR) & SPI_STATUS_BUSY)
+            ;
+        spi_async_done(dev);
+    }
+}
+
+int ss_spi_xfer_async(SPI_CONTROLLER controller_id, uint8_t *buf,
+                      unsigned tx_cnt, unsigned rx_cnt,
+                      void (*callback)(uint32_t), uint32_t cb_data)
+{
+    uint32_t saved;
+    spi_info_pt dev = &ss_spi_master_devs[controller_id];
+
+    saved = interrupt_lock();
+    if (dev->state == SPI_STATE_TRANSMIT) {
+        interrupt_unlock(saved);
+        return -1;
+    }
+    dev->state = SPI_STATE_TRANSMIT;
+    interrupt_unlock(saved);
+
+    dev->tx_buf = buf;
+    dev->tx_len = tx_cnt;
+    dev->tx_count = 0;
+    dev->rx_buf = buf;
+    dev->rx_len = rx_cnt;
+    dev->rx_count = 0;
+    dev->xfer_cb = callback;
+    dev->cb_xfer_data = cb_data;
+
+    spi_start(dev, tx_cnt, rx_cnt);
+    if (!tx_cnt)
+        WRITE_ARC_REG(SPI_PUSH_DATA | 0x56,
+                      dev->reg_base + DR); // start rx-only transfert
+
+    /* Fill the TX FIFO from here; the ISR takes over for the rest */
+    saved = interrupt_lock();
+    ss_spi_async_proc(dev);
+    if (dev->state == SPI_STATE_TRANSMIT && dev->tx_count < dev->tx_len)
+        WRITE_ARC_REG(SPI_ENABLE_TX_INT | SPI_ENABLE_RX_INT,
+                      dev->reg_base + INTR_MASK);
+    else if (dev->state == SPI_STATE_TRANSMIT && !dev->rx_len)
+        WRITE_ARC_REG(SPI_ENABLE_TX_INT, dev->reg_base + INTR_MASK);
+    interrupt_unlock(saved);
+
+    return 0;
+}
+
+int ss_spi_busy(SPI_CONTROLLER controller_id)
+{
+    return ss_spi_master_devs[controller_id].state == SPI_STATE_TRANSMIT;
+}
@@ -40,6 +40,16 @@ void ss_spi_init(SPI_CONTROLLER controller_id, uint32_t speed,
 void ss_spi_disable(SPI_CONTROLLER controller_id);
 int ss_spi_xfer(SPI_CONTROLLER controller_id, uint8_t *buf, unsigned tx_cnt,
                 unsigned rx_cnt);
+
+/* Interrupt-driven ss_spi_xfer(): returns at once, then callback(cb_data)
+ * runs from the SPI interrupt once rx_cnt bytes have been read back into
+ * buf. Returns -1, without starting, while another transfer is running on
+ * the controller. Use ss_spi_xfer() from an ISR. */
+int ss_spi_xfer_async(SPI_CONTROLLER controller_id, uint8_t *buf,
+                      unsigned tx_cnt, unsigned rx_cnt,
+                      void (*callback)(uint32_t), uint32_t cb_data);
+/* Non-zero while an ss_spi_xfer_async() is running */
+int ss_spi_busy(SPI_CONTROLLER controller_id);
 void ss_spi_set_data_mode(SPI_CONTROLLER controller_id, uint8_t dataMode);
 void ss_spi_set_clock_divider(SPI_CONTROLLER controller_id, uint8_t clockDiv);
 
@@ -84,6 +84,7 @@ int uart_irq_tx_ready(int port);
 void uart_irq_rx_enable(int port);
 void uart_irq_rx_disable(int port);
 int uart_irq_rx_ready(int port);
+int uart_irq_rx_timeout(int port);
 void uart_irq_err_enable(int port);
 void uart_irq_err_disable(int port);
 int uart_irq_err_detected(int port);
@@ -175,6 +175,9 @@ int cfw_unregister_service(service_t * service);
 /**
  * Send an indication message to the registered clients.
  *
+ * Clients on this CPU are all handed msg itself, each freeing it as usual;
+ * those on other CPUs get a copy. The caller still frees msg afterwards.
+ *
  * \param msg the indication message to send.
  */
 void cfw_send_event(struct cfw_message * msg);
@@ -58,17 +58,59 @@ void ipc_init(int tx_channel, int rx_channel, int tx_ack_channel,
 /**
  * Request a synchronous ipc call.
  *
- * This method blocks until the command is answered.
+ * This method blocks until the command is answered, or for up to 1 s.
  *
  * @param request_id the synchronous request id
  * @param param1 the first param for the request
  * @param param2 the second param for the request
  * @param ptr the third param for the request
  *
- * @return the synchronous command response.
+ * @return the synchronous command response, E_OS_ERR_TIMEOUT if it didn't
+ *         come or E_OS_ERR_BUSY if the channel stayed busy.
  */
 int ipc_request_sync_int(int request_id, int param1, int param2, void *ptr);
 
+/**
+ * Callback receiving the response to ipc_request_async_int().
+ *
+ * @param ret the command response, or E_OS_ERR_TIMEOUT if a synchronous
+ *            request gave up waiting for it
+ * @param priv the priv passed to ipc_request_async_int()
+ */
+typedef void (*ipc_ack_cb_t)(int ret, void *priv);
+
+/**
+ * Request an ipc call without waiting for its response.
+ *
+ * The request is posted only if none is in flight. cb is then called with
+ * the response, from the mailbox interrupt. Needs ipc_enable_ack_int().
+ *
+ * @param request_id the synchronous request id
+ * @param param1 the first param for the request
+ * @param param2 the second param for the request
+ * @param ptr the third param for the request
+ * @param cb the response callback, may be NULL
+ * @param priv passed to cb
+ *
+ * @return E_OS_OK if posted, E_OS_ERR_BUSY if a request is in flight.
+ */
+int ipc_request_async_int(int request_id, int param1, int param2, void *ptr,
+        ipc_ack_cb_t cb, void *priv);
+
+/**
+ * Route the rx acknowledge mailbox interrupt to this CPU.
+ *
+ * The mailbox interrupt handler must then call ipc_handle_ack(), and
+ * ipc_request_sync_int() sleeps instead of spinning while it waits.
+ */
+void ipc_enable_ack_int(void);
+
+/**
+ * Called from the mailbox interrupt to collect the response of the request
+ * in flight.
+ */
+void ipc_handle_ack(void);
+
 /**
  * Polling mode polling call.
  *
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __IPC_RING_H__
+#define __IPC_RING_H__
+
+#include <stdint.h>
+
+/**
+ * @defgroup ipc_ring IPC shared memory rings
+ * Bulk byte streams between ARC and LMT through shared RAM
+ * @ingroup ipc
+ * @{
+ *
+ * One ring per direction, published by LMT in the shared block. Mailbox
+ * channels are only used as doorbells, rung when a write finds the ring
+ * empty, so the reader drains it until it's empty again and nothing is
+ * exchanged per message.
+ */
+
+/**
+ * Initialize the rings' doorbells.
+ *
+ * @param tx_doorbell the mailbox rung when data is written for LMT.
+ * @param rx_doorbell the mailbox LMT rings, whose interrupt is routed here.
+ */
+void ipc_ring_init(int tx_doorbell, int rx_doorbell);
+
+/**
+ * Whether LMT has set up the rings.
+ *
+ * @return 1 if the rings can be used, 0 otherwise
+ */
+int ipc_ring_ready(void);
+
+/**
+ * Copy data into the ring to LMT, as much as fits.
+ *
+ * @param buf the data to send
+ * @param len the number of bytes to send
+ *
+ * @return the number of bytes written, 0 if full or not ready
+ */
+int ipc_ring_write(const void *buf, int len);
+
+/**
+ * Copy data out of the ring from LMT.
+ *
+ * @param buf receives the data
+ * @param len the room in buf
+ *
+ * @return the number of bytes read, 0 if empty or not ready
+ */
+int ipc_ring_read(void *buf, int len);
+
+/**
+ * @return the number of bytes waiting in the ring from LMT
+ */
+int ipc_ring_available(void);
+
+/**
+ * @return the room left in the ring to LMT
+ */
+int ipc_ring_space(void);
+
+/**
+ * Set the function called, from the mailbox interrupt, when LMT rings the
+ * doorbell. It should read until ipc_ring_available() is 0, or another
+ * doorbell isn't guaranteed.
+ *
+ * @param cb the callback, NULL to poll
+ * @param priv passed to cb
+ */
+void ipc_ring_set_callback(void (*cb)(void *priv), void *priv);
+
+/**
+ * Called from the mailbox interrupt to handle the rx doorbell.
+ */
+void ipc_ring_handle_doorbell(void);
+
+/** @} */
+#endif
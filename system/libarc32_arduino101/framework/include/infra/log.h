@@ -197,6 +197,13 @@ int8_t log_get_module_level(uint8_t module);
  */
 void log_flush();
 
+/**
+ * On deferred implementations, format and output the messages queued since
+ * the last call. Call it from the main loop or an idle hook, out of the way
+ * of time-critical code; it does nothing while the log is suspended.
+ */
+void log_process();
+
 /**
  * Suspend logger task.
  * This is used when we don't want logging to interrupt any lower priority
@@ -209,13 +216,50 @@ void log_suspend();
  */
 void log_resume();
 
+/**
+ * Highest log level compiled in, e.g. -DCONFIG_LOG_LEVEL_MAX=LOG_LEVEL_WARNING
+ * for a production build. Calls above it become constant 0, so their
+ * arguments aren't evaluated and their format strings aren't linked in.
+ * log_set_global_level() and the module levels still filter at run time
+ * below it.
+ */
+#ifndef CONFIG_LOG_LEVEL_MAX
+#define CONFIG_LOG_LEVEL_MAX LOG_LEVEL_DEBUG
+#endif
+
+/**
+ * Modules, one bit per log module ID, whose pr_info() and pr_debug() calls
+ * are compiled in; the others keep only errors and warnings. E.g.
+ * -DCONFIG_LOG_VERBOSE_MODULES="(~((1UL << LOG_MODULE_BLE) | (1UL << LOG_MODULE_IPC)))"
+ * takes the BLE and IPC hot paths down to no code.
+ */
+#ifndef CONFIG_LOG_VERBOSE_MODULES
+#define CONFIG_LOG_VERBOSE_MODULES (~0UL)
+#endif
+
+/**
+ * Non-zero if messages of this level and module are compiled in; a constant
+ * when both are, as in the pr_xxx() calls.
+ */
+#define LOG_COMPILED(level, module) ((level) <= CONFIG_LOG_LEVEL_MAX && \
+	((level) <= LOG_LEVEL_WARNING || \
+	 ((unsigned long)(CONFIG_LOG_VERBOSE_MODULES) >> ((module) & 31)) & 1))
+
+/* log_printk() if compiled in, else 0 without evaluating the arguments */
+#define LOG_CALL(level, module, format,...) ({ \
+	int8_t __log_ret = 0; \
+	if (LOG_COMPILED(level, module)) \
+		__log_ret = log_printk(level, module, format, ##__VA_ARGS__); \
+	__log_ret; \
+})
+
 /**
  * Log an error message.
  *
  * @param module the ID of the module related to this message
  * @param format the printf-like string format
  */
-#define pr_error(module, format,...) log_printk(LOG_LEVEL_ERROR, module, format, ##__VA_ARGS__)
+#define pr_error(module, format,...) LOG_CALL(LOG_LEVEL_ERROR, module, format, ##__VA_ARGS__)
 
 /**
  * Log a warning message.
@@ -223,7 +267,7 @@ void log_resume();
  * @param module the ID of the log module related to this message
  * @param format the printf-like string format
  */
-#define pr_warning(module, format,...) log_printk(LOG_LEVEL_WARNING, module, format, ##__VA_ARGS__)
+#define pr_warning(module, format,...) LOG_CALL(LOG_LEVEL_WARNING, module, format, ##__VA_ARGS__)
 
 /**
  * Log an info message.
@@ -231,7 +275,7 @@ void log_resume();
  * @param module the ID of the log module related to this message
  * @param format the printf-like string format
  */
-#define pr_info(module, format,...) log_printk(LOG_LEVEL_INFO, module, format, ##__VA_ARGS__)
+#define pr_info(module, format,...) LOG_CALL(LOG_LEVEL_INFO, module, format, ##__VA_ARGS__)
 
 /* The following function is defined for each log module. After preprocessing:
  * 1) The content of the "if" is constant, so compiler can optimize and remove
@@ -243,7 +287,8 @@ void log_resume();
  */
 #define DEFINE_LOGGER_MODULE(_id,_name,...) inline static int8_t pr_debug_ ## _id(const char *format,...) { \
 	int8_t ret = 0; \
-	if( (sizeof(#__VA_ARGS__) == sizeof("")) || 0x0##__VA_ARGS__) {\
+	if( LOG_COMPILED(LOG_LEVEL_DEBUG, _id) && \
+	    ((sizeof(#__VA_ARGS__) == sizeof("")) || 0x0##__VA_ARGS__)) {\
 		va_list args;\
 		va_start(args, format);\
 		ret = log_vprintk(LOG_LEVEL_DEBUG, _id, format, args);\
@@ -257,14 +302,13 @@ void log_resume();
 /**
  * Log a debug message.
  *
- * Note that this call will have an effect only if debug log level is activated
- * for this module at compilation time. This is done by setting the 3rd
- * parameter of the DEFINE_LOGGER_MODULE X_MACRO to 1.
+ * The call is compiled out when CONFIG_LOG_LEVEL_MAX is below
+ * LOG_LEVEL_DEBUG or the module is left out of CONFIG_LOG_VERBOSE_MODULES.
  *
  * @param module the ID of the log module related to this message
  * @param format the printf-like string format
  */
-#define pr_debug(module, format,...) log_printk(LOG_LEVEL_DEBUG, module, format, ##__VA_ARGS__)
+#define pr_debug(module, format,...) LOG_CALL(LOG_LEVEL_DEBUG, module, format, ##__VA_ARGS__)
 
 #ifdef __cplusplus
 }
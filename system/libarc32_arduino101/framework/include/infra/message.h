@@ -131,6 +131,22 @@ struct message * message_alloc(int size, OS_ERR_TYPE * err);
  */
 void message_free(struct message *message);
 
+/**
+ * Share an allocated message between several owners.
+ *
+ * The message is only released by the last of refs calls to message_free(),
+ * so one buffer can be handed to several local handlers in turn instead of
+ * a copy each. The header is common to all owners: only share a message
+ * whose handlers are done with its destination once they return.
+ *
+ * \param message the message allocated with message_alloc()
+ * \param refs number of message_free() calls that will be made on it
+ *
+ * \return 0 on success, -1 if too many messages are already shared, in
+ *         which case the message keeps a single owner
+ */
+int message_share(struct message *message, uint16_t refs);
+
 /** @} */
 /** @} */
 #endif /* __INFRA_MESSAGE_H_ */
@@ -157,6 +157,18 @@ uint16_t queue_process_message(T_QUEUE queue);
  */
 uint16_t queue_process_message_wait(T_QUEUE queue, uint32_t timeout, OS_ERR_TYPE* err);
 
+/**
+ * Process all the messages pending in a queue.
+ *
+ * Calls the port handlers for every message in the queue, including those
+ * queued by the handlers themselves, until it is empty.
+ *
+ * @param queue The queue to drain
+ *
+ * @return the number of messages processed
+ */
+uint32_t queue_process_all(T_QUEUE queue);
+
 /**
  * Process the next message in a queue.
  *
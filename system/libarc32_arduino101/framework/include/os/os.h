@@ -69,7 +69,8 @@ void queue_delete(T_QUEUE queue, OS_ERR_TYPE* err);
  *     Authorized execution levels:  task, fiber.
  *
  *     As for semaphores and mutexes, queues are picked from a pool of
- *     statically-allocated objects.
+ *     statically-allocated objects. Their rings of message pointers share
+ *     CONFIG_OS_QUEUE_SLOTS statically-allocated slots.
  *
  * \param maxSize: maximum number of  messages in the queue.
  *     (Rationale: queues only contain pointer to messages)
@@ -77,6 +78,7 @@ void queue_delete(T_QUEUE queue, OS_ERR_TYPE* err);
  * \param err (out): execution status:
  *          -# E_OS_OK : queue was created
  *          -# E_OS_ERR: all queues from the pool are already being used
+ *          -# E_OS_ERR_NO_MEMORY: fewer than maxSize free slots are left
  *          -# E_OS_ERR_NOT_ALLOWED: service cannot be executed from ISR context.
  *
  * \return Handler on the created queue.
@@ -194,6 +196,51 @@ extern void* balloc (uint32_t size, OS_ERR_TYPE* err);
  */
 extern OS_ERR_TYPE bfree(void* buffer);
 
+/* The pool statistics are only in a system library built with
+ * CONFIG_BALLOC_POOL_STATS; the prebuilt libarc32drv_arduino101.a predates
+ * them, so sketches don't see them until the platform defines it too. */
+#ifdef CONFIG_BALLOC_POOL_STATS
+/**
+ * \brief Usage of one balloc() memory pool
+ */
+typedef struct {
+    uint16_t size;    /** size of each block */
+    uint16_t count;   /** number of blocks */
+    uint16_t used;    /** blocks currently allocated */
+    uint16_t max;     /** most blocks allocated at the same time */
+    uint32_t allocs;  /** allocations that fit no smaller pool */
+    uint32_t bytes;   /** bytes requested by those allocations */
+} T_POOL_STATS;
+
+/**
+ * \brief Number of balloc() memory pools, smallest block size first
+ */
+extern uint8_t balloc_pool_count(void);
+
+/**
+ * \brief Reports the usage of a balloc() memory pool
+ *
+ * Authorized execution levels:  task, fiber, ISR
+ *
+ * Only used is tracked in every build; max, allocs and bytes need
+ * CONFIG_MEMORY_POOLS_BALLOC_STATISTICS and are 0 otherwise.
+ *
+ * \param pool index of the pool, below balloc_pool_count()
+ *
+ * \param stats receives the usage of the pool
+ *
+ * \return execution status:
+ *    E_OS_OK : stats was filled in
+ *    E_OS_ERR : no such pool
+ */
+extern OS_ERR_TYPE balloc_pool_stats(uint8_t pool, T_POOL_STATS* stats);
+
+/**
+ * \brief Restarts the pool high-water marks and counters from the current usage
+ */
+extern void balloc_reset_stats(void);
+#endif
+
 /* MUTEX STUB FUNCTIONS */
 extern T_MUTEX mutex_create(OS_ERR_TYPE* err);
 extern void mutex_delete(T_MUTEX mutex, OS_ERR_TYPE* err );
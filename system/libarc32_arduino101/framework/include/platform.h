@@ -63,6 +63,25 @@ struct cdc_acm_shared_data {
     int device_open;
 };
 
+/** Value LMT writes to cdc_acm_flow_control.magic when it reports drain credits */
+#define CDCACM_FLOW_MAGIC 0x43444346
+
+/**
+ * CDC-ACM tx flow control.
+ *
+ * Both counters are free-running byte counts, so ARC can tell how much of
+ * what it queued in the tx ring has actually been accepted by the USB host.
+ * They are initialised by LMT only and survive ARC resets.
+ */
+struct cdc_acm_flow_control {
+    /** Set to CDCACM_FLOW_MAGIC by LMT once it maintains tx_credits */
+    uint32_t magic;
+    /** Bytes delivered to the USB host, incremented by LMT */
+    uint32_t tx_credits;
+    /** Bytes queued in the tx ring, incremented by ARC */
+    uint32_t tx_queued;
+};
+
 struct shared_ring_buffer
 {
     /** Ring buffer data */
@@ -80,6 +99,28 @@ struct shared_ring_buffer
     volatile int flag;
 };
 
+/** Value QRK writes to ipc_ring_magic once the ipc_ring pointers are valid */
+#define IPC_RING_MAGIC 0x49504352
+
+/**
+ * Single producer, single consumer byte ring between the cores.
+ *
+ * head and tail are free-running byte counts, each written by one side
+ * only, so neither core needs a lock to use the ring. Allocated and
+ * initialised by QRK.
+ */
+struct ipc_ring
+{
+    /** Size of data, a power of two */
+    uint32_t size;
+    /** Bytes written, incremented by the producer */
+    volatile uint32_t head;
+    /** Bytes read, incremented by the consumer */
+    volatile uint32_t tail;
+    /** Ring data */
+    volatile uint8_t data[];
+};
+
 struct ipm_shared_data
 {
     struct shared_ring_buffer *quark_buffer;
@@ -158,6 +199,18 @@ struct platform_shared_block_ {
     uint32_t pm_int_status;
     
     uint8_t error_code;
+
+    /** CDC-ACM tx flow control, appended so the layout above is unchanged
+     * for LMT firmware that does not implement it */
+    struct cdc_acm_flow_control cdc_acm_flow;
+
+    /** Set to IPC_RING_MAGIC by QRK once the rings below are in place,
+     * appended like cdc_acm_flow */
+    uint32_t ipc_ring_magic;
+    /** Ring passing data from QRK to ARC */
+    struct ipc_ring *ipc_ring_rx;
+    /** Ring passing data from ARC to QRK */
+    struct ipc_ring *ipc_ring_tx;
 };
 
 #define RAM_START           0xA8000000
@@ -32,6 +32,7 @@
 #define __BLE_SERVICE_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* For MSG_ID_BLE_SERVICE_BASE */
 #include "services/services_ids.h"
@@ -232,6 +233,18 @@ int ble_service_enable(cfw_service_conn_t * p_service_conn, uint8_t enable,
 			const struct ble_enable_config * p_config,
 			void *p_priv);
 
+/** Carry on the BLE core bring-up started at boot.
+ *
+ * Releases the BLE core from reset when due. To be called until it returns
+ * true, e.g. from the main loop, before the BLE service can be used.
+ *
+ * @return true once the BLE service is registered
+ */
+bool ble_cfw_service_poll(void);
+
+/** Wait for the BLE service to be registered, calling ble_cfw_service_poll(). */
+void ble_cfw_service_wait(void);
+
 /** @endcond */
 /** @}*/
 #endif
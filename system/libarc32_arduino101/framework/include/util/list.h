@@ -131,5 +131,109 @@ int list_empty(list_head_t *lh);
 list_t * list_find_first(list_head_t * lh, bool(*cb)(list_t*,void*), void *data);
 
 
+/**
+ * Doubly linked list element, for lists elements leave from the middle of.
+ */
+typedef struct dlist {
+	struct dlist * next;
+	struct dlist * prev;
+} dlist_t;
+
+/**
+ * Doubly linked list head. The list is circular through the head, so no
+ * operation needs to walk it or test for its ends.
+ */
+typedef struct dlist_head_ {
+	dlist_t node;
+} dlist_head_t;
+
+/**
+ * The dlist functions take no lock: the caller serializes accesses, with
+ * interrupt_lock() if the list is used from interrupt context.
+ */
+
+/**
+ * Initialize a doubly linked list.
+ *
+ * @param list the list to initialize
+ */
+void dlist_init(dlist_head_t * list);
+
+/**
+ * Append an element to the end of list.
+ *
+ * @param list the list to which element has to be added
+ * @param element the element we want to add to the list.
+ */
+void dlist_add(dlist_head_t * list, dlist_t * element);
+
+/**
+ * Add an element to the begining of list.
+ *
+ * @param list the list to which element has to be added
+ * @param element the element we want to add to the list.
+ */
+void dlist_add_head(dlist_head_t * list, dlist_t * element);
+
+/**
+ * Remove an element from the list it is in, in constant time.
+ *
+ * @param element the element to remove. Must be in a list.
+ */
+void dlist_remove(dlist_t * element);
+
+/**
+ * Get the first element from the list.
+ *
+ * @param list the list from which the element has to be retrieved.
+ * @return the element removed, or NULL if the list is empty.
+ */
+dlist_t * dlist_get(dlist_head_t * list);
+
+/**
+ * Check if the list is empty.
+ *
+ * @return 0 if not empty
+ */
+int dlist_empty(dlist_head_t * list);
+
+/**
+ * Multiple producer, single consumer queue of list_t elements.
+ *
+ * Any context may push, including nested interrupts, without masking
+ * interrupts: a push is a single atomic exchange. Only one context may
+ * get. Elements come out in push order.
+ */
+typedef struct mpsc_queue_ {
+	list_t * volatile head;     /* last pushed */
+	list_t * tail;              /* next to get, consumer only */
+	list_t stub;
+} mpsc_queue_t;
+
+/**
+ * Initialize a queue.
+ *
+ * @param q the queue to initialize
+ */
+void mpsc_init(mpsc_queue_t * q);
+
+/**
+ * Push an element at the end of the queue, from any context.
+ *
+ * @param q the queue to which element has to be added
+ * @param element the element to add
+ */
+void mpsc_push(mpsc_queue_t * q, list_t * element);
+
+/**
+ * Get the first element of the queue. Consumer only.
+ *
+ * @param q the queue from which the element has to be retrieved.
+ * @return the element removed, or NULL if the queue is empty or the
+ *         push of its next element has not finished yet, in which case
+ *         the producer is an interrupt that preempted the caller.
+ */
+list_t * mpsc_get(mpsc_queue_t * q);
+
 /** @} */
 #endif /* __LIST_H__ */
@@ -356,10 +356,39 @@ typedef struct registered_evt_list_
     int ind; /*! Indication message id */
 } registered_evt_list_t;
 
+#ifndef CONFIG_CFW_EVT_TABLE_SIZE
+#define CONFIG_CFW_EVT_TABLE_SIZE 32 /*!< Power of two */
+#endif
+
+/**
+ * Registered indications indexed by message id, open addressed with linear
+ * probing. Indications that don't fit are kept on registered_evt_list.
+ */
+static registered_evt_list_t * registered_evt_table[CONFIG_CFW_EVT_TABLE_SIZE];
+
 list_head_t registered_evt_list;
 
+#define EVT_TABLE_SLOT(msg_id) \
+    ((((unsigned int)(msg_id) * 2654435761u) >> 16) & (CONFIG_CFW_EVT_TABLE_SIZE - 1))
+
 registered_evt_list_t * get_event_registered_list(int msg_id)
 {
+    unsigned int slot = EVT_TABLE_SLOT(msg_id);
+    int i;
+    for (i = 0; i < CONFIG_CFW_EVT_TABLE_SIZE; i++) {
+        registered_evt_list_t * l = registered_evt_table[slot];
+        if (l == NULL) {
+            break;
+        }
+        if (l->ind == msg_id) {
+            return l;
+        }
+        slot = (slot + 1) & (CONFIG_CFW_EVT_TABLE_SIZE - 1);
+    }
+    if (i < CONFIG_CFW_EVT_TABLE_SIZE && registered_evt_list.head == NULL) {
+        return NULL ;
+    }
+
     registered_evt_list_t * l =
             (registered_evt_list_t*) registered_evt_list.head;
     while (l) {
@@ -371,6 +400,20 @@ registered_evt_list_t * get_event_registered_list(int msg_id)
     return NULL ;
 }
 
+static void add_event_registered_list(registered_evt_list_t * ind)
+{
+    unsigned int slot = EVT_TABLE_SLOT(ind->ind);
+    int i;
+    for (i = 0; i < CONFIG_CFW_EVT_TABLE_SIZE; i++) {
+        if (registered_evt_table[slot] == NULL) {
+            registered_evt_table[slot] = ind;
+            return;
+        }
+        slot = (slot + 1) & (CONFIG_CFW_EVT_TABLE_SIZE - 1);
+    }
+    list_add(&registered_evt_list, &ind->list);
+}
+
 list_head_t * get_event_list(int msg_id)
 {
     registered_evt_list_t * l = get_event_registered_list(msg_id);
@@ -379,15 +422,11 @@ list_head_t * get_event_list(int msg_id)
     return NULL ;
 }
 
-static void send_event_callback(void * item, void * param)
+static bool event_client_is_inline(struct cfw_message * msg, indication_list_t * ind)
 {
-    struct cfw_message * msg = (struct cfw_message *) param;
-    indication_list_t * ind = (indication_list_t *) item;
-    struct cfw_message * m = cfw_clone_message(msg);
-    if (m != NULL ) {
-        CFW_MESSAGE_DST(m) = ind->conn_handle->client_port;
-        cfw_send_message(m);
-    }
+    /* port_send_message() runs the handler before returning */
+    return port_get_cpu_id(ind->conn_handle->client_port) == get_cpu_id()
+            && port_get_cpu_id(CFW_MESSAGE_SRC(msg)) == get_cpu_id();
 }
 
 void cfw_send_event(struct cfw_message * msg)
@@ -395,9 +434,38 @@ void cfw_send_event(struct cfw_message * msg)
 #ifdef SVC_MANAGER_DEBUG
     pr_debug(LOG_MODULE_CFW, "%s : msg:%d", __func__, CFW_MESSAGE_ID(msg));
 #endif
-    list_head_t * list = get_event_list(CFW_MESSAGE_ID(msg));
-    if (list != NULL ) {
-        list_foreach(list, send_event_callback, msg);
+    registered_evt_list_t * evt = get_event_registered_list(CFW_MESSAGE_ID(msg));
+    indication_list_t * ind;
+    int shared = 0;
+
+    if (evt == NULL ) {
+        return;
+    }
+
+    /* Local clients are handed msg itself, one after the other, holding a
+     * reference each on top of the caller's. Only remote ones get a copy. */
+    for (ind = (indication_list_t *) evt->lh.head; ind != NULL ;
+            ind = (indication_list_t *) ind->list.next) {
+        if (event_client_is_inline(msg, ind)) {
+            shared++;
+        }
+    }
+    if (shared > 0 && message_share(CFW_MESSAGE_HEADER(msg), shared + 1) != 0) {
+        shared = 0;
+    }
+
+    for (ind = (indication_list_t *) evt->lh.head; ind != NULL ;
+            ind = (indication_list_t *) ind->list.next) {
+        struct cfw_message * m;
+        if (shared > 0 && event_client_is_inline(msg, ind)) {
+            m = msg;
+        } else {
+            m = cfw_clone_message(msg);
+        }
+        if (m != NULL ) {
+            CFW_MESSAGE_DST(m) = ind->conn_handle->client_port;
+            cfw_send_message(m);
+        }
     }
 }
 
@@ -413,7 +481,7 @@ void _cfw_register_event(conn_handle_t * h, int msg_id)
         ind = (registered_evt_list_t *) balloc(sizeof(*ind), NULL );
         ind->ind = msg_id;
         list_init(&ind->lh);
-        list_add(&registered_evt_list, &ind->list);
+        add_event_registered_list(ind);
     }
 
     indication_list_t * e = (indication_list_t *) balloc(sizeof(*e), NULL );
@@ -457,6 +525,8 @@ void _cfw_loop(void * queue)
         message = (struct cfw_message *) m;
         if (message != NULL ) {
             port_process_message(&message->m);
+            /* and the rest of the burst without waiting again */
+            queue_process_all(queue);
         }
     }
 }
@@ -34,6 +34,7 @@
 #include "portable.h"
 #include "os/os_types.h"
 #include "infra/ipc.h"
+#include "infra/ipc_ring.h"
 #include "infra/log.h"
 #include "cfw/cfw.h"
 #include "cfw/cfw_service.h"
@@ -59,14 +60,18 @@ static const uint8_t ipc_rx_chan = 0;
 static const uint8_t ipc_tx_ack_chan = 6;
 static const uint8_t ipc_rx_ack_chan = 1;
 static const uint8_t ipc_remote_cpu = CPU_ID_LMT;
+static const uint8_t ipc_ring_tx_doorbell = 7;
+static const uint8_t ipc_ring_rx_doorbell = 2;
 
 /* ISR Callback to handle new messages received via Mailbox from LMT */
 static void ipc_mbx_isr(void)
 {
+    ipc_handle_ack();
+    ipc_ring_handle_doorbell();
     while (MBX_STS(ipc_rx_chan) & 0x2) {
         /* Pop a message from the h/w mailbox FIFO, process it, and ack it */
         ipc_handle_message();
-        while((queue_process_message(service_mgr_queue)) != 0);
+        queue_process_all(service_mgr_queue);
     }
 }
 
@@ -89,6 +94,10 @@ static void cfw_platform_mbx_int_enable(void)
     interrupt_enable(SOC_MBOX_INTERRUPT);
     /* Enable interrupt for ARC IPC rx channel */
     SOC_MBX_INT_UNMASK(ipc_rx_chan);
+    /* and for its ack channel, so IPC requests needn't spin */
+    ipc_enable_ack_int();
+    /* shared memory ring doorbells */
+    ipc_ring_init(ipc_ring_tx_doorbell, ipc_ring_rx_doorbell);
 }
 
 /* Initialise the IPC framework */
@@ -29,7 +29,7 @@
  */
 
 #include <stdint.h>
-#include "os/os_types.h"
+#include "os/os.h"
 #include "infra/ipc.h"
 #include "infra/port.h"
 #include "infra/message.h"
@@ -38,15 +38,27 @@
 #include "platform.h"
 
 #include "portable.h"
+#include "aux_regs.h"
 
 #define MBX_IPC_SYNC_ARC_TO_LMT 5
 
+#define IPC_ACK_TIMEOUT_MS 1000
+
 static int rx_chan = 0;
 static int tx_chan = 0;
 static int tx_ack_chan = 0;
 static int rx_ack_chan = 0;
 static uint8_t remote_cpu = 0;
 
+/* The one request in flight on tx_chan, until its ack is collected */
+static volatile int ack_pending = 0;
+static volatile int ack_done = 0;
+static volatile int ack_ret = 0;
+static ipc_ack_cb_t ack_cb = NULL;
+static void * ack_priv = NULL;
+/* rx_ack_chan interrupts reach ipc_handle_ack() */
+static int ack_int = 0;
+
 /*****************************************************************************
  * IPC Protocol:
  * 2 Mailboxes per side.
@@ -87,22 +99,64 @@ void ipc_handle_message()
     MBX_STS(rx_chan) = 3;
 }
 
-int ipc_request_sync_int(int request_id, int param1, int param2, void * ptr)
+void ipc_enable_ack_int(void)
+{
+    ack_int = 1;
+    SOC_MBX_INT_UNMASK(rx_ack_chan);
+}
+
+/* Collects the ack of the request in flight, if it has come. */
+static void ipc_collect_ack(void)
 {
+    ipc_ack_cb_t cb;
+    void * priv;
     int ret;
-    int timeout;
-    ret = mutex_lock(ipc_mutex, OS_WAIT_FOREVER);
-    if (ret != E_OS_OK) {
-        pr_error(LOG_MODULE_MAIN, "Error locking ipc %d", ret);
-        return ret;
+    uint32_t key = interrupt_lock();
+
+    if (!MBX_STS(rx_ack_chan)) {
+        interrupt_unlock(key);
+        return;
     }
-    pr_debug(LOG_MODULE_MAIN, "send request %d from: %p", request_id, &ret);
-    while (MBX_CTRL(tx_chan) & 0x80000000) {
-        pr_info(LOG_MODULE_MAIN, "Channel busy %d for request: %d msg: %p",
-                tx_chan, request_id, param1);
-        pr_info(LOG_MODULE_MAIN, "current request: %p msg: %p",
-                MBX_CTRL(tx_chan), MBX_DAT0(tx_chan));
+    ret = MBX_DAT0(rx_ack_chan);
+    MBX_DAT0(rx_ack_chan) = 0;
+    MBX_STS(rx_ack_chan) = 3;
+    if (!ack_pending) {
+        /* late ack of a request that timed out */
+        interrupt_unlock(key);
+        return;
     }
+    ack_pending = 0;
+    cb = ack_cb;
+    priv = ack_priv;
+    ack_cb = NULL;
+    if (cb == NULL) {
+        ack_ret = ret;
+        ack_done = 1;
+    }
+    interrupt_unlock(key);
+    if (cb != NULL)
+        cb(ret, priv);
+}
+
+void ipc_handle_ack(void)
+{
+    ipc_collect_ack();
+}
+
+/* Writes the request to tx_chan if nothing is in flight. */
+static int ipc_post(int request_id, int param1, int param2, void * ptr,
+        ipc_ack_cb_t cb, void * priv)
+{
+    uint32_t key = interrupt_lock();
+
+    if (ack_pending || (MBX_CTRL(tx_chan) & 0x80000000)) {
+        interrupt_unlock(key);
+        return 0;
+    }
+    ack_pending = 1;
+    ack_done = 0;
+    ack_cb = cb;
+    ack_priv = priv;
 
     MBX_STS(rx_ack_chan) = 3;
 
@@ -111,22 +165,111 @@ int ipc_request_sync_int(int request_id, int param1, int param2, void * ptr)
     MBX_DAT2(tx_chan) = param2;
     MBX_DAT3(tx_chan) = (unsigned int )ptr;
     MBX_CTRL(tx_chan) = 0x80000000 | IPC_MSG_TYPE_SYNC;
+    interrupt_unlock(key);
+    return 1;
+}
+
+/* Drops the request in flight: its ack, if it ever comes, is discarded. */
+static void ipc_abandon(void)
+{
+    ipc_ack_cb_t cb;
+    void * priv;
+    uint32_t key = interrupt_lock();
+
+    cb = ack_pending ? ack_cb : NULL;
+    priv = ack_priv;
+    ack_pending = 0;
+    ack_cb = NULL;
+    interrupt_unlock(key);
+    if (cb != NULL)
+        cb(E_OS_ERR_TIMEOUT, priv);
+}
+
+/*
+ * While an ack is due the core sleeps between checks, woken by the ack
+ * interrupt, unless acks aren't routed here or this is an interrupt handler
+ * (the mailbox one can't preempt it): then it spins. Nothing signals tx_chan
+ * being read, so waiting for that alone always spins.
+ */
+static int ipc_can_sleep(void)
+{
+    return ack_int &&
+           (aux_reg_read(ARC_V2_STATUS32) & ARC_V2_STATUS32_IE) &&
+           aux_reg_read(ARC_V2_AUX_IRQ_ACT) == 0;
+}
+
+static void ipc_idle(int sleep)
+{
+    uint32_t key;
+
+    ipc_collect_ack();
+    if (!sleep)
+        return;
+    key = interrupt_lock();
+    if (ack_pending && !MBX_STS(rx_ack_chan))
+        __asm__ volatile ("sleep %0" :: "r" (key));
+    else
+        interrupt_unlock(key);
+}
+
+int ipc_request_sync_int(int request_id, int param1, int param2, void * ptr)
+{
+    int ret;
+    int sleep = ipc_can_sleep();
+    uint32_t start;
+    ret = mutex_lock(ipc_mutex, OS_WAIT_FOREVER);
+    if (ret != E_OS_OK) {
+        pr_error(LOG_MODULE_MAIN, "Error locking ipc %d", ret);
+        return ret;
+    }
+    pr_debug(LOG_MODULE_MAIN, "send request %d from: %p", request_id, &ret);
+
+    start = get_uptime_ms();
+    while (!ipc_post(request_id, param1, param2, ptr, NULL, NULL)) {
+        if (get_uptime_ms() - start >= IPC_ACK_TIMEOUT_MS) {
+            pr_error(LOG_MODULE_MAIN, "Channel busy %d for request: %d msg: %p",
+                    tx_chan, request_id, param1);
+            ipc_abandon();
+            if (!ipc_post(request_id, param1, param2, ptr, NULL, NULL)) {
+                mutex_unlock(ipc_mutex, NULL);
+                return E_OS_ERR_BUSY;
+            }
+            break;
+        }
+        ipc_idle(sleep);
+    }
 
-    timeout = get_uptime_ms() + 1000;
-    while(!MBX_STS(rx_ack_chan)) {
-        if (get_uptime_ms() > timeout) {
+    start = get_uptime_ms();
+    for (;;) {
+        ipc_collect_ack();
+        if (ack_done) {
+            ret = ack_ret;
+            break;
+        }
+        if (get_uptime_ms() - start >= IPC_ACK_TIMEOUT_MS) {
             pr_error(LOG_MODULE_MAIN, "Timeout waiting ack %p", request_id);
+            ipc_abandon();
+            ret = E_OS_ERR_TIMEOUT;
             break;
         }
+        ipc_idle(sleep);
     }
-    ret = MBX_DAT0(rx_ack_chan);
-    MBX_DAT0(rx_ack_chan) = 0;
-    MBX_STS(rx_ack_chan) = 3;
     pr_debug(LOG_MODULE_MAIN, "ipc_request_sync returns: [%d] %p", rx_ack_chan, ret);
     mutex_unlock(ipc_mutex, NULL);
     return ret;
 }
 
+int ipc_request_async_int(int request_id, int param1, int param2, void * ptr,
+        ipc_ack_cb_t cb, void * priv)
+{
+    if (!ack_int)
+        return E_OS_ERR_NOT_SUPPORTED;
+    ipc_collect_ack();
+    if (!ipc_post(request_id, param1, param2, ptr, cb, priv))
+        return E_OS_ERR_BUSY;
+    return E_OS_OK;
+}
+
 #define IPC_MESSAGE_SEND 1
 #define IPC_MESSAGE_FREE 2
 
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include "os/os.h"
+#include "infra/ipc_ring.h"
+#include "platform.h"
+
+#include "portable.h"
+
+static int tx_doorbell = -1;
+static int rx_doorbell = -1;
+static void (*ring_cb)(void *priv) = NULL;
+static void * ring_priv = NULL;
+
+void ipc_ring_init(int tx_doorbell_chan, int rx_doorbell_chan)
+{
+    tx_doorbell = tx_doorbell_chan;
+    rx_doorbell = rx_doorbell_chan;
+    MBX_STS(rx_doorbell) = 3;
+    SOC_MBX_INT_UNMASK(rx_doorbell);
+}
+
+int ipc_ring_ready(void)
+{
+    return tx_doorbell >= 0 && shared_data->ipc_ring_magic == IPC_RING_MAGIC;
+}
+
+int ipc_ring_write(const void *buf, int len)
+{
+    struct ipc_ring * r = shared_data->ipc_ring_tx;
+    const uint8_t * p = (const uint8_t *) buf;
+    uint32_t head;
+    uint32_t flags;
+    int n, i;
+
+    if (!ipc_ring_ready() || len <= 0)
+        return 0;
+
+    /* one producer on this side, whichever context it runs in */
+    flags = interrupt_lock();
+    head = r->head;
+    n = r->size - (head - r->tail);
+    if (n > len)
+        n = len;
+    for (i = 0; i < n; i++)
+        r->data[(head + i) & (r->size - 1)] = p[i];
+    r->head = head + n;
+    /* the reader may have seen it empty and be done: wake it. The tail is
+     * read after head is published, so a reader that misses the new head
+     * left the tail equal to the old one. */
+    if (n > 0 && r->tail == head && !(MBX_CTRL(tx_doorbell) & 0x80000000))
+        MBX_CTRL(tx_doorbell) = 0x80000000;
+    interrupt_unlock(flags);
+    return n;
+}
+
+int ipc_ring_read(void *buf, int len)
+{
+    struct ipc_ring * r = shared_data->ipc_ring_rx;
+    uint8_t * p = (uint8_t *) buf;
+    uint32_t tail;
+    uint32_t flags;
+    int n, i;
+
+    if (!ipc_ring_ready() || len <= 0)
+        return 0;
+
+    flags = interrupt_lock();
+    tail = r->tail;
+    n = r->head - tail;
+    if (n > len)
+        n = len;
+    for (i = 0; i < n; i++)
+        p[i] = r->data[(tail + i) & (r->size - 1)];
+    r->tail = tail + n;
+    interrupt_unlock(flags);
+    return n;
+}
+
+int ipc_ring_available(void)
+{
+    if (!ipc_ring_ready())
+        return 0;
+    return shared_data->ipc_ring_rx->head - shared_data->ipc_ring_rx->tail;
+}
+
+int ipc_ring_space(void)
+{
+    struct ipc_ring * r = shared_data->ipc_ring_tx;
+    if (!ipc_ring_ready())
+        return 0;
+    return r->size - (r->head - r->tail);
+}
+
+void ipc_ring_set_callback(void (*cb)(void *priv), void *priv)
+{
+    uint32_t flags = interrupt_lock();
+    ring_cb = cb;
+    ring_priv = priv;
+    interrupt_unlock(flags);
+}
+
+void ipc_ring_handle_doorbell(void)
+{
+    if (rx_doorbell < 0 || !MBX_STS(rx_doorbell))
+        return;
+    MBX_STS(rx_doorbell) = 3;
+    if (ring_cb != NULL)
+        ring_cb(ring_priv);
+}
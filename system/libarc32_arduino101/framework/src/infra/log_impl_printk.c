@@ -29,28 +29,333 @@
  */
 
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "os/os.h"
+#include "infra/time.h"
 #include "log_impl.h"
 #include "infra/log_backend.h"
 
 //extern int printk(const char * format, ...);
 extern void printk(const char *fmt, va_list args);
 
+/*
+ * Deferred log: log_write_msg() keeps the format pointer, level, module,
+ * timestamp and the raw arguments in a ring of fixed-size records, taking
+ * the interrupt lock only to claim a slot. The text is built later by
+ * log_process(), called from the main loop, so a pr_debug() in an interrupt
+ * or an IPC path costs a scan of the format rather than a printf. Strings
+ * are copied, as the caller's buffer may be gone by then; what doesn't fit
+ * a record is marked with "..." in the output.
+ */
+#ifndef CONFIG_LOG_DEFER_SLOTS
+#define CONFIG_LOG_DEFER_SLOTS 16	/* a power of two */
+#endif
+#define LOG_DEFER_WORDS 8
+#define LOG_DEFER_STR 32
+
+struct log_record {
+	const char *format;
+	uint32_t timestamp;
+	uint8_t level;
+	uint8_t module;
+	uint8_t truncated;
+	volatile uint8_t ready;
+	uint32_t words[LOG_DEFER_WORDS];
+	char strs[LOG_DEFER_STR];	/* %s arguments, NUL-terminated */
+};
+
+static struct log_record log_ring[CONFIG_LOG_DEFER_SLOTS];
+static uint32_t log_head;		/* slots claimed, under the lock */
+static volatile uint32_t log_tail;	/* slots emitted, by log_process() */
+static uint32_t log_lost;		/* dropped on a full ring */
+static bool log_suspended;
+static void (*log_put)(const char *buffer, uint16_t len);
+
+/* What a conversion takes from the arguments */
+enum {
+	ARG_NONE,
+	ARG_INT,
+	ARG_LLONG,
+	ARG_DOUBLE,
+	ARG_STR,
+	ARG_PTR
+};
+
+/* Steps over one conversion spec after its '%', counting '*'s; returns
+ * the argument kind and leaves *fmt past the spec */
+static uint8_t log_parse_spec(const char **fmt, uint8_t *stars)
+{
+	const char *p = *fmt;
+	uint8_t longs = 0;
+	uint8_t kind;
+
+	*stars = 0;
+	while (*p && strchr("-+ #0", *p))
+		p++;
+	if (*p == '*') {
+		(*stars)++;
+		p++;
+	}
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			(*stars)++;
+			p++;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	while (*p && strchr("hlLqjzt", *p)) {
+		if (*p == 'l' || *p == 'q' || *p == 'j')
+			longs++;
+		p++;
+	}
+	switch (*p) {
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+		kind = longs >= 2 || (longs && p[-1] == 'j') ? ARG_LLONG : ARG_INT;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		kind = ARG_DOUBLE;
+		break;
+	case 's':
+		kind = ARG_STR;
+		break;
+	case 'p': case 'n':
+		kind = ARG_PTR;
+		break;
+	default:
+		/* %% or an unknown conversion */
+		kind = ARG_NONE;
+		break;
+	}
+	if (*p)
+		p++;
+	*fmt = p;
+	return kind;
+}
+
+/* Copies the arguments the format will want into the record */
+static void log_capture(struct log_record *r, va_list args)
+{
+	const char *p = r->format;
+	uint8_t w = 0, s = 0, stars, kind;
+
+	r->truncated = 0;
+	while (*p) {
+		if (*p++ != '%')
+			continue;
+		kind = log_parse_spec(&p, &stars);
+		if (kind == ARG_NONE)
+			continue;
+		if (w + stars + (kind == ARG_LLONG || kind == ARG_DOUBLE ? 2 : 1) > LOG_DEFER_WORDS) {
+			r->truncated = 1;
+			return;
+		}
+		while (stars--)
+			r->words[w++] = va_arg(args, int);
+		if (kind == ARG_LLONG || kind == ARG_DOUBLE) {
+			union { uint64_t ll; double d; uint32_t w[2]; } v;
+			if (kind == ARG_LLONG)
+				v.ll = va_arg(args, uint64_t);
+			else
+				v.d = va_arg(args, double);
+			r->words[w++] = v.w[0];
+			r->words[w++] = v.w[1];
+		} else if (kind == ARG_STR) {
+			const char *str = va_arg(args, const char *);
+			size_t n;
+
+			if (!str)
+				str = "(null)";
+			n = strlen(str);
+			if (n >= (size_t)(LOG_DEFER_STR - s)) {
+				n = LOG_DEFER_STR - s - 1;
+				r->truncated = 1;
+			}
+			memcpy(r->strs + s, str, n);
+			r->strs[s + n] = '\0';
+			r->words[w++] = s;
+			s += n + 1;
+			if (s >= LOG_DEFER_STR) {
+				/* later strings come out empty */
+				s = LOG_DEFER_STR - 1;
+			}
+		} else {
+			r->words[w++] = va_arg(args, uint32_t);
+		}
+	}
+}
+
+/* Formats a record the way vsnprintf() would have, a conversion at a time */
+static uint16_t log_format(const struct log_record *r, char *out, uint16_t size)
+{
+	const char *p = r->format;
+	char spec[24];
+	uint16_t n = 0;
+	uint8_t w = 0, stars, kind;
+	int len;
+
+	while (*p && n < size - 1) {
+		const char *start = p;
+
+		if (*p != '%') {
+			out[n++] = *p++;
+			continue;
+		}
+		p++;
+		kind = log_parse_spec(&p, &stars);
+		if (kind == ARG_NONE) {
+			if (p[-1] == '%')
+				out[n++] = '%';
+			continue;
+		}
+		if (w + stars + (kind == ARG_LLONG || kind == ARG_DOUBLE ? 2 : 1) > LOG_DEFER_WORDS ||
+		    p - start >= (int)sizeof(spec) - 16) {
+			/* its arguments weren't kept */
+			break;
+		}
+
+		/* the spec with any '*' replaced by the width kept for it */
+		uint8_t k = 0;
+		while (start < p) {
+			if (*start == '*')
+				k += snprintf(spec + k, sizeof(spec) - k, "%d", (int)r->words[w++]);
+			else
+				spec[k++] = *start;
+			start++;
+		}
+		spec[k] = '\0';
+
+		if (kind == ARG_LLONG || kind == ARG_DOUBLE) {
+			union { uint64_t ll; double d; uint32_t w[2]; } v;
+			v.w[0] = r->words[w++];
+			v.w[1] = r->words[w++];
+			if (kind == ARG_LLONG)
+				len = snprintf(out + n, size - n, spec, v.ll);
+			else
+				len = snprintf(out + n, size - n, spec, v.d);
+		} else if (kind == ARG_STR) {
+			len = snprintf(out + n, size - n, spec, r->strs + r->words[w++]);
+		} else if (kind == ARG_PTR) {
+			len = spec[k - 1] == 'n' ? (w++, 0) :
+			      snprintf(out + n, size - n, spec, (void *)(uintptr_t)r->words[w++]);
+		} else {
+			len = snprintf(out + n, size - n, spec, r->words[w++]);
+		}
+		if (len < 0)
+			break;
+		n += len < size - n ? len : size - n - 1;
+	}
+	if (r->truncated && n + 3 < size) {
+		memcpy(out + n, "...", 3);
+		n += 3;
+	}
+	out[n] = '\0';
+	return n;
+}
+
+static void log_printk_str(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	printk(fmt, args);
+	va_end(args);
+}
+
+/* To the backend, or printk() until one is set */
+static void log_emit(char *buf, uint16_t len)
+{
+	if (log_put) {
+		buf[len++] = '\n';
+		log_put(buf, len);
+	} else {
+		log_printk_str("%s", buf);
+	}
+}
+
+/* Emits the ready records, at most max of them */
+static void log_drain(uint32_t max)
+{
+	/* a line of text plus the newline the backend gets */
+	char buf[LOG_MAX_MSG_LEN + 24];
+	uint32_t lost;
+	uint16_t n;
+
+	while (max-- && log_tail != log_head) {
+		struct log_record *r = &log_ring[log_tail & (CONFIG_LOG_DEFER_SLOTS - 1)];
+
+		if (!r->ready)
+			break;
+
+		uint32_t flags = interrupt_lock();
+		lost = log_lost;
+		log_lost = 0;
+		interrupt_unlock(flags);
+		if (lost) {
+			n = snprintf(buf, sizeof(buf) - 1, "%u log messages lost", (unsigned)lost);
+			log_emit(buf, n);
+		}
+
+		n = snprintf(buf, sizeof(buf) - 1, "%u %s %s: ", (unsigned)r->timestamp,
+			     log_get_level_name(r->level), log_get_module_name(r->module));
+		n += log_format(r, buf + n, sizeof(buf) - 1 - n);
+		r->ready = 0;
+		log_tail++;
+		log_emit(buf, n);
+	}
+}
+
 uint32_t log_write_msg(uint8_t level, uint8_t module, const char *format,
 				va_list args)
 {
-// TODO - implement printk
-	printk(format, args);
+	struct log_record *r;
+
+	uint32_t flags = interrupt_lock();
+	if (log_head - log_tail == CONFIG_LOG_DEFER_SLOTS) {
+		log_lost++;
+		interrupt_unlock(flags);
+		return 0;
+	}
+	r = &log_ring[log_head++ & (CONFIG_LOG_DEFER_SLOTS - 1)];
+	interrupt_unlock(flags);
+
+	r->format = format;
+	r->timestamp = get_uptime_ms();
+	r->level = level;
+	r->module = module;
+	log_capture(r, args);
+	/* log_process() stops at the first record not yet filled in */
+	r->ready = 1;
 	return 0;
 }
 
+void log_process() {
+	if (!log_suspended)
+		log_drain(CONFIG_LOG_DEFER_SLOTS);
+}
+
 void log_flush() {
-	return;
+	log_drain(0xFFFFFFFF);
+}
+
+void log_suspend() {
+	log_suspended = true;
+}
+
+void log_resume() {
+	log_suspended = false;
 }
 
 void log_impl_init() {
-	return;
+	log_head = log_tail = log_lost = 0;
 }
 
 void log_set_backend(struct log_backend backend) {
-	return;
+	uint32_t flags = interrupt_lock();
+	log_put = backend.put_one_msg;
+	interrupt_unlock(flags);
 }
@@ -235,6 +235,63 @@ uint8_t port_get_cpu_id(uint16_t port_id)
     }
 }
 
+#ifndef CONFIG_SHARED_MESSAGES
+#define CONFIG_SHARED_MESSAGES 4
+#endif
+
+/**
+ * Messages handed to several local handlers at once, with the number of
+ * message_free() calls still expected before the buffer is released.
+ */
+static struct {
+	struct message * msg;
+	uint16_t refs;
+} shared_messages[CONFIG_SHARED_MESSAGES];
+static int shared_message_count = 0;
+
+int message_share(struct message * msg, uint16_t refs)
+{
+	int i;
+	int ret = -1;
+	uint32_t flags = interrupt_lock();
+	for (i = 0; i < CONFIG_SHARED_MESSAGES; i++) {
+		if (shared_messages[i].msg == NULL) {
+			shared_messages[i].msg = msg;
+			shared_messages[i].refs = refs;
+			shared_message_count++;
+			ret = 0;
+			break;
+		}
+	}
+	interrupt_unlock(flags);
+	return ret;
+}
+
+/* Returns 1 while other references to msg remain, 0 when it may be freed. */
+static int message_release(struct message * msg)
+{
+	int i;
+	int held = 0;
+	uint32_t flags;
+
+	if (shared_message_count == 0)
+		return 0;
+	flags = interrupt_lock();
+	for (i = 0; i < CONFIG_SHARED_MESSAGES; i++) {
+		if (shared_messages[i].msg == msg) {
+			if (--shared_messages[i].refs > 0) {
+				held = 1;
+			} else {
+				shared_messages[i].msg = NULL;
+				shared_message_count--;
+			}
+			break;
+		}
+	}
+	interrupt_unlock(flags);
+	return held;
+}
+
 #ifdef INFRA_MULTI_CPU_SUPPORT
 #include "platform.h"
 
@@ -296,6 +353,8 @@ int port_send_message(struct message * message)
 
 void message_free(struct message * msg)
 {
+    if (message_release(msg))
+        return;
     struct port * port = get_port(MESSAGE_SRC(msg));
     if (!port)
     {
@@ -333,6 +392,8 @@ int port_send_message(struct message * msg)
 
 void message_free(struct message * msg)
 {
+	if (message_release(msg))
+		return;
 	bfree(msg);
 }
 #endif
@@ -351,3 +412,33 @@ uint16_t queue_process_message(T_QUEUE queue)
        }
        return id;
 }
+
+uint16_t queue_process_message_wait(T_QUEUE queue, uint32_t timeout, OS_ERR_TYPE* err)
+{
+       T_QUEUE_MESSAGE m = NULL;
+       struct message * message;
+       uint16_t id = 0;
+       queue_get_message(queue, &m, timeout, err);
+       message = (struct message *) m;
+       if (message != NULL) {
+               id = MESSAGE_ID(message);
+               port_process_message(message);
+       }
+       return id;
+}
+
+uint32_t queue_process_all(T_QUEUE queue)
+{
+       T_QUEUE_MESSAGE m;
+       OS_ERR_TYPE err;
+       uint32_t count = 0;
+
+       for (;;) {
+               queue_get_message(queue, &m, OS_NO_WAIT, &err);
+               if (err != E_OS_OK || m == NULL)
+                       break;
+               port_process_message((struct message *) m);
+               count++;
+       }
+       return count;
+}
@@ -37,6 +37,7 @@ typedef struct {
     uint32_t sum;           /** Cumulative size in bytes */
     uint32_t nbrs;          /** Cumulative block allocated */
 #endif
+    uint16_t hint;          /** first track word that may have a free block */
 }T_POOL_DESC;
 
 /**********************************************************
@@ -45,15 +46,14 @@ typedef struct {
 
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
 
-/** Allocate the memory blocks and tracking variables for each pool */
+/** Allocate the tracking variables for each pool; the blocks themselves
+ * are allocated from DCCM by os_abstraction_init_malloc() */
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_TRACK_OWNER
 #define DECLARE_MEMORY_POOL(index, size, count) \
-    uint8_t mblock_ ## index[count][size] __aligned(4); \
     uint32_t mblock_alloc_track_ ## index[count / BITS_PER_U32 + 1] = { 0 }; \
     uint32_t *mblock_owners_ ## index[count] = { 0 };
 #else
 #define DECLARE_MEMORY_POOL(index, size, count) \
-    uint8_t mblock_ ## index[count][size] __aligned(4); \
     uint32_t mblock_alloc_track_ ## index[count / BITS_PER_U32 + \
                           1] = { 0 };
 #endif
@@ -67,8 +67,8 @@ T_POOL_DESC mpool[] =
 #define DECLARE_MEMORY_POOL(index, size, count) \
     { \
 /* T_POOL_DESC.track */ mblock_alloc_track_ ## index, \
-/* T_POOL_DESC.start */ (uint32_t)mblock_ ## index, \
-/* T_POOL_DESC.end */ (uint32_t)mblock_ ## index + count * size, \
+/* T_POOL_DESC.start */ 0, \
+/* T_POOL_DESC.end */ 0, \
 /* T_POOL_DESC.count */ count, \
 /* T_POOL_DESC.size */ size, \
 /* T_POOL_DESC.owners */ mblock_owners_ ## index, \
@@ -81,8 +81,8 @@ T_POOL_DESC mpool[] =
 #define DECLARE_MEMORY_POOL(index, size, count) \
     { \
 /* T_POOL_DESC.track */ mblock_alloc_track_ ## index, \
-/* T_POOL_DESC.start */ (uint32_t)mblock_ ## index, \
-/* T_POOL_DESC.end */ (uint32_t)mblock_ ## index + count * size, \
+/* T_POOL_DESC.start */ 0, \
+/* T_POOL_DESC.end */ 0, \
 /* T_POOL_DESC.count */ count, \
 /* T_POOL_DESC.size */ size, \
 /* T_POOL_DESC.max */ 0, \
@@ -144,31 +144,41 @@ T_POOL_DESC mpool [] =
 static void *memblock_alloc(uint32_t pool)
 {
     uint16_t block;
-    uint32_t flags = interrupt_lock();//irq_lock();
-
-    for (block = 0; block < mpool[pool].count; block++) {
-        if (((mpool[pool].track)[block / BITS_PER_U32] & 1 <<
-             (BITS_PER_U32 - 1 - (block % BITS_PER_U32))) == 0) {
-            (mpool[pool].track)[block / BITS_PER_U32] =
-                (mpool[pool].track)[block / BITS_PER_U32] |
-                (1 << (BITS_PER_U32 - 1 - (block % BITS_PER_U32)));
+    uint16_t word;
+    uint16_t words = (mpool[pool].count + BITS_PER_U32 - 1) / BITS_PER_U32;
+    uint32_t flags = interrupt_lock_low();
+
+    /* Block n is bit (31 - n % 32) of word n / 32, so the first free block
+     * of a word is the leading zero count of its complement. Words below
+     * the hint are known to be full. */
+    for (word = mpool[pool].hint; word < words; word++) {
+        uint32_t free = ~(mpool[pool].track)[word];
+
+        if (word == words - 1 && mpool[pool].count % BITS_PER_U32)
+            free &= ~0U << (BITS_PER_U32 - mpool[pool].count % BITS_PER_U32);
+        if (free == 0)
+            continue;
+
+        block = word * BITS_PER_U32 + __builtin_clz(free);
+        (mpool[pool].track)[word] |= 0x80000000U >> __builtin_clz(free);
+        mpool[pool].hint = word;
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
-            mpool[pool].cur = mpool[pool].cur + 1;
+        mpool[pool].cur = mpool[pool].cur + 1;
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_TRACK_OWNER
-            /* get return address */
-            uint32_t ret_a = (uint32_t)__builtin_return_address(0);
-            mpool[pool].owners[block] =
-                (uint32_t *)(((ret_a & 0xFFFF0U) >> 4) |
-                         ((get_uptime_ms() & 0xFFFF0) << 12));
+        /* get return address */
+        uint32_t ret_a = (uint32_t)__builtin_return_address(0);
+        mpool[pool].owners[block] =
+            (uint32_t *)(((ret_a & 0xFFFF0U) >> 4) |
+                     ((get_uptime_ms() & 0xFFFF0) << 12));
 #endif
-            if (mpool[pool].cur > mpool[pool].max)
-                mpool[pool].max = mpool[pool].cur;
+        if (mpool[pool].cur > mpool[pool].max)
+            mpool[pool].max = mpool[pool].cur;
 #endif
-            interrupt_unlock(flags);//irq_unlock(flags);
-            return (void *)(mpool[pool].start +
-                    mpool[pool].size * block);
-        }
+        interrupt_unlock(flags);//irq_unlock(flags);
+        return (void *)(mpool[pool].start +
+                mpool[pool].size * block);
     }
+    mpool[pool].hint = words;
     //irq_unlock(flags);
     interrupt_unlock(flags);
     return NULL;
@@ -192,13 +202,15 @@ static void memblock_free(uint32_t pool, void *ptr)
 
     block = ((uint32_t)ptr - mpool[pool].start) / mpool[pool].size;
     if (block < mpool[pool].count) {
-        flags = interrupt_lock();//irq_lock();
+        flags = interrupt_lock_low();
         (mpool[pool].track)[block / BITS_PER_U32] &=
             ~(1 << (BITS_PER_U32 - 1 - (block % BITS_PER_U32)));
-        interrupt_unlock(flags);//irq_unlock(flags);
+        if (block / BITS_PER_U32 < mpool[pool].hint)
+            mpool[pool].hint = block / BITS_PER_U32;
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
         mpool[pool].cur = mpool[pool].cur - 1;
 #endif
+        interrupt_unlock(flags);//irq_unlock(flags);
     } else {
         pr_debug(
             LOG_MODULE_UTIL,
@@ -337,10 +349,85 @@ void os_abstraction_init_malloc(void)
   for (indx=0; indx < NB_MEMORY_POOLS; indx++) {
     bufSize = mpool[indx].count * mpool[indx].size;
     mpool[indx].start = (uint32_t)dccm_memalign((uint16_t)bufSize);
+    if (mpool[indx].start == 0) {
+      /* DCCM can't hold this pool: leave it empty so that balloc()
+       * moves on to the next one, and report count 0 in the stats */
+      mpool[indx].count = 0;
+      continue;
+    }
     mpool[indx].end = mpool[indx].start + bufSize;
   }
 }
 
+/**
+ * Number of pools, the highest valid index for balloc_pool_stats() + 1.
+ */
+uint8_t balloc_pool_count(void)
+{
+    return NB_MEMORY_POOLS;
+}
+
+/**
+ * Reports the usage of one pool.
+ *
+ * Authorized execution levels:  task, fiber, ISR
+ *
+ * @param pool index of the pool, 0 for the smallest blocks
+ *
+ * @param stats receives the pool usage; max, allocs and bytes stay 0
+ *     unless built with CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
+ *
+ * @return execution status:
+ *    E_OS_OK : stats was filled in
+ *    E_OS_ERR : no such pool
+ */
+OS_ERR_TYPE balloc_pool_stats(uint8_t pool, T_POOL_STATS *stats)
+{
+    uint16_t word;
+    uint16_t used = 0;
+    uint32_t flags;
+
+    if (pool >= NB_MEMORY_POOLS || stats == NULL)
+        return E_OS_ERR;
+
+    flags = interrupt_lock_low();
+    for (word = 0; word < (mpool[pool].count + BITS_PER_U32 - 1) / BITS_PER_U32; word++)
+        used += __builtin_popcount((mpool[pool].track)[word]);
+    stats->size = mpool[pool].size;
+    stats->count = mpool[pool].count;
+    stats->used = used;
+#ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
+    stats->max = mpool[pool].max;
+    stats->allocs = mpool[pool].nbrs;
+    stats->bytes = mpool[pool].sum;
+#else
+    stats->max = 0;
+    stats->allocs = 0;
+    stats->bytes = 0;
+#endif
+    interrupt_unlock(flags);
+    return E_OS_OK;
+}
+
+/**
+ * Restarts the balloc_pool_stats() high-water marks and counters from the
+ * current usage.
+ */
+void balloc_reset_stats(void)
+{
+#ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
+    uint8_t pool;
+    uint32_t flags = interrupt_lock_low();
+
+    for (pool = 0; pool < NB_MEMORY_POOLS; pool++) {
+        mpool[pool].max = mpool[pool].cur;
+        mpool[pool].nbrs = 0;
+        mpool[pool].sum = 0;
+    }
+    interrupt_unlock(flags);
+#endif
+}
+
 /**
  * Reserves a block of memory.
  *
@@ -30,6 +30,8 @@
 
 #include "cfw/cfw.h"
 #include "os/os.h"
+#include "infra/time.h"
+#include "aux_regs.h"
 
 /*************************    MEMORY   *************************/
 
@@ -79,64 +81,200 @@ OS_ERR_TYPE bfree(void *ptr) {
 
 /*************************    QUEUES   *************************/
 
+/*
+ * Each queue is a ring of message pointers of the capacity given to
+ * queue_create(), carved out of one static slot array, so a put or a get
+ * is a couple of index updates with interrupts masked and a full queue
+ * reports E_OS_ERR_OVERFLOW instead of growing.
+ */
+#ifndef CONFIG_OS_QUEUE_POOL
+#define CONFIG_OS_QUEUE_POOL 10
+#endif
+#ifndef CONFIG_OS_QUEUE_SLOTS
+#define CONFIG_OS_QUEUE_SLOTS 128	/* message pointers, for all queues */
+#endif
+
 typedef struct queue_ {
-    list_head_t lh;
-    int count;
-    int used;
+    T_QUEUE_MESSAGE *ring;
+    uint16_t base;              /* first slot in q_slots */
+    uint16_t size;              /* capacity */
+    uint16_t head;              /* next put */
+    uint16_t count;
+    uint8_t used;
 } q_t;
 
-q_t q_pool[10];
+static q_t q_pool[CONFIG_OS_QUEUE_POOL];
+static T_QUEUE_MESSAGE q_slots[CONFIG_OS_QUEUE_SLOTS];
+
+/* Sets *err, or panics on an error if the caller gave no err */
+static void queue_status(OS_ERR_TYPE *err, OS_ERR_TYPE status)
+{
+    if (err != NULL)
+        *err = status;
+    else if (status != E_OS_OK && status != E_OS_ERR_EMPTY &&
+             status != E_OS_ERR_TIMEOUT)
+        panic(status);
+}
+
+/* Waiting needs interrupts, and a handler can't wait */
+static bool queue_can_wait(void)
+{
+    return (aux_reg_read(ARC_V2_STATUS32) & ARC_V2_STATUS32_IE) &&
+           aux_reg_read(ARC_V2_AUX_IRQ_ACT) == 0;
+}
 
-void queue_put(void *queue, void *msg) {
+/* Pops the oldest message, or NULL; call with interrupts masked */
+static T_QUEUE_MESSAGE queue_pop(q_t *q)
+{
+    T_QUEUE_MESSAGE msg;
+    uint16_t tail;
+
+    if (q->count == 0)
+        return NULL;
+    tail = q->head >= q->count ? q->head - q->count : q->head + q->size - q->count;
+    msg = q->ring[tail];
+    q->count--;
+    return msg;
+}
+
+void queue_get_message (T_QUEUE queue, T_QUEUE_MESSAGE* message, int timeout, OS_ERR_TYPE* err) {
     q_t * q = (q_t*) queue;
-    list_add(&q->lh, (list_t *)msg);
-#ifdef DEBUG_OS
-    cfw_log("queue_put: %p <- %p\n", queue, msg);
-#endif
+    uint32_t start = 0;
+
+    if (q == NULL || !q->used || message == NULL) {
+        queue_status(err, E_OS_ERR);
+        return;
+    }
+    if (timeout > 0)
+        start = get_uptime_ms();
+
+    for (;;) {
+        unsigned int key = interrupt_lock();
+        *message = queue_pop(q);
+        if (*message != NULL) {
+            interrupt_unlock(key);
+            queue_status(err, E_OS_OK);
+            return;
+        }
+        if (timeout == OS_NO_WAIT) {
+            interrupt_unlock(key);
+            queue_status(err, E_OS_ERR_EMPTY);
+            return;
+        }
+        interrupt_unlock(key);
+        if (!queue_can_wait()) {
+            queue_status(err, E_OS_ERR_NOT_ALLOWED);
+            return;
+        }
+        if (timeout == OS_WAIT_FOREVER) {
+            /* Messages come from interrupts: sleep until the next one.
+             * The sleep takes the lock key and re-enables interrupts as it
+             * sleeps, so a put between the check and the sleep still wakes it. */
+            key = interrupt_lock();
+            if (q->count == 0)
+                __asm__ volatile ("sleep %0" :: "r" (key));
+            else
+                interrupt_unlock(key);
+        } else if (get_uptime_ms() - start >= (uint32_t)timeout) {
+            /* nothing to wake a sleep at the deadline, so timed waits poll */
+            queue_status(err, E_OS_ERR_TIMEOUT);
+            return;
+        }
+    }
 }
 
-void * queue_wait(void *queue) {
+void queue_send_message (T_QUEUE queue, T_QUEUE_MESSAGE message, OS_ERR_TYPE* err) {
     q_t * q = (q_t*) queue;
-    void * elem = (void *)list_get(&q->lh);
+    unsigned int key;
+
+    if (q == NULL || !q->used) {
+        queue_status(err, E_OS_ERR);
+        return;
+    }
+
+    key = interrupt_lock();
+    if (q->count == q->size) {
+        interrupt_unlock(key);
+        queue_status(err, E_OS_ERR_OVERFLOW);
+        return;
+    }
+    q->ring[q->head] = message;
+    if (++q->head == q->size)
+        q->head = 0;
+    q->count++;
+    interrupt_unlock(key);
 #ifdef DEBUG_OS
-    cfw_log("queue_wait: %p -> %p\n", queue, elem);
+    cfw_log("queue_put: %p <- %p\n", queue, message);
 #endif
-    return elem;
+    queue_status(err, E_OS_OK);
 }
 
-void queue_get_message (T_QUEUE queue, T_QUEUE_MESSAGE* message, int timeout, OS_ERR_TYPE* err) {
-    *message = queue_wait(queue);
-    *err = E_OS_OK;
-}
+/* First gap of size slots between the rings in use, or -1 */
+static int queue_find_slots(uint32_t size)
+{
+    uint32_t base = 0;
+    int i, moved;
 
-void queue_send_message (T_QUEUE queue, T_QUEUE_MESSAGE message, OS_ERR_TYPE* err) {
-    queue_put(queue, message);
-    *err = E_OS_OK;
+    do {
+        moved = 0;
+        for (i = 0; i < CONFIG_OS_QUEUE_POOL; i++) {
+            q_t *o = &q_pool[i];
+            if (o->used && o->base < base + size && base < o->base + o->size) {
+                base = o->base + o->size;
+                moved = 1;
+            }
+        }
+    } while (moved);
+
+    return base + size <= CONFIG_OS_QUEUE_SLOTS ? (int)base : -1;
 }
 
 T_QUEUE queue_create(uint32_t  max_size, OS_ERR_TYPE*err) {
-    int i, found=0;
-    q_t * q;
-    for (i=0;i<10; i++) {
-        q = &q_pool[i];
-        if (q->used == 0) {
-            q->used = 1;
-            found = 1;
+    int i, base;
+    q_t * q = NULL;
+    unsigned int key;
+
+    if (max_size == 0) {
+        queue_status(err, E_OS_ERR);
+        return (T_QUEUE)NULL;
+    }
+
+    key = interrupt_lock();
+    for (i = 0; i < CONFIG_OS_QUEUE_POOL; i++) {
+        if (q_pool[i].used == 0) {
+            q = &q_pool[i];
+            break;
         }
     }
-    if (!found) return (T_QUEUE)NULL;
-    list_init(&q->lh);
+    base = q ? queue_find_slots(max_size) : -1;
+    if (base < 0) {
+        interrupt_unlock(key);
+        queue_status(err, q ? E_OS_ERR_NO_MEMORY : E_OS_ERR);
+        return (T_QUEUE)NULL;
+    }
+    q->ring = &q_slots[base];
+    q->base = base;
+    q->size = max_size;
+    q->head = 0;
     q->count = 0;
+    q->used = 1;
+    interrupt_unlock(key);
+
+    queue_status(err, E_OS_OK);
     return (T_QUEUE) q;
 }
 
 void queue_delete(T_QUEUE queue, OS_ERR_TYPE* err) {
-    void * element = NULL;
     q_t * q = (q_t*) queue;
-    while((element = list_get(&q->lh)) != NULL)
-        list_remove(&q->lh, element);
-    //cfw_free(q, NULL);
+
+    if (q == NULL || !q->used) {
+        queue_status(err, E_OS_ERR);
+        return;
+    }
+    /* messages still queued are dropped, as before */
+    q->count = 0;
     q->used = 0;
+    queue_status(err, E_OS_OK);
 }
 
 /*************************    MUTEXES   *************************/
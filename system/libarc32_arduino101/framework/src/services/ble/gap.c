@@ -721,6 +721,33 @@ int bt_le_adv_start(const struct bt_le_adv_param *param,
 	return 0;
 }
 
+int bt_le_adv_update(const struct bt_data *ad, size_t ad_len,
+		     const struct bt_data *sd, size_t sd_len)
+{
+	int err;
+	struct nble_gap_ad_data_params data;
+
+	if (!atomic_test_bit(bt_dev.flags, BT_DEV_KEEP_ADVERTISING)) {
+		return -EINVAL;
+	}
+
+	memset(&data, 0, sizeof(data));
+
+	err = set_ad(&data.ad, ad, ad_len);
+	if (err) {
+		return err;
+	}
+	err = set_ad(&data.sd, sd, sd_len);
+	if (err) {
+		return err;
+	}
+
+	/* The controller takes new data while advertising is enabled */
+	nble_gap_set_adv_data_req(&data);
+
+	return 0;
+}
+
 void on_nble_gap_dir_adv_timeout_evt(const struct nble_gap_dir_adv_timeout_evt *p_evt)
 {
 	struct bt_conn *conn = bt_conn_lookup_state_le(BT_ADDR_LE_ANY, BT_CONN_CONNECT);
@@ -564,12 +564,16 @@ struct notify_data {
 	const void *data;
 	uint16_t len;
 	bt_gatt_notify_sent_func_t notify_cb;
+	void (*release)(void *);
+	void *release_arg;
 	struct bt_gatt_indicate_params *params;
+	int count;
 };
 
 static int att_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 		      const void *data, size_t len,
-		      bt_gatt_notify_sent_func_t cb)
+		      bt_gatt_notify_sent_func_t cb,
+		      void (*release)(void *), void *release_arg)
 {
 	struct nble_gatt_send_notif_params notif;
 
@@ -578,7 +582,11 @@ static int att_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 	notif.params.offset = 0;
 	notif.cback = cb;
 
-	nble_gatt_send_notif_req(&notif, data, len);
+	if (release)
+		nble_gatt_send_notif_ref_req(&notif, data, len, release,
+					     release_arg);
+	else
+		nble_gatt_send_notif_req(&notif, data, len);
 
 	return 0;
 }
@@ -589,10 +597,13 @@ void on_nble_gatts_send_notif_rsp(const struct nble_gatt_notif_rsp *rsp)
 
 	conn = bt_conn_lookup_handle(rsp->conn_handle);
 
+	/* The buffer is free even if the peer has gone meanwhile; the sender
+	 * still has to hear about it to keep its flow control in step.
+	 */
+	if (rsp->cback) {
+		rsp->cback(conn, rsp->attr, rsp->status);
+	}
 	if (conn) {
-		if (rsp->cback) {
-			rsp->cback(conn, rsp->attr, rsp->status);
-		}
 		bt_conn_unref(conn);
 	}
 }
@@ -673,7 +684,8 @@ static uint8_t notify_cb(const struct bt_gatt_attr *attr, void *user_data)
 
 		} else {
 			err = att_notify(conn, data->attr, data->data,
-					 data->len, data->notify_cb);
+					 data->len, data->notify_cb,
+					 data->release, data->release_arg);
 		}
 
 		bt_conn_unref(conn);
@@ -681,6 +693,7 @@ static uint8_t notify_cb(const struct bt_gatt_attr *attr, void *user_data)
 		if (err < 0) {
 			return BT_GATT_ITER_STOP;
 		}
+		data->count++;
 	}
 
 	return BT_GATT_ITER_CONTINUE;
@@ -689,6 +702,14 @@ static uint8_t notify_cb(const struct bt_gatt_attr *attr, void *user_data)
 int bt_gatt_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 		   const void *data, uint16_t len,
 		   bt_gatt_notify_sent_func_t cb)
+{
+	return bt_gatt_notify_ref(conn, attr, data, len, cb, NULL, NULL);
+}
+
+int bt_gatt_notify_ref(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+		       const void *data, uint16_t len,
+		       bt_gatt_notify_sent_func_t cb,
+		       void (*release)(void *), void *release_arg)
 {
 	struct notify_data nfy;
 
@@ -697,7 +718,10 @@ int bt_gatt_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 	}
 
 	if (conn) {
-		return att_notify(conn, attr, data, len, cb);
+		int err = att_notify(conn, attr, data, len, cb, release,
+				     release_arg);
+
+		return err < 0 ? err : 1;
 	}
 
 	nfy.state = 0;
@@ -706,10 +730,13 @@ int bt_gatt_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 	nfy.data = data;
 	nfy.len = len;
 	nfy.notify_cb = cb;
+	nfy.release = release;
+	nfy.release_arg = release_arg;
+	nfy.count = 0;
 
 	bt_gatt_foreach_attr(1, 0xffff, notify_cb, &nfy);
 
-	return 0;
+	return nfy.count;
 }
 
 int bt_gatt_indicate(struct bt_conn *conn,
@@ -1318,13 +1345,16 @@ void on_nble_gattc_write_rsp(const struct ble_gattc_write_rsp *rsp)
 
 	struct bt_conn *conn = bt_conn_lookup_handle(rsp->conn_handle);
 
-	BT_ASSERT(conn);
-
+	/* As for notifications, the writer has to hear about it even if the
+	 * peer has gone meanwhile, to keep its flow control in step.
+	 */
 	if (rsp->wr_params.func) {
 		rsp->wr_params.func(conn, rsp->status, &rsp->wr_params);
 	}
 
-	bt_conn_unref(conn);
+	if (conn) {
+		bt_conn_unref(conn);
+	}
 }
 
 
@@ -1335,6 +1365,23 @@ int bt_gatt_write_without_response(struct bt_conn *conn, uint16_t handle,
 			     on_write_no_rsp_complete);
 }
 
+int bt_gatt_write_without_response_cb(struct bt_conn *conn, uint16_t handle,
+				      const void *data, uint16_t length,
+				      bt_gatt_write_rsp_func_t func)
+{
+	struct bt_gatt_write_params wr_params;
+
+	if (!conn || conn->state != BT_CONN_CONNECTED  || !handle || !func) {
+		return -EINVAL;
+	}
+
+	wr_params.func = on_write_complete;
+	wr_params.user_data[0] = func;
+	wr_params.user_data[1] = (void *)data;
+
+	return _bt_gatt_write(conn, handle, false, 0, data, length, &wr_params);
+}
+
 int bt_gatt_write(struct bt_conn *conn, uint16_t handle, uint16_t offset,
 		  const void *data, uint16_t length,
 		  bt_gatt_write_rsp_func_t func)
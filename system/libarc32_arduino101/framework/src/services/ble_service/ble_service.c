@@ -47,6 +47,7 @@
 #include "gap_internal.h"
 
 #include "nble_driver.h"
+#include "ipc_uart_ns16550.h"
 
 #include "rpc.h"
 
@@ -115,7 +116,7 @@ static void handle_msg_id_ble_rpc_callin(struct message *msg, void *priv)
 	/* handle incoming message */
     //pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
 	rpc_deserialize(rpc->p_data, rpc->len);
-	bfree(rpc->p_data);
+	ipc_uart_rx_free(rpc->p_data);
 	message_free(msg);
     //pr_debug(LOG_MODULE_BLE, "%s-%d", __FUNCTION__, __LINE__);
 }
@@ -278,9 +279,19 @@ void ble_cfw_service_init(int service_id, T_QUEUE queue)
 
     ble_inited = false;
 
+    /* nble comes up in the background: see ble_cfw_service_poll() */
     bt_enable(ble_bt_rdy);
-    do{}
-    while (ble_inited == false);
+}
+
+bool ble_cfw_service_poll(void)
+{
+    nble_driver_poll();
+    return ble_inited;
+}
+
+void ble_cfw_service_wait(void)
+{
+    while (!ble_cfw_service_poll());
 }
 
 void nble_log(const struct nble_log_s *param, char *buf, uint8_t buflen)
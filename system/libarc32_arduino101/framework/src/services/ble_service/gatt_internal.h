@@ -184,6 +184,12 @@ void on_nble_gatts_read_evt(const struct nble_gatt_rd_evt *p_evt);
 void nble_gatt_send_notif_req(const struct nble_gatt_send_notif_params *p_params,
 			     const uint8_t *p_value, uint16_t length);
 
+/* As nble_gatt_send_notif_req(), without copying p_value: release(arg) is
+ * called once it has gone out on the IPC UART */
+void nble_gatt_send_notif_ref_req(const struct nble_gatt_send_notif_params *p_params,
+				  const uint8_t *p_value, uint16_t length,
+				  void (*release)(void *), void *arg);
+
 void nble_gatt_send_ind_req(const struct nble_gatt_send_ind_params *p_params,
 			   const uint8_t *p_value, uint8_t length);
 
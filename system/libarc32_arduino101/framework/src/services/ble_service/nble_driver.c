@@ -64,6 +64,7 @@
 #define QRK_BLE_INT     5
 
 static uint16_t rpc_port_id;
+/* RPCs the IPC UART TX queue had no room for */
 static list_head_t m_rpc_tx_q;
 
 extern void on_nble_curie_log(char *fmt, ...)
@@ -136,6 +137,11 @@ static void *m_rpc_channel;
 struct rpc_tx_elt {
 	list_t l;
 	uint16_t length;
+	/* payload sent in place after data, see rpc_transmit_ext_cb() */
+	uint16_t ext_length;
+	const uint8_t *ext;
+	void (*release)(void *);
+	void *release_arg;
 	uint8_t data[0];
 };
 
@@ -153,9 +159,11 @@ static int uart_rpc_try_tx(list_t *l)
 	p_elt = container_of(l, struct rpc_tx_elt, l);
 
 	/* Try to send the element payload */
-	return ipc_uart_ns16550_send_pdu(m_rpc_channel, 
-	                                 p_elt->length, 
-	                                 p_elt->data);
+	return ipc_uart_ns16550_send_pdu_ext(m_rpc_channel,
+	                                     p_elt->length,
+	                                     p_elt->data,
+	                                     p_elt->ext_length,
+	                                     p_elt->ext);
 }
 
 /**
@@ -247,6 +255,8 @@ if (NULL == rpc)
     	struct rpc_tx_elt *p_elt;
 
     	p_elt = container_of(p_data, struct rpc_tx_elt, data);
+		if (p_elt->release)
+			p_elt->release(p_elt->release_arg);
 		bfree(p_elt);
         
         //pr_debug(LOG_MODULE_IPC, "%s:%p", __FUNCTION__, p_elt);
@@ -276,6 +286,9 @@ uint8_t *rpc_alloc_cb(uint16_t length)
 
 	/* Save the length of the buffer */
 	p_elt->length = length;
+	p_elt->ext_length = 0;
+	p_elt->ext = NULL;
+	p_elt->release = NULL;
 
 	return p_elt->data;
 }
@@ -292,15 +305,34 @@ void rpc_transmit_cb(uint8_t *p_buf, uint16_t length)
 	uart_rpc_try_tx_on_add();
 }
 
+/* p_ext goes out in place after p_buf; release(arg) runs from the TX done
+ * interrupt once it has */
+void rpc_transmit_ext_cb(uint8_t *p_buf, uint16_t length,
+			 const uint8_t *p_ext, uint16_t ext_length,
+			 void (*release)(void *), void *arg)
+{
+	struct rpc_tx_elt *p_elt;
+
+	p_elt = container_of(p_buf, struct rpc_tx_elt, data);
+	p_elt->ext = p_ext;
+	p_elt->ext_length = ext_length;
+	p_elt->release = release;
+	p_elt->release_arg = arg;
+
+	rpc_transmit_cb(p_buf, length);
+}
+
 /* nble reset is achieved by asserting low the SWDIO pin.
  * However, the BLE Core chip can be in SWD debug mode, and NRF_POWER->RESET = 0 due to,
  * other constraints: therefore, this reset might not work everytime, especially after
  * flashing or debugging.
  */
+/* End of the reset pulse, in 32k ticks, until nble_driver_poll() ends it */
+static uint32_t nble_reset_until = 0;
+static bool nble_in_reset = false;
+
 void nble_driver_init(void)
 {
-    uint32_t delay_until;
-    
     nble_interface_init();
     /* Setup UART0 for BLE communication, HW flow control required  */
     SET_PIN_MODE(18, QRK_PMUX_SEL_MODEA); /* UART0_RXD        */
@@ -310,30 +342,37 @@ void nble_driver_init(void)
     
 	ipc_uart_init(0);
 	
-    //while (1)
-    //{}
 	/* RESET_PIN depends on the board and the local configuration: check top of file */
 	gpio_cfg_data_t pin_cfg = { .gpio_type = GPIO_OUTPUT };
     
 	soc_gpio_set_config(SOC_GPIO_32, RESET_PIN, &pin_cfg);
-    //soc_gpio_set_config(SOC_GPIO_32_ID, BLE_SW_CLK_PIN, &pin_cfg);
 	/* Reset hold time is 0.2us (normal) or 100us (SWD debug) */
 	soc_gpio_write(SOC_GPIO_32, RESET_PIN, 0);
-	/* Wait for ~1ms */
-	delay_until = get_uptime_32k() + 32768;
+	/* Held for 32768 ticks of the 32k clock, but without waiting here:
+	 * nble_driver_poll() releases it, so boot goes on meanwhile */
+	nble_reset_until = get_uptime_32k() + 32768;
+	nble_in_reset = true;
 	
 	/* Open the UART channel for RPC while Nordic is in reset */
 	m_rpc_channel = ipc_uart_channel_open(RPC_CHANNEL, uart_ipc_rpc_cback);
-	
-	while (get_uptime_32k() < delay_until);
-	
+}
+
+bool nble_driver_poll(void)
+{
+	gpio_cfg_data_t pin_cfg = { .gpio_type = GPIO_INPUT };
+
+	if (!nble_in_reset)
+		return true;
+	if ((int32_t)(get_uptime_32k() - nble_reset_until) < 0)
+		return false;
+	nble_in_reset = false;
+
 	/* De-assert the reset */
 	soc_gpio_write(SOC_GPIO_32, RESET_PIN, 1);
 
-
 	/* Set back GPIO to input to avoid interfering with external debugger */
-	pin_cfg.gpio_type = GPIO_INPUT;
 	soc_gpio_set_config(SOC_GPIO_32, RESET_PIN, &pin_cfg);
+	return true;
 }
 
 
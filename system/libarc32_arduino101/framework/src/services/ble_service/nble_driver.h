@@ -31,6 +31,7 @@
 #ifndef NBLE_DRIVER_H_
 #define NBLE_DRIVER_H_
 
+#include <stdbool.h>
 #include "os/os.h"
 #include "infra/message.h"
 
@@ -43,11 +44,19 @@ struct ble_rpc_callin {
 /**
  * This resets and initializes the uart/ipc mechanism of nble.
  *
- * This this will trigger the call to @ref on_nble_up indicating that rpc
- * mechanism is up and running.
+ * The reset is released later, by @ref nble_driver_poll. This will then
+ * trigger the call to @ref on_nble_up indicating that rpc mechanism is up
+ * and running.
  */
 void nble_driver_init(void);
 
+/**
+ * Release nble from reset once its hold time is over.
+ *
+ * @return true once nble is out of reset
+ */
+bool nble_driver_poll(void);
+
 void nble_driver_configure(T_QUEUE queue, void (*handler)(struct message*, void*));
 
 void uart_ipc_disable(void);
@@ -36,7 +36,7 @@ void list_init(list_head_t * list) {
 }
 
 void list_add_head(list_head_t * list, list_t * element) {
-    uint32_t saved = interrupt_lock();
+    uint32_t saved = interrupt_lock_low();
     element->next = list->head;
     list->head = element;
     if (element->next == NULL) {
@@ -47,7 +47,7 @@ void list_add_head(list_head_t * list, list_t * element) {
 
 
 void list_add(list_head_t * list, list_t * element) {
-    uint32_t saved = interrupt_lock();
+    uint32_t saved = interrupt_lock_low();
     if (list->head == NULL) {
         list->head = list->tail = element;
     } else {
@@ -59,7 +59,7 @@ void list_add(list_head_t * list, list_t * element) {
 }
 
 void list_remove(list_head_t *list, list_t * element) {
-    uint32_t saved = interrupt_lock();
+    uint32_t saved = interrupt_lock_low();
     list_t * l = list->head;
     if (l == NULL) {
         // List empty, return
@@ -124,7 +124,7 @@ void list_foreach_del(list_head_t * lh, int(*cb)(void *, void *), void * param)
 }
 
 list_t * list_get(list_head_t *lh) {
-    uint32_t saved = interrupt_lock();
+    uint32_t saved = interrupt_lock_low();
     list_t * l = lh->head;
     if (l != NULL) {
         lh->head = l->next;
@@ -146,3 +146,103 @@ list_t * list_find_first(list_head_t * lh, bool(*cb)(list_t*,void*), void *data)
     for (; l && !cb(l,data); l = l->next);
     return l;
 }
+
+void dlist_init(dlist_head_t * list) {
+    list->node.next = list->node.prev = &list->node;
+}
+
+static void dlist_insert(dlist_t * prev, dlist_t * element, dlist_t * next) {
+    element->prev = prev;
+    element->next = next;
+    prev->next = element;
+    next->prev = element;
+}
+
+void dlist_add(dlist_head_t * list, dlist_t * element) {
+    dlist_insert(list->node.prev, element, &list->node);
+}
+
+void dlist_add_head(dlist_head_t * list, dlist_t * element) {
+    dlist_insert(&list->node, element, list->node.next);
+}
+
+void dlist_remove(dlist_t * element) {
+    element->prev->next = element->next;
+    element->next->prev = element->prev;
+    element->next = element->prev = NULL;
+}
+
+dlist_t * dlist_get(dlist_head_t * list) {
+    dlist_t * l = list->node.next;
+    if (l == &list->node) {
+        return NULL;
+    }
+    dlist_remove(l);
+    return l;
+}
+
+int dlist_empty(dlist_head_t * list) {
+    return (list->node.next == &list->node);
+}
+
+/* Stores element in *ptr and returns what was there, atomically */
+static inline list_t * mpsc_exchange(list_t * volatile * ptr, list_t * element) {
+#ifdef __CPU_ARC__
+    __asm__ volatile ("ex %0, [%1]" : "+r" (element) : "r" (ptr) : "memory");
+    return element;
+#else
+    uint32_t saved = interrupt_lock();
+    list_t * prev = *ptr;
+    *ptr = element;
+    interrupt_unlock(saved);
+    return prev;
+#endif
+}
+
+/*
+ * The queue always holds at least one element, stub when it is otherwise
+ * empty, so a push only touches head and the element pushed before it.
+ * Between the exchange and the link of the previous element the new one
+ * is not reachable yet; mpsc_get() then reports the queue empty.
+ */
+void mpsc_init(mpsc_queue_t * q) {
+    q->stub.next = NULL;
+    q->head = q->tail = &q->stub;
+}
+
+void mpsc_push(mpsc_queue_t * q, list_t * element) {
+    list_t * prev;
+
+    element->next = NULL;
+    prev = mpsc_exchange(&q->head, element);
+    *(list_t * volatile *)&prev->next = element;
+}
+
+list_t * mpsc_get(mpsc_queue_t * q) {
+    list_t * tail = q->tail;
+    list_t * next = *(list_t * volatile *)&tail->next;
+
+    if (tail == &q->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        q->tail = tail = next;
+        next = *(list_t * volatile *)&tail->next;
+    }
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+    if (tail != q->head) {
+        /* A push is in progress */
+        return NULL;
+    }
+    /* tail is the last element: put stub behind it to take it */
+    mpsc_push(q, &q->stub);
+    next = *(list_t * volatile *)&tail->next;
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
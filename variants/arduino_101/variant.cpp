@@ -18,6 +18,7 @@
 
 #include "variant.h"
 #include "portable.h"
+#include "power.h"
 
 #include "cfw_platform.h"
 #include "platform.h"
@@ -63,47 +64,17 @@ extern "C" {
 /*
  * Pins descriptions
  */
+#define PIN_DESCRIPTION(...) { __VA_ARGS__ },
+
 PinDescription g_APinDescription[]=
 {
-
-//     gpio port          type       base                   soc pin mux mode       pwm chan pwm scale        adc channel pin mode
-    {  1,   SS_GPIO_8B1,  SS_GPIO,   SS_GPIO_8B1_BASE_ADDR, 17,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO0
-    {  0,   SS_GPIO_8B1,  SS_GPIO,   SS_GPIO_8B1_BASE_ADDR, 16,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO1
-    { 18,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    52,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO2
-    {  2,   SS_GPIO_8B1,  SS_GPIO,   SS_GPIO_8B1_BASE_ADDR, 63,     GPIO_MUX_MODE, 0,       PWM_SCALE_490HZ, INVALID, INPUT_MODE }, // Arduino IO3
-    { 19,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    53,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO4
-    {  3,   SS_GPIO_8B1,  SS_GPIO,   SS_GPIO_8B1_BASE_ADDR, 64,     GPIO_MUX_MODE, 1,       PWM_SCALE_980HZ, INVALID, INPUT_MODE }, // Arduino IO5
-    {  4,   SS_GPIO_8B1,  SS_GPIO,   SS_GPIO_8B1_BASE_ADDR, 65,     GPIO_MUX_MODE, 2,       PWM_SCALE_980HZ, INVALID, INPUT_MODE }, // Arduino IO6
-    { 20,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    54,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO7
-    { 16,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    50,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO8
-    {  5,   SS_GPIO_8B1,  SS_GPIO,   SS_GPIO_8B1_BASE_ADDR, 66,     GPIO_MUX_MODE, 3,       PWM_SCALE_490HZ, INVALID, INPUT_MODE }, // Arduino IO9
-    { 11,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    45,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO10
-    { 10,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    44,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO11
-    {  9,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    43,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO12
-    {  8,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    42,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO13
-    {  2,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR, 10,     GPIO_MUX_MODE, INVALID, INVALID,              10, INPUT_MODE }, // Arduino IO14
-    {  3,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR, 11,     GPIO_MUX_MODE, INVALID, INVALID,              11, INPUT_MODE }, // Arduino IO15
-    {  4,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR, 12,     GPIO_MUX_MODE, INVALID, INVALID,              12, INPUT_MODE }, // Arduino IO16
-    {  5,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR, 13,     GPIO_MUX_MODE, INVALID, INVALID,              13, INPUT_MODE }, // Arduino IO17
-    {  6,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR, 14,     GPIO_MUX_MODE, INVALID, INVALID,              14, INPUT_MODE }, // Arduino IO18
-    {  1,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR,  9,     GPIO_MUX_MODE, INVALID, INVALID,               9, INPUT_MODE }, // Arduino IO19
-    {  0,   SS_GPIO_8B0,  SS_GPIO,   SS_GPIO_8B0_BASE_ADDR,  8,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO20
-    { 24,   SOC_GPIO_32,  SOC_GPIO,  SOC_GPIO_BASE_ADDR,    58,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO21
-    { 12,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_BASE_ADDR,    46,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO22
-    { 13,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_BASE_ADDR,    47,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO23    
-    { 14,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_BASE_ADDR,    48,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO24
-    { 26,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_BASE_ADDR,    60,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO25
-    {  0,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_AON_BASE_ADDR, 0,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO26 *soft reset button
-    {  1,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_AON_BASE_ADDR, 1,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO27
-    {  2,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_AON_BASE_ADDR, 2,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO28 
-    {  3,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_AON_BASE_ADDR, 3,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO29
-    {  4,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_AON_BASE_ADDR, 4,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO30 *imu_int
-    {  5,   SOC_GPIO_32, SOC_GPIO,   SOC_GPIO_AON_BASE_ADDR, 5,     GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE }, // Arduino IO31 *ble_int
+    VARIANT_PIN_TABLE(PIN_DESCRIPTION)
 } ;
 
 uint32_t pwmPeriod[] = {PWM_PERIOD, PWM_PERIOD/2, PWM_PERIOD/2, PWM_PERIOD};
 
 uint8_t pinmuxMode[];
+uint8_t pinPullup[NUM_DIGITAL_PINS];
 #ifdef __cplusplus
 }
 #endif
@@ -121,13 +92,20 @@ uart_init_info info_cdc;
 
 CDCSerialClass Serial(&info_cdc);
 
+// Defined by the sketch; without it serialEventRun() does nothing for Serial
 void serialEvent() __attribute__((weak));
-void serialEvent() { }
 
 // Serial1 - Arduino Header Pins 0 and 1
 
-RingBuffer rx_buffer_uart;
-RingBuffer tx_buffer_uart;
+#ifndef SERIAL1_RX_BUFFER_SIZE
+#define SERIAL1_RX_BUFFER_SIZE UART_BUFFER_SIZE
+#endif
+#ifndef SERIAL1_TX_BUFFER_SIZE
+#define SERIAL1_TX_BUFFER_SIZE UART_BUFFER_SIZE
+#endif
+
+RingBuffer rx_buffer_uart(SERIAL1_RX_BUFFER_SIZE);
+RingBuffer tx_buffer_uart(SERIAL1_TX_BUFFER_SIZE);
 uart_init_info info_uart;
 
 UARTClass Serial1(&info_uart, &rx_buffer_uart, &tx_buffer_uart);
@@ -142,17 +120,18 @@ bool Serial1_available() {
 }
 
 void serialEvent1() __attribute__((weak));
-void serialEvent1() { }
 
+// Run after every loop(): each handler only once data arrived, and for as
+// long as some of it is left unread
 void serialEventRun(void)
 {
-  if (Serial.available()) serialEvent();
-  if (Serial1.available()) serialEvent1();
+  if (serialEvent && Serial.rxEvent()) serialEvent();
+  if (serialEvent1 && Serial1.rxEvent()) serialEvent1();
 }
 
 void serialEventRun1(void)
 {
-  if (Serial1_available()) serialEvent1();
+  if (serialEvent1 && Serial1.rxEvent()) serialEvent1();
 }
 // ----------------------------------------------------------------------------
 
@@ -181,18 +160,29 @@ void variantGpioInit(void)
         pinmuxMode[pin] = GPIO_MUX_MODE;
         pinMode(pin, INPUT);
     }
+    bootMark(BOOT_GPIO_INIT);
 }
 
+static bool pwmInitDone = false;
+static bool adcInitDone = false;
+
 void variantPwmInit(void)
 {
-    /* Enable PWM peripheral clock */
-    MMIO_REG_VAL(QRK_CLKGATE_CTRL) |= QRK_CLKGATE_CTRL_PWM_ENABLE;
+    if (pwmInitDone)
+        return;
+    pwmInitDone = true;
+
+    /* Clock the PWM block to set it up; analogWrite() holds the clock
+     * while a channel runs */
+    power_clock_acquire(POWER_CLOCK_PWM);
 
     /* Select PWM mode, with interrupts masked */
     for (uint8_t i = 0; i < NUM_PWM; i++) {
         uint32_t offset = ((i * QRK_PWM_N_REGS_LEN) + QRK_PWM_N_CONTROL);
         MMIO_REG_VAL_FROM_BASE(QRK_PWM_BASE_ADDR, offset) = QRK_PWM_CONTROL_PWM_OUT | QRK_PWM_CONTROL_INT_MASK | QRK_PWM_CONTROL_MODE_PERIODIC;
     }
+    power_clock_release(POWER_CLOCK_PWM);
+    bootMark(BOOT_PWM_INIT);
 }
 
 void variantAdcInit(void)
@@ -200,6 +190,9 @@ void variantAdcInit(void)
     uint32_t creg;
     uint32_t saved;
 
+    if (adcInitDone)
+        return;
+
     /* read creg slave to get current Power Mode */
     creg = READ_ARC_REG(AR_IO_CREG_SLV0_OBSR);
 
@@ -232,33 +225,41 @@ void variantAdcInit(void)
     WRITE_ARC_REG(ADC_CLK_ENABLE | ADC_INT_DSB, ADC_CTRL);
     WRITE_ARC_REG(ADC_CONFIG_SETUP, ADC_SET);
     WRITE_ARC_REG(ADC_CLOCK_RATIO & ADC_CLK_RATIO_MASK, ADC_DIVSEQSTAT);
+    adcInitDone = true;
+    bootMark(BOOT_ADC_INIT);
 
 }
 
 
 void initVariant( void )
 {
+    bootMark(BOOT_VARIANT);
+
     /* Initialise CDC-ACM shared buffers pointers, provided by LMT */
     Serial.setSharedData(shared_data->cdc_acm_buffers);
+    Serial.setFlowControl(&shared_data->cdc_acm_flow);
 
-    /* For now, lets enable clocks for all interfaces we need
-     * TODO - Consider only enabling as needed later to reduce power consumption
-     */
     variantGpioInit();
+#ifdef VARIANT_EAGER_INIT
     variantPwmInit();
     variantAdcInit();
+#endif
     
     //set RTC clock divider to 32768(1 Hz)
     *SYS_CLK_CTL |= RTC_DIV_1HZ_MASK;
     *SYS_CLK_CTL &= ~(1 << CCU_RTC_CLK_DIV_EN);
     *SYS_CLK_CTL |= 1 << CCU_RTC_CLK_DIV_EN;
     
+    /* Starts the BLE core bring-up too, which carries on in the background */
     cfw_platform_init();
+    bootMark(BOOT_FRAMEWORK);
     
     // Add for debug corelib
     #ifdef CONFIGURE_DEBUG_CORELIB_ENABLED
     log_init();
     #endif
+
+    bootMark(BOOT_VARIANT_DONE);
 }
 
 #ifdef __cplusplus
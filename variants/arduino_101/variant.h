@@ -92,6 +92,47 @@ extern "C"{
 #define SOC_GPIO 2
 #define INPUT_MODE 1
 #define OUTPUT_MODE 0
+
+/*
+ * Pin table, one row per Arduino pin. g_APinDescription[] in variant.cpp is
+ * built from it, and so are the compile-time lookups behind DigitalPin<>.
+ *
+ *      gpio port         type      base                    soc pin mux mode       pwm chan pwm scale        adc chan pin mode
+ */
+#define VARIANT_PIN_TABLE(PIN) \
+    PIN(1,  SS_GPIO_8B1, SS_GPIO,  SS_GPIO_8B1_BASE_ADDR,  17, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO0 */                     \
+    PIN(0,  SS_GPIO_8B1, SS_GPIO,  SS_GPIO_8B1_BASE_ADDR,  16, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO1 */                     \
+    PIN(18, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     52, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO2 */                     \
+    PIN(2,  SS_GPIO_8B1, SS_GPIO,  SS_GPIO_8B1_BASE_ADDR,  63, GPIO_MUX_MODE, 0,       PWM_SCALE_490HZ, INVALID, INPUT_MODE) /* Arduino IO3 */                     \
+    PIN(19, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     53, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO4 */                     \
+    PIN(3,  SS_GPIO_8B1, SS_GPIO,  SS_GPIO_8B1_BASE_ADDR,  64, GPIO_MUX_MODE, 1,       PWM_SCALE_980HZ, INVALID, INPUT_MODE) /* Arduino IO5 */                     \
+    PIN(4,  SS_GPIO_8B1, SS_GPIO,  SS_GPIO_8B1_BASE_ADDR,  65, GPIO_MUX_MODE, 2,       PWM_SCALE_980HZ, INVALID, INPUT_MODE) /* Arduino IO6 */                     \
+    PIN(20, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     54, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO7 */                     \
+    PIN(16, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     50, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO8 */                     \
+    PIN(5,  SS_GPIO_8B1, SS_GPIO,  SS_GPIO_8B1_BASE_ADDR,  66, GPIO_MUX_MODE, 3,       PWM_SCALE_490HZ, INVALID, INPUT_MODE) /* Arduino IO9 */                     \
+    PIN(11, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     45, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO10 */                    \
+    PIN(10, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     44, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO11 */                    \
+    PIN(9,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     43, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO12 */                    \
+    PIN(8,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     42, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO13 */                    \
+    PIN(2,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  10, GPIO_MUX_MODE, INVALID, INVALID,         10,      INPUT_MODE) /* Arduino IO14 */                    \
+    PIN(3,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  11, GPIO_MUX_MODE, INVALID, INVALID,         11,      INPUT_MODE) /* Arduino IO15 */                    \
+    PIN(4,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  12, GPIO_MUX_MODE, INVALID, INVALID,         12,      INPUT_MODE) /* Arduino IO16 */                    \
+    PIN(5,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  13, GPIO_MUX_MODE, INVALID, INVALID,         13,      INPUT_MODE) /* Arduino IO17 */                    \
+    PIN(6,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  14, GPIO_MUX_MODE, INVALID, INVALID,         14,      INPUT_MODE) /* Arduino IO18 */                    \
+    PIN(1,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  9,  GPIO_MUX_MODE, INVALID, INVALID,         9,       INPUT_MODE) /* Arduino IO19 */                    \
+    PIN(0,  SS_GPIO_8B0, SS_GPIO,  SS_GPIO_8B0_BASE_ADDR,  8,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO20 */                    \
+    PIN(24, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     58, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO21 */                    \
+    PIN(12, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     46, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO22 */                    \
+    PIN(13, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     47, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO23 */                    \
+    PIN(14, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     48, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO24 */                    \
+    PIN(26, SOC_GPIO_32, SOC_GPIO, SOC_GPIO_BASE_ADDR,     60, GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO25 */                    \
+    PIN(0,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_AON_BASE_ADDR, 0,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO26 *soft reset button */ \
+    PIN(1,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_AON_BASE_ADDR, 1,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO27 */                    \
+    PIN(2,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_AON_BASE_ADDR, 2,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO28 */                    \
+    PIN(3,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_AON_BASE_ADDR, 3,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO29 */                    \
+    PIN(4,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_AON_BASE_ADDR, 4,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO30 *imu_int */           \
+    PIN(5,  SOC_GPIO_32, SOC_GPIO, SOC_GPIO_AON_BASE_ADDR, 5,  GPIO_MUX_MODE, INVALID, INVALID,         INVALID, INPUT_MODE) /* Arduino IO31 *ble_int */           \
+
 /*
  * PWM
  */
@@ -151,6 +192,19 @@ extern "C"{
 #define ADC_CONFIG_SEQ_TBL         (0x0A)
 #define ADC_RESOLUTION               12
 #define ADC_CLOCK_GATE             (1 << 31)
+/* ADC_SET fields used by the multi-channel sequencer */
+#define ADC_FLUSH_RX               (1 << 30)
+#define ADC_SEQ_MODE_REPETITIVE    (1 << 13)
+#define ADC_SEQ_ENTRIES_SHIFT        16
+#define ADC_THRESHOLD_SHIFT          24
+/* ADC_SEQ entry: channel in bits 4:0, delay in ADC clocks in bits 15:5, two entries per write */
+#define ADC_SEQ_DELAY_SHIFT          5
+#define ADC_SEQ_DELAY_MAX          (0x7FF)
+#define ADC_SEQ_MAX_ENTRIES          16
+/* ADC_CTRL / ADC_INTSTAT */
+#define ADC_INT_DATA_A_DSB         (1 << 8)
+#define ADC_CLR_OVERFLOW           (1 << 17)
+#define ADC_INT_OVERFLOW           (0x2)
 
 /*
  * Clocking
@@ -182,6 +236,15 @@ static inline uint32_t digitalPinToPort(uint32_t pin) {
     return reg;
 }
 
+/*
+ * The PWM block and the ADC are brought up by the first analogWrite() or
+ * analogRead() family call rather than before setup(), shortening boot.
+ * Build with -DVARIANT_EAGER_INIT to bring them up in initVariant() again.
+ * Both calls do nothing once done.
+ */
+void variantPwmInit(void);
+void variantAdcInit(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -225,5 +288,9 @@ void CDCSerial_bytes_sent(uint32_t num);
 
 extern uint32_t sizeof_g_APinDescription;
 
+#ifdef __cplusplus
+#include "DigitalPin.h"
+#endif
+
 #endif /* _VARIANT_ARDUINO_101_X_ */
 